@@ -0,0 +1,135 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef CARD_READER_SCHEDULER_HPP
+#define CARD_READER_SCHEDULER_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "ICardReader.hpp"
+#include "Metrics.hpp"
+#include "NulLogger.hpp"
+
+/// Polling settings of one card reader
+struct CardReaderSettings
+{
+	/// Poll interval right after a card was read or an IRQ fired
+	unsigned int activeInterval_ms;
+	/// Longest poll interval, used when the reader has been idle for a while
+	unsigned int idleInterval_ms;
+	/// How long polling stays at `activeInterval_ms` after activity, before backing off towards `idleInterval_ms`
+	unsigned int activityHold_ms;
+	/// Largest share of time (1 - 100 %) the reader may spend inside `pollCardUUID()`
+	unsigned int dutyCycle_percent;
+};
+
+/// Receives cards read by `CardReaderScheduler`
+class ICardReaderListener
+{
+public:
+	virtual ~ICardReaderListener() = default;
+
+	/// Called from the thread running `CardReaderScheduler::WaitAndPoll()` every time `pReader` returns a card
+	virtual void CardDetected(ICardReader* pReader, const std::string& cardUUID) = 0;
+};
+
+/**
+ * @brief Polls several card readers from one thread
+ *
+ * Each reader is polled at `activeInterval_ms` while there is activity and the interval doubles on
+ * every empty poll afterwards, up to `idleInterval_ms`. Readers with an IRQ line are polled immediately
+ * when it fires. The time between polls is also stretched so a slow reader stays within its duty cycle.
+ */
+class CardReaderScheduler
+{
+public:
+	/**
+	 * @brief Create new CardReaderScheduler object
+	 * @param pListener Receives every card read
+	 * @param pLogger Pointer to a Logger object
+	*/
+	CardReaderScheduler(ICardReaderListener* pListener, ILogger* pLogger = NulLogger::getInstance());
+	~CardReaderScheduler();
+
+	CardReaderScheduler(const CardReaderScheduler&) = delete;
+	CardReaderScheduler& operator=(const CardReaderScheduler&) = delete;
+
+	/// Start polling `pReader` (not owned). The first poll happens immediately.
+	void AddReader(ICardReader* pReader, const CardReaderSettings& settings);
+
+	/// Replace the settings of `pReader`; applied from its next poll
+	void SetSettings(ICardReader* pReader, const CardReaderSettings& settings);
+
+	/**
+	 * @brief Sleeps until a reader is due, an IRQ fires or `Interrupt()` is called, then polls every due reader
+	 * @param maxWait_ms Upper bound of the wait, -1 waits until the next reader is due
+	 * @param pExtraFds Other descriptors (e.g. keypads) to wait on in the same poll(); their `revents` are filled in
+	 * @param extraFdCount Number of entries at `pExtraFds`
+	 * @return false if woken up by `Interrupt()`
+	*/
+	bool WaitAndPoll(int maxWait_ms = -1, pollfd* pExtraFds = nullptr, size_t extraFdCount = 0);
+
+	/// Wakes up a thread blocked in `WaitAndPoll()`. Safe to call from any thread.
+	void Interrupt();
+
+	/// Number of `pollCardUUID()` calls made on `pReader`
+	unsigned long getPollCount(ICardReader* pReader) const;
+
+	/// Interval which will be used after the next empty poll of `pReader`
+	unsigned int getCurrentInterval_ms(ICardReader* pReader) const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct ReaderState
+	{
+		ICardReader* pReader;
+		CardReaderSettings settings;
+		Clock::time_point nextPoll;
+		Clock::time_point lastActivity;
+		unsigned int interval_ms;
+		unsigned long polls;
+	};
+
+	ICardReaderListener* m_pListener;
+	ILogger* m_pLogger;
+	int m_wakeupFd;
+	std::vector<ReaderState> m_readers;
+
+	MetricHistogram m_pollLatency;	// "reader.poll_ns" - one pollCardUUID() call, its count is the number of polls
+	MetricCounter m_cardCounter;	// "reader.cards" - cards returned by the readers
+	MetricCounter m_irqCounter;		// "reader.irq_wakeups" - polls triggered by an IRQ line
+
+	ReaderState* findReader(ICardReader* pReader);
+	const ReaderState* findReader(ICardReader* pReader) const;
+
+	/// Polls `reader` and schedules its next poll
+	void pollReader(ReaderState& reader);
+};
+
+#endif
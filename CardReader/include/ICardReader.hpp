@@ -0,0 +1,55 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef ICARD_READER_HPP
+#define ICARD_READER_HPP
+
+#include <string>
+
+/// Interface of RFID/NFC card readers driven by `CardReaderScheduler`
+class ICardReader
+{
+public:
+	virtual ~ICardReader() = default;
+
+	/**
+	 * @brief Checks once whether a card is in the field, without waiting for one
+	 * @return UUID of the card formatted as "XX-XX-XX-XX", or an empty string if there is no card
+	*/
+	virtual std::string pollCardUUID() = 0;
+
+	/// Name used in logs
+	virtual std::string getName() const = 0;
+
+	/**
+	 * @brief File descriptor which becomes readable when the reader's IRQ line signals a card
+	 * @return -1 if the reader has no IRQ line and can only be polled
+	*/
+	virtual int getIrqFd() const { return -1; }
+
+	/// Called after `getIrqFd()` became readable, before the reader is polled
+	virtual void acknowledgeIrq() {}
+};
+
+#endif
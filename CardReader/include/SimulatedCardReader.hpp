@@ -0,0 +1,76 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SIMULATED_CARD_READER_HPP
+#define SIMULATED_CARD_READER_HPP
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#include "ICardReader.hpp"
+
+/**
+ * @brief Card reader without hardware, for tests and benchmarks
+ *
+ * Cards are put into the field with `PresentCard()` from any thread. Every poll keeps the CPU
+ * busy for `pollCost_us`, like an SPI/I2C transaction would, so CPU use can be compared.
+ */
+class SimulatedCardReader : public ICardReader
+{
+public:
+	/**
+	 * @brief Create new SimulatedCardReader object
+	 * @param name Name used in logs
+	 * @param pollCost_us CPU time spent in every `pollCardUUID()` call
+	 * @param withIrq If true, `getIrqFd()` becomes readable when a card is presented
+	*/
+	SimulatedCardReader(const std::string& name, unsigned int pollCost_us = 0, bool withIrq = false);
+	virtual ~SimulatedCardReader();
+
+	/// Puts a card with `cardUUID` into the field
+	void PresentCard(const std::string& cardUUID);
+
+	/// Takes the card out of the field
+	void RemoveCard();
+
+	/// When the card currently in the field was presented
+	std::chrono::steady_clock::time_point getPresentedAt() const;
+
+	virtual std::string pollCardUUID() override;
+	virtual std::string getName() const override { return m_name; }
+	virtual int getIrqFd() const override { return m_irqFd; }
+	virtual void acknowledgeIrq() override;
+
+private:
+	const std::string m_name;
+	const unsigned int m_pollCost_us;
+	int m_irqFd;
+
+	mutable std::mutex m_mutex;
+	std::string m_cardUUID;
+	std::chrono::steady_clock::time_point m_presentedAt;
+};
+
+#endif
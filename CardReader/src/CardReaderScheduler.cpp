@@ -0,0 +1,234 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "CardReaderScheduler.hpp"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "Kernel.hpp"
+
+CardReaderScheduler::CardReaderScheduler(ICardReaderListener* pListener, ILogger* pLogger)
+	: m_pListener(pListener), m_pLogger(pLogger), m_wakeupFd(-1),
+	m_pollLatency(MetricsRegistry::Process().getHistogram("reader.poll_ns")),
+	m_cardCounter(MetricsRegistry::Process().getCounter("reader.cards")),
+	m_irqCounter(MetricsRegistry::Process().getCounter("reader.irq_wakeups"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	if (m_pListener == nullptr)
+	{
+		*m_pLogger << "CardReaderScheduler - invalid listener pointer in ctor!";
+		Kernel::Fatal_Error("CardReaderScheduler - invalid listener pointer in ctor!");
+	}
+
+	m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_wakeupFd < 0)
+	{
+		*m_pLogger << "CardReaderScheduler - cannot create eventfd!";
+		Kernel::Fatal_Error("CardReaderScheduler - cannot create eventfd!");
+	}
+}
+
+CardReaderScheduler::~CardReaderScheduler()
+{
+	close(m_wakeupFd);
+}
+
+void CardReaderScheduler::AddReader(ICardReader* pReader, const CardReaderSettings& settings)
+{
+	if (pReader == nullptr)
+	{
+		*m_pLogger << "CardReaderScheduler - invalid reader pointer!";
+		Kernel::Fatal_Error("CardReaderScheduler - invalid reader pointer!");
+	}
+
+	Clock::time_point now = Clock::now();
+	m_readers.push_back(ReaderState{ pReader, settings, now, now, settings.activeInterval_ms, 0 });
+
+	*m_pLogger << "Card reader added: " + pReader->getName();
+}
+
+void CardReaderScheduler::SetSettings(ICardReader* pReader, const CardReaderSettings& settings)
+{
+	ReaderState* pState = findReader(pReader);
+	if (pState == nullptr) return;
+
+	pState->settings = settings;
+	pState->interval_ms = std::max(settings.activeInterval_ms, std::min(pState->interval_ms, settings.idleInterval_ms));
+}
+
+bool CardReaderScheduler::WaitAndPoll(int maxWait_ms, pollfd* pExtraFds, size_t extraFdCount)
+{
+	std::vector<pollfd> pollFds;
+	std::vector<ReaderState*> irqReaders;
+
+	pollFds.push_back({ m_wakeupFd, POLLIN, 0 });
+
+	Clock::time_point now = Clock::now();
+	Clock::time_point nextPoll = Clock::time_point::max();
+
+	for (ReaderState& reader : m_readers)
+	{
+		nextPoll = std::min(nextPoll, reader.nextPoll);
+
+		int irqFd = reader.pReader->getIrqFd();
+		if (irqFd >= 0)
+		{
+			pollFds.push_back({ irqFd, POLLIN | POLLPRI, 0 });
+			irqReaders.push_back(&reader);
+		}
+	}
+
+	const size_t extraFdsBegin = pollFds.size();
+	pollFds.insert(pollFds.end(), pExtraFds, pExtraFds + extraFdCount);
+
+	int timeout_ms = maxWait_ms;
+	if (nextPoll != Clock::time_point::max())
+	{
+		// Rounded up, so the wait never ends just before the reader is due
+		auto untilNextPoll = std::chrono::duration_cast<std::chrono::microseconds>(nextPoll - now).count();
+		int untilNextPoll_ms = untilNextPoll <= 0 ? 0 : (int)((untilNextPoll + 999) / 1000);
+		timeout_ms = (maxWait_ms < 0) ? untilNextPoll_ms : std::min(maxWait_ms, untilNextPoll_ms);
+	}
+
+	int readyCount = poll(pollFds.data(), pollFds.size(), timeout_ms);
+	if (readyCount < 0 && errno != EINTR)
+	{
+		*m_pLogger << "CardReaderScheduler - poll() error!";
+		Kernel::Fatal_Error("CardReaderScheduler - poll() error!");
+	}
+
+	for (size_t i = 0; i < extraFdCount; ++i)
+	{
+		pExtraFds[i].revents = (readyCount > 0) ? pollFds[extraFdsBegin + i].revents : 0;
+	}
+
+	bool interrupted = false;
+	if (readyCount > 0)
+	{
+		if (pollFds[0].revents & POLLIN)
+		{
+			eventfd_t count;
+			eventfd_read(m_wakeupFd, &count);
+			interrupted = true;
+		}
+
+		now = Clock::now();
+		for (size_t i = 0; i < irqReaders.size(); ++i)
+		{
+			if (pollFds[i + 1].revents == 0) continue;
+
+			ReaderState& reader = *irqReaders[i];
+			reader.pReader->acknowledgeIrq();
+			m_irqCounter.Increment();
+			reader.lastActivity = now;
+			reader.interval_ms = reader.settings.activeInterval_ms;
+			reader.nextPoll = now;
+		}
+	}
+
+	now = Clock::now();
+	for (ReaderState& reader : m_readers)
+	{
+		if (reader.nextPoll <= now)
+		{
+			pollReader(reader);
+		}
+	}
+
+	return !interrupted;
+}
+
+void CardReaderScheduler::pollReader(ReaderState& reader)
+{
+	const CardReaderSettings& settings = reader.settings;
+
+	Clock::time_point start = Clock::now();
+	std::string cardUUID = reader.pReader->pollCardUUID();
+	Clock::time_point end = Clock::now();
+	++reader.polls;
+	m_pollLatency.Record(end - start);
+
+	if (!cardUUID.empty())
+	{
+		m_cardCounter.Increment();
+		reader.lastActivity = end;
+		reader.interval_ms = settings.activeInterval_ms;
+	}
+	else if (end - reader.lastActivity >= std::chrono::milliseconds(settings.activityHold_ms))
+	{
+		reader.interval_ms = std::min(std::max(reader.interval_ms, 1u) * 2, settings.idleInterval_ms);
+	}
+
+	// A poll lasting `busy` may be followed by at least busy * (100 - duty) / duty of rest
+	unsigned int dutyCycle_percent = std::max(1u, std::min(settings.dutyCycle_percent, 100u));
+	Clock::duration busy = end - start;
+	Clock::duration minimumRest = busy * (100 - dutyCycle_percent) / dutyCycle_percent;
+
+	reader.nextPoll = end + std::max<Clock::duration>(std::chrono::milliseconds(reader.interval_ms), minimumRest);
+
+	if (!cardUUID.empty())
+	{
+		m_pListener->CardDetected(reader.pReader, cardUUID);
+	}
+}
+
+void CardReaderScheduler::Interrupt()
+{
+	eventfd_write(m_wakeupFd, 1);
+}
+
+unsigned long CardReaderScheduler::getPollCount(ICardReader* pReader) const
+{
+	const ReaderState* pState = findReader(pReader);
+	return pState ? pState->polls : 0;
+}
+
+unsigned int CardReaderScheduler::getCurrentInterval_ms(ICardReader* pReader) const
+{
+	const ReaderState* pState = findReader(pReader);
+	return pState ? pState->interval_ms : 0;
+}
+
+CardReaderScheduler::ReaderState* CardReaderScheduler::findReader(ICardReader* pReader)
+{
+	for (ReaderState& reader : m_readers)
+	{
+		if (reader.pReader == pReader) return &reader;
+	}
+
+	return nullptr;
+}
+
+const CardReaderScheduler::ReaderState* CardReaderScheduler::findReader(ICardReader* pReader) const
+{
+	return const_cast<CardReaderScheduler*>(this)->findReader(pReader);
+}
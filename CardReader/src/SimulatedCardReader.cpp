@@ -0,0 +1,87 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SimulatedCardReader.hpp"
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "Kernel.hpp"
+
+SimulatedCardReader::SimulatedCardReader(const std::string& name, unsigned int pollCost_us, bool withIrq)
+	: m_name(name), m_pollCost_us(pollCost_us), m_irqFd(-1)
+{
+	if (withIrq)
+	{
+		m_irqFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (m_irqFd < 0)
+		{
+			Kernel::Fatal_Error("SimulatedCardReader - cannot create eventfd!");
+		}
+	}
+}
+
+SimulatedCardReader::~SimulatedCardReader()
+{
+	if (m_irqFd >= 0) close(m_irqFd);
+}
+
+void SimulatedCardReader::PresentCard(const std::string& cardUUID)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cardUUID = cardUUID;
+		m_presentedAt = std::chrono::steady_clock::now();
+	}
+
+	if (m_irqFd >= 0) eventfd_write(m_irqFd, 1);
+}
+
+void SimulatedCardReader::RemoveCard()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cardUUID = "";
+}
+
+std::chrono::steady_clock::time_point SimulatedCardReader::getPresentedAt() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_presentedAt;
+}
+
+std::string SimulatedCardReader::pollCardUUID()
+{
+	// Busy wait instead of sleep: bit-banged SPI and libnfc transfers keep the CPU busy too
+	auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(m_pollCost_us);
+	while (std::chrono::steady_clock::now() < end);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_cardUUID;
+}
+
+void SimulatedCardReader::acknowledgeIrq()
+{
+	eventfd_t count;
+	eventfd_read(m_irqFd, &count);
+}
@@ -0,0 +1,173 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef ACCESS_GUARD_HPP
+#define ACCESS_GUARD_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "DataMailbox.hpp"
+#include "ILogger.hpp"
+#include "NulLogger.hpp"
+#include "Sha256.hpp"
+
+/**
+ * @brief Rate limiting and anti-passback in front of every AUTHENTICATE, kept in memory by DatabaseGateway
+ *
+ * Three checks, each disabled by a zero limit:
+ * - every credential may be presented `m_credentialMaxAttempts` times per sliding window, more locks it out (card sharing, replayed taps)
+ * - every door input (keypad, card reader) may refuse `m_doorMaxFailures` credentials per sliding window, more locks that input
+ *   out while the other inputs of the door keep working (PIN brute force)
+ * - a credential granted at one door is refused at every other door for `m_antiPassback_ms`
+ *
+ * Credentials are tracked by a 64 bit FNV-1a hash of type and data. The hash is not keyed, so the PIN of a locked out credential
+ * is easily recovered from its row in `AccessLockouts`; the table is as sensitive as the credential tables next to it. A window is
+ * a ring of the last `limit` timestamps, so a check is a hash lookup and one comparison with the oldest timestamp whatever the limit.
+ * Lockouts are written to the `AccessLockouts` table and reloaded at startup, so a restart does not lift them.
+ * Timestamps are passed in by the caller (wall clock milliseconds in DatabaseGateway), which keeps the guard deterministic.
+ * Not thread-safe, it is used by the request loop only.
+*/
+class AccessGuard
+{
+public:
+	typedef enum
+	{
+		ALLOWED = 0,
+		CREDENTIAL_LOCKED,
+		DOOR_LOCKED,
+		PASSBACK
+	} enuVerdict;
+
+	/// Outcome of an admitted attempt
+	typedef enum
+	{
+		GRANTED = 0,
+		DENIED,            ///< known credential refused by its clearance, access schedule or a holiday
+		UNKNOWN_CREDENTIAL ///< no such card or PIN
+	} enuOutcome;
+
+	struct Limits
+	{
+		unsigned int m_credentialMaxAttempts = 0;
+		int64_t m_credentialWindow_ms = 0;
+		unsigned int m_doorMaxFailures = 0;
+		int64_t m_doorWindow_ms = 0;
+		int64_t m_lockout_ms = 0;
+		int64_t m_antiPassback_ms = 0;
+	};
+
+	/// Table of active lockouts: Scope 0 for credentials, 1 for door inputs; Until in the caller's milliseconds
+	static const char* const CREATE_TABLES;
+
+	/// Tracked credentials and door inputs are swept for idle entries whenever their count doubles past this
+	static const size_t SWEEP_THRESHOLD = 4096;
+
+	/**
+	 * @brief Opens `databasePath`, creating `AccessLockouts` if missing, and loads the persisted lockouts
+	 * @param databasePath Database to persist lockouts to, empty to keep them in memory only. Credentials are stored
+	 * keyed with the key in `databasePath` + ".key", which is created on first use.
+	*/
+	AccessGuard(const Limits& limits, const std::string& databasePath, ILogger* pLogger = NulLogger::getInstance());
+	~AccessGuard();
+
+	AccessGuard(const AccessGuard&) = delete;
+	AccessGuard& operator=(const AccessGuard&) = delete;
+
+	/**
+	 * @brief Decides whether `credential` may be looked up at door `doorId`, counting the attempt
+	 * @return ALLOWED, or why the attempt is refused without a lookup
+	*/
+	enuVerdict Admit(const InputParameter& credential, DoorId doorId, int64_t now_ms);
+
+	/// Records the outcome of an admitted attempt: unknown credentials count against the door input, grants start anti-passback
+	void Record(const InputParameter& credential, DoorId doorId, enuOutcome outcome, int64_t now_ms);
+
+	/// Replaces the limits; attempts counted so far are dropped, active lockouts stay until they expire
+	void setLimits(const Limits& limits);
+
+	/// Number of credentials and door inputs locked out at `now_ms`
+	size_t getLockoutCount(int64_t now_ms) const;
+
+	/// Number of credentials and door inputs currently tracked
+	size_t getTrackedCount() const { return m_credentials.size() + m_inputs.size(); }
+
+	static const char* toString(enuVerdict verdict);
+
+private:
+	/// Last `limit` timestamps of a sliding window, oldest at m_next once full
+	struct Window
+	{
+		std::vector<int64_t> m_times;
+		size_t m_next = 0;
+	};
+
+	struct CredentialState
+	{
+		Window m_attempts;
+		int64_t m_lockedUntil_ms = INT64_MIN;
+		int64_t m_lastGrant_ms = INT64_MIN;
+		DoorId m_lastDoor = NO_DOOR;
+	};
+
+	struct InputState
+	{
+		Window m_failures;
+		int64_t m_lockedUntil_ms = INT64_MIN;
+	};
+
+	enum : int { SCOPE_CREDENTIAL = 0, SCOPE_DOOR_INPUT = 1 };
+
+	static uint64_t inputKey(DoorId doorId, InputParameter::enuType type) { return (static_cast<uint64_t>(doorId) << 8) | static_cast<uint8_t>(type); }
+
+	/// HMAC-SHA-256 of the credential type and data. Without the key a 4 digit PIN cannot be recovered from the stored value.
+	uint64_t credentialKey(const InputParameter& credential) const;
+
+	/// Reads the key file, or creates it with a random key readable by the owner only
+	bool loadKey(const std::string& keyPath);
+
+	/// Adds `now_ms` to `window`; false if it already holds `limit` timestamps newer than `now_ms - length_ms`
+	static bool addToWindow(Window& window, unsigned int limit, int64_t length_ms, int64_t now_ms);
+
+	void lockOut(int scope, uint64_t key, int64_t until_ms, int64_t now_ms);
+	void loadLockouts();
+	void sweep(int64_t now_ms);
+
+	Limits m_limits;
+	std::string m_databasePath;
+	ILogger* m_pLogger;
+	Sha256::HmacKey m_key;
+
+	sqlite3* m_pDatabase;
+
+	std::unordered_map<uint64_t, CredentialState> m_credentials;
+	std::unordered_map<uint64_t, InputState> m_inputs;
+	size_t m_nextSweep;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef ACCESS_SCHEDULE_HPP
+#define ACCESS_SCHEDULE_HPP
+
+#include <bitset>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "DataMailbox.hpp"
+#include "ILogger.hpp"
+#include "NulLogger.hpp"
+
+/**
+ * @brief One row of the `AccessRules` table: a weekly time window in local wall-clock time
+ *
+ * Rules of one employee are alternatives (any of them admits), as are the rules of one door;
+ * an employee restricted by their own rules at a door which also has a door schedule needs both.
+*/
+struct AccessRule
+{
+	/// Employee the rule restricts (`UID`), 0 for a door schedule which restricts everyone
+	unsigned int m_employeeId = 0;
+	/// Door the rule applies to, NO_DOOR for every door
+	DoorId m_doorId = NO_DOOR;
+	/// Days the window starts on, bit 0 Monday ... bit 6 Sunday
+	uint8_t m_weekdays = 0;
+	/// Minutes since local midnight, start included and end excluded. `m_end_min <= m_start_min` ends on the next day.
+	uint16_t m_start_min = 0;
+	uint16_t m_end_min = 0;
+	/// First and last local date (days since 1970-01-01) a window may start on
+	int32_t m_validFrom_day = INT32_MIN;
+	int32_t m_validUntil_day = INT32_MAX;
+	/// Whether the window also opens on a date listed in `Holidays`
+	bool m_onHolidays = false;
+};
+
+/**
+ * @brief Time-window restrictions on top of the numeric clearance, checked on every AUTHENTICATE
+ *
+ * Employees and doors without rules are not restricted. The rules are read once into memory and grouped by
+ * (employee, door); for the current local date every group is compiled on first use into a bitmap with one
+ * bit per minute of the day, so a check costs a local time conversion, two hash lookups and a bit test.
+ * Weekdays, holidays and validity dates are resolved while compiling, and the compiled day is dropped at
+ * local midnight. Local time follows the TZ rules of the process, so windows keep their wall-clock times
+ * across DST changes: a window inside the skipped hour never opens that day, one inside the repeated hour
+ * opens twice.
+ *
+ * Rules are edited directly in the database; Refresh() picks up committed changes without a restart.
+*/
+class AccessSchedule
+{
+public:
+	using DayWindows = std::bitset<24 * 60>;
+
+	/**
+	 * @brief Tables read by AccessSchedule, created by DatabaseObject when missing
+	 *
+	 * AccessRules: EmployeeId and DoorId NULL for all, Weekdays as the bit mask of `AccessRule`, StartTime and
+	 * EndTime as `HH:MM`, ValidFrom and ValidUntil as `YYYY-MM-DD` or NULL, OnHolidays 0 or 1.
+	 * Holidays: Date as `YYYY-MM-DD`.
+	*/
+	static const char* const CREATE_TABLES;
+
+	/// How often Refresh() asks the database whether anything changed
+	static constexpr std::chrono::milliseconds RELOAD_INTERVAL = std::chrono::milliseconds(1000);
+
+	/// Opens `databasePath` read-only and loads the rules
+	AccessSchedule(const std::string& databasePath, ILogger* pLogger = NulLogger::getInstance());
+	~AccessSchedule();
+
+	AccessSchedule(const AccessSchedule&) = delete;
+	AccessSchedule& operator=(const AccessSchedule&) = delete;
+
+	/// Reloads the rules if another connection committed since the last load, checked at most once per RELOAD_INTERVAL
+	void Refresh();
+
+	/// Reloads the rules unconditionally. Returns false, keeping the previous rules, if they cannot be read.
+	bool Reload();
+
+	/// Replaces the rules and holidays (days since 1970-01-01)
+	void setRules(const std::vector<AccessRule>& rules, const std::vector<int32_t>& holidays);
+
+	/// True if employee `employeeId` may pass door `doorId` at `now`
+	bool isAllowed(unsigned int employeeId, DoorId doorId, time_t now);
+
+	/// Number of rules loaded
+	size_t getRuleCount() const { return m_rules.size(); }
+
+	/// Days since 1970-01-01 of a proleptic Gregorian date
+	static int32_t DayNumber(int year, unsigned int month, unsigned int day);
+	/// Parses `YYYY-MM-DD`
+	static bool ParseDate(const std::string& text, int32_t& day);
+	/// Parses `HH:MM`, 00:00 to 24:00
+	static bool ParseTime(const std::string& text, uint16_t& minutes);
+
+private:
+	static uint64_t key(unsigned int employeeId, DoorId doorId) { return (static_cast<uint64_t>(employeeId) << 16) | doorId; }
+
+	/// Rule group of (employee, door), falling back to (employee, every door); nullptr if the employee is not restricted there
+	const std::vector<size_t>* findGroup(unsigned int employeeId, DoorId doorId) const;
+	bool isOpen(const std::vector<size_t>& group, unsigned int minute);
+	bool opensOn(const AccessRule& rule, int32_t day, unsigned int weekday) const;
+	bool readDataVersion(int64_t& dataVersion);
+
+	std::string m_databasePath;
+	ILogger* m_pLogger;
+
+	sqlite3* m_pDatabase;
+	int64_t m_dataVersion;
+	std::chrono::steady_clock::time_point m_lastCheck;
+
+	std::vector<AccessRule> m_rules;
+	std::unordered_set<int32_t> m_holidays;
+	/// Indices into m_rules by key(employee, door); door NO_DOOR holds the rules for every door
+	std::unordered_map<uint64_t, std::vector<size_t>> m_groups;
+
+	/// Compiled windows of m_day, by the address of their group
+	std::unordered_map<const std::vector<size_t>*, DayWindows> m_compiled;
+	int32_t m_day;
+	unsigned int m_weekday;
+};
+
+#endif
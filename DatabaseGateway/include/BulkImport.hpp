@@ -0,0 +1,152 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef BULK_IMPORT_HPP
+#define BULK_IMPORT_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "DataMailbox.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+/// One employee with the complete set of credentials they should have after an import
+struct ImportedEmployee
+{
+	std::string m_name;
+	Clearance m_clearance = 0;
+	/// At most one, `RFIDCardTable` allows a single card per owner
+	std::vector<std::string> m_cards;
+	std::vector<std::string> m_pins;
+};
+
+/**
+ * @brief Import batches handed from WebAPIController to DatabaseGateway as files
+ *
+ * A batch of 10k employees does not fit into a DataMailbox message, so WebAPIController validates it,
+ * writes it next to the database as `<DB_PATH>.<name>` and sends only the name with the IMPORT command.
+ * One line per record, fields separated by tabs: `E name clearance`, followed by `C uuid` and `P pin`
+ * lines of that employee.
+*/
+class ImportSpool
+{
+public:
+	/// Largest batch accepted, keeps the in-memory copy of a batch bounded
+	static const size_t MAX_EMPLOYEES = 100000;
+
+	/// Checks names, clearances and credential formats, and that no name, card or PIN appears twice
+	static bool Validate(const std::vector<ImportedEmployee>& employees, std::string& error);
+
+	/// New unique spool name for this process, `import.<pid>.<counter>`
+	static std::string CreateName();
+	/// True for names made by CreateName(): the gateway never opens anything else
+	static bool isValidName(const std::string& name);
+	static std::string getPath(const std::string& databasePath, const std::string& name);
+
+	/// Writes `employees` to a new file (never overwrites, owner-only permissions)
+	static bool Write(const std::string& path, const std::vector<ImportedEmployee>& employees, std::string& error);
+	/// Reads and validates a spool file
+	static bool Read(const std::string& path, std::vector<ImportedEmployee>& employees, std::string& error);
+};
+
+/**
+ * @brief Commits import batches in one transaction each, on its own connection and thread
+ *
+ * The transaction holds `DatabaseObject::getWriteLock()`, so it is serialized with the gateway's other
+ * writes, while authorization keeps reading on the gateway's connection: in WAL mode readers see the
+ * last committed state and are never blocked by the import. Only changed rows are written, re-importing
+ * the same batch costs one read of the credential tables.
+ *
+ * Import semantics: employees are matched by name and created if missing, their clearance is set, and
+ * their cards and PINs become exactly the listed ones - a listed credential owned by someone else is
+ * moved to them. Employees not in the batch are left untouched. Any failure rolls the whole batch back.
+*/
+class BulkImporter
+{
+public:
+	BulkImporter(const std::string& databasePath, std::mutex& writeLock, ILogger* pLogger = NulLogger::getInstance());
+	~BulkImporter();
+
+	BulkImporter(const BulkImporter&) = delete;
+	BulkImporter& operator=(const BulkImporter&) = delete;
+
+	/// Starts the worker thread, which replies to finished imports from DataMailbox `replyMailboxName`
+	void Start(const std::string& replyMailboxName);
+
+	/**
+	 * @brief Queues the import of spool `spoolPath` and returns. The spool file is removed afterwards.
+	 * @param request IMPORT request, answered with DatabaseReply SUCCESS or ERROR once the batch is committed or rolled back
+	*/
+	void Submit(const std::string& spoolPath, CommandMessage& request);
+
+	/// Imports `employees` on the calling thread. Returns false with `error` set if nothing was changed.
+	bool Import(const std::vector<ImportedEmployee>& employees, std::string& error);
+
+	/**
+	 * @brief Reads every employee with their cards and PINs, ordered by employee ID, in one read transaction
+	 * @param pDatabase Connection to read from, may be read-only
+	*/
+	static bool Export(sqlite3* pDatabase, std::vector<ImportedEmployee>& employees, std::string& error);
+
+private:
+	struct Job
+	{
+		std::string m_spoolPath;
+		MailboxReference m_replyTo;
+		DoorId m_doorId;
+		RequestId m_requestId;
+		LatencyTrace m_trace;
+	};
+
+	void workerThreadFunction();
+	void process(Job& job);
+	bool importOn(sqlite3* pDatabase, const std::vector<ImportedEmployee>& employees, std::string& error);
+
+	/// Lock waits of the gateway's own connection are short, see Database
+	static const int BUSY_TIMEOUT_MS = 5000;
+
+	std::string m_databasePath;
+	std::mutex& m_writeLock;
+	ILogger* m_pLogger;
+
+	std::unique_ptr<DataMailbox> m_pReplyMailbox;
+	std::thread m_worker;
+	std::mutex m_jobsLock;
+	std::condition_variable m_jobsChanged;
+	std::deque<Job> m_jobs;
+	bool m_stop = false;
+
+	MetricHistogram m_importLatency;
+	MetricCounter m_importedEmployees;
+};
+
+#endif
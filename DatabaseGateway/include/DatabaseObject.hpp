@@ -25,13 +25,19 @@
 #ifndef DATABASE_OBJECT_HPP
 #define DATABASE_OBJECT_HPP
 
+#include<chrono>
+
 #include"Tables.hpp"
+#include"AccessSchedule.hpp"
 
 #include"Logger.hpp"
 #include"DataMailbox.hpp"
 #include"Time.hpp"
 
 class DatabaseObject;
+class BulkImporter;
+class AccessGuard;
+class LogJournal;
 
 /// Contains all the resources used by DatabaseRequests to execute requests
 struct DatabaseResources
@@ -40,10 +46,12 @@ struct DatabaseResources
 	DatabaseObject* m_pDatabaseObject;
 	/// Outgoing Mailbox pointer
 	DataMailbox* m_pMailbox;
-	/// Pointer to SimplifiedMailbox used to send Request log data to logging thread
-	SimplifiedMailbox* m_pLogMailbox;
-	/// MailboxReference to logging thread mailbox
-	MailboxReference& m_refLogThread;
+	/// Journal request logs are appended to, the logging thread writes them to the log table
+	LogJournal* m_pLogJournal;
+	/// Worker which commits bulk imports next to the request loop
+	BulkImporter* m_pBulkImporter;
+	/// Rate limits and anti-passback checked before every authorization
+	AccessGuard* m_pAccessGuard;
 };
 
 /// Class which bundles SQL statments (SQL statement wrapper methods specifically) into coherent methods
@@ -73,6 +81,15 @@ public:
 	*/
 	Clearance getClearance(const InputParameter& authorizationParameter);
 
+	/**
+	 * @brief Clearance of the employee at door `doorId` right now
+	 * @param authorizationParameter InputParameter which contains authorization type (Card, PIN) and authorization data
+	 * @param doorId Door the employee wants to pass
+	 * @param pKnown [optional] set to whether the credential belongs to an employee, whatever their schedule
+	 * @return Same as getClearance(), but NO_CLEARANCE outside the time windows of the employee's and the door's AccessSchedule rules
+	*/
+	Clearance getClearanceAtDoor(const InputParameter& authorizationParameter, DoorId doorId, bool* pKnown = nullptr);
+
 	/**
 	 * @brief Adds authorization identifier `parameterToAdd` (Card, PIN, ...) as a guest employee
 	 * @param parameterToAdd InputParameter which contains authorization type (Card, PIN, ...) and authorization data to be added
@@ -100,15 +117,19 @@ public:
 	/**
 	 * @brief Creates Log which includes: timestamp, executed `command` by employee identified with `userCredentials`
 	 * 
-	 * It creates the log object and passes it to the logging thread (connectionless), \n
-	 * then the logging thread takes the log object, whenever it does, and inserts it into database log table.
+	 * It appends the log to the LogJournal and returns, \n
+	 * then the logging thread takes the log from the journal, whenever it does, and inserts it into database log table. \n
+	 * If the journal stays full for LOG_JOURNAL_FULL_WAIT_MS the log is inserted right away instead, so no log is lost.
 	 * 
 	 * @param command requested CommandMessage::enuCommand to be executed
 	 * @param userCredentials InputParameter which contains authorization type (Card, PIN, ...) and authorization data of an employee who requested to execute `command`
 	*/
 	void CreateLog(CommandMessage::enuCommand command, const InputParameter& userCredentials);
 
-	/// Creates database log table entry based on `logEntry` object. Used by logging thread to write logs to database log table
+	/// Like `CreateLog(AUTHENTICATE, ...)` for an authorization MainApplication decided from its offline cache at `timestamp`; the authorization method is marked "offline"
+	void CreateOfflineLog(const InputParameter& userCredentials, const std::string& timestamp);
+
+	/// Creates database log table entry based on `logEntry` object right away. Used when the log journal is full
 	void WriteLogToLogTable(LogEntry& logEntry);
 
 	/**
@@ -133,6 +154,8 @@ private:
 
 	Database m_database;
 
+	std::chrono::milliseconds m_logJournalFullWait;
+
 	bool m_initialized = false;
 
 	//************* DATABASE TABLES
@@ -144,6 +167,8 @@ private:
 	WebAPITable* m_pWebAPITable = nullptr;
 	LogTable* m_pLogTable = nullptr;
 
+	AccessSchedule* m_pAccessSchedule = nullptr;
+
 	//************* INIT METHODS
 	
 	void initialize();
@@ -162,9 +187,12 @@ private:
 
 	LogEntry parseInputParameterToLogEntry(const InputParameter& param);
 
+	void journalLog(LogEntry& logEntry);
+
 	Clearance getClearanceFromPassword(const std::string& password);
 	Clearance getClearanceFromName(const std::string& name);
 	Clearance getClearanceFromRFIDCard(const std::string& uuid);
+	Clearance getClearanceFromWebPass(const std::string& hash);
 
 	unsigned int getUserIdFromPassword(const std::string& password);
 	unsigned int getUserIdFromRFIDCard(const std::string& uuid);
@@ -26,6 +26,7 @@
 #define DATABASE_REQUEST_HPP
 
 #include "DatabaseObject.hpp"
+#include "BulkImport.hpp"
 
 class IDatabaseRequest;
 
@@ -79,6 +80,8 @@ protected:
 
 	/// Sends DatabaseReply with `errorStatus` to request source
 	void ReplyToRequestSource(DatabaseReply::enuStatus errorStatus);
+	/// Sends `reply` to request source, tagged with the door, ID and latency trace of the request
+	void SendReply(DatabaseReply& reply);
 
 
 	//***** FUNCTIONS WHICH MUST BE OVERLOADED IN CHILD CLASSES ******
@@ -187,6 +190,42 @@ private:
 
 };
 
+/// Parameters: spool name (PlainData, see ImportSpool) and the requesting web API key (WebPass). Committed by BulkImporter, which replies.
+class ImportRequest : public IDatabaseRequest
+{
+public:
+	ImportRequest(CommandMessage** ppRequestMessage, DatabaseResources& resources, ILogger* pLogger = NulLogger::getInstance())
+		: IDatabaseRequest(ppRequestMessage, resources, pLogger)
+	{}
+
+	virtual ~ImportRequest() {}
+
+private:
+
+	virtual bool Validate() override;
+	virtual bool Authorize() override;
+	virtual void Execute() override;
+	virtual void Log() override;
+
+};
 
+/// Parameters: credential (KeypadPIN or RFIDCard) and the time MainApplication decided it from its offline cache (PlainData, see `isValidTimestamp`). Only logged; a valid request is not replied to.
+class OfflineLogRequest : public IDatabaseRequest
+{
+public:
+	OfflineLogRequest(CommandMessage** ppRequestMessage, DatabaseResources& resources, ILogger* pLogger = NulLogger::getInstance())
+		: IDatabaseRequest(ppRequestMessage, resources, pLogger)
+	{}
+
+	virtual ~OfflineLogRequest() {}
+
+private:
+
+	virtual bool Validate() override;
+	virtual bool Authorize() override;
+	virtual void Execute() override;
+	virtual void Log() override;
+
+};
 
 #endif
\ No newline at end of file
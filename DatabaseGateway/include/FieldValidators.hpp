@@ -0,0 +1,181 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef FIELD_VALIDATORS_HPP
+#define FIELD_VALIDATORS_HPP
+
+#include <string>
+#include <cstddef>
+
+/**
+ * @brief Compile-time composed field validators used instead of `std::regex`.
+ *
+ * Every validator is a type with a static `match(const char*& it, const char* end)`
+ * function which consumes characters from `it` and returns false on mismatch.
+ * `FullMatch<Pattern>::test(str)` is the equivalent of `std::regex_match(str, Pattern)`.
+ *
+ * Repetitions are greedy and never backtrack, so adjacent parts of a `Sequence`
+ * must not accept the same characters (true for all field formats below).
+ */
+namespace FieldValidators
+{
+	/// Character class [0-9]
+	struct Digit
+	{
+		static bool test(char c) { return c >= '0' && c <= '9'; }
+	};
+
+	/// Character class [a-zA-Z0-9]
+	struct Alnum
+	{
+		static bool test(char c) { return Digit::test(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+	};
+
+	/// Character class [0-9a-fA-F]
+	struct HexDigit
+	{
+		static bool test(char c) { return Digit::test(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+	};
+
+	/// Character class of literal characters, e.g. `OneOf<'+', '-'>` is [+-]
+	template<char... Cs> struct OneOf;
+
+	template<> struct OneOf<>
+	{
+		static bool test(char) { return false; }
+	};
+
+	template<char C, char... Cs> struct OneOf<C, Cs...>
+	{
+		static bool test(char c) { return c == C || OneOf<Cs...>::test(c); }
+	};
+
+	/// Union of character classes, e.g. `AnyOf<Alnum, OneOf<' '>>` is [a-zA-Z0-9 ]
+	template<class... Classes> struct AnyOf;
+
+	template<> struct AnyOf<>
+	{
+		static bool test(char) { return false; }
+	};
+
+	template<class Class, class... Classes> struct AnyOf<Class, Classes...>
+	{
+		static bool test(char c) { return Class::test(c) || AnyOf<Classes...>::test(c); }
+	};
+
+	/// Character class repeated between `Min` and `Max` [inclusive] times, e.g. `Run<Digit, 4, 10>` is [0-9]{4,10}
+	template<class Class, size_t Min, size_t Max = Min> struct Run
+	{
+		static bool match(const char*& it, const char* end)
+		{
+			size_t count = 0;
+			while (count < Max && it != end && Class::test(*it))
+			{
+				++it;
+				++count;
+			}
+
+			return count >= Min;
+		}
+	};
+
+	/// Parts matched one after another, e.g. `Sequence<Run<Alnum, 2>, Run<OneOf<'-'>, 1>>` is [a-zA-Z0-9]{2}-
+	template<class... Parts> struct Sequence;
+
+	template<> struct Sequence<>
+	{
+		static bool match(const char*&, const char*) { return true; }
+	};
+
+	template<class Part, class... Parts> struct Sequence<Part, Parts...>
+	{
+		static bool match(const char*& it, const char* end)
+		{
+			return Part::match(it, end) && Sequence<Parts...>::match(it, end);
+		}
+	};
+
+	/// Group repeated exactly `Count` times, e.g. `Repeat<Group, 3>` is (Group){3}
+	template<class Part, size_t Count> struct Repeat
+	{
+		static bool match(const char*& it, const char* end)
+		{
+			for (size_t i = 0; i < Count; ++i)
+			{
+				if (Part::match(it, end) == false) return false;
+			}
+
+			return true;
+		}
+	};
+
+	/// Optional character, e.g. `Optional<OneOf<'+', '-'>>` is [+-]?
+	template<class Class> using Optional = Run<Class, 0, 1>;
+
+	/// Anchored match of the whole string against `Pattern`
+	template<class Pattern> struct FullMatch
+	{
+		static bool test(const char* begin, const char* end)
+		{
+			const char* it = begin;
+			return Pattern::match(it, end) && it == end;
+		}
+
+		static bool test(const std::string& str)
+		{
+			return test(str.data(), str.data() + str.size());
+		}
+	};
+
+
+
+	/// ([a-zA-Z0-9]{2}-){3}[a-zA-Z0-9]{2}
+	using CardUUID = FullMatch<Sequence<
+		Repeat<Sequence<Run<Alnum, 2>, Run<OneOf<'-'>, 1>>, 3>,
+		Run<Alnum, 2>
+	>>;
+
+	/// [0-9]{4,10}
+	using KeypadPassword = FullMatch<Run<Digit, 4, 10>>;
+
+	/// [a-zA-Z0-9 .\-+]{0,64}
+	using PlainData = FullMatch<Run<AnyOf<Alnum, OneOf<' ', '.', '-', '+'>>, 0, 64>>;
+
+	/// [+-]?[0-9]{1,10}
+	using SignedNumber = FullMatch<Sequence<Optional<OneOf<'+', '-'>>, Run<Digit, 1, 10>>>;
+
+	/// [0-9a-fA-F]{64} (SHA-256 of a web API key)
+	using WebPassHash = FullMatch<Run<HexDigit, 64>>;
+
+	/// [a-zA-Z0-9 .\-+_]{1,64} (employee name)
+	using EmployeeName = FullMatch<Run<AnyOf<Alnum, OneOf<' ', '.', '-', '+', '_'>>, 1, 64>>;
+
+	/// [0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}\.[0-9]{3} (Time::getDateTime_ISO8601)
+	using Timestamp = FullMatch<Sequence<
+		Run<Digit, 4>, Run<OneOf<'-'>, 1>, Run<Digit, 2>, Run<OneOf<'-'>, 1>, Run<Digit, 2>, Run<OneOf<' '>, 1>,
+		Run<Digit, 2>, Run<OneOf<':'>, 1>, Run<Digit, 2>, Run<OneOf<':'>, 1>, Run<Digit, 2>, Run<OneOf<'.'>, 1>, Run<Digit, 3>
+	>>;
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef LOG_JOURNAL_HPP
+#define LOG_JOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "ILogger.hpp"
+#include "NulLogger.hpp"
+#include "Metrics.hpp"
+
+/// One journaled access log, the fields of `LogEntry` (Tables.hpp cannot be included here, its definitions already are in DatabaseObject)
+struct JournaledLog
+{
+	uint64_t m_sequence = 0;
+	std::string m_timestamp;
+	unsigned int m_userId = 0;
+	std::string m_authMethod;
+	unsigned int m_commandId = 0;
+};
+
+/**
+ * @brief Append-only journal of access logs in a memory-mapped file, written before the logs reach LogTable
+ *
+ * The file is a header followed by a ring of records. Every record is `length, CRC32, payload`, the payload
+ * starts with a sequence number which grows by one per record. The header keeps the offset and sequence number
+ * of the oldest record not yet in LogTable twice, updated alternately and each with its own CRC, so a process
+ * killed while committing leaves one valid copy.
+ *
+ * On open the records are recovered from the head for as long as the CRC matches and the sequence number is the
+ * expected one, so a record torn by a crash and everything older than the head is ignored. Every open starts a new
+ * generation, which is stored in the records, so records left behind a torn one are not taken for newer ones. The mapping is shared,
+ * a record copied into it survives the process being killed; surviving a power loss depends on the kernel
+ * writing the page cache back in time (no msync per record, that would cost a disk write per authorization).
+ *
+ * Thread-safe: request threads append, one replay thread reads and commits.
+*/
+class LogJournal
+{
+public:
+	typedef enum
+	{
+		APPENDED = 0,
+		/// No space freed within the wait passed to Append(), or the record is larger than the journal
+		FULL
+	} enuAppendResult;
+
+	/**
+	 * @brief Opens or creates journal `path` and recovers its records
+	 * @param capacity Bytes of records a new journal holds. An existing journal keeps its size until it is empty.
+	*/
+	LogJournal(const std::string& path, size_t capacity, ILogger* pLogger = NulLogger::getInstance());
+	~LogJournal();
+
+	LogJournal(const LogJournal&) = delete;
+	LogJournal& operator=(const LogJournal&) = delete;
+
+	/**
+	 * @brief Copies a log into the journal and wakes the replay thread
+	 * @param wait How long to wait for ReplayBatch() to free space if the journal is full
+	*/
+	enuAppendResult Append(const std::string& timestamp, unsigned int userId, const std::string& authMethod, unsigned int commandId, std::chrono::milliseconds wait);
+
+	/**
+	 * @brief Copies up to `maxCount` of the oldest records to `logs`, waiting up to `wait` for the first one
+	 * Records stay in the journal until Commit(), reading again returns the same records.
+	*/
+	size_t Read(std::vector<JournaledLog>& logs, size_t maxCount, std::chrono::milliseconds wait);
+
+	/// Drops every record up to and including `sequence`; an emptied journal starts again at the beginning of the file
+	void Commit(uint64_t sequence);
+
+	/// Random identifier chosen when the file was created, tells a replaced journal from the one a commit was recorded for
+	uint64_t getId() const { return m_id; }
+	/// Sequence number of the oldest record, or of the next record appended to an empty journal
+	uint64_t getHeadSequence() const;
+	size_t getCount() const;
+	size_t getCapacity() const { return m_capacity; }
+
+private:
+	bool open(size_t capacity);
+	bool create(size_t capacity);
+	void recover();
+	void writeHead();
+
+	/// Size of a record with the given strings in the ring, records are 8 byte aligned
+	static size_t recordSize(size_t timestampSize, size_t methodSize);
+	/// Offset of the record at `offset`, or of the beginning of the ring if the writer wrapped there
+	size_t skipWrap(size_t offset) const;
+	/**
+	 * @brief Decodes the record at `offset`
+	 * @param generation Oldest generation accepted, set to the record's generation
+	 * @return false if the record is torn, corrupted, older than `generation` or its sequence number is not `sequence`
+	*/
+	bool decode(size_t offset, uint64_t sequence, JournaledLog* pLog, size_t& size, uint32_t& generation) const;
+	bool fits(size_t size, size_t& offset) const;
+
+	std::string m_path;
+	ILogger* m_pLogger;
+
+	int m_fd = -1;
+	char* m_pMapping = nullptr;
+	size_t m_mappingSize = 0;
+	char* m_pRing = nullptr;
+	size_t m_capacity = 0;
+	uint64_t m_id = 0;
+	uint32_t m_generation = 1;
+
+	mutable std::mutex m_lock;
+	std::condition_variable m_appended;
+	std::condition_variable m_committed;
+
+	size_t m_head = 0;
+	size_t m_tail = 0;
+	size_t m_count = 0;
+	uint64_t m_headSequence = 1;
+	/// Header copy written by the next writeHead()
+	unsigned int m_nextHeadSlot = 0;
+
+	MetricGauge m_records;
+	MetricCounter m_full;
+};
+
+/**
+ * @brief Writes journaled logs to LogTable in batches, each exactly once
+ *
+ * Runs on its own connection like BulkImporter and holds `DatabaseObject::getWriteLock()` for every batch.
+ * A batch is inserted together with the sequence number of its last record into `LogJournalCommit` in one
+ * transaction and only then committed in the journal. If the process dies in between, the records are found
+ * in the journal again on restart and skipped because `LogJournalCommit` already has them.
+ *
+ * A batch which fails `MAX_BATCH_ATTEMPTS` times because the log table rejects one of its records (constraint,
+ * type mismatch, too big) is written again one record at a time; the rejected record is logged in full and dropped
+ * from the journal, so it does not hold back every log behind it. Failures of the database itself (busy, locked,
+ * full, I/O) never drop a record, the logs stay journaled until it recovers.
+*/
+class LogJournalReplay
+{
+public:
+	/// Last sequence number of journal `JournalId` written to LogTable, a single row
+	static const char* const CREATE_TABLES;
+
+	LogJournalReplay(LogJournal& journal, const std::string& databasePath, std::mutex& writeLock, ILogger* pLogger = NulLogger::getInstance());
+	~LogJournalReplay();
+
+	LogJournalReplay(const LogJournalReplay&) = delete;
+	LogJournalReplay& operator=(const LogJournalReplay&) = delete;
+
+	/// Failed writes of the same logs before a record the log table rejects is looked for and skipped
+	static const unsigned int MAX_BATCH_ATTEMPTS = 5;
+
+	/**
+	 * @brief Writes up to `maxCount` journaled logs to LogTable, waiting up to `wait` for the first one
+	 * @return Number of logs written; 0 on timeout, if the transaction failed (the logs stay journaled) or a rejected log was skipped
+	*/
+	size_t ReplayBatch(size_t maxCount, std::chrono::milliseconds wait);
+
+private:
+	bool prepare();
+	/// On failure the transaction is rolled back and the error is kept in m_lastError and m_lastErrorMessage
+	bool writeBatch(const std::vector<JournaledLog>& logs);
+	/// Drops `log` from the journal, its fields go to the log file
+	void skipRejected(const JournaledLog& log);
+	/// True for errors caused by the logs written rather than by the state of the database
+	static bool isRejection(int error);
+
+	/// Lock waits of the gateway's own connection are short, see Database
+	static const int BUSY_TIMEOUT_MS = 5000;
+
+	LogJournal& m_journal;
+	std::string m_databasePath;
+	std::mutex& m_writeLock;
+	ILogger* m_pLogger;
+
+	sqlite3* m_pDatabase = nullptr;
+	sqlite3_stmt* m_pInsertLog = nullptr;
+	sqlite3_stmt* m_pSetCommitted = nullptr;
+	/// Records of this journal up to here are in LogTable already
+	uint64_t m_committedSequence = 0;
+
+	int m_lastError = SQLITE_OK;
+	std::string m_lastErrorMessage;
+	/// Consecutive failed writes of the oldest logs
+	unsigned int m_failedAttempts = 0;
+	/// Logs up to here belong to a batch the log table rejected, they are written one at a time
+	uint64_t m_suspectSequence = 0;
+
+	std::vector<JournaledLog> m_batch;
+	MetricHistogram m_writeLatency;
+	MetricCounter m_rejected;
+};
+
+#endif
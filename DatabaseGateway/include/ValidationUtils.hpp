@@ -26,7 +26,7 @@
 #define VALIDATION_UTILS_HPP
 
 #include"DataMailbox.hpp"
-#include<regex>
+#include"FieldValidators.hpp"
 
 Clearance destringifyClearance(const std::string& sClearance);
 bool isValidClearance(Clearance clearance);
@@ -34,6 +34,8 @@ bool isValidCardUUID(const CardUUID& uuid);
 bool isValidKeypadPassword(const KeyPass& password);
 bool isValidPlainData(const std::string& data);
 bool isValidSignedNumber(const std::string& data);
+bool isValidWebPassHash(const std::string& hash);
+bool isValidTimestamp(const std::string& data);
 bool isParameterDataValid(const InputParameter& param);
 
 // inclusive
@@ -96,30 +98,20 @@ bool isValidClearance(Clearance clearance)
 /// Card UUID is valid if it is in form of "XX-XX-XX-XX" where X is hex numeral
 bool isValidCardUUID(const CardUUID& uuid)
 {
-	std::regex mask("([a-zA-Z0-9]{2}-){3}[a-zA-Z0-9]{2}");
-
-	bool valid = std::regex_match(uuid, mask);
-
-	return valid;
+	return FieldValidators::CardUUID::test(uuid);
 }
 
 /// Password is valid if it consists of 4 to 10 [inclusive] numerals (0-9)
 bool isValidKeypadPassword(const KeyPass& password)
 {
-	std::regex mask("[0-9]{4,10}");
-
-	bool valid = std::regex_match(password, mask);
-
-	return valid;
+	return FieldValidators::KeypadPassword::test(password);
 }
 
 /// Plain data is valid if it contains between 0 and 64 [inclusive] letters, dots, spaces, minus signs and/or plus signs
 bool isValidPlainData(const std::string& data)
 {
 	// TODO Max length, TODO add anchors?, TODO space?
-	std::regex mask("[a-zA-Z0-9 \\.\\-\\+]{0,64}");
-
-	bool valid = std::regex_match(data, mask);
+	bool valid = FieldValidators::PlainData::test(data);
 
 	return true;
 }
@@ -127,11 +119,19 @@ bool isValidPlainData(const std::string& data)
 /// Signed number is valid if it consists of 1 to 10 [inclusive] numerals and optional +/- sign at the beginning
 bool isValidSignedNumber(const std::string& data)
 {
-	std::regex mask("(\\-|\\+)?[0-9]{1,10}");
+	return FieldValidators::SignedNumber::test(data);
+}
 
-	bool valid = std::regex_match(data, mask);
+/// Web pass hash is valid if it is a SHA-256 digest written as 64 hex numerals
+bool isValidWebPassHash(const std::string& hash)
+{
+	return FieldValidators::WebPassHash::test(hash);
+}
 
-	return valid;
+/// Timestamp is valid if it has the "YYYY-MM-DD HH:MM:SS.mmm" form used in the log table
+bool isValidTimestamp(const std::string& data)
+{
+	return FieldValidators::Timestamp::test(data);
 }
 
 /// Returns true if data carried by InputParameter is valid
@@ -155,6 +155,9 @@ bool isParameterDataValid(const InputParameter& param)
 
 	case InputParameter::enuType::PlainData:
 		return isValidPlainData(param.getData());
+
+	case InputParameter::enuType::WebPass:
+		return isValidWebPassHash(param.getData());
 	}
 
 	return false;
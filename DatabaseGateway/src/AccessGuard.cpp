@@ -0,0 +1,395 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessGuard.hpp"
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+const char* const AccessGuard::CREATE_TABLES =
+	"CREATE TABLE IF NOT EXISTS AccessLockouts ("
+	"Scope INTEGER NOT NULL, "
+	"Key INTEGER NOT NULL, "
+	"Until INTEGER NOT NULL, "
+	"PRIMARY KEY (Scope, Key));";
+
+const size_t AccessGuard::SWEEP_THRESHOLD;
+
+namespace
+{
+	/// Lockouts are rare, waiting for the gateway's own writes is cheaper than losing one
+	const int BUSY_TIMEOUT_MS = 1000;
+
+	const size_t KEY_SIZE = 32;
+}
+
+AccessGuard::AccessGuard(const Limits& limits, const std::string& databasePath, ILogger* pLogger)
+	: m_limits(limits), m_databasePath(databasePath), m_pLogger(pLogger), m_pDatabase(nullptr), m_nextSweep(SWEEP_THRESHOLD)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	if (m_databasePath.empty())
+	{
+		std::string key(KEY_SIZE, '\0');
+		if (getrandom(&key[0], KEY_SIZE, 0) != static_cast<ssize_t>(KEY_SIZE))
+		{
+			Kernel::Fatal_Error("AccessGuard -- getrandom failed");
+		}
+		m_key = Sha256::HmacKey(key);
+		return;
+	}
+
+	// Kept outside the database, persisted credential lockouts cannot be matched without it
+	if (!loadKey(m_databasePath + ".key"))
+	{
+		*m_pLogger << "AccessGuard -- cannot use key file " + m_databasePath + ".key";
+		Kernel::Fatal_Error("AccessGuard -- cannot use key file " + m_databasePath + ".key");
+	}
+
+	// Own connection, so persisting a lockout never disturbs a query prepared by DatabaseObject
+	if (sqlite3_open_v2(m_databasePath.c_str(), &m_pDatabase, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+	{
+		*m_pLogger << "AccessGuard -- cannot open " + m_databasePath;
+		Kernel::Fatal_Error("AccessGuard -- cannot open " + m_databasePath);
+	}
+	sqlite3_busy_timeout(m_pDatabase, BUSY_TIMEOUT_MS);
+
+	if (sqlite3_exec(m_pDatabase, CREATE_TABLES, nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		*m_pLogger << "AccessGuard -- cannot create the lockout table in " + m_databasePath;
+		Kernel::Fatal_Error("AccessGuard -- cannot create the lockout table in " + m_databasePath);
+	}
+
+	loadLockouts();
+}
+
+AccessGuard::~AccessGuard()
+{
+	sqlite3_close(m_pDatabase);
+}
+
+void AccessGuard::loadLockouts()
+{
+	sqlite3_stmt* pStatement = nullptr;
+	bool loaded = sqlite3_prepare_v2(m_pDatabase, "SELECT Scope, Key, Until FROM AccessLockouts;", -1, &pStatement, nullptr) == SQLITE_OK;
+
+	int status = SQLITE_DONE;
+	while (loaded && (status = sqlite3_step(pStatement)) == SQLITE_ROW)
+	{
+		const int scope = sqlite3_column_int(pStatement, 0);
+		const uint64_t key = static_cast<uint64_t>(sqlite3_column_int64(pStatement, 1));
+		const int64_t until_ms = sqlite3_column_int64(pStatement, 2);
+
+		if (scope == SCOPE_CREDENTIAL)
+		{
+			m_credentials[key].m_lockedUntil_ms = until_ms;
+		}
+		else if (scope == SCOPE_DOOR_INPUT)
+		{
+			m_inputs[key].m_lockedUntil_ms = until_ms;
+		}
+	}
+	sqlite3_finalize(pStatement);
+
+	// Starting without them would lift every lockout with a restart
+	if (!loaded || status != SQLITE_DONE)
+	{
+		*m_pLogger << "AccessGuard -- cannot read the lockouts of " + m_databasePath;
+		Kernel::Fatal_Error("AccessGuard -- cannot read the lockouts of " + m_databasePath);
+	}
+
+	*m_pLogger << "AccessGuard -- loaded " + std::to_string(getTrackedCount()) + " lockouts";
+}
+
+AccessGuard::enuVerdict AccessGuard::Admit(const InputParameter& credential, DoorId doorId, int64_t now_ms)
+{
+	if (getTrackedCount() >= m_nextSweep)
+	{
+		sweep(now_ms);
+	}
+
+	auto itInput = m_inputs.find(inputKey(doorId, credential.getType()));
+	if (itInput != m_inputs.end() && itInput->second.m_lockedUntil_ms > now_ms)
+	{
+		return DOOR_LOCKED;
+	}
+
+	const uint64_t key = credentialKey(credential);
+	CredentialState* pState = nullptr;
+	if (m_limits.m_credentialMaxAttempts != 0 || m_limits.m_antiPassback_ms != 0)
+	{
+		pState = &m_credentials[key];
+	}
+	else
+	{
+		auto itCredential = m_credentials.find(key);
+		if (itCredential == m_credentials.end())
+		{
+			return ALLOWED;
+		}
+		pState = &itCredential->second;
+	}
+
+	if (pState->m_lockedUntil_ms > now_ms)
+	{
+		return CREDENTIAL_LOCKED;
+	}
+
+	if (addToWindow(pState->m_attempts, m_limits.m_credentialMaxAttempts, m_limits.m_credentialWindow_ms, now_ms) == false)
+	{
+		pState->m_lockedUntil_ms = now_ms + m_limits.m_lockout_ms;
+		pState->m_attempts = Window();
+		lockOut(SCOPE_CREDENTIAL, key, pState->m_lockedUntil_ms, now_ms);
+		return CREDENTIAL_LOCKED;
+	}
+
+	if (m_limits.m_antiPassback_ms != 0 && pState->m_lastDoor != doorId && pState->m_lastGrant_ms > now_ms - m_limits.m_antiPassback_ms)
+	{
+		return PASSBACK;
+	}
+
+	return ALLOWED;
+}
+
+void AccessGuard::Record(const InputParameter& credential, DoorId doorId, enuOutcome outcome, int64_t now_ms)
+{
+	if (outcome == GRANTED)
+	{
+		if (m_limits.m_antiPassback_ms != 0)
+		{
+			CredentialState& state = m_credentials[credentialKey(credential)];
+			state.m_lastGrant_ms = now_ms;
+			state.m_lastDoor = doorId;
+		}
+		return;
+	}
+
+	// A valid card used out of hours is no guess, counting it would lock the input for everyone else
+	if (outcome != UNKNOWN_CREDENTIAL || m_limits.m_doorMaxFailures == 0)
+	{
+		return;
+	}
+
+	const uint64_t key = inputKey(doorId, credential.getType());
+	InputState& input = m_inputs[key];
+	if (addToWindow(input.m_failures, m_limits.m_doorMaxFailures, m_limits.m_doorWindow_ms, now_ms) == false)
+	{
+		input.m_lockedUntil_ms = now_ms + m_limits.m_lockout_ms;
+		input.m_failures = Window();
+		lockOut(SCOPE_DOOR_INPUT, key, input.m_lockedUntil_ms, now_ms);
+	}
+}
+
+void AccessGuard::setLimits(const Limits& limits)
+{
+	m_limits = limits;
+
+	// Windows are sized by the old limits
+	for (auto& credential : m_credentials)
+	{
+		credential.second.m_attempts = Window();
+	}
+	for (auto& input : m_inputs)
+	{
+		input.second.m_failures = Window();
+	}
+}
+
+bool AccessGuard::addToWindow(Window& window, unsigned int limit, int64_t length_ms, int64_t now_ms)
+{
+	if (limit == 0)
+	{
+		return true;
+	}
+
+	if (window.m_times.size() < limit)
+	{
+		window.m_times.push_back(now_ms);
+		return true;
+	}
+
+	int64_t& oldest = window.m_times[window.m_next];
+	if (oldest > now_ms - length_ms)
+	{
+		return false;
+	}
+
+	oldest = now_ms;
+	window.m_next = (window.m_next + 1) % limit;
+	return true;
+}
+
+void AccessGuard::lockOut(int scope, uint64_t key, int64_t until_ms, int64_t now_ms)
+{
+	*m_pLogger << std::string("AccessGuard -- locked out ") + (scope == SCOPE_CREDENTIAL ? "credential " : "door input ")
+		+ std::to_string(key) + " until " + std::to_string(until_ms);
+
+	if (m_pDatabase == nullptr)
+	{
+		return;
+	}
+
+	// Expired rows are dropped on the way, so the table only ever holds the lockouts of one lockout period
+	sqlite3_stmt* pInsert = nullptr;
+	sqlite3_stmt* pDelete = nullptr;
+	bool persisted = sqlite3_prepare_v2(m_pDatabase, "INSERT OR REPLACE INTO AccessLockouts (Scope, Key, Until) VALUES (?, ?, ?);", -1, &pInsert, nullptr) == SQLITE_OK
+		&& sqlite3_prepare_v2(m_pDatabase, "DELETE FROM AccessLockouts WHERE Until <= ?;", -1, &pDelete, nullptr) == SQLITE_OK;
+
+	if (persisted)
+	{
+		sqlite3_bind_int(pInsert, 1, scope);
+		sqlite3_bind_int64(pInsert, 2, static_cast<sqlite3_int64>(key));
+		sqlite3_bind_int64(pInsert, 3, until_ms);
+		sqlite3_bind_int64(pDelete, 1, now_ms);
+		persisted = sqlite3_step(pInsert) == SQLITE_DONE && sqlite3_step(pDelete) == SQLITE_DONE;
+	}
+
+	sqlite3_finalize(pInsert);
+	sqlite3_finalize(pDelete);
+
+	// Still enforced in memory, only a restart would lift it
+	if (!persisted)
+	{
+		*m_pLogger << "AccessGuard -- cannot persist the lockout: " + std::string(sqlite3_errmsg(m_pDatabase));
+	}
+}
+
+void AccessGuard::sweep(int64_t now_ms)
+{
+	auto newest = [](const Window& window)
+	{
+		return window.m_times.empty() ? INT64_MIN
+			: window.m_times[(window.m_next + window.m_times.size() - 1) % window.m_times.size()];
+	};
+
+	for (auto it = m_credentials.begin(); it != m_credentials.end();)
+	{
+		const CredentialState& state = it->second;
+		const bool idle = state.m_lockedUntil_ms <= now_ms
+			&& newest(state.m_attempts) <= now_ms - m_limits.m_credentialWindow_ms
+			&& state.m_lastGrant_ms <= now_ms - m_limits.m_antiPassback_ms;
+		it = idle ? m_credentials.erase(it) : std::next(it);
+	}
+
+	for (auto it = m_inputs.begin(); it != m_inputs.end();)
+	{
+		const InputState& input = it->second;
+		const bool idle = input.m_lockedUntil_ms <= now_ms && newest(input.m_failures) <= now_ms - m_limits.m_doorWindow_ms;
+		it = idle ? m_inputs.erase(it) : std::next(it);
+	}
+
+	// Doubling keeps the sweeps amortized constant per attempt however many credentials stay active
+	m_nextSweep = std::max(SWEEP_THRESHOLD, 2 * getTrackedCount());
+}
+
+size_t AccessGuard::getLockoutCount(int64_t now_ms) const
+{
+	size_t count = 0;
+	for (const auto& credential : m_credentials)
+	{
+		count += credential.second.m_lockedUntil_ms > now_ms;
+	}
+	for (const auto& input : m_inputs)
+	{
+		count += input.second.m_lockedUntil_ms > now_ms;
+	}
+	return count;
+}
+
+const char* AccessGuard::toString(enuVerdict verdict)
+{
+	switch (verdict)
+	{
+	case ALLOWED: return "ALLOWED";
+	case CREDENTIAL_LOCKED: return "CREDENTIAL_LOCKED";
+	case DOOR_LOCKED: return "DOOR_LOCKED";
+	case PASSBACK: return "PASSBACK";
+	}
+	return "UNKNOWN";
+}
+
+uint64_t AccessGuard::credentialKey(const InputParameter& credential) const
+{
+	const std::string data = std::to_string(static_cast<int>(credential.getType())) + ":" + credential.getData();
+	const Sha256::Digest digest = m_key.Sign(data);
+
+	uint64_t key = 0;
+	std::memcpy(&key, digest.data(), sizeof(key));
+	return key;
+}
+
+bool AccessGuard::loadKey(const std::string& keyPath)
+{
+	int fd = open(keyPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		// First start: only one process may create the key, a second one reads the key of the first
+		unsigned char key[KEY_SIZE];
+		if (getrandom(key, sizeof(key), 0) != static_cast<ssize_t>(sizeof(key)))
+		{
+			return false;
+		}
+
+		fd = open(keyPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd >= 0)
+		{
+			bool written = ::write(fd, key, sizeof(key)) == static_cast<ssize_t>(sizeof(key));
+			written &= (close(fd) == 0);
+			if (!written)
+			{
+				unlink(keyPath.c_str());
+				return false;
+			}
+
+			m_key = Sha256::HmacKey(std::string(reinterpret_cast<const char*>(key), sizeof(key)));
+			*m_pLogger << "AccessGuard -- created key " + keyPath;
+			return true;
+		}
+
+		fd = open(keyPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+	}
+
+	char key[KEY_SIZE];
+	bool valid = read(fd, key, sizeof(key)) == static_cast<ssize_t>(sizeof(key));
+	close(fd);
+
+	if (valid)
+	{
+		m_key = Sha256::HmacKey(std::string(key, sizeof(key)));
+	}
+
+	return valid;
+}
@@ -0,0 +1,370 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessSchedule.hpp"
+#include "Kernel.hpp"
+
+#include <set>
+
+const char* const AccessSchedule::CREATE_TABLES =
+	"CREATE TABLE IF NOT EXISTS AccessRules ("
+	"ID INTEGER PRIMARY KEY AUTOINCREMENT, "
+	"EmployeeId INTEGER DEFAULT NULL, "
+	"DoorId INTEGER DEFAULT NULL, "
+	"Weekdays INTEGER NOT NULL DEFAULT 127, "
+	"StartTime TEXT NOT NULL DEFAULT '00:00', "
+	"EndTime TEXT NOT NULL DEFAULT '24:00', "
+	"ValidFrom TEXT DEFAULT NULL, "
+	"ValidUntil TEXT DEFAULT NULL, "
+	"OnHolidays INTEGER NOT NULL DEFAULT 0);"
+	"CREATE TABLE IF NOT EXISTS Holidays ("
+	"Date TEXT NOT NULL PRIMARY KEY, "
+	"Name TEXT DEFAULT NULL);";
+
+constexpr std::chrono::milliseconds AccessSchedule::RELOAD_INTERVAL;
+
+namespace
+{
+	const unsigned int MINUTES_PER_DAY = 24 * 60;
+
+	std::string columnText(sqlite3_stmt* pStatement, int column)
+	{
+		const unsigned char* pText = sqlite3_column_text(pStatement, column);
+		return pText != nullptr ? reinterpret_cast<const char*>(pText) : "";
+	}
+
+	bool isDigits(const std::string& text, size_t begin, size_t count)
+	{
+		for (size_t i = begin; i < begin + count; ++i)
+		{
+			if (text[i] < '0' || text[i] > '9')
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+AccessSchedule::AccessSchedule(const std::string& databasePath, ILogger* pLogger)
+	: m_databasePath(databasePath), m_pLogger(pLogger), m_pDatabase(nullptr), m_dataVersion(-1),
+	m_lastCheck(std::chrono::steady_clock::now()), m_day(INT32_MIN), m_weekday(0)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	// Own read-only connection: reloading never waits for the gateway's writes
+	if (sqlite3_open_v2(m_databasePath.c_str(), &m_pDatabase, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+	{
+		*m_pLogger << "AccessSchedule -- cannot open " + m_databasePath;
+		Kernel::Fatal_Error("AccessSchedule -- cannot open " + m_databasePath);
+	}
+
+	// Ignoring the schedules would admit everyone at any time
+	if (Reload() == false)
+	{
+		*m_pLogger << "AccessSchedule -- cannot read the access rules of " + m_databasePath;
+		Kernel::Fatal_Error("AccessSchedule -- cannot read the access rules of " + m_databasePath);
+	}
+}
+
+AccessSchedule::~AccessSchedule()
+{
+	sqlite3_close(m_pDatabase);
+}
+
+void AccessSchedule::Refresh()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (now - m_lastCheck < RELOAD_INTERVAL)
+	{
+		return;
+	}
+	m_lastCheck = now;
+
+	int64_t dataVersion;
+	if (readDataVersion(dataVersion) && dataVersion != m_dataVersion)
+	{
+		Reload();
+	}
+}
+
+bool AccessSchedule::readDataVersion(int64_t& dataVersion)
+{
+	sqlite3_stmt* pStatement = nullptr;
+	bool read = sqlite3_prepare_v2(m_pDatabase, "PRAGMA data_version;", -1, &pStatement, nullptr) == SQLITE_OK
+		&& sqlite3_step(pStatement) == SQLITE_ROW;
+	if (read)
+	{
+		dataVersion = sqlite3_column_int64(pStatement, 0);
+	}
+	sqlite3_finalize(pStatement);
+	return read;
+}
+
+bool AccessSchedule::Reload()
+{
+	std::vector<AccessRule> rules;
+	std::vector<int32_t> holidays;
+	int64_t dataVersion = -1;
+
+	// One read transaction, so rules and holidays come from the same commit
+	bool loaded = sqlite3_exec(m_pDatabase, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+
+	sqlite3_stmt* pStatement = nullptr;
+	loaded = loaded && sqlite3_prepare_v2(m_pDatabase,
+		"SELECT ID, EmployeeId, DoorId, Weekdays, StartTime, EndTime, ValidFrom, ValidUntil, OnHolidays FROM AccessRules;",
+		-1, &pStatement, nullptr) == SQLITE_OK;
+
+	int status = SQLITE_DONE;
+	while (loaded && (status = sqlite3_step(pStatement)) == SQLITE_ROW)
+	{
+		AccessRule rule;
+		const sqlite3_int64 employeeId = sqlite3_column_int64(pStatement, 1);
+		const sqlite3_int64 doorId = sqlite3_column_int64(pStatement, 2);
+		const sqlite3_int64 weekdays = sqlite3_column_int64(pStatement, 3);
+
+		bool valid = employeeId >= 0 && employeeId <= UINT_MAX && doorId >= 0 && doorId <= USHRT_MAX && weekdays >= 0 && weekdays <= 0x7F
+			&& ParseTime(columnText(pStatement, 4), rule.m_start_min) && rule.m_start_min < MINUTES_PER_DAY
+			&& ParseTime(columnText(pStatement, 5), rule.m_end_min)
+			&& (sqlite3_column_type(pStatement, 6) == SQLITE_NULL || ParseDate(columnText(pStatement, 6), rule.m_validFrom_day))
+			&& (sqlite3_column_type(pStatement, 7) == SQLITE_NULL || ParseDate(columnText(pStatement, 7), rule.m_validUntil_day));
+
+		rule.m_employeeId = static_cast<unsigned int>(employeeId);
+		rule.m_doorId = static_cast<DoorId>(doorId);
+		rule.m_weekdays = static_cast<uint8_t>(weekdays);
+		rule.m_onHolidays = sqlite3_column_int(pStatement, 8) != 0;
+
+		if (valid == false)
+		{
+			// Still restricts its employee and door, so a typo cannot lift a restriction
+			*m_pLogger << "AccessRules row " + std::to_string(sqlite3_column_int64(pStatement, 0)) + " is malformed and admits nobody";
+			rule.m_weekdays = 0;
+		}
+
+		rules.push_back(rule);
+	}
+	loaded = loaded && status == SQLITE_DONE;
+	sqlite3_finalize(pStatement);
+
+	pStatement = nullptr;
+	loaded = loaded && sqlite3_prepare_v2(m_pDatabase, "SELECT Date FROM Holidays;", -1, &pStatement, nullptr) == SQLITE_OK;
+	while (loaded && (status = sqlite3_step(pStatement)) == SQLITE_ROW)
+	{
+		int32_t day;
+		if (ParseDate(columnText(pStatement, 0), day))
+		{
+			holidays.push_back(day);
+		}
+		else
+		{
+			*m_pLogger << "Holidays date " + columnText(pStatement, 0) + " is malformed and ignored";
+		}
+	}
+	loaded = loaded && status == SQLITE_DONE;
+	sqlite3_finalize(pStatement);
+
+	loaded = loaded && readDataVersion(dataVersion);
+	sqlite3_exec(m_pDatabase, "COMMIT;", nullptr, nullptr, nullptr);
+
+	if (loaded == false)
+	{
+		*m_pLogger << std::string("Cannot load access rules, keeping the previous ones: ") + sqlite3_errmsg(m_pDatabase);
+		return false;
+	}
+
+	setRules(rules, holidays);
+	m_dataVersion = dataVersion;
+
+	*m_pLogger << "Loaded " + std::to_string(rules.size()) + " access rules and " + std::to_string(holidays.size()) + " holidays";
+	return true;
+}
+
+void AccessSchedule::setRules(const std::vector<AccessRule>& rules, const std::vector<int32_t>& holidays)
+{
+	m_compiled.clear();
+	m_groups.clear();
+	m_rules = rules;
+	m_holidays = std::unordered_set<int32_t>(holidays.begin(), holidays.end());
+
+	// A rule for every door also belongs to the groups of the doors that have rules of their own
+	std::unordered_map<unsigned int, std::set<DoorId>> doorsOf;
+	for (const AccessRule& rule : m_rules)
+	{
+		if (rule.m_doorId != NO_DOOR)
+		{
+			doorsOf[rule.m_employeeId].insert(rule.m_doorId);
+		}
+	}
+
+	for (size_t i = 0; i < m_rules.size(); ++i)
+	{
+		const AccessRule& rule = m_rules[i];
+		m_groups[key(rule.m_employeeId, rule.m_doorId)].push_back(i);
+
+		if (rule.m_doorId == NO_DOOR)
+		{
+			for (DoorId doorId : doorsOf[rule.m_employeeId])
+			{
+				m_groups[key(rule.m_employeeId, doorId)].push_back(i);
+			}
+		}
+	}
+}
+
+bool AccessSchedule::isAllowed(unsigned int employeeId, DoorId doorId, time_t now)
+{
+	tm local;
+	localtime_r(&now, &local);
+
+	const int32_t day = DayNumber(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+	if (day != m_day)
+	{
+		m_compiled.clear();
+		m_day = day;
+		m_weekday = (local.tm_wday + 6) % 7;
+	}
+
+	const unsigned int minute = local.tm_hour * 60 + local.tm_min;
+
+	// Employee 0 (unknown credentials) is only subject to door schedules
+	const std::vector<size_t>* pEmployeeGroup = employeeId != 0 ? findGroup(employeeId, doorId) : nullptr;
+	const std::vector<size_t>* pDoorGroup = findGroup(0, doorId);
+
+	return (pEmployeeGroup == nullptr || isOpen(*pEmployeeGroup, minute))
+		&& (pDoorGroup == nullptr || isOpen(*pDoorGroup, minute));
+}
+
+const std::vector<size_t>* AccessSchedule::findGroup(unsigned int employeeId, DoorId doorId) const
+{
+	auto group = m_groups.find(key(employeeId, doorId));
+	if (group == m_groups.end() && doorId != NO_DOOR)
+	{
+		group = m_groups.find(key(employeeId, NO_DOOR));
+	}
+
+	return group != m_groups.end() ? &group->second : nullptr;
+}
+
+bool AccessSchedule::opensOn(const AccessRule& rule, int32_t day, unsigned int weekday) const
+{
+	return (rule.m_weekdays >> weekday & 1) != 0
+		&& day >= rule.m_validFrom_day && day <= rule.m_validUntil_day
+		&& (rule.m_onHolidays || m_holidays.count(day) == 0);
+}
+
+bool AccessSchedule::isOpen(const std::vector<size_t>& group, unsigned int minute)
+{
+	auto compiled = m_compiled.find(&group);
+	if (compiled == m_compiled.end())
+	{
+		DayWindows windows;
+		const unsigned int yesterday = (m_weekday + 6) % 7;
+
+		for (size_t index : group)
+		{
+			const AccessRule& rule = m_rules[index];
+			const bool overnight = rule.m_end_min <= rule.m_start_min;
+
+			if (opensOn(rule, m_day, m_weekday))
+			{
+				for (unsigned int i = rule.m_start_min; i < (overnight ? MINUTES_PER_DAY : rule.m_end_min); ++i)
+				{
+					windows.set(i);
+				}
+			}
+
+			// The part after midnight of a window opened yesterday
+			if (overnight && opensOn(rule, m_day - 1, yesterday))
+			{
+				for (unsigned int i = 0; i < rule.m_end_min; ++i)
+				{
+					windows.set(i);
+				}
+			}
+		}
+
+		compiled = m_compiled.emplace(&group, windows).first;
+	}
+
+	return compiled->second.test(minute);
+}
+
+int32_t AccessSchedule::DayNumber(int year, unsigned int month, unsigned int day)
+{
+	// Days from civil, counting years from March so the leap day is the last day of a year
+	const int y = year - (month <= 2 ? 1 : 0);
+	const int era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned int yearOfEra = static_cast<unsigned int>(y - era * 400);
+	const unsigned int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	const unsigned int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + static_cast<int32_t>(dayOfEra) - 719468;
+}
+
+bool AccessSchedule::ParseDate(const std::string& text, int32_t& day)
+{
+	if (text.size() != 10 || text[4] != '-' || text[7] != '-' || !isDigits(text, 0, 4) || !isDigits(text, 5, 2) || !isDigits(text, 8, 2))
+	{
+		return false;
+	}
+
+	const int year = std::stoi(text.substr(0, 4));
+	const unsigned int month = std::stoul(text.substr(5, 2));
+	const unsigned int dayOfMonth = std::stoul(text.substr(8, 2));
+	if (month < 1 || month > 12 || dayOfMonth < 1)
+	{
+		return false;
+	}
+
+	// The first of the next month tells the length of this one
+	const int32_t first = DayNumber(year, month, 1);
+	const int32_t next = month == 12 ? DayNumber(year + 1, 1, 1) : DayNumber(year, month + 1, 1);
+	if (static_cast<int32_t>(dayOfMonth) > next - first)
+	{
+		return false;
+	}
+
+	day = first + static_cast<int32_t>(dayOfMonth) - 1;
+	return true;
+}
+
+bool AccessSchedule::ParseTime(const std::string& text, uint16_t& minutes)
+{
+	if (text.size() != 5 || text[2] != ':' || !isDigits(text, 0, 2) || !isDigits(text, 3, 2))
+	{
+		return false;
+	}
+
+	const unsigned int hours = std::stoul(text.substr(0, 2));
+	const unsigned int minutesOfHour = std::stoul(text.substr(3, 2));
+	if (minutesOfHour > 59 || hours > 24 || (hours == 24 && minutesOfHour != 0))
+	{
+		return false;
+	}
+
+	minutes = static_cast<uint16_t>(hours * 60 + minutesOfHour);
+	return true;
+}
@@ -0,0 +1,722 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "BulkImport.hpp"
+#include "FieldValidators.hpp"
+#include "Kernel.hpp"
+#include "propertiesclass.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Same as in Tables.hpp, which cannot be included here: its definitions already are in DatabaseObject
+using UID = unsigned int;
+
+namespace
+{
+	/// Finalizes the statement when it goes out of scope
+	struct Statement
+	{
+		sqlite3_stmt* m_pStatement = nullptr;
+
+		~Statement() { sqlite3_finalize(m_pStatement); }
+
+		bool prepare(sqlite3* pDatabase, const std::string& query, std::string& error)
+		{
+			if (sqlite3_prepare_v2(pDatabase, query.c_str(), -1, &m_pStatement, nullptr) != SQLITE_OK)
+			{
+				error = "cannot prepare \"" + query + "\": " + sqlite3_errmsg(pDatabase);
+				return false;
+			}
+			return true;
+		}
+
+		/// Runs a statement which returns no rows and resets it for the next bindings
+		bool execute(sqlite3* pDatabase, const std::string& what, std::string& error)
+		{
+			const int status = sqlite3_step(m_pStatement);
+			if (status != SQLITE_DONE)
+			{
+				error = what + ": " + sqlite3_errmsg(pDatabase);
+			}
+			sqlite3_reset(m_pStatement);
+			return status == SQLITE_DONE;
+		}
+	};
+
+	/// Cards or PINs: who owns which credential, kept in step with every row the import changes
+	struct CredentialTable
+	{
+		std::string m_name;
+		std::unordered_map<std::string, UID> m_ownerOf;
+		std::unordered_map<UID, std::set<std::string>> m_ownedBy;
+		Statement m_delete;
+		Statement m_upsert;
+
+		bool load(sqlite3* pDatabase, const std::string& table, const std::string& valueColumn, const std::string& ownerColumn, std::string& error)
+		{
+			m_name = table;
+
+			Statement select;
+			if (!select.prepare(pDatabase, "SELECT " + valueColumn + ", " + ownerColumn + " FROM " + table + ";", error))
+			{
+				return false;
+			}
+
+			int status;
+			while ((status = sqlite3_step(select.m_pStatement)) == SQLITE_ROW)
+			{
+				const char* pValue = reinterpret_cast<const char*>(sqlite3_column_text(select.m_pStatement, 0));
+				const UID owner = static_cast<UID>(sqlite3_column_int64(select.m_pStatement, 1));
+				if (pValue != nullptr)
+				{
+					m_ownerOf[pValue] = owner;
+					m_ownedBy[owner].insert(pValue);
+				}
+			}
+
+			if (status != SQLITE_DONE)
+			{
+				error = "cannot read " + table + ": " + sqlite3_errmsg(pDatabase);
+				return false;
+			}
+
+			/*======================================================
+
+				DELETE FROM RFIDCardTable WHERE CardUUID = ?1;
+
+				INSERT INTO RFIDCardTable(CardUUID, CardOwnerId) VALUES (?1, ?2)
+				ON CONFLICT(CardUUID) DO UPDATE SET CardOwnerId = excluded.CardOwnerId;
+
+			  ======================================================*/
+
+			return m_delete.prepare(pDatabase, "DELETE FROM " + table + " WHERE " + valueColumn + " = ?1;", error)
+				&& m_upsert.prepare(pDatabase, "INSERT INTO " + table + "(" + valueColumn + ", " + ownerColumn + ") VALUES (?1, ?2) "
+					"ON CONFLICT(" + valueColumn + ") DO UPDATE SET " + ownerColumn + " = excluded." + ownerColumn + ";", error);
+		}
+
+		/// Makes `wanted` the credentials of `owner`: drops the ones not listed, adds or moves the listed ones
+		bool assign(sqlite3* pDatabase, UID owner, const std::vector<std::string>& wanted, std::string& error)
+		{
+			auto owned = m_ownedBy.find(owner);
+			if (owned != m_ownedBy.end())
+			{
+				std::vector<std::string> dropped;
+				for (const std::string& value : owned->second)
+				{
+					if (std::find(wanted.begin(), wanted.end(), value) == wanted.end())
+					{
+						dropped.push_back(value);
+					}
+				}
+
+				for (const std::string& value : dropped)
+				{
+					sqlite3_bind_text(m_delete.m_pStatement, 1, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+					if (!m_delete.execute(pDatabase, "cannot delete from " + m_name, error))
+					{
+						return false;
+					}
+					m_ownerOf.erase(value);
+					owned->second.erase(value);
+				}
+			}
+
+			for (const std::string& value : wanted)
+			{
+				auto current = m_ownerOf.find(value);
+				if (current != m_ownerOf.end() && current->second == owner)
+				{
+					continue;
+				}
+
+				sqlite3_bind_text(m_upsert.m_pStatement, 1, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+				sqlite3_bind_int64(m_upsert.m_pStatement, 2, owner);
+				if (!m_upsert.execute(pDatabase, "cannot write " + m_name, error))
+				{
+					return false;
+				}
+
+				if (current != m_ownerOf.end())
+				{
+					m_ownedBy[current->second].erase(value);
+				}
+				m_ownerOf[value] = owner;
+				m_ownedBy[owner].insert(value);
+			}
+
+			return true;
+		}
+	};
+
+	std::vector<std::string> splitFields(const std::string& line)
+	{
+		std::vector<std::string> fields;
+		std::istringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, '\t'))
+		{
+			fields.push_back(field);
+		}
+		return fields;
+	}
+
+	bool parseClearance(const std::string& text, Clearance& clearance)
+	{
+		if (!FieldValidators::SignedNumber::test(text))
+		{
+			return false;
+		}
+
+		const long value = std::strtol(text.c_str(), nullptr, 10);
+		if (value < NO_CLEARANCE || value >= MAX_CLEARANCE)
+		{
+			return false;
+		}
+
+		clearance = static_cast<Clearance>(value);
+		return true;
+	}
+}
+
+const size_t ImportSpool::MAX_EMPLOYEES;
+const int BulkImporter::BUSY_TIMEOUT_MS;
+
+bool ImportSpool::Validate(const std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	if (employees.empty() || employees.size() > MAX_EMPLOYEES)
+	{
+		error = "a batch must contain between 1 and " + std::to_string(MAX_EMPLOYEES) + " employees";
+		return false;
+	}
+
+	std::unordered_set<std::string> names;
+	std::unordered_set<std::string> cards;
+	std::unordered_set<std::string> pins;
+
+	for (size_t i = 0; i < employees.size(); ++i)
+	{
+		const ImportedEmployee& employee = employees[i];
+		const std::string record = "employee " + std::to_string(i + 1) + ": ";
+
+		if (!FieldValidators::EmployeeName::test(employee.m_name))
+		{
+			error = record + "invalid name";
+			return false;
+		}
+
+		if (!names.insert(employee.m_name).second)
+		{
+			error = record + "name " + employee.m_name + " listed twice";
+			return false;
+		}
+
+		if (employee.m_clearance < NO_CLEARANCE || employee.m_clearance >= MAX_CLEARANCE)
+		{
+			error = record + "clearance must be between " + std::to_string(NO_CLEARANCE) + " and " + std::to_string(MAX_CLEARANCE - 1);
+			return false;
+		}
+
+		if (employee.m_cards.size() > 1)
+		{
+			error = record + "at most one card per employee";
+			return false;
+		}
+
+		for (const std::string& card : employee.m_cards)
+		{
+			if (!FieldValidators::CardUUID::test(card) || !cards.insert(card).second)
+			{
+				error = record + "card " + card + " is invalid or listed twice";
+				return false;
+			}
+		}
+
+		for (const std::string& pin : employee.m_pins)
+		{
+			if (!FieldValidators::KeypadPassword::test(pin) || !pins.insert(pin).second)
+			{
+				error = record + "PIN is invalid or listed twice";
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+std::string ImportSpool::CreateName()
+{
+	static std::atomic<unsigned int> counter(0);
+	return "import." + std::to_string(getpid()) + "." + std::to_string(++counter);
+}
+
+bool ImportSpool::isValidName(const std::string& name)
+{
+	const std::string prefix = "import.";
+	return name.size() > prefix.size() && name.size() <= 32
+		&& name.compare(0, prefix.size(), prefix) == 0
+		&& name.find_first_not_of("0123456789.", prefix.size()) == std::string::npos;
+}
+
+std::string ImportSpool::getPath(const std::string& databasePath, const std::string& name)
+{
+	return databasePath + "." + name;
+}
+
+bool ImportSpool::Write(const std::string& path, const std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	std::string content;
+	content.reserve(employees.size() * 48);
+	for (const ImportedEmployee& employee : employees)
+	{
+		content += "E\t" + employee.m_name + "\t" + std::to_string(employee.m_clearance) + "\n";
+		for (const std::string& card : employee.m_cards)
+		{
+			content += "C\t" + card + "\n";
+		}
+		for (const std::string& pin : employee.m_pins)
+		{
+			content += "P\t" + pin + "\n";
+		}
+	}
+
+	// Credentials in plain text: readable by the owner only, and an existing file is never reused
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		error = "cannot create " + path + ": " + strerror(errno);
+		return false;
+	}
+
+	size_t written = 0;
+	while (written < content.size())
+	{
+		const ssize_t result = write(fd, content.data() + written, content.size() - written);
+		if (result < 0 && errno == EINTR) continue;
+		if (result <= 0) break;
+		written += static_cast<size_t>(result);
+	}
+
+	const bool closed = close(fd) == 0;
+	if (written != content.size() || !closed)
+	{
+		error = "cannot write " + path + ": " + strerror(errno);
+		unlink(path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ImportSpool::Read(const std::string& path, std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	employees.clear();
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+		const std::vector<std::string> fields = splitFields(line);
+		const std::string record = path + ":" + std::to_string(lineNumber) + ": ";
+
+		if (fields.size() == 3 && fields[0] == "E")
+		{
+			ImportedEmployee employee;
+			employee.m_name = fields[1];
+			if (!parseClearance(fields[2], employee.m_clearance))
+			{
+				error = record + "invalid clearance";
+				return false;
+			}
+			employees.push_back(employee);
+		}
+		else if (fields.size() == 2 && (fields[0] == "C" || fields[0] == "P") && !employees.empty())
+		{
+			(fields[0] == "C" ? employees.back().m_cards : employees.back().m_pins).push_back(fields[1]);
+		}
+		else
+		{
+			error = record + "malformed record";
+			return false;
+		}
+
+		if (employees.size() > MAX_EMPLOYEES)
+		{
+			break;
+		}
+	}
+
+	// The gateway does not trust the file any more than the request that named it
+	return Validate(employees, error);
+}
+
+BulkImporter::BulkImporter(const std::string& databasePath, std::mutex& writeLock, ILogger* pLogger) :
+	m_databasePath(databasePath), m_writeLock(writeLock), m_pLogger(pLogger),
+	m_importLatency(MetricsRegistry::Process().getHistogram("database.import_ns")),
+	m_importedEmployees(MetricsRegistry::Process().getCounter("database.imported_employees"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+}
+
+BulkImporter::~BulkImporter()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_jobsLock);
+		m_stop = true;
+	}
+	m_jobsChanged.notify_all();
+
+	if (m_worker.joinable())
+	{
+		m_worker.join();
+	}
+}
+
+void BulkImporter::Start(const std::string& replyMailboxName)
+{
+	if (m_worker.joinable())
+	{
+		Kernel::Fatal_Error("BulkImporter - Start() called twice");
+	}
+
+	// DataMailbox is not thread safe: the worker replies from its own mailbox, never from the gateway's
+	m_pReplyMailbox.reset(new DataMailbox(replyMailboxName, m_pLogger));
+	m_worker = std::thread(&BulkImporter::workerThreadFunction, this);
+}
+
+void BulkImporter::Submit(const std::string& spoolPath, CommandMessage& request)
+{
+	if (!m_worker.joinable())
+	{
+		Kernel::Fatal_Error("BulkImporter - Submit() called before Start()");
+	}
+
+	Job job{ spoolPath, request.getSource(), request.getDoorId(), request.getRequestId(), request.getTrace() };
+	{
+		std::unique_lock<std::mutex> lock(m_jobsLock);
+		m_jobs.push_back(job);
+	}
+	m_jobsChanged.notify_one();
+}
+
+void BulkImporter::workerThreadFunction()
+{
+	for (;;)
+	{
+		std::unique_lock<std::mutex> lock(m_jobsLock);
+		m_jobsChanged.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+		if (m_stop)
+		{
+			return;
+		}
+
+		Job job = m_jobs.front();
+		m_jobs.pop_front();
+		lock.unlock();
+
+		process(job);
+	}
+}
+
+void BulkImporter::process(Job& job)
+{
+	std::vector<ImportedEmployee> employees;
+	std::string error;
+
+	const bool success = ImportSpool::Read(job.m_spoolPath, employees, error) && Import(employees, error);
+	unlink(job.m_spoolPath.c_str());
+
+	if (success)
+	{
+		*m_pLogger << "Imported " + std::to_string(employees.size()) + " employees from " + job.m_spoolPath;
+	}
+	else
+	{
+		*m_pLogger << "Import of " + job.m_spoolPath + " failed: " + error;
+	}
+
+	DatabaseReply reply(success ? DatabaseReply::enuStatus::SUCCESS : DatabaseReply::enuStatus::ERROR);
+	reply.setDoorId(job.m_doorId);
+	reply.setRequestId(job.m_requestId);
+	if (!job.m_trace.empty())
+	{
+		reply.setTrace(job.m_trace);
+		reply.getTrace().Mark(LatencyTrace::DATABASE_REPLIED);
+	}
+
+	m_pReplyMailbox->send(job.m_replyTo, &reply);
+}
+
+bool BulkImporter::Import(const std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	if (!ImportSpool::Validate(employees, error))
+	{
+		return false;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	sqlite3* pDatabase = nullptr;
+	if (sqlite3_open_v2(m_databasePath.c_str(), &pDatabase, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+	{
+		error = "cannot open " + m_databasePath + ": " + (pDatabase != nullptr ? sqlite3_errmsg(pDatabase) : "out of memory");
+		sqlite3_close(pDatabase);
+		return false;
+	}
+	sqlite3_busy_timeout(pDatabase, BUSY_TIMEOUT_MS);
+
+	bool success;
+	{
+		std::unique_lock<std::mutex> writeLock(m_writeLock);
+		success = importOn(pDatabase, employees, error);
+	}
+	sqlite3_close(pDatabase);
+
+	m_importLatency.Record(std::chrono::steady_clock::now() - start);
+	if (success)
+	{
+		m_importedEmployees.Increment(employees.size());
+	}
+
+	return success;
+}
+
+bool BulkImporter::importOn(sqlite3* pDatabase, const std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	// IMMEDIATE takes the write lock up front instead of failing to upgrade a read transaction later
+	if (sqlite3_exec(pDatabase, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		error = std::string("cannot begin transaction: ") + sqlite3_errmsg(pDatabase);
+		return false;
+	}
+
+	const Properties& properties = GlobalProperties::Get();
+	const std::string& EMPLOYEES = properties.EMPLOYEES_TABLE_NAME;
+	const std::string& EMPLOYEE_ID = properties.EMPLOYEES_TABLE_ID_COLUMN_NAME;
+	const std::string& EMPLOYEE_NAME = properties.EMPLOYEES_TABLE_NAME_COLUMN_NAME;
+	const std::string& EMPLOYEE_CLEARANCE = properties.EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME;
+
+	// Statements are finalized before the transaction ends, hence the scope
+	bool success = [&]()
+	{
+		struct Employee { UID m_id; int m_clearance; };
+		std::unordered_map<std::string, Employee> existing;
+
+		Statement select;
+		if (!select.prepare(pDatabase, "SELECT " + EMPLOYEE_ID + ", " + EMPLOYEE_NAME + ", " + EMPLOYEE_CLEARANCE + " FROM " + EMPLOYEES + ";", error))
+		{
+			return false;
+		}
+
+		int status;
+		while ((status = sqlite3_step(select.m_pStatement)) == SQLITE_ROW)
+		{
+			const char* pName = reinterpret_cast<const char*>(sqlite3_column_text(select.m_pStatement, 1));
+			if (pName != nullptr)
+			{
+				existing[pName] = Employee{ static_cast<UID>(sqlite3_column_int64(select.m_pStatement, 0)), sqlite3_column_int(select.m_pStatement, 2) };
+			}
+		}
+
+		if (status != SQLITE_DONE)
+		{
+			error = "cannot read " + EMPLOYEES + ": " + sqlite3_errmsg(pDatabase);
+			return false;
+		}
+
+		CredentialTable cards;
+		CredentialTable pins;
+		Statement insertEmployee;
+		Statement updateClearance;
+
+		/*======================================================
+
+			INSERT INTO Employees(Name, Clearance) VALUES (?1, ?2);
+
+			UPDATE Employees SET Clearance = ?2 WHERE EmployeeId = ?1;
+
+		  ======================================================*/
+
+		if (!cards.load(pDatabase, properties.RFID_CARD_TABLE_NAME, properties.RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME, properties.RFID_CARD_TABLE_OWNER_COLUMN_NAME, error)
+			|| !pins.load(pDatabase, properties.KEYPAD_PASS_TABLE_NAME, properties.KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME, properties.KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME, error)
+			|| !insertEmployee.prepare(pDatabase, "INSERT INTO " + EMPLOYEES + "(" + EMPLOYEE_NAME + ", " + EMPLOYEE_CLEARANCE + ") VALUES (?1, ?2);", error)
+			|| !updateClearance.prepare(pDatabase, "UPDATE " + EMPLOYEES + " SET " + EMPLOYEE_CLEARANCE + " = ?2 WHERE " + EMPLOYEE_ID + " = ?1;", error))
+		{
+			return false;
+		}
+
+		for (const ImportedEmployee& employee : employees)
+		{
+			UID id;
+			auto current = existing.find(employee.m_name);
+			if (current == existing.end())
+			{
+				sqlite3_bind_text(insertEmployee.m_pStatement, 1, employee.m_name.c_str(), static_cast<int>(employee.m_name.size()), SQLITE_TRANSIENT);
+				sqlite3_bind_int(insertEmployee.m_pStatement, 2, employee.m_clearance);
+				if (!insertEmployee.execute(pDatabase, "cannot add employee " + employee.m_name, error))
+				{
+					return false;
+				}
+				id = static_cast<UID>(sqlite3_last_insert_rowid(pDatabase));
+			}
+			else
+			{
+				id = current->second.m_id;
+				if (current->second.m_clearance != employee.m_clearance)
+				{
+					sqlite3_bind_int64(updateClearance.m_pStatement, 1, id);
+					sqlite3_bind_int(updateClearance.m_pStatement, 2, employee.m_clearance);
+					if (!updateClearance.execute(pDatabase, "cannot set clearance of " + employee.m_name, error))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (!cards.assign(pDatabase, id, employee.m_cards, error) || !pins.assign(pDatabase, id, employee.m_pins, error))
+			{
+				error = employee.m_name + ": " + error;
+				return false;
+			}
+		}
+
+		return true;
+	}();
+
+	if (success && sqlite3_exec(pDatabase, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		error = std::string("cannot commit: ") + sqlite3_errmsg(pDatabase);
+		success = false;
+	}
+
+	if (!success)
+	{
+		sqlite3_exec(pDatabase, "ROLLBACK;", nullptr, nullptr, nullptr);
+	}
+
+	return success;
+}
+
+bool BulkImporter::Export(sqlite3* pDatabase, std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	const Properties& properties = GlobalProperties::Get();
+
+	// One read transaction, so employees and credentials come from the same committed state
+	if (sqlite3_exec(pDatabase, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		error = std::string("cannot begin transaction: ") + sqlite3_errmsg(pDatabase);
+		return false;
+	}
+
+	employees.clear();
+	std::unordered_map<UID, size_t> indexOf;
+
+	auto readRows = [&](const std::string& query, const std::function<void(sqlite3_stmt*)>& onRow)
+	{
+		Statement select;
+		if (!select.prepare(pDatabase, query, error))
+		{
+			return false;
+		}
+
+		int status;
+		while ((status = sqlite3_step(select.m_pStatement)) == SQLITE_ROW)
+		{
+			onRow(select.m_pStatement);
+		}
+
+		if (status != SQLITE_DONE)
+		{
+			error = "cannot read: " + std::string(sqlite3_errmsg(pDatabase));
+			return false;
+		}
+		return true;
+	};
+
+	auto addCredential = [&](bool card)
+	{
+		return [&, card](sqlite3_stmt* pRow)
+		{
+			const char* pValue = reinterpret_cast<const char*>(sqlite3_column_text(pRow, 0));
+			auto owner = indexOf.find(static_cast<UID>(sqlite3_column_int64(pRow, 1)));
+			if (pValue != nullptr && owner != indexOf.end())
+			{
+				ImportedEmployee& employee = employees[owner->second];
+				(card ? employee.m_cards : employee.m_pins).push_back(pValue);
+			}
+		};
+	};
+
+	/*======================================================
+
+		SELECT EmployeeId, Name, Clearance FROM Employees ORDER BY EmployeeId;
+		SELECT CardUUID, CardOwnerId FROM RFIDCardTable ORDER BY ID;
+		SELECT PasswordHash, PassOwnerId FROM KeypadPasswordTable ORDER BY ID;
+
+	  ======================================================*/
+
+	const bool success =
+		readRows("SELECT " + properties.EMPLOYEES_TABLE_ID_COLUMN_NAME + ", " + properties.EMPLOYEES_TABLE_NAME_COLUMN_NAME + ", " + properties.EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME
+			+ " FROM " + properties.EMPLOYEES_TABLE_NAME + " ORDER BY " + properties.EMPLOYEES_TABLE_ID_COLUMN_NAME + ";",
+			[&](sqlite3_stmt* pRow)
+			{
+				const char* pName = reinterpret_cast<const char*>(sqlite3_column_text(pRow, 1));
+				ImportedEmployee employee;
+				employee.m_name = pName != nullptr ? pName : "";
+				employee.m_clearance = static_cast<Clearance>(sqlite3_column_int(pRow, 2));
+				indexOf[static_cast<UID>(sqlite3_column_int64(pRow, 0))] = employees.size();
+				employees.push_back(employee);
+			})
+		&& readRows("SELECT " + properties.RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME + ", " + properties.RFID_CARD_TABLE_OWNER_COLUMN_NAME
+			+ " FROM " + properties.RFID_CARD_TABLE_NAME + " ORDER BY " + properties.RFID_CARD_TABLE_ID_COLUMN_NAME + ";", addCredential(true))
+		&& readRows("SELECT " + properties.KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME + ", " + properties.KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME
+			+ " FROM " + properties.KEYPAD_PASS_TABLE_NAME + " ORDER BY " + properties.KEYPAD_PASS_TABLE_ID_COLUMN_NAME + ";", addCredential(false));
+
+	sqlite3_exec(pDatabase, "COMMIT;", nullptr, nullptr, nullptr);
+	return success;
+}
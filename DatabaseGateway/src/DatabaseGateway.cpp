@@ -28,14 +28,29 @@
 #include<thread>
 
 #include "DatabaseRequest.hpp"
+#include "AccessGuard.hpp"
+#include "LogJournal.hpp"
 #include "UNIX_SignalHandler.hpp"
 #include "WatchdogClient.hpp"
+#include "Metrics.hpp"
 #include "propertiesclass.h"
 
 
 volatile sig_atomic_t globalTerminateFlag = 0;
 
-void databaseLoggerThreadFunction(DatabaseResources& resources);
+void databaseLoggerThreadFunction(LogJournalReplay& replay);
+
+static AccessGuard::Limits AccessGuardLimits(const Properties& properties)
+{
+    AccessGuard::Limits limits;
+    limits.m_credentialMaxAttempts = properties.GUARD_CREDENTIAL_MAX_ATTEMPTS;
+    limits.m_credentialWindow_ms = properties.GUARD_CREDENTIAL_WINDOW_S * 1000LL;
+    limits.m_doorMaxFailures = properties.GUARD_DOOR_MAX_FAILURES;
+    limits.m_doorWindow_ms = properties.GUARD_DOOR_WINDOW_S * 1000LL;
+    limits.m_lockout_ms = properties.GUARD_LOCKOUT_S * 1000LL;
+    limits.m_antiPassback_ms = properties.GUARD_ANTIPASSBACK_S * 1000LL;
+    return limits;
+}
 
 int main()
 {
@@ -44,9 +59,13 @@ int main()
 
     UNIX_SignalHandler::bindSignalToFlag(UNIX_SignalHandler::enuSIGTERM, &globalTerminateFlag);
 
+    // Guard limits are live, the request loop applies them between requests
+    PropertiesChangeFlag configChange;
+    GlobalProperties::Subscribe(&configChange);
+    GlobalProperties::StartWatching();
+
     const std::string DATABASE_WATCHDOG = GlobalProperties::Get().DATABASE_WATCHDOG_NAME;
     const unsigned int DATABASE_MAILBOX_TIMEOUT_MS = GlobalProperties::Get().DATABASE_MB_TIMEOUT;
-    const std::string DATABASE_LOG_THREAD_MB = GlobalProperties::Get().DATABASE_LOG_THREAD_MAILBOX_NAME;
     const std::string WATCHDOG_SERVER_NAME = GlobalProperties::Get().WATCHDOG_SERVER_NAME;
     const SlotSettings DATABASE_WATCHDOG_SETTINGS =
     {
@@ -64,31 +83,53 @@ int main()
     mailbox.setRTO_ns(DATABASE_MAILBOX_TIMEOUT_MS * Time::ms_to_ns);
     // MailboxReference router(ROUTER_TO_DBG_QUEUE); // REMOVE
 
-    SimplifiedMailbox logMailbox(DATABASE_LOG_THREAD_MB + ".client");
-    MailboxReference refLogThread(DATABASE_LOG_THREAD_MB + ".server");
+    const std::string DATABASE_PATH = GlobalProperties::Get().DB_PATH;
+
+    // Logs of requests not yet in the log table, kept across restarts
+    Logger journal_logger("database.journal.log");
+    LogJournal logJournal(DATABASE_PATH + ".journal", GlobalProperties::Get().LOG_JOURNAL_SIZE_KB * 1024, &journal_logger);
 
     DatabaseResources resources =
     {
         .m_pDatabaseObject = nullptr, // not yet created
         .m_pMailbox = &mailbox,
-        .m_pLogMailbox = &logMailbox,
-        .m_refLogThread = refLogThread
+        .m_pLogJournal = &logJournal,
+        .m_pBulkImporter = nullptr, // not yet created
+        .m_pAccessGuard = nullptr // not yet created
     };
 
-    const std::string DATABASE_PATH = GlobalProperties::Get().DB_PATH;
     DatabaseObject database(DATABASE_PATH, resources, &db_logger);
 
     resources.m_pDatabaseObject = &database; // created here, required for DatabaseRequestFactory
 
+    Logger import_logger("database.import.log");
+    BulkImporter importer(DATABASE_PATH, database.getWriteLock(), &import_logger);
+    importer.Start(DATABASE_GATEWAY_MAILBOX_NAME + ".import");
+    resources.m_pBulkImporter = &importer;
+
+    Logger guard_logger("database.guard.log");
+    AccessGuard guard(AccessGuardLimits(GlobalProperties::Get()), DATABASE_PATH, &guard_logger);
+    resources.m_pAccessGuard = &guard;
+
     DatabaseRequestFactory requestFactory(resources, &db_logger);
 
-    std::thread databaseLoggerThread(databaseLoggerThreadFunction, std::ref(resources));
+    MetricHistogram requestLatency = MetricsRegistry::Process().getHistogram("database.request_ns");
+
+    LogJournalReplay logReplay(logJournal, DATABASE_PATH, database.getWriteLock(), &journal_logger);
+    std::thread databaseLoggerThread(databaseLoggerThreadFunction, std::ref(logReplay));
 
     watchdog.Start();
     while (!globalTerminateFlag && watchdog.Kick())
     {
         DataMailboxMessage* pReceivedMessage = mailbox.receive(enuReceiveOptions::TIMED);
 
+        std::vector<std::string> restartRequired;
+        if (configChange.TakeChange(restartRequired))
+        {
+            guard.setLimits(AccessGuardLimits(GlobalProperties::Get()));
+            guard_logger << "Config reloaded, version " + std::to_string(GlobalProperties::Version()) + ", guard limits applied";
+        }
+
         if (pReceivedMessage->getDataType() != MessageDataType::enuType::CommandMessage)
         {
             delete pReceivedMessage;
@@ -97,6 +138,13 @@ int main()
         }
 
         CommandMessage* pReceivedRequestMessage = dynamic_cast<CommandMessage*>(pReceivedMessage);
+        if (!pReceivedRequestMessage->getTrace().empty())
+        {
+            pReceivedRequestMessage->getTrace().Mark(LatencyTrace::DATABASE_RECEIVED);
+        }
+
+        ScopedLatency latency(requestLatency);
+
         IDatabaseRequest* pRequest = requestFactory.createRequestObjectFrom(&pReceivedRequestMessage);
         
         pRequest->Process();
@@ -109,62 +157,24 @@ int main()
 
     databaseLoggerThread.join();
 
+    GlobalProperties::StopWatching();
+    GlobalProperties::Unsubscribe(&configChange);
+
     return 0;
 }
 
-void databaseLoggerThreadFunction(DatabaseResources& resources)
+void databaseLoggerThreadFunction(LogJournalReplay& replay)
 {
-    if (resources.m_pDatabaseObject == nullptr)
-    {
-        Kernel::Fatal_Error("DatabaseLoggerThread - pDatabaseObject is null!");
-        return;
-    }
-
-    const std::string DATABASE_LOG_THREAD_MB = GlobalProperties::Get().DATABASE_LOG_THREAD_MAILBOX_NAME;
-
-    SimplifiedMailbox mailbox(DATABASE_LOG_THREAD_MB + ".server");
-
-    const unsigned int mailbox_timeout_ms = 100;
-    const timespec timeout_settings = Time::getTimespecFrom_ms(mailbox_timeout_ms);
-
-    mailbox.setTimeout_settings(timeout_settings);
+    const size_t batch = GlobalProperties::Get().LOG_JOURNAL_BATCH;
+    const std::chrono::milliseconds wait(100);
 
     while (!globalTerminateFlag)
     {
-        SimpleMailboxMessage message = mailbox.receive(enuReceiveOptions::TIMED);
-
-        if (message.isTimedOut() || message.isSyscallInterrupted())
-        {
-            continue;
-        }
-
-        // DataSizePair temp = message.getOwnershipOfData();
-        // char* pRawData = temp.m_pData;
-        // temp.Clear(); // Safety TODO
-
-        char* pRawData = message.m_pData;
-
-        /********************************************************************************************************************************************************
-        *   pRawData points to buffer which contains logEntry address on heap => char* pRawData = & ( &logEntry )
-        *                                                                       pointer to buffer ^   ^ buffer contents
-        *   
-        *   so => LogEntry logEntry = * (*pRawData);
-        *     dereference the address ^  ^ contents of buffer which contains logEntry address on heap   
-        *
-        *
-        ********************************************************************************************************************************************************/
-
-        LogEntry** pToBufferContainingLogEntryAddress = (LogEntry**) pRawData;
-        LogEntry* pLogEntry = *(pToBufferContainingLogEntryAddress);
-
-        if (pLogEntry == nullptr)
-        {
-            Kernel::Warning("DatabaseGateway received log data is null!");
-            delete pLogEntry;
-            continue;
-        }
+        replay.ReplayBatch(batch, wait);
+    }
 
-        resources.m_pDatabaseObject->WriteLogToLogTable(*pLogEntry);
-        delete pLogEntry;
+    // The request loop has stopped, write what it journaled last instead of leaving it for the next start
+    while (replay.ReplayBatch(batch, std::chrono::milliseconds(0)) != 0)
+    {
     }
 }
@@ -25,6 +25,8 @@
 #include "DatabaseObject.hpp"
 
 #include "ValidationUtils.hpp"
+#include "LogJournal.hpp"
+#include "propertiesclass.h"
 
 #include <sstream>
 
@@ -45,12 +47,14 @@ DatabaseObject::DatabaseObject(const std::string& DB_path, DatabaseResources& re
 		Kernel::Fatal_Error("DatabaseObject - mailbox cannot be nullptr!");
 	}
 
-	if (resources.m_pLogMailbox == nullptr)
+	if (resources.m_pLogJournal == nullptr)
 	{
-		*m_pLogger << "DatabaseObject -- pointer to pLogMailbox cannot be null!";
-		Kernel::Fatal_Error("DatabaseRequestFactory -- pointer to pLogMailbox cannot be null!");
+		*m_pLogger << "DatabaseObject -- pointer to pLogJournal cannot be null!";
+		Kernel::Fatal_Error("DatabaseObject -- pointer to pLogJournal cannot be null!");
 	}
 
+	m_logJournalFullWait = std::chrono::milliseconds(GlobalProperties::Get().LOG_JOURNAL_FULL_WAIT_MS);
+
 	initialize();
 }
 
@@ -64,6 +68,7 @@ DatabaseObject::~DatabaseObject()
 	delete m_pRFIDCardTable;
 	delete m_pWebAPITable;
 	delete m_pLogTable;
+	delete m_pAccessSchedule;
 }
 
 
@@ -95,7 +100,8 @@ bool DatabaseObject::test()
 		m_pCommandsTable == nullptr ||
 		m_pRFIDCardTable == nullptr ||
 		m_pWebAPITable == nullptr ||
-		m_pLogTable == nullptr;
+		m_pLogTable == nullptr ||
+		m_pAccessSchedule == nullptr;
 
 	return !anyNullptrPresent;
 							
@@ -137,28 +143,47 @@ void DatabaseObject::initializeTables()
 	m_pLogTable = new LogTable(&m_database, m_pLogger);
 	m_pLogTable->initialize();
 
+	// Not part of the original schema, added to existing databases on first start
+	m_database.Execute(AccessSchedule::CREATE_TABLES, nullptr);
+	m_pAccessSchedule = new AccessSchedule(m_path, m_pLogger);
+
 }
 
 
 void DatabaseObject::CreateLog(CommandMessage::enuCommand command, const InputParameter& userCredentials)
 {
-	// std::string s contained in LogEntry contain garbage value
-	// when sent via a message queue even inside the same process
-	// (probably uses stack local variables)
-	// Make sure that pLogEntry is free d on receiving side!
-	LogEntry* pLogEntry = new LogEntry;
-
-	*pLogEntry = parseInputParameterToLogEntry(userCredentials);
+	LogEntry logEntry = parseInputParameterToLogEntry(userCredentials);
 	std::string commandName = parseCommand(command);
 
-	pLogEntry->m_timestamp = Time::getDateTime_ISO8601();
-	pLogEntry->m_commandId = m_pCommandsTable->SelectId(commandName);
+	logEntry.m_timestamp = Time::getDateTime_ISO8601();
+	logEntry.m_commandId = m_pCommandsTable->SelectId(commandName);
+
+	journalLog(logEntry);
+}
+
+void DatabaseObject::CreateOfflineLog(const InputParameter& userCredentials, const std::string& timestamp)
+{
+	LogEntry logEntry = parseInputParameterToLogEntry(userCredentials);
+	std::string commandName = parseCommand(CommandMessage::enuCommand::AUTHENTICATE);
 
+	// Decided without the database, possibly long before it is logged
+	logEntry.m_authMethod += " offline";
+	logEntry.m_timestamp = timestamp;
+	logEntry.m_commandId = m_pCommandsTable->SelectId(commandName);
 
-	m_resources.m_pLogMailbox->sendConnectionless(m_resources.m_refLogThread, (char*)&pLogEntry, sizeof(LogEntry*));
+	journalLog(logEntry);
+}
 
-	return;
-	
+void DatabaseObject::journalLog(LogEntry& logEntry)
+{
+	LogJournal::enuAppendResult result = m_resources.m_pLogJournal->Append(logEntry.m_timestamp, logEntry.m_userId, logEntry.m_authMethod, logEntry.m_commandId, m_logJournalFullWait);
+
+	// Backpressure: the logging thread is behind by a whole journal, this request pays for one insert itself
+	if (result != LogJournal::APPENDED)
+	{
+		*m_pLogger << "Log journal is full, writing the log directly";
+		WriteLogToLogTable(logEntry);
+	}
 }
 
 void DatabaseObject::WriteLogToLogTable(LogEntry& logEntry)
@@ -189,7 +214,8 @@ std::string decodeParamType(InputParameter::enuType paramType)
 	case InputParameter::enuType::RFIDCard:
 		return "Card";
 
-	// case InputParameter::enuWebPass: // TODO ADD
+	case InputParameter::enuType::WebPass:
+		return "Web";
 	}
 
 	Kernel::Fatal_Error("decodeParamType(...) from DatabaseObject -> invalid parameter type [ " + std::to_string((int)paramType) + " ]!");
@@ -214,6 +240,17 @@ Clearance DatabaseObject::getClearanceFromRFIDCard(const std::string& uuid)
 	return m_pEmployeesTable->SelectClearanceWhereId(ownerId);
 }
 
+Clearance DatabaseObject::getClearanceFromWebPass(const std::string& hash)
+{
+	UID ownerId = m_pWebAPITable->SelectUserId(hash);
+	if (ownerId == 0)
+	{
+		return NO_CLEARANCE;
+	}
+
+	return m_pEmployeesTable->SelectClearanceWhereId(ownerId);
+}
+
 unsigned int DatabaseObject::getUserIdFromPassword(const std::string& password)
 {
 	return m_pKeypadPassTable->SelectOwnerId(password);
@@ -232,6 +269,14 @@ Clearance DatabaseObject::getRequiredClearanceForCommand(CommandMessage::enuComm
 		return MAX_CLEARANCE;
 	}
 
+	// SelectClearance() cannot tell a missing row apart from a stored clearance,
+	// a command the database does not list yet must not be open to everyone
+	if (m_pCommandsTable->SelectId(commandName) == 0)
+	{
+		*m_pLogger << "Command " + commandName + " is not in the commands table, MAX_CLEARANCE required";
+		return MAX_CLEARANCE;
+	}
+
 	Clearance requiredClearance = m_pCommandsTable->SelectClearance(commandName);
 
 	return requiredClearance;
@@ -256,6 +301,9 @@ std::string DatabaseObject::parseCommand(CommandMessage::enuCommand command)
 	case CommandMessage::enuCommand::GUEST_ACCESS_ENABLE:
 	case CommandMessage::enuCommand::GUEST_ACCESS_DISABLE:
 		return "GUEST_ACCESS_CTL";
+
+	case CommandMessage::enuCommand::IMPORT:
+		return "IMPORT";
 	}
 
 	*m_pLogger << "Invalid command type for authorization: (CommandMessage::enuCommand int)" + (int)command;
@@ -276,6 +324,9 @@ Clearance DatabaseObject::getClearance(const InputParameter& authorizationParame
 	case InputParameter::enuType::RFIDCard:
 		return getClearanceFromRFIDCard(parameterData);
 
+	case InputParameter::enuType::WebPass:
+		return getClearanceFromWebPass(parameterData);
+
 	}
 
 	*m_pLogger << "Invalid parameter type for authorization: " + authorizationParameter.getInfo();
@@ -285,6 +336,28 @@ Clearance DatabaseObject::getClearance(const InputParameter& authorizationParame
 
 }
 
+Clearance DatabaseObject::getClearanceAtDoor(const InputParameter& authorizationParameter, DoorId doorId, bool* pKnown)
+{
+	m_pAccessSchedule->Refresh();
+
+	// Same two lookups as getClearance(), keeping the owner ID for the schedule
+	UID userId = getUserId(authorizationParameter);
+	Clearance clearance = m_pEmployeesTable->SelectClearanceWhereId(userId);
+
+	if (pKnown != nullptr)
+	{
+		*pKnown = clearance != NO_CLEARANCE;
+	}
+
+	if (clearance != NO_CLEARANCE && m_pAccessSchedule->isAllowed(userId, doorId, time(nullptr)) == false)
+	{
+		*m_pLogger << "Employee " + std::to_string(userId) + " is outside their access schedule at door " + std::to_string(doorId);
+		return NO_CLEARANCE;
+	}
+
+	return clearance;
+}
+
 unsigned int DatabaseObject::getUserId(const InputParameter& param)
 {
 	InputParameter::enuType paramType = param.getType();
@@ -298,6 +371,9 @@ unsigned int DatabaseObject::getUserId(const InputParameter& param)
 	case InputParameter::enuType::RFIDCard:
 		return getUserIdFromRFIDCard(paramData);
 
+	case InputParameter::enuType::WebPass:
+		return m_pWebAPITable->SelectUserId(paramData);
+
 	}
 
 	Kernel::Fatal_Error("Database Object - getUserId(...) -> invalid parameter type [ " + std::to_string((int)paramType) + " ]");
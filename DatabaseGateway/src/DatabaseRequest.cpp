@@ -25,6 +25,10 @@
 #include "DatabaseRequest.hpp"
 
 #include "ValidationUtils.hpp"
+#include "AccessGuard.hpp"
+#include "propertiesclass.h"
+
+#include <chrono>
 
 DatabaseRequestFactory::DatabaseRequestFactory(DatabaseResources& resources, ILogger* pLogger)
 	: m_resources(resources), m_pLogger(pLogger)
@@ -46,10 +50,10 @@ DatabaseRequestFactory::DatabaseRequestFactory(DatabaseResources& resources, ILo
 		Kernel::Fatal_Error("DatabaseRequestFactory -- pointer to pDatabaseObject cannot be null!");
 	}
 
-	if (resources.m_pLogMailbox == nullptr)
+	if (resources.m_pLogJournal == nullptr)
 	{
-		*m_pLogger << "DatabaseRequestFactory -- pointer to pLogMailbox cannot be null!";
-		Kernel::Fatal_Error("DatabaseRequestFactory -- pointer to pLogMailbox cannot be null!");
+		*m_pLogger << "DatabaseRequestFactory -- pointer to pLogJournal cannot be null!";
+		Kernel::Fatal_Error("DatabaseRequestFactory -- pointer to pLogJournal cannot be null!");
 	}
 
 }
@@ -75,6 +79,11 @@ IDatabaseRequest* DatabaseRequestFactory::createRequestObjectFrom(CommandMessage
 	case CommandMessage::enuCommand::GUEST_ACCESS_DISABLE:
 		return new GuestAccessControl(ppRequestMessage, m_resources, m_pLogger);
 
+	case CommandMessage::enuCommand::IMPORT:
+		return new ImportRequest(ppRequestMessage, m_resources, m_pLogger);
+
+	case CommandMessage::enuCommand::OFFLINE_LOG:
+		return new OfflineLogRequest(ppRequestMessage, m_resources, m_pLogger);
 
 	}
 
@@ -138,12 +147,22 @@ void IDatabaseRequest::Process()
 void IDatabaseRequest::ReplyToRequestSource(DatabaseReply::enuStatus replyStatus)
 {
 
-	MailboxReference destination = m_pRequest->getSource();
-	
 	DatabaseReply reply(replyStatus);
-	
-	m_resources.m_pMailbox->send(destination, &reply);
+	SendReply(reply);
+}
+
+void IDatabaseRequest::SendReply(DatabaseReply& reply)
+{
+	reply.setDoorId(m_pRequest->getDoorId());
+	reply.setRequestId(m_pRequest->getRequestId());
 
+	if (!m_pRequest->getTrace().empty())
+	{
+		reply.setTrace(m_pRequest->getTrace());
+		reply.getTrace().Mark(LatencyTrace::DATABASE_REPLIED);
+	}
+
+	m_resources.m_pMailbox->send(m_pRequest->getSource(), &reply);
 }
 
 
@@ -187,14 +206,36 @@ bool AuthorizeRequest::Authorize()
 void AuthorizeRequest::Execute()
 {
 	InputParameter clientIdentification = m_pRequest->getParameterAt(0);
-	Clearance clientClearance = m_resources.m_pDatabaseObject->getClearance(clientIdentification);
+	const DoorId doorId = m_pRequest->getDoorId();
+
+	// Wall clock, because lockouts are persisted and must outlive a restart
+	const int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	AccessGuard* pGuard = m_resources.m_pAccessGuard;
+	AccessGuard::enuVerdict verdict = (pGuard != nullptr) ? pGuard->Admit(clientIdentification, doorId, now_ms) : AccessGuard::ALLOWED;
+	if (verdict != AccessGuard::ALLOWED)
+	{
+		*m_pLogger << std::string("Authorization at door ") + std::to_string(doorId) + " refused by access guard: " + AccessGuard::toString(verdict);
+		ReplyWithRequestedClearance(NO_CLEARANCE);
+		return;
+	}
+
+	bool knownCredential = false;
+	Clearance clientClearance = m_resources.m_pDatabaseObject->getClearanceAtDoor(clientIdentification, doorId, &knownCredential);
+	if (pGuard != nullptr)
+	{
+		const AccessGuard::enuOutcome outcome = (clientClearance != NO_CLEARANCE) ? AccessGuard::GRANTED
+			: knownCredential ? AccessGuard::DENIED : AccessGuard::UNKNOWN_CREDENTIAL;
+		pGuard->Record(clientIdentification, doorId, outcome, now_ms);
+	}
+
 	ReplyWithRequestedClearance(clientClearance);
 }
 
 void AuthorizeRequest::ReplyWithRequestedClearance(Clearance clearance)
 {
 	DatabaseReply reply(clearance);
-	m_resources.m_pMailbox->send(m_pRequest->getSource(), &reply);
+	SendReply(reply);
 }
 
 void AuthorizeRequest::Log()
@@ -492,4 +533,108 @@ void GuestAccessControl::Log()
 }
 
 
+bool ImportRequest::Validate()
+{
+	bool parameterCountCondition = hasParameterCount(m_pRequest, 2);
+	if (parameterCountCondition == false)
+	{
+		*m_pLogger << "Parameter count validation failed!";
+		return false;
+	}
+
+	InputParameter param1 = m_pRequest->getParameterAt(0);
+	InputParameter param2 = m_pRequest->getParameterAt(1);
+
+	// The spool name is joined to the database path, anything but a name made by ImportSpool is refused
+	bool param1Valid = isParameterValid(param1, { InputParameter::enuType::PlainData }) && ImportSpool::isValidName(param1.getData());
+	bool param2Valid = isParameterValid(param2, { InputParameter::enuType::WebPass });
+
+	bool parametersValidCondition = param1Valid && param2Valid;
+	if (parametersValidCondition == false)
+	{
+		std::stringstream logStringBuilder;
+		logStringBuilder.str("");
+
+		logStringBuilder << "Parameter validation falied:\n"
+			<< "Param1 [" << param1Valid << " ]\n"
+			<< "Param2 [" << param2Valid << " ]\n";
+
+		*m_pLogger << logStringBuilder.str();
+	}
+
+	return parametersValidCondition && m_resources.m_pBulkImporter != nullptr;
+}
+
+bool ImportRequest::Authorize()
+{
+	CommandMessage::enuCommand requestedCommand = m_pRequest->getCommandId();
+	Clearance requiredClearance = m_resources.m_pDatabaseObject->getRequiredClearanceForCommand(requestedCommand);
+
+	InputParameter clientCredentials = m_pRequest->getParameterAt(1);
+	Clearance clientClearance = m_resources.m_pDatabaseObject->getClearance(clientCredentials);
+
+	return clientClearance >= requiredClearance;
+}
+
+void ImportRequest::Execute()
+{
+	const std::string spoolPath = ImportSpool::getPath(GlobalProperties::Get().DB_PATH, m_pRequest->getParameterAt(0).getData());
+
+	// Committing a batch takes long enough to stall authorization, BulkImporter replies when it is done
+	m_resources.m_pBulkImporter->Submit(spoolPath, *m_pRequest);
+}
+
+void ImportRequest::Log()
+{
+	const InputParameter& userCredentials = m_pRequest->getParameterAt(1);
+	m_resources.m_pDatabaseObject->CreateLog(CommandMessage::enuCommand::IMPORT, userCredentials);
+}
+
 
+bool OfflineLogRequest::Validate()
+{
+	bool parameterCountCondition = hasParameterCount(m_pRequest, 2);
+	if (parameterCountCondition == false)
+	{
+		*m_pLogger << "Parameter count validation failed!";
+		return false;
+	}
+
+	InputParameter param1 = m_pRequest->getParameterAt(0);
+	InputParameter param2 = m_pRequest->getParameterAt(1);
+
+	bool param1Valid = isParameterValid(param1, { InputParameter::enuType::KeypadPIN, InputParameter::enuType::RFIDCard });
+	bool param2Valid = isParameterType(param2, { InputParameter::enuType::PlainData }) && isValidTimestamp(param2.getData());
+
+	if (param1Valid == false || param2Valid == false)
+	{
+		*m_pLogger << "Parameter validation failed!";
+		return false;
+	}
+
+	return true;
+}
+
+bool OfflineLogRequest::Authorize()
+{
+	// The door already acted on the decision, the record is accepted whatever the credential is worth now,
+	// but only MainApplication decides offline; anyone else could write grants into the access log
+	if (m_pRequest->getSource().getName() != GlobalProperties::Get().MAIN_MB_NAME)
+	{
+		*m_pLogger << "Offline log record from " + m_pRequest->getSource().getName() + " refused";
+		return false;
+	}
+
+	return true;
+}
+
+void OfflineLogRequest::Execute()
+{
+	// MainApplication does not wait for a reply, it forgets the record once it is sent
+}
+
+void OfflineLogRequest::Log()
+{
+	const InputParameter& userCredentials = m_pRequest->getParameterAt(0);
+	m_resources.m_pDatabaseObject->CreateOfflineLog(userCredentials, m_pRequest->getParameterAt(1).getData());
+}
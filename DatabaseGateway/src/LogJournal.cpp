@@ -0,0 +1,728 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "LogJournal.hpp"
+#include "Kernel.hpp"
+#include "propertiesclass.h"
+#include "propertiesimage.h"
+
+#include <cstddef>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+	/// Oldest record not yet in LogTable, checksum over the two fields before it
+	struct JournalHead
+	{
+		uint64_t m_sequence;
+		uint64_t m_offset;
+		uint32_t m_checksum;
+		uint32_t m_reserved;
+	};
+
+	struct JournalHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		uint64_t m_capacity;
+		uint64_t m_id;
+		/// Incremented by every open, records carry the generation they were appended in
+		uint64_t m_generation;
+		JournalHead m_heads[2];
+	};
+
+	struct RecordHeader
+	{
+		/// Payload bytes, or WRAP where the writer continued at the beginning of the ring
+		uint32_t m_length;
+		/// CRC32 of the payload
+		uint32_t m_checksum;
+	};
+
+	const uint32_t MAGIC = 0x4A4C464E; // "NFLJ" on little-endian hosts
+	const uint32_t VERSION = 1;
+	const uint32_t WRAP = 0xFFFFFFFFu;
+
+	/// Fixed part of the payload, followed by the timestamp and the authorization method
+	struct Payload
+	{
+		uint64_t m_sequence;
+		uint32_t m_generation;
+		uint32_t m_userId;
+		uint32_t m_commandId;
+		uint16_t m_timestampSize;
+		uint16_t m_methodSize;
+	} __attribute__((packed));
+
+	const size_t ALIGNMENT = 8;
+
+	uint32_t headChecksum(const JournalHead& head)
+	{
+		return PropertiesImage::Checksum(&head, offsetof(JournalHead, m_checksum));
+	}
+}
+
+LogJournal::LogJournal(const std::string& path, size_t capacity, ILogger* pLogger)
+	: m_path(path), m_pLogger(pLogger),
+	m_records(MetricsRegistry::Process().getGauge("database.log_journal.records")),
+	m_full(MetricsRegistry::Process().getCounter("database.log_journal.full"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	// Whole records only, the ring never ends in the middle of the alignment
+	capacity -= capacity % ALIGNMENT;
+
+	if (m_path.empty() || capacity < recordSize(0, 0) || !open(capacity))
+	{
+		*m_pLogger << "LogJournal -- cannot open " + m_path;
+		Kernel::Fatal_Error("LogJournal -- cannot open " + m_path);
+	}
+}
+
+LogJournal::~LogJournal()
+{
+	if (m_pMapping != nullptr)
+	{
+		munmap(m_pMapping, m_mappingSize);
+	}
+
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+}
+
+bool LogJournal::open(size_t capacity)
+{
+	m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStatus;
+	if (fstat(m_fd, &fileStatus) < 0)
+	{
+		return false;
+	}
+
+	const size_t fileSize = static_cast<size_t>(fileStatus.st_size);
+	if (fileSize < sizeof(JournalHeader))
+	{
+		return create(capacity);
+	}
+
+	m_mappingSize = fileSize;
+	void* pMapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (pMapping == MAP_FAILED)
+	{
+		m_pMapping = nullptr;
+		return false;
+	}
+	m_pMapping = static_cast<char*>(pMapping);
+
+	const JournalHeader* pHeader = reinterpret_cast<const JournalHeader*>(m_pMapping);
+	if (pHeader->m_magic != MAGIC || pHeader->m_version != VERSION
+		|| pHeader->m_capacity % ALIGNMENT != 0 || pHeader->m_capacity != fileSize - sizeof(JournalHeader))
+	{
+		*m_pLogger << "LogJournal -- " + m_path + " is not a journal of this version, it is recreated";
+		Kernel::Warning("LogJournal -- " + m_path + " is not a journal of this version, it is recreated");
+		return create(capacity);
+	}
+
+	m_pRing = m_pMapping + sizeof(JournalHeader);
+	m_capacity = static_cast<size_t>(pHeader->m_capacity);
+	m_id = pHeader->m_id;
+
+	recover();
+
+	// Records appended from now on are newer than anything left behind the recovered ones
+	JournalHeader* pWritableHeader = reinterpret_cast<JournalHeader*>(m_pMapping);
+	m_generation = static_cast<uint32_t>(pWritableHeader->m_generation + 1);
+	pWritableHeader->m_generation = m_generation;
+
+	// A new size takes effect once nothing would be lost by it
+	if (m_count == 0 && m_capacity != capacity)
+	{
+		const uint64_t nextSequence = m_headSequence;
+		if (!create(capacity))
+		{
+			return false;
+		}
+		m_headSequence = nextSequence;
+		writeHead();
+	}
+
+	*m_pLogger << "LogJournal -- " + m_path + " recovered " + std::to_string(m_count) + " logs from sequence " + std::to_string(m_headSequence);
+	return true;
+}
+
+bool LogJournal::create(size_t capacity)
+{
+	if (m_pMapping != nullptr)
+	{
+		munmap(m_pMapping, m_mappingSize);
+		m_pMapping = nullptr;
+	}
+
+	// Truncating first zeroes the file, no record of a previous journal can be recovered from it
+	m_mappingSize = sizeof(JournalHeader) + capacity;
+	if (ftruncate(m_fd, 0) < 0 || ftruncate(m_fd, static_cast<off_t>(m_mappingSize)) < 0)
+	{
+		return false;
+	}
+
+	void* pMapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (pMapping == MAP_FAILED)
+	{
+		return false;
+	}
+	m_pMapping = static_cast<char*>(pMapping);
+	m_pRing = m_pMapping + sizeof(JournalHeader);
+	m_capacity = capacity;
+
+	std::random_device random;
+	m_id = (static_cast<uint64_t>(random()) << 32) | random();
+
+	m_head = 0;
+	m_tail = 0;
+	m_count = 0;
+	m_headSequence = 1;
+	m_nextHeadSlot = 0;
+	m_generation = 1;
+
+	JournalHeader* pHeader = reinterpret_cast<JournalHeader*>(m_pMapping);
+	pHeader->m_capacity = m_capacity;
+	pHeader->m_id = m_id;
+	pHeader->m_generation = m_generation;
+	pHeader->m_version = VERSION;
+	writeHead();
+	// Last, a journal killed while being created is recreated on the next start
+	pHeader->m_magic = MAGIC;
+
+	return true;
+}
+
+void LogJournal::recover()
+{
+	const JournalHeader* pHeader = reinterpret_cast<const JournalHeader*>(m_pMapping);
+
+	// The newer valid copy of the head; the other one may be torn by a crash while committing
+	int newest = -1;
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		const JournalHead& head = pHeader->m_heads[slot];
+		if (head.m_checksum == headChecksum(head) && head.m_offset <= m_capacity
+			&& (newest < 0 || head.m_sequence > pHeader->m_heads[newest].m_sequence))
+		{
+			newest = slot;
+		}
+	}
+
+	m_head = 0;
+	m_headSequence = 1;
+	m_nextHeadSlot = 0;
+	if (newest >= 0)
+	{
+		m_head = static_cast<size_t>(pHeader->m_heads[newest].m_offset);
+		m_headSequence = pHeader->m_heads[newest].m_sequence;
+		m_nextHeadSlot = newest ^ 1;
+	}
+
+	// The ring cannot hold more records than this, so a loop of stale records cannot make recovery run forever
+	const size_t maxCount = m_capacity / recordSize(0, 0);
+
+	// A record appended over a torn one may be followed by the rest of the records which were behind it before:
+	// their sequence numbers fit, but they are of an older generation, so they end the journal
+	size_t offset = m_head;
+	uint32_t generation = 0;
+	m_count = 0;
+	while (m_count < maxCount)
+	{
+		const size_t recordOffset = skipWrap(offset);
+		size_t size = 0;
+		if (!decode(recordOffset, m_headSequence + m_count, nullptr, size, generation))
+		{
+			break;
+		}
+		offset = recordOffset + size;
+		++m_count;
+	}
+
+	m_tail = offset;
+	if (m_count == 0)
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	m_records.Set(static_cast<int64_t>(m_count));
+}
+
+void LogJournal::writeHead()
+{
+	JournalHeader* pHeader = reinterpret_cast<JournalHeader*>(m_pMapping);
+	JournalHead& head = pHeader->m_heads[m_nextHeadSlot];
+
+	head.m_sequence = m_headSequence;
+	head.m_offset = m_head;
+	head.m_reserved = 0;
+	head.m_checksum = headChecksum(head);
+
+	m_nextHeadSlot ^= 1;
+}
+
+size_t LogJournal::recordSize(size_t timestampSize, size_t methodSize)
+{
+	const size_t size = sizeof(RecordHeader) + sizeof(Payload) + timestampSize + methodSize;
+	return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+size_t LogJournal::skipWrap(size_t offset) const
+{
+	if (m_capacity - offset < sizeof(RecordHeader))
+	{
+		return 0;
+	}
+
+	uint32_t length;
+	std::memcpy(&length, m_pRing + offset, sizeof(length));
+	return length == WRAP ? 0 : offset;
+}
+
+bool LogJournal::decode(size_t offset, uint64_t sequence, JournaledLog* pLog, size_t& size, uint32_t& generation) const
+{
+	if (m_capacity - offset < recordSize(0, 0))
+	{
+		return false;
+	}
+
+	RecordHeader record;
+	std::memcpy(&record, m_pRing + offset, sizeof(record));
+
+	const char* pPayload = m_pRing + offset + sizeof(RecordHeader);
+	if (record.m_length < sizeof(Payload) || record.m_length > m_capacity - offset - sizeof(RecordHeader))
+	{
+		return false;
+	}
+
+	Payload payload;
+	std::memcpy(&payload, pPayload, sizeof(payload));
+	if (payload.m_sequence != sequence || payload.m_generation < generation
+		|| record.m_length != sizeof(Payload) + payload.m_timestampSize + payload.m_methodSize
+		|| record.m_checksum != PropertiesImage::Checksum(pPayload, record.m_length))
+	{
+		return false;
+	}
+
+	size = recordSize(payload.m_timestampSize, payload.m_methodSize);
+	generation = payload.m_generation;
+
+	if (pLog != nullptr)
+	{
+		const char* pStrings = pPayload + sizeof(Payload);
+		pLog->m_sequence = payload.m_sequence;
+		pLog->m_userId = payload.m_userId;
+		pLog->m_commandId = payload.m_commandId;
+		pLog->m_timestamp.assign(pStrings, payload.m_timestampSize);
+		pLog->m_authMethod.assign(pStrings + payload.m_timestampSize, payload.m_methodSize);
+	}
+
+	return true;
+}
+
+bool LogJournal::fits(size_t size, size_t& offset) const
+{
+	if (m_count == 0)
+	{
+		offset = 0;
+		return size <= m_capacity;
+	}
+
+	// Records from head to the end of the ring, then from its beginning up to tail; head == tail is a full ring
+	if (m_tail > m_head)
+	{
+		if (m_capacity - m_tail >= size)
+		{
+			offset = m_tail;
+			return true;
+		}
+
+		offset = 0;
+		return m_head >= size;
+	}
+
+	offset = m_tail;
+	return m_head - m_tail >= size;
+}
+
+LogJournal::enuAppendResult LogJournal::Append(const std::string& timestamp, unsigned int userId, const std::string& authMethod, unsigned int commandId, std::chrono::milliseconds wait)
+{
+	if (timestamp.size() > UINT16_MAX || authMethod.size() > UINT16_MAX)
+	{
+		m_full.Increment();
+		return FULL;
+	}
+
+	const size_t size = recordSize(timestamp.size(), authMethod.size());
+	const auto deadline = std::chrono::steady_clock::now() + wait;
+
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	size_t offset = 0;
+	while (!fits(size, offset))
+	{
+		if (size > m_capacity || m_committed.wait_until(lock, deadline) == std::cv_status::timeout)
+		{
+			if (fits(size, offset))
+			{
+				break;
+			}
+			m_full.Increment();
+			return FULL;
+		}
+	}
+
+	if (m_count != 0 && offset < m_tail && m_capacity - m_tail >= sizeof(RecordHeader))
+	{
+		const uint32_t wrap = WRAP;
+		std::memcpy(m_pRing + m_tail, &wrap, sizeof(wrap));
+	}
+
+	Payload payload;
+	payload.m_sequence = m_headSequence + m_count;
+	payload.m_generation = m_generation;
+	payload.m_userId = userId;
+	payload.m_commandId = commandId;
+	payload.m_timestampSize = static_cast<uint16_t>(timestamp.size());
+	payload.m_methodSize = static_cast<uint16_t>(authMethod.size());
+
+	char* pPayload = m_pRing + offset + sizeof(RecordHeader);
+	std::memcpy(pPayload, &payload, sizeof(payload));
+	std::memcpy(pPayload + sizeof(payload), timestamp.data(), timestamp.size());
+	std::memcpy(pPayload + sizeof(payload) + timestamp.size(), authMethod.data(), authMethod.size());
+
+	RecordHeader record;
+	record.m_length = static_cast<uint32_t>(sizeof(payload) + timestamp.size() + authMethod.size());
+	record.m_checksum = PropertiesImage::Checksum(pPayload, record.m_length);
+	std::memcpy(m_pRing + offset, &record, sizeof(record));
+
+	m_tail = offset + size;
+	++m_count;
+	m_records.Set(static_cast<int64_t>(m_count));
+
+	m_appended.notify_all();
+	return APPENDED;
+}
+
+size_t LogJournal::Read(std::vector<JournaledLog>& logs, size_t maxCount, std::chrono::milliseconds wait)
+{
+	logs.clear();
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	if (!m_appended.wait_for(lock, wait, [this]() { return m_count != 0; }))
+	{
+		return 0;
+	}
+
+	size_t offset = m_head;
+	while (logs.size() < maxCount && logs.size() < m_count)
+	{
+		const size_t recordOffset = skipWrap(offset);
+		JournaledLog log;
+		size_t size = 0;
+		uint32_t generation = 0;
+		if (!decode(recordOffset, m_headSequence + logs.size(), &log, size, generation))
+		{
+			// Only this process writes the mapping, a record it appended cannot be corrupted
+			Kernel::Fatal_Error("LogJournal -- record " + std::to_string(m_headSequence + logs.size()) + " of " + m_path + " is corrupted");
+			break;
+		}
+		logs.push_back(std::move(log));
+		offset = recordOffset + size;
+	}
+
+	return logs.size();
+}
+
+void LogJournal::Commit(uint64_t sequence)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	if (m_count == 0 || sequence < m_headSequence)
+	{
+		return;
+	}
+
+	while (m_count != 0 && m_headSequence <= sequence)
+	{
+		const size_t recordOffset = skipWrap(m_head);
+		size_t size = 0;
+		uint32_t generation = 0;
+		if (!decode(recordOffset, m_headSequence, nullptr, size, generation))
+		{
+			Kernel::Fatal_Error("LogJournal -- record " + std::to_string(m_headSequence) + " of " + m_path + " is corrupted");
+			break;
+		}
+		m_head = recordOffset + size;
+		++m_headSequence;
+		--m_count;
+	}
+
+	// Truncated: the next record starts the file again and the pages of the old ones can be reused
+	if (m_count == 0)
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	writeHead();
+	m_records.Set(static_cast<int64_t>(m_count));
+
+	m_committed.notify_all();
+}
+
+uint64_t LogJournal::getHeadSequence() const
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	return m_headSequence;
+}
+
+size_t LogJournal::getCount() const
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	return m_count;
+}
+
+
+const char* const LogJournalReplay::CREATE_TABLES =
+	"CREATE TABLE IF NOT EXISTS LogJournalCommit ("
+	"Id INTEGER PRIMARY KEY CHECK (Id = 0), "
+	"JournalId INTEGER NOT NULL, "
+	"Sequence INTEGER NOT NULL);";
+
+LogJournalReplay::LogJournalReplay(LogJournal& journal, const std::string& databasePath, std::mutex& writeLock, ILogger* pLogger)
+	: m_journal(journal), m_databasePath(databasePath), m_writeLock(writeLock), m_pLogger(pLogger),
+	m_writeLatency(MetricsRegistry::Process().getHistogram("database.log_write_ns")),
+	m_rejected(MetricsRegistry::Process().getCounter("database.log_journal.rejected"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	if (sqlite3_open_v2(m_databasePath.c_str(), &m_pDatabase, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+	{
+		*m_pLogger << "LogJournalReplay -- cannot open " + m_databasePath;
+		Kernel::Fatal_Error("LogJournalReplay -- cannot open " + m_databasePath);
+	}
+	sqlite3_busy_timeout(m_pDatabase, BUSY_TIMEOUT_MS);
+
+	if (!prepare())
+	{
+		*m_pLogger << std::string("LogJournalReplay -- cannot prepare the log statements: ") + sqlite3_errmsg(m_pDatabase);
+		Kernel::Fatal_Error(std::string("LogJournalReplay -- cannot prepare the log statements: ") + sqlite3_errmsg(m_pDatabase));
+	}
+
+	// Logs written just before the previous process died, but not yet committed in the journal
+	if (m_committedSequence >= m_journal.getHeadSequence())
+	{
+		*m_pLogger << "LogJournalReplay -- logs up to " + std::to_string(m_committedSequence) + " are in the log table already";
+		m_journal.Commit(m_committedSequence);
+	}
+}
+
+LogJournalReplay::~LogJournalReplay()
+{
+	sqlite3_finalize(m_pInsertLog);
+	sqlite3_finalize(m_pSetCommitted);
+	sqlite3_close(m_pDatabase);
+}
+
+bool LogJournalReplay::prepare()
+{
+	if (sqlite3_exec(m_pDatabase, CREATE_TABLES, nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		return false;
+	}
+
+	sqlite3_stmt* pSelect = nullptr;
+	if (sqlite3_prepare_v2(m_pDatabase, "SELECT JournalId, Sequence FROM LogJournalCommit WHERE Id = 0;", -1, &pSelect, nullptr) != SQLITE_OK)
+	{
+		return false;
+	}
+
+	// Sequence numbers of a recreated journal start again, the ones recorded for the old journal mean nothing
+	if (sqlite3_step(pSelect) == SQLITE_ROW && static_cast<uint64_t>(sqlite3_column_int64(pSelect, 0)) == m_journal.getId())
+	{
+		m_committedSequence = static_cast<uint64_t>(sqlite3_column_int64(pSelect, 1));
+	}
+	sqlite3_finalize(pSelect);
+
+	const Properties& properties = GlobalProperties::Get();
+
+	/*======================================================
+
+		INSERT INTO LogTable(Timestamp, UserId, AuthMethod, CommandId)
+		VALUES (?1, ?2, ?3, ?4);
+
+		INSERT INTO LogJournalCommit(Id, JournalId, Sequence) VALUES (0, ?1, ?2)
+		ON CONFLICT(Id) DO UPDATE SET JournalId = excluded.JournalId, Sequence = excluded.Sequence;
+
+	  ======================================================*/
+
+	const std::string insertLog = "INSERT INTO " + properties.LOG_TABLE_NAME + "("
+		+ properties.LOG_TABLE_TIMESTAMP_COLUMN_NAME + ", " + properties.LOG_TABLE_USER_ID_COLUMN_NAME + ", "
+		+ properties.LOG_TABLE_AUTH_METHOD_COLUMN_NAME + ", " + properties.LOG_TABLE_COMMAND_ID_COLUMN_NAME + ") "
+		"VALUES (?1, ?2, ?3, ?4);";
+
+	return sqlite3_prepare_v2(m_pDatabase, insertLog.c_str(), -1, &m_pInsertLog, nullptr) == SQLITE_OK
+		&& sqlite3_prepare_v2(m_pDatabase, "INSERT INTO LogJournalCommit(Id, JournalId, Sequence) VALUES (0, ?1, ?2) "
+			"ON CONFLICT(Id) DO UPDATE SET JournalId = excluded.JournalId, Sequence = excluded.Sequence;", -1, &m_pSetCommitted, nullptr) == SQLITE_OK;
+}
+
+size_t LogJournalReplay::ReplayBatch(size_t maxCount, std::chrono::milliseconds wait)
+{
+	const bool isolating = m_journal.getHeadSequence() <= m_suspectSequence;
+	if (m_journal.Read(m_batch, isolating ? 1 : maxCount, wait) == 0)
+	{
+		return 0;
+	}
+
+	bool written;
+	{
+		ScopedLatency latency(m_writeLatency);
+		written = writeBatch(m_batch);
+	}
+
+	if (!written)
+	{
+		if (!isRejection(m_lastError) || ++m_failedAttempts < MAX_BATCH_ATTEMPTS)
+		{
+			*m_pLogger << "LogJournalReplay -- cannot write logs to the log table, retrying: " + m_lastErrorMessage;
+			// The logs stay journaled; do not spin on a locked or full database
+			std::this_thread::sleep_for(wait);
+			return 0;
+		}
+
+		m_failedAttempts = 0;
+		if (m_batch.size() > 1)
+		{
+			// Some log of the batch is rejected every time, writing them one at a time finds it
+			m_suspectSequence = m_batch.back().m_sequence;
+			*m_pLogger << "LogJournalReplay -- logs up to " + std::to_string(m_suspectSequence) + " are written one at a time: " + m_lastErrorMessage;
+			return 0;
+		}
+
+		skipRejected(m_batch.front());
+		return 0;
+	}
+
+	m_failedAttempts = 0;
+	m_committedSequence = m_batch.back().m_sequence;
+	m_journal.Commit(m_committedSequence);
+
+	return m_batch.size();
+}
+
+void LogJournalReplay::skipRejected(const JournaledLog& log)
+{
+	const std::string message = "LogJournalReplay -- log " + std::to_string(log.m_sequence) + " is rejected by the log table and skipped ("
+		+ m_lastErrorMessage + "): timestamp " + log.m_timestamp + ", user " + std::to_string(log.m_userId)
+		+ ", method " + log.m_authMethod + ", command " + std::to_string(log.m_commandId);
+	*m_pLogger << message;
+	Kernel::Warning(message);
+
+	m_rejected.Increment();
+	m_journal.Commit(log.m_sequence);
+}
+
+bool LogJournalReplay::isRejection(int error)
+{
+	switch (error & 0xFF)
+	{
+	case SQLITE_CONSTRAINT:
+	case SQLITE_MISMATCH:
+	case SQLITE_TOOBIG:
+		return true;
+	}
+	return false;
+}
+
+bool LogJournalReplay::writeBatch(const std::vector<JournaledLog>& logs)
+{
+	std::unique_lock<std::mutex> writeLock(m_writeLock);
+
+	// IMMEDIATE takes the write lock up front instead of failing to upgrade a read transaction later
+	if (sqlite3_exec(m_pDatabase, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+	{
+		m_lastError = sqlite3_extended_errcode(m_pDatabase);
+		m_lastErrorMessage = sqlite3_errmsg(m_pDatabase);
+		return false;
+	}
+
+	bool success = true;
+	for (const JournaledLog& log : logs)
+	{
+		sqlite3_bind_text(m_pInsertLog, 1, log.m_timestamp.c_str(), static_cast<int>(log.m_timestamp.size()), SQLITE_STATIC);
+		sqlite3_bind_int64(m_pInsertLog, 2, log.m_userId);
+		sqlite3_bind_text(m_pInsertLog, 3, log.m_authMethod.c_str(), static_cast<int>(log.m_authMethod.size()), SQLITE_STATIC);
+		sqlite3_bind_int64(m_pInsertLog, 4, log.m_commandId);
+
+		success = sqlite3_step(m_pInsertLog) == SQLITE_DONE;
+		sqlite3_reset(m_pInsertLog);
+		if (!success)
+		{
+			break;
+		}
+	}
+
+	if (success)
+	{
+		sqlite3_bind_int64(m_pSetCommitted, 1, static_cast<sqlite3_int64>(m_journal.getId()));
+		sqlite3_bind_int64(m_pSetCommitted, 2, static_cast<sqlite3_int64>(logs.back().m_sequence));
+		success = sqlite3_step(m_pSetCommitted) == SQLITE_DONE;
+		sqlite3_reset(m_pSetCommitted);
+	}
+
+	if (success && sqlite3_exec(m_pDatabase, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK)
+	{
+		return true;
+	}
+
+	m_lastError = sqlite3_extended_errcode(m_pDatabase);
+	m_lastErrorMessage = sqlite3_errmsg(m_pDatabase);
+	sqlite3_exec(m_pDatabase, "ROLLBACK;", nullptr, nullptr, nullptr);
+	return false;
+}
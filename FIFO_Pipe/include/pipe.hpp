@@ -31,6 +31,10 @@
 #include<sys/types.h>
 #include<sys/stat.h>
 #include<fcntl.h>
+#include<limits.h>
+#include<string>
+#include<vector>
+#include<deque>
 
 /*extern mqd_t statusQueueId;
 extern char* process_name;*/
@@ -48,9 +52,57 @@ typedef struct mq_attr mq_attr;
 
 
 
+/**
+ * @brief Typed message sent through a Pipe as one frame
+ *
+ * Frame layout: data length (2 B, little endian), type (1 B), data.
+ * Frames are never larger than PIPE_BUF, so `Pipe::sendMessage()` writes each one atomically
+ * even when several writers share a FIFO.
+ */
+class PipeMessage
+{
+public:
+
+    typedef enum : unsigned char
+    {
+        Empty           = 0,
+        KeypadData      = 'D',  ///< Buffered keypad characters
+        KeypadEnter     = 'E',  ///< Enter pressed with an empty buffer
+        KeypadBackspace = 'B',  ///< Backspace pressed with an empty buffer
+        KeypadReset     = 'R',  ///< Backspace + Enter chord
+        RFIDCard        = 'C'   ///< Card UUID read by an RFID reader
+    } enuType;
+
+    static const size_t HEADER_SIZE = 3;
+    static const size_t MAX_DATA_SIZE = PIPE_BUF - HEADER_SIZE;
+
+    PipeMessage()
+        : m_type(Empty), m_data("")
+    {}
+
+    PipeMessage(enuType type, const std::string& data = "")
+        : m_type(type), m_data(data)
+    {}
+
+    enuType getType() const { return m_type; }
+    const std::string& getData() const { return m_data; }
+
+    /// Returns true if `type` is one of the `enuType` values (other than `Empty`)
+    static bool isValidType(unsigned char type);
+
+private:
+    enuType m_type;
+    std::string m_data;
+};
+
+
+
 /**
  * @brief Pipe wrapper class
  * 
+ * `send()`/`receive()` transfer raw strings: messages written in quick succession can be
+ * merged or split by the reader. `sendMessage()`/`receiveMessage()` use `PipeMessage` frames,
+ * which are reassembled across reads and never merged. Do not mix both on one FIFO.
  */
 class Pipe
 {
@@ -62,6 +114,19 @@ private:
                  ILogger* p_parentLogger = NULL;
             std::string  pathname        = "";
 
+    /// Bytes of an incomplete frame left over from the last read
+    std::string              m_partialFrame;
+    /// Complete frames which were read but not yet returned by `receiveMessage()`
+    std::deque<PipeMessage>  m_pendingMessages;
+    /// Read buffer, large enough to drain a full FIFO (64 KiB on Linux) in one read()
+    std::vector<char>        m_readBuffer;
+
+    /// Appends the frame for `message` to `frame`. Returns false if the message is too large.
+    bool encodeFrame(const PipeMessage& message, std::string& frame);
+
+    /// Writes all `count` buffers, continuing after partial writes
+    void writeAll(struct iovec* pBuffers, int count);
+
 
 
 
@@ -113,6 +178,44 @@ public:
      */
     std::string receive (void);
 
+    /**
+     * @brief Send one framed message with a single write()
+     *
+     * @param message Message to send. Messages larger than `PipeMessage::MAX_DATA_SIZE` are dropped with a warning.
+     */
+    void sendMessage    (const PipeMessage& message);
+
+    /**
+     * @brief Send several framed messages with as few write() calls as possible
+     *
+     * Frames are packed into writes of at most PIPE_BUF bytes, so other writers of the FIFO may put their
+     * frames between two writes of a batch, but never inside a frame.
+     *
+     * @param messages Messages to send, in order
+     */
+    void sendMessages   (const std::vector<PipeMessage>& messages);
+
+    /**
+     * @brief Read everything currently available and append every complete frame to `messages`
+     *
+     * Messages already read by an earlier `receiveMessage()` call are returned first.
+     * Incomplete frames are kept and completed by a later read.
+     * @return Number of messages appended
+     */
+    size_t receiveMessages(std::vector<PipeMessage>& messages);
+
+    /**
+     * @brief Get the next framed message
+     *
+     * @param message Filled with the next message
+     * @return false if no complete message is available
+     */
+    bool receiveMessage (PipeMessage& message);
+
+    /// Returns true if messages were already read from the FIFO and are waiting in `receiveMessage()`.
+    /// poll() on `getFd()` does not report these.
+    bool hasPendingMessages() const { return !m_pendingMessages.empty(); }
+
     /// Returns the file descriptor of the pipe
     int getFd() const { return fd; }
 
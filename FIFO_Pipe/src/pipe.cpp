@@ -30,8 +30,10 @@
 #include<string.h>
 #include<errno.h>
 #include<string>
+#include<algorithm>
 #include<sys/stat.h>
 #include<fcntl.h>
+#include<sys/uio.h>
 
 #include"propertiesclass.h"
 
@@ -155,3 +157,173 @@ std::string Pipe::receive(void)
     return result;
 }
 
+
+
+
+bool PipeMessage::isValidType(unsigned char type)
+{
+    switch (type)
+    {
+    case KeypadData:
+    case KeypadEnter:
+    case KeypadBackspace:
+    case KeypadReset:
+    case RFIDCard:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool Pipe::encodeFrame(const PipeMessage& message, std::string& frame)
+{
+    const std::string& data = message.getData();
+    if (data.size() > PipeMessage::MAX_DATA_SIZE)
+    {
+        Kernel::Warning(pathname + " - message of " + std::to_string(data.size()) + " B is too large for a frame, dropped");
+        return false;
+    }
+
+    frame += (char)(data.size() & 0xFF);
+    frame += (char)(data.size() >> 8);
+    frame += (char)message.getType();
+    frame += data;
+    return true;
+}
+
+void Pipe::writeAll(struct iovec* pBuffers, int count)
+{
+    while (count > 0)
+    {
+        ssize_t written = writev(fd, pBuffers, count);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            Kernel::Fatal_Error("Cannot write to a pipe " + pathname);
+        }
+
+        // Skip fully written buffers, advance into a partially written one
+        while (count > 0 && (size_t)written >= pBuffers->iov_len)
+        {
+            written -= pBuffers->iov_len;
+            ++pBuffers;
+            --count;
+        }
+
+        if (count > 0)
+        {
+            pBuffers->iov_base = (char*)pBuffers->iov_base + written;
+            pBuffers->iov_len -= written;
+        }
+    }
+}
+
+void Pipe::sendMessage(const PipeMessage& message)
+{
+    std::string frame;
+    if (!encodeFrame(message, frame)) return;
+
+    struct iovec buffer = { (void*)frame.data(), frame.size() };
+    writeAll(&buffer, 1);
+}
+
+void Pipe::sendMessages(const std::vector<PipeMessage>& messages)
+{
+    // Frames are packed into chunks of at most PIPE_BUF bytes
+    std::vector<std::string> chunks(1);
+    for (const PipeMessage& message : messages)
+    {
+        if (chunks.back().size() + PipeMessage::HEADER_SIZE + message.getData().size() > PIPE_BUF)
+        {
+            chunks.emplace_back();
+        }
+        encodeFrame(message, chunks.back());
+    }
+
+    // One write() per chunk: writes of at most PIPE_BUF bytes are atomic, so frames of
+    // other writers sharing the FIFO can only come between chunks, never inside one
+    for (const std::string& chunk : chunks)
+    {
+        if (chunk.empty()) continue;
+
+        struct iovec buffer = { (void*)chunk.data(), chunk.size() };
+        writeAll(&buffer, 1);
+    }
+}
+
+size_t Pipe::receiveMessages(std::vector<PipeMessage>& messages)
+{
+    const size_t initialSize = messages.size();
+
+    while (!m_pendingMessages.empty())
+    {
+        messages.push_back(std::move(m_pendingMessages.front()));
+        m_pendingMessages.pop_front();
+    }
+
+    if(fd < 0 || (openMode != Kernel::IOMode::READ && openMode != Kernel::IOMode::READ_NONBLOCKING) )
+    {
+        *p_parentLogger << "Pipe not open for receiving";
+        return messages.size() - initialSize;
+    }
+
+    if (m_readBuffer.empty()) m_readBuffer.resize(64 * 1024);
+
+    while (true)
+    {
+        ssize_t size = read(fd, m_readBuffer.data(), m_readBuffer.size());
+        if (size < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) Kernel::Warning("Pipe cannot read message - " + pathname);
+            break;
+        }
+
+        m_partialFrame.append(m_readBuffer.data(), size);
+
+        // A blocking read() must not be repeated, it would wait for the next writer
+        if ((size_t)size < m_readBuffer.size() || openMode != Kernel::IOMode::READ_NONBLOCKING) break;
+    }
+
+    size_t offset = 0;
+    while (m_partialFrame.size() - offset >= PipeMessage::HEADER_SIZE)
+    {
+        const unsigned char* pHeader = (const unsigned char*)m_partialFrame.data() + offset;
+        size_t dataSize = pHeader[0] | (pHeader[1] << 8);
+        unsigned char type = pHeader[2];
+
+        if (!PipeMessage::isValidType(type) || dataSize > PipeMessage::MAX_DATA_SIZE)
+        {
+            // Frame boundaries are lost, nothing after this point can be trusted
+            Kernel::Warning(pathname + " - invalid frame, discarding " + std::to_string(m_partialFrame.size() - offset) + " B");
+            offset = m_partialFrame.size();
+            break;
+        }
+
+        if (m_partialFrame.size() - offset - PipeMessage::HEADER_SIZE < dataSize) break;
+
+        messages.emplace_back((PipeMessage::enuType)type, m_partialFrame.substr(offset + PipeMessage::HEADER_SIZE, dataSize));
+        offset += PipeMessage::HEADER_SIZE + dataSize;
+    }
+
+    m_partialFrame.erase(0, offset);
+
+    return messages.size() - initialSize;
+}
+
+bool Pipe::receiveMessage(PipeMessage& message)
+{
+    if (m_pendingMessages.empty())
+    {
+        std::vector<PipeMessage> messages;
+        receiveMessages(messages);
+        m_pendingMessages.insert(m_pendingMessages.end(), messages.begin(), messages.end());
+    }
+
+    if (m_pendingMessages.empty()) return false;
+
+    message = std::move(m_pendingMessages.front());
+    m_pendingMessages.pop_front();
+    return true;
+}
@@ -0,0 +1,255 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef PROPERTIES_H
+#define PROPERTIES_H
+
+#include <string>
+#include <vector>
+
+/// One door driven by HardwareDaemon: its input devices and indicators (`Settings > Doors > Door`)
+struct DoorProperties
+{
+    /// Value of optional pin settings which are not configured
+    static const unsigned int NO_PIN = 0xFFFFFFFF;
+    /// MainApplication runs two automata per door, with the `short` instance IDs 2 * ID and 2 * ID + 1
+    static const unsigned int MAX_ID = 16383;
+
+    unsigned int ID;
+    std::string KEYPAD_ISTREAM_PATH;
+    /// libnfc connection string of the door's PN532, empty for the first device libnfc finds
+    std::string RFID_CONNSTRING;
+    unsigned int BUZZER_BCM_PIN;
+    unsigned int DOOR_BCM_PIN;
+    /// Optional status LED, `NO_PIN` without one
+    unsigned int LED_BCM_PIN;
+    unsigned int LCD_I2C_ADDRESS;
+
+    bool operator==(const DoorProperties& other) const
+    {
+        return ID == other.ID
+            && KEYPAD_ISTREAM_PATH == other.KEYPAD_ISTREAM_PATH
+            && RFID_CONNSTRING == other.RFID_CONNSTRING
+            && BUZZER_BCM_PIN == other.BUZZER_BCM_PIN
+            && DOOR_BCM_PIN == other.DOOR_BCM_PIN
+            && LED_BCM_PIN == other.LED_BCM_PIN
+            && LCD_I2C_ADDRESS == other.LCD_I2C_ADDRESS;
+    }
+
+    bool operator!=(const DoorProperties& other) const { return !(*this == other); }
+};
+
+/// Typed configuration read from config.xml. Treat as immutable once published by `GlobalProperties::Get()`.
+/// When adding a field, also add it to `PROPERTIES_IMAGE_FIELDS` in propertiesimage.h.
+struct Properties
+{
+    // ---------- Keypad
+    unsigned int KEYPAD_BUFFER_SIZE;
+    /// Unused since the keypad is read through epoll, kept so existing config.xml files still load
+    unsigned int KEYPAD_READ_TIMEOUT_MS;
+
+    // ---------- RFID
+    unsigned int RFID_BUFFER_SIZE;
+    unsigned int RFID_READ_TIMEOUT_MS;
+    unsigned int RFID_SAME_CARD_TIMEOUT_MS;
+    unsigned int RFID_IDLE_POLL_INTERVAL_MS;
+    unsigned int RFID_ACTIVITY_HOLD_MS;
+    unsigned int RFID_DUTY_CYCLE_PERCENT;
+    /// Prefix of the per-door pipes HardwareDaemon writes card UUIDs to, like `KEYPAD_PIPE_NAME`
+    std::string RFID_PIPE_NAME;
+
+    // ---------- Database
+    std::string DB_PATH;
+
+    // ---------- Mailbox
+    int QUEUE_SIZE;
+    int MAX_MSG_SIZE;
+    std::string MAIN_MB_NAME;
+    std::string DBGW_MB_NAME;
+    unsigned int DATABASE_MB_TIMEOUT;
+    std::string DATABASE_LOG_THREAD_MAILBOX_NAME;
+    std::string HARDWARED_MB_NAME;
+
+    // ---------- Kernel
+    std::string KERNEL_LOG_NAME;
+    
+    // ---------- Watchdog
+    std::string WATCHDOG_SERVER_NAME;
+    std::string HARDWARED_WATCHDOG_NAME;
+    std::string MAIN_WATCHDOG_NAME;
+    std::string DATABASE_WATCHDOG_NAME;
+    unsigned int WATCHDOG_SERVER_PERIOD_MS;
+    unsigned int HARDWARED_WD_TIMEOUT_MS;
+    unsigned int HARDWARED_WD_TTL;
+    unsigned int MAIN_WD_TIMEOUT_MS;
+    unsigned int MAIN_WD_TTL;
+    unsigned int DB_WD_TIMEOUT_MS;
+    unsigned int DB_WD_TTL;
+
+    // ----------- Startup
+    std::string HARDWARED_EXECUTABLE;
+    std::string MAIN_APP_EXECUTABLE;
+    std::string DBGW_EXECUTABLE;
+
+    // ----------- Keypad
+    std::string KEYPAD_PIPE_NAME;
+    std::string KEYPAD_ISTREAM_PATH;
+
+    
+    // ----------- Tables
+    std::string EMPLOYEES_TABLE_NAME;
+    std::string EMPLOYEES_TABLE_ID_COLUMN_NAME;
+    std::string EMPLOYEES_TABLE_NAME_COLUMN_NAME;
+    std::string EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME;
+    std::string KEYPAD_PASS_TABLE_NAME;
+    std::string KEYPAD_PASS_TABLE_ID_COLUMN_NAME;
+    std::string KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME;
+    std::string KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME;
+    std::string COMMANDS_TABLE_NAME;
+    std::string COMMANDS_TABLE_ID_COLUMN_NAME;
+    std::string COMMANDS_TABLE_COMMAND_COLUMN_NAME;
+    std::string COMMANDS_TABLE_CLEARANCE_COLUMN_NAME;
+    std::string RFID_CARD_TABLE_NAME;
+    std::string RFID_CARD_TABLE_ID_COLUMN_NAME;
+    std::string RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME;
+    std::string RFID_CARD_TABLE_OWNER_COLUMN_NAME;
+    std::string LOG_TABLE_NAME;
+    std::string LOG_TABLE_ID_COLUMN_NAME;
+    std::string LOG_TABLE_TIMESTAMP_COLUMN_NAME;
+    std::string LOG_TABLE_USER_ID_COLUMN_NAME;
+    std::string LOG_TABLE_AUTH_METHOD_COLUMN_NAME;
+    std::string LOG_TABLE_COMMAND_ID_COLUMN_NAME;
+
+    // -------------- Indicators
+    std::string INDICATORS_MAILBOX_NAME;
+    std::string INDICATORS_MB_SERVER_SUFFIX;
+    std::string INDICATORS_MB_CLIENT_SUFFIX;
+    unsigned int INDICATORS_MB_TIMEOUT_MS;
+    unsigned int BUZZER_BCM_PIN;
+    unsigned int DOOR_BCM_PIN;
+    unsigned int DOOR_OPEN_TIME_MS;
+    unsigned int LCD_I2C_BUS;
+    std::string LCD_DEFAULT_IDLE_MESSAGE;
+    unsigned int BUZZER_PING_DURATION_MS;
+    unsigned int LCD_I2C_ADDRESS;
+    unsigned int LCD_DEFULT_MSG_DISPLAY_TIME_MS;
+    unsigned int LCD_INTER_COMMANDS_WAIT_TIME_US;
+    /// Signal patterns in the text form of `SignalPattern` (IndicatorController), each with its priority
+    std::string SIGNAL_PATTERN_PING;
+    unsigned int SIGNAL_PATTERN_PING_PRIORITY;
+    std::string SIGNAL_PATTERN_SUCCESS;
+    unsigned int SIGNAL_PATTERN_SUCCESS_PRIORITY;
+    std::string SIGNAL_PATTERN_FAILURE;
+    unsigned int SIGNAL_PATTERN_FAILURE_PRIORITY;
+    std::string SIGNAL_PATTERN_DOOR_OPEN;
+    unsigned int SIGNAL_PATTERN_DOOR_OPEN_PRIORITY;
+
+    // std::string LOG_FILE_SUFFIX;
+
+    // --------------- General
+    /// Unused since every Logger rotates at DEFAULT_MAX_LOG_FILE_SIZE_BYTES, kept so existing config.xml files still load
+    unsigned int DEFAULT_MAX_LOG_FILE_SIZE;
+    std::string LOG_FILE_OLD_SUFFIX;
+    int MAX_CLEARANCE;
+    int FAIL_SAFE_CLEARANCE;
+    int NO_CLERANCE;
+    std::string MAILBOX_REFRENCE_DEFAULT_NAME;
+    unsigned int REQUEST_DEADLINE_TIMER_TIMEOUT_S;
+
+    // --------------- Doors
+    /// Never empty: without a `Doors` section, one door with ID 1 is made of the Keypad and Indicators settings
+    std::vector<DoorProperties> DOORS;
+
+    // --------------- Hardware
+    /// "pi" (pigpio, evdev keypads, libnfc readers) or "simulated" (no hardware, input from a scenario or socket)
+    std::string HARDWARE_BACKEND;
+    /// Scenario played by the simulated backend, empty for none
+    std::string SIMULATION_SCENARIO_PATH;
+    /// UNIX socket taking commands for the simulated backend, empty for none
+    std::string SIMULATION_CONTROL_SOCKET;
+    /// UNIX datagram socket receiving the latency trace of every request, empty to disable tracing
+    std::string LATENCY_TRACE_SOCKET;
+
+    // --------------- Automaton trace
+    /// Shared memory ring every process records its automaton transitions to, as /NAME.program
+    std::string AUTOMATON_TRACE_NAME;
+    /// Transitions kept in the ring (rounded up to a power of two), 0 disables the trace
+    unsigned int AUTOMATON_TRACE_RECORDS;
+
+    // --------------- Metrics
+    /// Shared memory segment every process publishes its metrics to, as /NAME.program; empty disables publishing
+    std::string METRICS_NAME;
+
+    // --------------- Web API
+    /// IPv4 address WebAPIController listens on, loopback unless the status pages should be reachable from the network
+    std::string WEBAPI_ADDRESS;
+    /// TCP port of WebAPIController
+    unsigned int WEBAPI_PORT;
+    /// Connections served at once, further ones wait in the listen backlog
+    unsigned int WEBAPI_MAX_CLIENTS;
+    /// Unix socket of the administration API (bulk import and export), empty disables it
+    std::string WEBAPI_ADMIN_SOCKET;
+    /// DataMailbox WebAPIController sends import requests to DatabaseGateway from
+    std::string WEBAPI_MB_NAME;
+    /// How long an import request waits for DatabaseGateway to commit it
+    unsigned int WEBAPI_IMPORT_TIMEOUT_MS;
+
+    // --------------- Access guard
+    /// Authorization attempts one credential may make within GUARD_CREDENTIAL_WINDOW_S before it is locked out, 0 disables the limit
+    unsigned int GUARD_CREDENTIAL_MAX_ATTEMPTS;
+    /// Sliding window of GUARD_CREDENTIAL_MAX_ATTEMPTS
+    unsigned int GUARD_CREDENTIAL_WINDOW_S;
+    /// Refused attempts with one input (keypad or card reader) of a door within GUARD_DOOR_WINDOW_S before that input is locked out, 0 disables the limit
+    unsigned int GUARD_DOOR_MAX_FAILURES;
+    /// Sliding window of GUARD_DOOR_MAX_FAILURES
+    unsigned int GUARD_DOOR_WINDOW_S;
+    /// How long a credential or door input stays locked out, persisted across restarts
+    unsigned int GUARD_LOCKOUT_S;
+    /// A credential granted at one door is refused at any other door for this long, 0 disables anti-passback
+    unsigned int GUARD_ANTIPASSBACK_S;
+
+    // --------------- Offline authorization
+    /// File MainApplication keeps its signed cache of DatabaseGateway's decisions in (key in PATH.key), empty disables offline decisions
+    std::string OFFLINE_CACHE_PATH;
+    /// Credential and door pairs kept in the cache, least recently used ones are dropped first
+    unsigned int OFFLINE_CACHE_ENTRIES;
+    /// A cached grant is used only this long after DatabaseGateway last confirmed it
+    unsigned int OFFLINE_CACHE_TTL_S;
+    /// How long an authorization waits for DatabaseGateway before it is decided from the cache
+    unsigned int OFFLINE_DEADLINE_MS;
+    /// Offline decisions kept for the access log until DatabaseGateway answers again, the oldest are dropped first
+    unsigned int OFFLINE_LOG_QUEUE_SIZE;
+
+    // --------------- Access log journal
+    /// Size of the file DatabaseGateway journals access logs to (DB_PATH.journal) before they are written to LogTable
+    unsigned int LOG_JOURNAL_SIZE_KB;
+    /// Most journaled logs written to LogTable in one transaction
+    unsigned int LOG_JOURNAL_BATCH;
+    /// How long a request waits for space in a full journal before its log is written to LogTable directly
+    unsigned int LOG_JOURNAL_FULL_WAIT_MS;
+
+    // std::string SHARED_MEMORY_NAME_SUFFIX;
+};
+
+#endif // PROPERTIES_H
@@ -30,119 +30,113 @@
 #include <QDomNode>
 #include <QDomElement>
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 
-struct Properties
+#include "properties.h"
+
+/// Interface for objects which want to be notified when config.xml is reloaded. \see GlobalProperties::Subscribe()
+class IPropertiesSubscriber
 {
-    // ---------- Keypad
-    unsigned int KEYPAD_BUFFER_SIZE;
-    unsigned int KEYPAD_READ_TIMEOUT_MS;
-
-    // ---------- RFID
-    unsigned int RFID_BUFFER_SIZE;
-    unsigned int RFID_READ_TIMEOUT_MS;
-    unsigned int RFID_SAME_CARD_TIMEOUT_MS;
-
-    // ---------- Database
-    std::string DB_PATH;
-
-    // ---------- Mailbox
-    int QUEUE_SIZE;
-    int MAX_MSG_SIZE;
-    std::string MAIN_MB_NAME;
-    std::string DBGW_MB_NAME;
-    unsigned int DATABASE_MB_TIMEOUT;
-    std::string DATABASE_LOG_THREAD_MAILBOX_NAME;
-    std::string HARDWARED_MB_NAME;
-
-    // ---------- Kernel
-    std::string KERNEL_LOG_NAME;
-    
-    // ---------- Watchdog
-    std::string WATCHDOG_SERVER_NAME;
-    std::string HARDWARED_WATCHDOG_NAME;
-    std::string MAIN_WATCHDOG_NAME;
-    std::string DATABASE_WATCHDOG_NAME;
-    unsigned int WATCHDOG_SERVER_PERIOD_MS;
-    unsigned int HARDWARED_WD_TIMEOUT_MS;
-    unsigned int HARDWARED_WD_TTL;
-    unsigned int MAIN_WD_TIMEOUT_MS;
-    unsigned int MAIN_WD_TTL;
-    unsigned int DB_WD_TIMEOUT_MS;
-    unsigned int DB_WD_TTL;
-
-    // ----------- Startup
-    std::string HARDWARED_EXECUTABLE;
-    std::string MAIN_APP_EXECUTABLE;
-    std::string DBGW_EXECUTABLE;
-
-    // ----------- Keypad
-    std::string KEYPAD_PIPE_NAME;
-    std::string KEYPAD_ISTREAM_PATH;
-
-    
-    // ----------- Tables
-    std::string EMPLOYEES_TABLE_NAME;
-    std::string EMPLOYEES_TABLE_ID_COLUMN_NAME;
-    std::string EMPLOYEES_TABLE_NAME_COLUMN_NAME;
-    std::string EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME;
-    std::string KEYPAD_PASS_TABLE_NAME;
-    std::string KEYPAD_PASS_TABLE_ID_COLUMN_NAME;
-    std::string KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME;
-    std::string KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME;
-    std::string COMMANDS_TABLE_NAME;
-    std::string COMMANDS_TABLE_ID_COLUMN_NAME;
-    std::string COMMANDS_TABLE_COMMAND_COLUMN_NAME;
-    std::string COMMANDS_TABLE_CLEARANCE_COLUMN_NAME;
-    std::string RFID_CARD_TABLE_NAME;
-    std::string RFID_CARD_TABLE_ID_COLUMN_NAME;
-    std::string RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME;
-    std::string RFID_CARD_TABLE_OWNER_COLUMN_NAME;
-    std::string LOG_TABLE_NAME;
-    std::string LOG_TABLE_ID_COLUMN_NAME;
-    std::string LOG_TABLE_TIMESTAMP_COLUMN_NAME;
-    std::string LOG_TABLE_USER_ID_COLUMN_NAME;
-    std::string LOG_TABLE_AUTH_METHOD_COLUMN_NAME;
-    std::string LOG_TABLE_COMMAND_ID_COLUMN_NAME;
-
-    // -------------- Indicators
-    std::string INDICATORS_MAILBOX_NAME;
-    std::string INDICATORS_MB_SERVER_SUFFIX;
-    std::string INDICATORS_MB_CLIENT_SUFFIX;
-    unsigned int INDICATORS_MB_TIMEOUT_MS;
-    unsigned int BUZZER_BCM_PIN;
-    unsigned int DOOR_BCM_PIN;
-    unsigned int DOOR_OPEN_TIME_MS;
-    unsigned int LCD_I2C_BUS;
-    std::string LCD_DEFAULT_IDLE_MESSAGE;
-    unsigned int BUZZER_PING_DURATION_MS;
-    unsigned int LCD_I2C_ADDRESS;
-    unsigned int LCD_DEFULT_MSG_DISPLAY_TIME_MS;
-    unsigned int LCD_INTER_COMMANDS_WAIT_TIME_US;
-
-    // std::string LOG_FILE_SUFFIX;
-
-    // --------------- General
-    unsigned int DEFAULT_MAX_LOG_FILE_SIZE;
-    std::string LOG_FILE_OLD_SUFFIX;
-    int MAX_CLEARANCE;
-    int FAIL_SAFE_CLEARANCE;
-    int NO_CLERANCE;
-    std::string MAILBOX_REFRENCE_DEFAULT_NAME;
-    unsigned int REQUEST_DEADLINE_TIMER_TIMEOUT_S;
-
-    // std::string SHARED_MEMORY_NAME_SUFFIX;
+public:
+    virtual ~IPropertiesSubscriber() = default;
+
+    /**
+     * @brief Called from the config watcher thread after a new snapshot is published
+     * @param properties New configuration snapshot (same object as returned by `GlobalProperties::Get()`)
+     * @param version Version of the new snapshot
+     * @param restartRequired Names of changed settings which were NOT applied because they need a restart
+    */
+    virtual void PropertiesChanged(const Properties& properties, unsigned int version, const std::vector<std::string>& restartRequired) = 0;
+};
+
+/**
+ * Subscriber for loops which apply live settings themselves. `PropertiesChanged()` runs on the watcher thread and only
+ * raises a flag; the loop calls `TakeChange()` and re-reads `GlobalProperties::Get()` on its own thread.
+*/
+class PropertiesChangeFlag : public IPropertiesSubscriber
+{
+public:
+    virtual void PropertiesChanged(const Properties& properties, unsigned int version, const std::vector<std::string>& restartRequired) override;
+
+    /**
+     * @brief Clears the flag, several reloads since the last call count as one
+     * @param restartRequired Filled with the restart-required settings reported since the last call
+     * @return true if config.xml was reloaded since the last call
+    */
+    bool TakeChange(std::vector<std::string>& restartRequired);
+
+private:
+    /// Checked without the lock, so idle loops do not contend with the watcher thread
+    std::atomic<bool> m_changed{ false };
+    std::mutex m_mutex;
+    std::vector<std::string> m_restartRequired;
 };
 
 class GlobalProperties
 {
 public:
-    static Properties Get();
+    /// Returns the configuration snapshot. config.xml is parsed only on the first call, every later call is a single pointer load.
+    static const Properties& Get();
+
+    /// Version of the snapshot returned by `Get()`. Starts at 1 and is incremented by every successful reload.
+    static unsigned int Version();
+
+    /// Walks the XML document and builds a new `Properties` object on every call. Use `Get()` instead.
+    static Properties Parse();
+
+    /**
+     * @brief Compiles config.xml into config.bin (see `PropertiesImage`).
+     * Processes started afterwards map the image instead of parsing XML, as long as config.xml is unchanged.
+     * @return false if config.xml cannot be read or the image cannot be written
+    */
+    static bool ExportImage();
+
+    /**
+     * @brief Re-reads config.xml, validates it and publishes it as a new snapshot.
+     * Settings which cannot change while running keep their current values and are reported to subscribers as restart-required.
+     * @return false if the file could not be read or is not valid (current snapshot stays in use)
+    */
+    static bool Reload();
+
+    /// Starts a thread which calls `Reload()` whenever config.xml is written or replaced (inotify). Returns false on error.
+    static bool StartWatching();
+
+    /// Stops the thread started with `StartWatching()`
+    static void StopWatching();
+
+    /// Register `pSubscriber` to be notified after each successful `Reload()`
+    static void Subscribe(IPropertiesSubscriber* pSubscriber);
+    static void Unsubscribe(IPropertiesSubscriber* pSubscriber);
 
 private:
+    struct Snapshot
+    {
+        Properties properties;
+        unsigned int version;
+    };
+
     static GlobalProperties* getInstance();
-    QDomElement getTag(const QString& path, bool& ok);
-    QString getAttribute(const QString& path, bool& ok);
+    static const Snapshot* createSnapshot();
+    static const Snapshot* currentSnapshot();
+    static void watchConfigFile(int inotifyFd, int stopFd);
+    static bool validate(const Properties& properties, QString& error);
+    static std::vector<std::string> keepRestartRequiredSettings(Properties& newProperties, const Properties& current);
+
+    Properties readProperties(const QDomDocument& document, bool& ok);
+    std::vector<DoorProperties> readDoors(const QDomDocument& document, const Properties& properties, bool& ok);
+    void readSignalPatterns(const QDomDocument& document, Properties& properties, bool& ok);
+    void readHardware(const QDomDocument& document, Properties& properties, bool& ok);
+    void readAutomatonTrace(const QDomDocument& document, Properties& properties);
+    void readMetrics(const QDomDocument& document, Properties& properties);
+    void readWebAPI(const QDomDocument& document, Properties& properties);
+    void readAccessGuard(const QDomDocument& document, Properties& properties);
+    void readOfflineCache(const QDomDocument& document, Properties& properties);
+    void readLogJournal(const QDomDocument& document, Properties& properties);
+    QDomElement getTag(const QDomDocument& document, const QString& path, bool& ok);
+    QString getAttribute(const QDomDocument& document, const QString& path, bool& ok);
     bool existsTag(const QString& path);
     bool existsAttribute(const QString& path);
 
@@ -152,8 +146,10 @@ private:
     GlobalProperties(GlobalProperties&&) = delete;
 
     void init();
+    static bool loadDocument(QDomDocument& document);
 
     static GlobalProperties* m_pInstance;
+    static std::atomic<const Snapshot*> m_pSnapshot;
     QDomDocument m_XML_document;
 
     void FatalError(const QString& msg);
@@ -162,7 +158,7 @@ private:
 
     QStringList parseNodeName(const QString& rawName);
 
-    QDomElement getParentNodeWithPath(const QStringList& nodePath, bool& ok);
+    QDomElement getParentNodeWithPath(const QDomDocument& document, const QStringList& nodePath, bool& ok);
 };
 
 #endif // PROPERTIESCLASS_H
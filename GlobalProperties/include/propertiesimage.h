@@ -0,0 +1,215 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef PROPERTIESIMAGE_H
+#define PROPERTIESIMAGE_H
+
+#include <cstdint>
+#include <string>
+
+#include "properties.h"
+
+/**
+ * @brief Every field of `Properties` in declaration order, as UINT(name), INT(name), STRING(name) or DOOR_LIST(name).
+ * Must be kept in sync with properties.h - the image layout and its fingerprint are generated from this list,
+ * propertiesimage.cpp fails to compile when a field is missing, out of order or of a different type.
+*/
+#define PROPERTIES_IMAGE_FIELDS(UINT, INT, STRING, DOOR_LIST) \
+    UINT(KEYPAD_BUFFER_SIZE) \
+    UINT(KEYPAD_READ_TIMEOUT_MS) \
+    UINT(RFID_BUFFER_SIZE) \
+    UINT(RFID_READ_TIMEOUT_MS) \
+    UINT(RFID_SAME_CARD_TIMEOUT_MS) \
+    UINT(RFID_IDLE_POLL_INTERVAL_MS) \
+    UINT(RFID_ACTIVITY_HOLD_MS) \
+    UINT(RFID_DUTY_CYCLE_PERCENT) \
+    STRING(RFID_PIPE_NAME) \
+    STRING(DB_PATH) \
+    INT(QUEUE_SIZE) \
+    INT(MAX_MSG_SIZE) \
+    STRING(MAIN_MB_NAME) \
+    STRING(DBGW_MB_NAME) \
+    UINT(DATABASE_MB_TIMEOUT) \
+    STRING(DATABASE_LOG_THREAD_MAILBOX_NAME) \
+    STRING(HARDWARED_MB_NAME) \
+    STRING(KERNEL_LOG_NAME) \
+    STRING(WATCHDOG_SERVER_NAME) \
+    STRING(HARDWARED_WATCHDOG_NAME) \
+    STRING(MAIN_WATCHDOG_NAME) \
+    STRING(DATABASE_WATCHDOG_NAME) \
+    UINT(WATCHDOG_SERVER_PERIOD_MS) \
+    UINT(HARDWARED_WD_TIMEOUT_MS) \
+    UINT(HARDWARED_WD_TTL) \
+    UINT(MAIN_WD_TIMEOUT_MS) \
+    UINT(MAIN_WD_TTL) \
+    UINT(DB_WD_TIMEOUT_MS) \
+    UINT(DB_WD_TTL) \
+    STRING(HARDWARED_EXECUTABLE) \
+    STRING(MAIN_APP_EXECUTABLE) \
+    STRING(DBGW_EXECUTABLE) \
+    STRING(KEYPAD_PIPE_NAME) \
+    STRING(KEYPAD_ISTREAM_PATH) \
+    STRING(EMPLOYEES_TABLE_NAME) \
+    STRING(EMPLOYEES_TABLE_ID_COLUMN_NAME) \
+    STRING(EMPLOYEES_TABLE_NAME_COLUMN_NAME) \
+    STRING(EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME) \
+    STRING(KEYPAD_PASS_TABLE_NAME) \
+    STRING(KEYPAD_PASS_TABLE_ID_COLUMN_NAME) \
+    STRING(KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME) \
+    STRING(KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME) \
+    STRING(COMMANDS_TABLE_NAME) \
+    STRING(COMMANDS_TABLE_ID_COLUMN_NAME) \
+    STRING(COMMANDS_TABLE_COMMAND_COLUMN_NAME) \
+    STRING(COMMANDS_TABLE_CLEARANCE_COLUMN_NAME) \
+    STRING(RFID_CARD_TABLE_NAME) \
+    STRING(RFID_CARD_TABLE_ID_COLUMN_NAME) \
+    STRING(RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME) \
+    STRING(RFID_CARD_TABLE_OWNER_COLUMN_NAME) \
+    STRING(LOG_TABLE_NAME) \
+    STRING(LOG_TABLE_ID_COLUMN_NAME) \
+    STRING(LOG_TABLE_TIMESTAMP_COLUMN_NAME) \
+    STRING(LOG_TABLE_USER_ID_COLUMN_NAME) \
+    STRING(LOG_TABLE_AUTH_METHOD_COLUMN_NAME) \
+    STRING(LOG_TABLE_COMMAND_ID_COLUMN_NAME) \
+    STRING(INDICATORS_MAILBOX_NAME) \
+    STRING(INDICATORS_MB_SERVER_SUFFIX) \
+    STRING(INDICATORS_MB_CLIENT_SUFFIX) \
+    UINT(INDICATORS_MB_TIMEOUT_MS) \
+    UINT(BUZZER_BCM_PIN) \
+    UINT(DOOR_BCM_PIN) \
+    UINT(DOOR_OPEN_TIME_MS) \
+    UINT(LCD_I2C_BUS) \
+    STRING(LCD_DEFAULT_IDLE_MESSAGE) \
+    UINT(BUZZER_PING_DURATION_MS) \
+    UINT(LCD_I2C_ADDRESS) \
+    UINT(LCD_DEFULT_MSG_DISPLAY_TIME_MS) \
+    UINT(LCD_INTER_COMMANDS_WAIT_TIME_US) \
+    STRING(SIGNAL_PATTERN_PING) \
+    UINT(SIGNAL_PATTERN_PING_PRIORITY) \
+    STRING(SIGNAL_PATTERN_SUCCESS) \
+    UINT(SIGNAL_PATTERN_SUCCESS_PRIORITY) \
+    STRING(SIGNAL_PATTERN_FAILURE) \
+    UINT(SIGNAL_PATTERN_FAILURE_PRIORITY) \
+    STRING(SIGNAL_PATTERN_DOOR_OPEN) \
+    UINT(SIGNAL_PATTERN_DOOR_OPEN_PRIORITY) \
+    UINT(DEFAULT_MAX_LOG_FILE_SIZE) \
+    STRING(LOG_FILE_OLD_SUFFIX) \
+    INT(MAX_CLEARANCE) \
+    INT(FAIL_SAFE_CLEARANCE) \
+    INT(NO_CLERANCE) \
+    STRING(MAILBOX_REFRENCE_DEFAULT_NAME) \
+    UINT(REQUEST_DEADLINE_TIMER_TIMEOUT_S) \
+    DOOR_LIST(DOORS) \
+    STRING(HARDWARE_BACKEND) \
+    STRING(SIMULATION_SCENARIO_PATH) \
+    STRING(SIMULATION_CONTROL_SOCKET) \
+    STRING(LATENCY_TRACE_SOCKET) \
+    STRING(AUTOMATON_TRACE_NAME) \
+    UINT(AUTOMATON_TRACE_RECORDS) \
+    STRING(METRICS_NAME) \
+    STRING(WEBAPI_ADDRESS) \
+    UINT(WEBAPI_PORT) \
+    UINT(WEBAPI_MAX_CLIENTS) \
+    STRING(WEBAPI_ADMIN_SOCKET) \
+    STRING(WEBAPI_MB_NAME) \
+    UINT(WEBAPI_IMPORT_TIMEOUT_MS) \
+    UINT(GUARD_CREDENTIAL_MAX_ATTEMPTS) \
+    UINT(GUARD_CREDENTIAL_WINDOW_S) \
+    UINT(GUARD_DOOR_MAX_FAILURES) \
+    UINT(GUARD_DOOR_WINDOW_S) \
+    UINT(GUARD_LOCKOUT_S) \
+    UINT(GUARD_ANTIPASSBACK_S) \
+    STRING(OFFLINE_CACHE_PATH) \
+    UINT(OFFLINE_CACHE_ENTRIES) \
+    UINT(OFFLINE_CACHE_TTL_S) \
+    UINT(OFFLINE_DEADLINE_MS) \
+    UINT(OFFLINE_LOG_QUEUE_SIZE) \
+    UINT(LOG_JOURNAL_SIZE_KB) \
+    UINT(LOG_JOURNAL_BATCH) \
+    UINT(LOG_JOURNAL_FULL_WAIT_MS)
+
+/// Every field of `DoorProperties`, same rules as `PROPERTIES_IMAGE_FIELDS`
+#define PROPERTIES_IMAGE_DOOR_FIELDS(UINT, STRING) \
+    UINT(ID) \
+    STRING(KEYPAD_ISTREAM_PATH) \
+    STRING(RFID_CONNSTRING) \
+    UINT(BUZZER_BCM_PIN) \
+    UINT(DOOR_BCM_PIN) \
+    UINT(LED_BCM_PIN) \
+    UINT(LCD_I2C_ADDRESS)
+
+/**
+ * @brief Flat binary copy of `Properties` which processes map read-only instead of parsing config.xml.
+ *
+ * Layout: fixed `Header`, then every field from `PROPERTIES_IMAGE_FIELDS` in order - numbers as
+ * 32 bit values in host byte order, strings as a 32 bit length followed by the characters, door lists
+ * as a 32 bit count followed by the `PROPERTIES_IMAGE_DOOR_FIELDS` of every door.
+ * An image is accepted only if the magic, format version, layout fingerprint and payload CRC32 match
+ * and it was generated from a config.xml with the same modification time and size as the current one.
+*/
+class PropertiesImage
+{
+public:
+    /// Identifies the config.xml an image was generated from
+    struct Source
+    {
+        int64_t modificationTime_ns;
+        int64_t size;
+    };
+
+    /// Fills `source` from the file at `path`. Returns false if the file cannot be accessed.
+    static bool StatSource(const std::string& path, Source& source);
+
+    /// Writes the image to a temporary file and renames it to `imagePath`, so readers never see a partial image
+    static bool Write(const std::string& imagePath, const Properties& properties, const Source& source);
+
+    /**
+     * @brief Maps `imagePath` read-only and decodes it into `properties`.
+     * @return false if the image is missing, corrupted, from a different build or stale with respect to `source`
+    */
+    static bool Read(const std::string& imagePath, const Source& source, Properties& properties);
+
+    /// CRC32 (IEEE 802.3) of `size` bytes at `data`
+    static uint32_t Checksum(const void* data, size_t size);
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t formatVersion;
+        uint32_t layoutFingerprint;
+        uint32_t payloadSize;
+        uint32_t payloadChecksum;
+        uint32_t reserved;
+        int64_t sourceModificationTime_ns;
+        int64_t sourceSize;
+    };
+
+    static const uint32_t MAGIC = 0x5043464E; // "NFCP" on little-endian hosts
+    static const uint32_t FORMAT_VERSION = 2;
+
+    static uint32_t layoutFingerprint();
+};
+
+#endif // PROPERTIESIMAGE_H
@@ -23,10 +23,31 @@
 */
 
 #include "propertiesclass.h"
+#include "propertiesimage.h"
+
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
 
 const QString CONFIG_PATH = "config.xml";
+const std::string IMAGE_PATH = "config.bin";
 
 GlobalProperties* GlobalProperties::m_pInstance = nullptr;
+std::atomic<const GlobalProperties::Snapshot*> GlobalProperties::m_pSnapshot(nullptr);
+
+// Subscribers and watcher state are only touched by Subscribe()/StartWatching() and the
+// watcher thread - never by Get(), so readers do not take this lock.
+static std::mutex watcherMutex;
+static std::vector<IPropertiesSubscriber*> subscribers;
+static std::thread watcherThread;
+static int watcherStopFd = -1;
 
 GlobalProperties::GlobalProperties()
 {
@@ -34,15 +55,24 @@ GlobalProperties::GlobalProperties()
 }
 
 void GlobalProperties::init()
+{
+    if(!loadDocument(m_XML_document))
+    {
+        FatalError("Error while opening XML file");
+    }
+}
+
+bool GlobalProperties::loadDocument(QDomDocument& document)
 {
     QFile XML_file(CONFIG_PATH);
     if(!XML_file.open(QIODevice::ReadOnly))
     {
-        FatalError("Error while opening XML file");
+        return false;
     }
 
-    m_XML_document.setContent(&XML_file);
+    bool parsed = document.setContent(&XML_file);
     XML_file.close();
+    return parsed;
 }
 
 GlobalProperties::~GlobalProperties()
@@ -57,10 +87,10 @@ GlobalProperties* GlobalProperties::getInstance()
     return m_pInstance;
 }
 
-QDomElement GlobalProperties::getTag(const QString& path, bool& ok)
+QDomElement GlobalProperties::getTag(const QDomDocument& document, const QString& path, bool& ok)
 {
     QStringList brokenPath = parseNodeName(path);
-    QDomElement parentElement = getParentNodeWithPath(brokenPath, ok);
+    QDomElement parentElement = getParentNodeWithPath(document, brokenPath, ok);
 
     const QString& targetTag = brokenPath.back();
     QDomElement targetTag_Element = parentElement.firstChildElement(targetTag);
@@ -68,11 +98,11 @@ QDomElement GlobalProperties::getTag(const QString& path, bool& ok)
     return targetTag_Element;
 }
 
-QString GlobalProperties::getAttribute(const QString& path, bool& ok)
+QString GlobalProperties::getAttribute(const QDomDocument& document, const QString& path, bool& ok)
 {
     const QString defValue = QString();
     QStringList brokenPath = parseNodeName(path);
-    QDomElement parentElement = getParentNodeWithPath(brokenPath, ok);
+    QDomElement parentElement = getParentNodeWithPath(document, brokenPath, ok);
 
     const QString& targetAttr_name = brokenPath.back();
     QString attributeValue = parentElement.attribute(targetAttr_name, defValue);
@@ -80,161 +110,1028 @@ QString GlobalProperties::getAttribute(const QString& path, bool& ok)
     return attributeValue;
 }
 
-Properties GlobalProperties::Get()
+const Properties& GlobalProperties::Get()
+{
+    return currentSnapshot()->properties;
+}
+
+unsigned int GlobalProperties::Version()
+{
+    return currentSnapshot()->version;
+}
+
+const GlobalProperties::Snapshot* GlobalProperties::currentSnapshot()
+{
+    const Snapshot* pSnapshot = m_pSnapshot.load(std::memory_order_acquire);
+    if(pSnapshot == nullptr) pSnapshot = createSnapshot();
+    return pSnapshot;
+}
+
+const GlobalProperties::Snapshot* GlobalProperties::createSnapshot()
+{
+    // Get() is called from static initializers of several libraries, so
+    // std::once_flag (constant initialized) is used instead of a mutex member.
+    static std::once_flag snapshotCreated;
+    std::call_once(snapshotCreated, []()
+    {
+        // Never deleted - references returned by Get() must stay valid until exit
+        Snapshot* pSnapshot = new Snapshot{ Properties(), 1 };
+
+        // Child processes normally find an image exported by Startup and skip the XML parser entirely
+        PropertiesImage::Source source;
+        bool fromImage = PropertiesImage::StatSource(CONFIG_PATH.toStdString(), source)
+            && PropertiesImage::Read(IMAGE_PATH, source, pSnapshot->properties);
+        if(!fromImage) pSnapshot->properties = Parse();
+
+        m_pSnapshot.store(pSnapshot, std::memory_order_release);
+    });
+
+    return m_pSnapshot.load(std::memory_order_acquire);
+}
+
+Properties GlobalProperties::Parse()
 {
     GlobalProperties* pXML = GlobalProperties::getInstance();
 
-    Properties prop;
-    bool ok = false;
+    bool ok = true;
+    Properties prop = pXML->readProperties(pXML->m_XML_document, ok);
+    if(!ok)
+    {
+        pXML->FatalError("Configuration file is missing required settings!");
+    }
 
-    prop.KEYPAD_BUFFER_SIZE = pXML->getTag("Settings > Keypad > BufferSize", ok).text().toUInt();
+    QString error;
+    if(!validate(prop, error))
+    {
+        pXML->FatalError("Configuration file is invalid: " + error);
+    }
 
-    prop.KEYPAD_READ_TIMEOUT_MS = pXML->getTag("Settings > Keypad > ReadTimeout_ms", ok).text().toUInt();
+    return prop;
+}
 
-    prop.RFID_BUFFER_SIZE = pXML->getTag("Settings > RFID_Reader > BufferSize", ok).text().toUInt();
+bool GlobalProperties::ExportImage()
+{
+    GlobalProperties* pXML = GlobalProperties::getInstance();
 
-    prop.RFID_READ_TIMEOUT_MS = pXML->getTag("Settings > RFID_Reader > ReadTimeout_ms", ok).text().toUInt();
+    // Stat before reading, so an edit racing with the export leaves an image that is already stale
+    PropertiesImage::Source source;
+    if(!PropertiesImage::StatSource(CONFIG_PATH.toStdString(), source))
+    {
+        pXML->Trace("Cannot export configuration image: " + CONFIG_PATH + " is missing");
+        return false;
+    }
 
-    prop.RFID_SAME_CARD_TIMEOUT_MS = pXML->getTag("Settings > RFID_Reader > SameCardTimeout_ms", ok).text().toUInt();
+    QDomDocument document;
+    bool ok = loadDocument(document);
+    Properties properties = ok ? pXML->readProperties(document, ok) : Properties();
+    QString error;
+    if(ok && !validate(properties, error))
+    {
+        pXML->Trace("Cannot export configuration image: " + error);
+        return false;
+    }
+    if(!ok || !PropertiesImage::Write(IMAGE_PATH, properties, source))
+    {
+        pXML->Trace("Cannot export configuration image " + QString::fromStdString(IMAGE_PATH));
+        return false;
+    }
 
-    prop.DB_PATH = pXML->getTag("Settings > Database > Path", ok).text().toStdString();
+    return true;
+}
 
-    prop.QUEUE_SIZE = pXML->getAttribute("Settings > Mailbox > queue_size", ok).toUInt();
+Properties GlobalProperties::readProperties(const QDomDocument& document, bool& ok)
+{
+    Properties prop{};
 
-    prop.MAX_MSG_SIZE = pXML->getAttribute("Settings > Mailbox > msg_size", ok).toUInt();
+    prop.KEYPAD_BUFFER_SIZE = getTag(document, "Settings > Keypad > BufferSize", ok).text().toUInt();
 
-    prop.MAIN_MB_NAME = pXML->getTag("Settings > Mailbox > MainAppMailbox > Name", ok).text().toStdString();
+    prop.KEYPAD_READ_TIMEOUT_MS = getTag(document, "Settings > Keypad > ReadTimeout_ms", ok).text().toUInt();
 
-    prop.DBGW_MB_NAME = pXML->getTag("Settings > Mailbox > DatabaseGatewayMailbox > Name", ok).text().toStdString();
+    prop.RFID_BUFFER_SIZE = getTag(document, "Settings > RFID_Reader > BufferSize", ok).text().toUInt();
 
-    prop.DATABASE_MB_TIMEOUT = pXML->getTag("Settings > Mailbox > DatabaseGatewayMailbox > Timeout_ms", ok).text().toUInt();
+    prop.RFID_READ_TIMEOUT_MS = getTag(document, "Settings > RFID_Reader > ReadTimeout_ms", ok).text().toUInt();
 
-    prop.DATABASE_LOG_THREAD_MAILBOX_NAME = pXML->getTag("Settings > Database > LogThread > MailboxName", ok).text().toStdString();
+    prop.RFID_SAME_CARD_TIMEOUT_MS = getTag(document, "Settings > RFID_Reader > SameCardTimeout_ms", ok).text().toUInt();
 
-    prop.HARDWARED_MB_NAME = pXML->getTag("Settings > Mailbox > HardwaredMailbox > Name", ok).text().toStdString();
+    prop.RFID_IDLE_POLL_INTERVAL_MS = getTag(document, "Settings > RFID_Reader > IdlePollInterval_ms", ok).text().toUInt();
 
-    prop.KERNEL_LOG_NAME = pXML->getTag("Settings > Kernel > LogName", ok).text().toStdString();
+    prop.RFID_ACTIVITY_HOLD_MS = getTag(document, "Settings > RFID_Reader > ActivityHold_ms", ok).text().toUInt();
 
-    prop.WATCHDOG_SERVER_NAME = pXML->getTag("Settings > Watchdog > Server > Name", ok).text().toStdString();
+    prop.RFID_DUTY_CYCLE_PERCENT = getTag(document, "Settings > RFID_Reader > DutyCycle_percent", ok).text().toUInt();
 
-    prop.HARDWARED_WATCHDOG_NAME = pXML->getTag("Settings > Watchdog > Hardwared > Name", ok).text().toStdString();
+    // Optional, config files written before the setting existed keep the name the pipes always had
+    bool hasRFID_PipeName = true;
+    QDomElement rfidPipeNameElement = getTag(document, "Settings > RFID_Reader > PipeName", hasRFID_PipeName);
+    prop.RFID_PIPE_NAME = hasRFID_PipeName ? rfidPipeNameElement.text().toStdString() : "rfid.pipe";
 
-    prop.MAIN_WATCHDOG_NAME = pXML->getTag("Settings > Watchdog > Main > Name", ok).text().toStdString();
+    prop.DB_PATH = getTag(document, "Settings > Database > Path", ok).text().toStdString();
 
-    prop.DATABASE_WATCHDOG_NAME = pXML->getTag("Settings > Watchdog > Database > Name", ok).text().toStdString();
+    prop.QUEUE_SIZE = getAttribute(document, "Settings > Mailbox > queue_size", ok).toUInt();
 
-    prop.WATCHDOG_SERVER_PERIOD_MS = pXML->getTag("Settings > Watchdog > Server > Period_ms", ok).text().toUInt();
+    prop.MAX_MSG_SIZE = getAttribute(document, "Settings > Mailbox > msg_size", ok).toUInt();
 
-    prop.HARDWARED_WD_TIMEOUT_MS = pXML->getTag("Settings > Watchdog > Hardwared > Timeout_ms", ok).text().toUInt();
+    prop.MAIN_MB_NAME = getTag(document, "Settings > Mailbox > MainAppMailbox > Name", ok).text().toStdString();
 
-    prop.HARDWARED_WD_TTL = pXML->getTag("Settings > Watchdog > Hardwared > TTL", ok).text().toUInt();
+    prop.DBGW_MB_NAME = getTag(document, "Settings > Mailbox > DatabaseGatewayMailbox > Name", ok).text().toStdString();
 
-    prop.MAIN_WD_TIMEOUT_MS = pXML->getTag("Settings > Watchdog > Main > Timeout_ms", ok).text().toUInt();
+    prop.DATABASE_MB_TIMEOUT = getTag(document, "Settings > Mailbox > DatabaseGatewayMailbox > Timeout_ms", ok).text().toUInt();
 
-    prop.MAIN_WD_TTL = pXML->getTag("Settings > Watchdog > Main > TTL", ok).text().toUInt();
+    prop.DATABASE_LOG_THREAD_MAILBOX_NAME = getTag(document, "Settings > Database > LogThread > MailboxName", ok).text().toStdString();
 
-    prop.DB_WD_TIMEOUT_MS = pXML->getTag("Settings > Watchdog > Database > Timeout_ms", ok).text().toUInt();
+    prop.HARDWARED_MB_NAME = getTag(document, "Settings > Mailbox > HardwaredMailbox > Name", ok).text().toStdString();
 
-    prop.DB_WD_TTL = pXML->getTag("Settings > Watchdog > Database > TTL", ok).text().toUInt();
+    prop.KERNEL_LOG_NAME = getTag(document, "Settings > Kernel > LogName", ok).text().toStdString();
 
-    prop.HARDWARED_EXECUTABLE = pXML->getTag("Settings > Startup > Hardwared > Path", ok).text().toStdString();
+    prop.WATCHDOG_SERVER_NAME = getTag(document, "Settings > Watchdog > Server > Name", ok).text().toStdString();
 
-    prop.MAIN_APP_EXECUTABLE = pXML->getTag("Settings > Startup > MainApp > Path", ok).text().toStdString();
+    prop.HARDWARED_WATCHDOG_NAME = getTag(document, "Settings > Watchdog > Hardwared > Name", ok).text().toStdString();
 
-    prop.DBGW_EXECUTABLE = pXML->getTag("Settings > Startup > DatabaseGateway > Path", ok).text().toStdString();
+    prop.MAIN_WATCHDOG_NAME = getTag(document, "Settings > Watchdog > Main > Name", ok).text().toStdString();
 
-    prop.KEYPAD_PIPE_NAME = pXML->getTag("Settings > Keypad > PipeName", ok).text().toStdString();
+    prop.DATABASE_WATCHDOG_NAME = getTag(document, "Settings > Watchdog > Database > Name", ok).text().toStdString();
 
-    prop.KEYPAD_ISTREAM_PATH = pXML->getTag("Settings > Keypad > IstreamPath", ok).text().toStdString();
+    prop.WATCHDOG_SERVER_PERIOD_MS = getTag(document, "Settings > Watchdog > Server > Period_ms", ok).text().toUInt();
 
-    prop.EMPLOYEES_TABLE_NAME = pXML->getAttribute("Settings > Database > Tables > EmployeesTable > name", ok).toStdString();
+    prop.HARDWARED_WD_TIMEOUT_MS = getTag(document, "Settings > Watchdog > Hardwared > Timeout_ms", ok).text().toUInt();
 
-    prop.EMPLOYEES_TABLE_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > EmployeesTable > ID_ColumnName", ok).text().toStdString();
+    prop.HARDWARED_WD_TTL = getTag(document, "Settings > Watchdog > Hardwared > TTL", ok).text().toUInt();
 
-    prop.EMPLOYEES_TABLE_NAME_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > EmployeesTable > Name_ColumnName", ok).text().toStdString();
+    prop.MAIN_WD_TIMEOUT_MS = getTag(document, "Settings > Watchdog > Main > Timeout_ms", ok).text().toUInt();
 
-    prop.EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > EmployeesTable > Clearance_ColumnName", ok).text().toStdString();
+    prop.MAIN_WD_TTL = getTag(document, "Settings > Watchdog > Main > TTL", ok).text().toUInt();
 
-    prop.KEYPAD_PASS_TABLE_NAME = pXML->getAttribute("Settings > Database > Tables > KeypadPassTable > name", ok).toStdString();
+    prop.DB_WD_TIMEOUT_MS = getTag(document, "Settings > Watchdog > Database > Timeout_ms", ok).text().toUInt();
 
-    prop.KEYPAD_PASS_TABLE_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > KeypadPassTable > ID_ColumnName", ok).text().toStdString();
+    prop.DB_WD_TTL = getTag(document, "Settings > Watchdog > Database > TTL", ok).text().toUInt();
 
-    prop.KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > KeypadPassTable > Password_ColumnName", ok).text().toStdString();
+    prop.HARDWARED_EXECUTABLE = getTag(document, "Settings > Startup > Hardwared > Path", ok).text().toStdString();
 
-    prop.KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > KeypadPassTable > Owner_ColumnName", ok).text().toStdString();
+    prop.MAIN_APP_EXECUTABLE = getTag(document, "Settings > Startup > MainApp > Path", ok).text().toStdString();
 
-    prop.COMMANDS_TABLE_NAME = pXML->getAttribute("Settings > Database > Tables > CommandsTable > name", ok).toStdString();
+    prop.DBGW_EXECUTABLE = getTag(document, "Settings > Startup > DatabaseGateway > Path", ok).text().toStdString();
 
-    prop.COMMANDS_TABLE_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > CommandsTable > ID_ColumnName", ok).text().toStdString();
+    prop.KEYPAD_PIPE_NAME = getTag(document, "Settings > Keypad > PipeName", ok).text().toStdString();
 
-    prop.COMMANDS_TABLE_COMMAND_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > CommandsTable > Command_ColumnName", ok).text().toStdString();
+    prop.KEYPAD_ISTREAM_PATH = getTag(document, "Settings > Keypad > IstreamPath", ok).text().toStdString();
 
-    prop.COMMANDS_TABLE_CLEARANCE_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > CommandsTable > Clearance_ColumnName", ok).text().toStdString();
+    prop.EMPLOYEES_TABLE_NAME = getAttribute(document, "Settings > Database > Tables > EmployeesTable > name", ok).toStdString();
 
-    prop.RFID_CARD_TABLE_NAME = pXML->getAttribute("Settings > Database > Tables > RFID_CardTable > name", ok).toStdString();
+    prop.EMPLOYEES_TABLE_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > EmployeesTable > ID_ColumnName", ok).text().toStdString();
 
-    prop.RFID_CARD_TABLE_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > RFID_CardTable > ID_ColumnName", ok).text().toStdString();
+    prop.EMPLOYEES_TABLE_NAME_COLUMN_NAME = getTag(document, "Settings > Database > Tables > EmployeesTable > Name_ColumnName", ok).text().toStdString();
 
-    prop.RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > RFID_CardTable > CardUUID_ColumnName", ok).text().toStdString();
+    prop.EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME = getTag(document, "Settings > Database > Tables > EmployeesTable > Clearance_ColumnName", ok).text().toStdString();
 
-    prop.RFID_CARD_TABLE_OWNER_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > RFID_CardTable > Owner_ColumnName", ok).text().toStdString();
+    prop.KEYPAD_PASS_TABLE_NAME = getAttribute(document, "Settings > Database > Tables > KeypadPassTable > name", ok).toStdString();
 
-    prop.LOG_TABLE_NAME = pXML->getAttribute("Settings > Database > Tables > LogTable > name", ok).toStdString();
+    prop.KEYPAD_PASS_TABLE_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > KeypadPassTable > ID_ColumnName", ok).text().toStdString();
 
-    prop.LOG_TABLE_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > LogTable > ID_ColumnName", ok).text().toStdString();
+    prop.KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME = getTag(document, "Settings > Database > Tables > KeypadPassTable > Password_ColumnName", ok).text().toStdString();
 
-    prop.LOG_TABLE_TIMESTAMP_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > LogTable > Timestamp_ColumnName", ok).text().toStdString();
+    prop.KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME = getTag(document, "Settings > Database > Tables > KeypadPassTable > Owner_ColumnName", ok).text().toStdString();
 
-    prop.LOG_TABLE_USER_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > LogTable > UserID_ColumnName", ok).text().toStdString();
+    prop.COMMANDS_TABLE_NAME = getAttribute(document, "Settings > Database > Tables > CommandsTable > name", ok).toStdString();
 
-    prop.LOG_TABLE_AUTH_METHOD_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > LogTable > AuthMethod_ColumnName", ok).text().toStdString();
+    prop.COMMANDS_TABLE_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > CommandsTable > ID_ColumnName", ok).text().toStdString();
 
-    prop.LOG_TABLE_COMMAND_ID_COLUMN_NAME = pXML->getTag("Settings > Database > Tables > LogTable > CommandID_ColumnName", ok).text().toStdString();
+    prop.COMMANDS_TABLE_COMMAND_COLUMN_NAME = getTag(document, "Settings > Database > Tables > CommandsTable > Command_ColumnName", ok).text().toStdString();
 
-    prop.INDICATORS_MAILBOX_NAME = pXML->getTag("Settings > Indicators > Mailbox > Name", ok).text().toStdString();
+    prop.COMMANDS_TABLE_CLEARANCE_COLUMN_NAME = getTag(document, "Settings > Database > Tables > CommandsTable > Clearance_ColumnName", ok).text().toStdString();
 
-    prop.INDICATORS_MB_SERVER_SUFFIX = pXML->getTag("Settings > Indicators > Mailbox > ServerSuffix", ok).text().toStdString();
+    prop.RFID_CARD_TABLE_NAME = getAttribute(document, "Settings > Database > Tables > RFID_CardTable > name", ok).toStdString();
 
-    prop.INDICATORS_MB_CLIENT_SUFFIX = pXML->getTag("Settings > Indicators > Mailbox > ClientSuffix", ok).text().toStdString();
+    prop.RFID_CARD_TABLE_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > RFID_CardTable > ID_ColumnName", ok).text().toStdString();
 
-    prop.INDICATORS_MB_TIMEOUT_MS = pXML->getTag("Settings > Indicators > Mailbox > Timeout_ms", ok).text().toUInt();
+    prop.RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > RFID_CardTable > CardUUID_ColumnName", ok).text().toStdString();
 
-    prop.BUZZER_BCM_PIN = pXML->getTag("Settings > Indicators > Buzzer > Pin", ok).text().toUInt();
+    prop.RFID_CARD_TABLE_OWNER_COLUMN_NAME = getTag(document, "Settings > Database > Tables > RFID_CardTable > Owner_ColumnName", ok).text().toStdString();
 
-    prop.DOOR_BCM_PIN = pXML->getTag("Settings > Indicators > Door > Pin", ok).text().toUInt();
+    prop.LOG_TABLE_NAME = getAttribute(document, "Settings > Database > Tables > LogTable > name", ok).toStdString();
 
-    prop.DOOR_OPEN_TIME_MS = pXML->getTag("Settings > Indicators > Door > OpenTime_ms", ok).text().toUInt();
+    prop.LOG_TABLE_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > LogTable > ID_ColumnName", ok).text().toStdString();
 
-    prop.LCD_I2C_BUS = pXML->getTag("Settings > Indicators > LCD > I2C > Bus", ok).text().toUInt();
+    prop.LOG_TABLE_TIMESTAMP_COLUMN_NAME = getTag(document, "Settings > Database > Tables > LogTable > Timestamp_ColumnName", ok).text().toStdString();
 
-    prop.LCD_DEFAULT_IDLE_MESSAGE = pXML->getTag("Settings > Indicators > LCD > IdleMessage", ok).text().toStdString();
+    prop.LOG_TABLE_USER_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > LogTable > UserID_ColumnName", ok).text().toStdString();
 
-    prop.BUZZER_PING_DURATION_MS = pXML->getTag("Settings > Indicators > Buzzer > PingDuration_ms", ok).text().toUInt();
+    prop.LOG_TABLE_AUTH_METHOD_COLUMN_NAME = getTag(document, "Settings > Database > Tables > LogTable > AuthMethod_ColumnName", ok).text().toStdString();
 
-    prop.LCD_I2C_ADDRESS = pXML->getTag("Settings > Indicators > LCD > I2C > Address", ok).text().toUInt();
+    prop.LOG_TABLE_COMMAND_ID_COLUMN_NAME = getTag(document, "Settings > Database > Tables > LogTable > CommandID_ColumnName", ok).text().toStdString();
 
-    prop.LCD_DEFULT_MSG_DISPLAY_TIME_MS = pXML->getTag("Settings > Indicators > LCD > MessageLingerTime_ms", ok).text().toUInt();
+    prop.INDICATORS_MAILBOX_NAME = getTag(document, "Settings > Indicators > Mailbox > Name", ok).text().toStdString();
 
-    prop.LCD_INTER_COMMANDS_WAIT_TIME_US = pXML->getTag("Settings > Indicators > LCD > InterCommandWaitTime_us", ok).text().toUInt();
+    prop.INDICATORS_MB_SERVER_SUFFIX = getTag(document, "Settings > Indicators > Mailbox > ServerSuffix", ok).text().toStdString();
 
-    prop.DEFAULT_MAX_LOG_FILE_SIZE = pXML->getTag("Settings > General > MaxLogFileSize_MB", ok).text().toUInt();
+    prop.INDICATORS_MB_CLIENT_SUFFIX = getTag(document, "Settings > Indicators > Mailbox > ClientSuffix", ok).text().toStdString();
 
-    prop.LOG_FILE_OLD_SUFFIX = pXML->getTag("Settings > General > LogFileOldSuffix", ok).text().toStdString();
+    prop.INDICATORS_MB_TIMEOUT_MS = getTag(document, "Settings > Indicators > Mailbox > Timeout_ms", ok).text().toUInt();
 
-    prop.MAX_CLEARANCE = pXML->getTag("Settings > Clearance > Max", ok).text().toInt();
+    prop.BUZZER_BCM_PIN = getTag(document, "Settings > Indicators > Buzzer > Pin", ok).text().toUInt();
 
-    prop.FAIL_SAFE_CLEARANCE = pXML->getTag("Settings > Clearance > Default", ok).text().toInt();
+    prop.DOOR_BCM_PIN = getTag(document, "Settings > Indicators > Door > Pin", ok).text().toUInt();
 
-    prop.NO_CLERANCE = pXML->getTag("Settings > Clearance > NoPrivileges", ok).text().toInt();
+    prop.DOOR_OPEN_TIME_MS = getTag(document, "Settings > Indicators > Door > OpenTime_ms", ok).text().toUInt();
 
-    prop.MAILBOX_REFRENCE_DEFAULT_NAME = pXML->getTag("Settings > General > MailboxRefenreceDefaultName", ok).text().toStdString();
+    prop.LCD_I2C_BUS = getTag(document, "Settings > Indicators > LCD > I2C > Bus", ok).text().toUInt();
 
-    prop.REQUEST_DEADLINE_TIMER_TIMEOUT_S = pXML->getTag("Settings > General > RequestDeadlineTimerTimeout_s", ok).text().toUInt();
+    prop.LCD_DEFAULT_IDLE_MESSAGE = getTag(document, "Settings > Indicators > LCD > IdleMessage", ok).text().toStdString();
+
+    prop.BUZZER_PING_DURATION_MS = getTag(document, "Settings > Indicators > Buzzer > PingDuration_ms", ok).text().toUInt();
+
+    prop.LCD_I2C_ADDRESS = getTag(document, "Settings > Indicators > LCD > I2C > Address", ok).text().toUInt();
+
+    prop.LCD_DEFULT_MSG_DISPLAY_TIME_MS = getTag(document, "Settings > Indicators > LCD > MessageLingerTime_ms", ok).text().toUInt();
+
+    prop.LCD_INTER_COMMANDS_WAIT_TIME_US = getTag(document, "Settings > Indicators > LCD > InterCommandWaitTime_us", ok).text().toUInt();
+
+    readSignalPatterns(document, prop, ok);
+
+    prop.DEFAULT_MAX_LOG_FILE_SIZE = getTag(document, "Settings > General > MaxLogFileSize_MB", ok).text().toUInt();
+
+    prop.LOG_FILE_OLD_SUFFIX = getTag(document, "Settings > General > LogFileOldSuffix", ok).text().toStdString();
+
+    prop.MAX_CLEARANCE = getTag(document, "Settings > Clearance > Max", ok).text().toInt();
+
+    prop.FAIL_SAFE_CLEARANCE = getTag(document, "Settings > Clearance > Default", ok).text().toInt();
+
+    prop.NO_CLERANCE = getTag(document, "Settings > Clearance > NoPrivileges", ok).text().toInt();
+
+    prop.MAILBOX_REFRENCE_DEFAULT_NAME = getTag(document, "Settings > General > MailboxRefenreceDefaultName", ok).text().toStdString();
+
+    prop.REQUEST_DEADLINE_TIMER_TIMEOUT_S = getTag(document, "Settings > General > RequestDeadlineTimerTimeout_s", ok).text().toUInt();
+
+    prop.DOORS = readDoors(document, prop, ok);
+
+    readHardware(document, prop, ok);
+
+    readAutomatonTrace(document, prop);
+
+    readMetrics(document, prop);
+    readWebAPI(document, prop);
+    readAccessGuard(document, prop);
+    readOfflineCache(document, prop);
+    readLogJournal(document, prop);
 
 
     return prop;
 }
 
+std::vector<DoorProperties> GlobalProperties::readDoors(const QDomDocument& document, const Properties& properties, bool& ok)
+{
+    std::vector<DoorProperties> doors;
+
+    // The section is optional: single-door config files keep working unchanged
+    bool hasDoors = true;
+    QDomElement doorsElement = getTag(document, "Settings > Doors", hasDoors);
+    if(!hasDoors)
+    {
+        doors.push_back(DoorProperties{ 1, properties.KEYPAD_ISTREAM_PATH, "", properties.BUZZER_BCM_PIN, properties.DOOR_BCM_PIN, DoorProperties::NO_PIN, properties.LCD_I2C_ADDRESS });
+        return doors;
+    }
+
+    auto childText = [&ok](const QDomElement& parent, const QString& tag)
+    {
+        QDomElement child = parent.firstChildElement(tag);
+        ok &= !child.isNull();
+        return child.text();
+    };
+
+    for(QDomElement doorElement = doorsElement.firstChildElement("Door"); !doorElement.isNull(); doorElement = doorElement.nextSiblingElement("Door"))
+    {
+        bool idOk = false;
+
+        DoorProperties door;
+        door.ID = doorElement.attribute("id").toUInt(&idOk);
+        door.KEYPAD_ISTREAM_PATH = childText(doorElement, "KeypadIstreamPath").toStdString();
+        // Optional, the default libnfc device is used without it
+        door.RFID_CONNSTRING = doorElement.firstChildElement("RFID_Connstring").text().toStdString();
+        door.BUZZER_BCM_PIN = childText(doorElement, "BuzzerPin").toUInt();
+        door.DOOR_BCM_PIN = childText(doorElement, "DoorPin").toUInt();
+        // Optional, doors without a status LED leave it out
+        bool hasLed = false;
+        door.LED_BCM_PIN = doorElement.firstChildElement("LedPin").text().toUInt(&hasLed);
+        if(!hasLed) door.LED_BCM_PIN = DoorProperties::NO_PIN;
+        door.LCD_I2C_ADDRESS = childText(doorElement, "LCD_I2C_Address").toUInt();
+
+        if(!idOk)
+        {
+            Trace("Door without a numeric id attribute");
+            ok = false;
+        }
+
+        doors.push_back(door);
+    }
+
+    return doors;
+}
+
+void GlobalProperties::readHardware(const QDomDocument& document, Properties& properties, bool& ok)
+{
+    // The section is optional: without it HardwareDaemon drives the Raspberry Pi hardware
+    bool hasHardware = true;
+    QDomElement hardwareElement = getTag(document, "Settings > Hardware", hasHardware);
+    if(!hasHardware)
+    {
+        properties.HARDWARE_BACKEND = "pi";
+        properties.SIMULATION_SCENARIO_PATH = "";
+        properties.SIMULATION_CONTROL_SOCKET = "";
+        properties.LATENCY_TRACE_SOCKET = "";
+        return;
+    }
+
+    QDomElement backendElement = hardwareElement.firstChildElement("Backend");
+    ok &= !backendElement.isNull();
+    properties.HARDWARE_BACKEND = backendElement.text().trimmed().toStdString();
+
+    QDomElement simulationElement = hardwareElement.firstChildElement("Simulation");
+    properties.SIMULATION_SCENARIO_PATH = simulationElement.firstChildElement("ScenarioPath").text().trimmed().toStdString();
+    properties.SIMULATION_CONTROL_SOCKET = simulationElement.firstChildElement("ControlSocket").text().trimmed().toStdString();
+
+    // Optional, requests are traced only while it is set
+    properties.LATENCY_TRACE_SOCKET = hardwareElement.firstChildElement("LatencyTraceSocket").text().trimmed().toStdString();
+}
+
+void GlobalProperties::readAutomatonTrace(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it the trace is on with the defaults below
+    properties.AUTOMATON_TRACE_NAME = "nfcdooraccess.trace";
+    properties.AUTOMATON_TRACE_RECORDS = 4096;
+
+    bool hasTrace = true;
+    QDomElement traceElement = getTag(document, "Settings > General > AutomatonTrace", hasTrace);
+    if(!hasTrace)
+    {
+        return;
+    }
+
+    const QString name = traceElement.firstChildElement("Name").text().trimmed();
+    if(!name.isEmpty())
+    {
+        properties.AUTOMATON_TRACE_NAME = name.toStdString();
+    }
+
+    bool recordsOk = false;
+    const unsigned int records = traceElement.firstChildElement("Records").text().toUInt(&recordsOk);
+    if(recordsOk)
+    {
+        properties.AUTOMATON_TRACE_RECORDS = records;
+    }
+}
+
+void GlobalProperties::readMetrics(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it metrics are published under the default name
+    properties.METRICS_NAME = "nfcdooraccess.metrics";
+
+    bool hasMetrics = true;
+    QDomElement metricsElement = getTag(document, "Settings > General > Metrics", hasMetrics);
+    if(!hasMetrics)
+    {
+        return;
+    }
+
+    // Present but empty turns publishing off
+    properties.METRICS_NAME = metricsElement.firstChildElement("Name").text().trimmed().toStdString();
+}
+
+void GlobalProperties::readWebAPI(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it the status pages are served on loopback only
+    properties.WEBAPI_ADDRESS = "127.0.0.1";
+    properties.WEBAPI_PORT = 8080;
+    properties.WEBAPI_MAX_CLIENTS = 32;
+    properties.WEBAPI_ADMIN_SOCKET = "";
+    properties.WEBAPI_MB_NAME = "webapi.mb";
+    properties.WEBAPI_IMPORT_TIMEOUT_MS = 60000;
+
+    bool hasWebAPI = true;
+    QDomElement webAPIElement = getTag(document, "Settings > General > WebAPI", hasWebAPI);
+    if(!hasWebAPI)
+    {
+        return;
+    }
+
+    const QString address = webAPIElement.firstChildElement("Address").text().trimmed();
+    if(!address.isEmpty())
+    {
+        properties.WEBAPI_ADDRESS = address.toStdString();
+    }
+
+    bool portOk = false;
+    const unsigned int port = webAPIElement.firstChildElement("Port").text().toUInt(&portOk);
+    if(portOk)
+    {
+        properties.WEBAPI_PORT = port;
+    }
+
+    bool clientsOk = false;
+    const unsigned int clients = webAPIElement.firstChildElement("MaxClients").text().toUInt(&clientsOk);
+    if(clientsOk)
+    {
+        properties.WEBAPI_MAX_CLIENTS = clients;
+    }
+
+    // Optional as well: without it there is no administration API
+    QDomElement adminElement = webAPIElement.firstChildElement("Admin");
+    if(adminElement.isNull())
+    {
+        return;
+    }
+
+    properties.WEBAPI_ADMIN_SOCKET = adminElement.firstChildElement("Socket").text().trimmed().toStdString();
+
+    const QString mailboxName = adminElement.firstChildElement("Mailbox").text().trimmed();
+    if(!mailboxName.isEmpty())
+    {
+        properties.WEBAPI_MB_NAME = mailboxName.toStdString();
+    }
+
+    bool timeoutOk = false;
+    const unsigned int importTimeout = adminElement.firstChildElement("ImportTimeout_ms").text().toUInt(&timeoutOk);
+    if(timeoutOk)
+    {
+        properties.WEBAPI_IMPORT_TIMEOUT_MS = importTimeout;
+    }
+}
+
+void GlobalProperties::readAccessGuard(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it brute force and card sharing are limited, anti-passback stays off
+    properties.GUARD_CREDENTIAL_MAX_ATTEMPTS = 10;
+    properties.GUARD_CREDENTIAL_WINDOW_S = 60;
+    properties.GUARD_DOOR_MAX_FAILURES = 5;
+    properties.GUARD_DOOR_WINDOW_S = 60;
+    properties.GUARD_LOCKOUT_S = 300;
+    properties.GUARD_ANTIPASSBACK_S = 0;
+
+    bool hasGuard = true;
+    QDomElement guardElement = getTag(document, "Settings > General > AccessGuard", hasGuard);
+    if(!hasGuard)
+    {
+        return;
+    }
+
+    const std::pair<const char*, unsigned int*> fields[] =
+    {
+        { "CredentialMaxAttempts", &properties.GUARD_CREDENTIAL_MAX_ATTEMPTS },
+        { "CredentialWindow_s", &properties.GUARD_CREDENTIAL_WINDOW_S },
+        { "DoorMaxFailures", &properties.GUARD_DOOR_MAX_FAILURES },
+        { "DoorWindow_s", &properties.GUARD_DOOR_WINDOW_S },
+        { "Lockout_s", &properties.GUARD_LOCKOUT_S },
+        { "AntiPassback_s", &properties.GUARD_ANTIPASSBACK_S }
+    };
+
+    for(const auto& field : fields)
+    {
+        bool valueOk = false;
+        const unsigned int value = guardElement.firstChildElement(field.first).text().toUInt(&valueOk);
+        if(valueOk)
+        {
+            *field.second = value;
+        }
+    }
+}
+
+void GlobalProperties::readOfflineCache(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it MainApplication never decides without DatabaseGateway
+    properties.OFFLINE_CACHE_PATH = "";
+    properties.OFFLINE_CACHE_ENTRIES = 10000;
+    properties.OFFLINE_CACHE_TTL_S = 7 * 24 * 3600;
+    properties.OFFLINE_DEADLINE_MS = 1500;
+    properties.OFFLINE_LOG_QUEUE_SIZE = 1000;
+
+    bool hasCache = true;
+    QDomElement cacheElement = getTag(document, "Settings > General > OfflineCache", hasCache);
+    if(!hasCache)
+    {
+        return;
+    }
+
+    properties.OFFLINE_CACHE_PATH = cacheElement.firstChildElement("Path").text().trimmed().toStdString();
+
+    const std::pair<const char*, unsigned int*> fields[] =
+    {
+        { "Entries", &properties.OFFLINE_CACHE_ENTRIES },
+        { "TTL_s", &properties.OFFLINE_CACHE_TTL_S },
+        { "Deadline_ms", &properties.OFFLINE_DEADLINE_MS },
+        { "LogQueueSize", &properties.OFFLINE_LOG_QUEUE_SIZE }
+    };
+
+    for(const auto& field : fields)
+    {
+        bool valueOk = false;
+        const unsigned int value = cacheElement.firstChildElement(field.first).text().toUInt(&valueOk);
+        if(valueOk)
+        {
+            *field.second = value;
+        }
+    }
+}
+
+void GlobalProperties::readLogJournal(const QDomDocument& document, Properties& properties)
+{
+    // The section is optional: without it a 1 MB journal holds a few thousand logs while LogTable is busy
+    properties.LOG_JOURNAL_SIZE_KB = 1024;
+    properties.LOG_JOURNAL_BATCH = 64;
+    properties.LOG_JOURNAL_FULL_WAIT_MS = 100;
+
+    bool hasJournal = true;
+    QDomElement journalElement = getTag(document, "Settings > Database > LogJournal", hasJournal);
+    if(!hasJournal)
+    {
+        return;
+    }
+
+    const std::pair<const char*, unsigned int*> fields[] =
+    {
+        { "Size_kB", &properties.LOG_JOURNAL_SIZE_KB },
+        { "Batch", &properties.LOG_JOURNAL_BATCH },
+        { "FullWait_ms", &properties.LOG_JOURNAL_FULL_WAIT_MS }
+    };
+
+    for(const auto& field : fields)
+    {
+        bool valueOk = false;
+        const unsigned int value = journalElement.firstChildElement(field.first).text().toUInt(&valueOk);
+        if(valueOk)
+        {
+            *field.second = value;
+        }
+    }
+}
+
+void GlobalProperties::readSignalPatterns(const QDomDocument& document, Properties& properties, bool& ok)
+{
+    // The section is optional: without it the patterns the buzzer and door always played are used
+    bool hasPatterns = true;
+    QDomElement patternsElement = getTag(document, "Settings > Indicators > Patterns", hasPatterns);
+    if(!hasPatterns)
+    {
+        const std::string tone = std::to_string(5 * properties.BUZZER_PING_DURATION_MS);
+        const std::string longTone = std::to_string(25 * properties.BUZZER_PING_DURATION_MS);
+
+        properties.SIGNAL_PATTERN_PING = "buzzer:" + std::to_string(2 * properties.BUZZER_PING_DURATION_MS);
+        properties.SIGNAL_PATTERN_PING_PRIORITY = 0;
+        properties.SIGNAL_PATTERN_SUCCESS = "buzzer:" + tone + " -:" + tone + " buzzer:" + tone;
+        properties.SIGNAL_PATTERN_SUCCESS_PRIORITY = 1;
+        properties.SIGNAL_PATTERN_FAILURE = "buzzer:" + tone + " -:" + tone + " buzzer:" + longTone;
+        properties.SIGNAL_PATTERN_FAILURE_PRIORITY = 1;
+        properties.SIGNAL_PATTERN_DOOR_OPEN = "door:" + std::to_string(properties.DOOR_OPEN_TIME_MS);
+        properties.SIGNAL_PATTERN_DOOR_OPEN_PRIORITY = 0;
+        return;
+    }
+
+    auto readPattern = [&ok, &patternsElement](const QString& tag, std::string& pattern, unsigned int& priority)
+    {
+        QDomElement patternElement = patternsElement.firstChildElement(tag);
+        ok &= !patternElement.isNull();
+        pattern = patternElement.text().simplified().toStdString();
+        // Optional, lowest priority without it
+        priority = patternElement.attribute("priority", "0").toUInt();
+    };
+
+    readPattern("Ping", properties.SIGNAL_PATTERN_PING, properties.SIGNAL_PATTERN_PING_PRIORITY);
+    readPattern("Success", properties.SIGNAL_PATTERN_SUCCESS, properties.SIGNAL_PATTERN_SUCCESS_PRIORITY);
+    readPattern("Failure", properties.SIGNAL_PATTERN_FAILURE, properties.SIGNAL_PATTERN_FAILURE_PRIORITY);
+    readPattern("DoorOpen", properties.SIGNAL_PATTERN_DOOR_OPEN, properties.SIGNAL_PATTERN_DOOR_OPEN_PRIORITY);
+}
+
+bool GlobalProperties::Reload()
+{
+    GlobalProperties* pXML = GlobalProperties::getInstance();
+
+    QDomDocument document;
+    if(!loadDocument(document))
+    {
+        pXML->Trace("Config reload rejected: cannot open or parse " + CONFIG_PATH);
+        return false;
+    }
+
+    bool ok = true;
+    Properties newProperties = pXML->readProperties(document, ok);
+    if(!ok)
+    {
+        pXML->Trace("Config reload rejected: missing required settings");
+        return false;
+    }
+
+    QString error;
+    if(!validate(newProperties, error))
+    {
+        pXML->Trace("Config reload rejected: " + error);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(watcherMutex);
+
+    const Snapshot* pCurrent = currentSnapshot();
+    std::vector<std::string> restartRequired = keepRestartRequiredSettings(newProperties, pCurrent->properties);
+    // Default patterns are derived from restart-required settings (DOOR_OPEN_TIME_MS), derive them from the kept values
+    readSignalPatterns(document, newProperties, ok);
+
+    // Old snapshots are intentionally leaked: callers may hold references returned by Get()
+    // indefinitely, and reloads are rare, so this costs one Properties object per reload.
+    const Snapshot* pNew = new Snapshot{ newProperties, pCurrent->version + 1 };
+    m_pSnapshot.store(pNew, std::memory_order_release);
+
+    pXML->Trace(QString("Config reloaded, version %1").arg(pNew->version));
+    for(const std::string& setting : restartRequired)
+    {
+        pXML->Trace(QString("Setting %1 changed but requires restart").arg(QString::fromStdString(setting)));
+    }
+
+    for(IPropertiesSubscriber* pSubscriber : subscribers)
+    {
+        pSubscriber->PropertiesChanged(pNew->properties, pNew->version, restartRequired);
+    }
+
+    return true;
+}
+
+bool GlobalProperties::validate(const Properties& properties, QString& error)
+{
+    if(properties.KEYPAD_BUFFER_SIZE == 0 || properties.RFID_BUFFER_SIZE == 0)
+    {
+        error = "buffer sizes must be greater than 0";
+        return false;
+    }
+
+    if(properties.REQUEST_DEADLINE_TIMER_TIMEOUT_S == 0)
+    {
+        error = "request deadline must be greater than 0";
+        return false;
+    }
+
+    if(properties.RFID_READ_TIMEOUT_MS == 0)
+    {
+        error = "RFID read timeout must be greater than 0";
+        return false;
+    }
+
+    if(properties.RFID_IDLE_POLL_INTERVAL_MS < properties.RFID_READ_TIMEOUT_MS)
+    {
+        error = "RFID idle poll interval cannot be shorter than the read timeout";
+        return false;
+    }
+
+    if(properties.RFID_DUTY_CYCLE_PERCENT == 0 || properties.RFID_DUTY_CYCLE_PERCENT > 100)
+    {
+        error = "RFID duty cycle must be between 1 and 100 percent";
+        return false;
+    }
+
+    if(properties.QUEUE_SIZE <= 0 || properties.MAX_MSG_SIZE <= 0)
+    {
+        error = "mailbox queue_size and msg_size must be greater than 0";
+        return false;
+    }
+
+    if(properties.KEYPAD_PIPE_NAME.empty() || properties.RFID_PIPE_NAME.empty())
+    {
+        error = "keypad and RFID pipe names cannot be empty";
+        return false;
+    }
+
+    if(properties.LCD_DEFAULT_IDLE_MESSAGE.empty())
+    {
+        error = "LCD idle message cannot be empty";
+        return false;
+    }
+
+    if(properties.SIGNAL_PATTERN_PING.empty() || properties.SIGNAL_PATTERN_SUCCESS.empty()
+        || properties.SIGNAL_PATTERN_FAILURE.empty() || properties.SIGNAL_PATTERN_DOOR_OPEN.empty())
+    {
+        error = "signal patterns cannot be empty";
+        return false;
+    }
+
+    if(properties.HARDWARE_BACKEND != "pi" && properties.HARDWARE_BACKEND != "simulated")
+    {
+        error = QString("unknown hardware backend '%1', expected pi or simulated").arg(QString::fromStdString(properties.HARDWARE_BACKEND));
+        return false;
+    }
+
+    if(properties.WEBAPI_PORT == 0 || properties.WEBAPI_PORT > 65535 || properties.WEBAPI_MAX_CLIENTS == 0)
+    {
+        error = "web API port must be between 1 and 65535 and max clients greater than 0";
+        return false;
+    }
+
+    if(!properties.WEBAPI_ADMIN_SOCKET.empty() && properties.WEBAPI_ADMIN_SOCKET.size() >= 108)
+    {
+        error = "web API admin socket path must be shorter than 108 characters";
+        return false;
+    }
+
+    // Each tracked credential and door input keeps its last MaxAttempts / MaxFailures timestamps
+    if(properties.GUARD_CREDENTIAL_MAX_ATTEMPTS > 1000 || properties.GUARD_DOOR_MAX_FAILURES > 1000)
+    {
+        error = "access guard attempt and failure limits cannot exceed 1000";
+        return false;
+    }
+
+    if((properties.GUARD_CREDENTIAL_MAX_ATTEMPTS != 0 && properties.GUARD_CREDENTIAL_WINDOW_S == 0)
+        || (properties.GUARD_DOOR_MAX_FAILURES != 0 && properties.GUARD_DOOR_WINDOW_S == 0)
+        || ((properties.GUARD_CREDENTIAL_MAX_ATTEMPTS != 0 || properties.GUARD_DOOR_MAX_FAILURES != 0) && properties.GUARD_LOCKOUT_S == 0))
+    {
+        error = "access guard windows and lockout must be greater than 0 while a limit is enabled";
+        return false;
+    }
+
+    if(!properties.OFFLINE_CACHE_PATH.empty() && (properties.OFFLINE_CACHE_ENTRIES == 0 || properties.OFFLINE_DEADLINE_MS == 0))
+    {
+        error = "offline cache entries and deadline must be greater than 0 while the cache is enabled";
+        return false;
+    }
+
+    // The journal is mapped whole, 1 GB is far more than any outage needs
+    if(properties.LOG_JOURNAL_SIZE_KB < 4 || properties.LOG_JOURNAL_SIZE_KB > 1024 * 1024 || properties.LOG_JOURNAL_BATCH == 0)
+    {
+        error = "log journal size must be between 4 and 1048576 kB and its batch greater than 0";
+        return false;
+    }
+
+    if(properties.DOORS.empty())
+    {
+        error = "at least one door must be configured";
+        return false;
+    }
+
+    for(size_t i = 0; i < properties.DOORS.size(); ++i)
+    {
+        const DoorProperties& door = properties.DOORS[i];
+
+        if(door.ID == 0 || door.ID > DoorProperties::MAX_ID)
+        {
+            error = QString("door ID %1 is out of range 1 - %2").arg(door.ID).arg(DoorProperties::MAX_ID);
+            return false;
+        }
+
+        for(size_t j = 0; j < i; ++j)
+        {
+            if(properties.DOORS[j].ID == door.ID)
+            {
+                error = QString("door ID %1 is used more than once").arg(door.ID);
+                return false;
+            }
+        }
+    }
+
+    if(properties.NO_CLERANCE >= properties.MAX_CLEARANCE || properties.FAIL_SAFE_CLEARANCE > properties.NO_CLERANCE)
+    {
+        error = "clearance levels must satisfy Default <= NoPrivileges < Max";
+        return false;
+    }
+
+    return true;
+}
+
+// Settings which are read once (names of mailboxes, pipes, tables, files, pins, buffer sizes...)
+// and cannot be applied without restarting the process. Anything not listed here is applied live.
+#define RESTART_REQUIRED(FIELD) \
+    if(newProperties.FIELD != current.FIELD) \
+    { \
+        restartRequired.push_back(#FIELD); \
+        newProperties.FIELD = current.FIELD; \
+    }
+
+std::vector<std::string> GlobalProperties::keepRestartRequiredSettings(Properties& newProperties, const Properties& current)
+{
+    std::vector<std::string> restartRequired;
+
+    RESTART_REQUIRED(KEYPAD_BUFFER_SIZE);
+    RESTART_REQUIRED(RFID_BUFFER_SIZE);
+    RESTART_REQUIRED(DB_PATH);
+    RESTART_REQUIRED(QUEUE_SIZE);
+    RESTART_REQUIRED(MAX_MSG_SIZE);
+    RESTART_REQUIRED(MAIN_MB_NAME);
+    RESTART_REQUIRED(DBGW_MB_NAME);
+    RESTART_REQUIRED(DATABASE_MB_TIMEOUT);
+    RESTART_REQUIRED(DATABASE_LOG_THREAD_MAILBOX_NAME);
+    RESTART_REQUIRED(HARDWARED_MB_NAME);
+    RESTART_REQUIRED(KERNEL_LOG_NAME);
+    RESTART_REQUIRED(WATCHDOG_SERVER_NAME);
+    RESTART_REQUIRED(HARDWARED_WATCHDOG_NAME);
+    RESTART_REQUIRED(MAIN_WATCHDOG_NAME);
+    RESTART_REQUIRED(DATABASE_WATCHDOG_NAME);
+    RESTART_REQUIRED(WATCHDOG_SERVER_PERIOD_MS);
+    RESTART_REQUIRED(HARDWARED_WD_TIMEOUT_MS);
+    RESTART_REQUIRED(HARDWARED_WD_TTL);
+    RESTART_REQUIRED(MAIN_WD_TIMEOUT_MS);
+    RESTART_REQUIRED(MAIN_WD_TTL);
+    RESTART_REQUIRED(DB_WD_TIMEOUT_MS);
+    RESTART_REQUIRED(DB_WD_TTL);
+    RESTART_REQUIRED(HARDWARED_EXECUTABLE);
+    RESTART_REQUIRED(MAIN_APP_EXECUTABLE);
+    RESTART_REQUIRED(DBGW_EXECUTABLE);
+    RESTART_REQUIRED(KEYPAD_PIPE_NAME);
+    RESTART_REQUIRED(RFID_PIPE_NAME);
+    RESTART_REQUIRED(KEYPAD_ISTREAM_PATH);
+    RESTART_REQUIRED(DOORS);
+    RESTART_REQUIRED(EMPLOYEES_TABLE_NAME);
+    RESTART_REQUIRED(EMPLOYEES_TABLE_ID_COLUMN_NAME);
+    RESTART_REQUIRED(EMPLOYEES_TABLE_NAME_COLUMN_NAME);
+    RESTART_REQUIRED(EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME);
+    RESTART_REQUIRED(KEYPAD_PASS_TABLE_NAME);
+    RESTART_REQUIRED(KEYPAD_PASS_TABLE_ID_COLUMN_NAME);
+    RESTART_REQUIRED(KEYPAD_PASS_TABLE_PASSWORD_COLUMN_NAME);
+    RESTART_REQUIRED(KEYPAD_PASS_TABLE_OWNER_COLUMN_NAME);
+    RESTART_REQUIRED(COMMANDS_TABLE_NAME);
+    RESTART_REQUIRED(COMMANDS_TABLE_ID_COLUMN_NAME);
+    RESTART_REQUIRED(COMMANDS_TABLE_COMMAND_COLUMN_NAME);
+    RESTART_REQUIRED(COMMANDS_TABLE_CLEARANCE_COLUMN_NAME);
+    RESTART_REQUIRED(RFID_CARD_TABLE_NAME);
+    RESTART_REQUIRED(RFID_CARD_TABLE_ID_COLUMN_NAME);
+    RESTART_REQUIRED(RFID_CARD_TABLE_CARD_UUID_COLUMN_NAME);
+    RESTART_REQUIRED(RFID_CARD_TABLE_OWNER_COLUMN_NAME);
+    RESTART_REQUIRED(LOG_TABLE_NAME);
+    RESTART_REQUIRED(LOG_TABLE_ID_COLUMN_NAME);
+    RESTART_REQUIRED(LOG_TABLE_TIMESTAMP_COLUMN_NAME);
+    RESTART_REQUIRED(LOG_TABLE_USER_ID_COLUMN_NAME);
+    RESTART_REQUIRED(LOG_TABLE_AUTH_METHOD_COLUMN_NAME);
+    RESTART_REQUIRED(LOG_TABLE_COMMAND_ID_COLUMN_NAME);
+    RESTART_REQUIRED(INDICATORS_MAILBOX_NAME);
+    RESTART_REQUIRED(INDICATORS_MB_SERVER_SUFFIX);
+    RESTART_REQUIRED(INDICATORS_MB_CLIENT_SUFFIX);
+    RESTART_REQUIRED(INDICATORS_MB_TIMEOUT_MS);
+    RESTART_REQUIRED(BUZZER_BCM_PIN);
+    RESTART_REQUIRED(DOOR_BCM_PIN);
+    RESTART_REQUIRED(DOOR_OPEN_TIME_MS);
+    RESTART_REQUIRED(LCD_I2C_BUS);
+    RESTART_REQUIRED(LCD_I2C_ADDRESS);
+    RESTART_REQUIRED(LCD_DEFULT_MSG_DISPLAY_TIME_MS);
+    RESTART_REQUIRED(DEFAULT_MAX_LOG_FILE_SIZE);
+    RESTART_REQUIRED(LOG_FILE_OLD_SUFFIX);
+    RESTART_REQUIRED(MAX_CLEARANCE);
+    RESTART_REQUIRED(FAIL_SAFE_CLEARANCE);
+    RESTART_REQUIRED(NO_CLERANCE);
+    RESTART_REQUIRED(MAILBOX_REFRENCE_DEFAULT_NAME);
+    RESTART_REQUIRED(REQUEST_DEADLINE_TIMER_TIMEOUT_S);
+    RESTART_REQUIRED(HARDWARE_BACKEND);
+    RESTART_REQUIRED(SIMULATION_SCENARIO_PATH);
+    RESTART_REQUIRED(SIMULATION_CONTROL_SOCKET);
+    RESTART_REQUIRED(LATENCY_TRACE_SOCKET);
+    RESTART_REQUIRED(AUTOMATON_TRACE_NAME);
+    RESTART_REQUIRED(AUTOMATON_TRACE_RECORDS);
+    RESTART_REQUIRED(METRICS_NAME);
+    RESTART_REQUIRED(WEBAPI_ADDRESS);
+    RESTART_REQUIRED(WEBAPI_PORT);
+    RESTART_REQUIRED(WEBAPI_MAX_CLIENTS);
+    RESTART_REQUIRED(WEBAPI_ADMIN_SOCKET);
+    RESTART_REQUIRED(WEBAPI_MB_NAME);
+    RESTART_REQUIRED(OFFLINE_CACHE_PATH);
+    RESTART_REQUIRED(OFFLINE_CACHE_ENTRIES);
+    RESTART_REQUIRED(OFFLINE_CACHE_TTL_S);
+    RESTART_REQUIRED(OFFLINE_LOG_QUEUE_SIZE);
+    RESTART_REQUIRED(LOG_JOURNAL_SIZE_KB);
+    RESTART_REQUIRED(LOG_JOURNAL_BATCH);
+    RESTART_REQUIRED(LOG_JOURNAL_FULL_WAIT_MS);
+
+    return restartRequired;
+}
+
+#undef RESTART_REQUIRED
+
+void GlobalProperties::Subscribe(IPropertiesSubscriber* pSubscriber)
+{
+    if(pSubscriber == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(watcherMutex);
+    subscribers.push_back(pSubscriber);
+}
+
+void GlobalProperties::Unsubscribe(IPropertiesSubscriber* pSubscriber)
+{
+    std::lock_guard<std::mutex> lock(watcherMutex);
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), pSubscriber), subscribers.end());
+}
+
+void PropertiesChangeFlag::PropertiesChanged(const Properties&, unsigned int, const std::vector<std::string>& restartRequired)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(const std::string& setting : restartRequired)
+    {
+        if(std::find(m_restartRequired.begin(), m_restartRequired.end(), setting) == m_restartRequired.end())
+        {
+            m_restartRequired.push_back(setting);
+        }
+    }
+    m_changed.store(true, std::memory_order_release);
+}
+
+bool PropertiesChangeFlag::TakeChange(std::vector<std::string>& restartRequired)
+{
+    if(!m_changed.load(std::memory_order_acquire)) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changed.store(false, std::memory_order_relaxed);
+    restartRequired.swap(m_restartRequired);
+    m_restartRequired.clear();
+    return true;
+}
+
+bool GlobalProperties::StartWatching()
+{
+    // Make sure the initial snapshot exists before anything can be reloaded
+    currentSnapshot();
+
+    std::lock_guard<std::mutex> lock(watcherMutex);
+    if(watcherThread.joinable()) return true;
+
+    QFileInfo configFile(CONFIG_PATH);
+
+    // Watch the directory, not the file: editors and deployment scripts usually replace config.xml with rename()
+    int inotifyFd = inotify_init1(IN_CLOEXEC);
+    if(inotifyFd < 0)
+    {
+        getInstance()->Trace("Cannot watch config file: inotify_init1() failed");
+        return false;
+    }
+
+    if(inotify_add_watch(inotifyFd, configFile.absolutePath().toStdString().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        getInstance()->Trace("Cannot watch config file: inotify_add_watch() failed");
+        close(inotifyFd);
+        return false;
+    }
+
+    watcherStopFd = eventfd(0, EFD_CLOEXEC);
+    if(watcherStopFd < 0)
+    {
+        getInstance()->Trace("Cannot watch config file: eventfd() failed");
+        close(inotifyFd);
+        return false;
+    }
+
+    watcherThread = std::thread(watchConfigFile, inotifyFd, watcherStopFd);
+    return true;
+}
+
+void GlobalProperties::StopWatching()
+{
+    std::thread stoppedThread;
+    {
+        std::lock_guard<std::mutex> lock(watcherMutex);
+        if(!watcherThread.joinable()) return;
+
+        uint64_t stop = 1;
+        if(write(watcherStopFd, &stop, sizeof(stop)) != sizeof(stop))
+        {
+            getInstance()->Trace("Cannot signal config watcher thread to stop");
+        }
+
+        stoppedThread = std::move(watcherThread);
+    }
+
+    // Joined without the lock - the watcher thread takes it in Reload()
+    stoppedThread.join();
+
+    std::lock_guard<std::mutex> lock(watcherMutex);
+    close(watcherStopFd);
+    watcherStopFd = -1;
+}
+
+void GlobalProperties::watchConfigFile(int inotifyFd, int stopFd)
+{
+    const std::string configFileName = QFileInfo(CONFIG_PATH).fileName().toStdString();
+
+    alignas(inotify_event) char buffer[4096];
+
+    pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+
+    while(true)
+    {
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+
+        if(fds[1].revents != 0) break;
+        if((fds[0].revents & POLLIN) == 0) continue;
+
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0) continue;
+
+        // Several events for the same file (e.g. write + rename) result in a single reload
+        bool configChanged = false;
+        for(char* pEvent = buffer; pEvent < buffer + length; )
+        {
+            const inotify_event* pInotifyEvent = (const inotify_event*)pEvent;
+            if(pInotifyEvent->len > 0 && configFileName == pInotifyEvent->name)
+            {
+                configChanged = true;
+            }
+            pEvent += sizeof(inotify_event) + pInotifyEvent->len;
+        }
+
+        if(configChanged) Reload();
+    }
+
+    close(inotifyFd);
+}
+
 void GlobalProperties::FatalError(const QString& msg)
 {
     qDebug() << msg;
@@ -278,11 +1175,9 @@ QStringList GlobalProperties::parseNodeName(const QString& rawName)
     return path;
 }
 
-QDomElement GlobalProperties::getParentNodeWithPath(const QStringList& nodePath, bool& ok)
+QDomElement GlobalProperties::getParentNodeWithPath(const QDomDocument& document, const QStringList& nodePath, bool& ok)
 {
-    QDomElement currentElement = m_XML_document.firstChildElement();
-
-    ok = false;
+    QDomElement currentElement = document.firstChildElement();
 
     QString debugPath = "[root]/";
 
@@ -307,7 +1202,8 @@ QDomElement GlobalProperties::getParentNodeWithPath(const QStringList& nodePath,
 
         if(!contains)
         {
-            FatalError(QString("Element: %1 doesn't contain node: %2").arg(debugPath).arg(currentPath));
+            // Not fatal here - Parse() exits on error, Reload() rejects the file
+            Trace(QString("Element: %1 doesn't contain node: %2").arg(debugPath).arg(currentPath));
 
             ok = false;
             return QDomElement();
@@ -317,23 +1213,22 @@ QDomElement GlobalProperties::getParentNodeWithPath(const QStringList& nodePath,
 
     }
 
-    ok = true;
     return currentElement;
 }
 
 bool GlobalProperties::existsTag(const QString& path)
 {
-    bool exists = false;
+    bool exists = true;
     // ignore ret value
-    getTag(path, exists);
+    getTag(m_XML_document, path, exists);
     return exists;
 }
 
 bool GlobalProperties::existsAttribute(const QString& path)
 {
-    bool exists = false;
+    bool exists = true;
     // ignore ret value
-    getAttribute(path, exists);
+    getAttribute(m_XML_document, path, exists);
     return exists;
 }
 
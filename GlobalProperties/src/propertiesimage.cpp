@@ -0,0 +1,336 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "propertiesimage.h"
+
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+    /// Appends fields to the image payload
+    class ImageWriter
+    {
+    public:
+        std::string m_payload;
+
+        void putUInt(uint32_t value)
+        {
+            m_payload.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void putInt(int32_t value)
+        {
+            m_payload.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        void putString(const std::string& value)
+        {
+            putUInt(static_cast<uint32_t>(value.size()));
+            m_payload.append(value);
+        }
+    };
+
+    /// Reads fields from a mapped payload; every read is bounds checked and failures are sticky
+    class ImageReader
+    {
+    public:
+        ImageReader(const char* begin, const char* end) : m_it(begin), m_end(end), m_ok(true) {}
+
+        unsigned int getUInt()
+        {
+            uint32_t value = 0;
+            copy(&value, sizeof(value));
+            return value;
+        }
+
+        int getInt()
+        {
+            int32_t value = 0;
+            copy(&value, sizeof(value));
+            return value;
+        }
+
+        std::string getString()
+        {
+            const uint32_t size = getUInt();
+            if(!m_ok || size > static_cast<size_t>(m_end - m_it))
+            {
+                m_ok = false;
+                return std::string();
+            }
+
+            std::string value(m_it, size);
+            m_it += size;
+            return value;
+        }
+
+        /// True if at least `count` more bytes are left and no read has failed yet
+        bool canRead(size_t count) const { return m_ok && count <= static_cast<size_t>(m_end - m_it); }
+
+        /// True if every field was read and the whole payload was consumed
+        bool finished() const { return m_ok && m_it == m_end; }
+
+    private:
+        void copy(void* pDestination, size_t size)
+        {
+            if(!m_ok || size > static_cast<size_t>(m_end - m_it))
+            {
+                m_ok = false;
+                return;
+            }
+
+            std::memcpy(pDestination, m_it, size);
+            m_it += size;
+        }
+
+        const char* m_it;
+        const char* m_end;
+        bool m_ok;
+    };
+
+    // Structs generated from the field lists. Any field missing from a list, listed out of order
+    // or with the wrong type moves the offsets or the size, which is caught at compile time below.
+#define PROPERTIES_IMAGE_MIRROR_UINT(NAME) unsigned int NAME;
+#define PROPERTIES_IMAGE_MIRROR_INT(NAME) int NAME;
+#define PROPERTIES_IMAGE_MIRROR_STRING(NAME) std::string NAME;
+#define PROPERTIES_IMAGE_MIRROR_DOOR_LIST(NAME) std::vector<DoorProperties> NAME;
+    struct PropertiesMirror
+    {
+        PROPERTIES_IMAGE_FIELDS(PROPERTIES_IMAGE_MIRROR_UINT, PROPERTIES_IMAGE_MIRROR_INT, PROPERTIES_IMAGE_MIRROR_STRING, PROPERTIES_IMAGE_MIRROR_DOOR_LIST)
+    };
+
+    struct DoorPropertiesMirror
+    {
+        PROPERTIES_IMAGE_DOOR_FIELDS(PROPERTIES_IMAGE_MIRROR_UINT, PROPERTIES_IMAGE_MIRROR_STRING)
+    };
+#undef PROPERTIES_IMAGE_MIRROR_UINT
+#undef PROPERTIES_IMAGE_MIRROR_INT
+#undef PROPERTIES_IMAGE_MIRROR_STRING
+#undef PROPERTIES_IMAGE_MIRROR_DOOR_LIST
+}
+
+static_assert(sizeof(PropertiesMirror) == sizeof(Properties), "PROPERTIES_IMAGE_FIELDS is out of sync with Properties");
+static_assert(sizeof(DoorPropertiesMirror) == sizeof(DoorProperties), "PROPERTIES_IMAGE_DOOR_FIELDS is out of sync with DoorProperties");
+
+#define PROPERTIES_IMAGE_CHECK_FIELD(STRUCT, NAME) \
+    static_assert(offsetof(STRUCT##Mirror, NAME) == offsetof(STRUCT, NAME) \
+        && std::is_same<decltype(STRUCT##Mirror::NAME), decltype(STRUCT::NAME)>::value, \
+        #NAME " is out of place in the image field lists or has a different type in properties.h");
+#define PROPERTIES_IMAGE_CHECK(NAME) PROPERTIES_IMAGE_CHECK_FIELD(Properties, NAME)
+#define PROPERTIES_IMAGE_CHECK_DOOR(NAME) PROPERTIES_IMAGE_CHECK_FIELD(DoorProperties, NAME)
+PROPERTIES_IMAGE_FIELDS(PROPERTIES_IMAGE_CHECK, PROPERTIES_IMAGE_CHECK, PROPERTIES_IMAGE_CHECK, PROPERTIES_IMAGE_CHECK)
+PROPERTIES_IMAGE_DOOR_FIELDS(PROPERTIES_IMAGE_CHECK_DOOR, PROPERTIES_IMAGE_CHECK_DOOR)
+#undef PROPERTIES_IMAGE_CHECK_FIELD
+#undef PROPERTIES_IMAGE_CHECK
+#undef PROPERTIES_IMAGE_CHECK_DOOR
+
+bool PropertiesImage::StatSource(const std::string& path, Source& source)
+{
+    struct stat fileStatus;
+    if(stat(path.c_str(), &fileStatus) < 0)
+    {
+        return false;
+    }
+
+    source.modificationTime_ns = static_cast<int64_t>(fileStatus.st_mtim.tv_sec) * 1000000000LL + fileStatus.st_mtim.tv_nsec;
+    source.size = static_cast<int64_t>(fileStatus.st_size);
+    return true;
+}
+
+bool PropertiesImage::Write(const std::string& imagePath, const Properties& properties, const Source& source)
+{
+    ImageWriter writer;
+
+#define PROPERTIES_IMAGE_PUT_UINT(NAME) writer.putUInt(properties.NAME);
+#define PROPERTIES_IMAGE_PUT_INT(NAME) writer.putInt(properties.NAME);
+#define PROPERTIES_IMAGE_PUT_STRING(NAME) writer.putString(properties.NAME);
+#define PROPERTIES_IMAGE_PUT_DOOR_UINT(NAME) writer.putUInt(door.NAME);
+#define PROPERTIES_IMAGE_PUT_DOOR_STRING(NAME) writer.putString(door.NAME);
+#define PROPERTIES_IMAGE_PUT_DOOR_LIST(NAME) \
+    writer.putUInt(static_cast<uint32_t>(properties.NAME.size())); \
+    for(const DoorProperties& door : properties.NAME) { PROPERTIES_IMAGE_DOOR_FIELDS(PROPERTIES_IMAGE_PUT_DOOR_UINT, PROPERTIES_IMAGE_PUT_DOOR_STRING) }
+    PROPERTIES_IMAGE_FIELDS(PROPERTIES_IMAGE_PUT_UINT, PROPERTIES_IMAGE_PUT_INT, PROPERTIES_IMAGE_PUT_STRING, PROPERTIES_IMAGE_PUT_DOOR_LIST)
+#undef PROPERTIES_IMAGE_PUT_UINT
+#undef PROPERTIES_IMAGE_PUT_INT
+#undef PROPERTIES_IMAGE_PUT_STRING
+#undef PROPERTIES_IMAGE_PUT_DOOR_UINT
+#undef PROPERTIES_IMAGE_PUT_DOOR_STRING
+#undef PROPERTIES_IMAGE_PUT_DOOR_LIST
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = MAGIC;
+    header.formatVersion = FORMAT_VERSION;
+    header.layoutFingerprint = layoutFingerprint();
+    header.payloadSize = static_cast<uint32_t>(writer.m_payload.size());
+    header.payloadChecksum = Checksum(writer.m_payload.data(), writer.m_payload.size());
+    header.sourceModificationTime_ns = source.modificationTime_ns;
+    header.sourceSize = source.size;
+
+    // Per-process temporary name: two processes exporting at once must not interleave writes
+    const std::string tmpPath = imagePath + ".tmp." + std::to_string(getpid());
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    bool written = ::write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header))
+        && ::write(fd, writer.m_payload.data(), writer.m_payload.size()) == static_cast<ssize_t>(writer.m_payload.size());
+    written &= (close(fd) == 0);
+
+    if(!written || std::rename(tmpPath.c_str(), imagePath.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool PropertiesImage::Read(const std::string& imagePath, const Source& source, Properties& properties)
+{
+    int fd = open(imagePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    struct stat imageStatus;
+    if(fstat(fd, &imageStatus) < 0 || static_cast<size_t>(imageStatus.st_size) < sizeof(Header))
+    {
+        close(fd);
+        return false;
+    }
+
+    const size_t imageSize = static_cast<size_t>(imageStatus.st_size);
+    void* pMapping = mmap(nullptr, imageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(pMapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const char* pImage = static_cast<const char*>(pMapping);
+    Header header;
+    std::memcpy(&header, pImage, sizeof(header));
+
+    const char* pPayload = pImage + sizeof(Header);
+    bool valid = header.magic == MAGIC
+        && header.formatVersion == FORMAT_VERSION
+        && header.layoutFingerprint == layoutFingerprint()
+        && header.reserved == 0
+        && header.payloadSize == imageSize - sizeof(Header)
+        && header.sourceModificationTime_ns == source.modificationTime_ns
+        && header.sourceSize == source.size
+        && header.payloadChecksum == Checksum(pPayload, header.payloadSize);
+
+    if(valid)
+    {
+        ImageReader reader(pPayload, pPayload + header.payloadSize);
+        Properties decoded{};
+
+#define PROPERTIES_IMAGE_GET_UINT(NAME) decoded.NAME = reader.getUInt();
+#define PROPERTIES_IMAGE_GET_INT(NAME) decoded.NAME = reader.getInt();
+#define PROPERTIES_IMAGE_GET_STRING(NAME) decoded.NAME = reader.getString();
+#define PROPERTIES_IMAGE_GET_DOOR_UINT(NAME) door.NAME = reader.getUInt();
+#define PROPERTIES_IMAGE_GET_DOOR_STRING(NAME) door.NAME = reader.getString();
+        // The count is bounded by the payload size, so a corrupted count cannot trigger a huge allocation
+#define PROPERTIES_IMAGE_GET_DOOR_LIST(NAME) \
+        for(uint32_t count = reader.getUInt(); count > 0 && reader.canRead(count); --count) \
+        { \
+            DoorProperties door{}; \
+            PROPERTIES_IMAGE_DOOR_FIELDS(PROPERTIES_IMAGE_GET_DOOR_UINT, PROPERTIES_IMAGE_GET_DOOR_STRING) \
+            decoded.NAME.push_back(door); \
+        }
+        PROPERTIES_IMAGE_FIELDS(PROPERTIES_IMAGE_GET_UINT, PROPERTIES_IMAGE_GET_INT, PROPERTIES_IMAGE_GET_STRING, PROPERTIES_IMAGE_GET_DOOR_LIST)
+#undef PROPERTIES_IMAGE_GET_UINT
+#undef PROPERTIES_IMAGE_GET_INT
+#undef PROPERTIES_IMAGE_GET_STRING
+#undef PROPERTIES_IMAGE_GET_DOOR_UINT
+#undef PROPERTIES_IMAGE_GET_DOOR_STRING
+#undef PROPERTIES_IMAGE_GET_DOOR_LIST
+
+        valid = reader.finished();
+        if(valid) properties = decoded;
+    }
+
+    munmap(pMapping, imageSize);
+    return valid;
+}
+
+uint32_t PropertiesImage::Checksum(const void* data, size_t size)
+{
+    static uint32_t table[256];
+    static const bool tableReady = []()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t crc = i;
+            for(int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc & 1) ? (0xEDB88320u ^ (crc >> 1)) : (crc >> 1);
+            }
+            table[i] = crc;
+        }
+        return true;
+    }();
+    (void)tableReady;
+
+    const unsigned char* pByte = static_cast<const unsigned char*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for(size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ pByte[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t PropertiesImage::layoutFingerprint()
+{
+    // Any change to field names, types or order gives a different fingerprint,
+    // so an image written by an older build is rejected instead of misread.
+#define PROPERTIES_IMAGE_DESCRIBE_UINT(NAME) "u:" #NAME ";"
+#define PROPERTIES_IMAGE_DESCRIBE_INT(NAME) "i:" #NAME ";"
+#define PROPERTIES_IMAGE_DESCRIBE_STRING(NAME) "s:" #NAME ";"
+#define PROPERTIES_IMAGE_DESCRIBE_DOOR_LIST(NAME) "l:" #NAME "[" PROPERTIES_IMAGE_DOOR_FIELDS(PROPERTIES_IMAGE_DESCRIBE_UINT, PROPERTIES_IMAGE_DESCRIBE_STRING) "];"
+    static const char layout[] = PROPERTIES_IMAGE_FIELDS(PROPERTIES_IMAGE_DESCRIBE_UINT, PROPERTIES_IMAGE_DESCRIBE_INT, PROPERTIES_IMAGE_DESCRIBE_STRING, PROPERTIES_IMAGE_DESCRIBE_DOOR_LIST);
+#undef PROPERTIES_IMAGE_DESCRIBE_UINT
+#undef PROPERTIES_IMAGE_DESCRIBE_INT
+#undef PROPERTIES_IMAGE_DESCRIBE_STRING
+#undef PROPERTIES_IMAGE_DESCRIBE_DOOR_LIST
+
+    static const uint32_t fingerprint = Checksum(layout, sizeof(layout) - 1);
+    return fingerprint;
+}
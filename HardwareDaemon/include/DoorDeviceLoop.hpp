@@ -0,0 +1,113 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef DOOR_DEVICE_LOOP_HPP
+#define DOOR_DEVICE_LOOP_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+
+#include "keypad.hpp"
+#include "pipe.hpp"
+#include "CardReaderScheduler.hpp"
+
+
+/**
+ * @brief Drives the keypads and card readers of every door from one thread
+ *
+ * Keypads, reader IRQ lines and reader poll deadlines are all waited on with a single poll(),
+ * so the number of threads does not grow with the number of doors. Keypads write to their own pipes;
+ * cards are sent as `PipeMessage::RFIDCard` to the RFID pipe of the door whose reader returned them.
+ * Repeated reads of the same card at the same door are dropped until the same-card timeout expires.
+ */
+class DoorDeviceLoop : private ICardReaderListener
+{
+public:
+	/**
+	 * @brief Create new DoorDeviceLoop object
+	 * @param settings Polling settings of every card reader
+	 * @param sameCardTimeout_ms Time during which the last card read at a door is not forwarded again
+	 * @param pLogger Pointer to a Logger object
+	*/
+	DoorDeviceLoop(const CardReaderSettings& settings, unsigned int sameCardTimeout_ms, ILogger* pLogger = NulLogger::getInstance());
+
+	DoorDeviceLoop(const DoorDeviceLoop&) = delete;
+	DoorDeviceLoop& operator=(const DoorDeviceLoop&) = delete;
+
+	/**
+	 * @brief Add a door. Nothing is owned.
+	 * @param pKeypad Keypad of the door, nullptr if it has none
+	 * @param pCardReader Card reader of the door, nullptr if it has none
+	 * @param pRFIDPipe Pipe to which cards from `pCardReader` are sent, required with a reader
+	*/
+	void AddDoor(Keypad* pKeypad, ICardReader* pCardReader, Pipe* pRFIDPipe);
+
+	/// Replace the reader settings and same-card timeout of every door; applied from the next poll
+	void SetSettings(const CardReaderSettings& settings, unsigned int sameCardTimeout_ms);
+
+	/**
+	 * @brief Waits for any keypad, reader IRQ or due reader (at most `maxWait_ms`) and handles everything ready
+	 * @return false if woken up by `Interrupt()`
+	*/
+	bool RunOnce(int maxWait_ms);
+
+	/// Wakes up a thread blocked in `RunOnce()`. Safe to call from any thread.
+	void Interrupt();
+
+	size_t getDoorCount() const { return m_doors.size(); }
+
+	/// Number of `pollCardUUID()` calls made on `pCardReader`
+	unsigned long getPollCount(ICardReader* pCardReader) const { return m_scheduler.getPollCount(pCardReader); }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Door
+	{
+		Keypad* pKeypad;
+		ICardReader* pCardReader;
+		Pipe* pRFIDPipe;
+		std::string lastCardUUID;
+		Clock::time_point lastCardTime;
+	};
+
+	ILogger* m_pLogger;
+	CardReaderSettings m_settings;
+	Clock::duration m_sameCardTimeout;
+	std::vector<Door> m_doors;
+
+	/// One entry per door with a keypad, `m_keypads[i]` owns `m_keypadFds[i]`
+	std::vector<pollfd> m_keypadFds;
+	std::vector<Keypad*> m_keypads;
+
+	CardReaderScheduler m_scheduler;
+
+	virtual void CardDetected(ICardReader* pReader, const std::string& cardUUID) override;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HARDWARE_BACKEND_HPP
+#define HARDWARE_BACKEND_HPP
+
+#include <memory>
+#include <string>
+
+#include "keypad.hpp"
+#include "pipe.hpp"
+#include "ICardReader.hpp"
+#include "GPIO_Port.hpp"
+#include "I2C_Device.hpp"
+#include "properties.h"
+
+/**
+ * @brief Source of every device HardwareDaemon drives, selected with `Settings > Hardware > Backend` in config.xml
+ *
+ * The backend owns the devices it opens; they stay valid until it is destroyed. Devices may be opened
+ * from different threads.
+*/
+class I_HardwareBackend
+{
+public:
+	virtual ~I_HardwareBackend() {};
+
+	/// Name used in logs
+	virtual std::string getName() const = 0;
+
+	/// Keypad of `door`, which sends its input to `pOutputPipe`
+	virtual Keypad* OpenKeypad(const DoorProperties& door, Pipe* pOutputPipe, ILogger* pLogger) = 0;
+
+	virtual ICardReader* OpenCardReader(const DoorProperties& door, ILogger* pLogger) = 0;
+
+	/// GPIO of the buzzers, LEDs and door locks of every door
+	virtual I_GPIO_Port* getGPIO() = 0;
+
+	/// LCD backpack of `door` on `i2c_bus`
+	virtual I_I2C_Device* OpenLCD_Device(const DoorProperties& door, unsigned int i2c_bus) = 0;
+
+	/// Called once the threads using the devices are started. Input sent before a device is opened is kept until it is.
+	virtual void Start() {};
+
+	/// Called before the devices are closed
+	virtual void Stop() {};
+};
+
+/// Creates the backend selected in `properties`. Unknown backend names are a fatal error.
+std::unique_ptr<I_HardwareBackend> CreateHardwareBackend(const Properties& properties, ILogger* pLogger = NulLogger::getInstance());
+
+#endif
@@ -0,0 +1,79 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HARDWARE_SCENARIO_HPP
+#define HARDWARE_SCENARIO_HPP
+
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Script of input for `SimulatedHardwareBackend`, loaded from the file set in config.xml
+ *
+ * One command per line, lines starting with `#` are comments:
+ * - `keys <door> <keys>` presses and releases each key at door `<door>`: `0`-`9 * / + - .` are the keys of the
+ *   numeric keypad, `E` is Enter and `B` is Backspace, so "keys 1 *1234E" is a PIN entry at door 1
+ * - `card <door> <UUID> [hold_ms]` puts a card into the field of the door's reader and takes it out after
+ *   `hold_ms` (100 ms by default)
+ * - `wait <ms>` pauses, fractions allowed (`wait 0.25`). Pauses are added up on an absolute timeline,
+ *   so `repeat 1000` / `wait 1` / `end` takes one second no matter how long the other commands take.
+ * - `repeat <count>` ... `end` repeats the enclosed commands, blocks may be nested
+*/
+class HardwareScenario
+{
+public:
+	struct Command
+	{
+		enum class Type { KEYS, CARD, WAIT, REPEAT, END };
+
+		Type type;
+		unsigned int doorId;		///< KEYS, CARD
+		std::string text;			///< KEYS: the keys, CARD: UUID of the card
+		double duration_ms;			///< WAIT: pause, CARD: hold time
+		/// REPEAT: number of repetitions, END: index of the matching REPEAT
+		unsigned long count;
+	};
+
+	static const unsigned int DEFAULT_CARD_HOLD_MS = 100;
+
+	/**
+	 * @brief Parses a whole scenario
+	 * @param error Line number and description of the first invalid line, if false is returned
+	*/
+	static bool Parse(std::istream& input, HardwareScenario& scenario, std::string& error);
+
+	/// Parses one `keys`, `card` or `wait` command. `repeat` and `end` are only valid in `Parse()`.
+	static bool ParseCommand(const std::string& line, Command& command, std::string& error);
+
+	/// evdev key code of `key` as used in a `keys` command. Returns false for keys the keypad does not have.
+	static bool KeyCode(char key, unsigned short& code);
+
+	const std::vector<Command>& getCommands() const { return m_commands; }
+
+private:
+	std::vector<Command> m_commands;
+};
+
+#endif
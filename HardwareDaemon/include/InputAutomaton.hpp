@@ -88,7 +88,8 @@ public:
 
 	// ===========================================================
 
-	InputAutomaton(int siInstID,
+	/// `doorId` is also the instance ID; it is stamped on every `CommandMessage` sent to MainApplication
+	InputAutomaton(DoorId doorId,
 		DataMailbox* pMailbox,
 		MailboxReference* pMainApplication,
 		IndicatorController_Client* pIndicators,
@@ -108,6 +109,8 @@ private:
 	// PRIVATE DATA ==============================================
 	ILogger* m_pLogger;
 
+	const DoorId m_doorId;
+
 	DataMailbox* m_pMailbox;
 
 	MailboxReference* m_pMainApplication;
@@ -115,6 +118,9 @@ private:
 
 	CommandMessage m_messageBuffer;
 
+	/// Set if LATENCY_TRACE_SOCKET is configured; sent requests then start a `LatencyTrace`
+	const bool m_bTraceLatency;
+
 	// PRIVATE HELPERS ===========================================
 
 	void checkResourcePointers();
@@ -37,6 +37,7 @@ class InputController
 public:
 	/**
 	 * @brief Construct a new InputController object
+	 * @param doorId Door whose keypad and reader feed the pipes; stamped on every command sent to MainApplication
 	 * @param pPipeKeypad Pointer to a FIFO Pipe which is used by the Keypad on the other end to send data
 	 * @param pPipeRFID Pointer to a FIFO Pipe which is used by the RFID Reader on the other end to send data
 	 * @param pMailbox Pointer to a Mailbox
@@ -44,7 +45,8 @@ public:
 	 * @param pIndicators Pointer to IndicatorController Client object
 	 * @param pLogger Pointer to a Logger object
 	*/
-	InputController(Pipe* pPipeKeypad,
+	InputController(DoorId doorId,
+		Pipe* pPipeKeypad,
 		Pipe* pPipeRFID,
 		DataMailbox* pMailbox,
 		MailboxReference* pRefMainApp,
@@ -53,8 +55,11 @@ public:
 
 	~InputController(){}
 
-	/// Listens for inputs and then processes it to messages
-	void ProcessInput();
+	/**
+	 * @brief Listens for inputs and then processes it to messages
+	 * @param timeout_ms How long to wait for input; 0 when the caller already knows a pipe is readable
+	*/
+	void ProcessInput(int timeout_ms = 10);
 
 private:
 
@@ -70,10 +75,11 @@ private:
 	InputAutomaton m_inputAutomaton;
 
 	/// Return InputParameter which represents Keypad/RFID Reader input
-	InputParameter getInput();
+	InputParameter getInput(int timeout_ms);
 
-	InputParameter parseKeypadInput(const std::string& input);
-	InputParameter parseRFIDInput(const std::string& input);
+	/// Maps a `KeypadEvent` received from the keypad pipe
+	InputParameter parseKeypadInput(const PipeMessage& message);
+	InputParameter parseRFIDInput(const PipeMessage& message);
 
 	/// Maps InputParameter into matching InputAutomatonEvent object
 	OWNER InputAutomatonEvent* parseInputParameterToInputAutomatonEvent(InputParameter& input);
@@ -0,0 +1,58 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef PI_HARDWARE_BACKEND_HPP
+#define PI_HARDWARE_BACKEND_HPP
+
+#include <mutex>
+#include <vector>
+
+#include "HardwareBackend.hpp"
+
+/// Devices of a Raspberry Pi: evdev keypads, PN532 readers (libnfc), GPIO and I2C through pigpio
+class PiHardwareBackend : public I_HardwareBackend
+{
+public:
+	/// Initializes pigpio; failure is a fatal error
+	PiHardwareBackend();
+
+	/// Closes every device, then terminates pigpio
+	virtual ~PiHardwareBackend();
+
+	virtual std::string getName() const override { return "pi"; }
+
+	virtual Keypad* OpenKeypad(const DoorProperties& door, Pipe* pOutputPipe, ILogger* pLogger) override;
+	virtual ICardReader* OpenCardReader(const DoorProperties& door, ILogger* pLogger) override;
+	virtual I_GPIO_Port* getGPIO() override { return &m_gpio; }
+	virtual I_I2C_Device* OpenLCD_Device(const DoorProperties& door, unsigned int i2c_bus) override;
+
+private:
+	std::mutex m_mutex;
+	PigpioGPIO_Port m_gpio;
+	std::vector<std::unique_ptr<Keypad>> m_keypads;
+	std::vector<std::unique_ptr<ICardReader>> m_cardReaders;
+	std::vector<std::unique_ptr<I_I2C_Device>> m_lcdDevices;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SIMULATED_HARDWARE_BACKEND_HPP
+#define SIMULATED_HARDWARE_BACKEND_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HardwareBackend.hpp"
+#include "HardwareScenario.hpp"
+#include "SimulatedCardReader.hpp"
+#include "MockGPIO_Port.hpp"
+#include "MockI2C_Device.hpp"
+
+/**
+ * @brief Devices without hardware, so the whole Startup stack can run off the Pi (containers, load tests)
+ *
+ * Every door gets a `Keypad` reading `input_event`s from a pipe, a `SimulatedCardReader` with an IRQ line,
+ * an HD44780 model behind its LCD address and pins on a shared `MockGPIO_Port`. Input comes from:
+ * - the scenario file (`HardwareScenario`), played once from `Start()`
+ * - the control socket, a UNIX stream socket accepting one command per line and answering each with
+ *   a line starting with "OK" or "ERROR": the `keys` and `card` commands of `HardwareScenario`, and
+ *   `remove <door>` (takes the card out), `lcd <door>` (text on the LCD, lines separated by '|'),
+ *   `gpio <pin>` (0 or 1) and `stats`
+ * - the methods below, for tests
+*/
+class SimulatedHardwareBackend : public I_HardwareBackend
+{
+public:
+	struct Stats
+	{
+		unsigned long keysPressed;
+		unsigned long cardsPresented;
+		unsigned long controlCommands;
+	};
+
+	/**
+	 * @param doors Doors to simulate
+	 * @param scenarioPath Scenario played by `Start()`, empty for none
+	 * @param controlSocketPath Path of the control socket opened by `Start()`, empty for none
+	*/
+	SimulatedHardwareBackend(const std::vector<DoorProperties>& doors,
+		const std::string& scenarioPath = "",
+		const std::string& controlSocketPath = "",
+		ILogger* pLogger = NulLogger::getInstance());
+
+	virtual ~SimulatedHardwareBackend();
+
+	virtual std::string getName() const override { return "simulated"; }
+
+	virtual Keypad* OpenKeypad(const DoorProperties& door, Pipe* pOutputPipe, ILogger* pLogger) override;
+	virtual ICardReader* OpenCardReader(const DoorProperties& door, ILogger* pLogger) override;
+	virtual I_GPIO_Port* getGPIO() override { return &m_gpio; }
+	virtual I_I2C_Device* OpenLCD_Device(const DoorProperties& door, unsigned int i2c_bus) override;
+
+	/// Loads the scenario and opens the control socket; an unreadable or invalid scenario is a fatal error
+	virtual void Start() override;
+	virtual void Stop() override;
+
+	// Simulated input, safe from any thread. Return false for unknown doors.
+
+	/// Presses and releases `keys` (see `HardwareScenario`) in order
+	bool PressKeys(unsigned int doorId, const std::string& keys);
+
+	/// Puts a card into the field of the door's reader, taken out after `hold_ms` (0 leaves it there)
+	bool PresentCard(unsigned int doorId, const std::string& cardUUID, unsigned int hold_ms = HardwareScenario::DEFAULT_CARD_HOLD_MS);
+
+	bool RemoveCard(unsigned int doorId);
+
+	/**
+	 * @brief Plays `scenario` on the calling thread; returns once every card it presented was taken out
+	 * @return false if `Stop()` was called or a command named an unknown door
+	*/
+	bool Play(const HardwareScenario& scenario);
+
+	/// Executes one control socket command and returns the reply, without the line end
+	std::string Execute(const std::string& line);
+
+	/// Lines of the door's LCD separated by '|'
+	std::string getLCD_Text(unsigned int doorId) const;
+
+	Stats getStats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct SimulatedDoor
+	{
+		DoorProperties properties;
+		int keyReadFd;
+		int keyWriteFd;
+		std::unique_ptr<Keypad> pKeypad;
+		std::unique_ptr<SimulatedCardReader> pCardReader;
+		std::unique_ptr<MockI2C_Device> pLCD;
+		bool removalPending;
+		Clock::time_point removeAt;
+	};
+
+	ILogger* m_pLogger;
+	const std::string m_scenarioPath;
+	const std::string m_controlSocketPath;
+
+	MockGPIO_Port m_gpio;
+	/// Created in the constructor and never changed, so lookups need no lock
+	std::map<unsigned int, std::unique_ptr<SimulatedDoor>> m_doors;
+
+	/// Guards the removal times of the doors and `m_stop`
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	bool m_stop;
+	int m_stopFd;
+
+	/// Keeps the key events of concurrent `PressKeys()` calls on one door from interleaving
+	std::mutex m_keysMutex;
+
+	std::atomic<unsigned long> m_keysPressed;
+	std::atomic<unsigned long> m_cardsPresented;
+	std::atomic<unsigned long> m_controlCommands;
+
+	int m_listenFd;
+	std::thread m_scenarioThread;
+	std::thread m_controlThread;
+
+	SimulatedDoor* findDoor(unsigned int doorId) const;
+
+	/// Waits until `time`, taking out cards whose hold time ends meanwhile. Returns false if stopped.
+	bool waitUntil(Clock::time_point time);
+
+	/// Takes out every card due at `now`; returns the earliest pending removal, or `Clock::time_point::max()`
+	Clock::time_point removeDueCards(Clock::time_point now);
+
+	/// Writes everything, waiting while the pipe is full. Returns false if stopped.
+	bool writeAll(int fd, const char* data, size_t size);
+
+	void scenarioLoop(HardwareScenario scenario);
+	void controlLoop();
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "DoorDeviceLoop.hpp"
+
+#include "Kernel.hpp"
+
+DoorDeviceLoop::DoorDeviceLoop(const CardReaderSettings& settings, unsigned int sameCardTimeout_ms, ILogger* pLogger)
+	:	m_pLogger(pLogger),
+	m_settings(settings),
+	m_sameCardTimeout(std::chrono::milliseconds(sameCardTimeout_ms)),
+	m_scheduler(this, pLogger)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+}
+
+void DoorDeviceLoop::AddDoor(Keypad* pKeypad, ICardReader* pCardReader, Pipe* pRFIDPipe)
+{
+	if (pCardReader != nullptr && pRFIDPipe == nullptr)
+	{
+		*m_pLogger << "DoorDeviceLoop - card reader without an RFID pipe!";
+		Kernel::Fatal_Error("DoorDeviceLoop - card reader without an RFID pipe!");
+	}
+
+	m_doors.push_back(Door{ pKeypad, pCardReader, pRFIDPipe, std::string(), Clock::time_point() });
+
+	if (pKeypad != nullptr)
+	{
+		m_keypadFds.push_back({ pKeypad->getFd(), POLLIN, 0 });
+		m_keypads.push_back(pKeypad);
+	}
+
+	if (pCardReader != nullptr)
+	{
+		m_scheduler.AddReader(pCardReader, m_settings);
+	}
+}
+
+void DoorDeviceLoop::SetSettings(const CardReaderSettings& settings, unsigned int sameCardTimeout_ms)
+{
+	m_settings = settings;
+	m_sameCardTimeout = std::chrono::milliseconds(sameCardTimeout_ms);
+
+	for (Door& door : m_doors)
+	{
+		if (door.pCardReader != nullptr)
+		{
+			m_scheduler.SetSettings(door.pCardReader, settings);
+		}
+	}
+}
+
+bool DoorDeviceLoop::RunOnce(int maxWait_ms)
+{
+	// Due readers are polled inside WaitAndPoll(), keypads are handled here
+	bool notInterrupted = m_scheduler.WaitAndPoll(maxWait_ms, m_keypadFds.data(), m_keypadFds.size());
+
+	for (size_t i = 0; i < m_keypadFds.size(); ++i)
+	{
+		if (m_keypadFds[i].revents != 0)
+		{
+			m_keypads[i]->WaitForInput(0);
+		}
+	}
+
+	return notInterrupted;
+}
+
+void DoorDeviceLoop::Interrupt()
+{
+	m_scheduler.Interrupt();
+}
+
+void DoorDeviceLoop::CardDetected(ICardReader* pReader, const std::string& cardUUID)
+{
+	for (Door& door : m_doors)
+	{
+		if (door.pCardReader != pReader) continue;
+
+		Clock::time_point now = Clock::now();
+		if (cardUUID == door.lastCardUUID && now - door.lastCardTime < m_sameCardTimeout)
+		{
+			*m_pLogger << "Detected card same as last one at " + pReader->getName() + "! Same card timer did not expire - ignoring card!";
+			return;
+		}
+
+		door.pRFIDPipe->sendMessage(PipeMessage(PipeMessage::RFIDCard, cardUUID));
+
+		door.lastCardUUID = cardUUID;
+		door.lastCardTime = now;
+		return;
+	}
+}
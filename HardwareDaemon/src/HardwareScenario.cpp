@@ -0,0 +1,219 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "HardwareScenario.hpp"
+
+#include <cmath>
+#include <sstream>
+
+#include <linux/input-event-codes.h>
+
+namespace
+{
+	const struct { char key; unsigned short code; } KEYS[] =
+	{
+		{ '0', KEY_KP0 }, { '1', KEY_KP1 }, { '2', KEY_KP2 }, { '3', KEY_KP3 }, { '4', KEY_KP4 },
+		{ '5', KEY_KP5 }, { '6', KEY_KP6 }, { '7', KEY_KP7 }, { '8', KEY_KP8 }, { '9', KEY_KP9 },
+		{ '*', KEY_KPASTERISK }, { '/', KEY_KPSLASH }, { '+', KEY_KPPLUS }, { '-', KEY_KPMINUS }, { '.', KEY_KPDOT },
+		{ 'E', KEY_KPENTER }, { 'B', KEY_BACKSPACE }
+	};
+
+	bool parseNumber(const std::string& text, double& value)
+	{
+		std::istringstream stream(text);
+		stream >> value;
+		return !text.empty() && stream.eof() && !stream.fail() && std::isfinite(value) && value >= 0;
+	}
+
+	bool parseDoor(const std::string& text, unsigned int& doorId)
+	{
+		double value;
+		if (!parseNumber(text, value) || value != std::floor(value) || value < 1 || value > 0xFFFF)
+		{
+			return false;
+		}
+
+		doorId = static_cast<unsigned int>(value);
+		return true;
+	}
+}
+
+bool HardwareScenario::KeyCode(char key, unsigned short& code)
+{
+	for (const auto& entry : KEYS)
+	{
+		if (entry.key == key)
+		{
+			code = entry.code;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool HardwareScenario::ParseCommand(const std::string& line, Command& command, std::string& error)
+{
+	std::istringstream stream(line);
+	std::vector<std::string> words;
+	std::string word;
+	while (stream >> word)
+	{
+		words.push_back(word);
+	}
+
+	if (words.empty())
+	{
+		error = "empty command";
+		return false;
+	}
+
+	command = Command{ Command::Type::WAIT, 0, std::string(), 0, 0 };
+	const std::string& name = words[0];
+
+	if (name == "keys" && words.size() == 3)
+	{
+		command.type = Command::Type::KEYS;
+		command.text = words[2];
+
+		unsigned short code;
+		for (char key : command.text)
+		{
+			if (!KeyCode(key, code))
+			{
+				error = std::string("unknown key '") + key + "'";
+				return false;
+			}
+		}
+
+		if (!parseDoor(words[1], command.doorId))
+		{
+			error = "invalid door \"" + words[1] + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	if (name == "card" && (words.size() == 3 || words.size() == 4))
+	{
+		command.type = Command::Type::CARD;
+		command.text = words[2];
+		command.duration_ms = DEFAULT_CARD_HOLD_MS;
+
+		if (!parseDoor(words[1], command.doorId))
+		{
+			error = "invalid door \"" + words[1] + "\"";
+			return false;
+		}
+		if (words.size() == 4 && !parseNumber(words[3], command.duration_ms))
+		{
+			error = "invalid hold time \"" + words[3] + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	if (name == "wait" && words.size() == 2)
+	{
+		command.type = Command::Type::WAIT;
+		if (!parseNumber(words[1], command.duration_ms))
+		{
+			error = "invalid time \"" + words[1] + "\"";
+			return false;
+		}
+		return true;
+	}
+
+	error = "unknown command or wrong number of arguments: \"" + line + "\"";
+	return false;
+}
+
+bool HardwareScenario::Parse(std::istream& input, HardwareScenario& scenario, std::string& error)
+{
+	std::vector<Command> commands;
+	std::vector<size_t> openRepeats;
+
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		++lineNumber;
+
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream stream(line);
+		std::string name;
+		stream >> name;
+
+		Command command{ Command::Type::END, 0, std::string(), 0, 0 };
+		std::string commandError;
+
+		if (name == "repeat")
+		{
+			double count;
+			std::string countText, extra;
+			stream >> countText;
+			if (!parseNumber(countText, count) || count != std::floor(count) || count < 1 || (stream >> extra))
+			{
+				error = "line " + std::to_string(lineNumber) + ": invalid repeat count";
+				return false;
+			}
+
+			command.type = Command::Type::REPEAT;
+			command.count = static_cast<unsigned long>(count);
+			openRepeats.push_back(commands.size());
+		}
+		else if (name == "end")
+		{
+			if (openRepeats.empty())
+			{
+				error = "line " + std::to_string(lineNumber) + ": end without repeat";
+				return false;
+			}
+
+			command.count = openRepeats.back();
+			openRepeats.pop_back();
+		}
+		else if (!ParseCommand(line, command, commandError))
+		{
+			error = "line " + std::to_string(lineNumber) + ": " + commandError;
+			return false;
+		}
+
+		commands.push_back(command);
+	}
+
+	if (!openRepeats.empty())
+	{
+		error = "repeat without end";
+		return false;
+	}
+
+	scenario.m_commands = commands;
+	return true;
+}
@@ -29,6 +29,9 @@
 #include<thread>
 #include<cstring>
 #include<string>
+#include<memory>
+#include<vector>
+#include<poll.h>
 #include<signal.h>
 
 #include"Settings.hpp"
@@ -40,27 +43,24 @@
 #include"ThreadLoggerClient.hpp"
 #include"WatchdogClient.hpp"
 #include"PN532_NFC.hpp"
+#include"DoorDeviceLoop.hpp"
 #include"InputController.hpp"
 #include"IndicatorController.hpp"
+#include"HardwareBackend.hpp"
 #include "propertiesclass.h"
 
-#include<pigpio.h>
-
-const Pinout pins
-(
-    GlobalProperties::Get().BUZZER_BCM_PIN,
-    GlobalProperties::Get().DOOR_BCM_PIN,
-    GlobalProperties::Get().DOOR_OPEN_TIME_MS,
-    GlobalProperties::Get().LCD_I2C_BUS
-);
-
 volatile sig_atomic_t globalTerminateFlag = 0;
 
+// Upper bound of one wait, so the terminate flag is still checked while every door is idle
+const int TERMINATE_CHECK_PERIOD_MS = 100;
 
-void KeypadReaderThreadFunction();
+// Every door gets its own FIFOs and indicator mailbox, named "<base>.<door ID>"
+static std::string KeypadPipeName(DoorId doorId) { return GlobalProperties::Get().KEYPAD_PIPE_NAME + "." + std::to_string(doorId); }
+static std::string RFID_PipeName(DoorId doorId) { return GlobalProperties::Get().RFID_PIPE_NAME + "." + std::to_string(doorId); }
+
+void DeviceThreadFunction(I_HardwareBackend* pBackend);
 void InputLogicThreadFunction();
-void RFID_ReaderThreadFunction();
-void IndicatorsThreadFunction();
+void IndicatorsThreadFunction(I_HardwareBackend* pBackend);
 
 #define DEBUG(X) std::cout << X << std::endl;
 
@@ -69,49 +69,85 @@ int main(int argc, char** argv)
 
     UNIX_SignalHandler::bindSignalToFlag(UNIX_SignalHandler::enuSIGTERM, &globalTerminateFlag);
 
-    int gpioStatus = gpioInitialise();
-    if (gpioStatus < 0)
-    {
-        Kernel::Fatal_Error("HardwareDaemon - Could not initialize GPIO pins (pigpio)!");
-    }
+    Logger hardwareLogger("hardware.backend.log");
+    std::unique_ptr<I_HardwareBackend> pBackend = CreateHardwareBackend(GlobalProperties::Get(), &hardwareLogger);
+    hardwareLogger << "Hardware backend: " + pBackend->getName();
+
+    GlobalProperties::StartWatching();
 
-    std::thread inputThread(KeypadReaderThreadFunction);
-    std::thread outputThread(InputLogicThreadFunction);
-    std::thread RFID_readerThread(RFID_ReaderThreadFunction);
-    std::thread indicatorThread(IndicatorsThreadFunction);
+    // One thread per role, each serving every door - the thread count does not depend on DOORS
+    std::thread deviceThread(DeviceThreadFunction, pBackend.get());
+    std::thread logicThread(InputLogicThreadFunction);
+    std::thread indicatorThread(IndicatorsThreadFunction, pBackend.get());
 
-    outputThread.join();
-    RFID_readerThread.join();
+    pBackend->Start();
+
+    logicThread.join();
     indicatorThread.join();
-    inputThread.join();
+    deviceThread.join();
+
+    pBackend->Stop();
 
-    gpioTerminate();
+    GlobalProperties::StopWatching();
 
     return 0;
 }
 
 
 
-void KeypadReaderThreadFunction(void)
+static CardReaderSettings RFID_ReaderSettings(const Properties& properties)
 {
-    const uint BUFFER_SIZE = GlobalProperties::Get().KEYPAD_BUFFER_SIZE;
-    const unsigned int keypadReadTimeout_ms = GlobalProperties::Get().KEYPAD_READ_TIMEOUT_MS;
+    return CardReaderSettings{ properties.RFID_READ_TIMEOUT_MS,
+                               properties.RFID_IDLE_POLL_INTERVAL_MS,
+                               properties.RFID_ACTIVITY_HOLD_MS,
+                               properties.RFID_DUTY_CYCLE_PERCENT };
+}
+
+void DeviceThreadFunction(I_HardwareBackend* pBackend)
+{
+    // DOORS is restart-required, so the list cannot change while the daemon runs
+    const std::vector<DoorProperties> DOORS = GlobalProperties::Get().DOORS;
+    const uint KEYPAD_BUFFER_SIZE = GlobalProperties::Get().KEYPAD_BUFFER_SIZE;
+    const uint RFID_BUFFER_SIZE = GlobalProperties::Get().RFID_BUFFER_SIZE;
+
+    Logger keypadLogger("keypad.driver.log");
+    Logger RFIDLogger("rfid.driver.log");
 
-    Logger logger("keypad.driver.log");
+    // Keypads and card readers are owned by the backend
+    std::vector<std::unique_ptr<Pipe>> pipes;
+
+    // Polling settings are live; subscribed before they are first read, so no reload is missed
+    PropertiesChangeFlag configChange;
+    GlobalProperties::Subscribe(&configChange);
+
+    DoorDeviceLoop devices(RFID_ReaderSettings(GlobalProperties::Get()), GlobalProperties::Get().RFID_SAME_CARD_TIMEOUT_MS, &RFIDLogger);
+
+    for (const DoorProperties& door : DOORS)
+    {
+        // Opened in the same order as InputLogicThreadFunction() opens the reading ends
+        pipes.emplace_back(new Pipe(KeypadPipeName(door.ID), Kernel::IOMode::WRITE, KEYPAD_BUFFER_SIZE, &keypadLogger));
+        Keypad* pKeypad = pBackend->OpenKeypad(door, pipes.back().get(), &keypadLogger);
 
-    const std::string KEYPAD_PIPE_PATH = GlobalProperties::Get().KEYPAD_PIPE_NAME;
-    const std::string KEYPAD_ISTREAM_PATH = GlobalProperties::Get().KEYPAD_ISTREAM_PATH;
+        pipes.emplace_back(new Pipe(RFID_PipeName(door.ID), Kernel::IOMode::WRITE, RFID_BUFFER_SIZE, &RFIDLogger));
+        ICardReader* pCardReader = pBackend->OpenCardReader(door, &RFIDLogger);
 
-    Pipe outputPipe(KEYPAD_PIPE_PATH, Kernel::IOMode::WRITE, BUFFER_SIZE, &logger);
-    Keypad keypad(KEYPAD_ISTREAM_PATH, &outputPipe, &logger);
+        devices.AddDoor(pKeypad, pCardReader, pipes.back().get());
+    }
 
-    logger << "Awaiting key press!";
+    keypadLogger << "Awaiting key press on " + std::to_string(devices.getDoorCount()) + " doors!";
 
+    std::vector<std::string> restartRequired;
     while(!globalTerminateFlag)
     {
-        keypad.readChar();
-        usleep(keypadReadTimeout_ms * 1000);
+        if (configChange.TakeChange(restartRequired))
+        {
+            const Properties& properties = GlobalProperties::Get();
+            devices.SetSettings(RFID_ReaderSettings(properties), properties.RFID_SAME_CARD_TIMEOUT_MS);
+            RFIDLogger << "Config reloaded, version " + std::to_string(GlobalProperties::Version()) + ", reader settings applied";
+        }
+        devices.RunOnce(TERMINATE_CHECK_PERIOD_MS);
     }
+    GlobalProperties::Unsubscribe(&configChange);
     DEBUG("MARK 1");
 
 }
@@ -143,26 +179,65 @@ void InputLogicThreadFunction(void)
     const std::string MAIN_APP_MESSAGE_QUEUE = GlobalProperties::Get().MAIN_MB_NAME;
     MailboxReference mainAppMailbox(MAIN_APP_MESSAGE_QUEUE);
 
+    const std::vector<DoorProperties> DOORS = GlobalProperties::Get().DOORS;
     const std::string INDICATORS_MAILBOX = GlobalProperties::Get().INDICATORS_MAILBOX_NAME;
-    IndicatorController_Client indicators(INDICATORS_MAILBOX, &indicatorLogger);
-
-    const std::string KEYPAD_FIFO_PATH = GlobalProperties::Get().KEYPAD_PIPE_NAME;
     const uint KEYPAD_PIPE_BUFFER_SIZE = GlobalProperties::Get().KEYPAD_BUFFER_SIZE;
-    Pipe inputPipeKeypad(KEYPAD_FIFO_PATH, Kernel::IOMode::READ_NONBLOCKING, KEYPAD_PIPE_BUFFER_SIZE, &keypadLogger);
-    const uint RFID_PIPR_BUFFER_SIZE = GlobalProperties::Get().RFID_BUFFER_SIZE;
-    Pipe inputPipeRFID("rfid.pipe", Kernel::IOMode::READ_NONBLOCKING, RFID_PIPR_BUFFER_SIZE, &RFIDLogger); // TODO add constant
+    const uint RFID_PIPE_BUFFER_SIZE = GlobalProperties::Get().RFID_BUFFER_SIZE;
 
-    InputController controller(&inputPipeKeypad,
-        &inputPipeRFID,
-        &outputMailbox,
-        &mainAppMailbox,
-        &indicators ,
-        &controllerLogger);
+    DoorIndicators indicators(&indicatorLogger);
+    std::vector<std::unique_ptr<Pipe>> pipes;
+    std::vector<std::unique_ptr<InputController>> controllers;
+
+    // Two entries per door: keypad pipe, then RFID pipe
+    std::vector<pollfd> pipeFds;
+
+    for (const DoorProperties& door : DOORS)
+    {
+        indicators.AddDoor(door.ID, INDICATORS_MAILBOX);
+
+        Pipe* pKeypadPipe = new Pipe(KeypadPipeName(door.ID), Kernel::IOMode::READ_NONBLOCKING, KEYPAD_PIPE_BUFFER_SIZE, &keypadLogger);
+        pipes.emplace_back(pKeypadPipe);
+        Pipe* pRFIDPipe = new Pipe(RFID_PipeName(door.ID), Kernel::IOMode::READ_NONBLOCKING, RFID_PIPE_BUFFER_SIZE, &RFIDLogger);
+        pipes.emplace_back(pRFIDPipe);
+
+        pipeFds.push_back({ pKeypadPipe->getFd(), POLLIN, 0 });
+        pipeFds.push_back({ pRFIDPipe->getFd(), POLLIN, 0 });
+
+        controllers.emplace_back(new InputController(door.ID,
+            pKeypadPipe,
+            pRFIDPipe,
+            &outputMailbox,
+            &mainAppMailbox,
+            indicators.get(door.ID),
+            &controllerLogger));
+    }
 
     watchdog.Start();
     while (!globalTerminateFlag && watchdog.Kick())
     {
-        controller.ProcessInput();
+        // Frames drained by an earlier read are not visible to poll()
+        int timeout_ms = TERMINATE_CHECK_PERIOD_MS;
+        for (const std::unique_ptr<Pipe>& pipe : pipes)
+        {
+            if (pipe->hasPendingMessages()) timeout_ms = 0;
+        }
+
+        if (poll(pipeFds.data(), pipeFds.size(), timeout_ms) < 0 && errno != EINTR)
+        {
+            watchdogLogger << "poll() error!";
+            Kernel::Fatal_Error("HardwareDaemon - poll() error on door pipes!");
+        }
+
+        for (size_t door = 0; door < controllers.size(); ++door)
+        {
+            const bool ready = pipeFds[2 * door].revents != 0 || pipeFds[2 * door + 1].revents != 0
+                || pipes[2 * door]->hasPendingMessages() || pipes[2 * door + 1]->hasPendingMessages();
+
+            if (ready)
+            {
+                controllers[door]->ProcessInput(0);
+            }
+        }
     }
 
     watchdogLogger << "Program ended. Terminate flag: " + std::to_string(globalTerminateFlag);
@@ -170,69 +245,61 @@ void InputLogicThreadFunction(void)
 }
 
 
-void RFID_ReaderThreadFunction()
+void IndicatorsThreadFunction(I_HardwareBackend* pBackend)
 {
+    const std::vector<DoorProperties> DOORS = GlobalProperties::Get().DOORS;
+    const std::string INDICATORS_MAILBOX = GlobalProperties::Get().INDICATORS_MAILBOX_NAME;
 
-    
-    const uint BUFFER_SIZE = GlobalProperties::Get().RFID_BUFFER_SIZE;
+    Logger logger("indicator.server.log");
 
-    Logger logger("rfid.driver.log");
-    Pipe outPipe("rfid.pipe", Kernel::IOMode::WRITE, BUFFER_SIZE, &logger);
-    PN532_NFC card_reader(&logger);
+    // A reloaded idle message replaces the one on screen
+    PropertiesChangeFlag configChange;
+    GlobalProperties::Subscribe(&configChange);
 
-    const unsigned int timeout_ms = GlobalProperties::Get().RFID_READ_TIMEOUT_MS;
-    const unsigned int sameCardTimeout_ms = GlobalProperties::Get().RFID_SAME_CARD_TIMEOUT_MS;
-    const std::string sameCardTimerName = "same_card_timer";
+    std::vector<std::unique_ptr<IndicatorController_Server>> servers;
+    std::vector<pollfd> serverFds;
 
-    Timer sameCardTimer(sameCardTimerName);
-    sameCardTimer.setTimeout_ms(sameCardTimeout_ms);
+    for (const DoorProperties& door : DOORS)
+    {
+        const Pinout pins
+        (
+            door.BUZZER_BCM_PIN,
+            door.DOOR_BCM_PIN,
+            GlobalProperties::Get().LCD_I2C_BUS,
+            door.LCD_I2C_ADDRESS,
+            door.LED_BCM_PIN
+        );
+
+        servers.emplace_back(new IndicatorController_Server(DoorIndicators::MailboxName(INDICATORS_MAILBOX, door.ID), pins,
+            pBackend->getGPIO(), pBackend->OpenLCD_Device(door, pins.m_lcd_i2c_bus), &logger));
+        serverFds.push_back({ servers.back()->getFileDescriptor(), POLLIN, 0 });
+    }
 
-    std::string lastCardUID = "";
-    while(!globalTerminateFlag)
+    std::vector<std::string> restartRequired;
+    while (!globalTerminateFlag)
     {
-        usleep(timeout_ms * Time::ms_to_us);
-        std::string cardUID = card_reader.readCardUUID();
-        if (cardUID == "")
+        if (configChange.TakeChange(restartRequired))
+        {
+            for (std::unique_ptr<IndicatorController_Server>& pServer : servers)
+            {
+                pServer->LCD_RefreshDefaultMsg();
+            }
+        }
+
+        if (poll(serverFds.data(), serverFds.size(), TERMINATE_CHECK_PERIOD_MS) <= 0)
         {
             continue;
         }
-        else if (cardUID == lastCardUID)
+
+        for (size_t door = 0; door < servers.size(); ++door)
         {
-            if (sameCardTimer.getTimerStatus() != Timer::Expired)
+            if (serverFds[door].revents & POLLIN)
             {
-                logger << "Detected card same as last one! Same card timer did not expire - ignoring card!";
-                continue;
+                servers[door]->ListenAndParseRequest(0);
             }
         }
-
-        // DEBUG
-        // std::cout << "Keypad read" << std::endl;
-        // DEBUG
-
-        outPipe.send(cardUID);
-
-        lastCardUID = cardUID;
-        sameCardTimer.Reset();
-
-        // usleep(timeout_ms * Time::ms_to_us);
-    }
-    DEBUG("MARK 3");
-}
-
-void IndicatorsThreadFunction()
-{
-    const unsigned int indicatorServerTimeout_ms = GlobalProperties::Get().INDICATORS_MB_TIMEOUT_MS;
-
-    Logger logger("indicator.server.log");
-
-    const std::string INDICATORS_MAILBOX = GlobalProperties::Get().INDICATORS_MAILBOX_NAME;
-    IndicatorController_Server indicators(INDICATORS_MAILBOX, pins, &logger);
-
-    while (!globalTerminateFlag)
-    {
-        indicators.ListenAndParseRequest(indicatorServerTimeout_ms);
     }
     DEBUG("MARK 4");
+    GlobalProperties::Unsubscribe(&configChange);
 
 }
-
@@ -153,20 +153,24 @@ void InputAutomaton::Warning(const std::string& message)
 	Kernel::Warning(message);
 }
 
-InputAutomaton::InputAutomaton(int siInstID,
+InputAutomaton::InputAutomaton(DoorId doorId,
 	DataMailbox* pMailbox,
 	MailboxReference* pMainApplication,
 	IndicatorController_Client* pIndicators,
 	ILogger* pLogger)
-	:	MAutomat(siInstID),
+	:	MAutomat(doorId),
+	m_doorId(doorId),
 	m_pMailbox(pMailbox),
 	m_pMainApplication(pMainApplication),
 	m_pIndicators(pIndicators),
-	m_pLogger(pLogger)
+	m_pLogger(pLogger),
+	m_bTraceLatency(!GlobalProperties::Get().LATENCY_TRACE_SOCKET.empty())
 {
 
 	checkResourcePointers();
 
+	setTraceName("InputAutomaton");
+
 	m_iInitialStateID = enumAutStateType::enuIdle;
 
 	/**********************************************
@@ -329,6 +333,12 @@ void InputAutomaton::logTransitionEnd(MAutEvent* event)
 
 bool InputAutomaton::processEvent(MAutEvent* event)
 {
+	// Transitions are recorded to the trace ring, the text log is for debugging only
+	if (!isTracing())
+	{
+		return MAutomat::processEvent(event);
+	}
+
 	logTransitionStart(event);
 
 	bool result = MAutomat::processEvent(event);
@@ -426,6 +436,11 @@ bool InputAutomaton::doAppendParameterAndSend(MAutEvent* pEvent)
 
 bool InputAutomaton::doSend(MAutEvent* pEvent)
 {
+	m_messageBuffer.setDoorId(m_doorId);
+	if (m_bTraceLatency)
+	{
+		m_messageBuffer.getTrace().Mark(LatencyTrace::HARDWARE_SENT);
+	}
 	m_pMailbox->send(*m_pMainApplication, &m_messageBuffer);
 
 	clearMessageBuffer();
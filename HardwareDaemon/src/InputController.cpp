@@ -24,6 +24,7 @@
 
 #include "InputController.hpp"
 #include "Time.hpp"
+#include "KeypadEvent.hpp"
 
 #include<poll.h>
 #include<sstream>
@@ -36,7 +37,8 @@
 #define DEBUG(X) std::cout << X << std::endl;
 
 
-InputController::InputController(Pipe* pPipeKeypad,
+InputController::InputController(DoorId doorId,
+	Pipe* pPipeKeypad,
 	Pipe* pPipeRFID,
 	DataMailbox* pMailbox,
 	MailboxReference* pRefMainApp,
@@ -48,7 +50,7 @@ InputController::InputController(Pipe* pPipeKeypad,
 	m_pMailbox(pMailbox),
 	m_pRefMainApp(pRefMainApp),
 	m_pIndicators(pIndicators),
-	m_inputAutomaton(536, pMailbox, pRefMainApp, pIndicators, pLogger) // TODO id
+	m_inputAutomaton(doorId, pMailbox, pRefMainApp, pIndicators, pLogger)
 {
 	if (m_pLogger == nullptr)
 	{
@@ -92,9 +94,9 @@ InputController::InputController(Pipe* pPipeKeypad,
 
 
 
-void InputController::ProcessInput()
+void InputController::ProcessInput(int timeout_ms)
 {
-	InputParameter input = getInput();
+	InputParameter input = getInput(timeout_ms);
 
 	InputAutomatonEvent* pEvent = parseInputParameterToInputAutomatonEvent(input);
 	
@@ -109,7 +111,7 @@ void InputController::ProcessInput()
 	
 }
 
-InputParameter InputController::getInput()
+InputParameter InputController::getInput(int timeout_ms)
 {
 	int keypadFd = m_pPipeKeypad->getFd();
 	int rfidFd = m_pPipeRFID->getFd();
@@ -127,12 +129,17 @@ InputParameter InputController::getInput()
 
 	pollfd fdPollArray[] = { rfidPollStruct, keypadPollStruct };
 	int openFds = 2;
-	int timeout_ms = 10;
 
 	pollfd* pRFIDPollStruct = &fdPollArray[0];
 	pollfd* pKeypadPollStruct = &fdPollArray[1];
 
 	
+	// Frames drained by an earlier read are not visible to poll()
+	if (m_pPipeKeypad->hasPendingMessages() || m_pPipeRFID->hasPendingMessages())
+	{
+		timeout_ms = 0;
+	}
+
 	int retval = poll(fdPollArray, openFds, timeout_ms);
 	// int retval = poll(fdPollArray, openFds, -1);
 	
@@ -143,7 +150,7 @@ InputParameter InputController::getInput()
 		*m_pLogger << "poll() error!";
 		Kernel::Fatal_Error("poll error!");
 	}
-	else if (retval == 0)
+	else if (retval == 0 && !m_pPipeKeypad->hasPendingMessages() && !m_pPipeRFID->hasPendingMessages())
 	{
 		
 		// *m_pLogger << "poll() timed out!";
@@ -152,23 +159,25 @@ InputParameter InputController::getInput()
 	
 	// *m_pLogger << "poll(): #" + std::to_string(retval) + " of fd's ready I/O";
 	
-	if (pKeypadPollStruct->revents & POLLIN)
+	PipeMessage message;
+	if ((m_pPipeKeypad->hasPendingMessages() || (pKeypadPollStruct->revents & POLLIN))
+		&& m_pPipeKeypad->receiveMessage(message))
 	{
-		DEBUG("KEYPAD - MARK 1");
-		std::string input = m_pPipeKeypad->receive();
+		*m_pLogger << "\tKeypad: " + message.getData();
 		
-		*m_pLogger << "\tKeypad: " + input;
-		
-		return parseKeypadInput(input);
+		return parseKeypadInput(message);
 	}
-	else if (pRFIDPollStruct->revents & POLLIN)
+	else if ((m_pPipeRFID->hasPendingMessages() || (pRFIDPollStruct->revents & POLLIN))
+		&& m_pPipeRFID->receiveMessage(message))
 	{
-		DEBUG("RFID - MARK 1");
-		std::string input = m_pPipeRFID->receive();
-		
-		*m_pLogger << "\tRFID: " + input;
+		*m_pLogger << "\tRFID: " + message.getData();
 		
-		return parseRFIDInput(input);
+		return parseRFIDInput(message);
+	}
+	else if (!(pKeypadPollStruct->revents & ~POLLIN) && !(pRFIDPollStruct->revents & ~POLLIN))
+	{
+		// Readable, but only part of a frame has arrived so far
+		return InputParameter();
 	}
 	
 	std::stringstream errorStringBuilder;
@@ -192,17 +201,28 @@ InputParameter InputController::getInput()
 	return InputParameter();
 }
 
-InputParameter InputController::parseKeypadInput(const std::string& input)
+InputParameter InputController::parseKeypadInput(const PipeMessage& message)
 {
-	if (input == "ENTER")
+	KeypadEvent event = KeypadEvent::fromPipeMessage(message);
+
+	switch (event.getType())
 	{
+	case KeypadEvent::Enter:
 		return InputParameter(InputParameter::enuType::Enter);
-	}
-	else if (input == "BCKSPC")
-	{
+
+	case KeypadEvent::Backspace:
+	case KeypadEvent::Reset:
 		return InputParameter(InputParameter::enuType::Cancel);
+
+	case KeypadEvent::Data:
+		break;
+
+	default:
+		*m_pLogger << "Invalid keypad message, type " + std::to_string((int)message.getType());
+		return InputParameter();
 	}
 
+	const std::string& input = event.getData();
 	switch (input[0])
 	{
 	case '*':
@@ -225,10 +245,15 @@ InputParameter InputController::parseKeypadInput(const std::string& input)
 	}
 }
 
-InputParameter InputController::parseRFIDInput(const std::string& input)
+InputParameter InputController::parseRFIDInput(const PipeMessage& message)
 {
-	
-	return InputParameter(InputParameter::enuType::RFIDCard, input);
+	if (message.getType() != PipeMessage::RFIDCard)
+	{
+		*m_pLogger << "Invalid RFID message, type " + std::to_string((int)message.getType());
+		return InputParameter();
+	}
+
+	return InputParameter(InputParameter::enuType::RFIDCard, message.getData());
 }
 
 
@@ -0,0 +1,94 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "PiHardwareBackend.hpp"
+#include "SimulatedHardwareBackend.hpp"
+
+#include <pigpio.h>
+
+#include "Kernel.hpp"
+#include "PN532_NFC.hpp"
+
+std::unique_ptr<I_HardwareBackend> CreateHardwareBackend(const Properties& properties, ILogger* pLogger)
+{
+	if (pLogger == nullptr)
+	{
+		pLogger = NulLogger::getInstance();
+	}
+
+	if (properties.HARDWARE_BACKEND == "pi")
+	{
+		return std::unique_ptr<I_HardwareBackend>(new PiHardwareBackend());
+	}
+
+	if (properties.HARDWARE_BACKEND == "simulated")
+	{
+		return std::unique_ptr<I_HardwareBackend>(new SimulatedHardwareBackend(properties.DOORS,
+			properties.SIMULATION_SCENARIO_PATH, properties.SIMULATION_CONTROL_SOCKET, pLogger));
+	}
+
+	*pLogger << "Unknown hardware backend: " + properties.HARDWARE_BACKEND;
+	Kernel::Fatal_Error("Unknown hardware backend: " + properties.HARDWARE_BACKEND);
+	return nullptr;
+}
+
+PiHardwareBackend::PiHardwareBackend()
+{
+	int gpioStatus = gpioInitialise();
+	if (gpioStatus < 0)
+	{
+		Kernel::Fatal_Error("HardwareDaemon - Could not initialize GPIO pins (pigpio)!");
+	}
+}
+
+PiHardwareBackend::~PiHardwareBackend()
+{
+	// I2C handles must be closed while pigpio is still running
+	m_lcdDevices.clear();
+	m_cardReaders.clear();
+	m_keypads.clear();
+
+	gpioTerminate();
+}
+
+Keypad* PiHardwareBackend::OpenKeypad(const DoorProperties& door, Pipe* pOutputPipe, ILogger* pLogger)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_keypads.emplace_back(new Keypad(door.KEYPAD_ISTREAM_PATH, pOutputPipe, pLogger));
+	return m_keypads.back().get();
+}
+
+ICardReader* PiHardwareBackend::OpenCardReader(const DoorProperties& door, ILogger* pLogger)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cardReaders.emplace_back(new PN532_NFC(door.RFID_CONNSTRING, pLogger));
+	return m_cardReaders.back().get();
+}
+
+I_I2C_Device* PiHardwareBackend::OpenLCD_Device(const DoorProperties& door, unsigned int i2c_bus)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_lcdDevices.emplace_back(new PigpioI2C_Device(i2c_bus, door.LCD_I2C_ADDRESS));
+	return m_lcdDevices.back().get();
+}
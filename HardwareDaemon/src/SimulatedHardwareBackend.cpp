@@ -0,0 +1,610 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SimulatedHardwareBackend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "Kernel.hpp"
+
+SimulatedHardwareBackend::SimulatedHardwareBackend(const std::vector<DoorProperties>& doors,
+	const std::string& scenarioPath, const std::string& controlSocketPath, ILogger* pLogger)
+	: m_pLogger(pLogger == nullptr ? NulLogger::getInstance() : pLogger),
+	m_scenarioPath(scenarioPath),
+	m_controlSocketPath(controlSocketPath),
+	m_gpio(53, false),
+	m_stop(false),
+	m_keysPressed(0),
+	m_cardsPresented(0),
+	m_controlCommands(0),
+	m_listenFd(-1)
+{
+	m_stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (m_stopFd < 0)
+	{
+		Kernel::Fatal_Error("SimulatedHardwareBackend - Could not create stop event!");
+	}
+
+	for (const DoorProperties& properties : doors)
+	{
+		int keyPipe[2];
+		if (pipe2(keyPipe, O_CLOEXEC | O_NONBLOCK) < 0)
+		{
+			Kernel::Fatal_Error("SimulatedHardwareBackend - Could not create keypad pipe for door " + std::to_string(properties.ID));
+		}
+
+		std::unique_ptr<SimulatedDoor> pDoor(new SimulatedDoor());
+		pDoor->properties = properties;
+		pDoor->keyReadFd = keyPipe[0];
+		pDoor->keyWriteFd = keyPipe[1];
+		pDoor->pCardReader.reset(new SimulatedCardReader("simulated reader, door " + std::to_string(properties.ID), 0, true));
+		pDoor->pLCD.reset(new MockI2C_Device());
+		pDoor->removalPending = false;
+		m_doors[properties.ID] = std::move(pDoor);
+	}
+}
+
+SimulatedHardwareBackend::~SimulatedHardwareBackend()
+{
+	Stop();
+
+	for (auto& entry : m_doors)
+	{
+		SimulatedDoor& door = *entry.second;
+		// The keypad closes the read end it was given
+		door.pKeypad.reset();
+		if (door.keyReadFd >= 0) close(door.keyReadFd);
+		close(door.keyWriteFd);
+	}
+
+	close(m_stopFd);
+}
+
+Keypad* SimulatedHardwareBackend::OpenKeypad(const DoorProperties& door, Pipe* pOutputPipe, ILogger* pLogger)
+{
+	SimulatedDoor* pDoor = findDoor(door.ID);
+	if (pDoor == nullptr || pDoor->keyReadFd < 0)
+	{
+		Kernel::Fatal_Error("SimulatedHardwareBackend - No keypad to open for door " + std::to_string(door.ID));
+	}
+
+	pDoor->pKeypad.reset(new Keypad(pDoor->keyReadFd, pOutputPipe, pLogger));
+	pDoor->keyReadFd = -1;
+	return pDoor->pKeypad.get();
+}
+
+ICardReader* SimulatedHardwareBackend::OpenCardReader(const DoorProperties& door, ILogger* pLogger)
+{
+	(void)pLogger;
+	SimulatedDoor* pDoor = findDoor(door.ID);
+	if (pDoor == nullptr)
+	{
+		Kernel::Fatal_Error("SimulatedHardwareBackend - No card reader for door " + std::to_string(door.ID));
+	}
+
+	return pDoor->pCardReader.get();
+}
+
+I_I2C_Device* SimulatedHardwareBackend::OpenLCD_Device(const DoorProperties& door, unsigned int i2c_bus)
+{
+	(void)i2c_bus;
+	SimulatedDoor* pDoor = findDoor(door.ID);
+	if (pDoor == nullptr)
+	{
+		Kernel::Fatal_Error("SimulatedHardwareBackend - No LCD for door " + std::to_string(door.ID));
+	}
+
+	return pDoor->pLCD.get();
+}
+
+void SimulatedHardwareBackend::Start()
+{
+	if (!m_scenarioPath.empty())
+	{
+		std::ifstream file(m_scenarioPath);
+		if (!file)
+		{
+			Kernel::Fatal_Error("SimulatedHardwareBackend - Could not open scenario " + m_scenarioPath);
+		}
+
+		HardwareScenario scenario;
+		std::string error;
+		if (!HardwareScenario::Parse(file, scenario, error))
+		{
+			Kernel::Fatal_Error("SimulatedHardwareBackend - Invalid scenario " + m_scenarioPath + ": " + error);
+		}
+
+		*m_pLogger << "Playing hardware scenario " + m_scenarioPath;
+		m_scenarioThread = std::thread(&SimulatedHardwareBackend::scenarioLoop, this, scenario);
+	}
+
+	if (!m_controlSocketPath.empty())
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (m_controlSocketPath.size() >= sizeof(address.sun_path))
+		{
+			Kernel::Fatal_Error("SimulatedHardwareBackend - Control socket path too long: " + m_controlSocketPath);
+		}
+		m_controlSocketPath.copy(address.sun_path, m_controlSocketPath.size());
+
+		// A socket left behind by a previous run would make bind() fail
+		unlink(m_controlSocketPath.c_str());
+
+		m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (m_listenFd < 0
+			|| bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+			|| listen(m_listenFd, 4) < 0)
+		{
+			Kernel::Fatal_Error("SimulatedHardwareBackend - Could not open control socket " + m_controlSocketPath);
+		}
+
+		*m_pLogger << "Hardware control socket: " + m_controlSocketPath;
+		m_controlThread = std::thread(&SimulatedHardwareBackend::controlLoop, this);
+	}
+}
+
+void SimulatedHardwareBackend::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+
+	uint64_t one = 1;
+	if (write(m_stopFd, &one, sizeof(one)) < 0)
+	{
+		*m_pLogger << "SimulatedHardwareBackend - Could not signal stop event";
+	}
+
+	if (m_scenarioThread.joinable()) m_scenarioThread.join();
+	if (m_controlThread.joinable()) m_controlThread.join();
+
+	if (m_listenFd >= 0)
+	{
+		close(m_listenFd);
+		m_listenFd = -1;
+		unlink(m_controlSocketPath.c_str());
+	}
+}
+
+bool SimulatedHardwareBackend::PressKeys(unsigned int doorId, const std::string& keys)
+{
+	SimulatedDoor* pDoor = findDoor(doorId);
+	if (pDoor == nullptr)
+	{
+		return false;
+	}
+
+	// Press, report, release, report - what an evdev keypad sends for every key
+	std::vector<input_event> events(4 * keys.size());
+	timeval now;
+	gettimeofday(&now, nullptr);
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		unsigned short code;
+		if (!HardwareScenario::KeyCode(keys[i], code))
+		{
+			return false;
+		}
+
+		input_event* pEvents = &events[4 * i];
+		for (int j = 0; j < 4; ++j) pEvents[j].time = now;
+		pEvents[0].type = EV_KEY; pEvents[0].code = code; pEvents[0].value = 1;
+		pEvents[1].type = EV_SYN; pEvents[1].code = SYN_REPORT; pEvents[1].value = 0;
+		pEvents[2].type = EV_KEY; pEvents[2].code = code; pEvents[2].value = 0;
+		pEvents[3].type = EV_SYN; pEvents[3].code = SYN_REPORT; pEvents[3].value = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_keysMutex);
+	if (!writeAll(pDoor->keyWriteFd, reinterpret_cast<const char*>(events.data()), events.size() * sizeof(input_event)))
+	{
+		return false;
+	}
+
+	m_keysPressed += keys.size();
+	return true;
+}
+
+bool SimulatedHardwareBackend::PresentCard(unsigned int doorId, const std::string& cardUUID, unsigned int hold_ms)
+{
+	SimulatedDoor* pDoor = findDoor(doorId);
+	if (pDoor == nullptr)
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pDoor->pCardReader->PresentCard(cardUUID);
+		pDoor->removalPending = hold_ms != 0;
+		pDoor->removeAt = Clock::now() + std::chrono::milliseconds(hold_ms);
+	}
+	m_changed.notify_all();
+
+	++m_cardsPresented;
+	return true;
+}
+
+bool SimulatedHardwareBackend::RemoveCard(unsigned int doorId)
+{
+	SimulatedDoor* pDoor = findDoor(doorId);
+	if (pDoor == nullptr)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	pDoor->pCardReader->RemoveCard();
+	pDoor->removalPending = false;
+	return true;
+}
+
+bool SimulatedHardwareBackend::Play(const HardwareScenario& scenario)
+{
+	typedef HardwareScenario::Command Command;
+	const std::vector<Command>& commands = scenario.getCommands();
+
+	// Remaining repetitions of every REPEAT currently being played, by its index
+	std::vector<unsigned long> remaining(commands.size(), 0);
+	Clock::time_point timeline = Clock::now();
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		const Command& command = commands[i];
+		bool ok = true;
+
+		switch (command.type)
+		{
+		case Command::Type::KEYS:
+			ok = PressKeys(command.doorId, command.text);
+			break;
+		case Command::Type::CARD:
+			ok = PresentCard(command.doorId, command.text, static_cast<unsigned int>(command.duration_ms));
+			break;
+		case Command::Type::WAIT:
+			timeline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(command.duration_ms));
+			ok = waitUntil(timeline);
+			break;
+		case Command::Type::REPEAT:
+			remaining[i] = command.count;
+			break;
+		case Command::Type::END:
+			if (--remaining[command.count] > 0)
+			{
+				i = command.count;
+			}
+			break;
+		}
+
+		if (!ok)
+		{
+			*m_pLogger << "SimulatedHardwareBackend - Scenario stopped at command " + std::to_string(i + 1);
+			return false;
+		}
+	}
+
+	// Let every card presented by the scenario be taken out
+	for (;;)
+	{
+		Clock::time_point lastRemoval = Clock::now();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& entry : m_doors)
+			{
+				if (entry.second->removalPending && entry.second->removeAt > lastRemoval) lastRemoval = entry.second->removeAt;
+			}
+		}
+
+		if (lastRemoval <= Clock::now())
+		{
+			// One more pass takes out the cards due exactly now
+			std::lock_guard<std::mutex> lock(m_mutex);
+			removeDueCards(Clock::now());
+			return !m_stop;
+		}
+
+		if (!waitUntil(lastRemoval))
+		{
+			return false;
+		}
+	}
+}
+
+std::string SimulatedHardwareBackend::Execute(const std::string& line)
+{
+	++m_controlCommands;
+
+	std::istringstream words(line);
+	std::string name;
+	words >> name;
+
+	if (name == "remove" || name == "lcd")
+	{
+		unsigned int doorId;
+		if (!(words >> doorId) || findDoor(doorId) == nullptr)
+		{
+			return "ERROR unknown door";
+		}
+
+		if (name == "remove")
+		{
+			RemoveCard(doorId);
+			return "OK";
+		}
+
+		return "OK " + getLCD_Text(doorId);
+	}
+
+	if (name == "gpio")
+	{
+		unsigned int pin;
+		if (!(words >> pin))
+		{
+			return "ERROR expected a pin number";
+		}
+
+		return m_gpio.isHigh(pin) ? "OK 1" : "OK 0";
+	}
+
+	if (name == "stats")
+	{
+		Stats stats = getStats();
+		return "OK keys=" + std::to_string(stats.keysPressed) + " cards=" + std::to_string(stats.cardsPresented)
+			+ " commands=" + std::to_string(stats.controlCommands);
+	}
+
+	HardwareScenario::Command command;
+	std::string error;
+	if (!HardwareScenario::ParseCommand(line, command, error))
+	{
+		return "ERROR " + error;
+	}
+
+	bool ok = true;
+	switch (command.type)
+	{
+	case HardwareScenario::Command::Type::KEYS:
+		ok = PressKeys(command.doorId, command.text);
+		break;
+	case HardwareScenario::Command::Type::CARD:
+		ok = PresentCard(command.doorId, command.text, static_cast<unsigned int>(command.duration_ms));
+		break;
+	case HardwareScenario::Command::Type::WAIT:
+		ok = waitUntil(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(command.duration_ms)));
+		break;
+	default:
+		return "ERROR " + name + " is only valid in scenario files";
+	}
+
+	return ok ? "OK" : "ERROR unknown door or stopped";
+}
+
+std::string SimulatedHardwareBackend::getLCD_Text(unsigned int doorId) const
+{
+	SimulatedDoor* pDoor = findDoor(doorId);
+	if (pDoor == nullptr)
+	{
+		return "";
+	}
+
+	return pDoor->pLCD->getLine(0) + "|" + pDoor->pLCD->getLine(1);
+}
+
+SimulatedHardwareBackend::Stats SimulatedHardwareBackend::getStats() const
+{
+	Stats stats;
+	stats.keysPressed = m_keysPressed;
+	stats.cardsPresented = m_cardsPresented;
+	stats.controlCommands = m_controlCommands;
+	return stats;
+}
+
+SimulatedHardwareBackend::SimulatedDoor* SimulatedHardwareBackend::findDoor(unsigned int doorId) const
+{
+	auto it = m_doors.find(doorId);
+	return it == m_doors.end() ? nullptr : it->second.get();
+}
+
+bool SimulatedHardwareBackend::waitUntil(Clock::time_point time)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		if (m_stop)
+		{
+			return false;
+		}
+
+		Clock::time_point now = Clock::now();
+		Clock::time_point nextRemoval = removeDueCards(now);
+		if (now >= time)
+		{
+			return true;
+		}
+
+		Clock::time_point wakeUp = std::min(time, nextRemoval);
+		if (wakeUp == Clock::time_point::max())
+		{
+			m_changed.wait(lock);
+		}
+		else
+		{
+			m_changed.wait_until(lock, wakeUp);
+		}
+	}
+}
+
+SimulatedHardwareBackend::Clock::time_point SimulatedHardwareBackend::removeDueCards(Clock::time_point now)
+{
+	Clock::time_point next = Clock::time_point::max();
+	for (auto& entry : m_doors)
+	{
+		SimulatedDoor& door = *entry.second;
+		if (!door.removalPending)
+		{
+			continue;
+		}
+
+		if (door.removeAt <= now)
+		{
+			door.pCardReader->RemoveCard();
+			door.removalPending = false;
+		}
+		else if (door.removeAt < next)
+		{
+			next = door.removeAt;
+		}
+	}
+
+	return next;
+}
+
+bool SimulatedHardwareBackend::writeAll(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t written = write(fd, data, size);
+		if (written > 0)
+		{
+			data += written;
+			size -= written;
+			continue;
+		}
+
+		if (written < 0 && errno != EAGAIN && errno != EINTR)
+		{
+			return false;
+		}
+
+		// Pipe full: the keypad thread is behind, wait for it unless stopped
+		pollfd fds[2] = { { fd, POLLOUT, 0 }, { m_stopFd, POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0 && errno != EINTR)
+		{
+			return false;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SimulatedHardwareBackend::scenarioLoop(HardwareScenario scenario)
+{
+	if (Play(scenario))
+	{
+		*m_pLogger << "Hardware scenario finished";
+	}
+
+	// Cards presented from the control socket still have to be taken out
+	waitUntil(Clock::time_point::max());
+}
+
+void SimulatedHardwareBackend::controlLoop()
+{
+	struct Client
+	{
+		int fd;
+		std::string input;
+	};
+	std::vector<Client> clients;
+
+	for (;;)
+	{
+		std::vector<pollfd> fds;
+		fds.push_back({ m_stopFd, POLLIN, 0 });
+		fds.push_back({ m_listenFd, POLLIN, 0 });
+		for (const Client& client : clients) fds.push_back({ client.fd, POLLIN, 0 });
+
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			int clientFd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (clientFd >= 0) clients.push_back({ clientFd, "" });
+		}
+
+		// Clients accepted above have no entry in fds yet and are polled next time
+		for (size_t i = fds.size() - 2; i-- > 0;)
+		{
+			if (fds[i + 2].revents == 0)
+			{
+				continue;
+			}
+
+			Client& client = clients[i];
+			char buffer[512];
+			ssize_t received = read(client.fd, buffer, sizeof(buffer));
+			bool connected = received > 0;
+			if (connected)
+			{
+				client.input.append(buffer, received);
+
+				size_t lineEnd;
+				while (connected && (lineEnd = client.input.find('\n')) != std::string::npos)
+				{
+					std::string line = client.input.substr(0, lineEnd);
+					client.input.erase(0, lineEnd + 1);
+					if (!line.empty() && line.back() == '\r') line.pop_back();
+
+					std::string reply = Execute(line) + "\n";
+					connected = send(client.fd, reply.data(), reply.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(reply.size());
+				}
+			}
+
+			if (!connected)
+			{
+				close(client.fd);
+				clients.erase(clients.begin() + i);
+			}
+		}
+	}
+
+	for (const Client& client : clients) close(client.fd);
+}
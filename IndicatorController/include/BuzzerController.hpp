@@ -25,24 +25,35 @@
 #ifndef BUZZER_CONTROLLER_HPP
 #define BUZZER_CONTROLLER_HPP
 
-/// Class which represents Active buzzer
+#include <string>
+
+#include "PatternSequencer.hpp"
+#include "properties.h"
+
+/// Class which represents Active buzzer, optionally with a status LED next to it
 class Buzzer
 {
 public:
 	Buzzer() = delete;
 	/**
 	 * @brief Create new Buzzer object
+	 * @param pGpio GPIO the pins are on, must outlive this object
 	 * @param pinBCM Buzzer `SIGNAL` pin (Broadcomm/BCM pin numbering)
+	 * @param ledPinBCM Status LED pin, `DoorProperties::NO_PIN` without one
 	*/
-	Buzzer(unsigned int pinBCM);
+	Buzzer(I_GPIO_Port* pGpio, unsigned int pinBCM, unsigned int ledPinBCM = DoorProperties::NO_PIN);
 	~Buzzer();
 
+	// Start the pattern configured in config.xml and return without waiting for it to finish
 	void SignalSuccess();
 	void SignalFailure();
 	void SignalPing();
 
 private:
 	unsigned int m_pinBCM;
+	PatternSequencer m_sequencer;
+
+	void play(const std::string& patternText, unsigned int priority, const std::string& name);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -25,7 +25,7 @@
 #ifndef DOOR_CONTROLLER_HPP
 #define DOOR_CONTROLLER_HPP
 
-#include "Timer.hpp"
+#include "PatternSequencer.hpp"
 
 /// Class which represents electronic lock
 class Door
@@ -35,22 +35,20 @@ public:
 
 	/**
 	 * @brief Create new Door object
+	 * @param pGpio GPIO the pin is on, must outlive this object
 	 * @param pinBCM Door `SIGNAL` pin (Broadcomm/BCM pin numbering)
-	 * @param doorOpenTime_ms Time duration which the door stays unlocked (in milliseconds)
 	*/
-	Door(unsigned int pinBCM, unsigned int doorOpenTime_ms);
+	Door(I_GPIO_Port* pGpio, unsigned int pinBCM);
+
+	/// Locks the door
 	~Door();
 
+	/// Unlocks the door for the DoorOpen pattern from config.xml. Opening an open door restarts the pattern.
 	void OpenDoors();
 
 private:
 	unsigned int m_pinBCM;
-	unsigned int m_doorOpenTime_ms;
-
-	Timer m_tmrDoor;
-	TimerCallbackFunctor<Door>* m_pTimeoutCallback;
-
-	void closeTheDoor_timerCallback(void*);
+	PatternSequencer m_sequencer;
 };
 
-#endif
\ No newline at end of file
+#endif
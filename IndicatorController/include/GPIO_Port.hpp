@@ -0,0 +1,50 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef GPIO_PORT_HPP
+#define GPIO_PORT_HPP
+
+/// GPIO pins used as outputs (Broadcomm/BCM pin numbering)
+class I_GPIO_Port
+{
+public:
+	enum class Pull { NONE, DOWN, UP };
+
+	virtual ~I_GPIO_Port() {};
+
+	/// Configures `pinBCM` as an output with the given pull resistor. Returns false if the pin does not exist.
+	virtual bool SetOutput(unsigned int pinBCM, Pull pull) = 0;
+
+	virtual void Write(unsigned int pinBCM, bool high) = 0;
+};
+
+/// GPIO through pigpio. Requires gpioInitialise() called before use.
+class PigpioGPIO_Port : public I_GPIO_Port
+{
+public:
+	virtual bool SetOutput(unsigned int pinBCM, Pull pull) override;
+	virtual void Write(unsigned int pinBCM, bool high) override;
+};
+
+#endif
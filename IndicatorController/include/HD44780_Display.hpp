@@ -0,0 +1,113 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HD44780_DISPLAY_HPP
+#define HD44780_DISPLAY_HPP
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "I2C_Device.hpp"
+
+/**
+ * @brief 16x2 HD44780 character display behind a PCF8574 I2C backpack, rendered from a shadow framebuffer
+ *
+ * `Show()` only stores the requested content and returns; a render thread compares it with what the
+ * display currently shows and sends just the changed cells, with a cursor move only where the changed
+ * cells are not contiguous. When most of the display turns blank, Clear Display is used instead.
+ * Every line is one I2C transaction: the PCF8574 latches each byte of a write to its outputs, so the
+ * enable pulses of a whole line can be clocked out without waiting in between.
+ * When content is requested faster than it can be rendered, intermediate content is skipped.
+*/
+class HD44780_Display
+{
+public:
+	static const unsigned int COLUMNS = 16;
+	static const unsigned int LINES = 2;
+
+	typedef std::array<std::string, LINES> Lines;
+
+	/**
+	 * @brief Starts the render thread, which initializes the controller before showing anything
+	 * @param pDevice LCD backpack, must outlive this object
+	 * @param transactionGap_us Wait after every I2C transaction
+	*/
+	HD44780_Display(I_I2C_Device* pDevice, unsigned int transactionGap_us = 0);
+
+	/// Finishes the transaction in progress and stops the render thread
+	~HD44780_Display();
+
+	HD44780_Display(const HD44780_Display&) = delete;
+	HD44780_Display& operator=(const HD44780_Display&) = delete;
+
+	/// Queues `message` for display and returns immediately. See `Layout()`.
+	void Show(const std::string& message);
+
+	void setTransactionGap_us(unsigned int transactionGap_us);
+
+	/// Blocks until the newest content passed to `Show()` is on the display. Returns false on timeout.
+	bool WaitUntilRendered(unsigned int timeout_ms);
+
+	/// First `COLUMNS` characters of `message` on the first line, the next `COLUMNS` on the second, padded with spaces
+	static Lines Layout(const std::string& message);
+
+private:
+	typedef std::array<char, COLUMNS * LINES> Frame;
+
+	I_I2C_Device* m_pDevice;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::condition_variable m_rendered;
+	Frame m_requested;
+	unsigned long m_requestedVersion;
+	unsigned long m_renderedVersion;
+	unsigned int m_transactionGap_us;
+	bool m_stop;
+
+	/// What the display shows, only touched by the render thread
+	Frame m_shown;
+
+	std::thread m_renderThread;
+
+	void renderLoop();
+	void initializeController();
+	void render(const Frame& target, unsigned int transactionGap_us);
+
+	/// Instructions which turn `line` of `shown` into that of `target`
+	static void appendLineUpdate(std::vector<uint8_t>& bytes, unsigned int line, const Frame& shown, const Frame& target);
+
+	/// One I2C transaction, followed by the transaction gap. Returns false if the device did not acknowledge.
+	bool send(const std::vector<uint8_t>& bytes, unsigned int transactionGap_us);
+
+	static void appendInstruction(std::vector<uint8_t>& bytes, uint8_t instruction);
+	static void appendCharacter(std::vector<uint8_t>& bytes, char character);
+	static void appendNibble(std::vector<uint8_t>& bytes, uint8_t nibble, uint8_t flags);
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef I2C_DEVICE_HPP
+#define I2C_DEVICE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/// One device on an I2C bus
+class I_I2C_Device
+{
+public:
+	virtual ~I_I2C_Device() {};
+
+	/**
+	 * @brief Writes `length` bytes to the device in a single transaction (start, address, bytes, stop)
+	 * @return false if the device did not acknowledge
+	*/
+	virtual bool Write(const uint8_t* data, size_t length) = 0;
+
+	/// Waits at least `time_us`, e.g. for a slow command of the device to complete
+	virtual void Delay_us(unsigned int time_us) = 0;
+};
+
+/// I2C device opened through pigpio. Requires gpioInitialise() called before constructing.
+class PigpioI2C_Device : public I_I2C_Device
+{
+public:
+	PigpioI2C_Device(unsigned int i2c_bus, unsigned int i2c_address);
+	virtual ~PigpioI2C_Device();
+
+	virtual bool Write(const uint8_t* data, size_t length) override;
+	virtual void Delay_us(unsigned int time_us) override;
+
+private:
+	int m_handle;
+};
+
+#endif
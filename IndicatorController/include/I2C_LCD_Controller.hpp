@@ -25,14 +25,15 @@
 #ifndef I2C_LCD_CONTROLLER_HPP
 #define I2C_LCD_CONTROLLER_HPP
 
+#include <memory>
 #include <string>
 #include "Timer.hpp"
 #include "propertiesclass.h"
 
-// const std::string DEFAULT_IDLE_MSG = "EMOVIS";
-const std::string DEFAULT_IDLE_MSG = GlobalProperties::Get().LCD_DEFAULT_IDLE_MESSAGE;
+#include "HD44780_Display.hpp"
+#include "I2C_Device.hpp"
 
-/// Class which represents I2C HD44780 16x2 LCD Screen Controller
+/// Class which represents I2C HD44780 16x2 LCD Screen Controller. All calls return without waiting for the display.
 class I2C_LCD
 {
 public:
@@ -40,20 +41,28 @@ public:
 	/**
 	 * @brief Create new I2C_LCD object
 	 * @param i2c_bus RPi I2C bus (check the RPi documentation)
+	 * @param i2c_address Address of the LCD backpack on `i2c_bus`; differs per LCD when several share a bus
 	*/
-	I2C_LCD(unsigned int i2c_bus);
+	I2C_LCD(unsigned int i2c_bus, unsigned int i2c_address = GlobalProperties::Get().LCD_I2C_ADDRESS);
+
+	/// Create new I2C_LCD object on `pDevice`, which must outlive it (e.g. a device of a hardware backend)
+	I2C_LCD(I_I2C_Device* pDevice);
 	~I2C_LCD();
 
 	/**
 	 * @brief Set time after which temporary messages will revert to `idleMessage`
 	 * @param messageLingerTime_ms Time duration which temporary message stays displayed on LCD Screen (in milliseconds)
-	 * @param idleMessage Permanent message which will be shown after `messageLingerTime_ms` expires.
+	 * @param idleMessage Permanent message which will be shown after `messageLingerTime_ms` expires, empty keeps the current one
 	*/
-	void SetMessageLingerTime_ms(unsigned int messageLingerTime_ms, const std::string& idleMessage = DEFAULT_IDLE_MSG);
+	void SetMessageLingerTime_ms(unsigned int messageLingerTime_ms, const std::string& idleMessage = "");
 	void ClearDisplay();
+	/// Shows LCD_DEFAULT_IDLE_MESSAGE, read from the current config every time it is shown
 	void ClearDisplayAndDisplayDefaultMsg();
 	void PutToLCD_Permanently(const std::string& message);
 
+	/// Shows a reloaded LCD_DEFAULT_IDLE_MESSAGE if the default message is on screen; a temporary message reverts to it anyway
+	void RefreshDefaultMsg();
+
 	/**
 	* Put temporary `message` to LCD Screen. Message duration time defined by `SetMessageLingerTime_ms()`, \n
 	* after which Default message will be permanently displayed \n
@@ -63,52 +72,27 @@ public:
 
 private:
 
-	unsigned int m_i2c_bus;
-	unsigned int m_i2c_device_handle;
-
 	unsigned int m_messageLingerTime_ms;
 
-	const std::string m_PREDEFINED_defaultIdleMessage = DEFAULT_IDLE_MSG;
+	/// Shown after temporary messages; unused while the default message is idle
 	std::string m_idleMessage;
+	bool m_bDefaultIdleMessage;
+	bool m_bTemporaryMessageShown;
 
 	Timer m_messageTimer;
 	TimerCallbackFunctor<I2C_LCD>* m_pTimerTimeoutCallback;
 
-	static const uint8_t m_i2c_lcd_address;
-
-	typedef enum : uint8_t
-	{
-		clearDisplay_cmd = 0x01,
-		cursorHome_cmd = 0x02,
-		shiftCursorRight_cmd = 0x14 
-	}enuCommands;
-
-	typedef enum : uint8_t
-	{
-		command = 0x0,
-		data = 0x1,
-
-		read = 0x2,
-		write = 0x0,
+	/// Set if the LCD opened its own device
+	std::unique_ptr<I_I2C_Device> m_pOwnedDevice;
+	HD44780_Display m_display;
 
-		enable = 0x4,
-		backlight = 0x8
-	} enuFlags;
-
-
-	void SendCommand(enuCommands command);
-	void SendCharacter(char character);
-
-	void SendUpperNibbleCommand(uint8_t rawData);
-	void SendUpperNibbleData(uint8_t rawData);
-
-	void initializeLCD();
 	void initializeTimer();
 
-	void goToSecondLine();
-
 	void clearDisplay_TimerCallback(void*);
 
+	void showIdleMessage();
+
+	/// Queues `message` on the display's render thread, does not wait for the I2C transfer
 	void PutToLCD(const std::string& message);
 };
 
@@ -25,10 +25,14 @@
 #ifndef INDICATOR_CONTROLLER_HPP
 #define INDICATOR_CONTROLLER_HPP
 
+#include <map>
+#include <memory>
+
 #include "DataMailbox.hpp"
 
 #include "BuzzerController.hpp"
 #include "DoorController.hpp"
+#include "GPIO_Port.hpp"
 #include "I2C_LCD_Controller.hpp"
 
 /// Abstract base class used to control peripherals/indicators like Doors, Buzzers and LCD_Screens
@@ -76,16 +80,20 @@ public:
 
 	virtual void OpenDoor_wBuzzerSuccess();
 
+	/// The next outcome request (`OpenDoor_wBuzzerSuccess()` or `BuzzerFailure()`) carries `trace` to the server
+	void AttachTrace(const LatencyTrace& trace) { m_trace = trace; }
+
 private:
 
 	DataMailbox m_mailbox;
 	MailboxReference m_refServer;
 	ILogger* m_pLogger;
+	LatencyTrace m_trace;
 
 	void checkParameters();
 
 	void sendRequest(const InputParameter& command);
-	void sendConnectionlessRequest(const InputParameter& command);
+	void sendConnectionlessRequest(const InputParameter& command, bool bWithTrace = false);
 
 };
 
@@ -94,22 +102,25 @@ struct Pinout
 {
 	Pinout(unsigned int buzzerPin_BCM,
 		unsigned int doorPin_BCM,
-		unsigned int doorOpenTime_ms,
-		unsigned int lcd_i2c_bus)
+		unsigned int lcd_i2c_bus,
+		unsigned int lcd_i2c_address = GlobalProperties::Get().LCD_I2C_ADDRESS,
+		unsigned int ledPin_BCM = DoorProperties::NO_PIN)
 
 	:	m_buzzerPin_BCM(buzzerPin_BCM),
 		m_doorPin_BCM(doorPin_BCM),
-		m_doorOpenTime_ms(doorOpenTime_ms),
-		m_lcd_i2c_bus(lcd_i2c_bus)
+		m_lcd_i2c_bus(lcd_i2c_bus),
+		m_lcd_i2c_address(lcd_i2c_address),
+		m_ledPin_BCM(ledPin_BCM)
 	{}
 
 	unsigned int m_buzzerPin_BCM;
 	unsigned int m_doorPin_BCM;
-	unsigned int m_doorOpenTime_ms;
 	unsigned int m_lcd_i2c_bus;
+	unsigned int m_lcd_i2c_address;
+	unsigned int m_ledPin_BCM;
 };
 
-/// Requires gpioInitialise() (from pigpio library) called before constructing
+/// Unless the devices are passed in, requires gpioInitialise() (from pigpio library) called before constructing
 class IndicatorController_Server : private I_IndicatorController
 {
 public:
@@ -119,10 +130,32 @@ public:
 		ILogger* pLogger = NulLogger::getInstance()
 	);
 
-	~IndicatorController_Server() {};
+	/**
+	 * @brief Server driving the indicators through devices it does not own, e.g. those of a hardware backend
+	 * @param pGpio GPIO of the buzzer, LED and door pins in `pinout`
+	 * @param pLcdDevice Device of the LCD; the I2C bus and address in `pinout` are not used
+	*/
+	IndicatorController_Server(
+		const std::string& identifier,
+		const Pinout& pinout,
+		I_GPIO_Port* pGpio,
+		I_I2C_Device* pLcdDevice,
+		ILogger* pLogger = NulLogger::getInstance()
+	);
+
+	~IndicatorController_Server();
 
+	/**
+	 * @brief Receives and executes one request.
+	 *
+	 * A traced request is stamped before and after it is executed and its trace is sent to LATENCY_TRACE_SOCKET
+	 * as one datagram: the `InputParameter::enuType` of the request, then the serialized `LatencyTrace`.
+	*/
 	void ListenAndParseRequest(unsigned int timeout_ms);
 
+	/// Descriptor of the request mailbox; becomes readable when a request arrives, so several servers can share one poll()
+	mqd_t getFileDescriptor() const { return m_mailbox.getFileDescriptor(); }
+
 	virtual void BuzzerPing();
 	virtual void BuzzerSuccess();
 	virtual void BuzzerFailure();
@@ -134,19 +167,53 @@ public:
 
 	virtual void OpenDoor_wBuzzerSuccess();
 
+	/// Call after config.xml was reloaded, shows a changed LCD_DEFAULT_IDLE_MESSAGE. \see I2C_LCD::RefreshDefaultMsg()
+	void LCD_RefreshDefaultMsg();
+
 private:
 	ILogger* m_pLogger;
 	DataMailbox m_mailbox;
+	/// Set if the server opened its own GPIO
+	std::unique_ptr<PigpioGPIO_Port> m_pOwnedGpio;
 	Buzzer m_buzzer;
 	Door m_door;
 	I2C_LCD m_lcd;
+	/// Unbound datagram socket for finished traces, -1 if tracing is disabled
+	int m_traceSocket;
 
 	void ParseRequest(const InputParameter& request);
 
+	void openTraceSocket();
+	void sendTrace(const LatencyTrace& trace, InputParameter::enuType request);
+
 	CommandMessage* castToAppropriateType(DataMailboxMessage* pMessage);
 	const InputParameter getParameter(CommandMessage* pMessage);
 
 };
 
+/**
+ * @brief Indicator clients of every door, selected by the door ID carried in messages
+ *
+ * Door `N` is served by the `IndicatorController_Server` named `MailboxName(baseName, N)`.
+*/
+class DoorIndicators
+{
+public:
+	DoorIndicators(ILogger* pLogger = NulLogger::getInstance());
+
+	/// Connects to the indicators of door `doorId`
+	void AddDoor(DoorId doorId, const std::string& baseName);
+
+	/// Client of door `doorId`. Unknown doors (e.g. `NO_DOOR` from a sender that does not set it) get the lowest door ID.
+	IndicatorController_Client* get(DoorId doorId) const;
+
+	/// Identifier of the indicators of door `doorId`
+	static std::string MailboxName(const std::string& baseName, DoorId doorId);
+
+private:
+	ILogger* m_pLogger;
+	std::map<DoorId, std::unique_ptr<IndicatorController_Client>> m_clients;
+};
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MOCK_GPIO_PORT_HPP
+#define MOCK_GPIO_PORT_HPP
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "GPIO_Port.hpp"
+
+/// GPIO without hardware, for tests: records every level change with the time it happened
+class MockGPIO_Port : public I_GPIO_Port
+{
+public:
+	struct Edge
+	{
+		unsigned int pinBCM;
+		bool high;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	/**
+	 * @param maxPinBCM Pins above are rejected like pins that do not exist
+	 * @param recordEdges If false only the levels are kept, for long running simulations
+	*/
+	MockGPIO_Port(unsigned int maxPinBCM = 53, bool recordEdges = true);
+
+	virtual bool SetOutput(unsigned int pinBCM, Pull pull) override;
+	virtual void Write(unsigned int pinBCM, bool high) override;
+
+	/// Writes which changed the level of a pin, in order. Writes of the current level are not edges.
+	std::vector<Edge> getEdges() const;
+	void clearEdges();
+
+	bool isHigh(unsigned int pinBCM) const;
+
+	/// Number of `Write()` calls, including those which did not change the level
+	unsigned long getWriteCount() const;
+
+private:
+	const unsigned int m_maxPinBCM;
+	const bool m_recordEdges;
+
+	mutable std::mutex m_mutex;
+	std::map<unsigned int, bool> m_levels;
+	std::vector<Edge> m_edges;
+	unsigned long m_writeCount;
+};
+
+#endif
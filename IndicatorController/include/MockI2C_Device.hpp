@@ -0,0 +1,86 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MOCK_I2C_DEVICE_HPP
+#define MOCK_I2C_DEVICE_HPP
+
+#include <mutex>
+#include <string>
+
+#include "I2C_Device.hpp"
+
+/**
+ * @brief HD44780 behind a PCF8574 backpack without hardware, for tests and benchmarks
+ *
+ * Decodes the enable pulses written to the expander, executes them on a model of the controller
+ * and counts transactions, bytes and the simulated time they take on the bus. Time is simulated:
+ * every transaction lasts its length at `clock_Hz` and `Delay_us()` only advances the clock,
+ * so nothing actually waits. Instructions arriving before the previous one finished are counted
+ * as timing violations.
+*/
+class MockI2C_Device : public I_I2C_Device
+{
+public:
+	struct Stats
+	{
+		unsigned long transactions;
+		unsigned long bytes;
+		double time_us;			///< Bus time plus delays
+		unsigned long timingViolations;
+	};
+
+	MockI2C_Device(unsigned int clock_Hz = 100000);
+
+	virtual bool Write(const uint8_t* data, size_t length) override;
+	virtual void Delay_us(unsigned int time_us) override;
+
+	Stats getStats() const;
+	void resetStats();
+
+	/// Characters visible on `line` (0 or 1)
+	std::string getLine(unsigned int line) const;
+
+private:
+	const double m_bitTime_us;
+
+	mutable std::mutex m_mutex;
+	Stats m_stats;
+	double m_now_us;
+
+	// Controller model
+	uint8_t m_ddram[0x80];
+	uint8_t m_address;
+	bool m_eightBitMode;
+	bool m_highNibblePending;
+	uint8_t m_highNibble;
+	bool m_enable;
+	unsigned int m_resetStep;
+	double m_busyUntil_us;
+
+	void latch(uint8_t outputs, double time_us);
+	void execute(bool isData, uint8_t value, double time_us);
+	void advanceAddress(bool increment);
+};
+
+#endif
@@ -0,0 +1,116 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef PATTERN_SEQUENCER_HPP
+#define PATTERN_SEQUENCER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GPIO_Port.hpp"
+#include "SignalPattern.hpp"
+
+/**
+ * @brief Plays `SignalPattern`s on GPIO outputs from its own thread, so callers never wait for a pattern to finish
+ *
+ * Step boundaries are absolute deadlines on the monotonic clock, so wake-up latency does not add up over a pattern,
+ * and only outputs whose level changes are written. A pattern of equal or higher priority than the one playing
+ * replaces it at once; a lower priority one waits in a queue (highest priority first, then in arrival order).
+ * Outputs of a pattern which were not added to the sequencer are ignored.
+*/
+class PatternSequencer
+{
+public:
+	enum class PlayResult { STARTED, QUEUED, DROPPED };
+
+	/// Waiting patterns beyond this are dropped, lowest priority first
+	static const size_t MAX_QUEUED = 4;
+
+	/// @param pGpio Must outlive this object
+	PatternSequencer(I_GPIO_Port* pGpio);
+
+	/// Stops the pattern in progress and leaves every output idle
+	~PatternSequencer();
+
+	PatternSequencer(const PatternSequencer&) = delete;
+	PatternSequencer& operator=(const PatternSequencer&) = delete;
+
+	/**
+	 * @brief Drives `pinBCM` for `output` and sets it idle. Call before the first `Play()`.
+	 * @param activeHigh Level of the pin while the output is active
+	 * @return false if the pin cannot be configured as an output
+	*/
+	bool AddOutput(SignalPattern::Output output, unsigned int pinBCM, bool activeHigh, I_GPIO_Port::Pull pull);
+
+	/// Starts or queues `pattern` according to its priority and returns immediately
+	PlayResult Play(const SignalPattern& pattern);
+
+	/// Drops the playing and queued patterns and sets every output idle
+	void Stop();
+
+	/// Blocks until no pattern is playing or queued. Returns false on timeout.
+	bool WaitUntilIdle(unsigned int timeout_ms);
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Pin
+	{
+		SignalPattern::Output output;
+		unsigned int pinBCM;
+		bool activeHigh;
+	};
+
+	I_GPIO_Port* m_pGpio;
+	std::vector<Pin> m_pins;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::condition_variable m_idle;
+	std::deque<SignalPattern> m_queue;
+	SignalPattern m_current;
+	size_t m_step;
+	Clock::time_point m_stepEnd;
+	bool m_playing;
+	/// Incremented whenever the playing pattern is replaced, so the thread abandons the step it waits on
+	unsigned long m_generation;
+	bool m_stop;
+
+	/// Outputs currently driven active, only touched with `m_mutex` held
+	unsigned int m_activeOutputs;
+
+	std::thread m_thread;
+
+	void run();
+	void start(const SignalPattern& pattern, Clock::time_point startTime);
+	/// Returns false if the queue is full of patterns with the same or higher priority
+	bool enqueue(const SignalPattern& pattern);
+	void apply(unsigned int outputs);
+};
+
+#endif
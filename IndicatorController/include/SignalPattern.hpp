@@ -0,0 +1,70 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SIGNAL_PATTERN_HPP
+#define SIGNAL_PATTERN_HPP
+
+#include <string>
+#include <vector>
+
+/// Outputs which are driven active for `duration_ms`, all others are idle
+struct SignalStep
+{
+	unsigned int outputs;	///< Bit mask of `SignalPattern::Output`
+	unsigned int duration_ms;
+};
+
+/**
+ * @brief Sequence of output states played by `PatternSequencer`, e.g. a buzzer tone or the unlock time of the door
+ *
+ * Text form (config.xml): whitespace separated steps `outputs:duration_ms`, where `outputs` are output names
+ * joined with `+`, or `-` for none. "buzzer+led:50 -:50 buzzer:250" sounds the buzzer with the LED lit for 50 ms,
+ * pauses 50 ms and sounds the buzzer alone for 250 ms. All outputs return to idle after the last step.
+*/
+struct SignalPattern
+{
+	enum Output : unsigned int
+	{
+		BUZZER = 0x01,
+		LED = 0x02,
+		DOOR = 0x04
+	};
+
+	static const unsigned int MAX_STEP_DURATION_MS = 60000;
+
+	/// A pattern preempts a playing one of lower or equal priority and is queued behind one of higher priority
+	unsigned int priority;
+	std::vector<SignalStep> steps;
+
+	/// Total duration of all steps
+	unsigned int Duration_ms() const;
+
+	/**
+	 * @brief Parses the text form of a pattern
+	 * @param error Description of the first invalid step, if false is returned
+	*/
+	static bool Parse(const std::string& text, unsigned int priority, SignalPattern& pattern, std::string& error);
+};
+
+#endif
@@ -24,69 +24,56 @@
 
 #include "BuzzerController.hpp"
 
-#include <unistd.h>
-
-#include <pigpio.h>
-
 #include "Kernel.hpp"
 #include "propertiesclass.h"
 
-const unsigned int pingDuration_ms = GlobalProperties::Get().BUZZER_PING_DURATION_MS;
-
-Buzzer::Buzzer(unsigned int pinBCM)
-	:	 m_pinBCM(pinBCM)
+Buzzer::Buzzer(I_GPIO_Port* pGpio, unsigned int pinBCM, unsigned int ledPinBCM)
+	:	 m_pinBCM(pinBCM), m_sequencer(pGpio)
 {
-	int pinStatus = gpioSetMode(m_pinBCM, PI_OUTPUT);
-	if (pinStatus < 0)
+	if (!m_sequencer.AddOutput(SignalPattern::BUZZER, m_pinBCM, true, I_GPIO_Port::Pull::DOWN))
 	{
 		Kernel::Fatal_Error("Buzzer invalid pin: " + std::to_string(m_pinBCM));
 	}
 
-	gpioSetPullUpDown(m_pinBCM, PI_PUD_DOWN);
-	gpioWrite(m_pinBCM, PI_LOW);
+	if (ledPinBCM != DoorProperties::NO_PIN && !m_sequencer.AddOutput(SignalPattern::LED, ledPinBCM, true, I_GPIO_Port::Pull::DOWN))
+	{
+		Kernel::Fatal_Error("Buzzer LED invalid pin: " + std::to_string(ledPinBCM));
+	}
 }
 
 Buzzer::~Buzzer()
 {
 }
 
+// Patterns are not cached - they are applied live when config.xml is reloaded
+
 void Buzzer::SignalSuccess()
 {
-	gpioWrite(m_pinBCM, PI_HIGH);
-	usleep(5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_LOW);
-	usleep(5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_HIGH);
-	usleep(5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_LOW);
-	//usleep(5 * pingDuration_ms * 1000);
-
+	const Properties& properties = GlobalProperties::Get();
+	play(properties.SIGNAL_PATTERN_SUCCESS, properties.SIGNAL_PATTERN_SUCCESS_PRIORITY, "Success");
 }
 
 void Buzzer::SignalFailure()
 {
-	gpioWrite(m_pinBCM, PI_HIGH);
-	usleep(5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_LOW);
-	usleep(5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_HIGH);
-	usleep(5 * 5 * pingDuration_ms * 1000);
-
-	gpioWrite(m_pinBCM, PI_LOW);
-	//usleep(5 * pingDuration_ms * 1000);
+	const Properties& properties = GlobalProperties::Get();
+	play(properties.SIGNAL_PATTERN_FAILURE, properties.SIGNAL_PATTERN_FAILURE_PRIORITY, "Failure");
 }
 
 void Buzzer::SignalPing()
 {
-	gpioWrite(m_pinBCM, PI_HIGH);
-	usleep(2 * pingDuration_ms * 1000);
+	const Properties& properties = GlobalProperties::Get();
+	play(properties.SIGNAL_PATTERN_PING, properties.SIGNAL_PATTERN_PING_PRIORITY, "Ping");
+}
 
-	gpioWrite(m_pinBCM, PI_LOW);
-	//usleep(2 * pingDuration_ms * 1000);
+void Buzzer::play(const std::string& patternText, unsigned int priority, const std::string& name)
+{
+	SignalPattern pattern;
+	std::string error;
+	if (!SignalPattern::Parse(patternText, priority, pattern, error))
+	{
+		Kernel::Warning("Buzzer - invalid " + name + " pattern: " + error);
+		return;
+	}
 
+	m_sequencer.Play(pattern);
 }
@@ -24,50 +24,41 @@
 
 #include "DoorController.hpp"
 
-#include <unistd.h>
-
-#include <pigpio.h>
-
 #include "Kernel.hpp"
+#include "propertiesclass.h"
 
-const unsigned int DOOR_OPEN_PIN_STATE = PI_LOW;
-const unsigned int DOOR_CLOSED_PIN_STATE = PI_HIGH;
-const unsigned int DOOR_PIN_PUD = PI_PUD_UP;
+// The lock relay is active low: the door is open while the pin is low
+const bool DOOR_OPEN_ACTIVE_HIGH = false;
+const I_GPIO_Port::Pull DOOR_PIN_PUD = I_GPIO_Port::Pull::UP;
 
-Door::Door(unsigned int pinBCM, unsigned int doorOpenTime_ms)
-	: m_pinBCM(pinBCM), m_doorOpenTime_ms(doorOpenTime_ms), m_tmrDoor("door"), // TODO rand name to prevent clashes
-	m_pTimeoutCallback(new TimerCallbackFunctor<Door>(this, &Door::closeTheDoor_timerCallback))
+Door::Door(I_GPIO_Port* pGpio, unsigned int pinBCM)
+	: m_pinBCM(pinBCM), m_sequencer(pGpio)
 {
-	int pinStatus = gpioSetMode(m_pinBCM, PI_OUTPUT);
-	if (pinStatus < 0)
+	if (!m_sequencer.AddOutput(SignalPattern::DOOR, m_pinBCM, DOOR_OPEN_ACTIVE_HIGH, DOOR_PIN_PUD))
 	{
 		Kernel::Fatal_Error("Door invalid pin: " + std::to_string(m_pinBCM));
 	}
-
-	gpioSetPullUpDown(m_pinBCM, DOOR_PIN_PUD);
-	gpioWrite(m_pinBCM, DOOR_CLOSED_PIN_STATE);
-
-	m_tmrDoor.setTimeout_ms(doorOpenTime_ms);
-	m_tmrDoor.setTimeoutCallback(m_pTimeoutCallback);
 }
 
 Door::~Door()
 {
-	delete m_pTimeoutCallback;
-	m_tmrDoor.Stop(); // ?
-	closeTheDoor_timerCallback(nullptr); //?
+	// m_sequencer leaves the pin idle, which closes the door
 }
 
 void Door::OpenDoors()
 {
-	gpioWrite(m_pinBCM, DOOR_OPEN_PIN_STATE);
-	//usleep(m_doorOpenTime_ms * 1000);
-	//gpioWrite(m_pinBCM, PI_LOW);
+	// Not cached - applied live when config.xml is reloaded
+	const Properties& properties = GlobalProperties::Get();
 
-	m_tmrDoor.Reset();
-}
+	SignalPattern pattern;
+	std::string error;
+	if (!SignalPattern::Parse(properties.SIGNAL_PATTERN_DOOR_OPEN, properties.SIGNAL_PATTERN_DOOR_OPEN_PRIORITY, pattern, error))
+	{
+		// A typo in the pattern must not keep authorized users out
+		Kernel::Warning("Door - invalid DoorOpen pattern: " + error + ", opening for " + std::to_string(properties.DOOR_OPEN_TIME_MS) + " ms");
+		pattern.priority = properties.SIGNAL_PATTERN_DOOR_OPEN_PRIORITY;
+		pattern.steps.assign(1, SignalStep{ SignalPattern::DOOR, properties.DOOR_OPEN_TIME_MS });
+	}
 
-void Door::closeTheDoor_timerCallback(void*)
-{
-	gpioWrite(m_pinBCM, DOOR_CLOSED_PIN_STATE);
-}
\ No newline at end of file
+	m_sequencer.Play(pattern);
+}
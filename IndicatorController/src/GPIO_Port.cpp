@@ -0,0 +1,55 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "GPIO_Port.hpp"
+
+#include <pigpio.h>
+
+bool PigpioGPIO_Port::SetOutput(unsigned int pinBCM, Pull pull)
+{
+	if (gpioSetMode(pinBCM, PI_OUTPUT) < 0)
+	{
+		return false;
+	}
+
+	switch (pull)
+	{
+	case Pull::NONE:
+		gpioSetPullUpDown(pinBCM, PI_PUD_OFF);
+		break;
+	case Pull::DOWN:
+		gpioSetPullUpDown(pinBCM, PI_PUD_DOWN);
+		break;
+	case Pull::UP:
+		gpioSetPullUpDown(pinBCM, PI_PUD_UP);
+		break;
+	}
+
+	return true;
+}
+
+void PigpioGPIO_Port::Write(unsigned int pinBCM, bool high)
+{
+	gpioWrite(pinBCM, high ? PI_HIGH : PI_LOW);
+}
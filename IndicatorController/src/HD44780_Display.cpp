@@ -0,0 +1,283 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "HD44780_Display.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	// PCF8574 outputs P0..P7 are wired to RS, RW, E, backlight and D4..D7
+	const uint8_t REGISTER_SELECT = 0x01;
+	const uint8_t ENABLE = 0x04;
+	const uint8_t BACKLIGHT = 0x08;
+
+	const uint8_t CLEAR_DISPLAY = 0x01;
+	const uint8_t ENTRY_MODE_INCREMENT = 0x06;
+	const uint8_t DISPLAY_ON = 0x0C;
+	const uint8_t FUNCTION_SET_4BIT_2LINES = 0x28;
+	const uint8_t SET_DDRAM_ADDRESS = 0x80;
+
+	const uint8_t LINE_ADDRESS[HD44780_Display::LINES] = { 0x00, 0x40 };
+
+	const unsigned int CLEAR_DISPLAY_TIME_US = 2000;	// 1.52 ms in the datasheet
+	const size_t CLEAR_DISPLAY_COST_BYTES = 22;			// The wait after Clear Display, in bytes at 100 kHz
+}
+
+HD44780_Display::HD44780_Display(I_I2C_Device* pDevice, unsigned int transactionGap_us)
+	: m_pDevice(pDevice),
+	m_requestedVersion(0),
+	m_renderedVersion(0),
+	m_transactionGap_us(transactionGap_us),
+	m_stop(false)
+{
+	m_requested.fill(' ');
+	m_shown.fill(' ');
+	m_renderThread = std::thread(&HD44780_Display::renderLoop, this);
+}
+
+HD44780_Display::~HD44780_Display()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+	m_renderThread.join();
+}
+
+void HD44780_Display::Show(const std::string& message)
+{
+	const Lines lines = Layout(message);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (unsigned int line = 0; line < LINES; line++)
+		{
+			std::copy(lines[line].begin(), lines[line].end(), m_requested.begin() + line * COLUMNS);
+		}
+		m_requestedVersion++;
+	}
+	m_changed.notify_one();
+}
+
+void HD44780_Display::setTransactionGap_us(unsigned int transactionGap_us)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_transactionGap_us = transactionGap_us;
+}
+
+bool HD44780_Display::WaitUntilRendered(unsigned int timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_rendered.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return m_renderedVersion == m_requestedVersion; });
+}
+
+HD44780_Display::Lines HD44780_Display::Layout(const std::string& message)
+{
+	Lines lines;
+	for (unsigned int line = 0; line < LINES; line++)
+	{
+		const size_t begin = line * COLUMNS;
+		lines[line] = begin < message.length() ? message.substr(begin, COLUMNS) : "";
+		lines[line].resize(COLUMNS, ' ');
+	}
+	return lines;
+}
+
+void HD44780_Display::renderLoop()
+{
+	initializeController();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_changed.wait(lock, [this]() { return m_stop || m_renderedVersion != m_requestedVersion; });
+		if (m_stop)
+		{
+			break;
+		}
+
+		const Frame target = m_requested;
+		const unsigned long version = m_requestedVersion;
+		const unsigned int transactionGap_us = m_transactionGap_us;
+
+		lock.unlock();
+		render(target, transactionGap_us);
+		lock.lock();
+
+		m_renderedVersion = version;
+		m_rendered.notify_all();
+	}
+}
+
+void HD44780_Display::initializeController()
+{
+	unsigned int transactionGap_us;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		transactionGap_us = m_transactionGap_us;
+	}
+
+	// Initialization by instruction (datasheet figure 24): three 8 bit function sets, then switch to 4 bits.
+	// Each is a single nibble and needs its own wait, so each is its own transaction.
+	const struct { uint8_t nibble; unsigned int wait_us; } reset[] = { { 0x30, 4500 }, { 0x30, 150 }, { 0x30, 150 }, { 0x20, 150 } };
+
+	std::vector<uint8_t> bytes;
+	for (const auto& step : reset)
+	{
+		bytes.clear();
+		appendNibble(bytes, step.nibble, 0);
+		send(bytes, 0);
+		m_pDevice->Delay_us(step.wait_us);
+	}
+
+	bytes.clear();
+	appendInstruction(bytes, FUNCTION_SET_4BIT_2LINES);
+	appendInstruction(bytes, DISPLAY_ON);
+	appendInstruction(bytes, ENTRY_MODE_INCREMENT);
+	appendInstruction(bytes, CLEAR_DISPLAY);
+	send(bytes, transactionGap_us);
+	m_pDevice->Delay_us(CLEAR_DISPLAY_TIME_US);
+
+	m_shown.fill(' ');
+}
+
+void HD44780_Display::render(const Frame& target, unsigned int transactionGap_us)
+{
+	std::array<std::vector<uint8_t>, LINES> diff;
+	std::array<std::vector<uint8_t>, LINES> fromBlank;
+	size_t diffBytes = 0;
+	size_t fromBlankBytes = 4 + CLEAR_DISPLAY_COST_BYTES;	// Clear Display instruction and its wait
+
+	Frame blank;
+	blank.fill(' ');
+
+	for (unsigned int line = 0; line < LINES; line++)
+	{
+		appendLineUpdate(diff[line], line, m_shown, target);
+		appendLineUpdate(fromBlank[line], line, blank, target);
+		diffBytes += diff[line].size();
+		fromBlankBytes += fromBlank[line].size();
+	}
+
+	// Blanking most of the display is cheaper with one Clear Display than with spaces in every cell
+	std::array<std::vector<uint8_t>, LINES>* pUpdate = &diff;
+	if (fromBlankBytes < diffBytes)
+	{
+		std::vector<uint8_t> bytes;
+		appendInstruction(bytes, CLEAR_DISPLAY);
+		if (send(bytes, transactionGap_us))
+		{
+			m_pDevice->Delay_us(CLEAR_DISPLAY_TIME_US);
+			m_shown = blank;
+			pUpdate = &fromBlank;
+		}
+	}
+
+	for (unsigned int line = 0; line < LINES; line++)
+	{
+		const std::vector<uint8_t>& bytes = (*pUpdate)[line];
+		if (bytes.empty())
+		{
+			continue;
+		}
+
+		const size_t first = line * COLUMNS;
+		if (send(bytes, transactionGap_us))
+		{
+			std::copy(target.begin() + first, target.begin() + first + COLUMNS, m_shown.begin() + first);
+		}
+		else
+		{
+			// Unknown what reached the display, redraw the whole line with the next content
+			std::fill(m_shown.begin() + first, m_shown.begin() + first + COLUMNS, '\0');
+		}
+	}
+}
+
+void HD44780_Display::appendLineUpdate(std::vector<uint8_t>& bytes, unsigned int line, const Frame& shown, const Frame& target)
+{
+	const size_t first = line * COLUMNS;
+	auto changed = [&](unsigned int column) { return column < COLUMNS && target[first + column] != shown[first + column]; };
+
+	unsigned int cursor = COLUMNS + 1; // Not known, the address counter is somewhere else after the previous line
+
+	for (unsigned int column = 0; column < COLUMNS; )
+	{
+		if (!changed(column))
+		{
+			column++;
+			continue;
+		}
+
+		if (cursor != column)
+		{
+			appendInstruction(bytes, SET_DDRAM_ADDRESS | (LINE_ADDRESS[line] + column));
+		}
+
+		// The address counter increments after every character. An unchanged cell between two changed
+		// ones is rewritten: that costs as many bytes as a cursor move and keeps the run going.
+		while (changed(column) || changed(column + 1))
+		{
+			appendCharacter(bytes, target[first + column]);
+			column++;
+		}
+		cursor = column;
+	}
+}
+
+bool HD44780_Display::send(const std::vector<uint8_t>& bytes, unsigned int transactionGap_us)
+{
+	const bool written = m_pDevice->Write(bytes.data(), bytes.size());
+
+	if (transactionGap_us > 0)
+	{
+		m_pDevice->Delay_us(transactionGap_us);
+	}
+
+	return written;
+}
+
+void HD44780_Display::appendInstruction(std::vector<uint8_t>& bytes, uint8_t instruction)
+{
+	appendNibble(bytes, instruction & 0xF0, 0);
+	appendNibble(bytes, instruction << 4, 0);
+}
+
+void HD44780_Display::appendCharacter(std::vector<uint8_t>& bytes, char character)
+{
+	const uint8_t rawCharacter = static_cast<uint8_t>(character);
+	appendNibble(bytes, rawCharacter & 0xF0, REGISTER_SELECT);
+	appendNibble(bytes, rawCharacter << 4, REGISTER_SELECT);
+}
+
+void HD44780_Display::appendNibble(std::vector<uint8_t>& bytes, uint8_t nibble, uint8_t flags)
+{
+	// The controller latches D4..D7 on the falling edge of E; the data is already stable while E is high
+	nibble &= 0xF0;
+	bytes.push_back(nibble | BACKLIGHT | flags | ENABLE);
+	bytes.push_back(nibble | BACKLIGHT | flags);
+}
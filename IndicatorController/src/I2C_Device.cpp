@@ -0,0 +1,60 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "I2C_Device.hpp"
+
+#include <string>
+#include <unistd.h>
+
+#include <pigpio.h>
+
+#include "Kernel.hpp"
+
+PigpioI2C_Device::PigpioI2C_Device(unsigned int i2c_bus, unsigned int i2c_address)
+	: m_handle(i2cOpen(i2c_bus, i2c_address, 0))
+{
+	if (m_handle < 0)
+	{
+		Kernel::Fatal_Error("Error while trying to open I2C device " + std::to_string(i2c_address) + " on bus " + std::to_string(i2c_bus) + ". Error: " + std::to_string(m_handle));
+	}
+}
+
+PigpioI2C_Device::~PigpioI2C_Device()
+{
+	if (m_handle >= 0)
+	{
+		i2cClose(m_handle);
+	}
+}
+
+bool PigpioI2C_Device::Write(const uint8_t* data, size_t length)
+{
+	// i2cWriteDevice sends the bytes raw, without the register byte of the SMBus block calls
+	return i2cWriteDevice(m_handle, const_cast<char*>(reinterpret_cast<const char*>(data)), length) == 0;
+}
+
+void PigpioI2C_Device::Delay_us(unsigned int time_us)
+{
+	usleep(time_us);
+}
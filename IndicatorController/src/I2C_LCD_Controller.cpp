@@ -24,38 +24,36 @@
 
 #include "I2C_LCD_Controller.hpp"
 
-#include <unistd.h>
-
-#include <pigpio.h>
-
 #include "Kernel.hpp"
 #include "propertiesclass.h"
 
 
-const uint8_t I2C_LCD::m_i2c_lcd_address = GlobalProperties::Get().LCD_I2C_ADDRESS;
 const unsigned int defaultMessageLingerTime_ms = GlobalProperties::Get().LCD_DEFULT_MSG_DISPLAY_TIME_MS;
-const unsigned int interCommandWaitTime_us = GlobalProperties::Get().LCD_INTER_COMMANDS_WAIT_TIME_US;
 
-I2C_LCD::I2C_LCD(unsigned int i2c_bus)
-	: m_i2c_bus(i2c_bus),
-	m_i2c_device_handle(-1),
-	m_messageLingerTime_ms(defaultMessageLingerTime_ms),
-	m_idleMessage(m_PREDEFINED_defaultIdleMessage),
+I2C_LCD::I2C_LCD(unsigned int i2c_bus, unsigned int i2c_address)
+	: m_messageLingerTime_ms(defaultMessageLingerTime_ms),
+	m_bDefaultIdleMessage(true),
+	m_bTemporaryMessageShown(false),
 	m_messageTimer("LCD_Screen_" + std::to_string(std::rand()%1000)), // TODO? rand name
-	m_pTimerTimeoutCallback(nullptr)
+	m_pTimerTimeoutCallback(nullptr),
+	m_pOwnedDevice(new PigpioI2C_Device(i2c_bus, i2c_address)),
+	m_display(m_pOwnedDevice.get(), GlobalProperties::Get().LCD_INTER_COMMANDS_WAIT_TIME_US)
 {
-	
-	m_i2c_device_handle = i2cOpen(m_i2c_bus, m_i2c_lcd_address, 0);
+	initializeTimer();
 
-	if (m_i2c_device_handle < 0)
-	{
-		Kernel::Fatal_Error("Error while trying to open LCD I2C device. Device handle: " + std::to_string(m_i2c_device_handle));
-	}
+	ClearDisplayAndDisplayDefaultMsg();
+}
 
+I2C_LCD::I2C_LCD(I_I2C_Device* pDevice)
+	: m_messageLingerTime_ms(defaultMessageLingerTime_ms),
+	m_bDefaultIdleMessage(true),
+	m_bTemporaryMessageShown(false),
+	m_messageTimer("LCD_Screen_" + std::to_string(std::rand()%1000)),
+	m_pTimerTimeoutCallback(nullptr),
+	m_display(pDevice, GlobalProperties::Get().LCD_INTER_COMMANDS_WAIT_TIME_US)
+{
 	initializeTimer();
 
-	initializeLCD();
-
 	ClearDisplayAndDisplayDefaultMsg();
 }
 
@@ -69,30 +67,40 @@ void I2C_LCD::initializeTimer()
 
 I2C_LCD::~I2C_LCD()
 {
-	i2cClose(m_i2c_device_handle);
+	m_messageTimer.Stop();
 	delete m_pTimerTimeoutCallback;
 }
 
 void I2C_LCD::ClearDisplay()
 {
 	m_messageTimer.Stop();
-	SendCommand(enuCommands::clearDisplay_cmd);
+	m_bTemporaryMessageShown = false;
+	PutToLCD("");
 }
 
 void I2C_LCD::ClearDisplayAndDisplayDefaultMsg()
 {
-	m_idleMessage = m_PREDEFINED_defaultIdleMessage;
 	ClearDisplay();
-	PutToLCD_Permanently(m_idleMessage);
+	m_bDefaultIdleMessage = true;
+	showIdleMessage();
+}
+
+void I2C_LCD::RefreshDefaultMsg()
+{
+	if (m_bDefaultIdleMessage && !m_bTemporaryMessageShown)
+	{
+		showIdleMessage();
+	}
 }
 
 void I2C_LCD::SetMessageLingerTime_ms(unsigned int messageLingerTime_ms, const std::string& idleMessage)
 {
 	m_messageLingerTime_ms = messageLingerTime_ms;
 
-	if (idleMessage != DEFAULT_IDLE_MSG)
+	if (!idleMessage.empty())
 	{
 		m_idleMessage = idleMessage;
+		m_bDefaultIdleMessage = false;
 	}
 
 }
@@ -100,6 +108,7 @@ void I2C_LCD::SetMessageLingerTime_ms(unsigned int messageLingerTime_ms, const s
 void I2C_LCD::PutToLCD_wTimeout(const std::string& message)
 {
 	m_messageTimer.Stop();
+	m_bTemporaryMessageShown = true;
 	PutToLCD(message);
 	m_messageTimer.Start(); // Timer to clearScreen
 }
@@ -107,135 +116,31 @@ void I2C_LCD::PutToLCD_wTimeout(const std::string& message)
 void I2C_LCD::PutToLCD_Permanently(const std::string& message)
 {
 	m_messageTimer.Stop();
+	m_bTemporaryMessageShown = false;
 
 	// So that message can be brought back after any temporary message
 	m_idleMessage = message;
+	m_bDefaultIdleMessage = false;
 
 	PutToLCD(message);
 }
 
-void I2C_LCD::SendCommand(enuCommands command)
-{
-	SendUpperNibbleCommand(command);
-	SendUpperNibbleCommand(command << 4);
-}
-
-void I2C_LCD::SendCharacter(char character)
-{
-	uint8_t rawCharacter = (uint8_t)character;
-
-	/*
-	std::stringstream stream;
-	stream << "Character:"  << character << " == " << std::uppercase << std::setw(2) << std::setfill('0') << std::hex << (int)rawCharacter;
-	Kernel::Trace(stream.str());
-	*/
-
-	SendUpperNibbleData(rawCharacter);
-	SendUpperNibbleData(rawCharacter << 4);
-}
-
-void I2C_LCD::SendUpperNibbleCommand(uint8_t rawData)
-{
-	rawData &= 0xF0; // set lower nibble to 0
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::command);
-	usleep(interCommandWaitTime_us);
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::command | enuFlags::enable);
-	usleep(interCommandWaitTime_us);
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::command);
-	usleep(interCommandWaitTime_us);
-}
-
-void I2C_LCD::SendUpperNibbleData(uint8_t rawData)
-{
-	rawData &= 0xF0; // set lower nibble to 0
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::data);
-	usleep(interCommandWaitTime_us);
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::data | enuFlags::enable);
-	usleep(interCommandWaitTime_us);
-
-	i2cWriteByte(m_i2c_device_handle, rawData | enuFlags::backlight | enuFlags::data);
-	usleep(interCommandWaitTime_us);
-}
-
-void I2C_LCD::initializeLCD()
-{
-	const uint8_t initSequence[14] =
-	{
-	  0x30,
-	  0x30,
-	  0x30,
-	  0x20,
-	  0x20,
-	  0x80,
-	  0x00,
-	  0xC0,
-	  0x00,
-	  0x10,
-	  0x00,
-	  0x60,
-	  0x00,
-	  0x20,
-	};
-
-	for (size_t i = 0; i < sizeof(initSequence) / sizeof(uint8_t); i++)
-	{
-		SendUpperNibbleCommand(initSequence[i]);
-	}
-}
-
-void I2C_LCD::goToSecondLine()
-{
-	SendCommand(enuCommands::cursorHome_cmd);
-
-	const int charsFromBeginningToNewLine = 40;
-	for (int i = 0; i < charsFromBeginningToNewLine; i++)
-	{
-		SendCommand(enuCommands::shiftCursorRight_cmd);
-	}
-}
-
 void I2C_LCD::clearDisplay_TimerCallback(void* uu)
 {
 	ClearDisplay();
-	PutToLCD_Permanently(m_idleMessage);
+	showIdleMessage();
 	
 }
 
-void I2C_LCD::PutToLCD(const std::string& message)
+void I2C_LCD::showIdleMessage()
 {
-	std::string firstLine = message;
-	std::string secondLine = "";
-
-	const int charsPerLine = 16;
-	if (firstLine.length() > charsPerLine)
-	{
-		firstLine = message.substr(0, charsPerLine);
-
-		const int charactersLeft = message.length() - charsPerLine;
-
-		secondLine = message.substr(charsPerLine, std::max(charactersLeft, charsPerLine));
-	}
-
-	ClearDisplay();
-
-
-	for (auto& character : firstLine)
-	{
-		SendCharacter(character);
-	}
-
-	if (secondLine != "")
-	{
-		goToSecondLine();
+	// Current config value, so a reloaded config.xml changes the default message
+	PutToLCD(m_bDefaultIdleMessage ? GlobalProperties::Get().LCD_DEFAULT_IDLE_MESSAGE : m_idleMessage);
+}
 
-		for (auto& character : secondLine)
-		{
-			SendCharacter(character);
-		}
-	}
-}
\ No newline at end of file
+void I2C_LCD::PutToLCD(const std::string& message)
+{
+	// Fetched per message so a reloaded config takes effect immediately
+	m_display.setTransactionGap_us(GlobalProperties::Get().LCD_INTER_COMMANDS_WAIT_TIME_US);
+	m_display.Show(message);
+}
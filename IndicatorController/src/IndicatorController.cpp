@@ -26,6 +26,11 @@
 
 #include "Kernel.hpp"
 
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 // const std::string SERVER_SUFFIX = ".identifier.s";
 // const std::string CLIENT_SUFFIX = ".identifier.c";
 const std::string SERVER_SUFFIX = GlobalProperties::Get().INDICATORS_MB_SERVER_SUFFIX;
@@ -60,7 +65,7 @@ void IndicatorController_Client::BuzzerSuccess()
 void IndicatorController_Client::BuzzerFailure()
 {
 	InputParameter command(InputParameter::BuzzerError);
-	sendConnectionlessRequest(command);
+	sendConnectionlessRequest(command, true);
 }
 
 void IndicatorController_Client::LCD_Clear()
@@ -90,14 +95,20 @@ void IndicatorController_Client::LCD_Put_wTimeout(const std::string& message)
 void IndicatorController_Client::OpenDoor_wBuzzerSuccess()
 {
 	InputParameter command(InputParameter::DoorOpen_wBuzzerSuccess);
-	sendConnectionlessRequest(command);
+	sendConnectionlessRequest(command, true);
 }
 
-void IndicatorController_Client::sendConnectionlessRequest(const InputParameter& command)
+void IndicatorController_Client::sendConnectionlessRequest(const InputParameter& command, bool bWithTrace)
 {
 	CommandMessage message(CommandMessage::enuCommand::NONE);
 	message.addParameter(command);
 
+	if (bWithTrace && !m_trace.empty())
+	{
+		message.setTrace(m_trace);
+		m_trace.clear();
+	}
+
 	m_mailbox.sendConnectionless(m_refServer, &message);
 
 	*m_pLogger << "Sent Connectionless: " + command.getInfo();
@@ -122,14 +133,49 @@ IndicatorController_Server::IndicatorController_Server(
 	:
 	m_pLogger(pLogger),
 	m_mailbox(identifier + SERVER_SUFFIX),
-	m_buzzer(pinout.m_buzzerPin_BCM),
-	m_door(pinout.m_doorPin_BCM, pinout.m_doorOpenTime_ms),
-	m_lcd(pinout.m_lcd_i2c_bus)
+	m_pOwnedGpio(new PigpioGPIO_Port()),
+	m_buzzer(m_pOwnedGpio.get(), pinout.m_buzzerPin_BCM, pinout.m_ledPin_BCM),
+	m_door(m_pOwnedGpio.get(), pinout.m_doorPin_BCM),
+	m_lcd(pinout.m_lcd_i2c_bus, pinout.m_lcd_i2c_address),
+	m_traceSocket(-1)
 {
 	if (m_pLogger == nullptr)
 	{
 		m_pLogger = NulLogger::getInstance();
 	}
+
+	openTraceSocket();
+}
+
+IndicatorController_Server::IndicatorController_Server(
+	const std::string& identifier,
+	const Pinout& pinout,
+	I_GPIO_Port* pGpio,
+	I_I2C_Device* pLcdDevice,
+	ILogger* pLogger
+)
+	:
+	m_pLogger(pLogger),
+	m_mailbox(identifier + SERVER_SUFFIX),
+	m_buzzer(pGpio, pinout.m_buzzerPin_BCM, pinout.m_ledPin_BCM),
+	m_door(pGpio, pinout.m_doorPin_BCM),
+	m_lcd(pLcdDevice),
+	m_traceSocket(-1)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	openTraceSocket();
+}
+
+IndicatorController_Server::~IndicatorController_Server()
+{
+	if (m_traceSocket >= 0)
+	{
+		close(m_traceSocket);
+	}
 }
 
 void IndicatorController_Server::BuzzerPing()
@@ -162,6 +208,11 @@ void IndicatorController_Server::LCD_Clear_wDefaultMsg()
 	*m_pLogger << "Clear_wDeafultMsg!";
 }
 
+void IndicatorController_Server::LCD_RefreshDefaultMsg()
+{
+	m_lcd.RefreshDefaultMsg();
+}
+
 void IndicatorController_Server::LCD_Put_Permanently(const std::string& message)
 {
 	m_lcd.PutToLCD_Permanently(message);
@@ -177,8 +228,8 @@ void IndicatorController_Server::LCD_Put_wTimeout(const std::string& message)
 void IndicatorController_Server::OpenDoor_wBuzzerSuccess()
 {
 	*m_pLogger << "Doors open w buzzer!";
-	m_buzzer.SignalSuccess();
 	m_door.OpenDoors();
+	m_buzzer.SignalSuccess();
 }
 
 void IndicatorController_Server::ParseRequest(const InputParameter& request)
@@ -239,11 +290,65 @@ void IndicatorController_Server::ListenAndParseRequest(unsigned int timeout_ms)
 	*m_pLogger << "Received request from: " + pParsedMessage->getSource().getName();
 
 	const InputParameter& requestParameter = getParameter(pParsedMessage);
+
+	LatencyTrace& trace = pParsedMessage->getTrace();
+	if (!trace.empty())
+	{
+		trace.Mark(LatencyTrace::INDICATOR_RECEIVED);
+	}
+
 	ParseRequest(requestParameter);
 
+	if (!trace.empty())
+	{
+		trace.Mark(LatencyTrace::INDICATOR_DONE);
+		sendTrace(trace, requestParameter.getType());
+	}
+
 	delete pMessage;
 }
 
+void IndicatorController_Server::openTraceSocket()
+{
+	if (GlobalProperties::Get().LATENCY_TRACE_SOCKET.empty())
+	{
+		return;
+	}
+
+	m_traceSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (m_traceSocket < 0)
+	{
+		*m_pLogger << "IndicatorController - could not create the latency trace socket: " + std::string(strerror(errno));
+		Kernel::Warning("IndicatorController - could not create the latency trace socket: " + std::string(strerror(errno)));
+	}
+}
+
+void IndicatorController_Server::sendTrace(const LatencyTrace& trace, InputParameter::enuType request)
+{
+	if (m_traceSocket < 0)
+	{
+		return;
+	}
+
+	const std::string& path = GlobalProperties::Get().LATENCY_TRACE_SOCKET;
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	char datagram[sizeof(request) + sizeof(byte) + LatencyTrace::MAX_STAMPS * (sizeof(byte) + sizeof(int64_t))];
+	memcpy(datagram, &request, sizeof(request));
+	trace.writeSerializedDataToBuffer(datagram + sizeof(request));
+
+	// Never blocks the indicators: without a listener the trace is dropped
+	size_t datagramSize = sizeof(request) + trace.getSerializedSize();
+	if (sendto(m_traceSocket, datagram, datagramSize, MSG_DONTWAIT, (const sockaddr*)&address, sizeof(address)) < 0)
+	{
+		*m_pLogger << "IndicatorController - latency trace dropped: " + std::string(strerror(errno));
+	}
+}
+
 CommandMessage* IndicatorController_Server::castToAppropriateType(DataMailboxMessage* pMessage)
 {
 	if (pMessage->getDataType() == MessageDataType::enuType::DataMailboxErrorMessage) // TimedOut! TODO???
@@ -282,4 +387,41 @@ const InputParameter IndicatorController_Server::getParameter(CommandMessage* pM
 	}
 
 	return pMessage->getParameterAt(0);
-}
\ No newline at end of file
+}
+
+
+DoorIndicators::DoorIndicators(ILogger* pLogger)
+	:	m_pLogger(pLogger)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+}
+
+void DoorIndicators::AddDoor(DoorId doorId, const std::string& baseName)
+{
+	m_clients[doorId].reset(new IndicatorController_Client(MailboxName(baseName, doorId), m_pLogger));
+}
+
+IndicatorController_Client* DoorIndicators::get(DoorId doorId) const
+{
+	if (m_clients.empty())
+	{
+		*m_pLogger << "DoorIndicators - no doors added!";
+		Kernel::Fatal_Error("DoorIndicators - no doors added!");
+	}
+
+	auto client = m_clients.find(doorId);
+	if (client == m_clients.end())
+	{
+		return m_clients.begin()->second.get();
+	}
+
+	return client->second.get();
+}
+
+std::string DoorIndicators::MailboxName(const std::string& baseName, DoorId doorId)
+{
+	return baseName + "." + std::to_string(doorId);
+}
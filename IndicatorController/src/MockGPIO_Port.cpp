@@ -0,0 +1,91 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MockGPIO_Port.hpp"
+
+MockGPIO_Port::MockGPIO_Port(unsigned int maxPinBCM, bool recordEdges)
+	: m_maxPinBCM(maxPinBCM),
+	m_recordEdges(recordEdges),
+	m_writeCount(0)
+{
+}
+
+bool MockGPIO_Port::SetOutput(unsigned int pinBCM, Pull pull)
+{
+	if (pinBCM > m_maxPinBCM)
+	{
+		return false;
+	}
+
+	// A floating output reads as its pull until it is written
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_levels[pinBCM] = (pull == Pull::UP);
+	return true;
+}
+
+void MockGPIO_Port::Write(unsigned int pinBCM, bool high)
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_writeCount++;
+
+	auto level = m_levels.find(pinBCM);
+	if (level != m_levels.end() && level->second == high)
+	{
+		return;
+	}
+
+	m_levels[pinBCM] = high;
+	if (m_recordEdges)
+	{
+		m_edges.push_back(Edge{ pinBCM, high, now });
+	}
+}
+
+std::vector<MockGPIO_Port::Edge> MockGPIO_Port::getEdges() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_edges;
+}
+
+void MockGPIO_Port::clearEdges()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_edges.clear();
+	m_writeCount = 0;
+}
+
+bool MockGPIO_Port::isHigh(unsigned int pinBCM) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto level = m_levels.find(pinBCM);
+	return level != m_levels.end() && level->second;
+}
+
+unsigned long MockGPIO_Port::getWriteCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_writeCount;
+}
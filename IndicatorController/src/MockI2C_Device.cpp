@@ -0,0 +1,198 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MockI2C_Device.hpp"
+
+#include <cstring>
+
+namespace
+{
+	const uint8_t REGISTER_SELECT = 0x01;
+	const uint8_t ENABLE = 0x04;
+
+	const double INSTRUCTION_TIME_US = 37;
+	const double CLEAR_OR_HOME_TIME_US = 1520;
+	const double FIRST_RESET_TIME_US = 4100;
+	const double RESET_TIME_US = 100;
+
+	// Start, address byte with ACK, stop
+	const unsigned int TRANSACTION_OVERHEAD_BITS = 1 + 9 + 1;
+}
+
+MockI2C_Device::MockI2C_Device(unsigned int clock_Hz)
+	: m_bitTime_us(1e6 / clock_Hz),
+	m_now_us(0),
+	m_address(0),
+	m_eightBitMode(true),
+	m_highNibblePending(false),
+	m_highNibble(0),
+	m_enable(false),
+	m_resetStep(0),
+	m_busyUntil_us(0)
+{
+	std::memset(m_ddram, ' ', sizeof(m_ddram));
+	resetStats();
+}
+
+bool MockI2C_Device::Write(const uint8_t* data, size_t length)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stats.transactions++;
+	m_stats.bytes += length;
+
+	// The expander changes its outputs at the acknowledge of every data byte
+	double time_us = m_now_us + (1 + 9) * m_bitTime_us;
+	for (size_t i = 0; i < length; i++)
+	{
+		time_us += 9 * m_bitTime_us;
+		latch(data[i], time_us);
+	}
+
+	const double duration_us = (TRANSACTION_OVERHEAD_BITS + 9 * length) * m_bitTime_us;
+	m_now_us += duration_us;
+	m_stats.time_us += duration_us;
+	return true;
+}
+
+void MockI2C_Device::Delay_us(unsigned int time_us)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_now_us += time_us;
+	m_stats.time_us += time_us;
+}
+
+MockI2C_Device::Stats MockI2C_Device::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void MockI2C_Device::resetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = Stats{ 0, 0, 0, 0 };
+}
+
+std::string MockI2C_Device::getLine(unsigned int line) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const uint8_t* pLine = &m_ddram[line == 0 ? 0x00 : 0x40];
+	return std::string(pLine, pLine + 16);
+}
+
+void MockI2C_Device::latch(uint8_t outputs, double time_us)
+{
+	const bool enable = (outputs & ENABLE) != 0;
+	const bool fallingEdge = m_enable && !enable;
+	m_enable = enable;
+
+	if (!fallingEdge)
+	{
+		return;
+	}
+
+	const uint8_t nibble = outputs & 0xF0;
+	const bool isData = (outputs & REGISTER_SELECT) != 0;
+
+	if (m_eightBitMode)
+	{
+		// D0..D3 are not connected, so they read as 0
+		execute(isData, nibble, time_us);
+		return;
+	}
+
+	if (!m_highNibblePending)
+	{
+		m_highNibble = nibble;
+		m_highNibblePending = true;
+		return;
+	}
+
+	m_highNibblePending = false;
+	execute(isData, m_highNibble | (nibble >> 4), time_us);
+}
+
+void MockI2C_Device::execute(bool isData, uint8_t value, double time_us)
+{
+	if (time_us < m_busyUntil_us)
+	{
+		m_stats.timingViolations++;
+	}
+
+	double executionTime_us = INSTRUCTION_TIME_US;
+
+	if (isData)
+	{
+		m_ddram[m_address] = value;
+		advanceAddress(true);
+	}
+	else if (value & 0x80)
+	{
+		m_address = value & 0x7F;
+	}
+	else if (value & 0x20)
+	{
+		// Function set; the first three of the reset sequence need extra time
+		if (m_eightBitMode && m_resetStep < 3)
+		{
+			executionTime_us = m_resetStep == 0 ? FIRST_RESET_TIME_US : RESET_TIME_US;
+			m_resetStep++;
+		}
+		m_eightBitMode = (value & 0x10) != 0;
+	}
+	else if (value & 0x10)
+	{
+		if ((value & 0x08) == 0)	// Cursor shift, display shift is not modeled
+		{
+			advanceAddress((value & 0x04) != 0);
+		}
+	}
+	else if (value & 0x02)
+	{
+		m_address = 0;
+		executionTime_us = CLEAR_OR_HOME_TIME_US;
+	}
+	else if (value & 0x01)
+	{
+		std::memset(m_ddram, ' ', sizeof(m_ddram));
+		m_address = 0;
+		executionTime_us = CLEAR_OR_HOME_TIME_US;
+	}
+
+	m_busyUntil_us = time_us + executionTime_us;
+}
+
+void MockI2C_Device::advanceAddress(bool increment)
+{
+	// Two line mode: 0x00..0x27 and 0x40..0x67, wrapping from one line to the other
+	if (increment)
+	{
+		m_address = (m_address == 0x27) ? 0x40 : (m_address == 0x67 ? 0x00 : m_address + 1);
+	}
+	else
+	{
+		m_address = (m_address == 0x40) ? 0x27 : (m_address == 0x00 ? 0x67 : m_address - 1);
+	}
+}
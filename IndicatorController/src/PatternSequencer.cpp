@@ -0,0 +1,178 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "PatternSequencer.hpp"
+
+#include <algorithm>
+
+PatternSequencer::PatternSequencer(I_GPIO_Port* pGpio)
+	: m_pGpio(pGpio),
+	m_step(0),
+	m_playing(false),
+	m_generation(0),
+	m_stop(false),
+	m_activeOutputs(0)
+{
+	m_thread = std::thread(&PatternSequencer::run, this);
+}
+
+PatternSequencer::~PatternSequencer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+	m_thread.join();
+}
+
+bool PatternSequencer::AddOutput(SignalPattern::Output output, unsigned int pinBCM, bool activeHigh, I_GPIO_Port::Pull pull)
+{
+	if (!m_pGpio->SetOutput(pinBCM, pull))
+	{
+		return false;
+	}
+
+	m_pGpio->Write(pinBCM, !activeHigh);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pins.push_back(Pin{ output, pinBCM, activeHigh });
+	return true;
+}
+
+PatternSequencer::PlayResult PatternSequencer::Play(const SignalPattern& pattern)
+{
+	PlayResult result;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_playing || pattern.priority >= m_current.priority)
+		{
+			start(pattern, Clock::now());
+			result = PlayResult::STARTED;
+		}
+		else
+		{
+			result = enqueue(pattern) ? PlayResult::QUEUED : PlayResult::DROPPED;
+		}
+	}
+	m_changed.notify_one();
+	return result;
+}
+
+void PatternSequencer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.clear();
+		m_playing = false;
+		m_generation++;
+	}
+	m_changed.notify_one();
+}
+
+bool PatternSequencer::WaitUntilIdle(unsigned int timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_idle.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return !m_playing && m_activeOutputs == 0; });
+}
+
+void PatternSequencer::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		if (!m_playing)
+		{
+			apply(0);
+			m_idle.notify_all();
+			m_changed.wait(lock, [this]() { return m_stop || m_playing; });
+			continue;
+		}
+
+		const unsigned long generation = m_generation;
+		apply(m_current.steps[m_step].outputs);
+
+		if (m_changed.wait_until(lock, m_stepEnd, [this, generation]() { return m_stop || m_generation != generation; }))
+		{
+			continue;
+		}
+
+		// Next step starts at the deadline of this one, not at the time the thread woke up
+		if (++m_step < m_current.steps.size())
+		{
+			m_stepEnd += std::chrono::milliseconds(m_current.steps[m_step].duration_ms);
+		}
+		else if (!m_queue.empty())
+		{
+			const SignalPattern next = m_queue.front();
+			m_queue.pop_front();
+			start(next, m_stepEnd);
+		}
+		else
+		{
+			m_playing = false;
+		}
+	}
+
+	apply(0);
+}
+
+void PatternSequencer::start(const SignalPattern& pattern, Clock::time_point startTime)
+{
+	m_current = pattern;
+	m_step = 0;
+	m_stepEnd = startTime + std::chrono::milliseconds(pattern.steps.empty() ? 0 : pattern.steps.front().duration_ms);
+	m_playing = !pattern.steps.empty();
+	m_generation++;
+}
+
+bool PatternSequencer::enqueue(const SignalPattern& pattern)
+{
+	auto position = std::find_if(m_queue.begin(), m_queue.end(), [&pattern](const SignalPattern& queued) { return queued.priority < pattern.priority; });
+	if (m_queue.size() >= MAX_QUEUED && position == m_queue.end())
+	{
+		return false;
+	}
+
+	m_queue.insert(position, pattern);
+	if (m_queue.size() > MAX_QUEUED)
+	{
+		m_queue.pop_back();
+	}
+	return true;
+}
+
+void PatternSequencer::apply(unsigned int outputs)
+{
+	const unsigned int changed = outputs ^ m_activeOutputs;
+	for (const Pin& pin : m_pins)
+	{
+		if (changed & pin.output)
+		{
+			const bool active = (outputs & pin.output) != 0;
+			m_pGpio->Write(pin.pinBCM, active == pin.activeHigh);
+		}
+	}
+	m_activeOutputs = outputs;
+}
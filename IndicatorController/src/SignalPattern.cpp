@@ -0,0 +1,123 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SignalPattern.hpp"
+
+#include <sstream>
+
+namespace
+{
+	const struct { const char* name; SignalPattern::Output output; } OUTPUT_NAMES[] =
+	{
+		{ "buzzer", SignalPattern::BUZZER },
+		{ "led", SignalPattern::LED },
+		{ "door", SignalPattern::DOOR }
+	};
+
+	bool parseOutputs(const std::string& text, unsigned int& outputs)
+	{
+		outputs = 0;
+		if (text == "-")
+		{
+			return true;
+		}
+
+		std::stringstream names(text);
+		std::string name;
+		while (std::getline(names, name, '+'))
+		{
+			bool known = false;
+			for (const auto& output : OUTPUT_NAMES)
+			{
+				if (name == output.name)
+				{
+					outputs |= output.output;
+					known = true;
+				}
+			}
+
+			if (!known)
+			{
+				return false;
+			}
+		}
+
+		// getline() does not report a trailing '+'
+		return !text.empty() && text.back() != '+';
+	}
+
+	bool parseDuration(const std::string& text, unsigned int& duration_ms)
+	{
+		if (text.empty() || text.size() > 5 || text.find_first_not_of("0123456789") != std::string::npos)
+		{
+			return false;
+		}
+
+		duration_ms = std::stoul(text);
+		return duration_ms > 0 && duration_ms <= SignalPattern::MAX_STEP_DURATION_MS;
+	}
+}
+
+unsigned int SignalPattern::Duration_ms() const
+{
+	unsigned int duration_ms = 0;
+	for (const SignalStep& step : steps)
+	{
+		duration_ms += step.duration_ms;
+	}
+	return duration_ms;
+}
+
+bool SignalPattern::Parse(const std::string& text, unsigned int priority, SignalPattern& pattern, std::string& error)
+{
+	SignalPattern parsed;
+	parsed.priority = priority;
+
+	std::stringstream stream(text);
+	std::string token;
+	while (stream >> token)
+	{
+		const size_t separator = token.rfind(':');
+
+		SignalStep step;
+		if (separator == std::string::npos
+			|| !parseOutputs(token.substr(0, separator), step.outputs)
+			|| !parseDuration(token.substr(separator + 1), step.duration_ms))
+		{
+			error = "invalid step \"" + token + "\"";
+			return false;
+		}
+
+		parsed.steps.push_back(step);
+	}
+
+	if (parsed.steps.empty())
+	{
+		error = "pattern has no steps";
+		return false;
+	}
+
+	pattern = parsed;
+	return true;
+}
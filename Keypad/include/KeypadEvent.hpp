@@ -0,0 +1,86 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef KEYPAD_EVENT_HPP
+#define KEYPAD_EVENT_HPP
+
+#include<string>
+
+#include"pipe.hpp"
+
+/**
+ * @brief Typed keypad output
+ *
+ * Sent through the keypad FIFO as one `PipeMessage` frame, e.g. type `KeypadData`
+ * with data "*1234" for a PIN entry.
+ */
+class KeypadEvent
+{
+public:
+
+    typedef enum : unsigned char
+    {
+        Invalid   = PipeMessage::Empty,
+        Data      = PipeMessage::KeypadData,        ///< Buffered characters, flushed by Enter or when the buffer is full
+        Enter     = PipeMessage::KeypadEnter,       ///< Enter pressed with an empty buffer
+        Backspace = PipeMessage::KeypadBackspace,   ///< Backspace pressed with an empty buffer
+        Reset     = PipeMessage::KeypadReset        ///< Backspace and Enter held together - buffer discarded
+    } enuType;
+
+    KeypadEvent()
+        : m_type(Invalid), m_data("")
+    {}
+
+    KeypadEvent(enuType type, const std::string& data = "")
+        : m_type(type), m_data(data)
+    {}
+
+    enuType getType() const { return m_type; }
+    const std::string& getData() const { return m_data; }
+
+    /// Frame sent through the keypad FIFO
+    PipeMessage toPipeMessage() const { return PipeMessage((PipeMessage::enuType)m_type, m_data); }
+
+    /// Inverse of `toPipeMessage()`. Returns an `Invalid` event for messages which are not keypad events.
+    static KeypadEvent fromPipeMessage(const PipeMessage& message)
+    {
+        switch (message.getType())
+        {
+        case PipeMessage::KeypadData:
+        case PipeMessage::KeypadEnter:
+        case PipeMessage::KeypadBackspace:
+        case PipeMessage::KeypadReset:
+            return KeypadEvent((enuType)message.getType(), message.getData());
+
+        default:
+            return KeypadEvent();
+        }
+    }
+
+private:
+    enuType m_type;
+    std::string m_data;
+};
+
+#endif
@@ -26,31 +26,13 @@
 #define KEYPAD_PROTO_HPP
 
 #include<string>
+#include<bitset>
+#include<linux/input.h>
 
 #include"pipe.hpp"
 #include"NulLogger.hpp"
 #include"propertiesclass.h"
-
-
-
-#define CHARACTER_MAP_OFFSET 69
-char characterMap[] = {
-    'N', // KEY_NUMLOCK
-    'S', // KEY_SCROLLLOCK
-    '7', // KEY_KP7
-    '8', // KEY_KP8
-    '9', // KEY_KP9
-    '-', // KEY_KPMINUS
-    '4', // KEY_KP4
-    '5', // KEY_KP5
-    '6', // KEY_KP6
-    '+', // KEY_KPPLUS
-    '1', // KEY_KP1
-    '2', // KEY_KP2
-    '3', // KEY_KP3
-    '0', // KEY_KP0
-    '.'  // KEY_KPDOT
-    };
+#include"KeypadEvent.hpp"
 
 
 
@@ -78,17 +60,41 @@ release, 1 for keypress and 2 for autorepeat.
 
 typedef struct input_event IEVENT;
 
+/**
+ * @brief Numeric keypad (evdev device) which sends typed `KeypadEvent`s to the output pipe
+ *
+ * The device is waited on with epoll and every wakeup drains all pending `input_event`s
+ * in batches of `EVENT_BATCH_SIZE`, so a key press is handled as soon as the kernel reports it.
+ * Autorepeat events are ignored (holding a key never enters the same digit twice).
+ * Pressing Backspace and Enter together, in either order, is a chord which discards the buffer and sends `KeypadEvent::Reset`.
+ * Enter therefore takes effect when it is released, or earlier when another key is pressed while it is held.
+ */
 class Keypad
 {
 private:
-// const static uint        m_buffer_size   = BUFFER_SIZE;
     const static uint        m_buffer_size;
+    const static size_t      EVENT_BATCH_SIZE = 64;
+
              std::string m_buffer                     ;
              Pipe*       m_pOutputPipe                ;
              ILogger*    m_pLogger       = NULL       ;
-             FILE*       keypadFile      = NULL       ;
              int         m_keypadFile_fd = -1         ;
-             IEVENT*     input_event     = NULL       ;
+             int         m_epoll_fd      = -1         ;
+             int         m_wakeup_fd     = -1         ;
+             bool        m_deviceLost    = false      ;
+             IEVENT      m_events[EVENT_BATCH_SIZE]   ;
+
+    /// Keys currently held down, indexed by key code
+    std::bitset<KEY_CNT> m_pressedKeys;
+
+    /// Set when a chord fired; further presses are ignored until every key is released
+    bool m_chordActive = false;
+
+    /// Set while Enter is held and has not taken effect yet, so Backspace can still turn it into a chord
+    bool m_enterPending = false;
+
+    /// Opens epoll and the wakeup eventfd, registers `m_keypadFile_fd`
+    void initialize(const std::string& keypadName);
 
     /// Appends `x` to the internal buffer
     inline void appendChar         (char x);
@@ -99,14 +105,23 @@ private:
     /// Flushes (sends) the internal buffer to the output pipe
     inline void flushBuffer        (void);
 
-           /// Decodes char from the last `input_event` and appends it to the internal buffer
-           void decodeChar         (void);
+           /// Sends `event` to the output pipe
+           void sendEvent          (const KeypadEvent& event);
+
+           /// Reads every pending `input_event` from the device. Returns false if the device is gone.
+           bool drainEvents        (void);
+
+           /// Updates key state for one `input_event` and decodes key presses
+           void processEvent       (const IEVENT& event);
+
+           /// Decodes the pressed key `code` and appends it to the internal buffer
+           void decodeKey          (unsigned short code);
+
+           /// Flushes the buffer, or sends `KeypadEvent::Enter` if it is empty
+           void submitEnter        (void);
 
            /// If buffer size reaches max specified size, flushes it to the output
            void checkBufferOverflow(void);
-
-           /// Sends ENTER or BACKSPACE strings
-           void sendSpecialChar(char character);
 public:
     /**
      * @brief Creates an object which represents numeric keypad
@@ -115,8 +130,32 @@ public:
      * @param p_logger Pointer to a logger
     */
     Keypad(const std::string& keypadPath, Pipe* pOutputPipe, ILogger* p_logger = NulLogger::getInstance());
+
+    /**
+     * @brief Creates a keypad which reads `input_event`s from an already open file descriptor
+     * @param keypadFd Nonblocking file descriptor (evdev device, or a pipe written by a test). Closed by the destructor.
+     * @param pOutputPipe Pointer to a pipe to which keypad input is sent after pressing enter
+     * @param p_logger Pointer to a logger
+    */
+    Keypad(int keypadFd, Pipe* pOutputPipe, ILogger* p_logger = NulLogger::getInstance());
+
     ~Keypad(void);
-    void readChar(void);
+
+    /**
+     * @brief Blocks until the keypad has input, `Interrupt()` is called or `timeout_ms` expires, then handles all pending input
+     * @param timeout_ms Maximum time to wait, -1 waits indefinitely
+     * @return false if woken up by `Interrupt()`
+    */
+    bool WaitForInput(int timeout_ms);
+
+    /// Wakes up a thread blocked in `WaitForInput()`. Safe to call from any thread.
+    void Interrupt(void);
+
+    /**
+     * @brief Descriptor (the internal epoll instance) which is readable whenever `WaitForInput()` would not block
+     * Lets one thread wait on several keypads with a single poll() and then call `WaitForInput(0)` on the ready ones.
+    */
+    int getFd(void) const { return m_epoll_fd; }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -31,11 +31,29 @@
 #include<linux/input-event-codes.h>
 #include<cstring>
 #include<sys/stat.h>
+#include<sys/epoll.h>
+#include<sys/eventfd.h>
 #include<fcntl.h>
 #include<errno.h>
 
-#define ENTER 96
-#define BCKSPC 14
+#define CHARACTER_MAP_OFFSET 69
+static const char characterMap[] = {
+    'N', // KEY_NUMLOCK
+    'S', // KEY_SCROLLLOCK
+    '7', // KEY_KP7
+    '8', // KEY_KP8
+    '9', // KEY_KP9
+    '-', // KEY_KPMINUS
+    '4', // KEY_KP4
+    '5', // KEY_KP5
+    '6', // KEY_KP6
+    '+', // KEY_KPPLUS
+    '1', // KEY_KP1
+    '2', // KEY_KP2
+    '3', // KEY_KP3
+    '0', // KEY_KP0
+    '.'  // KEY_KPDOT
+    };
 
 const uint Keypad::m_buffer_size = GlobalProperties::Get().KEYPAD_BUFFER_SIZE;
 
@@ -52,44 +70,72 @@ Keypad::Keypad(const std::string& keypadPath, Pipe* pOutputPipt,ILogger* p_logge
         Kernel::Fatal_Error("Invalid keypad path (empty)!");
     }
 
-    if (m_pOutputPipe == nullptr)
+    m_keypadFile_fd = open(keypadPath.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (m_keypadFile_fd < 0)
     {
-        *m_pLogger << keypadPath + " - pipe pointer invalid. (nullptr)!";
-        Kernel::Fatal_Error(keypadPath + " - pipe pointer invalid. (nullptr)!");
+        *m_pLogger << "Cannot find file descriptor of a file on path: " + std::string(keypadPath);
+        Kernel::Fatal_Error("Cannot find file descriptor of a file on path: " + std::string(keypadPath));
     }
 
-    /*keypadFile = fopen(keypadPath.c_str() , "r");
+    initialize(keypadPath);
+}
 
-    if(keypadFile == NULL)
-    {
-        *m_pLogger << "Cannot open specified file on path: " + std::string(keypadPath);
-        Kernel::Fatal_Error("Cannot open specified file on path: " + std::string(keypadPath));
-    }*/
+Keypad::Keypad(int keypadFd, Pipe* pOutputPipt, ILogger* p_logger)
+    :   m_pOutputPipe(pOutputPipt), m_pLogger(p_logger), m_keypadFile_fd(keypadFd)
+{
+    if(m_pLogger == nullptr)
+        m_pLogger = NulLogger::getInstance();
 
-    m_keypadFile_fd = open(keypadPath.c_str(), O_RDONLY | O_NONBLOCK);
     if (m_keypadFile_fd < 0)
     {
-        *m_pLogger << "Cannot find file descriptor of a file on path: " + std::string(keypadPath);
-        Kernel::Fatal_Error("Cannot find file descriptor of a file on path: " + std::string(keypadPath));
+        *m_pLogger << "Invalid keypad file descriptor!";
+        Kernel::Fatal_Error("Invalid keypad file descriptor!");
     }
 
-    clearBuffer();
+    initialize("fd " + std::to_string(keypadFd));
+}
+
+void Keypad::initialize(const std::string& keypadName)
+{
+    if (m_pOutputPipe == nullptr)
+    {
+        *m_pLogger << keypadName + " - pipe pointer invalid. (nullptr)!";
+        Kernel::Fatal_Error(keypadName + " - pipe pointer invalid. (nullptr)!");
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_wakeup_fd < 0)
+    {
+        *m_pLogger << "Cannot create keypad epoll instance!";
+        Kernel::Fatal_Error("Cannot create keypad epoll instance!");
+    }
+
+    epoll_event keypadEvent = {};
+    keypadEvent.events = EPOLLIN;
+    keypadEvent.data.fd = m_keypadFile_fd;
 
+    epoll_event wakeupEvent = {};
+    wakeupEvent.events = EPOLLIN;
+    wakeupEvent.data.fd = m_wakeup_fd;
 
-    input_event = new IEVENT;
-    if(input_event == NULL)
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_keypadFile_fd, &keypadEvent) < 0
+        || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &wakeupEvent) < 0)
     {
-        *m_pLogger << "Cannot create a new IEVENT!";
-        Kernel::Fatal_Error("Cannot create a new IEVENT!");
+        *m_pLogger << keypadName + " - cannot be watched with epoll!";
+        Kernel::Fatal_Error(keypadName + " - cannot be watched with epoll!");
     }
 
+    clearBuffer();
+
     std::cout << "Keypad ready!" << std::endl;
 }
 
 Keypad::~Keypad(void)
 {
     close(m_keypadFile_fd);
-    delete input_event;
+    close(m_wakeup_fd);
+    close(m_epoll_fd);
 
     *m_pLogger << "Closing keypad!";
 
@@ -100,68 +146,140 @@ inline void Keypad::flushBuffer(void)
 {
     if(m_buffer == "") return;
 
-    // DEBUG
-    // std::cout << "Keypad read" << std::endl;
-    // DEBUG
-    
-    m_pOutputPipe->send(m_buffer);
+    sendEvent(KeypadEvent(KeypadEvent::Data, m_buffer));
     clearBuffer();
 }
 
-void Keypad::sendSpecialChar(char character)
+void Keypad::sendEvent(const KeypadEvent& event)
 {
-    if (character == ENTER)
+    m_pOutputPipe->sendMessage(event.toPipeMessage());
+}
+
+inline void Keypad::appendChar(char x) {m_buffer += x;}
+
+bool Keypad::WaitForInput(int timeout_ms)
+{
+    epoll_event readyEvents[2];
+
+    int readyCount = epoll_wait(m_epoll_fd, readyEvents, 2, timeout_ms);
+    if (readyCount < 0)
     {
-        m_pOutputPipe->send("ENTER");
+        if (errno == EINTR) return true;
+
+        *m_pLogger << "Keypad epoll_wait() error in WaitForInput()";
+        Kernel::Fatal_Error("Keypad epoll_wait() error in WaitForInput()");
     }
-    else if (character == BCKSPC)
+
+    bool interrupted = false;
+    for (int i = 0; i < readyCount; ++i)
     {
-        m_pOutputPipe->send("BCKSPC");
+        if (readyEvents[i].data.fd == m_wakeup_fd)
+        {
+            eventfd_t count;
+            eventfd_read(m_wakeup_fd, &count);
+            interrupted = true;
+        }
+        else if (!drainEvents() && !m_deviceLost)
+        {
+            // Level triggered: a hung up device would wake every epoll_wait(), so stop watching it
+            m_deviceLost = true;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_keypadFile_fd, nullptr);
+            *m_pLogger << "Keypad device lost!";
+            Kernel::Warning("Keypad device lost!");
+        }
     }
-}
 
-inline void Keypad::appendChar(char x) {m_buffer += x;}
+    return !interrupted;
+}
 
-void Keypad::readChar(void)
+void Keypad::Interrupt(void)
 {
-    *m_pLogger << "Buffer: " + m_buffer;
-    checkBufferOverflow();
+    eventfd_write(m_wakeup_fd, 1);
+}
 
+bool Keypad::drainEvents(void)
+{
+    while (true)
+    {
+        ssize_t dataRead = read(m_keypadFile_fd, m_events, sizeof(m_events));
+        if (dataRead < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        else if (dataRead == 0)
+        {
+            return false; // writer closed (test pipe)
+        }
 
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(m_keypadFile_fd, &readfds);
+        // evdev only returns whole events
+        size_t eventCount = (size_t)dataRead / sizeof(IEVENT);
+        for (size_t i = 0; i < eventCount; ++i)
+        {
+            processEvent(m_events[i]);
+        }
 
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 500 * 1000;
+        if ((size_t)dataRead < sizeof(m_events))
+        {
+            return true;
+        }
+    }
+}
 
-    /*int status = select(1, &readfds, nullptr, nullptr, &timeout);
-    std::cout << "MARK" << std::endl;
-    if (status < 0)
+void Keypad::processEvent(const IEVENT& event)
+{
+    if (event.type == EV_SYN && event.code == SYN_DROPPED)
     {
-        *m_pLogger << "Keypad select() error in readChar()";
-        Kernel::Fatal_Error("Keypad select() error in readChar()");
+        // Kernel queue overflowed, releases may have been lost
+        m_pressedKeys.reset();
+        m_chordActive = false;
+        m_enterPending = false;
+        return;
     }
-    else if (status == 0)
+
+    if (event.type != EV_KEY || event.code >= KEY_CNT) return;
+
+    switch (event.value)
     {
-        std::cout << "MARK2" << std::endl;
+    case 0: // Released
+        m_pressedKeys.reset(event.code);
+        if (event.code == KEY_KPENTER && m_enterPending)
+        {
+            m_enterPending = false;
+            submitEnter();
+        }
+        if (m_pressedKeys.none()) m_chordActive = false;
         return;
-    }*/
 
-    
-    
-    //fread(input_event, sizeof(IEVENT), 1, keypadFile);
-    ssize_t dataRead = read(m_keypadFile_fd, input_event, sizeof(IEVENT));
+    case 1: // Pressed
+        m_pressedKeys.set(event.code);
+        break;
+
+    default: // Autorepeat
+        return;
+    }
 
-    if (dataRead <= 0)
+    if (m_chordActive) return;
+
+    if (m_pressedKeys.test(KEY_BACKSPACE) && m_pressedKeys.test(KEY_KPENTER))
     {
+        m_chordActive = true;
+        m_enterPending = false;
+        clearBuffer();
+        sendEvent(KeypadEvent(KeypadEvent::Reset));
         return;
     }
 
-    if(input_event->type != EV_KEY || input_event->value != 1) return; // Filter only Key Pressed events
+    // Typing on while Enter is still held belongs to the next entry
+    if (m_enterPending)
+    {
+        m_enterPending = false;
+        submitEnter();
+    }
+
+    *m_pLogger << "Buffer: " + m_buffer;
+    checkBufferOverflow();
 
-    decodeChar();
+    decodeKey(event.code);
 }
 
 inline void Keypad::checkBufferOverflow(void)
@@ -171,15 +289,15 @@ inline void Keypad::checkBufferOverflow(void)
 }
 
 
-void Keypad::decodeChar(void)
+void Keypad::decodeKey(unsigned short code)
 {
-    char currentCharacter = (char) input_event->code;
+    char currentCharacter;
 
 
     /* switch-case for special characters*/
-    switch (currentCharacter)
+    switch (code)
     {
-    case 14: // BACKSPACE
+    case KEY_BACKSPACE:
     {
         if (m_buffer != "")
         {
@@ -187,42 +305,45 @@ void Keypad::decodeChar(void)
         }
         else
         {
-            sendSpecialChar(currentCharacter);
+            sendEvent(KeypadEvent(KeypadEvent::Backspace));
         }
     }
         
     return;
 
-    case 55:
+    case KEY_KPASTERISK:
         currentCharacter = '*';
     break;
 
-    case 70 ... 83:
-        currentCharacter = characterMap[currentCharacter - CHARACTER_MAP_OFFSET];
+    case KEY_SCROLLLOCK ... KEY_KPDOT:
+        currentCharacter = characterMap[code - CHARACTER_MAP_OFFSET];
     break;
 
-    case 96: // ENTER
-        if (m_buffer != "")
-        {
-            flushBuffer();
-        }
-        else
-        {
-            sendSpecialChar(currentCharacter);
-        }
+    case KEY_KPENTER:
+        // Submitted on release, see submitEnter()
+        m_enterPending = true;
     return;
 
-    case 98:
+    case KEY_KPSLASH:
         currentCharacter = '/';
     break;
 
     default:
-        char* errorMessage = new char[100]; 
-        sprintf(errorMessage, "Invalid character '%c' (int)%d", currentCharacter, (int) currentCharacter);
-        *m_pLogger << errorMessage;
-        delete[] errorMessage;
+        *m_pLogger << "Invalid key code " + std::to_string(code);
     return;
     }
     
     appendChar(currentCharacter);
-}
\ No newline at end of file
+}
+
+void Keypad::submitEnter(void)
+{
+    if (m_buffer != "")
+    {
+        flushBuffer();
+    }
+    else
+    {
+        sendEvent(KeypadEvent(KeypadEvent::Enter));
+    }
+}
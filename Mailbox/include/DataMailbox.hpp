@@ -38,6 +38,7 @@
 
 #include <string>
 #include <limits>
+#include <cstdint>
 
  // TODO export
 
@@ -46,10 +47,16 @@ using byte = unsigned char;
 using CardUUID = std::string;
 using KeyPass = std::string;
 using PIN = std::string;
+/// `DoorProperties::ID` of the door a request came from. NO_DOOR for messages not tied to a door.
+using DoorId = unsigned short;
+/// Correlates a request with its reply; chosen by the requester and copied into the reply
+using RequestId = uint32_t;
 
 const Clearance MAX_CLEARANCE = std::numeric_limits<Clearance>::max();
 const Clearance FAIL_SAFE_CLEARANCE = std::numeric_limits<Clearance>::min();
 const Clearance NO_CLEARANCE = -1;
+const DoorId NO_DOOR = 0;
+const RequestId NO_REQUEST = 0;
 
 // ---------------------------
 
@@ -422,6 +429,9 @@ public:
 	 */
 	void setMQAttributes(const mq_attr& message_queue_attributes);
 
+	/// Message queue descriptor, readable when a message is waiting. Used to wait on several mailboxes with poll().
+	mqd_t getFileDescriptor() const { return m_mailbox.getFileDescriptor(); }
+
 private:
 	ILogger* m_pLogger;
 
@@ -497,7 +507,8 @@ class InputParameter
 		DoorOpen_wBuzzerSuccess,
 		BuzzerError,
 		BuzzerSuccess,
-		BuzzerPing
+		BuzzerPing,
+		WebPass
 	} enuType;
 
 	InputParameter()
@@ -536,6 +547,66 @@ private:
 
 
 
+/**
+ * @brief CLOCK_MONOTONIC timestamps of the stages a request passed on its way from a reader to a door.
+ *
+ * Carried by `CommandMessage` and `DatabaseReply` after their other fields, and only if not empty,
+ * so untraced messages keep their original size and layout. Holds a fixed number of stamps and never allocates.
+*/
+class LatencyTrace
+{
+public:
+
+	typedef enum : byte
+	{
+		HARDWARE_SENT = 0,
+		MAIN_RECEIVED,
+		DATABASE_RECEIVED,
+		DATABASE_REPLIED,
+		MAIN_REPLY_RECEIVED,
+		INDICATOR_RECEIVED,
+		INDICATOR_DONE,
+		STAGE_COUNT
+	} enuStage;
+
+	struct Stamp
+	{
+		enuStage m_stage;
+		int64_t m_time_ns;
+	};
+
+	static const unsigned int MAX_STAMPS = 8;
+
+	LatencyTrace() : m_count(0) {}
+
+	bool empty() const { return m_count == 0; }
+	unsigned int size() const { return m_count; }
+	const Stamp& at(unsigned int index) const { return m_stamps[index]; }
+	void clear() { m_count = 0; }
+
+	/// Stamps `stage` with the current time. Ignored once `MAX_STAMPS` stamps were taken.
+	void Mark(enuStage stage);
+
+	/// Time of the first stamp of `stage`, or -1 if there is none
+	int64_t getTime_ns(enuStage stage) const;
+
+	size_t getSerializedSize() const;
+	void writeSerializedDataToBuffer(IN OUT char* pBuffer) const;
+	/// Reads at most `size` bytes written by `writeSerializedDataToBuffer()`. Returns false and leaves the trace empty if they are malformed.
+	bool Deserialize(const char* pSerializedData, size_t size);
+
+	std::string getInfo() const;
+
+	/// CLOCK_MONOTONIC in nanoseconds, the clock of every stamp
+	static int64_t Now_ns();
+	static std::string getStageName(enuStage stage);
+
+private:
+
+	Stamp m_stamps[MAX_STAMPS];
+	byte m_count;
+};
+
 class CommandMessage : public ExtendedDataMailboxMessage
 {
 public:
@@ -548,7 +619,10 @@ public:
 		REMOVE,
 		SET_CLNC,
 		GUEST_ACCESS_ENABLE,
-		GUEST_ACCESS_DISABLE
+		GUEST_ACCESS_DISABLE,
+		IMPORT,
+		/// Authorization MainApplication decided from its offline cache while DatabaseGateway did not answer, delivered for the access log
+		OFFLINE_LOG
 	} enuCommand;
 
 	CommandMessage(); // TODO Forbid sending with empty commandId
@@ -562,11 +636,21 @@ public:
 	CommandMessage& operator= (CommandMessage&& other);
 
 	enuCommand getCommandId() const { return m_command; }
+
+	DoorId getDoorId() const { return m_doorId; }
+	void setDoorId(DoorId doorId) { m_doorId = doorId; }
+
+	RequestId getRequestId() const { return m_requestId; }
+	void setRequestId(RequestId requestId) { m_requestId = requestId; }
 	
 	void addParameter(const InputParameter& param) { m_parameters.push_back(param); }
 	InputParameter getParameterAt(unsigned int index);
 	int getParameterCount() const { return m_parameters.size(); }
 
+	/// Stages this request passed, empty unless latency tracing is enabled
+	LatencyTrace& getTrace() { return m_trace; }
+	void setTrace(const LatencyTrace& trace) { m_trace = trace; }
+
 	virtual void Serialize() override;
 	virtual void Deserialize() override;
 	virtual std::string getInfo() override;
@@ -574,7 +658,10 @@ public:
 private:
 
 	enuCommand m_command;
+	DoorId m_doorId;
+	RequestId m_requestId;
 	std::vector<InputParameter> m_parameters;
+	LatencyTrace m_trace;
 
 };
 
@@ -670,20 +757,26 @@ public:
 	DatabaseReply()
 		: ExtendedDataMailboxMessage(MessageDataType::enuType::DatabaseReply),
 		m_status(NONE),
-		m_clearance(-1)
+		m_clearance(-1),
+		m_doorId(NO_DOOR),
+		m_requestId(NO_REQUEST)
 	{}
 
 	DatabaseReply(enuStatus status)
 		:
 		ExtendedDataMailboxMessage(MessageDataType::enuType::DatabaseReply),
 		m_status(status),
-		m_clearance(-1)
+		m_clearance(-1),
+		m_doorId(NO_DOOR),
+		m_requestId(NO_REQUEST)
 	{}
 
 	DatabaseReply(Clearance clearance)
 		: ExtendedDataMailboxMessage(MessageDataType::enuType::DatabaseReply),
 		m_status(CLEARANCE),
-		m_clearance(clearance)
+		m_clearance(clearance),
+		m_doorId(NO_DOOR),
+		m_requestId(NO_REQUEST)
 	{}
 
 	virtual ~DatabaseReply(){}
@@ -696,13 +789,26 @@ public:
 
 	enuStatus getReplyStatus() const { return m_status; }
 	Clearance getClearance() const { return m_clearance; }
-	
-	
+
+	/// Door of the request this reply answers
+	DoorId getDoorId() const { return m_doorId; }
+	void setDoorId(DoorId doorId) { m_doorId = doorId; }
+
+	/// ID of the request this reply answers
+	RequestId getRequestId() const { return m_requestId; }
+	void setRequestId(RequestId requestId) { m_requestId = requestId; }
+
+	/// Trace of the request this reply answers, extended by the replying process
+	LatencyTrace& getTrace() { return m_trace; }
+	void setTrace(const LatencyTrace& trace) { m_trace = trace; }
 
 private:
 
 	enuStatus m_status;
 	Clearance m_clearance;
+	DoorId m_doorId;
+	RequestId m_requestId;
+	LatencyTrace m_trace;
 
 };
 
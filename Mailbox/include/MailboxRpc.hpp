@@ -0,0 +1,168 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MAILBOX_RPC_HPP
+#define MAILBOX_RPC_HPP
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "DataMailbox.hpp"
+#include "Metrics.hpp"
+
+/// Outcome of a request made through MailboxRpc
+struct RpcResult
+{
+	typedef enum
+	{
+		REPLIED = 0,
+		/// No reply before the request's deadline; a reply arriving later is dropped
+		TIMED_OUT,
+		CANCELLED,
+		/// MailboxRpc was stopped while the request was pending
+		STOPPED
+	} enuOutcome;
+
+	enuOutcome m_outcome = STOPPED;
+	/// The reply, only for REPLIED
+	std::unique_ptr<DatabaseReply> m_pReply;
+};
+
+/**
+ * @brief Many outstanding CommandMessage requests over one DataMailbox, matched to their DatabaseReply by RequestId
+ *
+ * A DataMailbox can be used by one thread only: send() and receive() share its queue and handshake automaton.
+ * MailboxRpc therefore owns the mailbox and a thread which does all the sending and receiving. Call() assigns a
+ * request ID, queues the request and returns at once; the thread sends it connectionless, like KeypadAutomaton,
+ * and completes the request when its reply arrives, in whatever order the server replies. A request is completed
+ * exactly once: with its reply, at its deadline, when it is cancelled, or when MailboxRpc stops.
+ *
+ * Requests are not sent while the server's queue is full, they wait here (their deadline running) instead of
+ * blocking the thread, which has to keep receiving so the server can finish sending its replies.
+ * Callbacks run on the MailboxRpc thread (Cancel(): on the cancelling thread) and must not block.
+*/
+class MailboxRpc
+{
+public:
+	using Callback = std::function<void(RpcResult& result)>;
+
+	/**
+	 * @param mailboxName Name of the DataMailbox replies are received on, globally unique
+	 * @param pLogger Logger of the mailbox and of requests which could not be matched
+	*/
+	explicit MailboxRpc(const std::string& mailboxName, ILogger* pLogger = NulLogger::getInstance());
+	~MailboxRpc();
+
+	MailboxRpc(const MailboxRpc&) = delete;
+	MailboxRpc& operator=(const MailboxRpc&) = delete;
+
+	/// Starts the thread. Requests made before are sent once it runs.
+	void Start();
+	/// Stops the thread and completes every pending request with STOPPED, as well as requests made until Start()
+	void Stop();
+
+	/**
+	 * @brief Sends `request` to the mailbox named `server`; `callback` is called once with the outcome
+	 * @param timeout Deadline of the request, measured from now
+	 * @return ID the request was sent with, for Cancel(); NO_REQUEST if stopped
+	*/
+	RequestId Call(const std::string& server, CommandMessage&& request, std::chrono::milliseconds timeout, Callback callback);
+
+	/// Like Call() with a callback, the outcome is delivered through the returned future
+	std::future<RpcResult> Call(const std::string& server, CommandMessage&& request, std::chrono::milliseconds timeout);
+
+	/**
+	 * @brief Completes a pending request with CANCELLED. The server is not told; its reply, if any, is dropped.
+	 * @return false if the request was already completed
+	*/
+	bool Cancel(RequestId requestId);
+
+	/// Requests waiting to be sent or for their reply
+	size_t getPendingCount() const;
+
+	const std::string& getName() const { return m_name; }
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	struct Pending
+	{
+		Callback m_callback;
+		TimePoint m_start;
+		TimePoint m_deadline;
+		std::string m_server;
+		/// Until the thread sends it
+		std::unique_ptr<CommandMessage> m_pRequest;
+	};
+
+	void threadFunction();
+	/// Sends queued requests in order, false if the first one waits for its server's queue to drain
+	bool sendQueued();
+	/// Reference to the server's mailbox, opened on first use and kept for the thread's lifetime
+	MailboxReference& getServer(const std::string& server);
+	void receiveAll();
+	void expire(TimePoint now);
+	/// Removes the request and calls its callback, false if it is not pending
+	bool complete(RequestId requestId, RpcResult& result);
+	void wake();
+
+	/// Longest sleep of the thread when no deadline is closer; it is woken for new requests and replies anyway
+	static const int IDLE_WAIT_MS = 100;
+	/// How often a full server queue is checked again, the queue gives no notification when it drains
+	static const int FULL_RETRY_MS = 5;
+
+	std::string m_name;
+	ILogger* m_pLogger;
+	DataMailbox m_mailbox;
+	int m_wakeFd;
+
+	mutable std::mutex m_lock;
+	std::unordered_map<RequestId, Pending> m_pending;
+	/// Deadlines of the pending requests, earliest first
+	std::set<std::pair<TimePoint, RequestId>> m_deadlines;
+	/// Requests in the order they were made, until sent
+	std::deque<RequestId> m_queued;
+	RequestId m_lastRequestId;
+
+	/// Used by the thread only; MailboxReference copies would share (and close) one descriptor
+	std::unordered_map<std::string, std::unique_ptr<MailboxReference>> m_servers;
+
+	std::thread m_thread;
+	std::atomic<bool> m_stop;
+
+	MetricHistogram m_callLatency;
+	MetricCounter m_timeouts;
+	MetricCounter m_unmatched;
+};
+
+#endif
@@ -32,6 +32,9 @@
 #include <sstream>
 #include <fstream>
 #include <numeric>
+#include <array>
+
+#include <time.h>
 
 
 MessageDataType::MessageDataType(enuType messageDataType) : m_messageDataType(messageDataType)
@@ -652,7 +655,7 @@ size_t InputParameter::DeserializeAndGetSize(char* pSerializedData)
 
 std::string InputParameter::getInfo() const
 {
-	std::array<std::string, 14> names =
+	std::array<std::string, 15> names =
 	{
 		"Empty",
 		"KeypadPIN",
@@ -667,7 +670,8 @@ std::string InputParameter::getInfo() const
 		"DoorOpen_wBuzzerSuccess",
 		"BuzzerError",
 		"BuzzerSuccess",
-		"BuzzerPing"
+		"BuzzerPing",
+		"WebPass"
 	};
 
 	if ((int)m_type >= names.size())
@@ -678,8 +682,129 @@ std::string InputParameter::getInfo() const
 	return "Input Parameter [ " + names[(int)m_type] + " ] : " + m_data;
 }
 
+void LatencyTrace::Mark(enuStage stage)
+{
+	if (m_count >= MAX_STAMPS)
+	{
+		return;
+	}
+
+	m_stamps[m_count].m_stage = stage;
+	m_stamps[m_count].m_time_ns = Now_ns();
+	++m_count;
+}
+
+int64_t LatencyTrace::getTime_ns(enuStage stage) const
+{
+	for (byte i = 0; i < m_count; ++i)
+	{
+		if (m_stamps[i].m_stage == stage)
+		{
+			return m_stamps[i].m_time_ns;
+		}
+	}
+
+	return -1;
+}
+
+size_t LatencyTrace::getSerializedSize() const
+{
+	return sizeof(m_count) + m_count * (sizeof(byte) + sizeof(int64_t));
+}
+
+void LatencyTrace::writeSerializedDataToBuffer(IN OUT char* pBuffer) const
+{
+	memcpy(pBuffer, &m_count, sizeof(m_count));
+
+	size_t currentOffset = sizeof(m_count);
+	for (byte i = 0; i < m_count; ++i)
+	{
+		byte stage = m_stamps[i].m_stage;
+		memcpy(pBuffer + currentOffset, &stage, sizeof(stage));
+		memcpy(pBuffer + currentOffset + sizeof(stage), &m_stamps[i].m_time_ns, sizeof(int64_t));
+		currentOffset += sizeof(stage) + sizeof(int64_t);
+	}
+}
+
+bool LatencyTrace::Deserialize(const char* pSerializedData, size_t size)
+{
+	clear();
+
+	byte count = 0;
+	if (size < sizeof(count))
+	{
+		return false;
+	}
+
+	memcpy(&count, pSerializedData, sizeof(count));
+	if (count > MAX_STAMPS || size < sizeof(count) + count * (sizeof(byte) + sizeof(int64_t)))
+	{
+		return false;
+	}
+
+	size_t currentOffset = sizeof(count);
+	for (byte i = 0; i < count; ++i)
+	{
+		byte stage = 0;
+		memcpy(&stage, pSerializedData + currentOffset, sizeof(stage));
+		memcpy(&m_stamps[i].m_time_ns, pSerializedData + currentOffset + sizeof(stage), sizeof(int64_t));
+		currentOffset += sizeof(stage) + sizeof(int64_t);
+
+		if (stage >= STAGE_COUNT)
+		{
+			return false;
+		}
+
+		m_stamps[i].m_stage = (enuStage)stage;
+	}
+
+	m_count = count;
+	return true;
+}
+
+std::string LatencyTrace::getInfo() const
+{
+	std::stringstream stringBuilder;
+
+	for (byte i = 0; i < m_count; ++i)
+	{
+		stringBuilder << (i == 0 ? "" : ", ") << getStageName(m_stamps[i].m_stage) << " +" << (m_stamps[i].m_time_ns - m_stamps[0].m_time_ns) << " ns";
+	}
+
+	return stringBuilder.str();
+}
+
+int64_t LatencyTrace::Now_ns()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+std::string LatencyTrace::getStageName(enuStage stage)
+{
+	static const std::array<std::string, STAGE_COUNT> stageNames =
+	{
+		"HARDWARE_SENT",
+		"MAIN_RECEIVED",
+		"DATABASE_RECEIVED",
+		"DATABASE_REPLIED",
+		"MAIN_REPLY_RECEIVED",
+		"INDICATOR_RECEIVED",
+		"INDICATOR_DONE"
+	};
+
+	if (stage >= STAGE_COUNT)
+	{
+		return "INVALID STAGE: " + std::to_string((int)stage);
+	}
+
+	return stageNames[stage];
+}
+
 CommandMessage::CommandMessage()
-	: ExtendedDataMailboxMessage(MessageDataType::enuType::CommandMessage), m_command(enuCommand::NONE), m_parameters()
+	: ExtendedDataMailboxMessage(MessageDataType::enuType::CommandMessage), m_command(enuCommand::NONE), m_doorId(NO_DOOR), m_requestId(NO_REQUEST), m_parameters()
 {
 
 }
@@ -687,7 +812,10 @@ CommandMessage::CommandMessage()
 CommandMessage::CommandMessage(CommandMessage&& other)
 	:	ExtendedDataMailboxMessage(std::move(other)),
 	m_command(other.m_command),
-	m_parameters(other.m_parameters)
+	m_doorId(other.m_doorId),
+	m_requestId(other.m_requestId),
+	m_parameters(other.m_parameters),
+	m_trace(other.m_trace)
 {
 
 }
@@ -696,13 +824,16 @@ CommandMessage& CommandMessage::operator= (CommandMessage&& other)
 	ExtendedDataMailboxMessage::operator=(std::move(other));
 
 	m_command = other.m_command;
+	m_doorId = other.m_doorId;
+	m_requestId = other.m_requestId;
 	m_parameters = other.m_parameters;
+	m_trace = other.m_trace;
 
 	return *this;
 }
 
 CommandMessage::CommandMessage(enuCommand commandId)
-	: ExtendedDataMailboxMessage(MessageDataType::enuType::CommandMessage), m_command(commandId), m_parameters()
+	: ExtendedDataMailboxMessage(MessageDataType::enuType::CommandMessage), m_command(commandId), m_doorId(NO_DOOR), m_requestId(NO_REQUEST), m_parameters()
 {
 
 }
@@ -731,12 +862,17 @@ void CommandMessage::Serialize()
 
 	char serializedDataType = m_dataType.toChar();
 
-	size_t sizeOfSerializedData = sizeof(serializedDataType) + sizeof(m_command) + sizeof(parameterCount) + totalParametersSerializedSize;
+	// The trace is appended only if present, so untraced messages keep their original layout
+	size_t traceSerializedSize = m_trace.empty() ? 0 : m_trace.getSerializedSize();
+
+	size_t sizeOfSerializedData = sizeof(serializedDataType) + sizeof(m_command) + sizeof(m_doorId) + sizeof(m_requestId) + sizeof(parameterCount) + totalParametersSerializedSize + traceSerializedSize;
 
 
 	// offset computation
 	size_t commandIdOffset = sizeof(serializedDataType);
-	size_t parameterCountOffset = sizeof(m_command) + commandIdOffset;
+	size_t doorIdOffset = sizeof(m_command) + commandIdOffset;
+	size_t requestIdOffset = sizeof(m_doorId) + doorIdOffset;
+	size_t parameterCountOffset = sizeof(m_requestId) + requestIdOffset;
 	size_t parametersOffset = sizeof(parameterCount) + parameterCountOffset;
 
 
@@ -745,6 +881,8 @@ void CommandMessage::Serialize()
 
 	memcpy(m_serialized, &serializedDataType, sizeof(serializedDataType));
 	memcpy(m_serialized + commandIdOffset, &m_command, sizeof(m_command));
+	memcpy(m_serialized + doorIdOffset, &m_doorId, sizeof(m_doorId));
+	memcpy(m_serialized + requestIdOffset, &m_requestId, sizeof(m_requestId));
 	memcpy(m_serialized + parameterCountOffset, &parameterCount, sizeof(parameterCount));
 
 
@@ -755,6 +893,10 @@ void CommandMessage::Serialize()
 		currentOffset += param.getSeralizedSize();
 	}
 
+	if (traceSerializedSize != 0)
+	{
+		m_trace.writeSerializedDataToBuffer(m_serialized + currentOffset);
+	}
 }
 
 void CommandMessage::Deserialize()
@@ -769,7 +911,13 @@ void CommandMessage::Deserialize()
 	size_t commandIdOffset = sizeof(serializedDataType);
 	memcpy(&m_command, m_serialized + commandIdOffset, sizeof(m_command));
 
-	size_t parameterCountOffset = sizeof(m_command) + commandIdOffset;
+	size_t doorIdOffset = sizeof(m_command) + commandIdOffset;
+	memcpy(&m_doorId, m_serialized + doorIdOffset, sizeof(m_doorId));
+
+	size_t requestIdOffset = sizeof(m_doorId) + doorIdOffset;
+	memcpy(&m_requestId, m_serialized + requestIdOffset, sizeof(m_requestId));
+
+	size_t parameterCountOffset = sizeof(m_requestId) + requestIdOffset;
 	byte parameterCount = 0;
 	memcpy(&parameterCount, m_serialized + parameterCountOffset, sizeof(parameterCount));
 
@@ -786,6 +934,12 @@ void CommandMessage::Deserialize()
 		
 		m_parameters.push_back(param);
 	}
+
+	m_trace.clear();
+	if (currentOffset < m_sizeOfSerializedData)
+	{
+		m_trace.Deserialize(m_serialized + currentOffset, m_sizeOfSerializedData - currentOffset);
+	}
 }
 
 std::string CommandMessage::getInfo()
@@ -795,6 +949,8 @@ std::string CommandMessage::getInfo()
 	stringBuilder
 		<< "\tCommandMessage" << "\n"
 		<< "\tCommand: " << (int)m_command << "\n"
+		<< "\tDoor: " << m_doorId << "\n"
+		<< "\tRequest: " << m_requestId << "\n"
 		<< "\tParameter Count: " << m_parameters.size() << "\n";
 
 		for (const auto& param : m_parameters)
@@ -804,6 +960,11 @@ std::string CommandMessage::getInfo()
 				<< "\tParam Data: " << param.getData() << "\n";
 		}
 
+		if (!m_trace.empty())
+		{
+			stringBuilder << "\tTrace: " << m_trace.getInfo() << "\n";
+		}
+
 		return stringBuilder.str();
 }
 
@@ -977,14 +1138,25 @@ void DatabaseReply::Serialize()
 
 	size_t statusOffset = sizeof(serializedDataType);
 	size_t clearanceOffset = statusOffset + sizeof(m_status);
+	size_t doorIdOffset = clearanceOffset + sizeof(m_clearance);
+	size_t requestIdOffset = doorIdOffset + sizeof(m_doorId);
 
-	size_t sizeOfSerializedData = clearanceOffset + sizeof(m_clearance);
+	size_t traceOffset = requestIdOffset + sizeof(m_requestId);
+
+	size_t sizeOfSerializedData = traceOffset + (m_trace.empty() ? 0 : m_trace.getSerializedSize());
 
 	deleteAndReallocateSerializedData(sizeOfSerializedData);
 
 	memcpy(m_serialized, &serializedDataType, sizeof(serializedDataType));
 	memcpy(m_serialized + statusOffset, &m_status, sizeof(m_status));
 	memcpy(m_serialized + clearanceOffset, &m_clearance, sizeof(m_clearance));
+	memcpy(m_serialized + doorIdOffset, &m_doorId, sizeof(m_doorId));
+	memcpy(m_serialized + requestIdOffset, &m_requestId, sizeof(m_requestId));
+
+	if (!m_trace.empty())
+	{
+		m_trace.writeSerializedDataToBuffer(m_serialized + traceOffset);
+	}
 }
 
 void DatabaseReply::Deserialize()
@@ -995,17 +1167,36 @@ void DatabaseReply::Deserialize()
 
 	size_t statusOffset = sizeof(serializedDataType);
 	size_t clearanceOffset = statusOffset + sizeof(m_status);
+	size_t doorIdOffset = clearanceOffset + sizeof(m_clearance);
 
 	memcpy(&serializedDataType, m_serialized, sizeof(serializedDataType));
 	memcpy(&m_status, m_serialized + statusOffset, sizeof(m_status));
 	memcpy(&m_clearance, m_serialized + clearanceOffset, sizeof(m_clearance));
+	memcpy(&m_doorId, m_serialized + doorIdOffset, sizeof(m_doorId));
+
+	size_t requestIdOffset = doorIdOffset + sizeof(m_doorId);
+	memcpy(&m_requestId, m_serialized + requestIdOffset, sizeof(m_requestId));
+
+	size_t traceOffset = requestIdOffset + sizeof(m_requestId);
+	m_trace.clear();
+	if (traceOffset < m_sizeOfSerializedData)
+	{
+		m_trace.Deserialize(m_serialized + traceOffset, m_sizeOfSerializedData - traceOffset);
+	}
 
 	m_dataType.Decode(serializedDataType);
 }
 
 std::string DatabaseReply::getInfo()
 {
-	return "DatabaseReply -- Status [ " + getStatusName() + " ], Clearance [ " + std::to_string((int)m_clearance) + " ]";
+	std::string info = "DatabaseReply -- Status [ " + getStatusName() + " ], Clearance [ " + std::to_string((int)m_clearance) + " ], Door [ " + std::to_string(m_doorId) + " ], Request [ " + std::to_string(m_requestId) + " ]";
+
+	if (!m_trace.empty())
+	{
+		info += ", Trace [ " + m_trace.getInfo() + " ]";
+	}
+
+	return info;
 }
 
 std::string DatabaseReply::getStatusName() const
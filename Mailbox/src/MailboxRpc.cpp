@@ -0,0 +1,371 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MailboxRpc.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+const int MailboxRpc::IDLE_WAIT_MS;
+const int MailboxRpc::FULL_RETRY_MS;
+
+MailboxRpc::MailboxRpc(const std::string& mailboxName, ILogger* pLogger)
+	: m_name(mailboxName), m_pLogger(pLogger == nullptr ? NulLogger::getInstance() : pLogger),
+	m_mailbox(mailboxName, m_pLogger),
+	// Random start, so replies to a previous instance's requests are not taken for replies to this one's
+	m_lastRequestId(static_cast<RequestId>(std::chrono::steady_clock::now().time_since_epoch().count())),
+	m_stop(false),
+	m_callLatency(MetricsRegistry::Process().getHistogram(mailboxName + ".rpc_ns")),
+	m_timeouts(MetricsRegistry::Process().getCounter(mailboxName + ".rpc_timeouts")),
+	m_unmatched(MetricsRegistry::Process().getCounter(mailboxName + ".rpc_unmatched"))
+{
+	m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (m_wakeFd < 0)
+	{
+		*m_pLogger << m_name + " - could not create eventfd: " + std::strerror(errno);
+		Kernel::Fatal_Error(m_name + " - could not create eventfd: " + std::strerror(errno));
+	}
+
+	// The thread polls the queue and then drains it, a timed receive must not wait (0 is refused)
+	m_mailbox.setRTO_ns(1);
+}
+
+MailboxRpc::~MailboxRpc()
+{
+	Stop();
+	close(m_wakeFd);
+}
+
+void MailboxRpc::Start()
+{
+	if (m_thread.joinable())
+	{
+		return;
+	}
+
+	m_stop = false;
+	m_thread = std::thread(&MailboxRpc::threadFunction, this);
+}
+
+void MailboxRpc::Stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_stop = true;
+	}
+
+	if (m_thread.joinable())
+	{
+		wake();
+		m_thread.join();
+	}
+
+	std::vector<RequestId> pending;
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (const auto& entry : m_pending)
+		{
+			pending.push_back(entry.first);
+		}
+	}
+
+	for (RequestId requestId : pending)
+	{
+		RpcResult result;
+		result.m_outcome = RpcResult::STOPPED;
+		complete(requestId, result);
+	}
+}
+
+RequestId MailboxRpc::Call(const std::string& server, CommandMessage&& request, std::chrono::milliseconds timeout, Callback callback)
+{
+	const TimePoint now = std::chrono::steady_clock::now();
+	RequestId requestId = NO_REQUEST;
+
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		if (!m_stop)
+		{
+			do
+			{
+				++m_lastRequestId;
+			} while (m_lastRequestId == NO_REQUEST || m_pending.count(m_lastRequestId) != 0);
+			requestId = m_lastRequestId;
+
+			request.setRequestId(requestId);
+
+			Pending& pending = m_pending[requestId];
+			pending.m_callback = std::move(callback);
+			pending.m_start = now;
+			pending.m_deadline = now + timeout;
+			pending.m_server = server;
+			pending.m_pRequest.reset(new CommandMessage(std::move(request)));
+
+			m_deadlines.insert(std::make_pair(pending.m_deadline, requestId));
+			m_queued.push_back(requestId);
+		}
+	}
+
+	if (requestId == NO_REQUEST)
+	{
+		RpcResult result;
+		result.m_outcome = RpcResult::STOPPED;
+		callback(result);
+		return NO_REQUEST;
+	}
+
+	wake();
+	return requestId;
+}
+
+std::future<RpcResult> MailboxRpc::Call(const std::string& server, CommandMessage&& request, std::chrono::milliseconds timeout)
+{
+	std::shared_ptr<std::promise<RpcResult>> pPromise = std::make_shared<std::promise<RpcResult>>();
+	std::future<RpcResult> future = pPromise->get_future();
+
+	Call(server, std::move(request), timeout, [pPromise](RpcResult& result) { pPromise->set_value(std::move(result)); });
+
+	return future;
+}
+
+bool MailboxRpc::Cancel(RequestId requestId)
+{
+	RpcResult result;
+	result.m_outcome = RpcResult::CANCELLED;
+	return complete(requestId, result);
+}
+
+size_t MailboxRpc::getPendingCount() const
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	return m_pending.size();
+}
+
+void MailboxRpc::threadFunction()
+{
+	*m_pLogger << m_name + " - RPC thread started";
+
+	while (!m_stop)
+	{
+		const bool sent = sendQueued();
+		const TimePoint now = std::chrono::steady_clock::now();
+		expire(now);
+
+		int wait_ms = sent ? IDLE_WAIT_MS : FULL_RETRY_MS;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			if (!m_deadlines.empty())
+			{
+				const auto untilDeadline = m_deadlines.begin()->first - now;
+				const int64_t deadline_ms = std::chrono::duration_cast<std::chrono::milliseconds>(untilDeadline + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+				wait_ms = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(wait_ms, deadline_ms)));
+			}
+		}
+
+		struct pollfd descriptors[2];
+		descriptors[0].fd = m_mailbox.getFileDescriptor();
+		descriptors[0].events = POLLIN;
+		descriptors[0].revents = 0;
+		descriptors[1].fd = m_wakeFd;
+		descriptors[1].events = POLLIN;
+		descriptors[1].revents = 0;
+
+		if (poll(descriptors, 2, wait_ms) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			*m_pLogger << m_name + " - poll failed: " + std::strerror(errno);
+			Kernel::Fatal_Error(m_name + " - poll failed: " + std::strerror(errno));
+		}
+
+		if (descriptors[1].revents & POLLIN)
+		{
+			uint64_t wakeups;
+			while (read(m_wakeFd, &wakeups, sizeof(wakeups)) > 0)
+			{
+			}
+		}
+
+		if (descriptors[0].revents & POLLIN)
+		{
+			receiveAll();
+		}
+	}
+
+	*m_pLogger << m_name + " - RPC thread stopped";
+}
+
+bool MailboxRpc::sendQueued()
+{
+	while (true)
+	{
+		std::string server;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			// Cancelled and expired requests stay queued until they reach the front
+			while (!m_queued.empty() && m_pending.count(m_queued.front()) == 0)
+			{
+				m_queued.pop_front();
+			}
+			if (m_queued.empty())
+			{
+				return true;
+			}
+			server = m_pending[m_queued.front()].m_server;
+		}
+
+		MailboxReference& destination = getServer(server);
+
+		// Same check as KeypadAutomaton: another client can still fill the queue first, then the send waits
+		if (destination.isFull())
+		{
+			return false;
+		}
+
+		std::unique_ptr<CommandMessage> pRequest;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			auto it = m_pending.find(m_queued.front());
+			if (it != m_pending.end())
+			{
+				pRequest = std::move(it->second.m_pRequest);
+			}
+			m_queued.pop_front();
+		}
+
+		if (pRequest != nullptr)
+		{
+			m_mailbox.sendConnectionless(destination, pRequest.get());
+		}
+	}
+}
+
+MailboxReference& MailboxRpc::getServer(const std::string& server)
+{
+	std::unique_ptr<MailboxReference>& pServer = m_servers[server];
+	if (pServer == nullptr)
+	{
+		pServer.reset(new MailboxReference(server, m_pLogger));
+	}
+	return *pServer;
+}
+
+void MailboxRpc::receiveAll()
+{
+	while (true)
+	{
+		DataMailboxMessage* pMessage = m_mailbox.receive(enuReceiveOptions::TIMED);
+
+		if (pMessage->getDataType() == MessageDataType::enuType::DataMailboxErrorMessage)
+		{
+			// Queue drained
+			delete pMessage;
+			return;
+		}
+
+		if (pMessage->getDataType() == MessageDataType::enuType::DatabaseReply)
+		{
+			RpcResult result;
+			result.m_outcome = RpcResult::REPLIED;
+			result.m_pReply.reset(dynamic_cast<DatabaseReply*>(pMessage));
+
+			const RequestId requestId = result.m_pReply->getRequestId();
+			if (!complete(requestId, result))
+			{
+				// Late reply to a request which timed out or was cancelled
+				m_unmatched.Increment();
+				*m_pLogger << m_name + " - dropped reply to request " + std::to_string(requestId) + " which is no longer pending";
+			}
+			continue;
+		}
+
+		m_unmatched.Increment();
+		*m_pLogger << m_name + " - dropped unexpected message of type " + pMessage->getDataType().toString();
+		delete pMessage;
+	}
+}
+
+void MailboxRpc::expire(TimePoint now)
+{
+	std::vector<RequestId> expired;
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (auto it = m_deadlines.begin(); it != m_deadlines.end() && it->first <= now; ++it)
+		{
+			expired.push_back(it->second);
+		}
+	}
+
+	for (RequestId requestId : expired)
+	{
+		RpcResult result;
+		result.m_outcome = RpcResult::TIMED_OUT;
+		if (complete(requestId, result))
+		{
+			m_timeouts.Increment();
+		}
+	}
+}
+
+bool MailboxRpc::complete(RequestId requestId, RpcResult& result)
+{
+	Callback callback;
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		auto it = m_pending.find(requestId);
+		if (it == m_pending.end())
+		{
+			return false;
+		}
+
+		if (result.m_outcome == RpcResult::REPLIED)
+		{
+			m_callLatency.Record(std::chrono::steady_clock::now() - it->second.m_start);
+		}
+
+		callback = std::move(it->second.m_callback);
+		m_deadlines.erase(std::make_pair(it->second.m_deadline, requestId));
+		m_pending.erase(it);
+	}
+
+	callback(result);
+	return true;
+}
+
+void MailboxRpc::wake()
+{
+	const uint64_t one = 1;
+	if (write(m_wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+	{
+		Kernel::Warning(m_name + " - could not wake the RPC thread: " + std::strerror(errno));
+	}
+}
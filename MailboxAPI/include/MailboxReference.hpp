@@ -140,6 +140,9 @@ class MailboxReference
 
     std::string getName () const;
 
+    /// True if the queue holds as many messages as it can, so sending to it would block until its owner receives one
+    bool isFull () const;
+
     /**
      * @brief Construct a new Mailbox Reference object with logger attached.
      * 
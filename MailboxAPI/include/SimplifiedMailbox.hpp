@@ -27,6 +27,7 @@
 
 #include"MailboxReference.hpp"
 #include"SimplifiedMailboxEnums.hpp"
+#include"Metrics.hpp"
 
 #include<memory>
 #include<queue>
@@ -130,6 +131,8 @@ class SimplifiedMailbox : public MailboxReference
 
     //std::queue<MailboxReference> m_qWaitingList;
     std::queue<std::string> m_qWaitingList; // set to MailboxReference ???
+    /// Connectionless messages which arrived during a handshake, returned by the next receive() calls
+    std::queue<SimpleMailboxMessage> m_qConnectionless;
     SimpleMailboxMessage m_messageBuffer;
 
     /// Structure representing send/receive timeout in both `s` and `ns`
@@ -138,6 +141,13 @@ class SimplifiedMailbox : public MailboxReference
     /// Used by the automaton
     enuReceiveOptions m_timedReceiveOverride;
 
+    /// Published to the process metrics registry as `<mailbox name>.<metric>`
+    MetricCounter m_sentCounter;        // ".sent" - messages sent with send() or sendConnectionless()
+    MetricCounter m_receivedCounter;    // ".received" - messages returned by receive()
+    MetricCounter m_timeoutCounter;     // ".timeouts" - receive() calls which timed out or found the queue empty
+    MetricGauge m_queueDepthGauge;      // ".depth" - messages waiting in the queue when the last receive started
+    MetricHistogram m_sendLatency;      // ".send_ns" - send() including the RTS / CTS / ACK handshake
+
     /// INTERNAL USE. Takes `char* p_rawData` and receives message (TIMED) and writes it to `p_rawData` TODO
     SimpleMailboxMessage receiveImmediateTimed(IN OUT char* p_rawData);
 
@@ -248,7 +258,7 @@ class SimplifiedMailbox : public MailboxReference
      * @param raw_message SimpleMailboxMessage `raw_message`
      * @return MailboxAutomatonEvent_wMessage containing pointer to the raw_message TODO UNSTABLE?
     */
-    OWNER MailboxAutomatonEvent_wMessage* parseMessage(SimpleMailboxMessage& raw_message);
+    MailboxAutomatonEvent_wMessage parseMessage(SimpleMailboxMessage& raw_message);
 
     /**
      * @brief Send message contained in `p_data` with size of `data_size` to `destination` DataMailbox. Guarantees that message will be delivered or it will block, possibly crash
@@ -208,6 +208,17 @@ std::string MailboxReference::getName() const
     return name;
 }
 
+bool MailboxReference::isFull() const
+{
+    mq_attr attributes;
+    if(mq_getattr(fd, &attributes) != 0)
+    {
+        return false;
+    }
+
+    return attributes.mq_curmsgs >= attributes.mq_maxmsg;
+}
+
 MailboxReference::MailboxReference(const std::string& identifier, ILogger* p_logger, const struct mq_attr& _messageAttributes, bool unlink)
 {
     m_isValid = false;
@@ -124,7 +124,12 @@ DataSizePair SimpleMailboxMessage::getOwnershipOfData()
 }
 
 SimplifiedMailbox::SimplifiedMailbox (const std::string& identifier, ILogger* p_logger, const struct mq_attr& _mailboxAttributes)
-    :   MailboxReference(identifier, p_logger, _mailboxAttributes), m_messageBuffer(SimpleMailboxMessage{}), m_timedReceiveOverride(enuReceiveOptions::DONT_OVERRIDE)
+    :   MailboxReference(identifier, p_logger, _mailboxAttributes), m_messageBuffer(SimpleMailboxMessage{}), m_timedReceiveOverride(enuReceiveOptions::DONT_OVERRIDE),
+    m_sentCounter(MetricsRegistry::Process().getCounter(identifier + ".sent")),
+    m_receivedCounter(MetricsRegistry::Process().getCounter(identifier + ".received")),
+    m_timeoutCounter(MetricsRegistry::Process().getCounter(identifier + ".timeouts")),
+    m_queueDepthGauge(MetricsRegistry::Process().getGauge(identifier + ".depth")),
+    m_sendLatency(MetricsRegistry::Process().getHistogram(identifier + ".send_ns"))
 {
     if (p_logger == nullptr)
         p_parentLogger = NulLogger::getInstance();
@@ -381,7 +386,10 @@ void SimplifiedMailbox::setMQAttributes(const mq_attr& message_queue_attributes)
 
 SimpleMailboxMessage SimplifiedMailbox::receiveImmediate(enuReceiveOptions timed)
 {
-    char p_rawData[getMQAttributes().mq_msgsize + 1];
+    const mq_attr attributes = getMQAttributes();
+    m_queueDepthGauge.Set(attributes.mq_curmsgs);
+
+    char p_rawData[attributes.mq_msgsize + 1];
     memset(p_rawData, 0, sizeof(p_rawData));
 
     SimpleMailboxMessage deserializedMessage;
@@ -716,37 +724,37 @@ void SimplifiedMailbox::sendImmediate(SimpleMailboxMessage& message)
 }
 
 
-OWNER MailboxAutomatonEvent_wMessage* SimplifiedMailbox::parseMessage(SimpleMailboxMessage& message)
+MailboxAutomatonEvent_wMessage SimplifiedMailbox::parseMessage(SimpleMailboxMessage& message)
 {
 
     if(message.m_header.m_type == TIMED_OUT)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtTimedOut, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtTimedOut, &message);
     }
 
     else if(message.m_header.m_type == RTS && message.m_sourceName != m_messageBuffer.m_destinationName)
     {
-       return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtRTS_Received, &message);
+       return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtRTS_Received, &message);
     }
     else if(message.m_header.m_type == CTS && message.m_sourceName == m_messageBuffer.m_destinationName)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtCTS_Received, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtCTS_Received, &message);
     }
     else if(message.m_header.m_type == HOLD && message.m_sourceName == m_messageBuffer.m_destinationName)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtHoldReceived, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtHoldReceived, &message);
     }
     else if(message.m_header.m_type == ACK && message.m_sourceName == m_messageBuffer.m_destinationName)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtACK_Received, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtACK_Received, &message);
     }
     else if (message.m_header.m_type == MESSAGE_CONNECTIONLESS)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtValidMsgConnectionless, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtValidMsgConnectionless, &message);
     }
     else if (message.m_header.m_type == EMPTY)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtTimedOut, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtTimedOut, &message);
     }
     /*else
     {
@@ -757,14 +765,14 @@ OWNER MailboxAutomatonEvent_wMessage* SimplifiedMailbox::parseMessage(SimpleMail
 
     else if(message.m_sourceName == m_messageBuffer.m_destinationName)
     {
-        return new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtValidMsg, &message);
+        return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtValidMsg, &message);
     }
 
     // else
     *p_parentLogger << name + " INVALID MESSAGE RECEIVED FROM: " + message.m_sourceName + ", TYPE: " + std::to_string(message.m_header.m_type);
     Kernel::Fatal_Error(name + " - invalid CTL message received");
     // m_pAutomaton->reset();
-    return nullptr; // ERROR TODO ERROR STATE?
+    return MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtTimedOut, &message); // not reached, Fatal_Error exits
 
 }
 
@@ -791,10 +799,10 @@ void SimplifiedMailbox::sendConnectionless(MailboxReference& destination, char*
     messageToBeSent.m_header.m_sourceNameLength = messageToBeSent.m_sourceName.length();
     messageToBeSent.m_header.m_destinationNameLength = messageToBeSent.m_destinationName.length();
 
-
-    m_messageBuffer = messageToBeSent; // ????
-
+    // No handshake, so m_messageBuffer is left alone: holding this message there made parseMessage() take
+    // the destination's next RTS (e.g. its reply) for a handshake message and return this message instead
     sendImmediate(messageToBeSent);
+    m_sentCounter.Increment();
 
     // TEMPORARY POINTER TO DATA !!!
     // OWNERSHIP OF SOME OBJECT ON HIGHER LAYER !!!
@@ -834,20 +842,23 @@ void SimplifiedMailbox::send(MailboxReference& destination, char* p_data, size_t
     
     // m_pAutomaton->clearErrorStatus();
 
-    OWNER MailboxAutomatonEvent_wMessage* p_event = new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtInitSending, &messageToBeSent);
-    m_pAutomaton->processEvent(p_event);
+    ScopedLatency sendLatency(m_sendLatency);
+
+    // Events live on the stack, the automaton does not allocate while processing them
+    MailboxAutomatonEvent_wMessage initEvent(MailboxAutomaton::enuEvtInitSending, &messageToBeSent);
+    m_pAutomaton->processEvent(initEvent);
 
     while(m_pAutomaton->taskCompleted() == false)
     {
         SimpleMailboxMessage msg = receiveImmediate(); // TODO timed
-        p_event = parseMessage(msg);
-        m_pAutomaton->processEvent(p_event);
+        MailboxAutomatonEvent_wMessage event = parseMessage(msg);
+        m_pAutomaton->processEvent(event);
     }
 
-    if(m_qWaitingList.empty() == true)
-        m_pAutomaton->processEvent(OWNER new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtResetQueueEmpty));
-    else
-        m_pAutomaton->processEvent(OWNER new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtResetQueueNotEmpty));
+    MailboxAutomatonEvent_wMessage resetEvent(m_qWaitingList.empty() ? MailboxAutomaton::enuEvtResetQueueEmpty : MailboxAutomaton::enuEvtResetQueueNotEmpty);
+    m_pAutomaton->processEvent(resetEvent);
+
+    m_sentCounter.Increment();
 
     // TEMPORARY POINTER TO DATA !!!
     // OWNERSHIP OF SOME OBJECT ON HIGHER LAYER !!!
@@ -861,20 +872,21 @@ void SimplifiedMailbox::send(MailboxReference& destination, char* p_data, size_t
 
 SimpleMailboxMessage SimplifiedMailbox::receive(enuReceiveOptions options)
 {
+    if (!m_qConnectionless.empty())
+    {
+        SimpleMailboxMessage kept = std::move(m_qConnectionless.front());
+        m_qConnectionless.pop();
+        m_receivedCounter.Increment();
+        return kept;
+    }
+
     // m_pAutomaton->clearErrorStatus();
 
     // DEBUG UNTESTED
     m_timedReceiveOverride = DONT_OVERRIDE;
 
-    MailboxAutomatonEvent_wMessage* p_event = nullptr;
-
-    
-    if(options % enuReceiveOptions::IGNORE_QUEUE)
-        p_event = new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtStartReceivingIgnoreQueue);
-    else
-        p_event = new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtStartReceiving);
-
-    m_pAutomaton->processEvent(p_event);
+    MailboxAutomatonEvent_wMessage startEvent((options % enuReceiveOptions::IGNORE_QUEUE) ? MailboxAutomaton::enuEvtStartReceivingIgnoreQueue : MailboxAutomaton::enuEvtStartReceiving);
+    m_pAutomaton->processEvent(startEvent);
 
     while(m_pAutomaton->taskCompleted() == false)
     {
@@ -887,17 +899,24 @@ SimpleMailboxMessage SimplifiedMailbox::receive(enuReceiveOptions options)
         }
 
         SimpleMailboxMessage msg = receiveImmediate(receiveOptions);
-        p_event = parseMessage(msg);
-        m_pAutomaton->processEvent(p_event);
+        MailboxAutomatonEvent_wMessage event = parseMessage(msg);
+        m_pAutomaton->processEvent(event);
     }
 
     SimpleMailboxMessage messageCopy = m_messageBuffer;
     m_messageBuffer.releaseAndResetResources();
 
-    if(m_qWaitingList.empty() == true)
-        m_pAutomaton->processEvent(new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtResetQueueEmpty));
-    else
-        m_pAutomaton->processEvent(new MailboxAutomatonEvent_wMessage(MailboxAutomaton::enuEvtResetQueueNotEmpty));
+    if (messageCopy.isTimedOut() || messageCopy.m_header.m_type == EMPTY)
+    {
+        m_timeoutCounter.Increment();
+    }
+    else if (!messageCopy.isSyscallInterrupted())
+    {
+        m_receivedCounter.Increment();
+    }
+
+    MailboxAutomatonEvent_wMessage resetEvent(m_qWaitingList.empty() ? MailboxAutomaton::enuEvtResetQueueEmpty : MailboxAutomaton::enuEvtResetQueueNotEmpty);
+    m_pAutomaton->processEvent(resetEvent);
 
     // DEBUG UNTESTED
     m_timedReceiveOverride = DONT_OVERRIDE;
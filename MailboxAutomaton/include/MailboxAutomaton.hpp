@@ -25,17 +25,14 @@
 #ifndef MAILBOX_AUTOMATON_HPP
 #define MAILBOX_AUTOMATON_HPP
 
-#include"mautomat.h"
+#include"mautomattable.h"
 #include"SimplifiedMailboxEnums.hpp"
 
 class SimplifiedMailbox;
 class SimpleMailboxMessageHeader;
 class SimpleMailboxMessage;
 
-
-#define AUT_ACTION(X) (bool (MAutomat::*)(MAutEvent*)) &MailboxAutomaton::X
-
-class MailboxAutomaton : public MAutomat
+class MailboxAutomaton : public MAutTableAutomat<MailboxAutomaton, 9, 13>
 {
     public:
     MailboxAutomaton(short int siInstID,
@@ -57,7 +54,9 @@ class MailboxAutomaton : public MAutomat
         enuWaitingRTS = 5,
         enuWaitingMSG = 6,
         enuActionSuccessfulyEnded = 7,
-        enuWaitingMSG_Connectionless = 8
+        enuWaitingMSG_Connectionless = 8,
+
+        enuStateCount
 
     } enumAutStateType;
     // =============================================================
@@ -79,12 +78,20 @@ class MailboxAutomaton : public MAutomat
         enuEvtResetQueueNotEmpty,
         enuEvtTimedOut,
 
+        enuEventCount
+
     } enumAutEventType;
 
+    static_assert(enuStateCount == 9 && enuEventCount == 13, "MailboxAutomaton table size must match its enums");
+
     // ============================================================
 
+    static const Table& getTransitionTable();
+
     virtual bool reset();
-    bool processEvent(MAutEvent* event);
+
+    using MAutTableAutomat::processEvent;
+    virtual bool processEvent(MAutEvent& event);
 
     bool taskCompleted() const;
 
@@ -131,6 +138,8 @@ class MailboxAutomaton : public MAutomat
 
     bool doSaveReceivedMessage(MAutEvent* event);
 
+    bool doKeepConnectionless(MAutEvent* event);
+
     // =============================================================
 };
 
@@ -149,6 +158,8 @@ class MailboxAutomatonEvent_wMessage : public MAutEvent
 
     virtual ~MailboxAutomatonEvent_wMessage();
 
+    static const char* getDescription(int idEvent);
+
     SimpleMailboxMessage* m_pMessage;
 };
 
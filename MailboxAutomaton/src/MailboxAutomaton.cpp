@@ -32,66 +32,55 @@
 
 
 MailboxAutomatonEvent_wMessage::MailboxAutomatonEvent_wMessage(int idEvent, SimpleMailboxMessage* p_message)
-    :   m_pMessage(p_message)
+    :   MAutEvent(idEvent, getDescription(idEvent)), m_pMessage(p_message)
 {
-    m_iEventID = idEvent;
+}
 
-    switch(m_iEventID)
+const char* MailboxAutomatonEvent_wMessage::getDescription(int idEvent)
+{
+    switch(idEvent)
     {
         case MailboxAutomaton::enuEvtStartReceiving :
-        m_sDesc = "enuEvtStartReceiving";
-        break;
+        return "enuEvtStartReceiving";
 
         case MailboxAutomaton::enuEvtStartReceivingIgnoreQueue :
-        m_sDesc = "enuEvtStartReceivingIgnoreQueue";
-        break;
+        return "enuEvtStartReceivingIgnoreQueue";
         
         case MailboxAutomaton::enuEvtStartReceivingConnectionless:
-        m_sDesc = "enuEvtStartReceivingConnectionless";
-        break;
+        return "enuEvtStartReceivingConnectionless";
 
         case MailboxAutomaton::enuEvtRTS_Received :
-        m_sDesc = "enuEvtRTS_Received";
-        break;
+        return "enuEvtRTS_Received";
         
         case MailboxAutomaton::enuEvtInitSending :
-        m_sDesc = "enuEvtInitSending";
-        break;
+        return "enuEvtInitSending";
         
         case MailboxAutomaton::enuEvtHoldReceived :
-        m_sDesc = "enuEvtHoldReceived";
-        break;
+        return "enuEvtHoldReceived";
         
         case MailboxAutomaton::enuEvtCTS_Received :
-        m_sDesc = "enuEvtCTS_Received";
-        break;
+        return "enuEvtCTS_Received";
         
         case MailboxAutomaton::enuEvtACK_Received :
-        m_sDesc = "enuEvtACK_Received";
-        break;
+        return "enuEvtACK_Received";
         
         case MailboxAutomaton::enuEvtValidMsg :
-        m_sDesc = "enuEvtValidMsg";
-        break;
+        return "enuEvtValidMsg";
         
         case MailboxAutomaton::enuEvtValidMsgConnectionless:
-        m_sDesc = "enuEvtValidMsgConnectionless";
-        break;
+        return "enuEvtValidMsgConnectionless";
 
         case MailboxAutomaton::enuEvtResetQueueEmpty :
-        m_sDesc = "enuEvtResetQueueEmpty";
-        break;
+        return "enuEvtResetQueueEmpty";
         
         case MailboxAutomaton::enuEvtResetQueueNotEmpty :
-        m_sDesc = "enuEvtResetQueueNotEmpty";
-        break;
+        return "enuEvtResetQueueNotEmpty";
 
         case MailboxAutomaton::enuEvtTimedOut :
-        m_sDesc = "enuEvtTimedOut";
-        break;
+        return "enuEvtTimedOut";
 
     default:
-        m_sDesc = "ERROR: Unknown Event!";
+        return "ERROR: Unknown Event!";
 
     }
 }
@@ -102,87 +91,82 @@ MailboxAutomatonEvent_wMessage::~MailboxAutomatonEvent_wMessage()
 }
 
 MailboxAutomaton::MailboxAutomaton(short int siInstID, SimplifiedMailbox* pMailbox, ILogger* pLogger)
-    :   MAutomat(siInstID), m_bFinished(false), m_pMessageBuffer(&pMailbox->m_messageBuffer)
+    :   MAutTableAutomat(siInstID), m_bFinished(false), m_pMessageBuffer(&pMailbox->m_messageBuffer)
 {
     if(pLogger == nullptr)
         m_pLogger = NulLogger::getInstance();
     else
         m_pLogger = pLogger;
 
+    setTraceName("MailboxAutomaton");
+
     m_pMailbox = pMailbox;
     if(m_pMailbox == nullptr)
         Fatal_Error("Mailbox pointer cannot be NULL!"); // possible name clash with Kernel::Fatal_Error
 
     m_iInitialStateID = enuIdleQueueEmpty;
+}
 
+const MailboxAutomaton::Table& MailboxAutomaton::getTransitionTable()
+{
     /**********************************************
      * TRANSITION TABLE INITIALIZATION            *
      **********************************************/
 
-    MAutState* pState = nullptr;
-
-    // enuIdleQueueEmpty = 0
-    pState = new MAutState(enuIdleQueueEmpty);
-    pState->addTransition(new MAutTransition(enuEvtStartReceiving, enuWaitingRTS, this, AUT_ACTION(doVoid)));
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuIdleQueueNotEmpty, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtInitSending, enuRTS_Sent, this, AUT_ACTION(doSendRTS)));
-    pState->addTransition(new MAutTransition(enuEvtStartReceivingIgnoreQueue, enuWaitingRTS, this, AUT_ACTION(doVoid)));
-    // pState->addTransition(new MAutTransition(enuEvtStartReceivingConnectionless, enuWaitingMSG_Connectionless, this, AUT_ACTION(doVoid)));
-    this->addAutState(pState);
-
-    // enuIdleQueueNotEmpty = 1
-    pState = new MAutState(enuIdleQueueNotEmpty);
-    pState->addTransition(new MAutTransition(enuEvtInitSending, enuRTS_Sent, this, AUT_ACTION(doSendRTS)));
-    pState->addTransition(new MAutTransition(enuEvtStartReceiving, enuWaitingMSG, this, AUT_ACTION(doDequeueAndCTS)));
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuIdleQueueNotEmpty, this, AUT_ACTION(doEnqueueAndHold)));
-    // pState->addTransition(new MAutTransition(enuEvtStartReceivingConnectionless, enuWaitingMSG_Connectionless, this, AUT_ACTION(doVoid)));
-    pState->addTransition(new MAutTransition(enuEvtStartReceivingIgnoreQueue, enuWaitingRTS, this, AUT_ACTION(doVoid)));
-    this->addAutState(pState);
-
-    // enuRTS_Sent = 2
-    pState = new MAutState(enuRTS_Sent);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuRTS_Sent, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtHoldReceived, enuHoldState, this, AUT_ACTION(doVoid)));
-    pState->addTransition(new MAutTransition(enuEvtCTS_Received, enuWaitingACK, this, AUT_ACTION(doSendMsg)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsgConnectionless, enuRTS_Sent, this, AUT_ACTION(doVoid))); // TEMPORARY TODO
-    this->addAutState(pState);
-
-    // enuHoldState = 3
-    pState = new MAutState(enuHoldState);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuHoldState, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtCTS_Received, enuWaitingACK, this, AUT_ACTION(doSendMsg)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsgConnectionless, enuHoldState, this, AUT_ACTION(doVoid))); // TEMPORARY TODO
-    this->addAutState(pState);
-
-    // enuWaitingACK = 4
-    pState = new MAutState(enuWaitingACK);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuWaitingACK, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtACK_Received, enuActionSuccessfulyEnded, this, AUT_ACTION(doSetFinishedFlag)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsgConnectionless, enuWaitingACK, this, AUT_ACTION(doVoid))); // TEMPORARY TODO
-    this->addAutState(pState);
-
-    // enuWaitingRTS = 5
-    pState = new MAutState(enuWaitingRTS);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuWaitingMSG, this, AUT_ACTION(doSendCTS)));
-    pState->addTransition(new MAutTransition(enuEvtTimedOut, enuActionSuccessfulyEnded, this, AUT_ACTION(doSetTimedOutStatus)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsgConnectionless, enuActionSuccessfulyEnded, this, AUT_ACTION(doSaveReceivedMessage)));
-    this->addAutState(pState);
-
-    // enuWaitingMSG = 6
-    pState = new MAutState(enuWaitingMSG);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuWaitingMSG, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtTimedOut, enuWaitingMSG, this, AUT_ACTION(doVoid)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsg, enuActionSuccessfulyEnded, this, AUT_ACTION(doSendACK)));
-    pState->addTransition(new MAutTransition(enuEvtValidMsgConnectionless, enuWaitingMSG, this, AUT_ACTION(doVoid)));
-    this->addAutState(pState);
-
-    // enuActionSuccessfulyEnded = 7
-    pState = new MAutState(enuActionSuccessfulyEnded);
-    pState->addTransition(new MAutTransition(enuEvtRTS_Received, enuActionSuccessfulyEnded, this, AUT_ACTION(doEnqueueAndHold)));
-    pState->addTransition(new MAutTransition(enuEvtResetQueueEmpty, enuIdleQueueEmpty, this, AUT_ACTION(doClearFinishedFlag)));
-    pState->addTransition(new MAutTransition(enuEvtResetQueueNotEmpty, enuIdleQueueNotEmpty, this, AUT_ACTION(doClearFinishedFlag)));
-    this->addAutState(pState);
-    
+    static const Table table = []()
+    {
+        Table t;
+
+        // enuIdleQueueEmpty = 0
+        t.add(enuIdleQueueEmpty, enuEvtStartReceiving, enuWaitingRTS, &MailboxAutomaton::doVoid)
+         .add(enuIdleQueueEmpty, enuEvtRTS_Received, enuIdleQueueNotEmpty, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuIdleQueueEmpty, enuEvtInitSending, enuRTS_Sent, &MailboxAutomaton::doSendRTS)
+         .add(enuIdleQueueEmpty, enuEvtStartReceivingIgnoreQueue, enuWaitingRTS, &MailboxAutomaton::doVoid);
+        // .add(enuIdleQueueEmpty, enuEvtStartReceivingConnectionless, enuWaitingMSG_Connectionless, &MailboxAutomaton::doVoid);
+
+        // enuIdleQueueNotEmpty = 1
+        t.add(enuIdleQueueNotEmpty, enuEvtInitSending, enuRTS_Sent, &MailboxAutomaton::doSendRTS)
+         .add(enuIdleQueueNotEmpty, enuEvtStartReceiving, enuWaitingMSG, &MailboxAutomaton::doDequeueAndCTS)
+         .add(enuIdleQueueNotEmpty, enuEvtRTS_Received, enuIdleQueueNotEmpty, &MailboxAutomaton::doEnqueueAndHold)
+         // .add(enuIdleQueueNotEmpty, enuEvtStartReceivingConnectionless, enuWaitingMSG_Connectionless, &MailboxAutomaton::doVoid)
+         .add(enuIdleQueueNotEmpty, enuEvtStartReceivingIgnoreQueue, enuWaitingRTS, &MailboxAutomaton::doVoid);
+
+        // enuRTS_Sent = 2
+        t.add(enuRTS_Sent, enuEvtRTS_Received, enuRTS_Sent, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuRTS_Sent, enuEvtHoldReceived, enuHoldState, &MailboxAutomaton::doVoid)
+         .add(enuRTS_Sent, enuEvtCTS_Received, enuWaitingACK, &MailboxAutomaton::doSendMsg)
+         .add(enuRTS_Sent, enuEvtValidMsgConnectionless, enuRTS_Sent, &MailboxAutomaton::doKeepConnectionless);
+
+        // enuHoldState = 3
+        t.add(enuHoldState, enuEvtRTS_Received, enuHoldState, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuHoldState, enuEvtCTS_Received, enuWaitingACK, &MailboxAutomaton::doSendMsg)
+         .add(enuHoldState, enuEvtValidMsgConnectionless, enuHoldState, &MailboxAutomaton::doKeepConnectionless);
+
+        // enuWaitingACK = 4
+        t.add(enuWaitingACK, enuEvtRTS_Received, enuWaitingACK, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuWaitingACK, enuEvtACK_Received, enuActionSuccessfulyEnded, &MailboxAutomaton::doSetFinishedFlag)
+         .add(enuWaitingACK, enuEvtValidMsgConnectionless, enuWaitingACK, &MailboxAutomaton::doKeepConnectionless);
+
+        // enuWaitingRTS = 5
+        t.add(enuWaitingRTS, enuEvtRTS_Received, enuWaitingMSG, &MailboxAutomaton::doSendCTS)
+         .add(enuWaitingRTS, enuEvtTimedOut, enuActionSuccessfulyEnded, &MailboxAutomaton::doSetTimedOutStatus)
+         .add(enuWaitingRTS, enuEvtValidMsgConnectionless, enuActionSuccessfulyEnded, &MailboxAutomaton::doSaveReceivedMessage);
+
+        // enuWaitingMSG = 6
+        t.add(enuWaitingMSG, enuEvtRTS_Received, enuWaitingMSG, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuWaitingMSG, enuEvtTimedOut, enuWaitingMSG, &MailboxAutomaton::doVoid)
+         .add(enuWaitingMSG, enuEvtValidMsg, enuActionSuccessfulyEnded, &MailboxAutomaton::doSendACK)
+         .add(enuWaitingMSG, enuEvtValidMsgConnectionless, enuWaitingMSG, &MailboxAutomaton::doKeepConnectionless);
+
+        // enuActionSuccessfulyEnded = 7
+        t.add(enuActionSuccessfulyEnded, enuEvtRTS_Received, enuActionSuccessfulyEnded, &MailboxAutomaton::doEnqueueAndHold)
+         .add(enuActionSuccessfulyEnded, enuEvtResetQueueEmpty, enuIdleQueueEmpty, &MailboxAutomaton::doClearFinishedFlag)
+         .add(enuActionSuccessfulyEnded, enuEvtResetQueueNotEmpty, enuIdleQueueNotEmpty, &MailboxAutomaton::doClearFinishedFlag);
+
+        return t;
+    }();
+
+    return table;
 }
 
 void MailboxAutomaton::Fatal_Error(const std::string& errorMessage)
@@ -220,18 +204,22 @@ bool MailboxAutomaton::taskCompleted() const
 
 // INHERITED METHODS ===========================================
 
-bool MailboxAutomaton::processEvent(MAutEvent* event)
+bool MailboxAutomaton::processEvent(MAutEvent& event)
 {
-    std::stringstream logStringBuilder;
+    // Transitions are recorded to the trace ring, the text log is for debugging only
+    if(isTracing())
+    {
+        std::stringstream logStringBuilder;
 
-    logStringBuilder << "\n******************************************************"
-                     << "\nSTATE: " << getCurrentStateId() << "\n"
-                     << "\nEVENT: " << event->getEventDesc() << " [ " << event->getEventId() << " ]"
-                     << "\n******************************************************";
+        logStringBuilder << "\n******************************************************"
+                         << "\nSTATE: " << getCurrentStateId() << "\n"
+                         << "\nEVENT: " << event.getEventDesc() << " [ " << event.getEventId() << " ]"
+                         << "\n******************************************************";
 
-    *m_pLogger << logStringBuilder.str();
+        *m_pLogger << logStringBuilder.str();
+    }
 
-    return MAutomat::processEvent(event);
+    return MAutTableAutomat::processEvent(event);
     
 }
 
@@ -401,5 +389,15 @@ bool MailboxAutomaton::doSaveReceivedMessage(MAutEvent* event)
     return true;
 }
 
+bool MailboxAutomaton::doKeepConnectionless(MAutEvent* event)
+{
+    MailboxAutomatonEvent_wMessage* p_event_wMessage = dynamic_cast<MailboxAutomatonEvent_wMessage*> (event);
+
+    // Arrived in the middle of a handshake; dropping it would lose e.g. a request sent while a reply is being sent
+    m_pMailbox->m_qConnectionless.push(*p_event_wMessage->m_pMessage);
+
+    return true;
+}
+
 
 // =============================================================
\ No newline at end of file
@@ -31,13 +31,16 @@
 /**
   * Class used to instantiate and pass resources to automata.
   * Used to hide cyclic dependecies between automata.
+  * One pair serves the session of one door.
 **/
 class AutomatonPairFactory
 {
 public:
-	AutomatonPairFactory(DataMailbox* pMailbox,
+	AutomatonPairFactory(DoorId doorId,
+		DataMailbox* pMailbox,
 		MailboxReference* pRefDatabase,
-		IndicatorController_Client* pIndicators,
+		DoorIndicators* pIndicators,
+		bool* pGuestAccessEnable,
 		ILogger* pLogger = NulLogger::getInstance());
 
 	~AutomatonPairFactory();
@@ -49,9 +52,11 @@ public:
 private:
 
 	ILogger* m_pLogger;
+	DoorId m_doorId;
 	DataMailbox* m_pMailbox;
 	MailboxReference* m_pRefDatabase;
-	IndicatorController_Client* m_pIndicators;
+	DoorIndicators* m_pIndicators;
+	bool* m_pGuestAccessEnable;
 
 	MainAutomaton* m_pMainAutomaton;
 	KeypadAutomaton* m_pKeypadAutomaton;
@@ -66,22 +71,33 @@ private:
 
 };
 
-AutomatonPairFactory::AutomatonPairFactory(DataMailbox* pMailbox,
+AutomatonPairFactory::AutomatonPairFactory(DoorId doorId,
+	DataMailbox* pMailbox,
 	MailboxReference* pRefDatabase,
-	IndicatorController_Client* pIndicators,
+	DoorIndicators* pIndicators,
+	bool* pGuestAccessEnable,
 	ILogger* pLogger)
-	:	m_pMailbox(pMailbox),
-	m_pLogger(pLogger),
+	:	m_pLogger(pLogger),
+	m_doorId(doorId),
+	m_pMailbox(pMailbox),
 	m_pRefDatabase(pRefDatabase),
 	m_pIndicators(pIndicators),
-	m_pKeypadAutomaton(nullptr),
-	m_pMainAutomaton(nullptr)
+	m_pGuestAccessEnable(pGuestAccessEnable),
+	m_pMainAutomaton(nullptr),
+	m_pKeypadAutomaton(nullptr)
 {
 	if (m_pLogger == nullptr)
 	{
 		m_pLogger = NulLogger::getInstance();
 	}
 
+	// 2 * ID + 1 must fit the automaton instance ID; config validation keeps door IDs in range
+	if (m_doorId > DoorProperties::MAX_ID)
+	{
+		*m_pLogger << "AutomatonPairFactory - door ID " + std::to_string(m_doorId) + " is out of range!";
+		Kernel::Fatal_Error("AutomatonPairFactory - door ID " + std::to_string(m_doorId) + " is out of range!");
+	}
+
 	if (m_pMailbox == nullptr)
 	{
 		*m_pLogger << "AutomatonPairFactory - Mailbox pointer cannot be null!";
@@ -116,12 +132,12 @@ AutomatonPairFactory::~AutomatonPairFactory()
 
 void AutomatonPairFactory::createMainAutomaton()
 {
-	m_pMainAutomaton = new MainAutomaton(0, m_pIndicators, m_pLogger);
+	m_pMainAutomaton = new MainAutomaton(2 * m_doorId, m_pIndicators, m_pGuestAccessEnable, m_pLogger);
 }
 
 void AutomatonPairFactory::createKeypadAutomaton()
 {
-	m_pKeypadAutomaton = new KeypadAutomaton(1, m_pMailbox, m_pRefDatabase, m_pIndicators, m_pLogger);
+	m_pKeypadAutomaton = new KeypadAutomaton(2 * m_doorId + 1, m_pMailbox, m_pRefDatabase, m_pIndicators, m_pLogger);
 }
 
 void AutomatonPairFactory::createAutomataCoupling()
@@ -28,11 +28,14 @@
 #include "mautomat.h"
 #include "DataMailbox.hpp"
 #include "TransitionInfo.hpp"
-#include "Timer.hpp"
 #include "IndicatorController.hpp"
+#include "Metrics.hpp"
+
+#include <chrono>
 
 
 class MainAutomaton;
+class OfflineCache;
 
 class KeypadAutomaton : public MAutomat
 {
@@ -41,13 +44,30 @@ public:
 	KeypadAutomaton(short int siInstID,
 		DataMailbox* pMailbox,
 		MailboxReference* pRefDatabase,
-		IndicatorController_Client* pIndicators,
+		DoorIndicators* pIndicators,
 		ILogger* pLogger = nullptr);
 
 	virtual ~KeypadAutomaton() {}
 	
 	void setMainAutomatonPointer(MainAutomaton* pMainAutomaton);
 
+	/// Door of the request being processed (or processed last); its indicators show the result
+	DoorId getActiveDoor() const { return m_activeDoor; }
+
+	/// ID of the database request awaiting a reply, `NO_REQUEST` if none. Replies with another ID are stale.
+	RequestId getPendingRequest() const { return m_pendingRequest; }
+
+	/**
+	 * @brief Times out the pending request if its reply is overdue. Called periodically by the owner of the automaton.
+	 *
+	 * With an offline cache, an AUTHENTICATE not answered within OFFLINE_DEADLINE_MS is decided from the cache instead;
+	 * if the cache has no answer the request keeps waiting for the gateway until the regular deadline.
+	*/
+	void CheckDeadline(std::chrono::steady_clock::time_point now);
+
+	/// Learns clearance replies and decides from `pCache` when the database is `deadline` late; nullptr (default) disables offline decisions
+	void setOfflineCache(OfflineCache* pCache, std::chrono::milliseconds deadline);
+
 	bool initialize();
 
 	// STATES =================================================
@@ -99,9 +119,30 @@ private:
 	MainAutomaton* m_pMainAutomaton;
 	DataMailbox* m_pMailbox;
 	MailboxReference* m_pRefDatabase;
-	IndicatorController_Client* m_pIndicators;
-	Timer m_deadlineTimer;
-	TimerCallbackFunctor<KeypadAutomaton> m_timeoutCallback;
+	DoorIndicators* m_pIndicators;
+	DoorId m_activeDoor;
+	RequestId m_pendingRequest;
+	bool m_bDeadlineActive;
+	std::chrono::steady_clock::time_point m_deadline;
+	std::chrono::steady_clock::time_point m_requestSent;
+
+	OfflineCache* m_pOfflineCache;
+	/// Credential of the pending AUTHENTICATE, the only request which may be decided offline
+	InputParameter m_pendingCredential;
+	bool m_bOfflineEligible;
+	std::chrono::milliseconds m_offlineTimeout;
+	std::chrono::steady_clock::time_point m_offlineDeadline;
+
+	/// Request outcomes, shared by all sessions of the process
+	MetricCounter m_grantedCounter;		// "access.granted" - doors opened
+	MetricCounter m_deniedCounter;		// "access.denied" - insufficient clearance or guest access disabled
+	MetricCounter m_invalidCounter;		// "access.invalid" - unknown command or invalid parameter
+	MetricCounter m_errorCounter;		// "access.errors" - database reported an error
+	MetricCounter m_timeoutCounter;		// "access.timeouts" - no reply before the request deadline
+	MetricCounter m_offlineCounter;		// "access.offline" - requests decided from the offline cache
+	MetricHistogram m_decisionLatency;	// "access.decision_ns" - request sent to the database until its reply is handled
+
+	IndicatorController_Client* activeIndicators() const { return m_pIndicators->get(m_activeDoor); }
 
 
 	// AUTOMAT FUNCTIONS ======================================
@@ -145,7 +186,13 @@ private:
 
 	TransitionInfo getTransitionInfo(MAutEvent* pReceivedEvent);
 
-	void doSendTimeoutEvent_timerWrapper(void*);
+	void startDeadline();
+	/// Decides the pending AUTHENTICATE from the offline cache. Returns false if the cache has no answer.
+	bool decideOffline();
+	/// Feeds a clearance reply to the pending AUTHENTICATE into the offline cache
+	void learnFromReply(MAutEvent* pEvent);
+	/// Stops the deadline and forgets the pending request, so a late reply is discarded
+	void stopDeadline();
 };
 
 class KeypadAutomatonEvent : public MAutEvent
@@ -158,5 +205,8 @@ public:
 	DataMailboxMessage* m_pMessage;
 };
 
+/// Door which sent a request (or which a reply belongs to), `NO_DOOR` if the message does not carry one
+DoorId getDoorId(DataMailboxMessage* pMessage);
+
 
 #endif
\ No newline at end of file
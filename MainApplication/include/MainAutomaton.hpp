@@ -35,8 +35,10 @@ class KeypadAutomaton;
 class MainAutomaton : public MAutomat
 {
 public:
+	/// `pGuestAccessEnable` is shared by the automata of all doors
 	MainAutomaton(short int siInstID,
-		IndicatorController_Client* pIndicators,
+		DoorIndicators* pIndicators,
+		bool* pGuestAccessEnable,
 		ILogger* pLogger = NulLogger::getInstance());
 
 	virtual ~MainAutomaton() {};
@@ -45,9 +47,9 @@ public:
 
 	bool initialize();
 
-	// TODO not a very good idea!
-	bool m_bGuestAccessEnable;
-	
+	bool isGuestAccessEnabled() const { return *m_pGuestAccessEnable; }
+	void setGuestAccessEnabled(bool enable) { *m_pGuestAccessEnable = enable; }
+
 
 	// STATES =================================================
 
@@ -77,7 +79,8 @@ public:
 private:
 	ILogger* m_pLogger;
 	KeypadAutomaton* m_pKeypadAutomaton;
-	IndicatorController_Client* m_pIndicators;
+	DoorIndicators* m_pIndicators;
+	bool* m_pGuestAccessEnable;
 
 
 	// AUTOMAT FUNCTIONS ======================================
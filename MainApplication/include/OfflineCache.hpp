@@ -0,0 +1,157 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef OFFLINE_CACHE_HPP
+#define OFFLINE_CACHE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "DataMailbox.hpp"
+#include "ILogger.hpp"
+#include "NulLogger.hpp"
+
+/**
+ * @brief Last answers of DatabaseGateway to AUTHENTICATE, kept by MainApplication to decide at the door while the gateway does not answer
+ *
+ * Every clearance reply is learned for the credential and door it answers, in the slot of its local hour of the week.
+ * An offline decision repeats the gateway's answer for the same credential, door and hour, so weekly schedules are followed
+ * at hour resolution; a credential never seen in that hour, or not confirmed by the gateway for `m_ttl_s`, is not decided.
+ *
+ * Credentials are kept as a 64 bit HMAC-SHA-256 of type, data and door with a key stored next to the cache file, so neither
+ * memory nor the file reveals a PIN or card UID. At most `m_maxEntries` are kept, the least recently confirmed is dropped first.
+ * The cache is saved to `path` signed with the same key; a file which was modified, truncated or signed with another key is ignored.
+ *
+ * Offline decisions are queued (credential, door, time) for the gateway's access log and sent as OFFLINE_LOG once it answers again.
+ * The queue is held in memory only, so it never puts credentials on disk; when full the oldest record is dropped and counted.
+ * Timestamps are passed in by the caller (wall clock seconds in MainApplication). Not thread-safe, it is used by the main loop only.
+*/
+class OfflineCache
+{
+public:
+	struct Limits
+	{
+		size_t m_maxEntries = 0;
+		int64_t m_ttl_s = 0;
+		size_t m_maxQueuedLogs = 0;
+	};
+
+	/// Hours in a week, one slot each
+	static const unsigned int SLOTS = 7 * 24;
+
+	/**
+	 * @brief Reads the key from `path` + ".key", creating it if missing
+	 * @param path Cache file, empty to keep the cache in memory only (with a random key which is not stored)
+	*/
+	OfflineCache(const std::string& path, const Limits& limits, ILogger* pLogger = NulLogger::getInstance());
+
+	OfflineCache(const OfflineCache&) = delete;
+	OfflineCache& operator=(const OfflineCache&) = delete;
+
+	/// Records the gateway's `clearance` for `credential` at door `doorId` (NO_CLEARANCE for a refusal)
+	void Learn(const InputParameter& credential, DoorId doorId, Clearance clearance, int64_t now_s);
+
+	/// Sets `clearance` to the gateway's last answer for `credential` at `doorId` in this hour of the week; false if there is none
+	bool Decide(const InputParameter& credential, DoorId doorId, int64_t now_s, Clearance& clearance) const;
+
+	/// Queues an authorization decided offline at `timestamp` (see Time::getDateTime_ISO8601) for the access log
+	void QueueLog(const InputParameter& credential, DoorId doorId, const std::string& timestamp);
+
+	/**
+	 * @brief Sends up to `maxCount` queued records to `gateway` as OFFLINE_LOG, stopping early when its mailbox is full
+	 * @return number of records sent
+	*/
+	size_t DeliverLogs(DataMailbox& mailbox, MailboxReference& gateway, size_t maxCount);
+
+	/// Replaces the entries with those of the cache file which have not expired at `now_s`. False if there is no valid file.
+	bool Load(int64_t now_s);
+
+	/// Writes the entries to a temporary file and renames it to the cache file, so a crash never leaves a partial file
+	bool Save(int64_t now_s);
+
+	/// True if entries were learned since the last `Save` or `Load`
+	bool isDirty() const { return m_bDirty; }
+
+	size_t getEntryCount() const { return m_entries.size(); }
+	size_t getQueuedLogCount() const { return m_logs.size(); }
+	size_t getDroppedLogCount() const { return m_droppedLogs; }
+
+	/// Slot of `now_s` in local time: hours since Sunday midnight
+	static unsigned int SlotOf(int64_t now_s);
+
+private:
+	struct Entry
+	{
+		uint64_t m_key;
+		int64_t m_confirmed_s;
+		Clearance m_clearance;
+		/// Slots in which the gateway granted (m_granted) or refused (m_refused) the credential last
+		uint32_t m_granted[(SLOTS + 31) / 32];
+		uint32_t m_refused[(SLOTS + 31) / 32];
+	};
+
+	struct QueuedLog
+	{
+		InputParameter m_credential;
+		DoorId m_doorId;
+		std::string m_timestamp;
+	};
+
+	struct FileHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_formatVersion;
+		uint32_t m_count;
+		uint32_t m_reserved;
+		int64_t m_savedAt_s;
+	};
+
+	static const uint32_t MAGIC = 0x43464F4E; // "NOFC" on little-endian hosts
+	static const uint32_t FORMAT_VERSION = 1;
+
+	ILogger* m_pLogger;
+	std::string m_path;
+	Limits m_limits;
+	std::string m_key;
+	bool m_bDirty;
+
+	/// Most recently confirmed first
+	std::list<Entry> m_entries;
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+
+	std::deque<QueuedLog> m_logs;
+	size_t m_droppedLogs;
+
+	uint64_t keyOf(const InputParameter& credential, DoorId doorId) const;
+	bool isExpired(const Entry& entry, int64_t now_s) const;
+	void insert(const Entry& entry);
+
+	/// Reads the key file, or creates it with a random key readable by the owner only
+	bool loadKey(const std::string& keyPath);
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SESSION_TABLE_HPP
+#define SESSION_TABLE_HPP
+
+#include "DataMailbox.hpp"
+#include "IndicatorController.hpp"
+#include "MainAutomaton.hpp"
+
+#include <map>
+#include <memory>
+
+class AutomatonPairFactory;
+class OfflineCache;
+
+/**
+ * @brief Independent MainAutomaton/KeypadAutomaton pairs, one per door, so a slow request at one door does not
+ * hold back the others.
+ *
+ * Messages are routed by the door ID they carry; messages of doors which were not added are discarded. A database reply is delivered only if its request ID is the one the
+ * session is waiting for; replies to requests which timed out or were decided offline are discarded.
+*/
+class SessionTable
+{
+public:
+	SessionTable(DataMailbox* pMailbox,
+		MailboxReference* pRefDatabase,
+		DoorIndicators* pIndicators,
+		ILogger* pLogger = NulLogger::getInstance());
+
+	~SessionTable();
+
+	SessionTable(const SessionTable&) = delete;
+	SessionTable& operator=(const SessionTable&) = delete;
+
+	/// Creates the session of door `doorId`, one of the configured doors
+	void AddDoor(DoorId doorId);
+
+	/// Hands `pEvent` (built from `pMessage`) to the session of the message's door. Takes ownership of `pEvent`.
+	void Dispatch(DataMailboxMessage* pMessage, OWNER MainAutomatonEvent* pEvent);
+
+	/// Times out every session whose database reply is overdue at `now`
+	void CheckDeadlines(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+	/// Lets every session, existing and added later, decide from `pCache` when the database is `deadline` late (see KeypadAutomaton::CheckDeadline)
+	void setOfflineCache(OfflineCache* pCache, std::chrono::milliseconds deadline);
+
+	size_t getSessionCount() const { return m_sessions.size(); }
+
+private:
+	ILogger* m_pLogger;
+	DataMailbox* m_pMailbox;
+	MailboxReference* m_pRefDatabase;
+	DoorIndicators* m_pIndicators;
+
+	/// Guest access is a property of the whole installation, not of one door
+	bool m_bGuestAccessEnable;
+
+	OfflineCache* m_pOfflineCache;
+	std::chrono::milliseconds m_offlineDeadline;
+
+	std::map<DoorId, std::unique_ptr<AutomatonPairFactory>> m_sessions;
+
+	/// Session of door `doorId`, nullptr if the door was not added
+	AutomatonPairFactory* getSession(DoorId doorId) const;
+};
+
+#endif
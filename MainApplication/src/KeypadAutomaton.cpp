@@ -25,6 +25,8 @@
 #include "KeypadAutomaton.hpp"
 
 #include "MainAutomaton.hpp"
+#include "OfflineCache.hpp"
+#include "propertiesclass.h"
 
 #ifdef AUT_ACTION
 #undef AUT_ACTION
@@ -33,14 +35,17 @@
 #define AUT_ACTION(X) (bool (MAutomat::*)(MAutEvent*)) &KeypadAutomaton::X
 
 #include<sstream>
-
-const unsigned int deadlineTimerTimeout_s = 30;
+#include<ctime>
 
 
 // OWNER MainAutomatonEvent* parseMessageForMainAutomaton(DataMailboxMessage* pMessage);
 
 OWNER KeypadAutomatonEvent* preprocessEvent(MAutEvent* pEvent);
 OWNER KeypadAutomatonEvent* parseClearanceToEvent(KeypadAutomatonEvent* pEvent);
+KeypadAutomaton::enuAutEventType eventForClearance(Clearance clearance);
+
+/// Unique among the requests of this process; seeded from the clock so replies to a previous instance do not match
+RequestId nextRequestId();
 
 
 KeypadAutomatonEvent::KeypadAutomatonEvent(int idEvent, DataMailboxMessage* pMessage)
@@ -127,22 +132,31 @@ KeypadAutomatonEvent::KeypadAutomatonEvent(int idEvent, DataMailboxMessage* pMes
 KeypadAutomaton::KeypadAutomaton(short int siInstID,
 	DataMailbox* pMailbox,
 	MailboxReference* pRefDatabase,
-	IndicatorController_Client* pIndicators,
+	DoorIndicators* pIndicators,
 	ILogger* pLogger)
 	: MAutomat(siInstID),
+	m_pLogger(pLogger),
 	m_pMailbox(pMailbox),
 	m_pRefDatabase(pRefDatabase),
 	m_pIndicators(pIndicators),
-	m_pLogger(pLogger),
-	m_deadlineTimer("keypad.automaton.timer", pLogger),
-	m_timeoutCallback(this, &KeypadAutomaton::doSendTimeoutEvent_timerWrapper)
+	m_activeDoor(NO_DOOR),
+	m_pendingRequest(NO_REQUEST),
+	m_bDeadlineActive(false),
+	m_pOfflineCache(nullptr),
+	m_bOfflineEligible(false),
+	m_offlineTimeout(0),
+	m_grantedCounter(MetricsRegistry::Process().getCounter("access.granted")),
+	m_deniedCounter(MetricsRegistry::Process().getCounter("access.denied")),
+	m_invalidCounter(MetricsRegistry::Process().getCounter("access.invalid")),
+	m_errorCounter(MetricsRegistry::Process().getCounter("access.errors")),
+	m_timeoutCounter(MetricsRegistry::Process().getCounter("access.timeouts")),
+	m_offlineCounter(MetricsRegistry::Process().getCounter("access.offline")),
+	m_decisionLatency(MetricsRegistry::Process().getHistogram("access.decision_ns"))
 {
 	if (pLogger == nullptr)
 		m_pLogger = NulLogger::getInstance();
 
-	m_deadlineTimer.setTimeoutCallback(&m_timeoutCallback);
-	m_deadlineTimer.setTimeout_s(deadlineTimerTimeout_s);
-
+	setTraceName("KeypadAutomaton");
 
 	/**********************************************
 	* TRANSITION TABLE INITIALIZATION            *
@@ -222,6 +236,12 @@ void KeypadAutomaton::setMainAutomatonPointer(MainAutomaton* pMainAutomaton)
 	m_pMainAutomaton = pMainAutomaton;
 }
 
+void KeypadAutomaton::setOfflineCache(OfflineCache* pCache, std::chrono::milliseconds deadline)
+{
+	m_pOfflineCache = pCache;
+	m_offlineTimeout = deadline;
+}
+
 bool KeypadAutomaton::initialize()
 {
 	if (m_pMainAutomaton == nullptr)
@@ -253,8 +273,16 @@ bool KeypadAutomaton::initialize()
 
 bool KeypadAutomaton::processEvent(MAutEvent* pEvent)
 {
+	learnFromReply(pEvent);
+
 	KeypadAutomatonEvent* pPreProcessedEvent = preprocessEvent(pEvent);
 
+	// Transitions are recorded to the trace ring, the text log is for debugging only
+	if (!isTracing())
+	{
+		return MAutomat::processEvent(pPreProcessedEvent);
+	}
+
 	// Save the event before calling processEvent because it frees the event object.
 	TransitionInfo info = getTransitionInfo(pPreProcessedEvent);
 
@@ -294,20 +322,21 @@ bool KeypadAutomaton::doVoid(MAutEvent* pEvent)
 
 bool KeypadAutomaton::doSignalTimeout(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop(); // TODO EXTRA?
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
 	signalFinishToMainAutomaton_wTempMessage("Timed out!");
 	return true;
 }
 
 bool KeypadAutomaton::doOpenDoors(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
+	stopDeadline();
 
-	m_pIndicators->LCD_Clear_wDefaultMsg();
+	activeIndicators()->LCD_Clear_wDefaultMsg();
 	// m_pIndicators->LCD_Put_wTimeout("Doors Open!");
 
-	m_pIndicators->OpenDoor_wBuzzerSuccess();
+	activeIndicators()->OpenDoor_wBuzzerSuccess();
+	m_grantedCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Doors Open!");
 	
 	return true;
@@ -324,18 +353,50 @@ bool KeypadAutomaton::doSendRequestToDB(MAutEvent* pEvent)
 		return false;
 	}
 
+	m_activeDoor = getDoorId(pDatabaseRequest->m_pMessage);
+
+	CommandMessage* pRequestMessage = dynamic_cast<CommandMessage*>(pDatabaseRequest->m_pMessage);
+	if (pRequestMessage == nullptr)
+	{
+		reset();
+		return false;
+	}
+
 	*m_pLogger << "### Before putting to LCD";
 
-	m_pIndicators->LCD_Put_Permanently("Request sent...");
+	activeIndicators()->LCD_Put_Permanently("Request sent...");
 
 	*m_pLogger << "### After putting to LCD";
 	*m_pLogger << "### Before sending to database";
 
-	m_pMailbox->send(*m_pRefDatabase, pDatabaseRequest->m_pMessage);
+	// Only a plain AUTHENTICATE is learned and may be decided offline, commands need the database
+	m_bOfflineEligible = m_pOfflineCache != nullptr
+		&& pRequestMessage->getCommandId() == CommandMessage::enuCommand::AUTHENTICATE
+		&& pRequestMessage->getParameterCount() == 1;
+	m_pendingCredential = m_bOfflineEligible ? pRequestMessage->getParameterAt(0) : InputParameter();
+
+	// The reply is matched by its ID, so the session does not wait for the database to take the request;
+	// a lost request ends in the deadline like a lost reply
+	m_pendingRequest = nextRequestId();
+	pRequestMessage->setRequestId(m_pendingRequest);
+
+	// A full mailbox means the gateway is not reading it, sending would block every door until it does
+	const bool sent = !m_pRefDatabase->isFull();
+	if (sent)
+	{
+		m_pMailbox->sendConnectionless(*m_pRefDatabase, pRequestMessage);
+	}
 
 	*m_pLogger << "### After sending to database";
 
-	m_deadlineTimer.Start();
+	startDeadline();
+
+	if (!sent)
+	{
+		*m_pLogger << "KeypadAutomaton - database mailbox full, request not sent";
+		m_deadline = m_requestSent;
+		m_offlineDeadline = m_requestSent;
+	}
 
 	*m_pLogger << "### END";
 
@@ -344,8 +405,8 @@ bool KeypadAutomaton::doSendRequestToDB(MAutEvent* pEvent)
 
 bool KeypadAutomaton::doSignalSuccess(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
-	m_pIndicators->BuzzerSuccess();
+	stopDeadline();
+	activeIndicators()->BuzzerSuccess();
 	signalFinishToMainAutomaton_wTempMessage("Success!");
 	return true;
 }
@@ -358,61 +419,72 @@ bool KeypadAutomaton::doOpenDoorsAndSignalSuccess(MAutEvent* pEvent)
 
 bool KeypadAutomaton::doSignalError(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
+	m_errorCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Error!");
 	return true;
 }
 
 bool KeypadAutomaton::doSignalInvalidCommand(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
+	m_invalidCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Invalid command!");
 	return true;
 }
 
 bool KeypadAutomaton::doSignalInvalidParameter(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
+	m_invalidCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Invalid parameter!");
 	return true;
 }
 
 bool KeypadAutomaton::doSignalInsufficientPermissions(MAutEvent* pEvent)
 {
-	m_deadlineTimer.Stop();
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
+	m_deniedCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Insufficient Permissions!");
 	return true;
 }
 
 bool KeypadAutomaton::doSignalBusy(MAutEvent* pEvent)
 {
-	m_pIndicators->BuzzerPing();
-	m_pIndicators->LCD_Put_wTimeout("Device busy...");
+	// Shown at the door which sent the rejected request, not at the one being served
+	KeypadAutomatonEvent* pParsedEvent = dynamic_cast<KeypadAutomatonEvent*>(pEvent);
+	IndicatorController_Client* pIndicators = m_pIndicators->get(pParsedEvent ? getDoorId(pParsedEvent->m_pMessage) : m_activeDoor);
+
+	pIndicators->BuzzerPing();
+	pIndicators->LCD_Put_wTimeout("Device busy...");
 
 	return true;
 }
 
 bool KeypadAutomaton::doCancelAction(MAutEvent* pEvent)
 {
-	m_pIndicators->BuzzerFailure();
+	activeIndicators()->BuzzerFailure();
 	signalFinishToMainAutomaton_wTempMessage("Canceled action!");
 	return true;
 }
 
 bool KeypadAutomaton::doSignalGuestAccessDenied(MAutEvent* pEvent)
 {
-	m_pIndicators->BuzzerFailure();
+	stopDeadline();
+	activeIndicators()->BuzzerFailure();
+	m_deniedCounter.Increment();
 	signalFinishToMainAutomaton_wTempMessage("Access disabled for guests!");
 	return true;
 }
 
 bool KeypadAutomaton::doEnableGuestAccess(MAutEvent* pEvent)
 {
-	m_pMainAutomaton->m_bGuestAccessEnable = true;
+	stopDeadline();
+	m_pMainAutomaton->setGuestAccessEnabled(true);
 
 	signalFinishToMainAutomaton_wTempMessage("Guest Access Enabled!");
 
@@ -421,7 +493,8 @@ bool KeypadAutomaton::doEnableGuestAccess(MAutEvent* pEvent)
 
 bool KeypadAutomaton::doDisableGuestAccess(MAutEvent* pEvent)
 {
-	m_pMainAutomaton->m_bGuestAccessEnable = false;
+	stopDeadline();
+	m_pMainAutomaton->setGuestAccessEnabled(false);
 
 	signalFinishToMainAutomaton_wTempMessage("Guest Access Disabled!");
 
@@ -430,7 +503,7 @@ bool KeypadAutomaton::doDisableGuestAccess(MAutEvent* pEvent)
 
 bool KeypadAutomaton::doOpenDoorsIfAuthorized(MAutomat* pEvent)
 {
-	if (m_pMainAutomaton->m_bGuestAccessEnable == true)
+	if (m_pMainAutomaton->isGuestAccessEnabled() == true)
 	{
 		doOpenDoorsAndSignalSuccess(nullptr);
 		return true;
@@ -458,11 +531,101 @@ void KeypadAutomaton::signalFinishToMainAutomaton()
 }
 
 
-void KeypadAutomaton::doSendTimeoutEvent_timerWrapper(void*)
+void KeypadAutomaton::CheckDeadline(std::chrono::steady_clock::time_point now)
 {
+	if (m_bDeadlineActive == false)
+	{
+		return;
+	}
+
+	// Tried once; without an answer in the cache the request waits for the gateway as if there were no cache
+	if (m_bOfflineEligible && now >= m_offlineDeadline)
+	{
+		m_bOfflineEligible = false;
+		if (decideOffline())
+		{
+			return;
+		}
+	}
+
+	if (now < m_deadline)
+	{
+		return;
+	}
+
+	// Dropped without stopDeadline(), a timed out request is not a decision
+	m_bDeadlineActive = false;
+	m_pendingRequest = NO_REQUEST;
+	m_pendingCredential = InputParameter();
+	m_timeoutCounter.Increment();
+
 	processEvent(new KeypadAutomatonEvent(enuEvtTimedOut, nullptr));
 }
 
+void KeypadAutomaton::startDeadline()
+{
+	m_requestSent = std::chrono::steady_clock::now();
+	m_deadline = m_requestSent + std::chrono::seconds(GlobalProperties::Get().REQUEST_DEADLINE_TIMER_TIMEOUT_S);
+	m_offlineDeadline = m_requestSent + m_offlineTimeout;
+	m_bDeadlineActive = true;
+}
+
+bool KeypadAutomaton::decideOffline()
+{
+	if (m_pOfflineCache == nullptr || getCurrentStateId() != enuWaitingDatabase_Authorize)
+	{
+		return false;
+	}
+
+	Clearance clearance = NO_CLEARANCE;
+	if (m_pOfflineCache->Decide(m_pendingCredential, m_activeDoor, (int64_t)time(nullptr), clearance) == false)
+	{
+		*m_pLogger << "KeypadAutomaton - database late, no offline answer for door " + std::to_string(m_activeDoor);
+		return false;
+	}
+
+	*m_pLogger << "KeypadAutomaton - database late, decided offline at door " + std::to_string(m_activeDoor) + " with clearance " + std::to_string((int)clearance);
+	m_offlineCounter.Increment();
+	m_pOfflineCache->QueueLog(m_pendingCredential, m_activeDoor, Time::getDateTime_ISO8601());
+
+	// Handled like the reply would have been; stopDeadline() forgets the request, so the late reply is discarded
+	processEvent(new KeypadAutomatonEvent(eventForClearance(clearance), nullptr));
+	return true;
+}
+
+void KeypadAutomaton::learnFromReply(MAutEvent* pEvent)
+{
+	KeypadAutomatonEvent* pParsedEvent = dynamic_cast<KeypadAutomatonEvent*>(pEvent);
+	if (m_pOfflineCache == nullptr || pParsedEvent == nullptr
+		|| pParsedEvent->getEventId() != enuEvtReceivedClearanceFromDB
+		|| getCurrentStateId() != enuWaitingDatabase_Authorize
+		|| m_pendingCredential.getType() == InputParameter::enuType::Empty)
+	{
+		return;
+	}
+
+	DatabaseReply* pReply = dynamic_cast<DatabaseReply*>(pParsedEvent->m_pMessage);
+	if (pReply == nullptr || pReply->getReplyStatus() != DatabaseReply::enuStatus::CLEARANCE)
+	{
+		return;
+	}
+
+	m_pOfflineCache->Learn(m_pendingCredential, m_activeDoor, pReply->getClearance(), (int64_t)time(nullptr));
+}
+
+void KeypadAutomaton::stopDeadline()
+{
+	if (m_bDeadlineActive)
+	{
+		m_decisionLatency.Record(std::chrono::steady_clock::now() - m_requestSent);
+	}
+
+	m_bDeadlineActive = false;
+	m_bOfflineEligible = false;
+	m_pendingRequest = NO_REQUEST;
+	m_pendingCredential = InputParameter();
+}
+
 TransitionInfo KeypadAutomaton::getTransitionInfo(MAutEvent* pReceivedEvent)
 {
 	if (pReceivedEvent == nullptr)
@@ -564,22 +727,49 @@ OWNER KeypadAutomatonEvent* parseClearanceToEvent(KeypadAutomatonEvent* pEvent)
 		return nullptr;
 	}
 
+	return new KeypadAutomatonEvent(eventForClearance(pReplyMessage->getClearance()), pReplyMessage);
+}
+
+KeypadAutomaton::enuAutEventType eventForClearance(Clearance clearance)
+{
 	// TODO
-	if (pReplyMessage->getClearance() > 0)
+	if (clearance > 0)
 	{
-		return new KeypadAutomatonEvent(KeypadAutomaton::enuEvtSuccess, pReplyMessage);
+		return KeypadAutomaton::enuEvtSuccess;
 	}
-	else if(pReplyMessage->getClearance() == 0)
+	else if (clearance == 0)
 	{
-		return new KeypadAutomatonEvent(KeypadAutomaton::enuEvtSuccess_Guest, pReplyMessage);
+		return KeypadAutomaton::enuEvtSuccess_Guest;
 	}
 	else
 	{
-		return new KeypadAutomatonEvent(KeypadAutomaton::enuEvtInsufficientPermissions, pReplyMessage);
+		return KeypadAutomaton::enuEvtInsufficientPermissions;
 	}
+}
 
+DoorId getDoorId(DataMailboxMessage* pMessage)
+{
+	if (CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage))
+	{
+		return pCommand->getDoorId();
+	}
+
+	if (DatabaseReply* pReply = dynamic_cast<DatabaseReply*>(pMessage))
+	{
+		return pReply->getDoorId();
+	}
 
+	return NO_DOOR;
 }
 
+RequestId nextRequestId()
+{
+	static RequestId requestId = (RequestId)std::chrono::steady_clock::now().time_since_epoch().count();
 
+	if (++requestId == NO_REQUEST)
+	{
+		++requestId;
+	}
 
+	return requestId;
+}
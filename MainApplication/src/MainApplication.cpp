@@ -31,10 +31,13 @@
 #include<string>
 #include<errno.h>
 #include<signal.h>
+#include<ctime>
+#include<memory>
 
 #include"Settings.hpp"
 #include"DataMailbox.hpp"
-#include"AutomatonPairFactory.hpp"
+#include"SessionTable.hpp"
+#include"OfflineCache.hpp"
 #include"WatchdogClient.hpp"
 #include"IndicatorController.hpp"
 #include "propertiesclass.h"
@@ -48,19 +51,31 @@ const std::string DATABASE_GATEWAY_MAILBOX_NAME = GlobalProperties::Get().DBGW_M
 const MailboxReference refKeypadMailbox(HARDWARED_MAILBOX_NAME);
 const MailboxReference refDatabaseMailbox(DATABASE_GATEWAY_MAILBOX_NAME);
 
+/// Dirty offline cache entries are written at most this often, and at exit
+const unsigned int OFFLINE_CACHE_SAVE_PERIOD_S = 60;
+/// Queued offline log records sent per gateway reply, leaves room in its mailbox for the doors' requests
+const size_t OFFLINE_LOGS_PER_REPLY = 4;
+
 
 OWNER MainAutomatonEvent* parseMessageToMainAutomatonEvent(DataMailboxMessage* pMessage);
+void traceLatency(DataMailboxMessage* pMessage, DoorIndicators& indicators);
 
 int main(void)
 {
 
     UNIX_SignalHandler::bindSignalToFlag(UNIX_SignalHandler::enuSIGTERM, &globalTerminateFlag);
 
+    // The offline deadline is live, the main loop applies it between messages
+    PropertiesChangeFlag configChange;
+    GlobalProperties::Subscribe(&configChange);
+    GlobalProperties::StartWatching();
+
     Logger mailbox_logger("main.mailbox.log");
     Logger main_aut_logger("main.automaton.log");
     Logger keypad_aut_logger("keypad.automaton.log");
     Logger watchdog_logger("main.watchdog.log");
     Logger indicators_logger("indicators.client.log");
+    Logger offline_logger("main.offline.log");
 
     const SlotSettings settings =
     {
@@ -80,32 +95,85 @@ int main(void)
     timespec timeoutSettings = Time::getTimespecFrom_ms(10);
     mailbox.setTimeout_settings(timeoutSettings);
 
+    // Requests carry the ID of the door they came from; results are shown at that door
     const std::string INDICATORS_MAILBOX_NAME = GlobalProperties::Get().INDICATORS_MAILBOX_NAME;
-    IndicatorController_Client indicators(INDICATORS_MAILBOX_NAME, &indicators_logger);
+    DoorIndicators indicators(&indicators_logger);
+    for (const DoorProperties& door : GlobalProperties::Get().DOORS)
+    {
+        indicators.AddDoor(door.ID, INDICATORS_MAILBOX_NAME);
+    }
 
-    AutomatonPairFactory automata(&mailbox, &databaseGateway, &indicators, &main_aut_logger);
+    // Every door has its own session, so doors do not wait for each other's database replies
+    SessionTable sessions(&mailbox, &databaseGateway, &indicators, &main_aut_logger);
+    for (const DoorProperties& door : GlobalProperties::Get().DOORS)
+    {
+        sessions.AddDoor(door.ID);
+    }
 
-    MainAutomaton& mainAutomaton = automata.getMainAutomatonReference();
-    KeypadAutomaton& keypadAutomaton = automata.getKeypadAutomatonReference();
+    // Doors keep working from the gateway's last answers while it restarts or stalls
+    std::unique_ptr<OfflineCache> pOfflineCache;
+    if (!GlobalProperties::Get().OFFLINE_CACHE_PATH.empty())
+    {
+        OfflineCache::Limits limits;
+        limits.m_maxEntries = GlobalProperties::Get().OFFLINE_CACHE_ENTRIES;
+        limits.m_ttl_s = GlobalProperties::Get().OFFLINE_CACHE_TTL_S;
+        limits.m_maxQueuedLogs = GlobalProperties::Get().OFFLINE_LOG_QUEUE_SIZE;
+
+        pOfflineCache.reset(new OfflineCache(GlobalProperties::Get().OFFLINE_CACHE_PATH, limits, &offline_logger));
+        pOfflineCache->Load(time(nullptr));
+        sessions.setOfflineCache(pOfflineCache.get(), std::chrono::milliseconds(GlobalProperties::Get().OFFLINE_DEADLINE_MS));
+    }
+    time_t lastOfflineSave = time(nullptr);
 
     watchdog.Start();
     while (!globalTerminateFlag && watchdog.Kick() )
     {
         DataMailboxMessage* pMessage = mailbox.receive(enuReceiveOptions::TIMED);
 
+        sessions.CheckDeadlines();
+
+        std::vector<std::string> restartRequired;
+        if (configChange.TakeChange(restartRequired) && pOfflineCache)
+        {
+            sessions.setOfflineCache(pOfflineCache.get(), std::chrono::milliseconds(GlobalProperties::Get().OFFLINE_DEADLINE_MS));
+            offline_logger << "Config reloaded, offline deadline " + std::to_string(GlobalProperties::Get().OFFLINE_DEADLINE_MS) + " ms";
+        }
+
+        if (pOfflineCache && pOfflineCache->isDirty() && time(nullptr) - lastOfflineSave >= OFFLINE_CACHE_SAVE_PERIOD_S)
+        {
+            pOfflineCache->Save(time(nullptr));
+            lastOfflineSave = time(nullptr);
+        }
+
         if (pMessage->getDataType() == MessageDataType::enuType::DataMailboxErrorMessage)
         {
             delete pMessage;
             continue;
         }
 
+        // A reply shows the gateway reads its mailbox again, records of offline decisions follow it
+        if (pOfflineCache && pMessage->getSource() == refDatabaseMailbox && pOfflineCache->getQueuedLogCount() > 0)
+        {
+            pOfflineCache->DeliverLogs(mailbox, databaseGateway, OFFLINE_LOGS_PER_REPLY);
+        }
+
+        traceLatency(pMessage, indicators);
+
         MainAutomatonEvent* pEvent = parseMessageToMainAutomatonEvent(pMessage);
-        mainAutomaton.processEvent(pEvent);
+        sessions.Dispatch(pMessage, pEvent);
         
         delete pMessage;
     }
 
+    if (pOfflineCache && pOfflineCache->isDirty())
+    {
+        pOfflineCache->Save(time(nullptr));
+    }
+
     watchdog_logger << "Program ended. Terminate flag: " + std::to_string(globalTerminateFlag);
+
+    GlobalProperties::StopWatching();
+    GlobalProperties::Unsubscribe(&configChange);
 }
 
 OWNER MainAutomatonEvent* parseMessageToMainAutomatonEvent(DataMailboxMessage* pMessage)
@@ -128,3 +196,23 @@ OWNER MainAutomatonEvent* parseMessageToMainAutomatonEvent(DataMailboxMessage* p
 
     return nullptr;
 }
+
+/// Stamps traced messages; the trace of a reply goes with the outcome shown at its door
+void traceLatency(DataMailboxMessage* pMessage, DoorIndicators& indicators)
+{
+    if (CommandMessage* pRequest = dynamic_cast<CommandMessage*>(pMessage))
+    {
+        if (!pRequest->getTrace().empty())
+        {
+            pRequest->getTrace().Mark(LatencyTrace::MAIN_RECEIVED);
+        }
+    }
+    else if (DatabaseReply* pReply = dynamic_cast<DatabaseReply*>(pMessage))
+    {
+        if (!pReply->getTrace().empty())
+        {
+            pReply->getTrace().Mark(LatencyTrace::MAIN_REPLY_RECEIVED);
+            indicators.get(pReply->getDoorId())->AttachTrace(pReply->getTrace());
+        }
+    }
+}
@@ -62,16 +62,19 @@ MainAutomatonEvent::MainAutomatonEvent(int idEvent, DataMailboxMessage* pMessage
 }
 
 MainAutomaton::MainAutomaton(short int siInstID,
-	IndicatorController_Client* pIndicators,
+	DoorIndicators* pIndicators,
+	bool* pGuestAccessEnable,
 	ILogger* pLogger)
 	:	MAutomat(siInstID),
 	m_pIndicators(pIndicators),
-	m_pLogger(pLogger),
-	m_bGuestAccessEnable(true)
+	m_pGuestAccessEnable(pGuestAccessEnable),
+	m_pLogger(pLogger)
 {
 	if (pLogger == nullptr)
 		m_pLogger = NulLogger::getInstance();
 
+	setTraceName("MainAutomaton");
+
 	/**********************************************
 	 * TRANSITION TABLE INITIALIZATION            *
 	 **********************************************/
@@ -111,12 +114,24 @@ bool MainAutomaton::initialize()
 		Kernel::Fatal_Error("Main automaton - Indicator Controller is nullptr!");
 	}
 
+	if (m_pGuestAccessEnable == nullptr)
+	{
+		*m_pLogger << "Main automaton - guest access flag is nullptr!";
+		Kernel::Fatal_Error("Main automaton - guest access flag is nullptr!");
+	}
+
 	return this->test();
 }
 
 bool MainAutomaton::processEvent(MAutEvent* pEvent)
 {
 
+	// Transitions are recorded to the trace ring, the text log is for debugging only
+	if (!isTracing())
+	{
+		return MAutomat::processEvent(pEvent);
+	}
+
 	// Save the event before calling processEvent because it frees the event object.
 	TransitionInfo info = getTransitionInfo(pEvent);
 
@@ -156,7 +171,10 @@ bool MainAutomaton::doVoid(MAutEvent* pEvent)
 
 bool MainAutomaton::doDisplayTempMsg_AndClear(MAutEvent* pEvent)
 {
-	m_pIndicators->LCD_Clear_wDefaultMsg();
+	// The result belongs to the door whose request the keypad automaton just finished
+	IndicatorController_Client* pIndicators = m_pIndicators->get(m_pKeypadAutomaton->getActiveDoor());
+
+	pIndicators->LCD_Clear_wDefaultMsg();
 
 	MainAutomatonEvent* pParsedEvent = dynamic_cast<MainAutomatonEvent*>(pEvent);
 
@@ -174,7 +192,7 @@ bool MainAutomaton::doDisplayTempMsg_AndClear(MAutEvent* pEvent)
 	}
 
 	const std::string message = pParsedMessage->getParameterAt(0).getData();
-	m_pIndicators->LCD_Put_wTimeout(message);
+	pIndicators->LCD_Put_wTimeout(message);
 
 	delete pParsedMessage;
 
@@ -0,0 +1,400 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "OfflineCache.hpp"
+
+#include "Sha256.hpp"
+#include "Kernel.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+namespace
+{
+	const size_t KEY_SIZE = 32;
+
+	void setBit(uint32_t* pBits, unsigned int bit) { pBits[bit / 32] |= (1u << (bit % 32)); }
+	void clearBit(uint32_t* pBits, unsigned int bit) { pBits[bit / 32] &= ~(1u << (bit % 32)); }
+	bool testBit(const uint32_t* pBits, unsigned int bit) { return (pBits[bit / 32] >> (bit % 32)) & 1u; }
+
+	/// Compares in time independent of where the signatures differ
+	bool sameDigest(const Sha256::Digest& a, const unsigned char* b)
+	{
+		unsigned char difference = 0;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			difference |= a[i] ^ b[i];
+		}
+
+		return difference == 0;
+	}
+}
+
+OfflineCache::OfflineCache(const std::string& path, const Limits& limits, ILogger* pLogger)
+	: m_pLogger(pLogger),
+	m_path(path),
+	m_limits(limits),
+	m_bDirty(false),
+	m_droppedLogs(0)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	if (m_path.empty() || loadKey(m_path + ".key") == false)
+	{
+		if (!m_path.empty())
+		{
+			*m_pLogger << "OfflineCache - cannot use key file " + m_path + ".key, the cache is kept in memory only";
+			Kernel::Warning("OfflineCache - cannot use key file " + m_path + ".key, the cache is kept in memory only");
+			m_path.clear();
+		}
+
+		m_key.resize(KEY_SIZE);
+		if (getrandom(&m_key[0], KEY_SIZE, 0) != static_cast<ssize_t>(KEY_SIZE))
+		{
+			Kernel::Fatal_Error("OfflineCache - getrandom failed");
+		}
+	}
+}
+
+void OfflineCache::Learn(const InputParameter& credential, DoorId doorId, Clearance clearance, int64_t now_s)
+{
+	if (m_limits.m_maxEntries == 0)
+	{
+		return;
+	}
+
+	const uint64_t key = keyOf(credential, doorId);
+	const unsigned int slot = SlotOf(now_s);
+
+	Entry entry;
+	std::memset(&entry, 0, sizeof(entry));
+	entry.m_key = key;
+
+	auto found = m_index.find(key);
+	if (found != m_index.end())
+	{
+		entry = *found->second;
+		m_entries.erase(found->second);
+		m_index.erase(found);
+	}
+
+	entry.m_confirmed_s = now_s;
+	if (clearance == NO_CLEARANCE)
+	{
+		setBit(entry.m_refused, slot);
+		clearBit(entry.m_granted, slot);
+	}
+	else
+	{
+		entry.m_clearance = clearance;
+		setBit(entry.m_granted, slot);
+		clearBit(entry.m_refused, slot);
+	}
+
+	insert(entry);
+	m_bDirty = true;
+}
+
+bool OfflineCache::Decide(const InputParameter& credential, DoorId doorId, int64_t now_s, Clearance& clearance) const
+{
+	auto found = m_index.find(keyOf(credential, doorId));
+	if (found == m_index.end() || isExpired(*found->second, now_s))
+	{
+		return false;
+	}
+
+	const Entry& entry = *found->second;
+	const unsigned int slot = SlotOf(now_s);
+
+	if (testBit(entry.m_refused, slot))
+	{
+		clearance = NO_CLEARANCE;
+		return true;
+	}
+
+	if (testBit(entry.m_granted, slot))
+	{
+		clearance = entry.m_clearance;
+		return true;
+	}
+
+	return false;
+}
+
+void OfflineCache::QueueLog(const InputParameter& credential, DoorId doorId, const std::string& timestamp)
+{
+	if (m_limits.m_maxQueuedLogs == 0)
+	{
+		++m_droppedLogs;
+		return;
+	}
+
+	if (m_logs.size() >= m_limits.m_maxQueuedLogs)
+	{
+		m_logs.pop_front();
+		++m_droppedLogs;
+		*m_pLogger << "OfflineCache - log queue full, dropped the oldest record (" + std::to_string(m_droppedLogs) + " so far)";
+	}
+
+	m_logs.push_back({ credential, doorId, timestamp });
+}
+
+size_t OfflineCache::DeliverLogs(DataMailbox& mailbox, MailboxReference& gateway, size_t maxCount)
+{
+	size_t sent = 0;
+
+	// A full mailbox would block the main loop, the rest waits for the next reply
+	while (sent < maxCount && !m_logs.empty() && !gateway.isFull())
+	{
+		const QueuedLog& log = m_logs.front();
+
+		CommandMessage message(CommandMessage::enuCommand::OFFLINE_LOG);
+		message.setDoorId(log.m_doorId);
+		message.addParameter(log.m_credential);
+		message.addParameter({ InputParameter::enuType::PlainData, log.m_timestamp });
+		mailbox.sendConnectionless(gateway, &message);
+
+		m_logs.pop_front();
+		++sent;
+	}
+
+	return sent;
+}
+
+bool OfflineCache::Load(int64_t now_s)
+{
+	if (m_path.empty())
+	{
+		return false;
+	}
+
+	int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> content;
+	unsigned char buffer[4096];
+	ssize_t count;
+	while ((count = read(fd, buffer, sizeof(buffer))) > 0)
+	{
+		content.insert(content.end(), buffer, buffer + count);
+	}
+	close(fd);
+
+	const size_t signatureSize = std::tuple_size<Sha256::Digest>::value;
+	if (count < 0 || content.size() < sizeof(FileHeader) + signatureSize)
+	{
+		*m_pLogger << "OfflineCache - " + m_path + " is truncated, ignored";
+		return false;
+	}
+
+	const size_t signedSize = content.size() - signatureSize;
+	const Sha256::Digest signature = Sha256::Hmac(m_key, std::string(reinterpret_cast<const char*>(content.data()), signedSize));
+
+	FileHeader header;
+	std::memcpy(&header, content.data(), sizeof(header));
+
+	bool valid = sameDigest(signature, content.data() + signedSize)
+		&& header.m_magic == MAGIC
+		&& header.m_formatVersion == FORMAT_VERSION
+		&& header.m_reserved == 0
+		&& signedSize == sizeof(FileHeader) + static_cast<size_t>(header.m_count) * sizeof(Entry);
+
+	if (!valid)
+	{
+		*m_pLogger << "OfflineCache - " + m_path + " is not signed with this cache's key or is corrupted, ignored";
+		Kernel::Warning("OfflineCache - " + m_path + " is not signed with this cache's key or is corrupted, ignored");
+		return false;
+	}
+
+	m_entries.clear();
+	m_index.clear();
+
+	// Saved most recently confirmed last, so inserting at the front restores the order
+	const unsigned char* pRecord = content.data() + sizeof(FileHeader);
+	for (uint32_t i = 0; i < header.m_count; ++i, pRecord += sizeof(Entry))
+	{
+		Entry entry;
+		std::memcpy(&entry, pRecord, sizeof(entry));
+		if (!isExpired(entry, now_s) && m_index.count(entry.m_key) == 0)
+		{
+			insert(entry);
+		}
+	}
+
+	m_bDirty = false;
+	*m_pLogger << "OfflineCache - loaded " + std::to_string(m_entries.size()) + " entries from " + m_path;
+	return true;
+}
+
+bool OfflineCache::Save(int64_t now_s)
+{
+	if (m_path.empty())
+	{
+		return false;
+	}
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.m_magic = MAGIC;
+	header.m_formatVersion = FORMAT_VERSION;
+	header.m_count = static_cast<uint32_t>(m_entries.size());
+	header.m_savedAt_s = now_s;
+
+	std::string content(reinterpret_cast<const char*>(&header), sizeof(header));
+	content.reserve(sizeof(header) + m_entries.size() * sizeof(Entry) + std::tuple_size<Sha256::Digest>::value);
+
+	for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it)
+	{
+		// Copied field by field into a zeroed record, so padding bytes are signed as zeros
+		Entry record;
+		std::memset(&record, 0, sizeof(record));
+		record.m_key = it->m_key;
+		record.m_confirmed_s = it->m_confirmed_s;
+		record.m_clearance = it->m_clearance;
+		std::memcpy(record.m_granted, it->m_granted, sizeof(record.m_granted));
+		std::memcpy(record.m_refused, it->m_refused, sizeof(record.m_refused));
+		content.append(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+
+	const Sha256::Digest signature = Sha256::Hmac(m_key, content);
+	content.append(reinterpret_cast<const char*>(signature.data()), signature.size());
+
+	const std::string tmpPath = m_path + ".tmp";
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		*m_pLogger << "OfflineCache - cannot create " + tmpPath;
+		return false;
+	}
+
+	bool written = ::write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+	written &= (fsync(fd) == 0);
+	written &= (close(fd) == 0);
+
+	if (!written || std::rename(tmpPath.c_str(), m_path.c_str()) != 0)
+	{
+		*m_pLogger << "OfflineCache - cannot write " + m_path;
+		unlink(tmpPath.c_str());
+		return false;
+	}
+
+	m_bDirty = false;
+	return true;
+}
+
+unsigned int OfflineCache::SlotOf(int64_t now_s)
+{
+	const time_t now = static_cast<time_t>(now_s);
+	tm local;
+	localtime_r(&now, &local);
+
+	return static_cast<unsigned int>(local.tm_wday * 24 + local.tm_hour);
+}
+
+uint64_t OfflineCache::keyOf(const InputParameter& credential, DoorId doorId) const
+{
+	const std::string data = std::to_string(static_cast<int>(credential.getType())) + ":" + credential.getData() + ":" + std::to_string(doorId);
+	const Sha256::Digest digest = Sha256::Hmac(m_key, data);
+
+	uint64_t key = 0;
+	std::memcpy(&key, digest.data(), sizeof(key));
+	return key;
+}
+
+bool OfflineCache::isExpired(const Entry& entry, int64_t now_s) const
+{
+	return now_s - entry.m_confirmed_s > m_limits.m_ttl_s;
+}
+
+void OfflineCache::insert(const Entry& entry)
+{
+	while (m_entries.size() >= m_limits.m_maxEntries && !m_entries.empty())
+	{
+		m_index.erase(m_entries.back().m_key);
+		m_entries.pop_back();
+	}
+
+	m_entries.push_front(entry);
+	m_index[entry.m_key] = m_entries.begin();
+}
+
+bool OfflineCache::loadKey(const std::string& keyPath)
+{
+	int fd = open(keyPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		// First start: only one process may create the key, a second one reads the key of the first
+		unsigned char key[KEY_SIZE];
+		if (getrandom(key, sizeof(key), 0) != static_cast<ssize_t>(sizeof(key)))
+		{
+			return false;
+		}
+
+		fd = open(keyPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd >= 0)
+		{
+			bool written = ::write(fd, key, sizeof(key)) == static_cast<ssize_t>(sizeof(key));
+			written &= (close(fd) == 0);
+			if (!written)
+			{
+				unlink(keyPath.c_str());
+				return false;
+			}
+
+			m_key.assign(reinterpret_cast<const char*>(key), sizeof(key));
+			*m_pLogger << "OfflineCache - created key " + keyPath;
+			return true;
+		}
+
+		fd = open(keyPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			return false;
+		}
+	}
+
+	char key[KEY_SIZE];
+	bool valid = read(fd, key, sizeof(key)) == static_cast<ssize_t>(sizeof(key));
+	close(fd);
+
+	if (valid)
+	{
+		m_key.assign(key, sizeof(key));
+	}
+
+	return valid;
+}
@@ -0,0 +1,117 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SessionTable.hpp"
+
+#include "AutomatonPairFactory.hpp"
+
+SessionTable::SessionTable(DataMailbox* pMailbox,
+	MailboxReference* pRefDatabase,
+	DoorIndicators* pIndicators,
+	ILogger* pLogger)
+	:	m_pLogger(pLogger),
+	m_pMailbox(pMailbox),
+	m_pRefDatabase(pRefDatabase),
+	m_pIndicators(pIndicators),
+	m_bGuestAccessEnable(true),
+	m_pOfflineCache(nullptr),
+	m_offlineDeadline(0)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+}
+
+SessionTable::~SessionTable()
+{
+
+}
+
+void SessionTable::AddDoor(DoorId doorId)
+{
+	// Doors are numbered into the automaton instance IDs, see DoorProperties::MAX_ID
+	if (doorId == NO_DOOR || doorId > DoorProperties::MAX_ID)
+	{
+		*m_pLogger << "SessionTable - invalid door ID " + std::to_string(doorId);
+		Kernel::Fatal_Error("SessionTable - invalid door ID " + std::to_string(doorId));
+	}
+
+	std::unique_ptr<AutomatonPairFactory>& pSession = m_sessions[doorId];
+	pSession.reset(new AutomatonPairFactory(doorId, m_pMailbox, m_pRefDatabase, m_pIndicators, &m_bGuestAccessEnable, m_pLogger));
+	pSession->getKeypadAutomatonReference().setOfflineCache(m_pOfflineCache, m_offlineDeadline);
+}
+
+void SessionTable::Dispatch(DataMailboxMessage* pMessage, MainAutomatonEvent* pEvent)
+{
+	if (pEvent == nullptr)
+	{
+		return;
+	}
+
+	// NO_DOOR and doors which are not configured have no session
+	AutomatonPairFactory* pSession = getSession(getDoorId(pMessage));
+	if (pSession == nullptr)
+	{
+		*m_pLogger << "SessionTable - discarded message of unknown door " + std::to_string(getDoorId(pMessage));
+		delete pEvent;
+		return;
+	}
+
+	// Replies to OFFLINE_LOG carry no request ID, sessions never wait for them
+	DatabaseReply* pReply = dynamic_cast<DatabaseReply*>(pMessage);
+	if (pReply != nullptr && (pReply->getRequestId() == NO_REQUEST || pReply->getRequestId() != pSession->getKeypadAutomatonReference().getPendingRequest()))
+	{
+		*m_pLogger << "SessionTable - discarded stale reply: " + pReply->getInfo();
+		delete pEvent;
+		return;
+	}
+
+	pSession->getMainAutomatonReference().processEvent(pEvent);
+}
+
+void SessionTable::CheckDeadlines(std::chrono::steady_clock::time_point now)
+{
+	for (auto& session : m_sessions)
+	{
+		session.second->getKeypadAutomatonReference().CheckDeadline(now);
+	}
+}
+
+void SessionTable::setOfflineCache(OfflineCache* pCache, std::chrono::milliseconds deadline)
+{
+	m_pOfflineCache = pCache;
+	m_offlineDeadline = deadline;
+
+	for (auto& session : m_sessions)
+	{
+		session.second->getKeypadAutomatonReference().setOfflineCache(m_pOfflineCache, m_offlineDeadline);
+	}
+}
+
+AutomatonPairFactory* SessionTable::getSession(DoorId doorId) const
+{
+	auto it = m_sessions.find(doorId);
+	return it != m_sessions.end() ? it->second.get() : nullptr;
+}
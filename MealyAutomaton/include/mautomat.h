@@ -26,6 +26,7 @@
 #define MAUTOMAT_H
 
 #include "mautomatfunctor.h"
+#include "mauttrace.h"
 
 #include "Time.hpp"
 #include "Kernel.hpp"
@@ -33,31 +34,44 @@
 
 #include<string>
 #include<vector>
-#include<mutex>
 
 
 class MAutomat;
 /*!
-
+	Small value type: an ID, a static description and whatever payload a derived event adds.
+	Events can live on the stack and be passed to MAutomat::processEvent(MAutEvent&),
+	the description is only turned into a string when someone asks for it.
 */
 class MAutEvent
 {
 
 public:
 	MAutEvent();
-	MAutEvent(int iEventID, std::string sDesc, bool bHasData); //int IDEvent, std::string sDesc, bool bArgs
+	MAutEvent(int iEventID, const char* szDesc = "", bool bHasData = false);
 	
 	virtual ~MAutEvent();
 
-	int getEventId();
-	std::string getEventDesc();
-	bool hasData();
+	int getEventId() const;
+	std::string getEventDesc() const;
+	const char* getEventDescCStr() const;
+	bool hasData() const;
 
 protected:
 	int m_iEventID;
-	std::string m_sDesc;
+	const char* m_sDesc; // always a string literal
+	bool m_bHasData;
+};
+
+
+
+/*
+	What MAutomat keeps of every processed event, without the event itself
+*/
+struct MAutEventRecord
+{
+	int m_iEventID;
+	const char* m_szDesc;
 	bool m_bHasData;
-	std::mutex automatonMutex;
 };
 
 
@@ -106,6 +120,7 @@ public:
 
 	void addTransition(MAutTransition * pT);
 	MAutTransition * getTransition(int iEventID);
+	const std::vector <MAutTransition*>& getTransitions() const;
 
 	int getStateID();
 private:
@@ -145,6 +160,9 @@ public:
 
 	bool test();
 	virtual bool reset() = 0;
+	// Processes an event the caller keeps, e.g. one on the stack. Nothing is allocated.
+	virtual bool processEvent(MAutEvent & event);
+	// Processes a heap allocated event and deletes it if it was accepted
 	virtual bool processEvent(MAutEvent * event);
 
 
@@ -158,7 +176,14 @@ public:
 	void clearErrorStatus() { m_iErrorStatus = AUT_OK; }
 	
 	
+	// Text logging of every transition; the binary trace ring (see MAutTraceRing) is always on
 	void setTracing(bool bTrace); //the automat will not trace unles you initialize log file first 
+	bool isTracing() const { return m_bTrace; }
+
+	static const unsigned int EVENT_HISTORY_SIZE = 8;
+
+	// Event processed `age` events ago, 0 being the current one. ID -1 if there is no such event yet.
+	MAutEventRecord getLastEvent(unsigned int age = 0) const;
 	
 
 	void logToFile(const std::string &s);
@@ -169,7 +194,23 @@ protected:
 	void addAutState(MAutState * p);
 	MAutState * getCurrentState();
 
-	virtual void saveEvent(MAutEvent * event);
+	/// Checks and saves `event` before its transition is looked up; false if the event cannot be processed
+	bool acceptEvent(MAutEvent & event);
+	void setErrorStatus(enumErrorStatusTypes status) { m_iErrorStatus = status; }
+
+	/// True if the automaton has transitions; automatons with a static table override this
+	virtual bool isTableDefined() const;
+
+	/// Name the transitions of this automaton are recorded under in the trace ring
+	void setTraceName(const char* szName);
+
+	void traceTransition(int iFromState, int iEvent, int iToState, uint8_t status)
+	{
+		if(m_pTraceRing != nullptr)
+			m_pTraceRing->Record(m_usTraceName, m_siInstId, iFromState, iEvent, iToState, status);
+	}
+
+	virtual void saveEvent(const MAutEvent & event);
 
 	virtual void saveLastInputPck(std::string sInPCK);
 	virtual void saveLastOutputPck(std::string sOutPCK);
@@ -183,7 +224,12 @@ protected:
 	
 	int m_iCurrentEventID;
 
-	MAutEvent * m_pCurrentEvent;
+	MAutTraceRing * m_pTraceRing; // nullptr if tracing is off
+	uint16_t m_usTraceName;
+
+	// Ring of the last EVENT_HISTORY_SIZE events, filled by saveEvent()
+	MAutEventRecord m_eventHistory[EVENT_HISTORY_SIZE];
+	unsigned int m_uiEventCount;
 
 	std::string m_sLastInputPCK;
 	std::string m_sLastOutputPCK;
@@ -196,6 +242,18 @@ private:
 	//Lista stanja po kojoj cemo trazit trenutno stanje
 	std::vector <MAutState*> m_vecAuthStates; 
 
+	/*
+		Dense lookup built by test() over the states added with addAutState:
+		m_vecStateIndex[state] and m_vecDispatchIndex[state * m_iIndexEventCount + event].
+		Left empty if the IDs are negative or too sparse, then the state lists are scanned.
+	*/
+	void buildDispatchIndex();
+	MAutTransition * findTransition(MAutState * pState, int iEventID);
+
+	std::vector <MAutState*> m_vecStateIndex;
+	std::vector <MAutTransition*> m_vecDispatchIndex;
+	int m_iIndexEventCount;
+
 	int m_iErrorStatus;
 	bool m_bAutInitialized;
 
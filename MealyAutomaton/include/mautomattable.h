@@ -0,0 +1,165 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MAUTOMATTABLE_H
+#define MAUTOMATTABLE_H
+
+#include "mautomat.h"
+
+#include <string>
+
+
+/*
+	Dense transition table of an automaton whose states and events are enums numbered 0..STATE_COUNT-1
+	and 0..EVENT_COUNT-1. Sizes and action types are fixed at compile time, the table is built once per
+	automaton class and shared by all of its instances.
+
+	Lookup is a bounds check and two array indexes, the action is called directly through
+	a member function pointer of the automaton instead of a heap allocated MAutomatFunctor.
+*/
+template <class TAutomaton, int STATE_COUNT, int EVENT_COUNT>
+class MAutTable
+{
+public:
+	typedef bool (TAutomaton::*Action)(MAutEvent * pEvent);
+
+	struct Transition
+	{
+		int m_iNextStateID;
+		Action m_pAction;	// nullptr if the transition only changes the state
+		bool m_bDefined;
+	};
+
+	MAutTable()
+	{
+		for (int iState = 0; iState < STATE_COUNT; ++iState)
+			for (int iEvent = 0; iEvent < EVENT_COUNT; ++iEvent)
+				m_transitions[iState][iEvent] = Transition{ -1, nullptr, false };
+	}
+
+	// Adds the transition taken on iEventID in iStateID. Returns the table so definitions can be chained.
+	MAutTable& add(int iStateID, int iEventID, int iNextStateID, Action pAction)
+	{
+		if (!isState(iStateID) || !isState(iNextStateID) || iEventID < 0 || iEventID >= EVENT_COUNT)
+		{
+			Kernel::Fatal_Error("MAutTable::add transition outside the table: state " + std::to_string(iStateID)
+				+ ", event " + std::to_string(iEventID) + ", next state " + std::to_string(iNextStateID));
+		}
+
+		if (m_transitions[iStateID][iEventID].m_bDefined)
+		{
+			Kernel::Fatal_Error("MAutTable::add transition defined twice: state " + std::to_string(iStateID)
+				+ ", event " + std::to_string(iEventID));
+		}
+
+		m_transitions[iStateID][iEventID] = Transition{ iNextStateID, pAction, true };
+		return *this;
+	}
+
+	// nullptr if iEventID is not handled in iStateID
+	const Transition * find(int iStateID, int iEventID) const
+	{
+		if (!isState(iStateID) || iEventID < 0 || iEventID >= EVENT_COUNT)
+			return nullptr;
+
+		const Transition * pTransition = &m_transitions[iStateID][iEventID];
+		return pTransition->m_bDefined ? pTransition : nullptr;
+	}
+
+	static bool isState(int iStateID) { return iStateID >= 0 && iStateID < STATE_COUNT; }
+
+private:
+	Transition m_transitions[STATE_COUNT][EVENT_COUNT];
+};
+
+
+
+/*
+	MAutomat driven by a MAutTable instead of addAutState() lists.
+
+	TAutomaton derives from this class and provides
+		static const Table& getTransitionTable();
+	which usually builds a function-local static table on first use.
+	Events, errors, reset() and test() behave as in MAutomat, so existing callers keep working.
+*/
+template <class TAutomaton, int STATE_COUNT, int EVENT_COUNT>
+class MAutTableAutomat : public MAutomat
+{
+public:
+	typedef MAutTable<TAutomaton, STATE_COUNT, EVENT_COUNT> Table;
+
+	MAutTableAutomat(short int siInstId, ILogger * pLogger = NulLogger::getInstance())
+		: MAutomat(siInstId, pLogger)
+	{}
+
+	virtual ~MAutTableAutomat() {}
+
+	using MAutomat::processEvent;
+
+	virtual bool processEvent(MAutEvent & event)
+	{
+		if (!acceptEvent(event))
+		{
+			return false;
+		}
+
+		if (!Table::isState(m_iCurrentStateID))
+		{
+			traceTransition(m_iCurrentStateID, m_iCurrentEventID, -1, MAutTraceRing::STATUS_NO_STATE);
+
+			*m_pLogger << std::to_string(m_siInstId) + " - The automat state cannot be found!";
+			this->reset();
+
+			setErrorStatus(AUT_TABLE_NOK);
+			return false;
+		}
+
+		const typename Table::Transition * pTransition = TAutomaton::getTransitionTable().find(m_iCurrentStateID, m_iCurrentEventID);
+		if (pTransition == nullptr)
+		{
+			traceTransition(m_iCurrentStateID, m_iCurrentEventID, m_iCurrentStateID, MAutTraceRing::STATUS_NO_TRANSITION);
+
+			*m_pLogger << std::to_string(m_siInstId) + " - TRANSITION NOT FOUND!";
+
+			setErrorStatus(AUT_NEXT_STATE_NOK);
+			return false;
+		}
+
+		traceTransition(m_iCurrentStateID, m_iCurrentEventID, pTransition->m_iNextStateID, MAutTraceRing::STATUS_OK);
+		m_iCurrentStateID = pTransition->m_iNextStateID;
+
+		if (pTransition->m_pAction != nullptr)
+		{
+			(static_cast<TAutomaton*>(this)->*(pTransition->m_pAction))(&event);
+		}
+
+		setErrorStatus(AUT_OK);
+		return true;
+	}
+
+protected:
+	virtual bool isTableDefined() const { return true; }
+};
+
+#endif
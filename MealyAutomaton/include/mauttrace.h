@@ -0,0 +1,169 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MAUTTRACE_H
+#define MAUTTRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/*
+	Binary transition recorder shared by all MAutomat instances of a process.
+
+	Every transition is written as a fixed size record into a ring in POSIX shared memory,
+	so the last transitions survive a crash or a watchdog kill and can be read by
+	AutomatonTraceDump from another process. Recording takes a clock read, one atomic
+	increment and a 32 byte store - no locks, no allocations, no formatting.
+
+	A record is valid when its sequence equals its index + 1; a writer sets the sequence
+	to 0 first and to index + 1 last, so readers skip records being overwritten.
+*/
+class MAutTraceRing
+{
+public:
+	static const uint32_t MAGIC = 0x4D415454; // "TTAM" on little-endian hosts
+	static const uint32_t FORMAT_VERSION = 1;
+	static const uint32_t MAX_NAMES = 32;
+	static const uint32_t NAME_LENGTH = 32;
+
+	// Stored in the status field of records
+	static const uint8_t STATUS_OK = 0;
+	static const uint8_t STATUS_NO_TRANSITION = 1;
+	static const uint8_t STATUS_NO_STATE = 2;
+
+	struct TraceRecord
+	{
+		std::atomic<uint32_t> m_sequence;
+		uint16_t m_usName;		// index into the name table of the header
+		int16_t m_siInstance;
+		int64_t m_time_ns;		// CLOCK_REALTIME, comparable with the log files
+		int32_t m_iFromState;
+		int32_t m_iEvent;
+		int32_t m_iToState;
+		uint8_t m_status;
+		uint8_t m_reserved[3];
+	};
+
+	struct Header
+	{
+		uint32_t m_magic;
+		uint32_t m_formatVersion;
+		uint32_t m_capacity;	// power of two
+		uint32_t m_recordSize;
+		int32_t m_pid;
+		std::atomic<uint32_t> m_nameCount;
+		std::atomic<uint32_t> m_head;	// index of the next record, wraps at 2^32
+		uint32_t m_reserved;
+		char m_program[NAME_LENGTH];
+		char m_names[MAX_NAMES][NAME_LENGTH];
+	};
+
+	// Copy of a valid record taken by Read()
+	struct Entry
+	{
+		uint32_t m_index;
+		int64_t m_time_ns;
+		std::string m_automaton;
+		int m_iInstance;
+		int m_iFromState;
+		int m_iEvent;
+		int m_iToState;
+		uint8_t m_status;
+	};
+
+	struct Snapshot
+	{
+		std::string m_program;
+		int m_pid;
+		uint32_t m_capacity;
+		uint32_t m_recorded;	// transitions recorded in total, older ones were overwritten
+		std::vector<Entry> m_entries;	// oldest first
+	};
+
+	/*
+		Creates the ring /name with at least `records` records. An existing ring of that name is
+		renamed to name.prev first, so the transitions of a crashed predecessor are kept.
+		Check isOpen() - a ring that cannot be created records nothing.
+	*/
+	MAutTraceRing(const std::string& name, uint32_t records);
+	~MAutTraceRing();
+
+	MAutTraceRing(const MAutTraceRing&) = delete;
+	MAutTraceRing& operator=(const MAutTraceRing&) = delete;
+
+	bool isOpen() const { return m_pHeader != nullptr; }
+	const std::string& getName() const { return m_sName; }
+
+	// Index of `szName` in the name table, registering it if needed. 0 ("?") if the table is full.
+	uint16_t RegisterName(const char* szName);
+
+	void Record(uint16_t usName, int iInstance, int iFromState, int iEvent, int iToState, uint8_t status)
+	{
+		const uint32_t index = m_pHeader->m_head.fetch_add(1, std::memory_order_relaxed);
+		TraceRecord& record = m_pRecords[index & m_mask];
+
+		record.m_sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		record.m_usName = usName;
+		record.m_siInstance = static_cast<int16_t>(iInstance);
+		record.m_time_ns = Now_ns();
+		record.m_iFromState = iFromState;
+		record.m_iEvent = iEvent;
+		record.m_iToState = iToState;
+		record.m_status = status;
+
+		record.m_sequence.store(index + 1, std::memory_order_release);
+	}
+
+	/*
+		Maps the ring /name read-only and copies its valid records.
+		Returns false if it does not exist or is not a trace ring of this format.
+	*/
+	static bool Read(const std::string& name, Snapshot& snapshot);
+
+	/*
+		Ring used by the automatons of this process, nullptr if tracing is off.
+		Created on first use from AUTOMATON_TRACE_NAME and AUTOMATON_TRACE_RECORDS as /NAME.program
+	*/
+	static MAutTraceRing* getProcessRing();
+
+	// Replaces the process ring for automatons created from now on; nullptr turns tracing off
+	static void setProcessRing(MAutTraceRing* pRing);
+
+	static int64_t Now_ns();
+
+private:
+	std::string m_sName;
+	void* m_pMapping;
+	size_t m_mappingSize;
+	Header* m_pHeader;
+	TraceRecord* m_pRecords;
+	uint32_t m_mask;
+};
+
+#endif
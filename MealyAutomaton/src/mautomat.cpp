@@ -24,6 +24,8 @@
 
 #include "mautomat.h"
 
+#include <algorithm>
+
 #ifndef TRACE_W
 #define TRACE_W(ID, MSG) *m_pLogger << std::to_string(ID) + " - " + MSG
 #endif
@@ -46,6 +48,8 @@ MAutTransition * MAutState::getTransition(int iEventID)
 	return NULL;
 }
 
+const std::vector <MAutTransition*>& MAutState::getTransitions() const { return m_vecTransitions; }
+
 
 
 
@@ -60,7 +64,7 @@ bool MAutomat::test()
 {
   //Test the initial automat state
 
-	if (m_vecAuthStates.size() < 1) 
+	if (!isTableDefined()) 
     {
         TRACE_W(m_siInstId, "MAutomat::init Undefined m_vecTransitions list!");
         m_iErrorStatus = AUT_TABLE_NOK;
@@ -78,6 +82,8 @@ bool MAutomat::test()
    
     m_bRecursion = false;
 
+	buildDispatchIndex();
+
 	m_bAutInitialized = true;
     m_iErrorStatus = AUT_OK;
 	return true;
@@ -87,7 +93,75 @@ bool MAutomat::test()
 
 
 
-bool MAutomat::processEvent(MAutEvent * event)
+bool MAutomat::isTableDefined() const
+{
+	return !m_vecAuthStates.empty();
+}
+
+void MAutomat::buildDispatchIndex()
+{
+	// Beyond this many cells the automaton is considered sparse and keeps the linear scan
+	const size_t MAX_INDEX_SIZE = 4096;
+
+	m_vecStateIndex.clear();
+	m_vecDispatchIndex.clear();
+	m_iIndexEventCount = 0;
+
+	int iMaxStateID = -1;
+	int iMaxEventID = -1;
+	for(const auto& pState : m_vecAuthStates)
+	{
+		if(pState == nullptr) continue;
+		if(pState->getStateID() < 0) return;
+		iMaxStateID = std::max(iMaxStateID, pState->getStateID());
+
+		for(const auto& pTransition : pState->getTransitions())
+		{
+			if(pTransition == nullptr) continue;
+			if(pTransition->getEventId() < 0) return;
+			iMaxEventID = std::max(iMaxEventID, pTransition->getEventId());
+		}
+	}
+
+	const size_t stateCount = static_cast<size_t>(iMaxStateID + 1);
+	const size_t eventCount = static_cast<size_t>(iMaxEventID + 1);
+	if(stateCount == 0 || stateCount * std::max<size_t>(eventCount, 1) > MAX_INDEX_SIZE) return;
+
+	m_vecStateIndex.assign(stateCount, nullptr);
+	m_vecDispatchIndex.assign(stateCount * eventCount, nullptr);
+	m_iIndexEventCount = static_cast<int>(eventCount);
+
+	// First definition wins, same as the scan
+	for(const auto& pState : m_vecAuthStates)
+	{
+		if(pState == nullptr || m_vecStateIndex[pState->getStateID()] != nullptr) continue;
+		m_vecStateIndex[pState->getStateID()] = pState;
+
+		for(const auto& pTransition : pState->getTransitions())
+		{
+			if(pTransition == nullptr) continue;
+			MAutTransition*& pCell = m_vecDispatchIndex[pState->getStateID() * eventCount + pTransition->getEventId()];
+			if(pCell == nullptr) pCell = pTransition;
+		}
+	}
+}
+
+MAutTransition * MAutomat::findTransition(MAutState * pState, int iEventID)
+{
+	if(m_vecStateIndex.empty())
+	{
+		return pState->getTransition(iEventID);
+	}
+
+	if(iEventID < 0 || iEventID >= m_iIndexEventCount)
+	{
+		return nullptr;
+	}
+
+	return m_vecDispatchIndex[pState->getStateID() * m_iIndexEventCount + iEventID];
+}
+
+bool MAutomat::acceptEvent(MAutEvent & event)
 {
 	if(!isAutInitialized())	 //if something wrong with the automat definition
 	{ 
@@ -97,6 +171,21 @@ bool MAutomat::processEvent(MAutEvent * event)
 	}
 
 
+  	m_iCurrentEventID = event.getEventId();
+
+	saveEvent(event); //Save the current event data (virtual)
+
+	return true;
+}
+
+bool MAutomat::processEvent(MAutEvent * event)
+{
+	if(!isAutInitialized())
+	{
+		m_iErrorStatus = AUT_NOK;
+		return false;
+	}
+
 	//Test if the event is OK
 	if (event == NULL )
     {
@@ -107,10 +196,22 @@ bool MAutomat::processEvent(MAutEvent * event)
 		return false;
     }
 
+	// Dispatched virtually, so automatons that override the in-place version are used for heap events too
+	if(!processEvent(*event))
+	{
+		return false;
+	}
 
-  	m_iCurrentEventID = event->getEventId();
+	delete event;
+	return true;
+}
 
-	saveEvent(event); //Save the current event data (virtual)
+bool MAutomat::processEvent(MAutEvent & event)
+{
+	if(!acceptEvent(event))
+	{
+		return false;
+	}
 	
 	//Get the current state object
 	MAutState * pCurrentState = getCurrentState();
@@ -118,6 +219,8 @@ bool MAutomat::processEvent(MAutEvent * event)
 	//Test if the state is OK 
 	if (pCurrentState == NULL )
     {
+		traceTransition(m_iCurrentStateID, m_iCurrentEventID, -1, MAutTraceRing::STATUS_NO_STATE);
+
 		std::string sMsg = "The automat state cannot be found!";
 		TRACE_W(m_siInstId, sMsg);
         this->reset();
@@ -129,12 +232,14 @@ bool MAutomat::processEvent(MAutEvent * event)
 
 	//Find the transition in the current state that corresponds for the currently received event 
 	MAutTransition * pTransition = NULL;
-	pTransition = pCurrentState->getTransition(m_iCurrentEventID);
+	pTransition = findTransition(pCurrentState, m_iCurrentEventID);
 
 	
 	//Test if the state is OK 
 	if (pTransition == NULL )
     {
+		traceTransition(m_iCurrentStateID, m_iCurrentEventID, m_iCurrentStateID, MAutTraceRing::STATUS_NO_TRANSITION);
+
 		std::string sMsg = "TRANSITION NOT FOUND!";
 		TRACE_W(m_siInstId, sMsg);
 		
@@ -144,6 +249,7 @@ bool MAutomat::processEvent(MAutEvent * event)
 
 	
 	//Change the current state than call the transition function
+	traceTransition(m_iCurrentStateID, m_iCurrentEventID, pTransition->getNextStateId(), MAutTraceRing::STATUS_OK);
 	this->m_iCurrentStateID = pTransition->getNextStateId();
 
 
@@ -151,10 +257,8 @@ bool MAutomat::processEvent(MAutEvent * event)
     // Execute the provided action 
 	if(pTransition->getFunctor()!= NULL)
 	{	MAutomatFunctor <MAutomat> *pFunctor = pTransition->getFunctor();
-		pFunctor->Call(event);
+		pFunctor->Call(&event);
     }
-	
-	if(event!=NULL) delete event;
      
 	m_iErrorStatus = AUT_OK;
 	return true;
@@ -163,6 +267,15 @@ bool MAutomat::processEvent(MAutEvent * event)
 
 MAutState * MAutomat::getCurrentState()
 {
+	if(!m_vecStateIndex.empty())
+	{
+		if(m_iCurrentStateID < 0 || m_iCurrentStateID >= static_cast<int>(m_vecStateIndex.size()))
+		{
+			return nullptr;
+		}
+		return m_vecStateIndex[m_iCurrentStateID];
+	}
+
 	MAutState * pCurrentState = nullptr;
 	for(const auto& pState : m_vecAuthStates)
 	{
@@ -189,14 +302,20 @@ MAutState * MAutomat::getCurrentState()
 /*!
 //Copy the data of the current event so it can be used in automat transitions
 */
-void MAutomat::saveEvent(MAutEvent * event)
+void MAutomat::saveEvent(const MAutEvent & event)
 {
-	if(m_pCurrentEvent != nullptr) 
-			delete m_pCurrentEvent;
-	
-	m_pCurrentEvent = new MAutEvent(event->getEventId(),event->getEventDesc(),event->hasData());
+	m_eventHistory[m_uiEventCount % EVENT_HISTORY_SIZE] = MAutEventRecord{ event.getEventId(), event.getEventDescCStr(), event.hasData() };
+	++m_uiEventCount;
+}
+
+MAutEventRecord MAutomat::getLastEvent(unsigned int age) const
+{
+	if(age >= EVENT_HISTORY_SIZE || age >= m_uiEventCount)
+	{
+		return MAutEventRecord{ -1, "", false };
+	}
 
-	return;
+	return m_eventHistory[(m_uiEventCount - 1 - age) % EVENT_HISTORY_SIZE];
 }
 
 //Keeps the pointer to the current Input package
@@ -225,10 +344,6 @@ MAutomat::~MAutomat()
 		delete m_vecAuthStates.back();
 		m_vecAuthStates.pop_back();
 	 }
-			
-
-	if(m_pCurrentEvent!=NULL) 
-			delete m_pCurrentEvent;
 
 };
 
@@ -236,14 +351,15 @@ MAutEvent::MAutEvent()
 	:	m_iEventID(0), m_sDesc(""), m_bHasData(false)
 {}
 
-MAutEvent::MAutEvent(int iEventID, std::string sDesc, bool bHasData)
-	:m_iEventID(iEventID), m_sDesc(sDesc), m_bHasData(bHasData) {};// //int IDEvent, std::string sDesc, bool bArgs
+MAutEvent::MAutEvent(int iEventID, const char* szDesc, bool bHasData)
+	:m_iEventID(iEventID), m_sDesc(szDesc), m_bHasData(bHasData) {};
 
 MAutEvent::~MAutEvent() {}
 
-int MAutEvent::getEventId() { return m_iEventID; };
-std::string MAutEvent::getEventDesc() { return m_sDesc; };
-bool MAutEvent::hasData() { return m_bHasData; };
+int MAutEvent::getEventId() const { return m_iEventID; };
+std::string MAutEvent::getEventDesc() const { return m_sDesc; };
+const char* MAutEvent::getEventDescCStr() const { return m_sDesc; };
+bool MAutEvent::hasData() const { return m_bHasData; };
 
 MAutTransition::MAutTransition(int IDEvent, int IDNextState, MAutomat* pAut, bool (MAutomat::* pAction) (MAutEvent* pEvent))
 {
@@ -280,8 +396,8 @@ void MAutState::addTransition(MAutTransition* pT) { m_vecTransitions.push_back(p
 int MAutState::getStateID() { return m_iStateID; };
 
 MAutomat::MAutomat(short int siInstId, ILogger* pLogger)
-	:	m_siInstId(siInstId), m_pLogger(pLogger), m_pCurrentEvent(NULL),
-	m_sLastInputPCK(), m_sLastOutputPCK(), m_bAutInitialized(false), m_bTrace(false), m_iErrorStatus(AUT_OK)
+	:	m_siInstId(siInstId), m_pLogger(pLogger), m_pTraceRing(MAutTraceRing::getProcessRing()), m_usTraceName(0), m_uiEventCount(0),
+	m_sLastInputPCK(), m_sLastOutputPCK(), m_iIndexEventCount(0), m_bAutInitialized(false), m_bTrace(false), m_iErrorStatus(AUT_OK)
 {
 	// tmTraceStart.start();
 };
@@ -291,5 +407,19 @@ int MAutomat::getCurrentStateId() { return m_iCurrentStateID; };
 
 int MAutomat::getCurrentEventId() { return m_iCurrentEventID; };
 bool MAutomat::isInRecursion() { return m_bRecursion; };
+void MAutomat::setTracing(bool bTrace) { m_bTrace = bTrace; };
+
+void MAutomat::setTraceName(const char* szName)
+{
+	if(m_pTraceRing != nullptr)
+		m_usTraceName = m_pTraceRing->RegisterName(szName);
+}
 
-void MAutomat::addAutState(MAutState* p) { m_vecAuthStates.push_back(p); };
+void MAutomat::addAutState(MAutState* p)
+{
+	m_vecAuthStates.push_back(p);
+
+	// A state added after test() is only found by the scan until the index is rebuilt
+	m_vecStateIndex.clear();
+	m_vecDispatchIndex.clear();
+}
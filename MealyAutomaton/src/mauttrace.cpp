@@ -0,0 +1,274 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mauttrace.h"
+
+#include "Kernel.hpp"
+#include "propertiesclass.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+	// Largest ring, 16M records of 32 bytes
+	const uint32_t MAX_CAPACITY = 1u << 24;
+
+	std::mutex processRingMutex;
+	MAutTraceRing* pProcessRing = nullptr;
+	bool bProcessRingChosen = false;
+
+	std::mutex nameMutex;
+
+	void copyName(char* pDestination, const char* szSource)
+	{
+		std::strncpy(pDestination, szSource, MAutTraceRing::NAME_LENGTH - 1);
+		pDestination[MAutTraceRing::NAME_LENGTH - 1] = '\0';
+	}
+}
+
+const uint32_t MAutTraceRing::MAX_NAMES;
+const uint32_t MAutTraceRing::NAME_LENGTH;
+
+MAutTraceRing::MAutTraceRing(const std::string& name, uint32_t records)
+	: m_sName(name), m_pMapping(nullptr), m_mappingSize(0), m_pHeader(nullptr), m_pRecords(nullptr), m_mask(0)
+{
+	uint32_t capacity = 1;
+	while (capacity < records && capacity < MAX_CAPACITY)
+	{
+		capacity <<= 1;
+	}
+
+	// glibc keeps POSIX shared memory in /dev/shm, renaming there keeps the ring of a crashed predecessor
+	const std::string path = "/dev/shm/" + name;
+	std::rename(path.c_str(), (path + ".prev").c_str());
+
+	int fd = shm_open(("/" + name).c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+	{
+		Kernel::Warning("MAutTraceRing - cannot create /" + name + ", automaton trace disabled. Errno: " + std::to_string(errno));
+		return;
+	}
+
+	const size_t size = sizeof(Header) + static_cast<size_t>(capacity) * sizeof(TraceRecord);
+	void* pMapping = MAP_FAILED;
+	if (ftruncate(fd, size) == 0)
+	{
+		pMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	const int mapErrno = errno;
+	close(fd);
+
+	if (pMapping == MAP_FAILED)
+	{
+		Kernel::Warning("MAutTraceRing - cannot map /" + name + ", automaton trace disabled. Errno: " + std::to_string(mapErrno));
+		shm_unlink(("/" + name).c_str());
+		return;
+	}
+
+	// The object was truncated to zero, so the header and every record start cleared
+	m_pMapping = pMapping;
+	m_mappingSize = size;
+	m_pHeader = static_cast<Header*>(pMapping);
+	m_pRecords = reinterpret_cast<TraceRecord*>(static_cast<char*>(pMapping) + sizeof(Header));
+	m_mask = capacity - 1;
+
+	m_pHeader->m_formatVersion = FORMAT_VERSION;
+	m_pHeader->m_capacity = capacity;
+	m_pHeader->m_recordSize = sizeof(TraceRecord);
+	m_pHeader->m_pid = getpid();
+	copyName(m_pHeader->m_program, program_invocation_short_name);
+	copyName(m_pHeader->m_names[0], "?");
+	m_pHeader->m_nameCount.store(1, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_release);
+	m_pHeader->m_magic = MAGIC;
+}
+
+MAutTraceRing::~MAutTraceRing()
+{
+	// Not unlinked: the ring is meant to be read after the process is gone
+	if (m_pMapping != nullptr)
+	{
+		munmap(m_pMapping, m_mappingSize);
+	}
+}
+
+uint16_t MAutTraceRing::RegisterName(const char* szName)
+{
+	if (!isOpen())
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(nameMutex);
+
+	const uint32_t count = m_pHeader->m_nameCount.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (std::strncmp(m_pHeader->m_names[i], szName, NAME_LENGTH - 1) == 0)
+		{
+			return static_cast<uint16_t>(i);
+		}
+	}
+
+	if (count >= MAX_NAMES)
+	{
+		return 0;
+	}
+
+	copyName(m_pHeader->m_names[count], szName);
+	m_pHeader->m_nameCount.store(count + 1, std::memory_order_release);
+	return static_cast<uint16_t>(count);
+}
+
+bool MAutTraceRing::Read(const std::string& name, Snapshot& snapshot)
+{
+	int fd = shm_open(("/" + name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) < 0 || static_cast<size_t>(status.st_size) < sizeof(Header))
+	{
+		close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(status.st_size);
+	void* pMapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pMapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const Header* pHeader = static_cast<const Header*>(pMapping);
+	const uint32_t capacity = pHeader->m_capacity;
+	bool valid = pHeader->m_magic == MAGIC
+		&& pHeader->m_formatVersion == FORMAT_VERSION
+		&& pHeader->m_recordSize == sizeof(TraceRecord)
+		&& capacity != 0 && (capacity & (capacity - 1)) == 0 && capacity <= MAX_CAPACITY
+		&& size >= sizeof(Header) + static_cast<size_t>(capacity) * sizeof(TraceRecord);
+
+	if (valid)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		const TraceRecord* pRecords = reinterpret_cast<const TraceRecord*>(static_cast<const char*>(pMapping) + sizeof(Header));
+		const uint32_t nameCount = std::min(pHeader->m_nameCount.load(std::memory_order_acquire), MAX_NAMES);
+		const uint32_t head = pHeader->m_head.load(std::memory_order_acquire);
+		const uint32_t available = std::min(head, capacity);
+
+		snapshot.m_program = std::string(pHeader->m_program, strnlen(pHeader->m_program, NAME_LENGTH));
+		snapshot.m_pid = pHeader->m_pid;
+		snapshot.m_capacity = capacity;
+		snapshot.m_recorded = head;
+		snapshot.m_entries.clear();
+		snapshot.m_entries.reserve(available);
+
+		for (uint32_t index = head - available; index != head; ++index)
+		{
+			const TraceRecord& record = pRecords[index & (capacity - 1)];
+
+			const uint32_t sequenceBefore = record.m_sequence.load(std::memory_order_acquire);
+			Entry entry;
+			entry.m_index = index;
+			entry.m_time_ns = record.m_time_ns;
+			const uint16_t usName = record.m_usName;
+			entry.m_iInstance = record.m_siInstance;
+			entry.m_iFromState = record.m_iFromState;
+			entry.m_iEvent = record.m_iEvent;
+			entry.m_iToState = record.m_iToState;
+			entry.m_status = record.m_status;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint32_t sequenceAfter = record.m_sequence.load(std::memory_order_relaxed);
+
+			// Still being written or already overwritten by a newer transition
+			if (sequenceBefore != index + 1 || sequenceAfter != sequenceBefore)
+			{
+				continue;
+			}
+
+			entry.m_automaton = usName < nameCount ? std::string(pHeader->m_names[usName], strnlen(pHeader->m_names[usName], NAME_LENGTH)) : "?";
+			snapshot.m_entries.push_back(entry);
+		}
+	}
+
+	munmap(pMapping, size);
+	return valid;
+}
+
+MAutTraceRing* MAutTraceRing::getProcessRing()
+{
+	std::lock_guard<std::mutex> lock(processRingMutex);
+
+	if (!bProcessRingChosen)
+	{
+		bProcessRingChosen = true;
+
+		const Properties& properties = GlobalProperties::Get();
+		if (properties.AUTOMATON_TRACE_RECORDS > 0 && !properties.AUTOMATON_TRACE_NAME.empty())
+		{
+			// Lives until the process exits, automatons keep a pointer to it
+			MAutTraceRing* pRing = new MAutTraceRing(properties.AUTOMATON_TRACE_NAME + "." + program_invocation_short_name, properties.AUTOMATON_TRACE_RECORDS);
+			if (pRing->isOpen())
+			{
+				pProcessRing = pRing;
+			}
+			else
+			{
+				delete pRing;
+			}
+		}
+	}
+
+	return pProcessRing;
+}
+
+void MAutTraceRing::setProcessRing(MAutTraceRing* pRing)
+{
+	std::lock_guard<std::mutex> lock(processRingMutex);
+
+	bProcessRingChosen = true;
+	pProcessRing = pRing;
+}
+
+int64_t MAutTraceRing::Now_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
@@ -0,0 +1,234 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mauttrace.h"
+
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+// Renders an automaton trace ring written by MAutTraceRing, e.g. after an incident:
+//   AutomatonTraceDump [--format text|dot|sequence] [--last N] RING
+// RING is the shared memory name without the leading slash, as listed in /dev/shm
+// (nfcdooraccess.trace.HardwareDaemon, or .prev for the run before the last restart).
+// "dot" draws the observed transitions as a Graphviz graph per automaton,
+// "sequence" lists them in order as a Mermaid sequence diagram.
+
+static std::string automatonLabel(const MAutTraceRing::Entry& entry)
+{
+	return entry.m_automaton + "#" + std::to_string(entry.m_iInstance);
+}
+
+static std::string statusSuffix(uint8_t status)
+{
+	switch (status)
+	{
+	case MAutTraceRing::STATUS_OK:
+		return "";
+	case MAutTraceRing::STATUS_NO_TRANSITION:
+		return " (no transition)";
+	case MAutTraceRing::STATUS_NO_STATE:
+		return " (unknown state)";
+	default:
+		return " (status " + std::to_string(status) + ")";
+	}
+}
+
+static std::string formatTime(int64_t time_ns)
+{
+	const time_t seconds = static_cast<time_t>(time_ns / 1000000000LL);
+	struct tm local;
+	localtime_r(&seconds, &local);
+
+	char buffer[32];
+	strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+
+	std::ostringstream text;
+	text << buffer << "." << std::setw(9) << std::setfill('0') << time_ns % 1000000000LL;
+	return text.str();
+}
+
+static void printText(const MAutTraceRing::Snapshot& snapshot)
+{
+	int64_t previous_ns = snapshot.m_entries.empty() ? 0 : snapshot.m_entries.front().m_time_ns;
+
+	for (const MAutTraceRing::Entry& entry : snapshot.m_entries)
+	{
+		std::cout << formatTime(entry.m_time_ns)
+			<< "  +" << std::fixed << std::setprecision(6) << (entry.m_time_ns - previous_ns) / 1e9 << " s  "
+			<< std::left << std::setw(24) << automatonLabel(entry) << std::right
+			<< entry.m_iFromState << " --" << entry.m_iEvent << "--> " << entry.m_iToState
+			<< statusSuffix(entry.m_status) << "\n";
+
+		previous_ns = entry.m_time_ns;
+	}
+}
+
+static void printDot(const MAutTraceRing::Snapshot& snapshot)
+{
+	// automaton -> (from, event, to, status) -> count
+	std::map<std::string, std::map<std::tuple<int, int, int, int>, unsigned int>> edges;
+	for (const MAutTraceRing::Entry& entry : snapshot.m_entries)
+	{
+		++edges[entry.m_automaton][std::make_tuple(entry.m_iFromState, entry.m_iEvent, entry.m_iToState, entry.m_status)];
+	}
+
+	std::cout << "digraph \"" << snapshot.m_program << "\" {\n"
+		<< "\tnode [shape=circle];\n";
+
+	int cluster = 0;
+	for (const auto& automaton : edges)
+	{
+		std::cout << "\tsubgraph cluster_" << cluster++ << " {\n"
+			<< "\t\tlabel=\"" << automaton.first << "\";\n";
+
+		for (const auto& edge : automaton.second)
+		{
+			const int from = std::get<0>(edge.first);
+			const int event = std::get<1>(edge.first);
+			const int to = std::get<2>(edge.first);
+			const int status = std::get<3>(edge.first);
+
+			std::cout << "\t\t\"" << automaton.first << ":" << from << "\" [label=\"" << from << "\"];\n";
+			if (status == MAutTraceRing::STATUS_OK)
+			{
+				std::cout << "\t\t\"" << automaton.first << ":" << to << "\" [label=\"" << to << "\"];\n"
+					<< "\t\t\"" << automaton.first << ":" << from << "\" -> \"" << automaton.first << ":" << to
+					<< "\" [label=\"" << event << " x" << edge.second << "\"];\n";
+			}
+			else
+			{
+				std::cout << "\t\t\"" << automaton.first << ":" << from << "\" -> \"" << automaton.first << ":" << from
+					<< "\" [label=\"" << event << statusSuffix(status) << " x" << edge.second << "\", style=dashed, color=red];\n";
+			}
+		}
+
+		std::cout << "\t}\n";
+	}
+
+	std::cout << "}\n";
+}
+
+static void printSequence(const MAutTraceRing::Snapshot& snapshot)
+{
+	std::map<std::string, std::string> participants;
+	for (const MAutTraceRing::Entry& entry : snapshot.m_entries)
+	{
+		const std::string label = automatonLabel(entry);
+		if (participants.count(label) == 0)
+		{
+			const std::string id = "A" + std::to_string(participants.size());
+			participants[label] = id;
+		}
+	}
+
+	std::cout << "sequenceDiagram\n";
+	for (const auto& participant : participants)
+	{
+		std::cout << "\tparticipant " << participant.second << " as " << participant.first << "\n";
+	}
+
+	const int64_t start_ns = snapshot.m_entries.empty() ? 0 : snapshot.m_entries.front().m_time_ns;
+	for (const MAutTraceRing::Entry& entry : snapshot.m_entries)
+	{
+		const std::string& id = participants[automatonLabel(entry)];
+		std::cout << "\t" << id << (entry.m_status == MAutTraceRing::STATUS_OK ? "->>" : "-x") << id << ": "
+			<< entry.m_iFromState << " --" << entry.m_iEvent << "--> " << entry.m_iToState << statusSuffix(entry.m_status)
+			<< " @" << std::fixed << std::setprecision(3) << (entry.m_time_ns - start_ns) / 1e6 << " ms\n";
+	}
+}
+
+static int usage()
+{
+	std::cerr << "Usage: AutomatonTraceDump [--format text|dot|sequence] [--last N] RING" << std::endl
+		<< "RING is a shared memory name from /dev/shm, e.g. nfcdooraccess.trace.HardwareDaemon" << std::endl;
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	std::string format = "text";
+	size_t last = 0;
+	std::string ring;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--format" && i + 1 < argc)
+		{
+			format = argv[++i];
+		}
+		else if (argument == "--last" && i + 1 < argc)
+		{
+			last = std::stoul(argv[++i]);
+		}
+		else if (ring.empty() && argument.compare(0, 2, "--") != 0)
+		{
+			ring = argument[0] == '/' ? argument.substr(1) : argument;
+		}
+		else
+		{
+			return usage();
+		}
+	}
+
+	if (ring.empty() || (format != "text" && format != "dot" && format != "sequence"))
+	{
+		return usage();
+	}
+
+	MAutTraceRing::Snapshot snapshot;
+	if (!MAutTraceRing::Read(ring, snapshot))
+	{
+		std::cerr << "Cannot read the automaton trace ring /" << ring << ": " << std::strerror(errno) << std::endl;
+		return 2;
+	}
+
+	if (last != 0 && snapshot.m_entries.size() > last)
+	{
+		snapshot.m_entries.erase(snapshot.m_entries.begin(), snapshot.m_entries.end() - last);
+	}
+
+	if (format == "text")
+	{
+		std::cout << "# " << snapshot.m_program << " (pid " << snapshot.m_pid << "), " << snapshot.m_recorded
+			<< " transitions recorded, last " << snapshot.m_entries.size() << " of " << snapshot.m_capacity << " kept\n";
+		printText(snapshot);
+	}
+	else if (format == "dot")
+	{
+		printDot(snapshot);
+	}
+	else
+	{
+		printSequence(snapshot);
+	}
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+	Counters, gauges and latency histograms published by every process into its own POSIX
+	shared memory segment (/METRICS_NAME.program), so MetricsDump can read them at any time
+	without talking to the process.
+
+	Metrics are registered once by name (usually when the owning object is constructed) and
+	updated through small handles: an update is one relaxed atomic operation on the mapped
+	segment - no locks, no allocations, no system calls. Registering the same name again
+	returns a handle to the same value, so e.g. all mailboxes of a process can share a counter.
+	If the segment cannot be created or is full, handles point to a process-local dummy slot and
+	updates are simply not published.
+*/
+
+class MetricsRegistry;
+
+/// Monotonic count of events
+class MetricCounter
+{
+public:
+	MetricCounter();
+
+	void Increment(uint64_t count = 1) { m_pValue->fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed); }
+	uint64_t Get() const { return static_cast<uint64_t>(m_pValue->load(std::memory_order_relaxed)); }
+
+private:
+	friend class MetricsRegistry;
+	explicit MetricCounter(std::atomic<int64_t>* pValue) : m_pValue(pValue) {}
+
+	std::atomic<int64_t>* m_pValue;
+};
+
+/// Current value of something, e.g. a queue depth
+class MetricGauge
+{
+public:
+	MetricGauge();
+
+	void Set(int64_t value) { m_pValue->store(value, std::memory_order_relaxed); }
+	void Add(int64_t delta) { m_pValue->fetch_add(delta, std::memory_order_relaxed); }
+	int64_t Get() const { return m_pValue->load(std::memory_order_relaxed); }
+
+private:
+	friend class MetricsRegistry;
+	explicit MetricGauge(std::atomic<int64_t>* pValue) : m_pValue(pValue) {}
+
+	std::atomic<int64_t>* m_pValue;
+};
+
+/**
+ * @brief Log-linear latency histogram in nanoseconds
+ *
+ * Values below 16 ns get a bucket each, above that every power of two is split into 8 buckets,
+ * so a recorded value is known within 12.5 %. Values of 2^40 ns (about 18 minutes) and more share the last bucket.
+*/
+class MetricHistogram
+{
+public:
+	static const uint32_t BUCKET_COUNT = 16 + 36 * 8;
+
+	/// Shared memory layout of one histogram
+	struct Data
+	{
+		std::atomic<int64_t> m_count;
+		std::atomic<int64_t> m_sum_ns;
+		std::atomic<int64_t> m_max_ns;
+		std::atomic<int64_t> m_buckets[BUCKET_COUNT];
+	};
+
+	MetricHistogram();
+
+	void Record_ns(uint64_t value_ns)
+	{
+		m_pData->m_buckets[BucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+		m_pData->m_sum_ns.fetch_add(static_cast<int64_t>(value_ns), std::memory_order_relaxed);
+
+		int64_t max_ns = m_pData->m_max_ns.load(std::memory_order_relaxed);
+		while (static_cast<int64_t>(value_ns) > max_ns
+			&& !m_pData->m_max_ns.compare_exchange_weak(max_ns, static_cast<int64_t>(value_ns), std::memory_order_relaxed))
+		{
+		}
+
+		// Last, so a reader never sees more samples than bucket entries
+		m_pData->m_count.fetch_add(1, std::memory_order_release);
+	}
+
+	void Record(std::chrono::steady_clock::duration duration)
+	{
+		const int64_t value_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		Record_ns(value_ns < 0 ? 0 : static_cast<uint64_t>(value_ns));
+	}
+
+	static uint32_t BucketIndex(uint64_t value_ns)
+	{
+		if (value_ns < 16)
+		{
+			return static_cast<uint32_t>(value_ns);
+		}
+
+		const uint32_t exponent = 63 - __builtin_clzll(value_ns);
+		if (exponent >= 40)
+		{
+			return BUCKET_COUNT - 1;
+		}
+
+		return 16 + (exponent - 4) * 8 + static_cast<uint32_t>((value_ns >> (exponent - 3)) & 7);
+	}
+
+	/// Smallest value counted in bucket `index`
+	static uint64_t BucketLowerBound(uint32_t index);
+
+	/// Largest value counted in bucket `index`
+	static uint64_t BucketUpperBound(uint32_t index);
+
+private:
+	friend class MetricsRegistry;
+	explicit MetricHistogram(Data* pData) : m_pData(pData) {}
+
+	Data* m_pData;
+};
+
+/// Records the time from construction to destruction into a histogram
+class ScopedLatency
+{
+public:
+	explicit ScopedLatency(MetricHistogram& histogram) : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+	~ScopedLatency() { m_histogram.Record(std::chrono::steady_clock::now() - m_start); }
+
+	ScopedLatency(const ScopedLatency&) = delete;
+	ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+	MetricHistogram& m_histogram;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+class MetricsRegistry
+{
+public:
+	static const uint32_t MAGIC = 0x5254454D; // "METR" on little-endian hosts
+	static const uint32_t FORMAT_VERSION = 1;
+	static const uint32_t MAX_METRICS = 128;
+	static const uint32_t MAX_HISTOGRAMS = 32;
+	static const uint32_t NAME_LENGTH = 48;
+
+	enum enuMetricType : uint32_t
+	{
+		enuUnused = 0,
+		enuCounter = 1,
+		enuGauge = 2,
+		enuHistogram = 3
+	};
+
+	struct Slot
+	{
+		std::atomic<uint32_t> m_type;	// set last, readers skip enuUnused slots
+		uint32_t m_histogram;			// index into the histogram area for enuHistogram
+		char m_name[NAME_LENGTH];
+		std::atomic<int64_t> m_value;	// counter or gauge value
+	};
+
+	struct Header
+	{
+		uint32_t m_magic;
+		uint32_t m_formatVersion;
+		uint32_t m_maxMetrics;
+		uint32_t m_maxHistograms;
+		uint32_t m_histogramBuckets;
+		int32_t m_pid;
+		std::atomic<uint32_t> m_metricCount;
+		uint32_t m_histogramCount;
+		int64_t m_startTime_ns;			// CLOCK_REALTIME when the segment was created
+		char m_program[NAME_LENGTH];
+	};
+
+	/// Copy of one metric taken by Read()
+	struct Value
+	{
+		std::string m_name;
+		enuMetricType m_type;
+		int64_t m_value;		// counter, gauge or histogram sample count
+		int64_t m_sum_ns;
+		int64_t m_max_ns;
+		std::vector<int64_t> m_buckets;
+
+		/// Upper bound of the bucket holding the `percentile` (0 - 100) sample of a histogram, capped at its max
+		uint64_t Percentile_ns(double percentile) const;
+	};
+
+	struct Snapshot
+	{
+		std::string m_program;
+		int m_pid;
+		int64_t m_startTime_ns;
+		std::vector<Value> m_metrics;	// in registration order
+	};
+
+	/**
+	 * @brief Creates the segment /name, replacing one left over from a previous run
+	 * An empty name publishes nothing. Check isOpen() - without a segment all handles are backed by a local dummy slot.
+	*/
+	explicit MetricsRegistry(const std::string& name);
+	~MetricsRegistry();
+
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	bool isOpen() const { return m_pHeader != nullptr; }
+	const std::string& getName() const { return m_sName; }
+
+	MetricCounter getCounter(const std::string& name);
+	MetricGauge getGauge(const std::string& name);
+	MetricHistogram getHistogram(const std::string& name);
+
+	/**
+	 * @brief Registry of this process, created on first use as /METRICS_NAME.program
+	 * An empty METRICS_NAME turns publishing off, the handles still work.
+	*/
+	static MetricsRegistry& Process();
+
+	/// Maps /name read-only and copies every metric. Returns false if it is not a metrics segment of this format.
+	static bool Read(const std::string& name, Snapshot& snapshot);
+
+private:
+	Slot* findOrAdd(const std::string& name, enuMetricType type);
+
+	std::string m_sName;
+	void* m_pMapping;
+	size_t m_mappingSize;
+	Header* m_pHeader;
+	Slot* m_pSlots;
+	MetricHistogram::Data* m_pHistograms;
+	std::mutex m_mutex;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,334 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "Metrics.hpp"
+
+#include "Kernel.hpp"
+#include "propertiesclass.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+	// Backs handles which could not get a slot in the segment; updated but never published
+	std::atomic<int64_t> unpublishedValue(0);
+	MetricHistogram::Data unpublishedHistogram;
+
+	void copyName(char* pDestination, const std::string& source)
+	{
+		std::strncpy(pDestination, source.c_str(), MetricsRegistry::NAME_LENGTH - 1);
+		pDestination[MetricsRegistry::NAME_LENGTH - 1] = '\0';
+	}
+
+	std::string readName(const char* szName)
+	{
+		return std::string(szName, strnlen(szName, MetricsRegistry::NAME_LENGTH));
+	}
+}
+
+const uint32_t MetricsRegistry::MAX_METRICS;
+const uint32_t MetricsRegistry::NAME_LENGTH;
+
+MetricCounter::MetricCounter() : m_pValue(&unpublishedValue) {}
+
+MetricGauge::MetricGauge() : m_pValue(&unpublishedValue) {}
+
+MetricHistogram::MetricHistogram() : m_pData(&unpublishedHistogram) {}
+
+uint64_t MetricHistogram::BucketLowerBound(uint32_t index)
+{
+	if (index < 16)
+	{
+		return index;
+	}
+
+	const uint32_t exponent = 4 + (index - 16) / 8;
+	const uint64_t subBucket = (index - 16) % 8;
+	return (8 + subBucket) << (exponent - 3);
+}
+
+uint64_t MetricHistogram::BucketUpperBound(uint32_t index)
+{
+	if (index >= BUCKET_COUNT - 1)
+	{
+		return UINT64_MAX;
+	}
+
+	return BucketLowerBound(index + 1) - 1;
+}
+
+uint64_t MetricsRegistry::Value::Percentile_ns(double percentile) const
+{
+	int64_t total = 0;
+	for (int64_t bucket : m_buckets)
+	{
+		total += bucket;
+	}
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(percentile / 100.0 * total)));
+	int64_t seen = 0;
+	for (uint32_t i = 0; i < m_buckets.size(); ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			return std::min<uint64_t>(MetricHistogram::BucketUpperBound(i), static_cast<uint64_t>(m_max_ns));
+		}
+	}
+
+	return static_cast<uint64_t>(m_max_ns);
+}
+
+MetricsRegistry::MetricsRegistry(const std::string& name)
+	: m_sName(name), m_pMapping(nullptr), m_mappingSize(0), m_pHeader(nullptr), m_pSlots(nullptr), m_pHistograms(nullptr)
+{
+	if (name.empty())
+	{
+		return;
+	}
+
+	// A segment left by a previous run of the program is truncated, its counters start over
+	int fd = shm_open(("/" + name).c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+	{
+		Kernel::Warning("MetricsRegistry - cannot create /" + name + ", metrics are not published. Errno: " + std::to_string(errno));
+		return;
+	}
+
+	const size_t size = sizeof(Header) + MAX_METRICS * sizeof(Slot) + MAX_HISTOGRAMS * sizeof(MetricHistogram::Data);
+	void* pMapping = MAP_FAILED;
+	if (ftruncate(fd, size) == 0)
+	{
+		pMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	const int mapErrno = errno;
+	close(fd);
+
+	if (pMapping == MAP_FAILED)
+	{
+		Kernel::Warning("MetricsRegistry - cannot map /" + name + ", metrics are not published. Errno: " + std::to_string(mapErrno));
+		shm_unlink(("/" + name).c_str());
+		return;
+	}
+
+	// Truncated to zero above, so every slot starts as enuUnused with zero values
+	m_pMapping = pMapping;
+	m_mappingSize = size;
+	m_pHeader = static_cast<Header*>(pMapping);
+	m_pSlots = reinterpret_cast<Slot*>(static_cast<char*>(pMapping) + sizeof(Header));
+	m_pHistograms = reinterpret_cast<MetricHistogram::Data*>(static_cast<char*>(pMapping) + sizeof(Header) + MAX_METRICS * sizeof(Slot));
+
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	m_pHeader->m_formatVersion = FORMAT_VERSION;
+	m_pHeader->m_maxMetrics = MAX_METRICS;
+	m_pHeader->m_maxHistograms = MAX_HISTOGRAMS;
+	m_pHeader->m_histogramBuckets = MetricHistogram::BUCKET_COUNT;
+	m_pHeader->m_pid = getpid();
+	m_pHeader->m_startTime_ns = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+	copyName(m_pHeader->m_program, program_invocation_short_name);
+
+	std::atomic_thread_fence(std::memory_order_release);
+	m_pHeader->m_magic = MAGIC;
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+	// Not unlinked: the last values stay readable after the process is gone
+	if (m_pMapping != nullptr)
+	{
+		munmap(m_pMapping, m_mappingSize);
+	}
+}
+
+MetricsRegistry::Slot* MetricsRegistry::findOrAdd(const std::string& name, enuMetricType type)
+{
+	if (!isOpen())
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const uint32_t count = m_pHeader->m_metricCount.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (std::strncmp(m_pSlots[i].m_name, name.c_str(), NAME_LENGTH - 1) != 0)
+		{
+			continue;
+		}
+
+		if (m_pSlots[i].m_type.load(std::memory_order_relaxed) != type)
+		{
+			Kernel::Warning("MetricsRegistry - metric " + name + " already registered with a different type, it is not published");
+			return nullptr;
+		}
+
+		return &m_pSlots[i];
+	}
+
+	if (count >= MAX_METRICS || (type == enuHistogram && m_pHeader->m_histogramCount >= MAX_HISTOGRAMS))
+	{
+		Kernel::Warning("MetricsRegistry - /" + m_sName + " is full, metric " + name + " is not published");
+		return nullptr;
+	}
+
+	Slot& slot = m_pSlots[count];
+	copyName(slot.m_name, name);
+	if (type == enuHistogram)
+	{
+		slot.m_histogram = m_pHeader->m_histogramCount++;
+	}
+	slot.m_type.store(type, std::memory_order_release);
+	m_pHeader->m_metricCount.store(count + 1, std::memory_order_release);
+
+	return &slot;
+}
+
+MetricCounter MetricsRegistry::getCounter(const std::string& name)
+{
+	Slot* pSlot = findOrAdd(name, enuCounter);
+	return pSlot != nullptr ? MetricCounter(&pSlot->m_value) : MetricCounter();
+}
+
+MetricGauge MetricsRegistry::getGauge(const std::string& name)
+{
+	Slot* pSlot = findOrAdd(name, enuGauge);
+	return pSlot != nullptr ? MetricGauge(&pSlot->m_value) : MetricGauge();
+}
+
+MetricHistogram MetricsRegistry::getHistogram(const std::string& name)
+{
+	Slot* pSlot = findOrAdd(name, enuHistogram);
+	return pSlot != nullptr ? MetricHistogram(&m_pHistograms[pSlot->m_histogram]) : MetricHistogram();
+}
+
+MetricsRegistry& MetricsRegistry::Process()
+{
+	// Never destroyed: handles into it may be used by static objects until the process exits
+	static MetricsRegistry* pProcessRegistry = []()
+	{
+		const std::string name = GlobalProperties::Get().METRICS_NAME;
+		return new MetricsRegistry(name.empty() ? std::string() : name + "." + program_invocation_short_name);
+	}();
+
+	return *pProcessRegistry;
+}
+
+bool MetricsRegistry::Read(const std::string& name, Snapshot& snapshot)
+{
+	int fd = shm_open(("/" + name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) < 0 || static_cast<size_t>(status.st_size) < sizeof(Header))
+	{
+		close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(status.st_size);
+	void* pMapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pMapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const Header* pHeader = static_cast<const Header*>(pMapping);
+	bool valid = pHeader->m_magic == MAGIC
+		&& pHeader->m_formatVersion == FORMAT_VERSION
+		&& pHeader->m_maxMetrics == MAX_METRICS
+		&& pHeader->m_maxHistograms == MAX_HISTOGRAMS
+		&& pHeader->m_histogramBuckets == MetricHistogram::BUCKET_COUNT
+		&& size >= sizeof(Header) + MAX_METRICS * sizeof(Slot) + MAX_HISTOGRAMS * sizeof(MetricHistogram::Data);
+
+	if (valid)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		const Slot* pSlots = reinterpret_cast<const Slot*>(static_cast<const char*>(pMapping) + sizeof(Header));
+		const MetricHistogram::Data* pHistograms = reinterpret_cast<const MetricHistogram::Data*>(
+			static_cast<const char*>(pMapping) + sizeof(Header) + MAX_METRICS * sizeof(Slot));
+		const uint32_t count = std::min(pHeader->m_metricCount.load(std::memory_order_acquire), MAX_METRICS);
+
+		snapshot.m_program = readName(pHeader->m_program);
+		snapshot.m_pid = pHeader->m_pid;
+		snapshot.m_startTime_ns = pHeader->m_startTime_ns;
+		snapshot.m_metrics.clear();
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const Slot& slot = pSlots[i];
+			const uint32_t type = slot.m_type.load(std::memory_order_acquire);
+			if (type == enuUnused || type > enuHistogram || (type == enuHistogram && slot.m_histogram >= MAX_HISTOGRAMS))
+			{
+				continue;
+			}
+
+			Value value;
+			value.m_name = readName(slot.m_name);
+			value.m_type = static_cast<enuMetricType>(type);
+			value.m_value = slot.m_value.load(std::memory_order_relaxed);
+			value.m_sum_ns = 0;
+			value.m_max_ns = 0;
+
+			if (type == enuHistogram)
+			{
+				const MetricHistogram::Data& histogram = pHistograms[slot.m_histogram];
+				value.m_value = histogram.m_count.load(std::memory_order_acquire);
+				value.m_sum_ns = histogram.m_sum_ns.load(std::memory_order_relaxed);
+				value.m_max_ns = histogram.m_max_ns.load(std::memory_order_relaxed);
+				value.m_buckets.resize(MetricHistogram::BUCKET_COUNT);
+				for (uint32_t bucket = 0; bucket < MetricHistogram::BUCKET_COUNT; ++bucket)
+				{
+					value.m_buckets[bucket] = histogram.m_buckets[bucket].load(std::memory_order_relaxed);
+				}
+			}
+
+			snapshot.m_metrics.push_back(value);
+		}
+	}
+
+	munmap(pMapping, size);
+	return valid;
+}
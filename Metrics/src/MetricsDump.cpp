@@ -0,0 +1,169 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "Metrics.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+// Prints the metrics published by running (or exited) processes:
+//   MetricsDump [SEGMENT...]
+// SEGMENT is a shared memory name without the leading slash (nfcdooraccess.metrics.MainApplication);
+// without one every metrics segment found in /dev/shm is printed.
+
+static const int NAME_COLUMN_WIDTH = MetricsRegistry::NAME_LENGTH;
+
+static std::string formatDuration_ns(double value_ns)
+{
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(1);
+
+	if (value_ns < 1e3)
+	{
+		text << value_ns << " ns";
+	}
+	else if (value_ns < 1e6)
+	{
+		text << value_ns / 1e3 << " us";
+	}
+	else if (value_ns < 1e9)
+	{
+		text << value_ns / 1e6 << " ms";
+	}
+	else
+	{
+		text << value_ns / 1e9 << " s";
+	}
+
+	return text.str();
+}
+
+static bool isRunning(int pid)
+{
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static void printSnapshot(const std::string& segment, const MetricsRegistry::Snapshot& snapshot)
+{
+	std::cout << snapshot.m_program << " (/" << segment << ", pid " << snapshot.m_pid
+		<< (isRunning(snapshot.m_pid) ? ", running" : ", exited") << ")" << std::endl;
+
+	for (const MetricsRegistry::Value& metric : snapshot.m_metrics)
+	{
+		std::cout << "  " << std::left << std::setw(NAME_COLUMN_WIDTH) << metric.m_name << std::right;
+
+		switch (metric.m_type)
+		{
+		case MetricsRegistry::enuCounter:
+		case MetricsRegistry::enuGauge:
+			std::cout << metric.m_value;
+			break;
+
+		case MetricsRegistry::enuHistogram:
+			std::cout << "count " << metric.m_value;
+			if (metric.m_value > 0)
+			{
+				std::cout << ", mean " << formatDuration_ns(static_cast<double>(metric.m_sum_ns) / metric.m_value)
+					<< ", p50 " << formatDuration_ns(metric.Percentile_ns(50))
+					<< ", p90 " << formatDuration_ns(metric.Percentile_ns(90))
+					<< ", p99 " << formatDuration_ns(metric.Percentile_ns(99))
+					<< ", max " << formatDuration_ns(metric.m_max_ns);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		std::cout << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> segments;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument.compare(0, 1, "-") == 0)
+		{
+			std::cerr << "Usage: MetricsDump [SEGMENT...]" << std::endl;
+			return 1;
+		}
+
+		segments.push_back(argument[0] == '/' ? argument.substr(1) : argument);
+	}
+
+	const bool explicitSegments = !segments.empty();
+	if (!explicitSegments)
+	{
+		// glibc keeps POSIX shared memory in /dev/shm; Read() skips everything that is not a metrics segment
+		DIR* pDirectory = opendir("/dev/shm");
+		if (pDirectory != nullptr)
+		{
+			for (dirent* pEntry = readdir(pDirectory); pEntry != nullptr; pEntry = readdir(pDirectory))
+			{
+				if (pEntry->d_name[0] != '.')
+				{
+					segments.push_back(pEntry->d_name);
+				}
+			}
+			closedir(pDirectory);
+		}
+	}
+
+	int found = 0;
+	for (const std::string& segment : segments)
+	{
+		MetricsRegistry::Snapshot snapshot;
+		if (!MetricsRegistry::Read(segment, snapshot))
+		{
+			if (explicitSegments)
+			{
+				std::cerr << "/" << segment << " is not a metrics segment" << std::endl;
+			}
+			continue;
+		}
+
+		if (found++ != 0)
+		{
+			std::cout << std::endl;
+		}
+		printSnapshot(segment, snapshot);
+	}
+
+	if (found == 0 && !explicitSegments)
+	{
+		std::cerr << "No metrics segments found in /dev/shm" << std::endl;
+	}
+
+	return found != 0 ? 0 : 2;
+}
@@ -29,21 +29,34 @@
 #include <string>
 
 #include "NulLogger.hpp"
+#include "ICardReader.hpp"
 
-class PN532_NFC
+class PN532_NFC : public ICardReader
 {
 public:
 	PN532_NFC(ILogger* pLogger = NulLogger::getInstance());
+
+	/**
+	 * @brief Opens a specific reader, for hosts with one reader per door
+	 * @param connstring libnfc connection string (e.g. "pn532_i2c:/dev/i2c-1"), empty opens the first reader found
+	 * @param pLogger Pointer to a Logger object
+	*/
+	PN532_NFC(const std::string& connstring, ILogger* pLogger = NulLogger::getInstance());
 	~PN532_NFC();
 
 	// void setTimeoutMs(uint8_t timeout_ms) { m_timeout_ms = timeout_ms; };
 
 	std::string readCardUUID();
 
+	/// Same as `readCardUUID()`: libnfc tries to select a target once and returns if there is none
+	virtual std::string pollCardUUID() override { return readCardUUID(); }
+	virtual std::string getName() const override { return m_connstring.empty() ? "PN532" : "PN532 " + m_connstring; }
+
 	std::string getVersion() const { return m_version; }
 
 private:
 	ILogger* m_pLogger;
+	std::string m_connstring;
 
 	nfc_context* m_pContext;
 	nfc_device* m_pDevice;
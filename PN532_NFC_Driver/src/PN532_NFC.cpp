@@ -32,7 +32,13 @@
 std::string parseHexUUID(uint8_t* pData, size_t dataLen);
 
 PN532_NFC::PN532_NFC(ILogger* pLogger)
-    :   m_pLogger(pLogger)
+    :   PN532_NFC(std::string(), pLogger)
+{
+}
+
+PN532_NFC::PN532_NFC(const std::string& connstring, ILogger* pLogger)
+    :   m_pLogger(pLogger),
+        m_connstring(connstring)
 {
 
     if (m_pLogger == nullptr)
@@ -73,11 +79,11 @@ void PN532_NFC::logVersion()
 
 void PN532_NFC::openDevice()
 {
-    m_pDevice = nfc_open(m_pContext, nullptr);
+    m_pDevice = nfc_open(m_pContext, m_connstring.empty() ? nullptr : m_connstring.c_str());
     if (m_pDevice == nullptr)
     {
-        *m_pLogger << "PN532 - Could not open NFC device!";
-        Kernel::Fatal_Error("PN532 - Could not open NFC device!");
+        *m_pLogger << "PN532 - Could not open NFC device " + m_connstring + "!";
+        Kernel::Fatal_Error("PN532 - Could not open NFC device " + m_connstring + "!");
     }
 }
     
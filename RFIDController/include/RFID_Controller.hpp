@@ -25,6 +25,9 @@
 #include"NulLogger.hpp"
 
 #include"MFRC522.h"
+#include"ICardReader.hpp"
+
+#include <memory>
 
 class Card
 {
@@ -40,20 +43,27 @@ class Card
 
 };
 
-class RFID_Controller
+class RFID_Controller : public ICardReader
 {
     private:
+    std::unique_ptr<IMFRC522_Bus> m_pOwnedBus;
     MFRC522 m_RFID_module;
     ILogger* m_pLogger;
 
     long m_waitingTime_ms;
 
     public:
-    RFID_Controller(ILogger* pLogger = nullptr);
+    /// `pBus` must outlive the controller; if null, the reader on the Raspberry Pi SPI0 bus is used
+    RFID_Controller(ILogger* pLogger = nullptr, IMFRC522_Bus* pBus = nullptr);
     ~RFID_Controller();
 
     void setWaitingTime_ms(long time_ms);
 
+    /// Polls until a card is in range. The interval starts at the waiting time and doubles up to 32 times that while no card is found.
     bool waitUntilCardIsAvailble();
     std::string getUID_OfAvailableCard();
+
+    /// Single REQA + anticollision attempt, for use with `CardReaderScheduler`
+    virtual std::string pollCardUUID() override;
+    virtual std::string getName() const override { return "MFRC522"; }
 };
\ No newline at end of file
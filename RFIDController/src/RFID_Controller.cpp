@@ -29,6 +29,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 Card::Card()
     :   m_UID("")
@@ -43,8 +44,9 @@ std::string Card::getUID()
     return m_UID;
 }
 
-RFID_Controller::RFID_Controller(ILogger* pLogger)
-    : m_RFID_module()
+RFID_Controller::RFID_Controller(ILogger* pLogger, IMFRC522_Bus* pBus)
+    : m_pOwnedBus(pBus == nullptr ? new BCM2835_SPI_Bus() : nullptr),
+      m_RFID_module(pBus == nullptr ? m_pOwnedBus.get() : pBus)
 {
     m_pLogger = pLogger;
     if(m_pLogger == nullptr)
@@ -65,9 +67,11 @@ bool RFID_Controller::waitUntilCardIsAvailble()
 {
     *m_pLogger << "Waiting for a card to come in range!";
 
+    long interval_ms = m_waitingTime_ms;
     while(!m_RFID_module.PICC_IsNewCardPresent())
     {
-        usleep(m_waitingTime_ms * Time::ms_to_us);
+        usleep(interval_ms * Time::ms_to_us);
+        interval_ms = std::min(interval_ms * 2, m_waitingTime_ms * 32);
     }
 
     *m_pLogger << "A card detected!";
@@ -101,6 +105,14 @@ std::string RFID_Controller::getUID_OfAvailableCard()
     return UID_string;
 }
 
+std::string RFID_Controller::pollCardUUID()
+{
+    if(!m_RFID_module.PICC_IsNewCardPresent())
+        return "";
+
+    return getUID_OfAvailableCard();
+}
+
 void RFID_Controller::setWaitingTime_ms(long time_ms)
 {
     m_waitingTime_ms = time_ms;
@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
+#include "MFRC522_Bus.h"
 using namespace std;
 
 typedef uint8_t byte;
@@ -237,10 +238,11 @@ public:
 	static const byte FIFO_SIZE = 64;		// The FIFO is 64 bytes.
 	
 	/////////////////////////////////////////////////////////////////////////////////////
-	// Functions for setting up the Raspberry Pi
+	// Functions for setting up the SPI bus
 	/////////////////////////////////////////////////////////////////////////////////////
-	MFRC522();
-	void setSPIConfig();
+	MFRC522(IMFRC522_Bus *pBus);
+	void PCD_SetBatchedIO(bool enabled);
+	bool PCD_IsBatchedIO() const { return m_batchedIO; }
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Basic interface functions for communicating with the MFRC522
 	/////////////////////////////////////////////////////////////////////////////////////
@@ -248,10 +250,12 @@ public:
 	void PCD_WriteRegister(byte reg, byte count, byte *values);
 	byte PCD_ReadRegister(byte reg);
 	void PCD_ReadRegister(byte reg, byte count, byte *values, byte rxAlign = 0);
+	void PCD_ReadRegisters(byte count, const byte *regs, byte *values);
 	void setBitMask(unsigned char reg, unsigned char mask);
 	void PCD_SetRegisterBitMask(byte reg, byte mask);
 	void PCD_ClearRegisterBitMask(byte reg, byte mask);
 	byte PCD_CalculateCRC(byte *data, byte length, byte *result);
+	static void CalculateCRC_A(const byte *data, byte length, byte *result);
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Functions for manipulating the MFRC522
@@ -317,6 +321,11 @@ public:
 	bool PICC_ReadCardSerial();
 	
 private:
+	IMFRC522_Bus *m_pBus;
+	bool m_batchedIO;						// See PCD_SetBatchedIO()
+	
+	void PCD_FlushFIFO();
+	byte PCD_CRC_A(byte *data, byte length, byte *result);
 	byte MIFARE_TwoStepHelper(byte command, byte blockAddr, long data);
 };
 
@@ -0,0 +1,70 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MFRC522_BUS_H
+#define MFRC522_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief SPI link to one MFRC522, plus its reset pin.
+ *
+ * Every `transfer()` is one chip-select frame. The MFRC522 only looks at the address byte once
+ * per frame when writing, so a frame writes any number of bytes to one register, while a read
+ * frame may address a different register with every byte (datasheet section 8.1.2).
+*/
+class IMFRC522_Bus
+{
+public:
+	virtual ~IMFRC522_Bus() {}
+
+	/// Sends `length` bytes from `data` in one frame and replaces them with the bytes received
+	virtual void transfer(uint8_t *data, size_t length) = 0;
+
+	/// Drives NRSTPD. Low keeps the chip in hard power down, the rising edge resets it.
+	virtual void setResetPin(bool high) = 0;
+	virtual bool getResetPin() = 0;
+
+	/// Waits at least `us` microseconds, preferably without keeping the CPU busy
+	virtual void delay_us(unsigned int us) = 0;
+};
+
+/// SPI0/CS0 at ~4 MHz and reset on GPIO 25, through the bcm2835 library. Needs root.
+/// Delays sleep instead of using bcm2835_delayMicroseconds(), which busy-waits below 450 us.
+class BCM2835_SPI_Bus : public IMFRC522_Bus
+{
+public:
+	BCM2835_SPI_Bus();
+
+	/// Call again if something else changed the SPI configuration since construction
+	void setSPIConfig();
+
+	virtual void transfer(uint8_t *data, size_t length) override;
+	virtual void setResetPin(bool high) override;
+	virtual bool getResetPin() override;
+	virtual void delay_us(unsigned int us) override;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef MFRC522_MOCKBUS_H
+#define MFRC522_MOCKBUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "MFRC522_Bus.h"
+
+/// One SPI frame as seen on the wire
+struct MFRC522_BusFrame
+{
+	std::vector<uint8_t> sent;
+	std::vector<uint8_t> received;
+};
+
+/// SPI traffic counters
+struct MFRC522_BusStats
+{
+	unsigned long frames;
+	unsigned long bytes;
+	double busTime_us;		///< Time the bus was busy: bytes at the SPI clock plus the per-frame chip-select overhead
+};
+
+/**
+ * @brief MFRC522 with one ISO/IEC 14443A card in front of it, simulated behind the SPI bus
+ *
+ * Models the register file, the FIFO, the CRC coprocessor, the timer and the Transceive command,
+ * and a card with a 4, 7 or 10 byte UID which answers REQA/WUPA, anticollision/SELECT and HLTA.
+ * Time is simulated: every frame advances the clock by its length at `clock_Hz` plus `frameOverhead_us`,
+ * RF exchanges take as long as at 106 kbit/s, so polling loops spin as often as on real hardware.
+ * Frames can be recorded and played back with `MFRC522_ReplayBus`.
+*/
+class MFRC522_MockBus : public IMFRC522_Bus
+{
+public:
+	/// The default overhead makes a 2 byte frame take the 17.86 us per register read measured on a Raspberry Pi
+	MFRC522_MockBus(unsigned int clock_Hz = 4000000, double frameOverhead_us = 13.86);
+
+	/// Puts a card into the field in IDLE state. `uid` must be 4, 7 or 10 bytes long.
+	void PresentCard(const std::vector<uint8_t>& uid);
+	void RemoveCard();
+
+	MFRC522_BusStats getStats() const { return m_stats; }
+	void resetStats();
+
+	/// Simulated time since construction, including RF exchanges and delays
+	double getTime_us() const { return m_now_us; }
+
+	void setRecording(bool enabled) { m_recording = enabled; }
+	const std::vector<MFRC522_BusFrame>& getRecording() const { return m_frames; }
+	void clearRecording() { m_frames.clear(); }
+
+	virtual void transfer(uint8_t *data, size_t length) override;
+	virtual void setResetPin(bool high) override;
+	virtual bool getResetPin() override { return m_resetPin; }
+	virtual void delay_us(unsigned int us) override { m_now_us += us; }
+
+private:
+	enum CardState { CARD_ABSENT, CARD_IDLE, CARD_READY, CARD_ACTIVE, CARD_HALT };
+
+	uint8_t& reg(uint8_t address) { return m_regs[(address & 0x7E) >> 1]; }
+	uint8_t readRegister(uint8_t address);
+	void writeRegister(uint8_t address, uint8_t value);
+
+	void reset();
+	void startTransceive();
+	void completeTransceive();
+	bool cardRespond(const std::vector<uint8_t>& frame, uint8_t txLastBits, std::vector<uint8_t>& response);
+
+	/// The 4 UID/cascade tag bytes and the BCC a card sends at cascade `level` (1..3)
+	void cascadeLevelBytes(unsigned int level, uint8_t *bytes) const;
+	unsigned int cascadeLevels() const { return m_uid.size() == 4 ? 1 : (m_uid.size() == 7 ? 2 : 3); }
+
+	const double m_byteTime_us;
+	const double m_frameOverhead_us;
+
+	uint8_t m_regs[64];
+	std::vector<uint8_t> m_fifo;
+	bool m_resetPin;
+	double m_now_us;
+
+	bool m_transceiving;
+	bool m_answered;
+	double m_transceiveDone_us;
+	std::vector<uint8_t> m_response;
+
+	std::vector<uint8_t> m_uid;
+	CardState m_cardState;
+
+	MFRC522_BusStats m_stats;
+	bool m_recording;
+	std::vector<MFRC522_BusFrame> m_frames;
+};
+
+/**
+ * @brief Plays recorded frames back in order
+ *
+ * Returns the recorded reply for every frame and counts frames whose sent bytes differ from the
+ * recording, so a change in the driver's register traffic shows up without hardware.
+*/
+class MFRC522_ReplayBus : public IMFRC522_Bus
+{
+public:
+	explicit MFRC522_ReplayBus(const std::vector<MFRC522_BusFrame>& frames);
+
+	/// Frames that differed from the recording, or were sent after it ended
+	size_t getMismatches() const { return m_mismatches; }
+	/// True once every recorded frame was played back
+	bool isFinished() const { return m_next == m_frames.size(); }
+
+	virtual void transfer(uint8_t *data, size_t length) override;
+	virtual void setResetPin(bool high) override { m_resetPin = high; }
+	virtual bool getResetPin() override { return m_resetPin; }
+	virtual void delay_us(unsigned int) override {}
+
+private:
+	const std::vector<MFRC522_BusFrame> m_frames;
+	size_t m_next;
+	size_t m_mismatches;
+	bool m_resetPin;
+};
+
+#endif
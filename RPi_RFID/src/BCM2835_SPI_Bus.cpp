@@ -0,0 +1,70 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MFRC522_Bus.h"
+#include "bcm2835.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+#define RSTPIN RPI_V2_GPIO_P1_22
+
+BCM2835_SPI_Bus::BCM2835_SPI_Bus() {
+  if (!bcm2835_init()) {
+    printf("Failed to initialize. This tool needs root access, use sudo.\n");
+  }
+  bcm2835_gpio_fsel(RSTPIN, BCM2835_GPIO_FSEL_OUTP);
+  setSPIConfig();
+}
+
+void BCM2835_SPI_Bus::setSPIConfig() {
+  bcm2835_spi_begin();
+  bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);      // The default
+  bcm2835_spi_setDataMode(BCM2835_SPI_MODE0);                   // The default
+  bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);    // ~ 4 MHz
+  bcm2835_spi_chipSelect(BCM2835_SPI_CS0);                      // The default
+  bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS0, LOW);      // the default
+}
+
+void BCM2835_SPI_Bus::transfer(uint8_t *data, size_t length) {
+  bcm2835_spi_transfern(reinterpret_cast<char*>(data), length);
+}
+
+void BCM2835_SPI_Bus::setResetPin(bool high) {
+  bcm2835_gpio_write(RSTPIN, high ? HIGH : LOW);
+}
+
+bool BCM2835_SPI_Bus::getResetPin() {
+  return bcm2835_gpio_lev(RSTPIN) == HIGH;
+}
+
+void BCM2835_SPI_Bus::delay_us(unsigned int us) {
+  struct timespec duration;
+  duration.tv_sec = us / 1000000;
+  duration.tv_nsec = (us % 1000000) * 1000L;
+  while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+    // Interrupted by a signal, sleep for the rest
+  }
+}
@@ -5,46 +5,38 @@
  */
 
 #include "MFRC522.h"
-#include "bcm2835.h"
 #include <linux/types.h>
 #include <stdint.h>
 #include <cstring>
 #include <stdio.h>
 #include <string>
 
-#define RSTPIN RPI_V2_GPIO_P1_22
-
 using namespace std;
 
+// Batched mode does not spin on ComIrqReg while the RF exchange cannot have finished yet
+static const unsigned int PICC_BIT_TIME_NS = 9440;		// 106 kbit/s
+static const unsigned int PICC_FRAME_DELAY_US = 86;		// Minimum frame delay time PCD to PICC, 1172/fc (ISO/IEC 14443-3 6.2.1.1)
+static const unsigned int PCD_POLL_INTERVAL_US = 25;	// Sleep between ComIrqReg reads
+
 /**
  * Constructor.
- * Prepares the output pins.
+ * Keeps the chip in power down until PCD_Init(). The bus must outlive this object.
  */
-MFRC522::MFRC522(){
+MFRC522::MFRC522(IMFRC522_Bus *pBus)
+  : m_pBus(pBus), m_batchedIO(true) {
   
-  if (!bcm2835_init()) {
-    printf("Failed to initialize. This tool needs root access, use sudo.\n");
-  }
-  bcm2835_gpio_fsel(RSTPIN, BCM2835_GPIO_FSEL_OUTP);
-  bcm2835_gpio_write(RSTPIN, LOW);
-  // Set SPI bus to work with MFRC522 chip.
-  setSPIConfig();
+  m_pBus->setResetPin(false);
 } // End constructor
 
 /**
- * Set SPI bus to work with MFRC522 chip.
- * Please call this function if you have changed the SPI config since the MFRC522 constructor was run.
+ * Selects how register I/O is split into SPI frames.
+ * Batched (the default): FIFO bursts and back-to-back register reads share one frame, write-only
+ * bits are written without reading the register first and CRC_A is computed on the host.
+ * Unbatched: one frame per register access and CRC_A on the coprocessor, as the library did originally.
  */
-void MFRC522::setSPIConfig() {
-  
-  bcm2835_spi_begin();
-  bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);      // The default
-  bcm2835_spi_setDataMode(BCM2835_SPI_MODE0);                   // The default
-  bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_64);    // ~ 4 MHz
-  bcm2835_spi_chipSelect(BCM2835_SPI_CS0);                      // The default
-  bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS0, LOW);      // the default
-	
-} // End setSPIConfig()
+void MFRC522::PCD_SetBatchedIO(bool enabled) {
+  m_batchedIO = enabled;
+} // End PCD_SetBatchedIO()
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Basic interface functions for communicating with the MFRC522
@@ -58,10 +50,10 @@ void MFRC522::PCD_WriteRegister(	byte reg,		///< The register to write to. One o
 					byte value		///< The value to write.
 					) {
 
-  char data[2];
+  byte data[2];
   data[0] = reg & 0x7E;
   data[1] = value;
-  bcm2835_spi_transfern(data, 2);
+  m_pBus->transfer(data, 2);
   
 } // End PCD_WriteRegister()
 
@@ -73,10 +65,20 @@ void MFRC522::PCD_WriteRegister(	byte reg,		///< The register to write to. One o
 					byte count,		///< The number of bytes to write to the register
 					byte *values	///< The values to write. Byte array.
 					) {
-  for (byte index = 0; index < count; index++) {
-  	PCD_WriteRegister(reg, values[index]);
-	}
-
+  if (!m_batchedIO) {
+    for (byte index = 0; index < count; index++) {
+      PCD_WriteRegister(reg, values[index]);
+    }
+    return;
+  }
+  if (count == 0) {
+    return;
+  }
+  // The address is sent once, all following bytes of the frame go to the same register.
+  byte data[1 + 255];
+  data[0] = reg & 0x7E;
+  memcpy(&data[1], values, count);
+  m_pBus->transfer(data, count + 1);
 } // End PCD_WriteRegister()
 
 /**
@@ -86,10 +88,11 @@ void MFRC522::PCD_WriteRegister(	byte reg,		///< The register to write to. One o
 byte MFRC522::PCD_ReadRegister(	byte reg	///< The register to read from. One of the PCD_Register enums.
 				) {
   
-  char data[2];
+  byte data[2];
   data[0] = 0x80 | ((reg) & 0x7E);
-  bcm2835_spi_transfern(data,2);
-  return (byte)data[1];
+  data[1] = 0;
+  m_pBus->transfer(data, 2);
+  return data[1];
 } // End PCD_ReadRegister()
 
 /**
@@ -104,31 +107,49 @@ void MFRC522::PCD_ReadRegister(	byte reg,		///< The register to read from. One o
   if (count == 0) {
     return;
   }
-  //Serial.print(F("Reading ")); 	Serial.print(count); Serial.println(F(" bytes from register."));
-  byte address = 0x80 | (reg & 0x7E);		// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
-  byte index = 0;							// Index in values array.
-  count--;								// One read is performed outside of the loop
-  bcm2835_spi_transfer(address);
-  while (index < count) {
-    if (index == 0 && rxAlign) {		// Only update bit positions rxAlign..7 in values[0]
-      // Create bit mask for bit positions rxAlign..7
-      byte mask = 0;
-      for (byte i = rxAlign; i <= 7; i++) {
-	mask |= (1 << i);
-      }
-      // Read value and tell that we want to read the same address again.
-      byte value = bcm2835_spi_transfer(address);
-      // Apply mask to both current value of values[0] and the new data in value.
-      values[0] = (values[index] & ~mask) | (value & mask);
-    }
-    else { // Normal case
-      values[index] = bcm2835_spi_transfer(address);
+  byte received[255];
+  if (m_batchedIO) {
+    byte regs[255];
+    memset(regs, reg, count);
+    PCD_ReadRegisters(count, regs, received);
+  }
+  else {
+    for (byte index = 0; index < count; index++) {
+      received[index] = PCD_ReadRegister(reg);
     }
-    index++;
   }
-  values[index] = bcm2835_spi_transfer(0);			// Read the final byte. Send 0 to stop reading.
+  byte mask = 0xFF << rxAlign;				// Only bit positions rxAlign..7 in values[0] are updated
+  values[0] = (values[0] & ~mask) | (received[0] & mask);
+  memcpy(&values[1], &received[1], count - 1);
 } // End PCD_ReadRegister()
 
+/**
+ * Reads several registers, in the order given. In batched mode this is a single SPI frame:
+ * every byte sent is the address of the next register to read and the final 0 ends the read.
+ * The interface is described in the datasheet section 8.1.2.1.
+ */
+void MFRC522::PCD_ReadRegisters(	byte count,			///< The number of registers to read
+					const byte *regs,	///< The registers to read from. PCD_Register enums, may repeat.
+					byte *values		///< Byte array to store the values in.
+					) {
+  if (count == 0) {
+    return;
+  }
+  if (!m_batchedIO) {
+    for (byte index = 0; index < count; index++) {
+      values[index] = PCD_ReadRegister(regs[index]);
+    }
+    return;
+  }
+  byte data[255 + 1];
+  for (byte index = 0; index < count; index++) {
+    data[index] = 0x80 | (regs[index] & 0x7E);	// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
+  }
+  data[count] = 0;								// Send 0 to stop reading.
+  m_pBus->transfer(data, count + 1);
+  memcpy(values, &data[1], count);				// Data for address i is clocked out while address i+1 is sent.
+} // End PCD_ReadRegisters()
+
 /**
  * Sets the bits given in mask in register reg.
  */
@@ -151,6 +172,19 @@ void MFRC522::PCD_ClearRegisterBitMask(	byte reg,	///< The register to update. O
   PCD_WriteRegister(reg, tmp & (~mask));		// clear bit mask
 } // End PCD_ClearRegisterBitMask()
 
+/**
+ * Empties the FIFO. FlushBuffer is the only writable bit in FIFOLevelReg,
+ * so batched mode writes it directly instead of read-modify-write.
+ */
+void MFRC522::PCD_FlushFIFO() {
+  if (m_batchedIO) {
+    PCD_WriteRegister(FIFOLevelReg, 0x80);
+  }
+  else {
+    PCD_SetRegisterBitMask(FIFOLevelReg, 0x80);
+  }
+} // End PCD_FlushFIFO()
+
 
 /**
  * Use the CRC coprocessor in the MFRC522 to calculate a CRC_A.
@@ -163,7 +197,7 @@ byte MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to the data to tra
 				) {
   PCD_WriteRegister(CommandReg, PCD_Idle);		// Stop any active command.
   PCD_WriteRegister(DivIrqReg, 0x04);				// Clear the CRCIRq interrupt request bit
-  PCD_SetRegisterBitMask(FIFOLevelReg, 0x80);		// FlushBuffer = 1, FIFO initialization
+  PCD_FlushFIFO();								// FlushBuffer = 1, FIFO initialization
   PCD_WriteRegister(FIFODataReg, length, data);	// Write data to the FIFO
   PCD_WriteRegister(CommandReg, PCD_CalcCRC);		// Start the calculation
 	
@@ -182,11 +216,43 @@ byte MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to the data to tra
   PCD_WriteRegister(CommandReg, PCD_Idle);		// Stop calculating CRC for new content in the FIFO.
 	
   // Transfer the result from the registers to the result buffer
-  result[0] = PCD_ReadRegister(CRCResultRegL);
-  result[1] = PCD_ReadRegister(CRCResultRegH);
+  const byte resultRegs[2] = {CRCResultRegL, CRCResultRegH};
+  PCD_ReadRegisters(2, resultRegs, result);
   return STATUS_OK;
 } // End PCD_CalculateCRC()
 
+/**
+ * Calculates CRC_A (ISO/IEC 14443-3 annex B, preset 0x6363) on the host.
+ * Gives the same result as PCD_CalculateCRC() with the ModeReg value set in PCD_Init().
+ */
+void MFRC522::CalculateCRC_A(	const byte *data,	///< In: The data to calculate the CRC over.
+				byte length,		///< In: The number of bytes.
+				byte *result		///< Out: Result is written to result[0..1], low byte first.
+				) {
+  word crc = 0x6363;
+  for (byte i = 0; i < length; i++) {
+    byte b = data[i] ^ (byte)(crc & 0xFF);
+    b ^= (byte)(b << 4);
+    crc = (crc >> 8) ^ ((word)b << 8) ^ ((word)b << 3) ^ (b >> 4);
+  }
+  result[0] = crc & 0xFF;
+  result[1] = crc >> 8;
+} // End CalculateCRC_A()
+
+/**
+ * CRC_A for PICC frames: on the host in batched mode, saving the ~14 SPI frames a run of the
+ * coprocessor costs, otherwise with PCD_CalculateCRC().
+ *
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+byte MFRC522::PCD_CRC_A(byte *data, byte length, byte *result) {
+  if (m_batchedIO) {
+    CalculateCRC_A(data, length, result);
+    return STATUS_OK;
+  }
+  return PCD_CalculateCRC(data, length, result);
+} // End PCD_CRC_A()
+
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Functions for manipulating the MFRC522
@@ -196,10 +262,10 @@ byte MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to the data to tra
  * Initializes the MFRC522 chip.
  */
 void MFRC522::PCD_Init() {
-  if (bcm2835_gpio_lev(RSTPIN) == LOW) {	//The MFRC522 chip is in power down mode.
-    bcm2835_gpio_write(RSTPIN, HIGH);		// Exit power down mode. This triggers a hard reset.
+  if (!m_pBus->getResetPin()) {	//The MFRC522 chip is in power down mode.
+    m_pBus->setResetPin(true);		// Exit power down mode. This triggers a hard reset.
     // Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74�s. Let us be generous: 50ms.
-    delay(50);
+    m_pBus->delay_us(50000);
   }
   else { // Perform a soft reset
     PCD_Reset();
@@ -226,7 +292,7 @@ void MFRC522::PCD_Reset() {
   // The datasheet does not mention how long the SoftRest command takes to complete.
   // But the MFRC522 might have been in soft power-down mode (triggered by bit 4 of CommandReg) 
   // Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74�s. Let us be generous: 50ms.
-  delay(50);
+  m_pBus->delay_us(50000);
   // Wait for the PowerDown bit in CommandReg to be cleared
   while (PCD_ReadRegister(CommandReg) & (1<<4)) {
     // PCD still restarting - unlikely after waiting 50ms, but better safe than sorry.
@@ -287,7 +353,7 @@ bool MFRC522::PCD_PerformSelfTest() {
 	
   // 2. Clear the internal buffer by writing 25 bytes of 00h
   byte ZEROES[25] = {0x00};
-  PCD_SetRegisterBitMask(FIFOLevelReg, 0x80); // flush the FIFO buffer
+  PCD_FlushFIFO(); // flush the FIFO buffer
   PCD_WriteRegister(FIFODataReg, 25, ZEROES); // write 25 bytes of 00h to FIFO
   PCD_WriteRegister(CommandReg, PCD_Mem); // transfer to internal buffer
 	
@@ -392,18 +458,31 @@ byte MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The command to execut
 	
   PCD_WriteRegister(CommandReg, PCD_Idle);			// Stop any active command.
   PCD_WriteRegister(ComIrqReg, 0x7F);					// Clear all seven interrupt request bits
-  PCD_SetRegisterBitMask(FIFOLevelReg, 0x80);			// FlushBuffer = 1, FIFO initialization
+  PCD_FlushFIFO();									// FlushBuffer = 1, FIFO initialization
   PCD_WriteRegister(FIFODataReg, sendLen, sendData);	// Write sendData to the FIFO
-  PCD_WriteRegister(BitFramingReg, bitFraming);		// Bit adjustments
-  PCD_WriteRegister(CommandReg, command);				// Execute the command
-  if (command == PCD_Transceive) {
-    PCD_SetRegisterBitMask(BitFramingReg, 0x80);	// StartSend=1, transmission of data starts
+  if (m_batchedIO && command == PCD_Transceive) {
+    PCD_WriteRegister(CommandReg, command);				// Execute the command
+    PCD_WriteRegister(BitFramingReg, bitFraming | 0x80);	// Bit adjustments and StartSend=1 in one write, transmission of data starts
+  }
+  else {
+    PCD_WriteRegister(BitFramingReg, bitFraming);		// Bit adjustments
+    PCD_WriteRegister(CommandReg, command);				// Execute the command
+    if (command == PCD_Transceive) {
+      PCD_SetRegisterBitMask(BitFramingReg, 0x80);	// StartSend=1, transmission of data starts
+    }
   }
 	
   // Wait for the command to complete.
   // In PCD_Init() we set the TAuto flag in TModeReg. This means the timer automatically starts when the PCD stops transmitting.
-  // Each iteration of the do-while-loop takes 17.86�s.
+  // Each iteration of the do-while-loop takes 17.86�s, or 17.86�s plus PCD_POLL_INTERVAL_US in batched mode.
   i = 2000;
+  if (m_batchedIO) {
+    i = 800;
+    if (command == PCD_Transceive) {
+      // Sending the frame (9 bits per byte plus start and end of frame) and the frame delay time come first
+      m_pBus->delay_us((sendLen * 9 + 2) * PICC_BIT_TIME_NS / 1000 + PICC_FRAME_DELAY_US);
+    }
+  }
   while (1) {
     n = PCD_ReadRegister(ComIrqReg);	// ComIrqReg[7..0] bits are: Set1 TxIRq RxIRq IdleIRq HiAlertIRq LoAlertIRq ErrIRq TimerIRq
     if (n & waitIRq) {					// One of the interrupts that signal success has been set.
@@ -415,23 +494,53 @@ byte MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The command to execut
     if (--i == 0) {						// The emergency break. If all other condions fail we will eventually terminate on this one after 35.7ms. Communication with the MFRC522 might be down.
       return STATUS_TIMEOUT;
     }
+    if (m_batchedIO) {
+      m_pBus->delay_us(PCD_POLL_INTERVAL_US);
+    }
   }
 	
   // Stop now if any errors except collisions were detected.
-  byte errorRegValue = PCD_ReadRegister(ErrorReg); // ErrorReg[7..0] bits are: WrErr TempErr reserved BufferOvfl CollErr CRCErr ParityErr ProtocolErr
+  // Batched mode reads the FIFO level in the same frame, it is needed below anyway.
+  byte errorRegValue;
+  byte fifoLevel = 0;
+  if (m_batchedIO) {
+    const byte statusRegs[2] = {ErrorReg, FIFOLevelReg};
+    byte statusValues[2];
+    PCD_ReadRegisters(2, statusRegs, statusValues);
+    errorRegValue = statusValues[0];
+    fifoLevel = statusValues[1];
+  }
+  else {
+    errorRegValue = PCD_ReadRegister(ErrorReg); // ErrorReg[7..0] bits are: WrErr TempErr reserved BufferOvfl CollErr CRCErr ParityErr ProtocolErr
+  }
   if (errorRegValue & 0x13) {	 // BufferOvfl ParityErr ProtocolErr
     return STATUS_ERROR;
   }	
 
   // If the caller wants data back, get it from the MFRC522.
   if (backData && backLen) {
-    n = PCD_ReadRegister(FIFOLevelReg);			// Number of bytes in the FIFO
+    n = m_batchedIO ? fifoLevel : PCD_ReadRegister(FIFOLevelReg);	// Number of bytes in the FIFO
     if (n > *backLen) {
       return STATUS_NO_ROOM;
     }
     *backLen = n;											// Number of bytes returned
-    PCD_ReadRegister(FIFODataReg, n, backData, rxAlign);	// Get received data from FIFO
-    _validBits = PCD_ReadRegister(ControlReg) & 0x07;		// RxLastBits[2:0] indicates the number of valid bits in the last received byte. If this value is 000b, the whole byte is valid.
+    if (m_batchedIO && n > 0) {
+      // FIFO contents and RxLastBits in one frame: n reads of FIFODataReg followed by ControlReg.
+      // FIFOLevel[6..0] can read as up to 127, size for that rather than trusting FIFO_SIZE.
+      byte regs[0x7F + 1];
+      byte values[0x7F + 1];
+      memset(regs, FIFODataReg, n);
+      regs[n] = ControlReg;
+      PCD_ReadRegisters(n + 1, regs, values);
+      byte mask = 0xFF << rxAlign;						// Only bit positions rxAlign..7 in backData[0] are updated
+      backData[0] = (backData[0] & ~mask) | (values[0] & mask);
+      memcpy(&backData[1], &values[1], n - 1);
+      _validBits = values[n] & 0x07;
+    }
+    else {
+      PCD_ReadRegister(FIFODataReg, n, backData, rxAlign);	// Get received data from FIFO
+      _validBits = PCD_ReadRegister(ControlReg) & 0x07;		// RxLastBits[2:0] indicates the number of valid bits in the last received byte. If this value is 000b, the whole byte is valid.
+    }
     if (validBits) {
       *validBits = _validBits;
     }
@@ -454,7 +563,7 @@ byte MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The command to execut
     }
     // Verify CRC_A - do our own calculation and store the control in controlBuffer.
     byte controlBuffer[2];
-    n = PCD_CalculateCRC(&backData[0], *backLen - 2, &controlBuffer[0]);
+    n = PCD_CRC_A(&backData[0], *backLen - 2, &controlBuffer[0]);
     if (n != STATUS_OK) {
       return n;
     }
@@ -647,7 +756,7 @@ byte MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct. Normally outp
 	// Calculate BCC - Block Check Character
 	buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
 	// Calculate CRC_A
-	result = PCD_CalculateCRC(buffer, 7, &buffer[7]);
+	result = PCD_CRC_A(buffer, 7, &buffer[7]);
 	if (result != STATUS_OK) {
 	  return result;
 	}
@@ -671,7 +780,9 @@ byte MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct. Normally outp
 			
       // Set bit adjustments
       rxAlign = txLastBits;											// Having a seperate variable is overkill. But it makes the next line easier to read.
-      PCD_WriteRegister(BitFramingReg, (rxAlign << 4) + txLastBits);	// RxAlign = BitFramingReg[6..4]. TxLastBits = BitFramingReg[2..0]
+      if (!m_batchedIO) {											// PCD_CommunicateWithPICC() writes the same value again before transmitting
+	PCD_WriteRegister(BitFramingReg, (rxAlign << 4) + txLastBits);	// RxAlign = BitFramingReg[6..4]. TxLastBits = BitFramingReg[2..0]
+      }
 			
       // Transmit the buffer and receive the response.
       result = PCD_TransceiveData(buffer, bufferUsed, responseBuffer, &responseLength, &txLastBits, rxAlign);
@@ -723,7 +834,7 @@ byte MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct. Normally outp
       return STATUS_ERROR;
     }
     // Verify CRC_A - do our own calculation and store the control in buffer[2..3] - those bytes are not needed anymore.
-    result = PCD_CalculateCRC(responseBuffer, 1, &buffer[2]);
+    result = PCD_CRC_A(responseBuffer, 1, &buffer[2]);
     if (result != STATUS_OK) {
       return result;
     }
@@ -758,7 +869,7 @@ byte MFRC522::PICC_HaltA() {
   buffer[0] = PICC_CMD_HLTA;
   buffer[1] = 0;
   // Calculate CRC_A
-  result = PCD_CalculateCRC(buffer, 2, &buffer[2]);
+  result = PCD_CRC_A(buffer, 2, &buffer[2]);
   if (result != STATUS_OK) {
     return result;
   }
@@ -857,7 +968,7 @@ byte MFRC522::MIFARE_Read(	byte blockAddr, 	///< MIFARE Classic: The block (0-0x
   buffer[0] = PICC_CMD_MF_READ;
   buffer[1] = blockAddr;
   // Calculate CRC_A
-  result = PCD_CalculateCRC(buffer, 2, &buffer[2]);
+  result = PCD_CRC_A(buffer, 2, &buffer[2]);
   if (result != STATUS_OK) {
     return result;
   }
@@ -1112,7 +1223,7 @@ byte MFRC522::PCD_MIFARE_Transceive(	byte *sendData,		///< Pointer to the data t
 	
   // Copy sendData[] to cmdBuffer[] and add CRC_A
   memcpy(cmdBuffer, sendData, sendLen);
-  result = PCD_CalculateCRC(cmdBuffer, sendLen, &cmdBuffer[sendLen]);
+  result = PCD_CRC_A(cmdBuffer, sendLen, &cmdBuffer[sendLen]);
   if (result != STATUS_OK) { 
     return result;
   }
@@ -0,0 +1,330 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MFRC522_MockBus.h"
+#include "MFRC522.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  const double RF_BIT_TIME_US = 1e6 / 106000.0;	// ISO/IEC 14443A at 106 kbit/s
+  const double FRAME_DELAY_US = 91.0;			// PCD to PICC frame delay time, 1236/fc
+
+  /// RF time of a frame: 8 data bits and a parity bit per byte, plus start and end of frame
+  double rfTime_us(size_t bytes) {
+    return (bytes * 9 + 2) * RF_BIT_TIME_US;
+  }
+}
+
+MFRC522_MockBus::MFRC522_MockBus(unsigned int clock_Hz, double frameOverhead_us)
+  : m_byteTime_us(8e6 / clock_Hz), m_frameOverhead_us(frameOverhead_us),
+    m_resetPin(false), m_now_us(0), m_cardState(CARD_ABSENT), m_recording(false) {
+  reset();
+  resetStats();
+}
+
+void MFRC522_MockBus::PresentCard(const std::vector<uint8_t>& uid) {
+  m_uid = uid;
+  m_cardState = (uid.size() == 4 || uid.size() == 7 || uid.size() == 10) ? CARD_IDLE : CARD_ABSENT;
+}
+
+void MFRC522_MockBus::RemoveCard() {
+  m_uid.clear();
+  m_cardState = CARD_ABSENT;
+}
+
+void MFRC522_MockBus::resetStats() {
+  m_stats.frames = 0;
+  m_stats.bytes = 0;
+  m_stats.busTime_us = 0;
+}
+
+void MFRC522_MockBus::transfer(uint8_t *data, size_t length) {
+  if (length == 0) {
+    return;
+  }
+
+  const double frameTime_us = m_frameOverhead_us + length * m_byteTime_us;
+  m_now_us += frameTime_us;
+  m_stats.frames++;
+  m_stats.bytes += length;
+  m_stats.busTime_us += frameTime_us;
+
+  MFRC522_BusFrame frame;
+  if (m_recording) {
+    frame.sent.assign(data, data + length);
+  }
+
+  if (m_transceiving && m_now_us >= m_transceiveDone_us) {
+    completeTransceive();
+  }
+
+  if (data[0] & 0x80) {
+    // Read: the byte clocked out with address i+1 is the content of address i, the last byte sent is 0
+    uint8_t previous = 0;
+    for (size_t i = 0; i < length; i++) {
+      uint8_t address = data[i];
+      data[i] = previous;
+      previous = (i + 1 < length) ? readRegister(address) : 0;
+    }
+  }
+  else {
+    // Write: all bytes after the address go to the same register
+    for (size_t i = 1; i < length; i++) {
+      writeRegister(data[0], data[i]);
+    }
+    memset(data, 0, length);
+  }
+
+  if (m_recording) {
+    frame.received.assign(data, data + length);
+    m_frames.push_back(frame);
+  }
+}
+
+void MFRC522_MockBus::setResetPin(bool high) {
+  if (high && !m_resetPin) {
+    reset();		// Rising edge on NRSTPD is a hard reset
+  }
+  m_resetPin = high;
+}
+
+void MFRC522_MockBus::reset() {
+  memset(m_regs, 0, sizeof(m_regs));
+  reg(MFRC522::CommandReg) = 0x20;
+  reg(MFRC522::ModeReg) = 0x3F;
+  reg(MFRC522::TxControlReg) = 0x80;
+  reg(MFRC522::VersionReg) = 0x92;
+  m_fifo.clear();
+  m_transceiving = false;
+}
+
+uint8_t MFRC522_MockBus::readRegister(uint8_t address) {
+  switch (address & 0x7E) {
+  case MFRC522::FIFODataReg: {
+    if (m_fifo.empty()) {
+      return 0;
+    }
+    uint8_t value = m_fifo.front();
+    m_fifo.erase(m_fifo.begin());
+    return value;
+  }
+  case MFRC522::FIFOLevelReg:
+    return static_cast<uint8_t>(m_fifo.size());
+  default:
+    return reg(address);
+  }
+}
+
+void MFRC522_MockBus::writeRegister(uint8_t address, uint8_t value) {
+  switch (address & 0x7E) {
+  case MFRC522::CommandReg:
+    reg(address) = value & 0x3F;
+    switch (value & 0x0F) {
+    case MFRC522::PCD_Idle:
+      m_transceiving = false;
+      break;
+    case MFRC522::PCD_CalcCRC: {
+      // The coprocessor is done long before the next frame, model it as immediate
+      uint8_t crc[2];
+      MFRC522::CalculateCRC_A(m_fifo.data(), static_cast<uint8_t>(m_fifo.size()), crc);
+      reg(MFRC522::CRCResultRegL) = crc[0];
+      reg(MFRC522::CRCResultRegH) = crc[1];
+      m_fifo.clear();
+      reg(MFRC522::DivIrqReg) |= 0x04;
+      break;
+    }
+    case MFRC522::PCD_SoftReset:
+      reset();
+      break;
+    default:
+      break;
+    }
+    break;
+  case MFRC522::ComIrqReg:
+  case MFRC522::DivIrqReg:
+    // Bit 7 (Set1/Set2) selects whether the marked bits are set or cleared
+    if (value & 0x80) {
+      reg(address) |= value & 0x7F;
+    }
+    else {
+      reg(address) &= ~value;
+    }
+    break;
+  case MFRC522::FIFODataReg:
+    if (m_fifo.size() < MFRC522::FIFO_SIZE) {
+      m_fifo.push_back(value);
+    }
+    else {
+      reg(MFRC522::ErrorReg) |= 0x10;	// BufferOvfl
+    }
+    break;
+  case MFRC522::FIFOLevelReg:
+    if (value & 0x80) {
+      m_fifo.clear();
+      reg(MFRC522::ErrorReg) &= ~0x10;
+    }
+    break;
+  case MFRC522::BitFramingReg:
+    reg(address) = value & 0x7F;
+    if ((value & 0x80) && (reg(MFRC522::CommandReg) & 0x0F) == MFRC522::PCD_Transceive) {
+      startTransceive();
+    }
+    break;
+  case MFRC522::VersionReg:
+    break;
+  default:
+    reg(address) = value;
+    break;
+  }
+}
+
+void MFRC522_MockBus::startTransceive() {
+  const std::vector<uint8_t> sent = m_fifo;
+  m_fifo.clear();
+  reg(MFRC522::ErrorReg) = 0;
+
+  m_answered = cardRespond(sent, reg(MFRC522::BitFramingReg) & 0x07, m_response);
+  m_transceiving = true;
+  if (m_answered) {
+    m_transceiveDone_us = m_now_us + rfTime_us(sent.size()) + FRAME_DELAY_US + rfTime_us(m_response.size());
+  }
+  else {
+    // TAuto: the timer starts when transmission ends, f_timer = 13.56 MHz / (2 * TPreScaler + 1)
+    const unsigned int prescaler = ((reg(MFRC522::TModeReg) & 0x0F) << 8) | reg(MFRC522::TPrescalerReg);
+    const unsigned int reload = (reg(MFRC522::TReloadRegH) << 8) | reg(MFRC522::TReloadRegL);
+    m_transceiveDone_us = m_now_us + rfTime_us(sent.size()) + (2.0 * prescaler + 1) * (reload + 1) / 13.56;
+  }
+}
+
+void MFRC522_MockBus::completeTransceive() {
+  m_transceiving = false;
+  if (m_answered) {
+    m_fifo = m_response;
+    reg(MFRC522::ControlReg) &= ~0x07;			// RxLastBits: every byte complete
+    reg(MFRC522::ComIrqReg) |= 0x20;			// RxIRq
+  }
+  else {
+    reg(MFRC522::ComIrqReg) |= 0x01;			// TimerIRq
+  }
+}
+
+bool MFRC522_MockBus::cardRespond(const std::vector<uint8_t>& frame, uint8_t txLastBits, std::vector<uint8_t>& response) {
+  response.clear();
+  if (m_cardState == CARD_ABSENT || frame.empty()) {
+    return false;
+  }
+
+  const uint8_t command = frame[0];
+
+  if ((command == MFRC522::PICC_CMD_REQA || command == MFRC522::PICC_CMD_WUPA) && frame.size() == 1 && txLastBits == 7) {
+    if (m_cardState != CARD_IDLE && !(command == MFRC522::PICC_CMD_WUPA && m_cardState == CARD_HALT)) {
+      return false;
+    }
+    m_cardState = CARD_READY;
+    // ATQA: UID size in bits 7..6, bit frame anticollision in bit 2
+    response.push_back(static_cast<uint8_t>(((cascadeLevels() - 1) << 6) | 0x04));
+    response.push_back(0x00);
+    return true;
+  }
+
+  if ((command == MFRC522::PICC_CMD_SEL_CL1 || command == MFRC522::PICC_CMD_SEL_CL2 || command == MFRC522::PICC_CMD_SEL_CL3)
+      && m_cardState == CARD_READY && frame.size() >= 2 && txLastBits == 0) {
+    const unsigned int level = (command - MFRC522::PICC_CMD_SEL_CL1) / 2 + 1;
+    if (level > cascadeLevels()) {
+      return false;
+    }
+    uint8_t bytes[5];
+    cascadeLevelBytes(level, bytes);
+
+    const uint8_t nvb = frame[1];
+    if (nvb == 0x70) {
+      // SELECT: all UID bits, BCC and CRC_A
+      uint8_t crc[2];
+      MFRC522::CalculateCRC_A(frame.data(), 7, crc);
+      if (frame.size() != 9 || !std::equal(bytes, bytes + 5, frame.begin() + 2) || crc[0] != frame[7] || crc[1] != frame[8]) {
+        m_cardState = CARD_IDLE;
+        return false;
+      }
+      const bool last = level == cascadeLevels();
+      const uint8_t sak = last ? (m_uid.size() == 7 ? 0x00 : 0x08) : 0x04;
+      response.push_back(sak);
+      MFRC522::CalculateCRC_A(&sak, 1, crc);
+      response.push_back(crc[0]);
+      response.push_back(crc[1]);
+      if (last) {
+        m_cardState = CARD_ACTIVE;
+      }
+      return true;
+    }
+
+    // ANTICOLLISION with whole known bytes: answer with the rest of the cascade level
+    const unsigned int known = (nvb >> 4) - 2;
+    if ((nvb & 0x0F) != 0 || known > 4 || frame.size() != 2 + known || !std::equal(frame.begin() + 2, frame.end(), bytes)) {
+      return false;
+    }
+    response.assign(bytes + known, bytes + 5);
+    return true;
+  }
+
+  if (command == MFRC522::PICC_CMD_HLTA && m_cardState == CARD_ACTIVE) {
+    m_cardState = CARD_HALT;	// HALT is acknowledged by silence
+    return false;
+  }
+
+  return false;
+}
+
+void MFRC522_MockBus::cascadeLevelBytes(unsigned int level, uint8_t *bytes) const {
+  const bool cascadeTag = level < cascadeLevels();
+  const size_t first = (level - 1) * 3;
+  if (cascadeTag) {
+    bytes[0] = MFRC522::PICC_CMD_CT;
+    std::copy(m_uid.begin() + first, m_uid.begin() + first + 3, bytes + 1);
+  }
+  else {
+    std::copy(m_uid.begin() + first, m_uid.begin() + first + 4, bytes);
+  }
+  bytes[4] = bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3];
+}
+
+MFRC522_ReplayBus::MFRC522_ReplayBus(const std::vector<MFRC522_BusFrame>& frames)
+  : m_frames(frames), m_next(0), m_mismatches(0), m_resetPin(false) {
+}
+
+void MFRC522_ReplayBus::transfer(uint8_t *data, size_t length) {
+  if (m_next == m_frames.size()) {
+    m_mismatches++;
+    memset(data, 0, length);
+    return;
+  }
+
+  const MFRC522_BusFrame& frame = m_frames[m_next++];
+  if (frame.sent.size() != length || !std::equal(frame.sent.begin(), frame.sent.end(), data)) {
+    m_mismatches++;
+  }
+  memset(data, 0, length);
+  memcpy(data, frame.received.data(), std::min(length, frame.received.size()));
+}
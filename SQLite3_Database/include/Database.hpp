@@ -34,6 +34,9 @@ class Database
     /// Finalizes and deletes previous query
     void deletePreviousQuery();
 
+    /// How long a statement waits for a write lock held by another connection before it fails
+    static const int BUSY_TIMEOUT_MS = 5000;
+
     public:
     /// Constructor without database name doesn't have sense.
     Database() = delete;
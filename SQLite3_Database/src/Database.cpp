@@ -29,6 +29,17 @@ Database::Database(const std::string& pathname, ILogger* _p_logger)
     // UNTESTED
     sqlite3_extended_result_codes(dbHandle, true);
 
+    // BulkImporter writes on a second connection; wait for its commit instead of failing with SQLITE_BUSY
+    sqlite3_busy_timeout(dbHandle, BUSY_TIMEOUT_MS);
+
+    // Write-ahead log: read-only connections (WebAPIController) never block writes and writes never block them.
+    // The mode is stored in the database file; in-memory databases keep their own journal and that is fine.
+    status = sqlite3_exec(dbHandle, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+    if(status != SQLITE_OK)
+    {
+        *p_logger << "Could not switch " + pathname + " to WAL journal mode, SQLITE_ status: " + std::to_string(status);
+    }
+
     *p_logger << "Database " + pathname + " succesfully opened!"; 
 
 }
@@ -100,6 +100,10 @@ int main(int argc, char** argv)
     const std::string WATCHDOG_SERVER_NAME = GlobalProperties::Get().WATCHDOG_SERVER_NAME;
     WatchdogServer watchdog(WATCHDOG_SERVER_NAME, &processManager, &logger);
 
+    // Children (and their restarts by the watchdog) map this instead of parsing config.xml
+    if (!GlobalProperties::ExportImage())
+        logger << "Configuration image not exported, child processes will parse config.xml";
+
     processManager.createProcess(GlobalProperties::Get().HARDWARED_EXECUTABLE /*, Process::enuInitOptions::MEMCHECK*/ );
     processManager.createProcess(GlobalProperties::Get().MAIN_APP_EXECUTABLE /*, Process::enuInitOptions::MEMCHECK*/ );
     processManager.createProcess(GlobalProperties::Get().DBGW_EXECUTABLE /*, Process::enuInitOptions::GDB*/ );
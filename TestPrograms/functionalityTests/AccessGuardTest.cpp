@@ -0,0 +1,343 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessGuard.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+// Rate limits and anti-passback of AccessGuard in simulated time: window boundaries, lockout expiry,
+// bursts of thousands of attempts by one card and by a keypad brute force, schedule denials that must not lock
+// a door input, lockouts surviving a restart, bounded memory with a stream of distinct credentials and the cost
+// of one check.
+//   AccessGuardTest [MAX_CHECK_NS]
+// Writes AccessGuardTest.db (+ -journal, .key) in the current directory.
+
+static const std::string DATABASE_PATH = "AccessGuardTest.db";
+
+/// Simulated wall clock, far from 0 so no window reaches before the epoch
+static const int64_t T0 = 1600000000000LL;
+static const int64_t SECOND = 1000;
+
+static AccessGuard::Limits limits(int64_t antiPassback_ms = 0)
+{
+	AccessGuard::Limits limits;
+	limits.m_credentialMaxAttempts = 10;
+	limits.m_credentialWindow_ms = 60 * SECOND;
+	limits.m_doorMaxFailures = 5;
+	limits.m_doorWindow_ms = 60 * SECOND;
+	limits.m_lockout_ms = 300 * SECOND;
+	limits.m_antiPassback_ms = antiPassback_ms;
+	return limits;
+}
+
+static InputParameter card(unsigned int number)
+{
+	return InputParameter(InputParameter::enuType::RFIDCard, "04:A2:" + std::to_string(number));
+}
+
+static InputParameter pin(unsigned int number)
+{
+	return InputParameter(InputParameter::enuType::KeypadPIN, std::to_string(100000 + number));
+}
+
+static void removeDatabase()
+{
+	unlink(DATABASE_PATH.c_str());
+	unlink((DATABASE_PATH + "-journal").c_str());
+	unlink((DATABASE_PATH + ".key").c_str());
+}
+
+static void testCredentialWindow()
+{
+	AccessGuard guard(limits(), "");
+
+	// Ten attempts spread over exactly one window: the eleventh is admitted once the first one left the window
+	for (int i = 0; i < 10; ++i)
+	{
+		check(guard.Admit(card(1), 1, T0 + i * 6 * SECOND) == AccessGuard::ALLOWED, "attempt " + std::to_string(i) + " within the limit refused");
+	}
+	check(guard.Admit(card(1), 1, T0 + 60 * SECOND) == AccessGuard::ALLOWED, "attempt after the oldest one left the window refused");
+	check(guard.getLockoutCount(T0 + 60 * SECOND) == 0, "credential locked at the window boundary");
+
+	// ...but not one millisecond earlier
+	AccessGuard strict(limits(), "");
+	for (int i = 0; i < 10; ++i)
+	{
+		strict.Admit(card(1), 1, T0 + i * 6 * SECOND);
+	}
+	check(strict.Admit(card(1), 1, T0 + 60 * SECOND - 1) == AccessGuard::CREDENTIAL_LOCKED, "eleventh attempt within the window admitted");
+	check(strict.Admit(card(2), 1, T0 + 60 * SECOND) == AccessGuard::ALLOWED, "lockout of one card refused another");
+
+	// Locked for the lockout period, then a fresh window
+	const int64_t lockedAt = T0 + 60 * SECOND - 1;
+	check(strict.Admit(card(1), 2, lockedAt + 300 * SECOND - 1) == AccessGuard::CREDENTIAL_LOCKED, "credential admitted before the lockout expired");
+	for (int i = 0; i < 10; ++i)
+	{
+		check(strict.Admit(card(1), 1, lockedAt + 300 * SECOND + i) == AccessGuard::ALLOWED, "attempt after the lockout expired refused");
+	}
+	check(strict.Admit(card(1), 1, lockedAt + 300 * SECOND + 10) == AccessGuard::CREDENTIAL_LOCKED, "window not restarted after the lockout");
+}
+
+static void testCardBurst()
+{
+	AccessGuard guard(limits(), "");
+
+	// A replayed or shared card tapped every 10 ms for an hour: ten lookups, then one per lockout period at most
+	const int ATTEMPTS = 360000;
+	unsigned int admitted = 0;
+	for (int i = 0; i < ATTEMPTS; ++i)
+	{
+		admitted += guard.Admit(card(7), static_cast<DoorId>(i % 4 + 1), T0 + i * 10) == AccessGuard::ALLOWED ? 1 : 0;
+	}
+
+	// Lockouts start at 100 ms, 300.2 s, 600.3 s, ... so an hour holds 12 of them, each preceded by ten admitted attempts
+	check(admitted == 120, "card burst admitted " + std::to_string(admitted) + " attempts instead of 120");
+}
+
+static void testKeypadBruteForce()
+{
+	AccessGuard guard(limits(), "");
+
+	// Every guess is a different PIN, so only the door input limit applies
+	unsigned int lookups = 0;
+	const int GUESSES = 10000;
+	for (int i = 0; i < GUESSES; ++i)
+	{
+		const int64_t now = T0 + i * 100;
+		if (guard.Admit(pin(i), 1, now) == AccessGuard::ALLOWED)
+		{
+			++lookups;
+			guard.Record(pin(i), 1, AccessGuard::UNKNOWN_CREDENTIAL, now);
+		}
+	}
+
+	// Six lookups (the sixth failure locks) per lockout period of 300 s in 1000 s of guessing
+	check(lookups == 6 * 4, "keypad brute force reached " + std::to_string(lookups) + " lookups instead of 24");
+
+	// The locked keypad does not lock the card reader of the same door or the keypad of another door
+	const int64_t now = T0 + GUESSES * 100;
+	check(guard.Admit(pin(GUESSES), 1, now) == AccessGuard::DOOR_LOCKED, "keypad not locked after the burst");
+	check(guard.Admit(card(1), 1, now) == AccessGuard::ALLOWED, "card reader locked by keypad failures");
+	check(guard.Admit(pin(GUESSES), 2, now) == AccessGuard::ALLOWED, "keypad of another door locked");
+
+	// Granted attempts never count as failures
+	AccessGuard granted(limits(), "");
+	for (int i = 0; i < 1000; ++i)
+	{
+		check(granted.Admit(pin(i), 1, T0 + i) == AccessGuard::ALLOWED, "valid PIN refused");
+		granted.Record(pin(i), 1, AccessGuard::GRANTED, T0 + i);
+	}
+}
+
+static void testScheduleDenials()
+{
+	AccessGuard guard(limits(), "");
+
+	// A valid card tapped again and again outside its access schedule is refused every time, but it guesses nothing
+	for (int i = 0; i < 100; ++i)
+	{
+		const int64_t now = T0 + i * 10 * SECOND;
+		check(guard.Admit(card(1), 1, now) == AccessGuard::ALLOWED, "card refused by its schedule locked out");
+		guard.Record(card(1), 1, AccessGuard::DENIED, now);
+	}
+	check(guard.Admit(card(2), 1, T0 + 1000 * SECOND) == AccessGuard::ALLOWED, "schedule denials locked the card reader");
+	check(guard.getLockoutCount(T0 + 1000 * SECOND) == 0, "schedule denials created a lockout");
+
+	// Unknown cards on the same reader still do
+	for (int i = 0; i <= 5; ++i)
+	{
+		guard.Record(card(100 + i), 1, AccessGuard::UNKNOWN_CREDENTIAL, T0 + 1000 * SECOND + i);
+	}
+	check(guard.Admit(card(2), 1, T0 + 1001 * SECOND) == AccessGuard::DOOR_LOCKED, "unknown cards did not lock the card reader");
+}
+
+static void testAntiPassback()
+{
+	AccessGuard guard(limits(30 * SECOND), "");
+
+	check(guard.Admit(card(1), 1, T0) == AccessGuard::ALLOWED, "first entry refused");
+	guard.Record(card(1), 1, AccessGuard::GRANTED, T0);
+
+	check(guard.Admit(card(1), 2, T0 + 29 * SECOND) == AccessGuard::PASSBACK, "card admitted at another door within the passback time");
+	check(guard.Admit(card(2), 2, T0 + 29 * SECOND) == AccessGuard::ALLOWED, "passback of one card refused another");
+	check(guard.Admit(card(1), 1, T0 + 29 * SECOND) == AccessGuard::ALLOWED, "card refused again at the same door");
+	check(guard.Admit(card(1), 2, T0 + 30 * SECOND) == AccessGuard::ALLOWED, "card refused after the passback time");
+
+	// Refused attempts are not grants: the card did not pass door 2 above, so door 1 stays open for it
+	guard.Record(card(1), 2, AccessGuard::DENIED, T0 + 30 * SECOND);
+	check(guard.Admit(card(1), 3, T0 + 31 * SECOND) == AccessGuard::ALLOWED, "failed attempt started passback");
+
+	AccessGuard disabled(limits(0), "");
+	disabled.Record(card(1), 1, AccessGuard::GRANTED, T0);
+	check(disabled.Admit(card(1), 2, T0 + 1) == AccessGuard::ALLOWED, "passback applied while disabled");
+}
+
+static void testPersistence()
+{
+	removeDatabase();
+
+	{
+		AccessGuard guard(limits(), DATABASE_PATH);
+		for (int i = 0; i <= 10; ++i)
+		{
+			guard.Admit(pin(42), 1, T0 + i);
+		}
+		for (int i = 0; i <= 5; ++i)
+		{
+			guard.Record(card(i), 3, AccessGuard::UNKNOWN_CREDENTIAL, T0 + i);
+		}
+		check(guard.getLockoutCount(T0 + 10) == 2, "lockouts not created");
+	}
+
+	{
+		AccessGuard guard(limits(), DATABASE_PATH);
+		check(guard.getLockoutCount(T0 + 10) == 2, "lockouts not reloaded");
+		check(guard.Admit(pin(42), 2, T0 + 20) == AccessGuard::CREDENTIAL_LOCKED, "credential lockout lifted by a restart");
+		check(guard.Admit(card(100), 3, T0 + 20) == AccessGuard::DOOR_LOCKED, "door input lockout lifted by a restart");
+		check(guard.Admit(pin(42), 2, T0 + 300 * SECOND + 10) == AccessGuard::ALLOWED, "reloaded lockout never expires");
+
+		// A new lockout drops the expired rows
+		for (int i = 0; i <= 10; ++i)
+		{
+			guard.Admit(pin(43), 1, T0 + 400 * SECOND + i);
+		}
+	}
+
+	{
+		AccessGuard guard(limits(), DATABASE_PATH);
+		check(guard.getLockoutCount(T0 + 400 * SECOND + 10) == 1, "expired lockouts kept in the database");
+	}
+
+	// Credentials are stored as hashes only
+	std::ifstream file(DATABASE_PATH, std::ios::binary);
+	const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	check(!content.empty(), "database not written");
+	check(content.find(pin(42).getData()) == std::string::npos && content.find(pin(43).getData()) == std::string::npos, "PIN stored in the database");
+
+	// ...keyed with a key outside the database: without it the database does not identify the credential
+	check(access((DATABASE_PATH + ".key").c_str(), R_OK) == 0, "key file not created");
+	unlink((DATABASE_PATH + ".key").c_str());
+	{
+		AccessGuard guard(limits(), DATABASE_PATH);
+		check(guard.getLockoutCount(T0 + 400 * SECOND + 10) == 1, "lockout not reloaded with a new key");
+		check(guard.Admit(pin(43), 1, T0 + 400 * SECOND + 20) == AccessGuard::ALLOWED, "credential identified without the key");
+	}
+
+	removeDatabase();
+}
+
+static void testReloadedLimits()
+{
+	AccessGuard guard(limits(), "");
+
+	for (int i = 0; i < 10; ++i)
+	{
+		guard.Admit(card(1), 1, T0 + i);
+	}
+	for (int i = 0; i <= 10; ++i)
+	{
+		guard.Admit(card(2), 1, T0 + i);
+	}
+
+	// Fewer attempts allowed from now on: counting restarts, the existing lockout stays
+	AccessGuard::Limits stricter = limits();
+	stricter.m_credentialMaxAttempts = 3;
+	guard.setLimits(stricter);
+
+	check(guard.Admit(card(2), 1, T0 + 20) == AccessGuard::CREDENTIAL_LOCKED, "lockout lifted by new limits");
+	for (int i = 0; i < 3; ++i)
+	{
+		check(guard.Admit(card(1), 1, T0 + 20 + i) == AccessGuard::ALLOWED, "attempts counted under the old limits kept");
+	}
+	check(guard.Admit(card(1), 1, T0 + 30) == AccessGuard::CREDENTIAL_LOCKED, "new attempt limit not applied");
+}
+
+static void testMemoryBound()
+{
+	AccessGuard guard(limits(), "");
+
+	// A stream of distinct cards, one every 100 ms: at most 600 are inside the window at any time
+	size_t maxTracked = 0;
+	for (int i = 0; i < 200000; ++i)
+	{
+		guard.Admit(card(i), static_cast<DoorId>(i % 4 + 1), T0 + i * 100);
+		maxTracked = std::max(maxTracked, guard.getTrackedCount());
+	}
+	check(maxTracked <= AccessGuard::SWEEP_THRESHOLD, "tracked " + std::to_string(maxTracked) + " credentials, more than the sweep threshold");
+}
+
+/// Average cost of one Admit and Record for 10000 cards spread over many windows
+static double measureCheck_ns()
+{
+	AccessGuard guard(limits(30 * SECOND), "");
+
+	const int CHECKS = 1000000;
+	const unsigned int CARDS = 10000;
+	unsigned int admitted = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < CHECKS; ++i)
+	{
+		const InputParameter credential = card(i % CARDS);
+		const DoorId door = static_cast<DoorId>(i % CARDS % 4 + 1);
+		const int64_t now = T0 + i * 10;
+		if (guard.Admit(credential, door, now) == AccessGuard::ALLOWED)
+		{
+			++admitted;
+			guard.Record(credential, door, AccessGuard::GRANTED, now);
+		}
+	}
+	const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	check(admitted == CHECKS, "regular use refused");
+	return elapsed_ns / CHECKS;
+}
+
+int main(int argc, char** argv)
+{
+	// Admit and Record each hash the credential with HMAC-SHA-256, still far below the cost of the database lookup
+	const double MAX_CHECK_NS = argc > 1 ? std::stod(argv[1]) : 20000.0;
+
+	testCredentialWindow();
+	testCardBurst();
+	testKeypadBruteForce();
+	testScheduleDenials();
+	testAntiPassback();
+	testPersistence();
+	testReloadedLimits();
+	testMemoryBound();
+
+	const double check_ns = measureCheck_ns();
+	std::cout << "Guard check: " << check_ns << " ns" << std::endl;
+	check(check_ns < MAX_CHECK_NS, "guard check slower than " + std::to_string(MAX_CHECK_NS) + " ns");
+
+	return testResult();
+}
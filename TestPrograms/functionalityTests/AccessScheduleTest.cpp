@@ -0,0 +1,242 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessSchedule.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+// Time-window rules of AccessSchedule at window boundaries, across midnight, on holidays, at the edges of
+// validity periods and across both DST changes of Central European Time, then reloading from the database
+// and the cost of one check with EMPLOYEES restricted employees.
+//   AccessScheduleTest [MAX_CHECK_NS]
+// Writes AccessScheduleTest.db (+ -wal, -shm) in the current directory.
+
+static const std::string DATABASE_PATH = "AccessScheduleTest.db";
+static const unsigned int EMPLOYEES = 10000;
+
+/// Seconds since the epoch of a UTC date and time
+static time_t utc(int year, unsigned int month, unsigned int day, int hours, int minutes, int seconds = 0)
+{
+	return static_cast<time_t>(AccessSchedule::DayNumber(year, month, day)) * 86400 + hours * 3600 + minutes * 60 + seconds;
+}
+
+/// Local CET/CEST time: UTC+1 in winter, UTC+2 in summer (`summer` chooses for the ambiguous hour)
+static time_t local(int year, unsigned int month, unsigned int day, int hours, int minutes, int seconds = 0, bool summer = false)
+{
+	return utc(year, month, day, hours, minutes, seconds) - (summer ? 2 : 1) * 3600;
+}
+
+static AccessRule rule(unsigned int employeeId, DoorId doorId, uint8_t weekdays, const std::string& start, const std::string& end,
+	const std::string& validFrom = "", const std::string& validUntil = "", bool onHolidays = false)
+{
+	AccessRule accessRule;
+	accessRule.m_employeeId = employeeId;
+	accessRule.m_doorId = doorId;
+	accessRule.m_weekdays = weekdays;
+	AccessSchedule::ParseTime(start, accessRule.m_start_min);
+	AccessSchedule::ParseTime(end, accessRule.m_end_min);
+	if (!validFrom.empty()) AccessSchedule::ParseDate(validFrom, accessRule.m_validFrom_day);
+	if (!validUntil.empty()) AccessSchedule::ParseDate(validUntil, accessRule.m_validUntil_day);
+	accessRule.m_onHolidays = onHolidays;
+	return accessRule;
+}
+
+static const uint8_t MON_FRI = 0x1F, FRIDAY = 0x10, SUNDAY = 0x40, EVERY_DAY = 0x7F;
+
+static void testParsing()
+{
+	int32_t day;
+	uint16_t minutes;
+	check(AccessSchedule::DayNumber(1970, 1, 1) == 0 && AccessSchedule::DayNumber(2000, 3, 1) == 11017 && AccessSchedule::DayNumber(1969, 12, 31) == -1, "DayNumber");
+	check(AccessSchedule::ParseDate("2024-02-29", day) && day == AccessSchedule::DayNumber(2024, 2, 29), "leap day not parsed");
+	check(!AccessSchedule::ParseDate("2021-02-29", day) && !AccessSchedule::ParseDate("2021-13-01", day) && !AccessSchedule::ParseDate("2021-1-01", day), "invalid date parsed");
+	check(AccessSchedule::ParseTime("24:00", minutes) && minutes == 1440 && AccessSchedule::ParseTime("00:00", minutes) && minutes == 0, "24:00 or 00:00 not parsed");
+	check(!AccessSchedule::ParseTime("24:01", minutes) && !AccessSchedule::ParseTime("7:30", minutes) && !AccessSchedule::ParseTime("12:60", minutes), "invalid time parsed");
+}
+
+static void testRules(AccessSchedule& schedule)
+{
+	int32_t easterMonday;
+	AccessSchedule::ParseDate("2021-04-05", easterMonday);
+
+	schedule.setRules({
+		rule(1, NO_DOOR, MON_FRI, "08:00", "16:30"),
+		rule(2, NO_DOOR, FRIDAY, "22:00", "06:00"),
+		rule(3, NO_DOOR, EVERY_DAY, "00:00", "24:00", "2021-04-01", "2021-04-30"),
+		rule(4, NO_DOOR, MON_FRI, "08:00", "16:00", "", "", true),
+		rule(5, 7, EVERY_DAY, "10:00", "11:00"),
+		rule(0, 2, EVERY_DAY, "06:00", "22:00"),
+		rule(6, NO_DOOR, SUNDAY, "02:00", "03:00"),
+		rule(6, NO_DOOR, SUNDAY, "08:00", "09:00"),
+	}, { easterMonday });
+
+	// Monday 2021-03-22, standard time
+	check(!schedule.isAllowed(1, 1, local(2021, 3, 22, 7, 59, 59)), "07:59:59 inside 08:00-16:30");
+	check(schedule.isAllowed(1, 1, local(2021, 3, 22, 8, 0, 0)), "08:00:00 outside 08:00-16:30");
+	check(schedule.isAllowed(1, 1, local(2021, 3, 22, 16, 29, 59)), "16:29:59 outside 08:00-16:30");
+	check(!schedule.isAllowed(1, 1, local(2021, 3, 22, 16, 30, 0)), "16:30:00 inside 08:00-16:30");
+	check(!schedule.isAllowed(1, 1, local(2021, 3, 20, 10, 0)), "Saturday inside a Monday to Friday window");
+	check(schedule.isAllowed(1, NO_DOOR, local(2021, 3, 22, 10, 0)), "rule for every door not applied without a door");
+
+	// Overnight window opened on Friday
+	check(!schedule.isAllowed(2, 1, local(2021, 3, 19, 21, 59)), "Friday 21:59 inside 22:00-06:00");
+	check(schedule.isAllowed(2, 1, local(2021, 3, 19, 23, 30)), "Friday 23:30 outside 22:00-06:00");
+	check(schedule.isAllowed(2, 1, local(2021, 3, 20, 5, 59)), "Saturday 05:59 outside Friday's 22:00-06:00");
+	check(!schedule.isAllowed(2, 1, local(2021, 3, 20, 6, 0)), "Saturday 06:00 inside Friday's 22:00-06:00");
+	check(!schedule.isAllowed(2, 1, local(2021, 3, 19, 3, 0)), "Friday 03:00 inside a window opened on Thursday");
+
+	// Validity period, first and last day included
+	check(!schedule.isAllowed(3, 1, local(2021, 3, 31, 23, 59, 59, true)), "day before the validity period admitted");
+	check(schedule.isAllowed(3, 1, local(2021, 4, 1, 0, 0, 0, true)), "first day of the validity period refused");
+	check(schedule.isAllowed(3, 1, local(2021, 4, 30, 23, 59, 59, true)), "last day of the validity period refused");
+	check(!schedule.isAllowed(3, 1, local(2021, 5, 1, 0, 0, 0, true)), "day after the validity period admitted");
+
+	// Easter Monday is a holiday
+	check(!schedule.isAllowed(1, 1, local(2021, 4, 5, 10, 0, 0, true)), "holiday admitted");
+	check(schedule.isAllowed(4, 1, local(2021, 4, 5, 10, 0, 0, true)), "rule open on holidays refused");
+	check(schedule.isAllowed(1, 1, local(2021, 4, 6, 10, 0, 0, true)), "day after a holiday refused");
+
+	// Per-door rules: employee 5 is only restricted at door 7; door 2 restricts everyone
+	check(!schedule.isAllowed(5, 7, local(2021, 3, 22, 9, 59)) && schedule.isAllowed(5, 7, local(2021, 3, 22, 10, 0)), "door rule of employee 5");
+	check(schedule.isAllowed(5, 1, local(2021, 3, 22, 3, 0)), "employee 5 restricted at another door");
+	check(schedule.isAllowed(9, 1, local(2021, 3, 22, 3, 0)), "employee without rules restricted");
+	check(!schedule.isAllowed(9, 2, local(2021, 3, 22, 22, 0)) && schedule.isAllowed(9, 2, local(2021, 3, 22, 21, 59)), "door 2 schedule");
+	// Both schedules apply: employee 1 at door 2 needs 08:00-16:30 and 06:00-22:00
+	check(!schedule.isAllowed(1, 2, local(2021, 3, 20, 10, 0)) && schedule.isAllowed(1, 2, local(2021, 3, 22, 10, 0)), "employee and door schedules not combined");
+
+	// Spring forward on Sunday 2021-03-28: 02:00 CET becomes 03:00 CEST, 02:00-03:00 never happens
+	for (int minute = -5; minute < 5; ++minute)
+	{
+		check(!schedule.isAllowed(6, 1, utc(2021, 3, 28, 1, 0) + minute * 60), "window in the skipped hour opened at UTC 01:00 " + std::to_string(minute) + " min");
+	}
+	check(!schedule.isAllowed(6, 1, utc(2021, 3, 28, 7, 0)), "09:00 CEST inside 08:00-09:00");
+	check(schedule.isAllowed(6, 1, utc(2021, 3, 28, 6, 0)), "08:00 CEST outside 08:00-09:00");
+	check(schedule.isAllowed(6, 1, utc(2021, 3, 28, 6, 59, 59)), "08:59:59 CEST outside 08:00-09:00");
+
+	// Fall back on Sunday 2021-10-31: 03:00 CEST becomes 02:00 CET, 02:00-03:00 happens twice
+	check(schedule.isAllowed(6, 1, utc(2021, 10, 31, 0, 15)), "02:15 CEST outside 02:00-03:00");
+	check(schedule.isAllowed(6, 1, utc(2021, 10, 31, 1, 15)), "02:15 CET outside 02:00-03:00");
+	check(!schedule.isAllowed(6, 1, utc(2021, 10, 31, 2, 0)), "03:00 CET inside 02:00-03:00");
+	check(!schedule.isAllowed(6, 1, utc(2021, 10, 30, 23, 59)), "01:59 CEST inside 02:00-03:00");
+	check(schedule.isAllowed(6, 1, utc(2021, 10, 31, 7, 0)) && !schedule.isAllowed(6, 1, utc(2021, 10, 31, 6, 0)), "08:00 CET after the change");
+}
+
+static bool execute(sqlite3* pDatabase, const std::string& query)
+{
+	char* pError = nullptr;
+	const bool executed = sqlite3_exec(pDatabase, query.c_str(), nullptr, nullptr, &pError) == SQLITE_OK;
+	if (!executed) std::cout << query << ": " << (pError != nullptr ? pError : "") << std::endl;
+	sqlite3_free(pError);
+	return executed;
+}
+
+static void removeDatabase()
+{
+	for (const char* suffix : { "", "-wal", "-shm" })
+	{
+		unlink((DATABASE_PATH + suffix).c_str());
+	}
+}
+
+/// Loading and reloading from AccessSchedule's tables; the schedule is left open on the database for the other tests
+static void testDatabase(sqlite3* pDatabase, AccessSchedule& schedule)
+{
+	check(schedule.getRuleCount() == 2, "rules not loaded");
+	check(schedule.isAllowed(1, 1, local(2021, 3, 22, 8, 0)) && !schedule.isAllowed(1, 1, local(2021, 4, 5, 10, 0, 0, true)), "loaded rule or holiday");
+	check(!schedule.isAllowed(2, 3, local(2021, 3, 22, 10, 0)) && schedule.isAllowed(2, 1, local(2021, 3, 22, 10, 0)), "malformed rule admits");
+
+	// Refresh() waits for RELOAD_INTERVAL and then notices the commit of another connection
+	check(execute(pDatabase, "UPDATE AccessRules SET StartTime = '09:00' WHERE EmployeeId = 1;"), "rule not updated");
+	schedule.Refresh();
+	check(schedule.isAllowed(1, 1, local(2021, 3, 22, 8, 0)), "rule reloaded before RELOAD_INTERVAL");
+	usleep(std::chrono::duration_cast<std::chrono::microseconds>(AccessSchedule::RELOAD_INTERVAL).count() + 50000);
+	schedule.Refresh();
+	check(!schedule.isAllowed(1, 1, local(2021, 3, 22, 8, 0)) && schedule.isAllowed(1, 1, local(2021, 3, 22, 9, 0)), "changed rule not reloaded");
+}
+
+static double measureCheck_ns(AccessSchedule& schedule)
+{
+	std::vector<AccessRule> rules;
+	for (unsigned int employee = 1; employee <= EMPLOYEES; ++employee)
+	{
+		rules.push_back(rule(employee, NO_DOOR, MON_FRI, "07:00", "19:00"));
+		rules.push_back(rule(employee, static_cast<DoorId>(employee % 4 + 1), EVERY_DAY, "20:00", "22:00"));
+	}
+	rules.push_back(rule(0, 1, EVERY_DAY, "05:00", "23:00"));
+	schedule.setRules(rules, {});
+
+	const time_t now = local(2021, 3, 22, 12, 0);
+	const int CHECKS = 1000000;
+	unsigned int admitted = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < CHECKS; ++i)
+	{
+		admitted += schedule.isAllowed(i % EMPLOYEES + 1, static_cast<DoorId>(i % 5), now + i % 3600) ? 1 : 0;
+	}
+	const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	check(admitted == CHECKS, "noon on a Monday refused");
+	return elapsed_ns / CHECKS;
+}
+
+int main(int argc, char** argv)
+{
+	const double MAX_CHECK_NS = argc > 1 ? std::stod(argv[1]) : 2000.0;
+
+	// Central European Time with its EU DST rules, independent of the installed time zone data
+	setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+	tzset();
+
+	testParsing();
+
+	removeDatabase();
+	sqlite3* pDatabase = nullptr;
+	sqlite3_open(DATABASE_PATH.c_str(), &pDatabase);
+	check(execute(pDatabase, "PRAGMA journal_mode=WAL;") && execute(pDatabase, AccessSchedule::CREATE_TABLES)
+		&& execute(pDatabase, AccessSchedule::CREATE_TABLES), "tables not created");
+	check(execute(pDatabase, "INSERT INTO AccessRules(EmployeeId, Weekdays, StartTime, EndTime) VALUES (1, 31, '08:00', '16:30');"
+		"INSERT INTO AccessRules(EmployeeId, DoorId, StartTime, EndTime) VALUES (2, 3, '7:00', '16:30');"
+		"INSERT INTO Holidays(Date, Name) VALUES ('2021-04-05', 'Easter Monday'), ('2021-04-31', 'Malformed');"), "rows not inserted");
+
+	{
+		AccessSchedule schedule(DATABASE_PATH);
+		testDatabase(pDatabase, schedule);
+		testRules(schedule);
+
+		const double check_ns = measureCheck_ns(schedule);
+		std::cout << "Schedule check: " << check_ns << " ns with " << EMPLOYEES << " restricted employees" << std::endl;
+		check(check_ns < MAX_CHECK_NS, "schedule check slower than " + std::to_string(MAX_CHECK_NS) + " ns");
+	}
+
+	sqlite3_close(pDatabase);
+	removeDatabase();
+
+	return testResult();
+}
@@ -0,0 +1,158 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mautomattable.h"
+#include "TestCheck.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Processing an event must not touch the heap: stack events are passed by reference to an automaton
+// built with addAutState() and to a MAutTableAutomat, and every operator new in between is counted.
+
+static std::atomic<long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	++allocations;
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+enum { STATE_A, STATE_B, STATE_COUNT };
+enum { EVENT_TOGGLE, EVENT_STAY, EVENT_COUNT };
+
+/// Event with an inline payload, as the automatons in this repository add to MAutEvent
+class PayloadEvent : public MAutEvent
+{
+public:
+	PayloadEvent(int iEventID, int payload) : MAutEvent(iEventID, iEventID == EVENT_TOGGLE ? "EVENT_TOGGLE" : "EVENT_STAY", true), m_payload(payload) {}
+
+	int m_payload;
+};
+
+class ListAutomaton : public MAutomat
+{
+public:
+	ListAutomaton() : MAutomat(0), m_sum(0)
+	{
+		m_iInitialStateID = STATE_A;
+
+		for (int iState = STATE_A; iState < STATE_COUNT; ++iState)
+		{
+			MAutState* pState = new MAutState(iState);
+			pState->addTransition(new MAutTransition(EVENT_TOGGLE, 1 - iState, this, (bool (MAutomat::*)(MAutEvent*)) &ListAutomaton::doAdd));
+			pState->addTransition(new MAutTransition(EVENT_STAY, iState, this, (bool (MAutomat::*)(MAutEvent*)) &ListAutomaton::doAdd));
+			addAutState(pState);
+		}
+	}
+
+	virtual bool reset() { m_iCurrentStateID = m_iInitialStateID; return true; }
+
+	long m_sum;
+
+private:
+	bool doAdd(MAutEvent* pEvent) { m_sum += static_cast<PayloadEvent*>(pEvent)->m_payload; return true; }
+};
+
+class TableAutomaton : public MAutTableAutomat<TableAutomaton, STATE_COUNT, EVENT_COUNT>
+{
+public:
+	TableAutomaton() : MAutTableAutomat(0), m_sum(0) { m_iInitialStateID = STATE_A; }
+
+	static const Table& getTransitionTable()
+	{
+		static const Table table = []()
+		{
+			Table t;
+			t.add(STATE_A, EVENT_TOGGLE, STATE_B, &TableAutomaton::doAdd)
+			 .add(STATE_A, EVENT_STAY, STATE_A, &TableAutomaton::doAdd)
+			 .add(STATE_B, EVENT_TOGGLE, STATE_A, &TableAutomaton::doAdd)
+			 .add(STATE_B, EVENT_STAY, STATE_B, &TableAutomaton::doAdd);
+			return t;
+		}();
+		return table;
+	}
+
+	virtual bool reset() { m_iCurrentStateID = m_iInitialStateID; return true; }
+
+	long m_sum;
+
+private:
+	bool doAdd(MAutEvent* pEvent) { m_sum += static_cast<PayloadEvent*>(pEvent)->m_payload; return true; }
+};
+
+template <class TAutomaton>
+static void checkAllocationFree(TAutomaton& automaton, const std::string& name)
+{
+	check(automaton.test(), name + " table rejected");
+
+	// First event outside the count: it builds the static table of MAutTableAutomat
+	PayloadEvent warmup(EVENT_STAY, 0);
+	automaton.processEvent(warmup);
+
+	const int EVENTS = 10000;
+	bool accepted = true;
+	long expectedSum = 0;
+
+	const long before = allocations.load();
+	for (int i = 0; i < EVENTS; ++i)
+	{
+		PayloadEvent event(i % 3 == 0 ? EVENT_TOGGLE : EVENT_STAY, i);
+		accepted &= automaton.processEvent(event);
+		expectedSum += i;
+	}
+	const long allocated = allocations.load() - before;
+
+	check(accepted, name + " rejected an event");
+	check(allocated == 0, name + " allocated " + std::to_string(allocated) + " times for " + std::to_string(EVENTS) + " events");
+	check(automaton.m_sum == expectedSum, name + " actions did not see the payload");
+	check(automaton.getCurrentStateId() == (((EVENTS + 2) / 3) % 2 == 0 ? STATE_A : STATE_B), name + " ended in the wrong state");
+
+	// History ring, newest first
+	check(automaton.getLastEvent(0).m_iEventID == ((EVENTS - 1) % 3 == 0 ? EVENT_TOGGLE : EVENT_STAY), name + " last event not recorded");
+	check(std::string(automaton.getLastEvent(2).m_szDesc) == ((EVENTS - 3) % 3 == 0 ? "EVENT_TOGGLE" : "EVENT_STAY"), name + " event history out of order");
+	check(automaton.getLastEvent(MAutomat::EVENT_HISTORY_SIZE).m_iEventID == -1, name + " history reaches past its capacity");
+
+	// Heap events keep working and are deleted by the automaton
+	check(automaton.processEvent(new PayloadEvent(EVENT_STAY, 0)), name + " rejected a heap event");
+}
+
+int main()
+{
+	ListAutomaton list;
+	checkAllocationFree(list, "addAutState automaton");
+
+	TableAutomaton table;
+	checkAllocationFree(table, "MAutTableAutomat");
+
+	return testResult();
+}
@@ -0,0 +1,176 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mautomattable.h"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Events per second through the same 8 state x 13 event automaton built three ways:
+// "scan" is an addAutState() table with sparse IDs, which keeps the linear search MAutomat used before,
+// "indexed" is the same table with dense IDs, dispatched through the index test() builds,
+// "MAutTable" is the static typed table of MAutTableAutomat.
+// Events are allocated with new, as most automatons in this repository do, except for "MAutTable stack"
+// which passes stack events by reference and does not allocate at all.
+// Usage: AutomatonDispatchBenchmark [EVENTS]
+
+static const int STATE_COUNT = 8;
+static const int EVENT_COUNT = 13;
+
+static int nextState(int iState, int iEvent) { return (iState + iEvent + 1) % STATE_COUNT; }
+
+class ListAutomaton : public MAutomat
+{
+public:
+	ListAutomaton(int iIdStride) : MAutomat(0), m_iIdStride(iIdStride), m_counter(0)
+	{
+		m_iInitialStateID = 0;
+
+		for (int iState = 0; iState < STATE_COUNT; ++iState)
+		{
+			MAutState* pState = new MAutState(iState * m_iIdStride);
+			for (int iEvent = 0; iEvent < EVENT_COUNT; ++iEvent)
+			{
+				pState->addTransition(new MAutTransition(iEvent, nextState(iState, iEvent) * m_iIdStride, this,
+					(bool (MAutomat::*)(MAutEvent*)) &ListAutomaton::doCount));
+			}
+			addAutState(pState);
+		}
+	}
+
+	virtual bool reset() { m_iCurrentStateID = m_iInitialStateID; return true; }
+
+	int getState() const { return m_iCurrentStateID / m_iIdStride; }
+	long getCounter() const { return m_counter; }
+
+private:
+	bool doCount(MAutEvent* pEvent) { m_counter += pEvent->getEventId(); return true; }
+
+	const int m_iIdStride;
+	long m_counter;
+};
+
+class TableAutomaton : public MAutTableAutomat<TableAutomaton, STATE_COUNT, EVENT_COUNT>
+{
+public:
+	TableAutomaton() : MAutTableAutomat(0), m_counter(0) { m_iInitialStateID = 0; }
+
+	static const Table& getTransitionTable()
+	{
+		static const Table table = []()
+		{
+			Table t;
+			for (int iState = 0; iState < STATE_COUNT; ++iState)
+				for (int iEvent = 0; iEvent < EVENT_COUNT; ++iEvent)
+					t.add(iState, iEvent, nextState(iState, iEvent), &TableAutomaton::doCount);
+			return t;
+		}();
+		return table;
+	}
+
+	virtual bool reset() { m_iCurrentStateID = m_iInitialStateID; return true; }
+
+	int getState() const { return m_iCurrentStateID; }
+	long getCounter() const { return m_counter; }
+
+private:
+	bool doCount(MAutEvent* pEvent) { m_counter += pEvent->getEventId(); return true; }
+
+	long m_counter;
+};
+
+/// Feeds `events` pseudo-random events to `automaton`, returns events per second; fails on any rejected event
+template <class TAutomaton>
+static double run(TAutomaton& automaton, long events, bool bHeapEvents, const std::string& name)
+{
+	if (!automaton.test())
+	{
+		++failures;
+		std::cout << "FAILED: " << name << " table rejected" << std::endl;
+		return 0;
+	}
+
+	int iExpectedState = 0;
+	long expectedCounter = 0;
+	unsigned int seed = 12345;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < events; ++i)
+	{
+		seed = seed * 1103515245u + 12345u;
+		const int iEvent = static_cast<int>((seed >> 16) % EVENT_COUNT);
+
+		MAutEvent event(iEvent);
+		if (!(bHeapEvents ? automaton.processEvent(new MAutEvent(iEvent)) : automaton.processEvent(event)))
+		{
+			++failures;
+			std::cout << "FAILED: " << name << " rejected event " << iEvent << std::endl;
+			return 0;
+		}
+
+		iExpectedState = nextState(iExpectedState, iEvent);
+		expectedCounter += iEvent;
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (automaton.getState() != iExpectedState || automaton.getCounter() != expectedCounter)
+	{
+		++failures;
+		std::cout << "FAILED: " << name << " took different transitions" << std::endl;
+	}
+
+	return events / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+	long EVENTS = 2000000;
+	if (argc >= 2)
+	{
+		EVENTS = std::stol(argv[1]);
+	}
+
+	ListAutomaton scan(1000);
+	ListAutomaton indexed(1);
+	TableAutomaton table;
+	TableAutomaton tableStack;
+
+	const double scanRate = run(scan, EVENTS, true, "scan");
+	const double indexedRate = run(indexed, EVENTS, true, "indexed");
+	const double tableRate = run(table, EVENTS, true, "MAutTable");
+	const double tableStackRate = run(tableStack, EVENTS, false, "MAutTable stack");
+
+	std::cout << EVENTS << " events, " << STATE_COUNT << " states x " << EVENT_COUNT << " events" << std::endl;
+	std::cout << std::left << std::setw(18) << "dispatch" << std::right << std::setw(16) << "events/s" << std::setw(12) << "ns/event" << std::endl;
+	for (const auto& result : { std::make_pair("scan", scanRate), std::make_pair("indexed", indexedRate), std::make_pair("MAutTable", tableRate), std::make_pair("MAutTable stack", tableStackRate) })
+	{
+		std::cout << std::left << std::setw(18) << result.first << std::right << std::fixed << std::setprecision(0)
+			<< std::setw(16) << result.second << std::setprecision(1) << std::setw(12) << (result.second > 0 ? 1e9 / result.second : 0) << std::endl;
+	}
+
+	return testResult();
+}
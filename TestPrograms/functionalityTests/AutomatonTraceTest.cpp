@@ -0,0 +1,154 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "mautomattable.h"
+#include "mauttrace.h"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Transitions of a MAutTableAutomat are recorded to a trace ring: contents, order, rejected events,
+// wraparound and the rotation of an existing ring to .prev. Also measures the cost of one record,
+// which must stay below the bound given as the first argument (ns, default 100).
+
+enum { STATE_IDLE, STATE_OPEN, STATE_COUNT };
+enum { EVENT_OPEN, EVENT_CLOSE, EVENT_COUNT };
+
+class DoorAutomaton : public MAutTableAutomat<DoorAutomaton, STATE_COUNT, EVENT_COUNT>
+{
+public:
+	DoorAutomaton(int iInstance) : MAutTableAutomat(iInstance)
+	{
+		m_iInitialStateID = STATE_IDLE;
+		setTraceName("DoorAutomaton");
+	}
+
+	static const Table& getTransitionTable()
+	{
+		static const Table table = []()
+		{
+			Table t;
+			t.add(STATE_IDLE, EVENT_OPEN, STATE_OPEN, &DoorAutomaton::doNothing)
+			 .add(STATE_OPEN, EVENT_CLOSE, STATE_IDLE, &DoorAutomaton::doNothing);
+			return t;
+		}();
+		return table;
+	}
+
+	virtual bool reset() { m_iCurrentStateID = m_iInitialStateID; return true; }
+
+private:
+	bool doNothing(MAutEvent*) { return true; }
+};
+
+int main(int argc, char** argv)
+{
+	const double maxRecordCost_ns = argc > 1 ? std::atof(argv[1]) : 100.0;
+	const std::string RING_NAME = "AutomatonTraceTest." + std::to_string(getpid());
+
+	{
+		MAutTraceRing stale(RING_NAME, 16);
+		stale.Record(stale.RegisterName("Stale"), 0, 0, 0, 0, MAutTraceRing::STATUS_OK);
+	}
+
+	MAutTraceRing ring(RING_NAME, 10);
+	check(ring.isOpen(), "ring not created");
+	MAutTraceRing::setProcessRing(&ring);
+
+	MAutTraceRing::Snapshot snapshot;
+	check(MAutTraceRing::Read(RING_NAME + ".prev", snapshot) && snapshot.m_entries.size() == 1
+		&& snapshot.m_entries[0].m_automaton == "Stale", "existing ring not rotated to .prev");
+	check(MAutTraceRing::Read(RING_NAME, snapshot) && snapshot.m_entries.empty(), "new ring not empty");
+	check(snapshot.m_capacity == 16, "capacity not rounded up to a power of two");
+
+	DoorAutomaton first(1);
+	DoorAutomaton second(2);
+	check(first.test() && second.test(), "automaton table rejected");
+
+	MAutEvent open(EVENT_OPEN, "EVENT_OPEN");
+	MAutEvent close(EVENT_CLOSE, "EVENT_CLOSE");
+
+	first.processEvent(open);
+	second.processEvent(close);	// no transition from IDLE
+	first.processEvent(close);
+
+	check(MAutTraceRing::Read(RING_NAME, snapshot), "ring not readable");
+	check(snapshot.m_pid == getpid(), "pid not recorded");
+	check(snapshot.m_recorded == 3 && snapshot.m_entries.size() == 3, "expected 3 records, got " + std::to_string(snapshot.m_entries.size()));
+	if (snapshot.m_entries.size() == 3)
+	{
+		const MAutTraceRing::Entry& opened = snapshot.m_entries[0];
+		check(opened.m_automaton == "DoorAutomaton" && opened.m_iInstance == 1, "automaton name or instance not recorded");
+		check(opened.m_iFromState == STATE_IDLE && opened.m_iEvent == EVENT_OPEN && opened.m_iToState == STATE_OPEN
+			&& opened.m_status == MAutTraceRing::STATUS_OK, "transition not recorded");
+
+		const MAutTraceRing::Entry& rejected = snapshot.m_entries[1];
+		check(rejected.m_iInstance == 2 && rejected.m_iEvent == EVENT_CLOSE && rejected.m_iToState == STATE_IDLE
+			&& rejected.m_status == MAutTraceRing::STATUS_NO_TRANSITION, "rejected event not recorded");
+
+		const MAutTraceRing::Entry& closed = snapshot.m_entries[2];
+		check(closed.m_iFromState == STATE_OPEN && closed.m_iToState == STATE_IDLE, "records out of order");
+		check(opened.m_time_ns <= rejected.m_time_ns && rejected.m_time_ns <= closed.m_time_ns, "timestamps not monotonic");
+	}
+
+	// Wraparound: only the newest records are kept, oldest first
+	for (int i = 0; i < 41; ++i)
+	{
+		first.processEvent(i % 2 == 0 ? open : close);
+	}
+
+	check(MAutTraceRing::Read(RING_NAME, snapshot), "ring not readable after wraparound");
+	check(snapshot.m_recorded == 44 && snapshot.m_entries.size() == 16, "wrapped ring keeps " + std::to_string(snapshot.m_entries.size()) + " records");
+	bool ordered = true;
+	for (size_t i = 0; i < snapshot.m_entries.size(); ++i)
+	{
+		ordered &= snapshot.m_entries[i].m_index == 44 - 16 + i;
+	}
+	check(ordered, "wrapped records out of order");
+	check(!snapshot.m_entries.empty() && snapshot.m_entries.back().m_iEvent == EVENT_OPEN, "newest record lost");
+
+	// Cost of one record, as paid by every processed event
+	const int ITERATIONS = 1000000;
+	const uint16_t name = ring.RegisterName("DoorAutomaton");
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		ring.Record(name, 1, STATE_IDLE, i, STATE_OPEN, MAutTraceRing::STATUS_OK);
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	const double recordCost_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(ITERATIONS);
+	std::cout << "Record: " << recordCost_ns << " ns" << std::endl;
+	check(recordCost_ns < maxRecordCost_ns, "recording a transition takes longer than " + std::to_string(maxRecordCost_ns) + " ns");
+
+	MAutTraceRing::setProcessRing(nullptr);
+	shm_unlink(("/" + RING_NAME).c_str());
+	shm_unlink(("/" + RING_NAME + ".prev").c_str());
+
+	return testResult();
+}
@@ -0,0 +1,388 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AdminService.hpp"
+#include "BulkImport.hpp"
+#include "Sha256.hpp"
+#include "Time.hpp"
+#include "propertiesclass.h"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Bulk import of EMPLOYEES employees with a card and a PIN each into a copy of the shipped database:
+// the import must commit within the bound, leave concurrent card lookups unblocked and roll back
+// completely on any failure. Then the CSV/JSON formats, the spool files and the admin API over its
+// Unix socket, with a stand-in for DatabaseGateway's main loop.
+//   BulkImportTest [MAX_IMPORT_MS] [SOURCE_DATABASE]
+// Writes BulkImportTest.db (+ -wal, -shm) and BulkImportTest.sock in the current directory.
+
+static const std::string DATABASE_PATH = "BulkImportTest.db";
+static const std::string SOCKET_PATH = "BulkImportTest.sock";
+static const int EMPLOYEES = 10000;
+static const double MAX_READER_LATENCY_MS = 100.0;
+
+static void removeDatabase()
+{
+	for (const char* suffix : { "", "-wal", "-shm" })
+	{
+		unlink((DATABASE_PATH + suffix).c_str());
+	}
+}
+
+static bool execute(sqlite3* pDatabase, const std::string& query)
+{
+	char* pError = nullptr;
+	if (sqlite3_exec(pDatabase, query.c_str(), nullptr, nullptr, &pError) != SQLITE_OK)
+	{
+		std::cout << query << ": " << (pError != nullptr ? pError : "") << std::endl;
+		sqlite3_free(pError);
+		return false;
+	}
+	return true;
+}
+
+static int64_t count(sqlite3* pDatabase, const std::string& query)
+{
+	sqlite3_stmt* pStatement = nullptr;
+	int64_t value = -1;
+	if (sqlite3_prepare_v2(pDatabase, query.c_str(), -1, &pStatement, nullptr) == SQLITE_OK && sqlite3_step(pStatement) == SQLITE_ROW)
+	{
+		value = sqlite3_column_int64(pStatement, 0);
+	}
+	sqlite3_finalize(pStatement);
+	return value;
+}
+
+static std::string card(int i, int generation = 0)
+{
+	char uuid[12];
+	std::snprintf(uuid, sizeof(uuid), "%02X-%02X-%02X-%02X", 0xB0 + generation, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+	return uuid;
+}
+
+static std::vector<ImportedEmployee> makeBatch(const std::string& prefix, int size, int generation = 0)
+{
+	std::vector<ImportedEmployee> employees(size);
+	for (int i = 0; i < size; ++i)
+	{
+		employees[i].m_name = prefix + " " + std::to_string(i);
+		employees[i].m_clearance = i % 4;
+		employees[i].m_cards.push_back(card(i, generation));
+		employees[i].m_pins.push_back(std::to_string(900000000 + generation * 1000000 + i));
+	}
+	return employees;
+}
+
+static const ImportedEmployee* find(const std::vector<ImportedEmployee>& employees, const std::string& name)
+{
+	for (const ImportedEmployee& employee : employees)
+	{
+		if (employee.m_name == name) return &employee;
+	}
+	return nullptr;
+}
+
+static bool same(const std::vector<ImportedEmployee>& a, const std::vector<ImportedEmployee>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (a[i].m_name != b[i].m_name || a[i].m_clearance != b[i].m_clearance || a[i].m_cards != b[i].m_cards || a[i].m_pins != b[i].m_pins) return false;
+	}
+	return true;
+}
+
+static bool exportAll(sqlite3* pReader, std::vector<ImportedEmployee>& employees)
+{
+	std::string error;
+	const bool exported = BulkImporter::Export(pReader, employees, error);
+	if (!exported) std::cout << "Export: " << error << std::endl;
+	return exported;
+}
+
+/// Card lookups like the gateway's authorization, every millisecond until `stop`; returns the worst latency in ms
+static double runReader(std::atomic<bool>& stop, std::atomic<long>& lookups)
+{
+	sqlite3* pDatabase = nullptr;
+	sqlite3_open_v2(DATABASE_PATH.c_str(), &pDatabase, SQLITE_OPEN_READONLY, nullptr);
+	sqlite3_stmt* pStatement = nullptr;
+	sqlite3_prepare_v2(pDatabase, "SELECT Clearance FROM Employees JOIN RFIDCardTable ON CardOwnerId = EmployeeId WHERE CardUUID = ?1;", -1, &pStatement, nullptr);
+
+	double worst_ms = 0;
+	for (int i = 0; !stop.load(); ++i)
+	{
+		const std::string uuid = card(i % EMPLOYEES);
+		auto start = std::chrono::steady_clock::now();
+		sqlite3_bind_text(pStatement, 1, uuid.c_str(), -1, SQLITE_TRANSIENT);
+		const int status = sqlite3_step(pStatement);
+		sqlite3_reset(pStatement);
+		worst_ms = std::max(worst_ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		if (status != SQLITE_ROW && status != SQLITE_DONE) worst_ms = 1e9;
+		++lookups;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	sqlite3_finalize(pStatement);
+	sqlite3_close(pDatabase);
+	return worst_ms;
+}
+
+static void testFormats(const std::vector<ImportedEmployee>& exported)
+{
+	std::vector<ImportedEmployee> parsed;
+	std::string error;
+
+	check(AdminService::ParseCsv(AdminService::ToCsv(exported), parsed, error) && same(parsed, exported), "CSV round trip: " + error);
+	check(AdminService::ParseJson(AdminService::ToJson(exported), parsed, error) && same(parsed, exported), "JSON round trip: " + error);
+
+	check(AdminService::ParseCsv("Ana,2,AA-BB-CC-DD,1234\r\n\r\n\"Ana\" , ,,5678\n", parsed, error) && parsed.size() == 1
+		&& parsed[0].m_clearance == 2 && parsed[0].m_cards.size() == 1 && parsed[0].m_pins.size() == 2, "CSV rows of one employee not merged");
+	check(!AdminService::ParseCsv("Ana,2,,1234\nAna,3,,5678\n", parsed, error), "CSV with conflicting clearances accepted");
+	check(!AdminService::ParseCsv("Ana,x,,1234\n", parsed, error), "CSV with malformed clearance accepted");
+
+	check(AdminService::ParseJson("{\"version\":[1,{\"a\":null}],\"employees\":[{\"name\":\"A\\u006ea\",\"x\":true,\"clearance\":1,\"pins\":[\"0123\"]}]}", parsed, error)
+		&& parsed.size() == 1 && parsed[0].m_name == "Ana" && parsed[0].m_pins[0] == "0123", "JSON with unknown members: " + error);
+	check(!AdminService::ParseJson("{\"employees\":[{\"name\":\"Ana\",\"pins\":[1234]}]}", parsed, error), "JSON with numeric PIN accepted");
+	check(!AdminService::ParseJson("{\"employees\":[{\"name\":\"Ana\"}]", parsed, error), "truncated JSON accepted");
+	check(!AdminService::ParseJson("{}", parsed, error), "JSON without employees accepted");
+
+	const std::string name = ImportSpool::CreateName();
+	const std::string path = ImportSpool::getPath(DATABASE_PATH, name);
+	check(ImportSpool::isValidName(name) && !ImportSpool::isValidName("../" + name) && !ImportSpool::isValidName("import.1.x"), "spool names");
+	check(ImportSpool::Write(path, exported, error) && !ImportSpool::Write(path, exported, error), "spool file overwritten");
+	check(ImportSpool::Read(path, parsed, error) && same(parsed, exported), "spool round trip: " + error);
+	unlink(path.c_str());
+
+	check(Sha256::HexHash("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", "SHA-256 of abc");
+}
+
+/// Status line of the last response, clients show its reason phrase
+static std::string lastStatusLine;
+
+/// Blocking client of the admin socket, one request per connection
+static unsigned int request(const std::string& method, const std::string& target, const std::string& key, const std::string& contentType, const std::string& body, std::string& responseBody)
+{
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, SOCKET_PATH.c_str(), sizeof(address.sun_path) - 1);
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	std::string message = method + " " + target + " HTTP/1.1\r\nConnection: close\r\n";
+	if (!key.empty()) message += "Authorization: Bearer " + key + "\r\n";
+	if (!contentType.empty()) message += "Content-Type: " + contentType + "\r\n";
+	message += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+
+	std::string response;
+	char buffer[65536];
+	ssize_t received;
+	for (size_t sent = 0; sent < message.size(); )
+	{
+		const ssize_t written = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+		if (written <= 0) break;
+		sent += written;
+	}
+	while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, received);
+	close(fd);
+
+	const size_t headerEnd = response.find("\r\n\r\n");
+	if (response.size() < 12 || headerEnd == std::string::npos) return 0;
+	responseBody = response.substr(headerEnd + 4);
+	lastStatusLine = response.substr(0, response.find("\r\n"));
+	return static_cast<unsigned int>(std::stoul(response.substr(9, 3)));
+}
+
+static void testAdminApi(sqlite3* pSetup, std::mutex& writeLock)
+{
+	const Properties& properties = GlobalProperties::Get();
+
+	// Keys of an employee with clearance 3 (enough for IMPORT and EXPORT) and one with clearance 1
+	const std::string adminKey = "admin-key", userKey = "user-key";
+	check(execute(pSetup, "INSERT INTO WebPassTable(UserId, WebPassHash) VALUES "
+		"((SELECT EmployeeId FROM Employees WHERE Name = 'Ivan Mazuranic'), '" + Sha256::HexHash(adminKey) + "'), "
+		"((SELECT EmployeeId FROM Employees WHERE Name = 'Marin Drzic'), '" + Sha256::HexHash(userKey) + "');"), "keys not stored");
+
+	// Stand-in for DatabaseGateway: IMPORT requests go to the BulkImporter, which replies from its own mailbox
+	std::atomic<bool> stop(false);
+	std::thread gateway([&]()
+	{
+		DataMailbox mailbox(properties.DBGW_MB_NAME);
+		mailbox.setRTO_ns(100 * Time::ms_to_ns);
+		BulkImporter importer(DATABASE_PATH, writeLock);
+		importer.Start(properties.DBGW_MB_NAME + ".import");
+		while (!stop.load())
+		{
+			DataMailboxMessage* pMessage = mailbox.receive(enuReceiveOptions::TIMED);
+			CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage);
+			if (pCommand != nullptr && pCommand->getCommandId() == CommandMessage::IMPORT)
+			{
+				importer.Submit(ImportSpool::getPath(DATABASE_PATH, pCommand->getParameterAt(0).getData()), *pCommand);
+			}
+			delete pMessage;
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	MailboxRpc rpc(properties.WEBAPI_MB_NAME);
+	rpc.Start();
+	AdminService admin(DATABASE_PATH, &rpc, properties.DBGW_MB_NAME);
+	HttpServer server(SOCKET_PATH, 4, nullptr);
+	admin.RegisterRoutes(server);
+	std::thread serverThread(&HttpServer::Run, &server);
+
+	std::string body;
+	const std::string csv = "employee,clearance,card,pin\nAdmin Api 1,2,C0-00-00-01,70001\nAdmin Api 2,1,,70002\nAdmin Api 2,,,70003\n";
+	check(request("GET", "/admin/export", "", "", "", body) == 401, "export without key not 401");
+	check(request("GET", "/admin/export", "wrong-key", "", "", body) == 401, "export with unknown key not 401");
+	check(request("POST", "/admin/import", userKey, "text/csv", csv, body) == 403, "import with low clearance not 403");
+	check(request("POST", "/admin/import", adminKey, "text/plain", csv, body) == 415, "import of text/plain not 415");
+	check(lastStatusLine == "HTTP/1.1 415 Unsupported Media Type", "status line of 415: " + lastStatusLine);
+	check(std::string(HttpServer::StatusText(504)) == "Gateway Timeout", "reason phrase of 504");
+	check(request("POST", "/admin/import", adminKey, "text/csv", "Bad Card,1,XX,1234\n", body) == 400, "invalid import not 400");
+
+	const unsigned int status = request("POST", "/admin/import", adminKey, "text/csv; charset=utf-8", csv, body);
+	check(status == 200 && body.find("\"imported\":2") != std::string::npos, "import over the admin socket: " + std::to_string(status) + " " + body);
+	check(request("GET", "/admin/export?format=csv", adminKey, "", "", body) == 200 && body.find("Admin Api 2,1,,70003\n") != std::string::npos, "export after import");
+	check(request("GET", "/admin/export?format=xml", adminKey, "", "", body) == 400, "unknown export format not 400");
+
+	server.Stop();
+	serverThread.join();
+	stop = true;
+	gateway.join();
+}
+
+int main(int argc, char** argv)
+{
+	const double MAX_IMPORT_MS = argc > 1 ? std::stod(argv[1]) : 2000.0;
+	const std::string sourcePath = argc > 2 ? argv[2] : "../DatabaseGateway/res/Database_11032021.db";
+
+	removeDatabase();
+	{
+		std::ifstream source(sourcePath, std::ios::binary);
+		std::ofstream(DATABASE_PATH, std::ios::binary) << source.rdbuf();
+	}
+
+	sqlite3* pSetup = nullptr;
+	sqlite3_open(DATABASE_PATH.c_str(), &pSetup);
+	if (!execute(pSetup, "PRAGMA journal_mode=WAL; INSERT OR REPLACE INTO Commands(CommandName, CommandClearance) VALUES ('IMPORT', 3), ('EXPORT', 3);"))
+	{
+		std::cout << "FAILED: cannot prepare a copy of " << sourcePath << std::endl;
+		return -1;
+	}
+	const int64_t existingEmployees = count(pSetup, "SELECT COUNT(*) FROM Employees;");
+
+	sqlite3* pReader = nullptr;
+	sqlite3_open_v2(DATABASE_PATH.c_str(), &pReader, SQLITE_OPEN_READONLY, nullptr);
+
+	std::mutex writeLock;
+	BulkImporter importer(DATABASE_PATH, writeLock);
+	std::string error;
+
+	// First import, with card lookups running next to it
+	const std::vector<ImportedEmployee> batch = makeBatch("Employee", EMPLOYEES);
+	std::atomic<bool> stopReader(false);
+	std::atomic<long> lookups(0);
+	double readerWorst_ms = 0;
+	std::thread reader([&]() { readerWorst_ms = runReader(stopReader, lookups); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	auto start = std::chrono::steady_clock::now();
+	check(importer.Import(batch, error), "import failed: " + error);
+	const double import_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	stopReader = true;
+	reader.join();
+
+	std::vector<ImportedEmployee> exported;
+	check(exportAll(pReader, exported) && exported.size() == static_cast<size_t>(existingEmployees + EMPLOYEES), "export count after import");
+	check(count(pReader, "SELECT COUNT(*) FROM RFIDCardTable WHERE CardUUID LIKE 'B0-%';") == EMPLOYEES
+		&& count(pReader, "SELECT COUNT(*) FROM KeypadPasswordTable WHERE PasswordHash LIKE '90%';") == EMPLOYEES, "credential counts after import");
+	const ImportedEmployee* pEmployee = find(exported, "Employee 4242");
+	check(pEmployee != nullptr && pEmployee->m_clearance == 2 && pEmployee->m_cards == batch[4242].m_cards && pEmployee->m_pins == batch[4242].m_pins, "Employee 4242 after import");
+	check(find(exported, "Marin Drzic") != nullptr && find(exported, "Marin Drzic")->m_pins.size() == 2, "employees outside the batch changed");
+
+	// Same batch again: nothing to write
+	start = std::chrono::steady_clock::now();
+	check(importer.Import(batch, error), "re-import failed: " + error);
+	const double reimport_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::vector<ImportedEmployee> reexported;
+	check(exportAll(pReader, reexported) && same(reexported, exported), "re-import of the same batch changed the database");
+
+	// Invalid record or a failing statement in the middle: nothing of the batch is written
+	std::vector<ImportedEmployee> changed = makeBatch("Employee", EMPLOYEES, 1);
+	changed[EMPLOYEES / 2].m_cards[0] = "not a card";
+	check(!importer.Import(changed, error), "batch with an invalid card accepted");
+
+	changed[EMPLOYEES / 2].m_cards[0] = card(EMPLOYEES / 2, 1);
+	changed.back().m_name = "Poison";
+	execute(pSetup, "CREATE TRIGGER Poison BEFORE INSERT ON Employees WHEN NEW.Name = 'Poison' BEGIN SELECT RAISE(ABORT, 'poisoned'); END;");
+	check(!importer.Import(changed, error), "batch with a failing insert accepted");
+	execute(pSetup, "DROP TRIGGER Poison;");
+	check(exportAll(pReader, reexported) && same(reexported, exported), "failed batch not rolled back");
+
+	// A listed card owned by someone else moves; unlisted credentials of the imported employee are dropped
+	ImportedEmployee mover = batch[1];
+	mover.m_cards = batch[2].m_cards;
+	mover.m_pins.clear();
+	check(importer.Import({ mover }, error), "card move failed: " + error);
+	check(exportAll(pReader, reexported) && find(reexported, "Employee 1")->m_cards == batch[2].m_cards
+		&& find(reexported, "Employee 1")->m_pins.empty() && find(reexported, "Employee 2")->m_cards.empty()
+		&& find(reexported, "Employee 2")->m_pins == batch[2].m_pins, "card not moved");
+
+	testFormats(reexported);
+	testAdminApi(pSetup, writeLock);
+
+	std::cout << "Import of " << EMPLOYEES << " employees: " << import_ms << " ms, again unchanged: " << reimport_ms << " ms" << std::endl;
+	std::cout << "Card lookups during import: " << lookups.load() << ", worst " << readerWorst_ms << " ms" << std::endl;
+
+	check(import_ms < MAX_IMPORT_MS, "import slower than " + std::to_string(MAX_IMPORT_MS) + " ms");
+	check(readerWorst_ms < MAX_READER_LATENCY_MS, "card lookup blocked by the import");
+
+	sqlite3_close(pReader);
+	sqlite3_close(pSetup);
+	removeDatabase();
+
+	return testResult();
+}
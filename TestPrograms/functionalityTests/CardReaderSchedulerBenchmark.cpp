@@ -0,0 +1,211 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "CardReaderScheduler.hpp"
+#include "SimulatedCardReader.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+// Tap-to-event latency, poll rate and CPU use of fixed polling, adaptive polling and IRQ driven polling,
+// measured on a SimulatedCardReader whose every poll costs POLL_COST_US of CPU time.
+// Usage: CardReaderSchedulerBenchmark [TAPS]
+
+using Clock = std::chrono::steady_clock;
+
+static const unsigned int POLL_COST_US = 2000;
+
+static double processCpuTime_ms()
+{
+	timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/// Records the latency of the first read after every `PresentCard()`
+class LatencyRecorder : public ICardReaderListener
+{
+public:
+	explicit LatencyRecorder(SimulatedCardReader* pReader) : m_pReader(pReader) {}
+
+	virtual void CardDetected(ICardReader* pReader, const std::string& cardUUID) override
+	{
+		(void)pReader;
+		(void)cardUUID;
+
+		auto latency = Clock::now() - m_pReader->getPresentedAt();
+		m_pReader->RemoveCard();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count() / 1.0);
+		++m_detected;
+	}
+
+	unsigned int detected()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_detected;
+	}
+
+	std::vector<double> latencies_us()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_latencies_us;
+	}
+
+private:
+	SimulatedCardReader* m_pReader;
+	std::mutex m_mutex;
+	std::vector<double> m_latencies_us;
+	unsigned int m_detected = 0;
+};
+
+struct ScenarioResult
+{
+	double medianLatency_ms;
+	double maxLatency_ms;
+	double pollsPerSecond;
+	double cpu_percent;
+	unsigned int finalInterval_ms;
+};
+
+static ScenarioResult runScenario(const std::string& name, const CardReaderSettings& settings, bool withIrq, int taps)
+{
+	SimulatedCardReader reader(name, POLL_COST_US, withIrq);
+	LatencyRecorder recorder(&reader);
+	CardReaderScheduler scheduler(&recorder);
+	scheduler.AddReader(&reader, settings);
+
+	std::atomic<bool> stop{ false };
+	std::thread pollingThread([&]()
+	{
+		while (!stop)
+		{
+			scheduler.WaitAndPoll();
+		}
+	});
+
+	const double cpuStart_ms = processCpuTime_ms();
+	const Clock::time_point start = Clock::now();
+
+	unsigned int seed = 12345;
+	for (int tap = 0; tap < taps; ++tap)
+	{
+		// Quiet period long enough for the adaptive scheduler to back off completely, with jitter so taps
+		// do not line up with the poll period
+		seed = seed * 1103515245u + 12345u;
+		usleep((settings.activityHold_ms + 300 + (seed >> 16) % 200) * 1000);
+
+		reader.PresentCard("DE-AD-BE-" + std::to_string(10 + tap % 90));
+		for (int i = 0; i < 2000 && recorder.detected() <= (unsigned int)tap; ++i)
+		{
+			usleep(500);
+		}
+	}
+
+	// Idle tail: by its end the scheduler must have backed off completely
+	usleep((settings.activityHold_ms + 4 * settings.idleInterval_ms) * 1000);
+
+	const double elapsed_s = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1e6;
+	const double cpu_ms = processCpuTime_ms() - cpuStart_ms;
+
+	stop = true;
+	scheduler.Interrupt();
+	pollingThread.join();
+
+	ScenarioResult result;
+	result.finalInterval_ms = scheduler.getCurrentInterval_ms(&reader);
+
+	std::vector<double> latencies = recorder.latencies_us();
+	check(latencies.size() == (size_t)taps, name + ": " + std::to_string(taps - (int)latencies.size()) + " taps not detected");
+	std::sort(latencies.begin(), latencies.end());
+
+	result.medianLatency_ms = latencies.empty() ? 0 : latencies[latencies.size() / 2] / 1000.0;
+	result.maxLatency_ms = latencies.empty() ? 0 : latencies.back() / 1000.0;
+	result.pollsPerSecond = scheduler.getPollCount(&reader) / elapsed_s;
+	result.cpu_percent = cpu_ms / (elapsed_s * 1000.0) * 100.0;
+
+	std::cout << name << ": median latency " << result.medianLatency_ms << " ms, max " << result.maxLatency_ms
+		<< " ms, " << result.pollsPerSecond << " polls/s, CPU " << result.cpu_percent << " %" << std::endl;
+
+	return result;
+}
+
+/// Reader polled as often as allowed must still rest between polls according to its duty cycle
+static void checkDutyCycle()
+{
+	SimulatedCardReader reader("duty", POLL_COST_US);
+	LatencyRecorder recorder(&reader);
+	CardReaderScheduler scheduler(&recorder);
+
+	const unsigned int DUTY_CYCLE_PERCENT = 20;
+	scheduler.AddReader(&reader, CardReaderSettings{ 0, 0, 0, DUTY_CYCLE_PERCENT });
+
+	const Clock::time_point end = Clock::now() + std::chrono::seconds(1);
+	while (Clock::now() < end)
+	{
+		scheduler.WaitAndPoll(10);
+	}
+
+	// Every poll costs POLL_COST_US and must be followed by 4 times as much rest
+	const double maxPolls = 1e6 / (POLL_COST_US * 100.0 / DUTY_CYCLE_PERCENT);
+	std::cout << "Duty cycle " << DUTY_CYCLE_PERCENT << " %: " << scheduler.getPollCount(&reader) << " polls/s (limit " << maxPolls << ")" << std::endl;
+	check(scheduler.getPollCount(&reader) <= maxPolls + 1, "duty cycle exceeded");
+}
+
+int main(int argc, char** argv)
+{
+	int TAPS = 10;
+	if (argc >= 2)
+	{
+		TAPS = std::stoi(argv[1]);
+		if (TAPS < 1)
+		{
+			std::cout << "Input argument TAPS cannot be negative or zero!" << std::endl;
+			return -1;
+		}
+	}
+
+	// Old behaviour: sleep RFID_READ_TIMEOUT_MS, poll, repeat
+	ScenarioResult fixed = runScenario("Fixed 10 ms", CardReaderSettings{ 10, 10, 0, 100 }, false, TAPS);
+	ScenarioResult adaptive = runScenario("Adaptive 10 - 250 ms", CardReaderSettings{ 10, 250, 200, 50 }, false, TAPS);
+	ScenarioResult irq = runScenario("Adaptive with IRQ", CardReaderSettings{ 10, 250, 200, 50 }, true, TAPS);
+
+	check(adaptive.finalInterval_ms == 250, "adaptive polling did not back off to the idle interval");
+	check(adaptive.pollsPerSecond < fixed.pollsPerSecond / 2, "adaptive polling does not poll less than fixed polling");
+	check(irq.maxLatency_ms < fixed.maxLatency_ms, "IRQ latency not below fixed polling latency");
+
+	checkDutyCycle();
+
+	return testResult();
+}
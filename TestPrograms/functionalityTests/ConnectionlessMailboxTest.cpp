@@ -0,0 +1,122 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "DataMailbox.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+// Connectionless requests answered with a handshaked send(), the way DatabaseGateway answers doors:
+// the reply must reach the client (not its own request), and requests arriving while the server is
+// in the middle of that handshake must not be lost. Uses mailboxes cltest.client and cltest.server.
+
+static const std::string CLIENT_NAME = "cltest.client";
+static const std::string SERVER_NAME = "cltest.server";
+
+/// Requests are tagged by door ID, replies carry it back as clearance
+static void sendRequest(DataMailbox& mailbox, MailboxReference& server, DoorId doorId)
+{
+	CommandMessage request(CommandMessage::enuCommand::AUTHENTICATE);
+	request.setDoorId(doorId);
+	mailbox.sendConnectionless(server, &request);
+}
+
+int main()
+{
+	std::atomic<bool> firstReceived(false), othersSent(false);
+	std::atomic<int> keptRequests(0);
+
+	std::thread server([&]()
+	{
+		DataMailbox mailbox(SERVER_NAME);
+		mailbox.setRTO_s(2);
+
+		std::unique_ptr<DataMailboxMessage> pFirst(mailbox.receive(enuReceiveOptions::TIMED));
+		CommandMessage* pRequest = dynamic_cast<CommandMessage*>(pFirst.get());
+		firstReceived = true;
+		if (pRequest == nullptr)
+		{
+			return;
+		}
+
+		while (!othersSent)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// The other requests are already queued, so they are read while waiting for the client's CTS
+		DatabaseReply reply(static_cast<Clearance>(pRequest->getDoorId()));
+		mailbox.send(pRequest->getSource(), &reply);
+
+		for (DoorId doorId = 2; doorId <= 4; ++doorId)
+		{
+			std::unique_ptr<DataMailboxMessage> pMessage(mailbox.receive(enuReceiveOptions::TIMED));
+			CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage.get());
+			if (pCommand != nullptr && pCommand->getDoorId() == doorId)
+			{
+				++keptRequests;
+			}
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	DataMailbox mailbox(CLIENT_NAME);
+	mailbox.setRTO_s(2);
+	MailboxReference serverReference(SERVER_NAME);
+
+	sendRequest(mailbox, serverReference, 1);
+	while (!firstReceived)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	for (DoorId doorId = 2; doorId <= 4; ++doorId)
+	{
+		sendRequest(mailbox, serverReference, doorId);
+	}
+	othersSent = true;
+
+	std::unique_ptr<DataMailboxMessage> pMessage(mailbox.receive(enuReceiveOptions::TIMED));
+	DatabaseReply* pReply = dynamic_cast<DatabaseReply*>(pMessage.get());
+
+	if (pReply == nullptr || pReply->getClearance() != 1)
+	{
+		std::cout << "FAILED: reply to a connectionless request not received, got " << pMessage->getDataType().toString() << std::endl;
+		// The server still waits for the handshake of its reply
+		server.detach();
+		return -1;
+	}
+
+	server.join();
+
+	if (keptRequests != 3)
+	{
+		std::cout << "FAILED: requests received during the reply's handshake: " << keptRequests << " of 3" << std::endl;
+		return -1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
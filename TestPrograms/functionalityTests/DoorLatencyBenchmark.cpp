@@ -0,0 +1,435 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "DataMailbox.hpp"
+#include "ProcessManager.hpp"
+#include "WatchdogServer.hpp"
+#include "propertiesclass.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// End-to-end latency of door requests: simulated PIN entries or card taps go through the real HardwareDaemon,
+// MainApplication and DatabaseGateway processes (started by ProcessManager) until the door indicators execute
+// the outcome. Every process stamps the request's LatencyTrace; the indicators send it to LATENCY_TRACE_SOCKET.
+//
+// Run it where Startup runs (config.xml and the executables), with a config.xml that has
+// <Backend>simulated</Backend>, a <ControlSocket> and a <LatencyTraceSocket>. The PIN or cards should be in the database,
+// otherwise the denial path is measured. A card is not read again within RFID_SAME_CARD_TIMEOUT_MS, so cycle enough cards.
+//
+// Usage: DoorLatencyBenchmark [--requests N] [--warmup N] [--door ID] [--pin PIN | --cards UUID,UUID,...]
+//                             [--timeout_ms MS] [--max_p99_ms MS]
+// Prints the results as one JSON object. Fails if a request times out or the end-to-end p99 exceeds --max_p99_ms.
+
+struct Options
+{
+	unsigned int requests = 1000;
+	unsigned int warmup = 50;
+	DoorId door = NO_DOOR;
+	std::string pin = "1234";
+	std::vector<std::string> cards;
+	unsigned int timeout_ms = 5000;
+	double max_p99_ms = 0;
+};
+
+/// One finished request; times are CLOCK_MONOTONIC nanoseconds
+struct Sample
+{
+	int64_t injected_ns;
+	LatencyTrace trace;
+	bool granted;
+};
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string name = argv[i];
+		const std::string value = argv[i + 1];
+
+		if (name == "--requests") options.requests = std::stoul(value);
+		else if (name == "--warmup") options.warmup = std::stoul(value);
+		else if (name == "--door") options.door = (DoorId)std::stoul(value);
+		else if (name == "--pin") options.pin = value;
+		else if (name == "--timeout_ms") options.timeout_ms = std::stoul(value);
+		else if (name == "--max_p99_ms") options.max_p99_ms = std::stod(value);
+		else if (name == "--cards")
+		{
+			std::stringstream list(value);
+			for (std::string card; std::getline(list, card, ',');)
+			{
+				if (!card.empty()) options.cards.push_back(card);
+			}
+		}
+		else return false;
+	}
+
+	return argc % 2 == 1 && options.requests > 0;
+}
+
+static bool checkConfiguration(const Properties& properties, std::string& error)
+{
+	if (properties.HARDWARE_BACKEND != "simulated") error = "Settings > Hardware > Backend must be simulated";
+	else if (properties.SIMULATION_CONTROL_SOCKET.empty()) error = "Settings > Hardware > Simulation > ControlSocket is not set";
+	else if (properties.LATENCY_TRACE_SOCKET.empty()) error = "Settings > Hardware > LatencyTraceSocket is not set";
+	else if (properties.DOORS.empty()) error = "no doors configured";
+
+	return error.empty();
+}
+
+static int bindTraceSocket(const std::string& path)
+{
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	unlink(path.c_str());
+	if (fd < 0 || bind(fd, (const sockaddr*)&address, sizeof(address)) < 0)
+	{
+		if (fd >= 0) close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/// The simulated backend opens its control socket once HardwareDaemon is up
+static int connectControlSocket(const std::string& path, unsigned int timeout_ms)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	for (unsigned int waited_ms = 0; waited_ms < timeout_ms; waited_ms += 50)
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd >= 0 && connect(fd, (const sockaddr*)&address, sizeof(address)) == 0)
+		{
+			return fd;
+		}
+
+		if (fd >= 0) close(fd);
+		usleep(50 * 1000);
+	}
+
+	return -1;
+}
+
+/// Sends one control command and waits for its reply line
+static bool sendCommand(int fd, const std::string& command, std::string& reply)
+{
+	const std::string line = command + "\n";
+	if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+	{
+		return false;
+	}
+
+	reply.clear();
+	char c = 0;
+	while (recv(fd, &c, 1, 0) == 1)
+	{
+		if (c == '\n') return true;
+		reply += c;
+	}
+
+	return false;
+}
+
+/// Waits for the trace of the request injected at `injected_ns`; older traces (e.g. of timed out requests) are skipped
+static bool receiveTrace(int fd, int64_t injected_ns, unsigned int timeout_ms, Sample& sample)
+{
+	const int64_t deadline_ns = injected_ns + (int64_t)timeout_ms * 1000000LL;
+
+	for (int64_t now_ns = LatencyTrace::Now_ns(); now_ns < deadline_ns; now_ns = LatencyTrace::Now_ns())
+	{
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, (int)((deadline_ns - now_ns) / 1000000LL) + 1) <= 0)
+		{
+			continue;
+		}
+
+		char datagram[256];
+		ssize_t size = recv(fd, datagram, sizeof(datagram), 0);
+		if (size < (ssize_t)sizeof(InputParameter::enuType))
+		{
+			continue;
+		}
+
+		InputParameter::enuType request;
+		memcpy(&request, datagram, sizeof(request));
+
+		LatencyTrace trace;
+		if (!trace.Deserialize(datagram + sizeof(request), size - sizeof(request)) || trace.getTime_ns(LatencyTrace::HARDWARE_SENT) < injected_ns)
+		{
+			continue;
+		}
+
+		sample.injected_ns = injected_ns;
+		sample.trace = trace;
+		sample.granted = request == InputParameter::DoorOpen_wBuzzerSuccess;
+		return true;
+	}
+
+	return false;
+}
+
+/// Nearest-rank percentile of sorted `values`
+static double percentile(const std::vector<double>& values, double percent)
+{
+	size_t rank = (size_t)std::ceil(percent / 100.0 * values.size());
+	return values[rank == 0 ? 0 : rank - 1];
+}
+
+static std::string summarize(std::vector<double> values_us)
+{
+	std::sort(values_us.begin(), values_us.end());
+
+	double sum = 0;
+	for (double value : values_us) sum += value;
+
+	std::stringstream json;
+	json << std::fixed << std::setprecision(1)
+		<< "{ \"count\": " << values_us.size()
+		<< ", \"mean\": " << sum / values_us.size()
+		<< ", \"p50\": " << percentile(values_us, 50)
+		<< ", \"p99\": " << percentile(values_us, 99)
+		<< ", \"p99_9\": " << percentile(values_us, 99.9)
+		<< ", \"max\": " << values_us.back() << " }";
+	return json.str();
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::cout << "Usage: DoorLatencyBenchmark [--requests N] [--warmup N] [--door ID] [--pin PIN | --cards UUID,UUID,...] [--timeout_ms MS] [--max_p99_ms MS]" << std::endl;
+		return -1;
+	}
+
+	const Properties& properties = GlobalProperties::Get();
+
+	std::string error;
+	if (!checkConfiguration(properties, error))
+	{
+		std::cout << "FAILED: " << error << std::endl;
+		return -1;
+	}
+
+	if (options.door == NO_DOOR)
+	{
+		options.door = properties.DOORS.front().ID;
+	}
+
+	int traceSocket = bindTraceSocket(properties.LATENCY_TRACE_SOCKET);
+	if (traceSocket < 0)
+	{
+		std::cout << "FAILED: cannot bind " << properties.LATENCY_TRACE_SOCKET << ": " << strerror(errno) << std::endl;
+		return -1;
+	}
+
+	Logger logger("benchmark.log");
+	Logger processManager_logger("benchmark.process_manager.log");
+
+	ProcessManager processManager(&processManager_logger);
+	WatchdogServer watchdog(properties.WATCHDOG_SERVER_NAME, &processManager, &logger);
+
+	GlobalProperties::ExportImage();
+
+	processManager.createProcess(properties.HARDWARED_EXECUTABLE);
+	processManager.createProcess(properties.MAIN_APP_EXECUTABLE);
+	processManager.createProcess(properties.DBGW_EXECUTABLE);
+	processManager.initiateAll();
+
+	watchdog.SetPeriod_us(properties.WATCHDOG_SERVER_PERIOD_MS * Time::ms_to_us);
+
+	std::atomic<bool> stopWatchdog(false);
+	std::thread watchdogThread([&]()
+	{
+		while (!stopWatchdog && !watchdog.hasRequestedTermination())
+		{
+			watchdog.WaitForRequestAndParse();
+		}
+	});
+
+	std::vector<Sample> samples;
+	unsigned int timeouts = 0;
+	int64_t measuredStart_ns = 0;
+	int64_t measuredEnd_ns = 0;
+
+	int controlSocket = connectControlSocket(properties.SIMULATION_CONTROL_SOCKET, 10000);
+	if (controlSocket < 0)
+	{
+		error = "cannot connect to " + properties.SIMULATION_CONTROL_SOCKET;
+	}
+
+	// Requests are issued one after another: the next one is injected when the previous outcome reached the door
+	for (unsigned int i = 0; error.empty() && i < options.warmup + options.requests; ++i)
+	{
+		const std::string command = options.cards.empty()
+			? "keys " + std::to_string(options.door) + " *" + options.pin + "E"
+			: "card " + std::to_string(options.door) + " " + options.cards[i % options.cards.size()];
+
+		if (i == options.warmup)
+		{
+			measuredStart_ns = LatencyTrace::Now_ns();
+		}
+
+		const int64_t injected_ns = LatencyTrace::Now_ns();
+
+		std::string reply;
+		if (!sendCommand(controlSocket, command, reply) || reply != "OK")
+		{
+			error = "command \"" + command + "\" failed: " + reply;
+			break;
+		}
+
+		Sample sample;
+		bool received = receiveTrace(traceSocket, injected_ns, options.timeout_ms, sample);
+
+		if (i < options.warmup)
+		{
+			continue;
+		}
+
+		if (received)
+		{
+			samples.push_back(sample);
+		}
+		else
+		{
+			++timeouts;
+		}
+	}
+	measuredEnd_ns = LatencyTrace::Now_ns();
+
+	stopWatchdog = true;
+	watchdogThread.join();
+	processManager.killAll();
+
+	if (controlSocket >= 0) close(controlSocket);
+	close(traceSocket);
+	unlink(properties.LATENCY_TRACE_SOCKET.c_str());
+
+	if (!error.empty())
+	{
+		std::cout << "FAILED: " << error << std::endl;
+		return -1;
+	}
+
+	if (samples.empty())
+	{
+		std::cout << "FAILED: no request completed" << std::endl;
+		return -1;
+	}
+
+	// Stage latencies between consecutive stamps; "INJECTED" is the command sent to the simulated reader
+	std::vector<double> endToEnd_us;
+	std::map<std::string, std::vector<double>> stages_us;
+	std::vector<std::string> stageOrder;
+	unsigned int granted = 0;
+
+	for (const Sample& sample : samples)
+	{
+		granted += sample.granted ? 1 : 0;
+
+		std::string previousName = "INJECTED";
+		int64_t previous_ns = sample.injected_ns;
+		for (unsigned int s = 0; s < sample.trace.size(); ++s)
+		{
+			const LatencyTrace::Stamp& stamp = sample.trace.at(s);
+			const std::string name = previousName + "->" + LatencyTrace::getStageName(stamp.m_stage);
+
+			if (stages_us.find(name) == stages_us.end())
+			{
+				stageOrder.push_back(name);
+			}
+			stages_us[name].push_back((stamp.m_time_ns - previous_ns) / 1000.0);
+
+			previousName = LatencyTrace::getStageName(stamp.m_stage);
+			previous_ns = stamp.m_time_ns;
+		}
+
+		endToEnd_us.push_back((previous_ns - sample.injected_ns) / 1000.0);
+	}
+
+	const double duration_s = (measuredEnd_ns - measuredStart_ns) / 1e9;
+	std::sort(endToEnd_us.begin(), endToEnd_us.end());
+	const double p99_ms = percentile(endToEnd_us, 99) / 1000.0;
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "{\n"
+		<< "  \"benchmark\": \"DoorLatencyBenchmark\",\n"
+		<< "  \"input\": \"" << (options.cards.empty() ? "pin" : "card") << "\",\n"
+		<< "  \"door\": " << options.door << ",\n"
+		<< "  \"requests\": " << options.requests << ",\n"
+		<< "  \"completed\": " << samples.size() << ",\n"
+		<< "  \"timeouts\": " << timeouts << ",\n"
+		<< "  \"granted\": " << granted << ",\n"
+		<< "  \"denied\": " << samples.size() - granted << ",\n"
+		<< "  \"duration_s\": " << duration_s << ",\n"
+		<< "  \"throughput_rps\": " << samples.size() / duration_s << ",\n"
+		<< "  \"end_to_end_us\": " << summarize(endToEnd_us) << ",\n"
+		<< "  \"stages_us\": {\n";
+
+	for (size_t s = 0; s < stageOrder.size(); ++s)
+	{
+		std::cout << "    \"" << stageOrder[s] << "\": " << summarize(stages_us[stageOrder[s]]) << (s + 1 < stageOrder.size() ? "," : "") << "\n";
+	}
+
+	std::cout << "  }\n}" << std::endl;
+
+	if (timeouts != 0)
+	{
+		std::cout << "FAILED: " << timeouts << " requests timed out" << std::endl;
+		return -1;
+	}
+
+	if (options.max_p99_ms > 0 && p99_ms > options.max_p99_ms)
+	{
+		std::cout << "FAILED: end-to-end p99 " << p99_ms << " ms exceeds " << options.max_p99_ms << " ms" << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "FieldValidators.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+// Checks FieldValidators against the regular expressions previously used in ValidationUtils.hpp
+// and measures both. Usage: FieldValidatorsTest [ITERATIONS]
+
+typedef bool (*ValidatorFunction)(const std::string&);
+
+struct Field
+{
+	const char* name;
+	const char* pattern;
+	std::regex mask;
+	ValidatorFunction validator;
+
+	Field(const char* name, const char* pattern, ValidatorFunction validator)
+		: name(name), pattern(pattern), mask(pattern), validator(validator) {}
+};
+
+static bool validateCardUUID(const std::string& data) { return FieldValidators::CardUUID::test(data); }
+static bool validateKeypadPassword(const std::string& data) { return FieldValidators::KeypadPassword::test(data); }
+static bool validatePlainData(const std::string& data) { return FieldValidators::PlainData::test(data); }
+static bool validateSignedNumber(const std::string& data) { return FieldValidators::SignedNumber::test(data); }
+
+static void compare(Field& field, const std::string& data)
+{
+	bool expected = std::regex_match(data, field.mask);
+	bool actual = field.validator(data);
+
+	if (expected != actual)
+	{
+		++failures;
+		std::cout << "MISMATCH [" << field.name << "] \"" << data << "\" regex: " << expected << " validator: " << actual << std::endl;
+	}
+}
+
+/// Every string over `alphabet` with length in [0, maxLength]
+static void compareAllStrings(Field& field, const std::string& alphabet, size_t maxLength)
+{
+	std::string data;
+	std::vector<size_t> indices;
+
+	compare(field, data);
+
+	for (size_t length = 1; length <= maxLength; ++length)
+	{
+		indices.assign(length, 0);
+		data.assign(length, alphabet[0]);
+
+		while (true)
+		{
+			compare(field, data);
+
+			size_t position = 0;
+			while (position < length && ++indices[position] == alphabet.size())
+			{
+				indices[position] = 0;
+				data[position] = alphabet[0];
+				++position;
+			}
+
+			if (position == length) break;
+			data[position] = alphabet[indices[position]];
+		}
+	}
+}
+
+/// Every byte value substituted at every position of every `seed`
+static void compareAllBytes(Field& field, const std::vector<std::string>& seeds)
+{
+	for (const std::string& seed : seeds)
+	{
+		compare(field, seed);
+
+		for (size_t position = 0; position < seed.size(); ++position)
+		{
+			for (int c = 0; c < 256; ++c)
+			{
+				std::string data = seed;
+				data[position] = (char)c;
+				compare(field, data);
+			}
+		}
+	}
+}
+
+static void benchmark(Field& field, const std::vector<std::string>& samples, int iterations)
+{
+	using Clock = std::chrono::steady_clock;
+	volatile bool sink = false;
+
+	// Same as the old ValidationUtils: regex constructed on every call
+	auto start = Clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		std::regex mask(field.pattern);
+		sink = std::regex_match(samples[i % samples.size()], mask);
+	}
+	auto regexConstructed = Clock::now() - start;
+
+	start = Clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		sink = std::regex_match(samples[i % samples.size()], field.mask);
+	}
+	auto regexPrebuilt = Clock::now() - start;
+
+	start = Clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		sink = field.validator(samples[i % samples.size()]);
+	}
+	auto validator = Clock::now() - start;
+	(void)sink;
+
+	auto perCall = [iterations](Clock::duration d) { return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / (double)iterations; };
+
+	std::cout << field.name << ": regex (constructed per call) " << perCall(regexConstructed) << " ns/call, "
+		<< "regex (prebuilt) " << perCall(regexPrebuilt) << " ns/call, "
+		<< "validator " << perCall(validator) << " ns/call" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int ITERATIONS = 100000;
+	if (argc >= 2)
+	{
+		ITERATIONS = std::stoi(argv[1]);
+		if (ITERATIONS < 1)
+		{
+			std::cout << "Input argument ITERATIONS cannot be negative or zero!" << std::endl;
+			return -1;
+		}
+	}
+
+	Field cardUUID("CardUUID", "([a-zA-Z0-9]{2}-){3}[a-zA-Z0-9]{2}", validateCardUUID);
+	Field keypadPassword("KeypadPassword", "[0-9]{4,10}", validateKeypadPassword);
+	Field plainData("PlainData", "[a-zA-Z0-9 \\.\\-\\+]{0,64}", validatePlainData);
+	Field signedNumber("SignedNumber", "(\\-|\\+)?[0-9]{1,10}", validateSignedNumber);
+
+	// One representative of each character class boundary plus characters no mask accepts
+	const std::string alphabet = "09azAZ-+. _/";
+
+	std::cout << "Comparing validators against regular expressions..." << std::endl;
+
+	compareAllStrings(cardUUID, "0Z-_", 11);
+	compareAllBytes(cardUUID, { "00-00-00-00", "aZ-09-zA-9z", "00-00-00-000", "00-00-00-0" });
+
+	compareAllStrings(keypadPassword, alphabet, 5);
+	compareAllStrings(keypadPassword, "09a", 12);
+	compareAllBytes(keypadPassword, { "0000", "0123456789", "012", "01234567890" });
+
+	compareAllStrings(plainData, alphabet, 5);
+	compareAllBytes(plainData, { "", "Some Name 1.2-3+4", std::string(64, 'a'), std::string(65, 'a') });
+
+	compareAllStrings(signedNumber, alphabet, 5);
+	compareAllStrings(signedNumber, "09+-", 12);
+	compareAllBytes(signedNumber, { "0", "-1", "+1234567890", "1234567890", "12345678901", "-12345678901" });
+
+	if (failures != 0)
+	{
+		std::cout << "FAILED: " << failures << " mismatches." << std::endl;
+		return -1;
+	}
+
+	std::cout << "PASSED: all validators match their regular expressions." << std::endl;
+
+	benchmark(cardUUID, { "0A-1B-2C-3D", "0A-1B-2C-3", "invalid" }, ITERATIONS);
+	benchmark(keypadPassword, { "2204", "0123456789", "12a4" }, ITERATIONS);
+	benchmark(plainData, { "John Doe", "1.2-3+4", "bad_char" }, ITERATIONS);
+	benchmark(signedNumber, { "-1", "+127", "12345678901" }, ITERATIONS);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "propertiesclass.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Compares cached GlobalProperties::Get() against walking the XML document on every call (old Get()).
+// Must be run from the directory containing config.xml. Usage: GlobalPropertiesBenchmark [ITERATIONS]
+
+using Clock = std::chrono::steady_clock;
+
+static double toMicroseconds(Clock::duration d)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / 1000.0;
+}
+
+int main(int argc, char** argv)
+{
+	int ITERATIONS = 10000;
+	if (argc >= 2)
+	{
+		ITERATIONS = std::stoi(argv[1]);
+		if (ITERATIONS < 1)
+		{
+			std::cout << "Input argument ITERATIONS cannot be negative or zero!" << std::endl;
+			return -1;
+		}
+	}
+
+	// Startup: read config.xml, parse it and build the snapshot
+	auto start = Clock::now();
+	const Properties& snapshot = GlobalProperties::Get();
+	auto startup = Clock::now() - start;
+
+	std::cout << "Startup (first Get()): " << toMicroseconds(startup) << " us" << std::endl;
+
+	size_t checksum = 0;
+
+	start = Clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		checksum += GlobalProperties::Parse().KEYPAD_BUFFER_SIZE;
+	}
+	auto parsed = Clock::now() - start;
+
+	start = Clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		checksum += GlobalProperties::Get().KEYPAD_BUFFER_SIZE;
+	}
+	auto cached = Clock::now() - start;
+
+	std::cout << "Per call, XML walk (old Get()): " << toMicroseconds(parsed) / ITERATIONS << " us" << std::endl;
+	std::cout << "Per call, cached snapshot: " << toMicroseconds(cached) / ITERATIONS << " us" << std::endl;
+
+	if (&GlobalProperties::Get() != &snapshot)
+	{
+		std::cout << "FAILED: Get() returned a different snapshot." << std::endl;
+		return -1;
+	}
+
+	Properties reparsed = GlobalProperties::Parse();
+	if (reparsed.KEYPAD_PIPE_NAME != snapshot.KEYPAD_PIPE_NAME || reparsed.DOOR_OPEN_TIME_MS != snapshot.DOOR_OPEN_TIME_MS)
+	{
+		std::cout << "FAILED: snapshot differs from the XML document." << std::endl;
+		return -1;
+	}
+
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "propertiesclass.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// Rewrites config.xml in the current directory (original is restored at the end) and checks that
+// a running process picks up the change. Must be run from the directory containing config.xml.
+
+class ReloadSubscriber : public IPropertiesSubscriber
+{
+public:
+	std::atomic<unsigned int> m_version{ 0 };
+	std::vector<std::string> m_restartRequired;
+
+	virtual void PropertiesChanged(const Properties& properties, unsigned int version, const std::vector<std::string>& restartRequired) override
+	{
+		std::cout << "Reloaded, version " << version << ", RFID_SAME_CARD_TIMEOUT_MS = " << properties.RFID_SAME_CARD_TIMEOUT_MS << std::endl;
+		m_restartRequired = restartRequired;
+		m_version = version;
+	}
+};
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream file(path);
+	std::stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+/// Write to a temporary file and rename it over `path`, the way deployment scripts replace config files
+static void replaceFile(const std::string& path, const std::string& content)
+{
+	const std::string tmpPath = path + ".tmp";
+	std::ofstream(tmpPath) << content;
+	std::rename(tmpPath.c_str(), path.c_str());
+}
+
+static std::string replaceTag(const std::string& xml, const std::string& tag, const std::string& value)
+{
+	const std::string open = "<" + tag + ">";
+	const std::string close = "</" + tag + ">";
+	size_t begin = xml.find(open) + open.size();
+	size_t end = xml.find(close, begin);
+	return xml.substr(0, begin) + value + xml.substr(end);
+}
+
+static std::string removeTag(const std::string& xml, const std::string& tag)
+{
+	const std::string close = "</" + tag + ">";
+	size_t begin = xml.find("<" + tag + ">");
+	size_t end = xml.find(close, begin) + close.size();
+	return xml.substr(0, begin) + xml.substr(end);
+}
+
+static bool waitForVersion(ReloadSubscriber& subscriber, unsigned int version)
+{
+	for (int i = 0; i < 200 && subscriber.m_version < version; ++i)
+	{
+		usleep(10 * 1000);
+	}
+
+	return subscriber.m_version >= version;
+}
+
+int main()
+{
+	const std::string CONFIG_PATH = "config.xml";
+	const std::string original = readFile(CONFIG_PATH);
+
+	const Properties& initial = GlobalProperties::Get();
+	const unsigned int initialTimeout_ms = initial.RFID_SAME_CARD_TIMEOUT_MS;
+	const std::string initialLogThreadMailbox = initial.DATABASE_LOG_THREAD_MAILBOX_NAME;
+	const unsigned int initialDoorOpen_ms = initial.DOOR_OPEN_TIME_MS;
+
+	// Subscribers are notified in order, so the flag is raised by the time `subscriber` sees a version
+	PropertiesChangeFlag changeFlag;
+	GlobalProperties::Subscribe(&changeFlag);
+	ReloadSubscriber subscriber;
+	GlobalProperties::Subscribe(&subscriber);
+
+	if (!GlobalProperties::StartWatching())
+	{
+		std::cout << "FAILED: cannot watch " << CONFIG_PATH << std::endl;
+		return -1;
+	}
+
+	// Readers must never observe a half-published snapshot and never block
+	std::atomic<bool> stopReaders{ false };
+	std::atomic<unsigned long> reads{ 0 };
+	std::thread reader([&]()
+	{
+		while (!stopReaders)
+		{
+			if (GlobalProperties::Get().KEYPAD_PIPE_NAME.empty()) std::cout << "FAILED: empty snapshot read" << std::endl;
+			++reads;
+		}
+	});
+
+	int result = 0;
+
+	std::string changed = replaceTag(original, "SameCardTimeout_ms", std::to_string(initialTimeout_ms + 5));
+	changed = replaceTag(changed, "MailboxName", "other.mailbox");
+	replaceFile(CONFIG_PATH, changed);
+
+	if (!waitForVersion(subscriber, 2))
+	{
+		std::cout << "FAILED: no reload after config.xml was replaced" << std::endl;
+		result = -1;
+	}
+	else if (GlobalProperties::Get().RFID_SAME_CARD_TIMEOUT_MS != initialTimeout_ms + 5 || GlobalProperties::Version() != 2)
+	{
+		std::cout << "FAILED: live setting was not applied" << std::endl;
+		result = -1;
+	}
+	else if (GlobalProperties::Get().DATABASE_LOG_THREAD_MAILBOX_NAME != initialLogThreadMailbox || subscriber.m_restartRequired.empty())
+	{
+		std::cout << "FAILED: restart-required setting was applied live" << std::endl;
+		result = -1;
+	}
+
+	// Loops polling the flag see the reload once, with the same restart-required settings
+	std::vector<std::string> restartRequired;
+	if (!changeFlag.TakeChange(restartRequired) || restartRequired != subscriber.m_restartRequired)
+	{
+		std::cout << "FAILED: change flag was not raised with the restart-required settings" << std::endl;
+		result = -1;
+	}
+	else if (changeFlag.TakeChange(restartRequired))
+	{
+		std::cout << "FAILED: change flag was raised twice for one reload" << std::endl;
+		result = -1;
+	}
+
+	// Invalid file must be rejected and the current snapshot kept
+	replaceFile(CONFIG_PATH, replaceTag(changed, "BufferSize", "0"));
+	usleep(500 * 1000);
+	if (GlobalProperties::Version() != 2)
+	{
+		std::cout << "FAILED: invalid config was published" << std::endl;
+		result = -1;
+	}
+
+	// Without a Patterns section the door pattern is derived from the restart-required door open time,
+	// so it must keep the time the running process uses
+	replaceFile(CONFIG_PATH, replaceTag(removeTag(changed, "Patterns"), "OpenTime_ms", std::to_string(initialDoorOpen_ms + 1000)));
+	if (!waitForVersion(subscriber, 3))
+	{
+		std::cout << "FAILED: no reload after the Patterns section was removed" << std::endl;
+		result = -1;
+	}
+	else if (GlobalProperties::Get().SIGNAL_PATTERN_DOOR_OPEN != "door:" + std::to_string(initialDoorOpen_ms))
+	{
+		std::cout << "FAILED: default door pattern was derived from a restart-required setting" << std::endl;
+		result = -1;
+	}
+
+	stopReaders = true;
+	reader.join();
+
+	GlobalProperties::StopWatching();
+	GlobalProperties::Unsubscribe(&subscriber);
+	GlobalProperties::Unsubscribe(&changeFlag);
+
+	replaceFile(CONFIG_PATH, original);
+
+	std::cout << "Reads during test: " << reads << std::endl;
+	if (result == 0) std::cout << "PASSED" << std::endl;
+
+	return result;
+}
@@ -48,7 +48,7 @@ int main()
 
 void Server()
 {
-	Pinout pins(20, 21, 1500, 1);
+	Pinout pins(20, 21, 1);
 	IndicatorController_Server indicators(IDENTIFIER, pins);
 	
 	while (true)
@@ -0,0 +1,345 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include"keypad.hpp"
+#include"KeypadEvent.hpp"
+#include"pipe.hpp"
+#include"TestCheck.hpp"
+
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<dirent.h>
+#include<iostream>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include<fcntl.h>
+#include<poll.h>
+#include<sys/ioctl.h>
+#include<unistd.h>
+#include<linux/uinput.h>
+
+// Injects key presses into a Keypad and checks the KeypadEvents it sends, then measures
+// keypress-to-event latency. Uses a uinput virtual keypad when /dev/uinput is writable
+// (real evdev path), otherwise writes input_events into a pipe passed to Keypad(int fd, ...).
+// Must be run from the directory containing config.xml.
+// Usage: KeypadLatencyTest [ITERATIONS] [--pipe]
+
+using Clock = std::chrono::steady_clock;
+
+static const unsigned short KEYS[] = {
+	KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9,
+	KEY_KPASTERISK, KEY_KPSLASH, KEY_KPENTER, KEY_BACKSPACE
+};
+
+/// Source of input_events for the Keypad under test
+class KeyInjector
+{
+public:
+	virtual ~KeyInjector() = default;
+
+	void press(unsigned short code) { emit(EV_KEY, code, 1); sync(); }
+	void repeat(unsigned short code) { emit(EV_KEY, code, 2); sync(); }
+	void release(unsigned short code) { emit(EV_KEY, code, 0); sync(); }
+	void tap(unsigned short code) { press(code); release(code); }
+
+protected:
+	virtual void emit(unsigned short type, unsigned short code, int value) = 0;
+	void sync() { emit(EV_SYN, SYN_REPORT, 0); }
+};
+
+class UinputInjector : public KeyInjector
+{
+public:
+	int m_fd = -1;
+	std::string m_devicePath;
+
+	bool open()
+	{
+		m_fd = ::open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+		if (m_fd < 0) return false;
+
+		ioctl(m_fd, UI_SET_EVBIT, EV_KEY);
+		for (unsigned short key : KEYS) ioctl(m_fd, UI_SET_KEYBIT, key);
+
+		uinput_setup setup = {};
+		setup.id.bustype = BUS_VIRTUAL;
+		setup.id.vendor = 0x1209;
+		setup.id.product = 0x0001;
+		std::strncpy(setup.name, "KeypadLatencyTest", UINPUT_MAX_NAME_SIZE - 1);
+
+		char sysName[64] = { 0 };
+		if (ioctl(m_fd, UI_DEV_SETUP, &setup) < 0 || ioctl(m_fd, UI_DEV_CREATE) < 0
+			|| ioctl(m_fd, UI_GET_SYSNAME(sizeof(sysName)), sysName) < 0)
+		{
+			return false;
+		}
+
+		// The event node appears asynchronously (udev)
+		const std::string sysPath = std::string("/sys/devices/virtual/input/") + sysName;
+		for (int attempt = 0; attempt < 100 && m_devicePath.empty(); ++attempt)
+		{
+			DIR* pDir = opendir(sysPath.c_str());
+			for (dirent* pEntry = pDir ? readdir(pDir) : nullptr; pEntry != nullptr; pEntry = readdir(pDir))
+			{
+				if (std::strncmp(pEntry->d_name, "event", 5) == 0 && access(("/dev/input/" + std::string(pEntry->d_name)).c_str(), R_OK) == 0)
+				{
+					m_devicePath = "/dev/input/" + std::string(pEntry->d_name);
+				}
+			}
+			if (pDir) closedir(pDir);
+			usleep(10 * 1000);
+		}
+
+		return !m_devicePath.empty();
+	}
+
+	~UinputInjector()
+	{
+		if (m_fd >= 0)
+		{
+			ioctl(m_fd, UI_DEV_DESTROY);
+			close(m_fd);
+		}
+	}
+
+protected:
+	virtual void emit(unsigned short type, unsigned short code, int value) override
+	{
+		input_event event = {};
+		event.type = type;
+		event.code = code;
+		event.value = value;
+		if (write(m_fd, &event, sizeof(event)) != sizeof(event)) std::cout << "uinput write failed" << std::endl;
+	}
+};
+
+class PipeInjector : public KeyInjector
+{
+public:
+	int m_readFd = -1;
+	int m_writeFd = -1;
+
+	bool open()
+	{
+		int fds[2];
+		if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) return false;
+
+		m_readFd = fds[0];
+		m_writeFd = fds[1];
+		return true;
+	}
+
+	~PipeInjector()
+	{
+		if (m_writeFd >= 0) close(m_writeFd);
+	}
+
+protected:
+	virtual void emit(unsigned short type, unsigned short code, int value) override
+	{
+		input_event event = {};
+		gettimeofday(&event.time, nullptr);
+		event.type = type;
+		event.code = code;
+		event.value = value;
+		if (write(m_writeFd, &event, sizeof(event)) != sizeof(event)) std::cout << "pipe write failed" << std::endl;
+	}
+};
+
+/// Waits for the next KeypadEvent on `output`
+static KeypadEvent receiveEvent(Pipe& output, int timeout_ms = 1000)
+{
+	PipeMessage message;
+	auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!output.receiveMessage(message))
+	{
+		int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		pollfd pollStruct = { output.getFd(), POLLIN, 0 };
+		if (remaining_ms < 0 || poll(&pollStruct, 1, remaining_ms) <= 0) return KeypadEvent();
+	}
+
+	return KeypadEvent::fromPipeMessage(message);
+}
+
+static void expect(Pipe& output, KeypadEvent::enuType type, const std::string& data, const std::string& description)
+{
+	KeypadEvent event = receiveEvent(output);
+	if (event.getType() != type || event.getData() != data)
+	{
+		++failures;
+		std::cout << "FAILED: " << description << " (got '" << (event.getType() ? (char)event.getType() : '-') << "' \"" << event.getData() << "\")" << std::endl;
+	}
+}
+
+static void expectNothing(Pipe& output, const std::string& description)
+{
+	KeypadEvent event = receiveEvent(output, 50);
+	if (event.getType() != KeypadEvent::Invalid)
+	{
+		++failures;
+		std::cout << "FAILED: " << description << " (got '" << (char)event.getType() << "' \"" << event.getData() << "\")" << std::endl;
+	}
+}
+
+static void checkBehaviour(KeyInjector& keys, Pipe& output)
+{
+	keys.tap(KEY_KPASTERISK); keys.tap(KEY_KP1); keys.tap(KEY_KP2); keys.tap(KEY_KP3); keys.tap(KEY_KP4); keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Data, "*1234", "PIN entry");
+
+	keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Enter, "", "Enter with empty buffer");
+
+	keys.tap(KEY_BACKSPACE);
+	expect(output, KeypadEvent::Backspace, "", "Backspace with empty buffer");
+
+	keys.tap(KEY_KP1); keys.tap(KEY_KP2); keys.tap(KEY_BACKSPACE);
+	expectNothing(output, "Backspace clears buffer silently");
+	keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Enter, "", "Buffer empty after Backspace");
+
+	keys.press(KEY_KP5); keys.repeat(KEY_KP5); keys.repeat(KEY_KP5); keys.release(KEY_KP5); keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Data, "5", "Autorepeat ignored");
+
+	keys.press(KEY_KP1); keys.press(KEY_KP2); keys.release(KEY_KP1); keys.release(KEY_KP2); keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Data, "12", "Overlapping key presses (rollover)");
+
+	keys.tap(KEY_KP7); keys.tap(KEY_KP8);
+	keys.press(KEY_BACKSPACE); keys.press(KEY_KPENTER); keys.press(KEY_KP9);
+	expect(output, KeypadEvent::Reset, "", "Backspace + Enter chord");
+	keys.release(KEY_KP9); keys.release(KEY_KPENTER); keys.release(KEY_BACKSPACE);
+	expectNothing(output, "Keys pressed during chord ignored");
+
+	keys.tap(KEY_KP3); keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Data, "3", "Input accepted after chord released");
+
+	keys.tap(KEY_KP7); keys.tap(KEY_KP8);
+	keys.press(KEY_KPENTER); keys.press(KEY_BACKSPACE);
+	expect(output, KeypadEvent::Reset, "", "Enter + Backspace chord");
+	keys.release(KEY_BACKSPACE); keys.release(KEY_KPENTER);
+	expectNothing(output, "Buffer discarded by Enter + Backspace chord");
+
+	keys.tap(KEY_KP4); keys.press(KEY_KPENTER); keys.press(KEY_KP6);
+	expect(output, KeypadEvent::Data, "4", "Enter takes effect when the next key is pressed");
+	keys.release(KEY_KPENTER); keys.release(KEY_KP6);
+	expectNothing(output, "Enter not submitted twice");
+	keys.tap(KEY_KPENTER);
+	expect(output, KeypadEvent::Data, "6", "Key pressed while Enter held starts the next entry");
+}
+
+static void measureLatency(KeyInjector& keys, Pipe& output, int iterations)
+{
+	std::vector<double> latencies_us;
+	latencies_us.reserve(iterations);
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		// Enter takes effect on release (it may still become a Backspace + Enter chord while held)
+		keys.press(KEY_KPENTER);
+		auto start = Clock::now();
+		keys.release(KEY_KPENTER);
+		KeypadEvent event = receiveEvent(output);
+		auto end = Clock::now();
+
+		if (event.getType() != KeypadEvent::Enter)
+		{
+			++failures;
+			std::cout << "FAILED: no event for key press " << i << std::endl;
+			return;
+		}
+
+		latencies_us.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0);
+	}
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	auto percentile = [&latencies_us](double p) { return latencies_us[(size_t)(p * (latencies_us.size() - 1))]; };
+
+	std::cout << "Keypress-to-event latency over " << iterations << " presses: "
+		<< "min " << latencies_us.front() << " us, "
+		<< "median " << percentile(0.5) << " us, "
+		<< "p99 " << percentile(0.99) << " us, "
+		<< "max " << latencies_us.back() << " us" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int ITERATIONS = 1000;
+	bool forcePipe = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--pipe") forcePipe = true;
+		else ITERATIONS = std::stoi(argv[i]);
+	}
+
+	if (ITERATIONS < 1)
+	{
+		std::cout << "Input argument ITERATIONS cannot be negative or zero!" << std::endl;
+		return -1;
+	}
+
+	const std::string OUTPUT_FIFO = "keypad_latency_test.fifo";
+	Pipe output(OUTPUT_FIFO, Kernel::IOMode::READ_NONBLOCKING, 64);
+	Pipe keypadOutput(OUTPUT_FIFO, Kernel::IOMode::WRITE, 64);
+
+	UinputInjector uinput;
+	PipeInjector pipeInjector;
+	KeyInjector* pKeys = nullptr;
+	Keypad* pKeypad = nullptr;
+
+	if (!forcePipe && uinput.open())
+	{
+		std::cout << "Injecting through uinput device " << uinput.m_devicePath << std::endl;
+		pKeys = &uinput;
+		pKeypad = new Keypad(uinput.m_devicePath, &keypadOutput);
+	}
+	else if (pipeInjector.open())
+	{
+		std::cout << "Injecting through a pipe" << (forcePipe ? "" : " (/dev/uinput not available)") << std::endl;
+		pKeys = &pipeInjector;
+		pKeypad = new Keypad(pipeInjector.m_readFd, &keypadOutput);
+	}
+	else
+	{
+		std::cout << "FAILED: cannot create an input source" << std::endl;
+		return -1;
+	}
+
+	std::thread keypadThread([pKeypad]()
+	{
+		while (pKeypad->WaitForInput(-1));
+	});
+
+	checkBehaviour(*pKeys, output);
+	measureLatency(*pKeys, output, ITERATIONS);
+
+	pKeypad->Interrupt();
+	keypadThread.join();
+	delete pKeypad;
+
+	unlink(OUTPUT_FIFO.c_str());
+
+	return testResult();
+}
@@ -0,0 +1,191 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "HD44780_Display.hpp"
+#include "MockI2C_Device.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Bytes and bus time per LCD update for a typical keypad session, on a simulated 100 kHz I2C bus.
+// "per byte" repeats what I2C_LCD did before the shadow framebuffer: clear, rewrite everything, reach
+// the second line with 40 cursor shifts, one transaction and one wait per expander byte.
+// Usage: LCD_RenderBenchmark [INTER_COMMAND_WAIT_US]
+
+static void legacyNibble(MockI2C_Device& device, uint8_t nibble, uint8_t flags, unsigned int wait_us)
+{
+	const uint8_t outputs[3] = { uint8_t((nibble & 0xF0) | 0x08 | flags), uint8_t((nibble & 0xF0) | 0x08 | flags | 0x04), uint8_t((nibble & 0xF0) | 0x08 | flags) };
+	for (uint8_t output : outputs)
+	{
+		device.Write(&output, 1);
+		device.Delay_us(wait_us);
+	}
+}
+
+static void legacyByte(MockI2C_Device& device, uint8_t value, uint8_t flags, unsigned int wait_us)
+{
+	legacyNibble(device, value, flags, wait_us);
+	legacyNibble(device, value << 4, flags, wait_us);
+}
+
+static void legacyInit(MockI2C_Device& device, unsigned int wait_us)
+{
+	const uint8_t initSequence[14] = { 0x30, 0x30, 0x30, 0x20, 0x20, 0x80, 0x00, 0xC0, 0x00, 0x10, 0x00, 0x60, 0x00, 0x20 };
+	for (uint8_t nibble : initSequence)
+	{
+		legacyNibble(device, nibble, 0, wait_us);
+	}
+}
+
+static void legacyPut(MockI2C_Device& device, const std::string& message, unsigned int wait_us)
+{
+	const std::string firstLine = message.substr(0, 16);
+	const std::string secondLine = message.length() > 16 ? message.substr(16, 16) : "";
+
+	legacyByte(device, 0x01, 0, wait_us);
+	for (char character : firstLine)
+	{
+		legacyByte(device, character, 0x01, wait_us);
+	}
+
+	if (!secondLine.empty())
+	{
+		legacyByte(device, 0x02, 0, wait_us);
+		for (int i = 0; i < 40; i++)
+		{
+			legacyByte(device, 0x14, 0, wait_us);
+		}
+		for (char character : secondLine)
+		{
+			legacyByte(device, character, 0x01, wait_us);
+		}
+	}
+}
+
+static bool shows(const MockI2C_Device& device, const std::string& message)
+{
+	const HD44780_Display::Lines lines = HD44780_Display::Layout(message);
+	return device.getLine(0) == lines[0] && device.getLine(1) == lines[1];
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int WAIT_US = 500;
+	if (argc >= 2)
+	{
+		WAIT_US = std::stoul(argv[1]);
+	}
+
+	const std::vector<std::string> SESSION = {
+		"EMOVIS",
+		"Enter PIN:",
+		"Enter PIN: *",
+		"Enter PIN: **",
+		"Enter PIN: ***",
+		"Enter PIN: ****",
+		"Access granted  Ivan Horvat",
+		"EMOVIS"
+	};
+
+	MockI2C_Device legacyDevice;
+	legacyInit(legacyDevice, WAIT_US);
+
+	MockI2C_Device device;
+	HD44780_Display display(&device, WAIT_US);
+	display.Show("");
+	display.WaitUntilRendered(1000);
+
+	std::cout << "Per update, 100 kHz I2C, " << WAIT_US << " us inter-command wait" << std::endl;
+	std::cout << std::left << std::setw(30) << "message"
+		<< std::right << std::setw(14) << "per byte B" << std::setw(12) << "ms"
+		<< std::setw(14) << "diffed B" << std::setw(12) << "ms" << std::setw(14) << "caller us" << std::endl;
+
+	double legacyTotal_ms = 0;
+	double total_ms = 0;
+
+	for (const std::string& message : SESSION)
+	{
+		legacyDevice.resetStats();
+		legacyPut(legacyDevice, message, WAIT_US);
+		const MockI2C_Device::Stats legacy = legacyDevice.getStats();
+
+		device.resetStats();
+		const auto start = std::chrono::steady_clock::now();
+		display.Show(message);
+		const auto callerBlocked = std::chrono::steady_clock::now() - start;
+		if (!display.WaitUntilRendered(1000))
+		{
+			std::cout << "FAILED: \"" << message << "\" not rendered" << std::endl;
+			++failures;
+		}
+		const MockI2C_Device::Stats diffed = device.getStats();
+
+		std::cout << std::left << std::setw(30) << ("\"" + message + "\"") << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(14) << legacy.bytes << std::setw(12) << legacy.time_us / 1000
+			<< std::setw(14) << diffed.bytes << std::setw(12) << diffed.time_us / 1000
+			<< std::setw(14) << std::chrono::duration_cast<std::chrono::microseconds>(callerBlocked).count() << std::endl;
+
+		legacyTotal_ms += legacy.time_us / 1000;
+		total_ms += diffed.time_us / 1000;
+
+		if (!shows(legacyDevice, message) || !shows(device, message))
+		{
+			std::cout << "FAILED: display content differs for \"" << message << "\": \""
+				<< device.getLine(0) << "\" / \"" << device.getLine(1) << "\"" << std::endl;
+			++failures;
+		}
+		if (diffed.timingViolations != 0)
+		{
+			std::cout << "FAILED: " << diffed.timingViolations << " instructions sent while the controller was busy" << std::endl;
+			++failures;
+		}
+	}
+
+	std::cout << "Session: " << legacyTotal_ms << " ms per byte, " << total_ms << " ms diffed" << std::endl;
+	if (total_ms >= legacyTotal_ms)
+	{
+		std::cout << "FAILED: diffed rendering is not faster" << std::endl;
+		++failures;
+	}
+
+	// Content requested faster than it renders: only the newest must reach the display
+	device.resetStats();
+	for (int i = 0; i < 100; ++i)
+	{
+		display.Show("Burst " + std::to_string(i));
+	}
+	display.WaitUntilRendered(1000);
+	std::cout << "100 queued updates: " << device.getStats().transactions << " transactions" << std::endl;
+	if (!shows(device, "Burst 99"))
+	{
+		std::cout << "FAILED: last queued update not shown" << std::endl;
+		++failures;
+	}
+
+	return testResult();
+}
@@ -0,0 +1,435 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "LogJournal.hpp"
+#include "TestCheck.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Access log journal: recovery after reopening and after the writer is killed mid-append, corrupted records,
+// wrapping around the ring, backpressure on a full journal, and batched replay into LogTable exactly once,
+// also when the journal is found again after its logs were committed to the database, and a log the log table
+// rejects skipped without holding back the others.
+// Writes LogJournalTest.journal and LogJournalTest.db (+ -wal, -shm) in the current directory.
+
+static const std::string JOURNAL_PATH = "LogJournalTest.journal";
+static const std::string DATABASE_PATH = "LogJournalTest.db";
+static const std::string TIMESTAMP = "2021-03-11T08:00:00.000";
+static const std::string METHOD = "RFID";
+/// Header and record sizes of the current format, records with the strings above are all the same size
+static const size_t HEADER_SIZE = 80;
+static const size_t RECORD_SIZE = 64;
+static const size_t SMALL_CAPACITY = 4096;
+
+static void removeFiles()
+{
+	unlink(JOURNAL_PATH.c_str());
+	for (const char* suffix : { "", "-wal", "-shm" })
+	{
+		unlink((DATABASE_PATH + suffix).c_str());
+	}
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+/// Log number `i`, recognizable after recovery
+static LogJournal::enuAppendResult append(LogJournal& journal, unsigned int i, std::chrono::milliseconds wait = std::chrono::milliseconds(0))
+{
+	return journal.Append(TIMESTAMP, i, METHOD, i % 7, wait);
+}
+
+/// All records are read back in order, numbered from `firstSequence`, with the user ID they were appended with
+static bool isIntact(LogJournal& journal, uint64_t firstSequence, size_t count, unsigned int firstUser)
+{
+	std::vector<JournaledLog> logs;
+	if (journal.Read(logs, count + 1, std::chrono::milliseconds(0)) != count)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < logs.size(); ++i)
+	{
+		if (logs[i].m_sequence != firstSequence + i || logs[i].m_userId != firstUser + i
+			|| logs[i].m_commandId != (firstUser + i) % 7 || logs[i].m_timestamp != TIMESTAMP || logs[i].m_authMethod != METHOD)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool execute(sqlite3* pDatabase, const std::string& query)
+{
+	return sqlite3_exec(pDatabase, query.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+static int64_t count(sqlite3* pDatabase, const std::string& query)
+{
+	sqlite3_stmt* pStatement = nullptr;
+	int64_t value = -1;
+	if (sqlite3_prepare_v2(pDatabase, query.c_str(), -1, &pStatement, nullptr) == SQLITE_OK && sqlite3_step(pStatement) == SQLITE_ROW)
+	{
+		value = sqlite3_column_int64(pStatement, 0);
+	}
+	sqlite3_finalize(pStatement);
+	return value;
+}
+
+static void testRecovery()
+{
+	removeFiles();
+
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		for (unsigned int i = 0; i < 100; ++i)
+		{
+			check(append(journal, 1000 + i) == LogJournal::APPENDED, "append to an empty journal failed");
+		}
+		check(journal.getCount() == 100, "appended logs not counted");
+		check(isIntact(journal, 1, 100, 1000), "appended logs not read back");
+	}
+
+	LogJournal journal(JOURNAL_PATH, 64 * 1024);
+	check(journal.getCount() == 100, "logs lost by reopening the journal");
+	check(isIntact(journal, 1, 100, 1000), "logs changed by reopening the journal");
+
+	journal.Commit(40);
+	check(journal.getCount() == 60 && journal.getHeadSequence() == 41, "commit did not drop the committed logs");
+	check(isIntact(journal, 41, 60, 1040), "commit changed the remaining logs");
+
+	journal.Commit(100);
+	check(journal.getCount() == 0 && journal.getHeadSequence() == 101, "commit of every log did not empty the journal");
+	check(append(journal, 2000) == LogJournal::APPENDED, "append after truncation failed");
+	check(isIntact(journal, 101, 1, 2000), "sequence numbers restarted after truncation");
+}
+
+static void testCorruption()
+{
+	removeFiles();
+
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		for (unsigned int i = 0; i < 20; ++i)
+		{
+			append(journal, i);
+		}
+	}
+
+	// A torn or corrupted record ends the journal, the records before it survive
+	std::string content = readFile(JOURNAL_PATH);
+	content[HEADER_SIZE + 12 * RECORD_SIZE + 20] ^= 0x01;
+	writeFile(JOURNAL_PATH, content);
+
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		check(journal.getCount() == 12, "recovery did not stop at the corrupted record");
+		check(isIntact(journal, 1, 12, 0), "records before the corrupted one changed");
+
+		check(append(journal, 500) == LogJournal::APPENDED, "append after a corrupted record failed");
+	}
+
+	LogJournal journal(JOURNAL_PATH, 64 * 1024);
+	check(journal.getCount() == 13, "record appended over the corrupted one lost");
+
+	// A garbage file is replaced by an empty journal
+	writeFile(JOURNAL_PATH, std::string(1000, 'x'));
+	LogJournal recreated(JOURNAL_PATH, 64 * 1024);
+	check(recreated.getCount() == 0 && recreated.getHeadSequence() == 1, "garbage file not replaced by an empty journal");
+}
+
+static void testKilledWriter()
+{
+	removeFiles();
+	{
+		LogJournal journal(JOURNAL_PATH, 1024 * 1024);
+	}
+
+	pid_t child = fork();
+	if (child == 0)
+	{
+		LogJournal journal(JOURNAL_PATH, 1024 * 1024);
+		for (unsigned int i = 0; ; ++i)
+		{
+			if (append(journal, i) != LogJournal::APPENDED)
+			{
+				journal.Commit(journal.getHeadSequence() + journal.getCount());
+				--i;
+			}
+		}
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	kill(child, SIGKILL);
+	waitpid(child, nullptr, 0);
+
+	LogJournal journal(JOURNAL_PATH, 1024 * 1024);
+	const size_t recovered = journal.getCount();
+	const uint64_t head = journal.getHeadSequence();
+	check(recovered > 0, "nothing recovered from the killed writer");
+	check(isIntact(journal, head, recovered, static_cast<unsigned int>(head - 1)), "logs of the killed writer recovered out of order or changed");
+	std::cout << "Recovered " << recovered << " logs from sequence " << head << " after SIGKILL" << std::endl;
+}
+
+static void testWrapAndBackpressure()
+{
+	removeFiles();
+
+	const size_t fitting = SMALL_CAPACITY / RECORD_SIZE;
+	{
+		LogJournal journal(JOURNAL_PATH, SMALL_CAPACITY);
+		for (unsigned int i = 0; i < fitting; ++i)
+		{
+			check(append(journal, i) == LogJournal::APPENDED, "append to a journal with space left failed");
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		check(append(journal, 9999, std::chrono::milliseconds(20)) == LogJournal::FULL, "append to a full journal succeeded");
+		check(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20), "append to a full journal did not wait");
+
+		// The next records continue at the beginning of the ring
+		journal.Commit(10);
+		for (unsigned int i = 0; i < 10; ++i)
+		{
+			check(append(journal, fitting + i) == LogJournal::APPENDED, "append after the ring wrapped failed");
+		}
+		check(append(journal, 9999) == LogJournal::FULL, "append over the oldest record succeeded");
+	}
+
+	{
+		LogJournal journal(JOURNAL_PATH, SMALL_CAPACITY);
+		check(journal.getCount() == fitting, "logs lost by reopening a wrapped journal");
+		check(isIntact(journal, 11, fitting, 10), "logs changed by reopening a wrapped journal");
+		journal.Commit(journal.getHeadSequence() + journal.getCount());
+	}
+
+	// A writer waiting for space is resumed by the replay thread, nothing is dropped
+	LogJournal journal(JOURNAL_PATH, SMALL_CAPACITY);
+	std::atomic<bool> done(false);
+	std::atomic<size_t> read(0);
+	std::thread reader([&]()
+	{
+		std::vector<JournaledLog> logs;
+		uint64_t expected = journal.getHeadSequence();
+		while (!done || journal.getCount() != 0)
+		{
+			if (journal.Read(logs, 16, std::chrono::milliseconds(10)) == 0)
+			{
+				continue;
+			}
+			for (const JournaledLog& log : logs)
+			{
+				check(log.m_sequence == expected++, "replay thread skipped or repeated a log");
+			}
+			read += logs.size();
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			journal.Commit(logs.back().m_sequence);
+		}
+	});
+
+	const unsigned int APPENDS = 2000;
+	size_t full = 0;
+	for (unsigned int i = 0; i < APPENDS; ++i)
+	{
+		if (append(journal, i, std::chrono::milliseconds(1000)) != LogJournal::APPENDED)
+		{
+			++full;
+		}
+	}
+	done = true;
+	reader.join();
+
+	check(full == 0, "append gave up although the replay thread was freeing space");
+	check(read == APPENDS, "replay thread did not read every log");
+}
+
+static void testReplay()
+{
+	removeFiles();
+
+	sqlite3* pDatabase = nullptr;
+	sqlite3_open(DATABASE_PATH.c_str(), &pDatabase);
+	check(execute(pDatabase, "CREATE TABLE LogTable (Id INTEGER PRIMARY KEY, Timestamp TEXT, UserId INTEGER, AuthMethod TEXT, CommandId INTEGER);"), "cannot create LogTable");
+
+	std::mutex writeLock;
+	std::string journaled;
+
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		LogJournalReplay replay(journal, DATABASE_PATH, writeLock);
+
+		for (unsigned int i = 0; i < 100; ++i)
+		{
+			append(journal, i);
+		}
+
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 64, "first batch not limited to its size");
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 36, "second batch not the rest of the logs");
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(10)) == 0, "empty journal replayed");
+		check(journal.getCount() == 0, "replayed logs left in the journal");
+		check(count(pDatabase, "SELECT COUNT(*) FROM LogTable;") == 100, "replayed logs not in LogTable");
+		check(count(pDatabase, "SELECT SUM(UserId) FROM LogTable;") == 99 * 100 / 2, "replayed logs changed");
+
+		for (unsigned int i = 0; i < 10; ++i)
+		{
+			append(journal, 100 + i);
+		}
+		journaled = readFile(JOURNAL_PATH);
+
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 10, "journal not replayed");
+	}
+
+	// The process died after the database commit, before the journal commit: the logs are found again
+	writeFile(JOURNAL_PATH, journaled);
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		check(journal.getCount() == 10, "restored journal not recovered");
+
+		LogJournalReplay replay(journal, DATABASE_PATH, writeLock);
+		check(journal.getCount() == 0, "logs already in LogTable not skipped");
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 0, "logs already in LogTable replayed");
+		check(count(pDatabase, "SELECT COUNT(*) FROM LogTable;") == 110, "logs written to LogTable twice");
+	}
+
+	// A new journal numbers its logs from 1 again, the commit recorded for the old one does not apply
+	unlink(JOURNAL_PATH.c_str());
+	{
+		LogJournal journal(JOURNAL_PATH, 64 * 1024);
+		LogJournalReplay replay(journal, DATABASE_PATH, writeLock);
+		for (unsigned int i = 0; i < 5; ++i)
+		{
+			append(journal, 200 + i);
+		}
+		check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 5, "logs of a new journal skipped");
+		check(count(pDatabase, "SELECT COUNT(*) FROM LogTable;") == 115, "logs of a new journal not in LogTable");
+	}
+
+	// Throughput of batched replay, to compare with one insert per log
+	{
+		LogJournal journal(JOURNAL_PATH, 1024 * 1024);
+		LogJournalReplay replay(journal, DATABASE_PATH, writeLock);
+
+		const unsigned int LOGS = 5000;
+		const auto start = std::chrono::steady_clock::now();
+		size_t replayed = 0;
+		for (unsigned int i = 0; i < LOGS; ++i)
+		{
+			append(journal, i);
+			if (journal.getCount() == 64)
+			{
+				replayed += replay.ReplayBatch(64, std::chrono::milliseconds(0));
+			}
+		}
+		while (journal.getCount() != 0)
+		{
+			replayed += replay.ReplayBatch(64, std::chrono::milliseconds(0));
+		}
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+
+		check(replayed == LOGS, "not every log replayed");
+		std::cout << "Journaled and replayed " << LOGS << " logs in batches of 64: "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0 << " ms" << std::endl;
+	}
+
+	sqlite3_close(pDatabase);
+}
+
+static void testRejectedLog()
+{
+	removeFiles();
+
+	sqlite3* pDatabase = nullptr;
+	sqlite3_open(DATABASE_PATH.c_str(), &pDatabase);
+	check(execute(pDatabase, "CREATE TABLE LogTable (Id INTEGER PRIMARY KEY, Timestamp TEXT, UserId INTEGER, AuthMethod TEXT, CommandId INTEGER);"), "cannot create LogTable");
+	check(execute(pDatabase, "CREATE TRIGGER RejectUser13 BEFORE INSERT ON LogTable WHEN NEW.UserId = 13 BEGIN SELECT RAISE(ABORT, 'user 13 rejected'); END;"), "cannot create the trigger");
+
+	std::mutex writeLock;
+	LogJournal journal(JOURNAL_PATH, 64 * 1024);
+	LogJournalReplay replay(journal, DATABASE_PATH, writeLock);
+
+	// A missing table is the database's fault, not the logs': they stay journaled however often the write fails
+	check(execute(pDatabase, "ALTER TABLE LogTable RENAME TO LogTableAway;"), "cannot rename LogTable");
+	for (unsigned int i = 0; i < 30; ++i)
+	{
+		append(journal, i);
+	}
+	for (unsigned int i = 0; i < 2 * LogJournalReplay::MAX_BATCH_ATTEMPTS; ++i)
+	{
+		replay.ReplayBatch(64, std::chrono::milliseconds(0));
+	}
+	check(journal.getCount() == 30, "logs dropped while the log table was missing");
+	check(execute(pDatabase, "ALTER TABLE LogTableAway RENAME TO LogTable;"), "cannot restore LogTable");
+
+	// Log 13 is rejected every time: it is skipped after a few attempts and every other log is written
+	size_t written = 0;
+	for (unsigned int i = 0; i < 100 && journal.getCount() != 0; ++i)
+	{
+		written += replay.ReplayBatch(64, std::chrono::milliseconds(0));
+	}
+	check(journal.getCount() == 0, "rejected log holds back the journal");
+	check(written == 29 && count(pDatabase, "SELECT COUNT(*) FROM LogTable;") == 29, "logs behind the rejected one not written");
+	check(count(pDatabase, "SELECT SUM(UserId) FROM LogTable;") == 29 * 30 / 2 - 13, "wrong log skipped");
+
+	// Back to whole batches once the rejected log is gone
+	for (unsigned int i = 0; i < 10; ++i)
+	{
+		append(journal, 100 + i);
+	}
+	check(replay.ReplayBatch(64, std::chrono::milliseconds(0)) == 10, "batches not restored after the rejected log");
+
+	sqlite3_close(pDatabase);
+}
+
+int main()
+{
+	testRecovery();
+	testCorruption();
+	testKilledWriter();
+	testWrapAndBackpressure();
+	testReplay();
+	testRejectedLog();
+
+	removeFiles();
+
+	return testResult();
+}
@@ -0,0 +1,182 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MFRC522.h"
+#include "MFRC522_MockBus.h"
+#include "TestCheck.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// SPI traffic of one card read (PICC_IsNewCardPresent + PICC_ReadCardSerial) on a simulated MFRC522,
+// one register access per frame (original driver) against batched register I/O.
+// Usage: MFRC522BusBenchmark [ROUNDS]
+
+struct ReadCost
+{
+	double frames;
+	double bytes;
+	double busTime_us;
+	double readTime_us;
+	bool uidCorrect;
+};
+
+static ReadCost measure(const std::vector<uint8_t>& uid, bool batched, int rounds)
+{
+	MFRC522_MockBus bus;
+	MFRC522 reader(&bus);
+	reader.PCD_Init();
+	reader.PCD_SetBatchedIO(batched);
+
+	ReadCost cost = { 0, 0, 0, 0, true };
+	for (int round = 0; round < rounds; ++round)
+	{
+		bus.PresentCard(uid);
+		bus.resetStats();
+		const double start_us = bus.getTime_us();
+
+		bool read = reader.PICC_IsNewCardPresent() && reader.PICC_ReadCardSerial();
+
+		const MFRC522_BusStats stats = bus.getStats();
+		cost.frames += stats.frames;
+		cost.bytes += stats.bytes;
+		cost.busTime_us += stats.busTime_us;
+		cost.readTime_us += bus.getTime_us() - start_us;
+
+		read = read && reader.uid.size == uid.size();
+		for (size_t i = 0; read && i < uid.size(); ++i)
+		{
+			read = reader.uid.uidByte[i] == uid[i];
+		}
+		cost.uidCorrect = cost.uidCorrect && read;
+	}
+
+	cost.frames /= rounds;
+	cost.bytes /= rounds;
+	cost.busTime_us /= rounds;
+	cost.readTime_us /= rounds;
+	return cost;
+}
+
+/// Frames spent by PICC_IsNewCardPresent() when no card is in the field, it waits for the 25 ms timer
+static MFRC522_BusStats measureIdle(bool batched)
+{
+	MFRC522_MockBus bus;
+	MFRC522 reader(&bus);
+	reader.PCD_Init();
+	reader.PCD_SetBatchedIO(batched);
+
+	bus.resetStats();
+	reader.PICC_IsNewCardPresent();
+	return bus.getStats();
+}
+
+/// Records a batched read on the mock and plays it back to a fresh driver instance
+static bool replayMatches(const std::vector<uint8_t>& uid)
+{
+	MFRC522_MockBus mock;
+	mock.PresentCard(uid);
+	mock.setRecording(true);
+	{
+		MFRC522 reader(&mock);
+		reader.PCD_Init();
+		if (!reader.PICC_IsNewCardPresent() || !reader.PICC_ReadCardSerial())
+		{
+			return false;
+		}
+	}
+
+	MFRC522_ReplayBus replay(mock.getRecording());
+	MFRC522 reader(&replay);
+	reader.PCD_Init();
+	bool read = reader.PICC_IsNewCardPresent() && reader.PICC_ReadCardSerial();
+
+	return read && replay.isFinished() && replay.getMismatches() == 0 && reader.uid.size == uid.size();
+}
+
+int main(int argc, char** argv)
+{
+	int ROUNDS = 100;
+	if (argc >= 2)
+	{
+		ROUNDS = std::stoi(argv[1]);
+		if (ROUNDS < 1)
+		{
+			std::cout << "Input argument ROUNDS cannot be negative or zero!" << std::endl;
+			return -1;
+		}
+	}
+
+	const std::vector<std::vector<uint8_t>> UIDS = {
+		{ 0xDE, 0xAD, 0xBE, 0xEF },
+		{ 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 },
+		{ 0x08, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09 }
+	};
+
+	std::cout << "Per card read, SPI at 4 MHz, 2 byte register access 17.86 us" << std::endl;
+	std::cout << std::left << std::setw(10) << "UID" << std::setw(11) << "mode"
+		<< std::right << std::setw(8) << "frames" << std::setw(8) << "bytes"
+		<< std::setw(12) << "SPI us" << std::setw(12) << "total us" << std::endl;
+
+	for (const std::vector<uint8_t>& uid : UIDS)
+	{
+		const ReadCost before = measure(uid, false, ROUNDS);
+		const ReadCost after = measure(uid, true, ROUNDS);
+
+		for (const ReadCost* pCost : { &before, &after })
+		{
+			std::cout << std::left << std::setw(10) << (std::to_string(uid.size()) + " bytes")
+				<< std::setw(11) << (pCost == &before ? "unbatched" : "batched")
+				<< std::right << std::fixed << std::setprecision(1)
+				<< std::setw(8) << pCost->frames << std::setw(8) << pCost->bytes
+				<< std::setw(12) << pCost->busTime_us << std::setw(12) << pCost->readTime_us << std::endl;
+		}
+		std::cout << "  frames -" << std::setprecision(0) << 100.0 * (1.0 - after.frames / before.frames)
+			<< "%, SPI time -" << 100.0 * (1.0 - after.busTime_us / before.busTime_us) << "%" << std::endl;
+
+		if (!before.uidCorrect || !after.uidCorrect)
+		{
+			std::cout << "FAILED: wrong UID read for " << uid.size() << " byte card" << std::endl;
+			++failures;
+		}
+		if (after.frames >= before.frames || after.busTime_us >= before.busTime_us)
+		{
+			std::cout << "FAILED: batching did not reduce SPI traffic for " << uid.size() << " byte card" << std::endl;
+			++failures;
+		}
+		if (!replayMatches(uid))
+		{
+			std::cout << "FAILED: replay of a recorded " << uid.size() << " byte card read diverged" << std::endl;
+			++failures;
+		}
+	}
+
+	const MFRC522_BusStats idleBefore = measureIdle(false);
+	const MFRC522_BusStats idleAfter = measureIdle(true);
+	std::cout << "Poll without card: " << idleBefore.frames << " frames unbatched, " << idleAfter.frames << " frames batched" << std::endl;
+
+	return testResult();
+}
@@ -0,0 +1,292 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MailboxRpc.hpp"
+#include "Metrics.hpp"
+#include "Time.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Requests from several threads over one MailboxRpc to a stand-in server which answers out of order,
+// late or never, and stops receiving to fill its queue. Uses mailboxes rpctest.client and rpctest.server.
+
+static const std::string CLIENT_NAME = "rpctest.client";
+static const std::string SERVER_NAME = "rpctest.server";
+
+/// Requests to this door are never answered
+static const DoorId IGNORED_DOOR = 100;
+/// Requests to this door are answered after LATE_REPLY_MS
+static const DoorId LATE_DOOR = 101;
+static const int LATE_REPLY_MS = 150;
+
+/**
+ * Answers every request with its door ID as clearance. Holds requests until `m_batch` of them arrived
+ * and then answers them last first, so replies never arrive in the order the requests were made.
+*/
+class TestServer
+{
+public:
+	std::atomic<int> m_batch{ 1 };
+	std::atomic<bool> m_paused{ false };
+
+	TestServer() : m_thread(&TestServer::run, this) {}
+
+	~TestServer()
+	{
+		m_stop = true;
+		m_thread.join();
+	}
+
+private:
+	void run()
+	{
+		DataMailbox mailbox(SERVER_NAME);
+		mailbox.setRTO_ns(10 * Time::ms_to_ns);
+
+		std::vector<std::unique_ptr<CommandMessage>> held;
+		std::vector<std::pair<std::chrono::steady_clock::time_point, std::unique_ptr<CommandMessage>>> late;
+
+		while (!m_stop)
+		{
+			for (auto it = late.begin(); it != late.end();)
+			{
+				if (it->first <= std::chrono::steady_clock::now())
+				{
+					reply(mailbox, *it->second);
+					it = late.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			if (m_paused)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				continue;
+			}
+
+			std::unique_ptr<DataMailboxMessage> pMessage(mailbox.receive(enuReceiveOptions::TIMED));
+			CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage.get());
+			if (pCommand == nullptr)
+			{
+				continue;
+			}
+			pMessage.release();
+
+			if (pCommand->getDoorId() == IGNORED_DOOR)
+			{
+				delete pCommand;
+			}
+			else if (pCommand->getDoorId() == LATE_DOOR)
+			{
+				late.emplace_back(std::chrono::steady_clock::now() + std::chrono::milliseconds(LATE_REPLY_MS), std::unique_ptr<CommandMessage>(pCommand));
+			}
+			else
+			{
+				held.emplace_back(pCommand);
+				if (held.size() >= static_cast<size_t>(m_batch.load()))
+				{
+					for (auto it = held.rbegin(); it != held.rend(); ++it)
+					{
+						reply(mailbox, **it);
+					}
+					held.clear();
+				}
+			}
+		}
+	}
+
+	static void reply(DataMailbox& mailbox, CommandMessage& request)
+	{
+		DatabaseReply reply(static_cast<Clearance>(request.getDoorId()));
+		reply.setRequestId(request.getRequestId());
+		reply.setDoorId(request.getDoorId());
+		mailbox.send(request.getSource(), &reply);
+	}
+
+	std::atomic<bool> m_stop{ false };
+	std::thread m_thread;
+};
+
+static CommandMessage makeRequest(DoorId doorId)
+{
+	CommandMessage request(CommandMessage::enuCommand::AUTHENTICATE);
+	request.setDoorId(doorId);
+	return request;
+}
+
+/// True if `result` is the reply to a request made for `doorId`
+static bool repliedFor(const RpcResult& result, DoorId doorId)
+{
+	return result.m_outcome == RpcResult::REPLIED && result.m_pReply != nullptr
+		&& result.m_pReply->getClearance() == static_cast<Clearance>(doorId) && result.m_pReply->getDoorId() == doorId;
+}
+
+static void testOutOfOrder(MailboxRpc& rpc, TestServer& server)
+{
+	const int THREADS = 4, PER_THREAD = 2;
+	server.m_batch = THREADS * PER_THREAD;
+
+	std::atomic<int> matched(0);
+	std::vector<std::thread> callers;
+	for (int t = 0; t < THREADS; ++t)
+	{
+		callers.emplace_back([&rpc, &matched, t]()
+		{
+			std::vector<std::future<RpcResult>> futures;
+			for (int i = 0; i < PER_THREAD; ++i)
+			{
+				futures.push_back(rpc.Call(SERVER_NAME, makeRequest(1 + t * PER_THREAD + i), std::chrono::milliseconds(2000)));
+			}
+			for (int i = 0; i < PER_THREAD; ++i)
+			{
+				if (repliedFor(futures[i].get(), 1 + t * PER_THREAD + i))
+				{
+					++matched;
+				}
+			}
+		});
+	}
+	for (std::thread& caller : callers)
+	{
+		caller.join();
+	}
+
+	check(matched == THREADS * PER_THREAD, "replies in reverse order matched: " + std::to_string(matched.load()));
+	check(rpc.getPendingCount() == 0, "requests left pending after their replies");
+	server.m_batch = 1;
+}
+
+static void testDeadlines(MailboxRpc& rpc)
+{
+	MetricCounter timeouts = MetricsRegistry::Process().getCounter(CLIENT_NAME + ".rpc_timeouts");
+	MetricCounter unmatched = MetricsRegistry::Process().getCounter(CLIENT_NAME + ".rpc_unmatched");
+	const uint64_t timeoutsBefore = timeouts.Get(), unmatchedBefore = unmatched.Get();
+
+	// A request without reply must not hold up the one behind it
+	const auto start = std::chrono::steady_clock::now();
+	std::future<RpcResult> ignored = rpc.Call(SERVER_NAME, makeRequest(IGNORED_DOOR), std::chrono::milliseconds(100));
+	std::future<RpcResult> answered = rpc.Call(SERVER_NAME, makeRequest(7), std::chrono::milliseconds(2000));
+	check(repliedFor(answered.get(), 7), "request behind an unanswered one not replied");
+	check(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100), "request waited for the unanswered one");
+
+	check(ignored.get().m_outcome == RpcResult::TIMED_OUT, "unanswered request not TIMED_OUT");
+	const auto waited = std::chrono::steady_clock::now() - start;
+	check(waited >= std::chrono::milliseconds(100) && waited < std::chrono::milliseconds(300),
+		"deadline of 100 ms met after " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(waited).count()) + " ms");
+
+	// The reply arrives after the deadline and is dropped, the next request still gets its own reply
+	std::future<RpcResult> late = rpc.Call(SERVER_NAME, makeRequest(LATE_DOOR), std::chrono::milliseconds(50));
+	check(late.get().m_outcome == RpcResult::TIMED_OUT, "late request not TIMED_OUT");
+	std::this_thread::sleep_for(std::chrono::milliseconds(LATE_REPLY_MS + 50));
+	check(repliedFor(rpc.Call(SERVER_NAME, makeRequest(8), std::chrono::milliseconds(2000)).get(), 8), "request after a late reply got the wrong reply");
+
+	check(timeouts.Get() - timeoutsBefore == 2, "timeouts counted: " + std::to_string(timeouts.Get() - timeoutsBefore));
+	check(unmatched.Get() - unmatchedBefore == 1, "late replies counted: " + std::to_string(unmatched.Get() - unmatchedBefore));
+}
+
+static void testCancel(MailboxRpc& rpc)
+{
+	std::atomic<int> calls(0);
+	RpcResult::enuOutcome outcome = RpcResult::REPLIED;
+	const RequestId requestId = rpc.Call(SERVER_NAME, makeRequest(IGNORED_DOOR), std::chrono::milliseconds(5000), [&](RpcResult& result)
+	{
+		outcome = result.m_outcome;
+		++calls;
+	});
+
+	check(requestId != NO_REQUEST, "request ID not assigned");
+	check(rpc.Cancel(requestId), "pending request not cancelled");
+	check(!rpc.Cancel(requestId), "request cancelled twice");
+	check(calls == 1 && outcome == RpcResult::CANCELLED, "callback of a cancelled request");
+	check(rpc.getPendingCount() == 0, "cancelled request still pending");
+}
+
+static void testFullQueue(MailboxRpc& rpc, TestServer& server)
+{
+	// More requests than the server's queue holds; the client keeps running while they wait
+	const int REQUESTS = GlobalProperties::Get().QUEUE_SIZE * 2 + 5;
+	server.m_paused = true;
+	// Let the server finish the receive it may be in
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	std::vector<std::future<RpcResult>> futures;
+	std::vector<RequestId> ids;
+	std::atomic<int> replied(0);
+	for (int i = 0; i < REQUESTS; ++i)
+	{
+		ids.push_back(rpc.Call(SERVER_NAME, makeRequest(1 + i), std::chrono::milliseconds(5000), [&replied, i](RpcResult& result)
+		{
+			if (repliedFor(result, 1 + i))
+			{
+				++replied;
+			}
+		}));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	check(rpc.Cancel(ids.back()), "request waiting for a full queue not cancelled");
+	check(rpc.getPendingCount() == static_cast<size_t>(REQUESTS - 1), "requests lost while the server's queue was full");
+
+	server.m_paused = false;
+	for (int i = 0; i < 200 && rpc.getPendingCount() != 0; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	check(replied == REQUESTS - 1, "requests replied after the server's queue drained: " + std::to_string(replied.load()));
+}
+
+static void testStop(MailboxRpc& rpc)
+{
+	std::future<RpcResult> pending = rpc.Call(SERVER_NAME, makeRequest(IGNORED_DOOR), std::chrono::milliseconds(5000));
+	rpc.Stop();
+	check(pending.get().m_outcome == RpcResult::STOPPED, "pending request not STOPPED by Stop()");
+	check(rpc.Call(SERVER_NAME, makeRequest(1), std::chrono::milliseconds(5000)).get().m_outcome == RpcResult::STOPPED, "request after Stop() not STOPPED");
+}
+
+int main()
+{
+	TestServer server;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	MailboxRpc rpc(CLIENT_NAME);
+	rpc.Start();
+
+	testOutOfOrder(rpc, server);
+	testDeadlines(rpc);
+	testCancel(rpc);
+	testFullQueue(rpc, server);
+	testStop(rpc);
+
+	return testResult();
+}
@@ -0,0 +1,186 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SessionTable.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Two doors authorizing at the same time through SessionTable: both requests reach the database without a
+// "busy" rejection, replies are delivered out of order, a stale reply is discarded and an unanswered request
+// times out. The database and the indicator servers are played by mailboxes of this program.
+
+static const std::string MAIN_NAME = "sessions.test.main";
+static const std::string DATABASE_NAME = "sessions.test.db";
+static const std::string INDICATORS_NAME = "sessions.test.indicators";
+
+/// Next message in `mailbox`, nullptr if none arrives within 200 ms
+static DataMailboxMessage* receive(DataMailbox& mailbox)
+{
+	mailbox.setTimeout_settings(Time::getTimespecFrom_ms(200));
+	DataMailboxMessage* pMessage = mailbox.receive(enuReceiveOptions::TIMED);
+
+	if (pMessage->getDataType() == MessageDataType::enuType::DataMailboxErrorMessage)
+	{
+		delete pMessage;
+		return nullptr;
+	}
+
+	return pMessage;
+}
+
+/// Every indicator request queued at `server`
+static std::vector<InputParameter::enuType> drainIndicators(DataMailbox& server)
+{
+	std::vector<InputParameter::enuType> requests;
+
+	while (DataMailboxMessage* pMessage = receive(server))
+	{
+		CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage);
+		if (pCommand != nullptr && pCommand->getParameterCount() > 0)
+		{
+			requests.push_back(pCommand->getParameterAt(0).getType());
+		}
+		delete pMessage;
+	}
+
+	return requests;
+}
+
+static bool contains(const std::vector<InputParameter::enuType>& requests, InputParameter::enuType request)
+{
+	for (InputParameter::enuType received : requests)
+	{
+		if (received == request) return true;
+	}
+	return false;
+}
+
+/// PIN entry at `doorId`, as HardwareDaemon sends it
+static void enterPin(SessionTable& sessions, DoorId doorId, const std::string& pin)
+{
+	CommandMessage* pRequest = new CommandMessage(CommandMessage::AUTHENTICATE);
+	pRequest->setDoorId(doorId);
+	pRequest->addParameter({ InputParameter::KeypadPIN, pin });
+
+	sessions.Dispatch(pRequest, new MainAutomatonEvent(MainAutomaton::enuEvtKeypadMessageReceived, pRequest));
+	delete pRequest;
+}
+
+static void reply(SessionTable& sessions, DoorId doorId, RequestId requestId, Clearance clearance)
+{
+	DatabaseReply message(clearance);
+	message.setDoorId(doorId);
+	message.setRequestId(requestId);
+
+	sessions.Dispatch(&message, new MainAutomatonEvent(MainAutomaton::enuEvtKeypadMessageReceived, &message));
+}
+
+int main()
+{
+	DataMailbox mainMailbox(MAIN_NAME);
+	DataMailbox database(DATABASE_NAME);
+	MailboxReference refDatabase(DATABASE_NAME);
+
+	const std::string SERVER_SUFFIX = GlobalProperties::Get().INDICATORS_MB_SERVER_SUFFIX;
+	DataMailbox door1(DoorIndicators::MailboxName(INDICATORS_NAME, 1) + SERVER_SUFFIX);
+	DataMailbox door2(DoorIndicators::MailboxName(INDICATORS_NAME, 2) + SERVER_SUFFIX);
+
+	DoorIndicators indicators;
+	indicators.AddDoor(1, INDICATORS_NAME);
+	indicators.AddDoor(2, INDICATORS_NAME);
+
+	SessionTable sessions(&mainMailbox, &refDatabase, &indicators);
+	sessions.AddDoor(1);
+	sessions.AddDoor(2);
+
+	// Both doors send a request before either is answered
+	enterPin(sessions, 1, "1111");
+	enterPin(sessions, 2, "2222");
+	check(sessions.getSessionCount() == 2, "one session per door");
+
+	RequestId requestIds[3] = { NO_REQUEST, NO_REQUEST, NO_REQUEST };
+	for (int i = 0; i < 2; ++i)
+	{
+		CommandMessage* pRequest = dynamic_cast<CommandMessage*>(receive(database));
+		check(pRequest != nullptr, "request " + std::to_string(i) + " did not reach the database");
+		if (pRequest == nullptr) continue;
+
+		check(pRequest->getDoorId() == 1 || pRequest->getDoorId() == 2, "request without its door");
+		if (pRequest->getDoorId() == 1 || pRequest->getDoorId() == 2)
+		{
+			requestIds[pRequest->getDoorId()] = pRequest->getRequestId();
+		}
+		delete pRequest;
+	}
+	check(requestIds[1] != NO_REQUEST && requestIds[2] != NO_REQUEST && requestIds[1] != requestIds[2], "requests without distinct IDs");
+	check(!contains(drainIndicators(door2), InputParameter::BuzzerPing), "second door was told the device is busy");
+	drainIndicators(door1);
+
+	// Out of order: door 2 is answered first, door 1 keeps waiting
+	reply(sessions, 2, requestIds[2], 5);
+	check(contains(drainIndicators(door2), InputParameter::DoorOpen_wBuzzerSuccess), "door 2 not opened by its reply");
+	check(drainIndicators(door1).empty(), "reply for door 2 shown at door 1");
+
+	// A reply with an ID door 1 is not waiting for is discarded
+	reply(sessions, 1, requestIds[1] + 1000, 5);
+	check(drainIndicators(door1).empty(), "stale reply opened door 1");
+
+	reply(sessions, 1, requestIds[1], 5);
+	check(contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "door 1 not opened by its reply");
+
+	// An unanswered request times out, and its late reply is discarded
+	enterPin(sessions, 1, "1111");
+	CommandMessage* pUnanswered = dynamic_cast<CommandMessage*>(receive(database));
+	check(pUnanswered != nullptr, "third request did not reach the database");
+	RequestId unansweredId = pUnanswered ? pUnanswered->getRequestId() : NO_REQUEST;
+	delete pUnanswered;
+	drainIndicators(door1);
+
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + std::chrono::seconds(1));
+	check(drainIndicators(door1).empty(), "request timed out before its deadline");
+
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + std::chrono::seconds(GlobalProperties::Get().REQUEST_DEADLINE_TIMER_TIMEOUT_S + 1));
+	check(contains(drainIndicators(door1), InputParameter::BuzzerError), "overdue request not timed out");
+
+	reply(sessions, 1, unansweredId, 5);
+	check(!contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "late reply opened the door");
+
+	// Doors which were not added get no session
+	enterPin(sessions, 3, "1111");
+	check(receive(database) == nullptr, "request of an unconfigured door reached the database");
+	check(drainIndicators(door1).empty(), "request of an unconfigured door shown at door 1");
+
+	enterPin(sessions, NO_DOOR, "1111");
+	check(receive(database) == nullptr, "request without a door reached the database");
+
+	enterPin(sessions, DoorProperties::MAX_ID + 1, "1111");
+	check(receive(database) == nullptr, "request of an unknown door reached the database");
+	check(sessions.getSessionCount() == 2, "session created for an unconfigured door");
+
+	return testResult();
+}
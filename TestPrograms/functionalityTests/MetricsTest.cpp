@@ -0,0 +1,167 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "Metrics.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Metrics published to a registry are read back through shared memory: counters shared by name,
+// gauges, histogram buckets and percentiles, type clashes and a full registry. Also measures the
+// cost of a counter increment and a histogram sample, which must stay below the bound given as
+// the first argument (ns, default 100).
+
+static const MetricsRegistry::Value* find(const MetricsRegistry::Snapshot& snapshot, const std::string& name)
+{
+	for (const MetricsRegistry::Value& value : snapshot.m_metrics)
+	{
+		if (value.m_name == name) return &value;
+	}
+	return nullptr;
+}
+
+int main(int argc, char** argv)
+{
+	const double maxUpdateCost_ns = argc > 1 ? std::atof(argv[1]) : 100.0;
+	const std::string SEGMENT_NAME = "MetricsTest." + std::to_string(getpid());
+
+	// Bucket bounds cover every value exactly once
+	bool bucketsConsistent = true;
+	for (uint32_t i = 0; i + 1 < MetricHistogram::BUCKET_COUNT; ++i)
+	{
+		bucketsConsistent &= MetricHistogram::BucketIndex(MetricHistogram::BucketLowerBound(i)) == i;
+		bucketsConsistent &= MetricHistogram::BucketIndex(MetricHistogram::BucketUpperBound(i)) == i;
+		bucketsConsistent &= MetricHistogram::BucketUpperBound(i) + 1 == MetricHistogram::BucketLowerBound(i + 1);
+	}
+	check(bucketsConsistent, "histogram bucket bounds inconsistent");
+	check(MetricHistogram::BucketIndex(UINT64_MAX) == MetricHistogram::BUCKET_COUNT - 1, "huge value outside the last bucket");
+
+	MetricsRegistry registry(SEGMENT_NAME);
+	check(registry.isOpen(), "segment not created");
+
+	MetricCounter sent = registry.getCounter("mailbox.sent");
+	MetricCounter sentAgain = registry.getCounter("mailbox.sent");
+	MetricGauge depth = registry.getGauge("mailbox.depth");
+	MetricHistogram latency = registry.getHistogram("database.request_ns");
+
+	sent.Increment();
+	sentAgain.Increment(4);
+	depth.Set(7);
+	depth.Add(-2);
+
+	// 1 .. 1000 us, so the percentiles are known
+	for (uint64_t us = 1; us <= 1000; ++us)
+	{
+		latency.Record_ns(us * 1000);
+	}
+
+	MetricCounter clash = registry.getCounter("mailbox.depth");
+	clash.Increment(100);
+
+	MetricsRegistry::Snapshot snapshot;
+	check(MetricsRegistry::Read(SEGMENT_NAME, snapshot), "segment not readable");
+	check(snapshot.m_pid == getpid(), "pid not published");
+	check(snapshot.m_metrics.size() == 3, "expected 3 metrics, got " + std::to_string(snapshot.m_metrics.size()));
+
+	const MetricsRegistry::Value* pSent = find(snapshot, "mailbox.sent");
+	check(pSent != nullptr && pSent->m_type == MetricsRegistry::enuCounter && pSent->m_value == 5, "counter not shared by name");
+
+	const MetricsRegistry::Value* pDepth = find(snapshot, "mailbox.depth");
+	check(pDepth != nullptr && pDepth->m_type == MetricsRegistry::enuGauge && pDepth->m_value == 5, "gauge wrong or changed through a counter of the same name");
+
+	const MetricsRegistry::Value* pLatency = find(snapshot, "database.request_ns");
+	check(pLatency != nullptr && pLatency->m_type == MetricsRegistry::enuHistogram, "histogram not published");
+	if (pLatency != nullptr)
+	{
+		check(pLatency->m_value == 1000 && pLatency->m_max_ns == 1000000 && pLatency->m_sum_ns == 500500000, "histogram count, max or sum wrong");
+
+		// Within the 12.5 % bucket resolution, never below the real value
+		const uint64_t p50 = pLatency->Percentile_ns(50);
+		const uint64_t p99 = pLatency->Percentile_ns(99);
+		check(p50 >= 500000 && p50 <= 500000 * 1.125, "p50 " + std::to_string(p50) + " ns, expected about 500 us");
+		check(p99 >= 990000 && p99 <= 1000000, "p99 " + std::to_string(p99) + " ns, expected about 990 us");
+		check(pLatency->Percentile_ns(100) == 1000000, "p100 is not the max");
+	}
+
+	// Concurrent increments are not lost
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&registry]()
+		{
+			MetricCounter counter = registry.getCounter("threads.increments");
+			for (int i = 0; i < 100000; ++i) counter.Increment();
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	check(registry.getCounter("threads.increments").Get() == 400000, "concurrent increments lost");
+
+	// A full registry keeps working, it just does not publish
+	for (uint32_t i = 0; i < MetricsRegistry::MAX_METRICS; ++i)
+	{
+		registry.getCounter("filler." + std::to_string(i)).Increment();
+	}
+	MetricCounter overflow = registry.getCounter("overflow");
+	overflow.Increment();
+	check(MetricsRegistry::Read(SEGMENT_NAME, snapshot) && snapshot.m_metrics.size() == MetricsRegistry::MAX_METRICS
+		&& find(snapshot, "overflow") == nullptr, "metric published past the capacity");
+
+	MetricsRegistry unpublished("");
+	check(!unpublished.isOpen(), "registry with an empty name published");
+	unpublished.getHistogram("unpublished_ns").Record_ns(1);
+
+	check(!MetricsRegistry::Read(SEGMENT_NAME + ".missing", snapshot), "missing segment read");
+
+	// Cost of the hot path updates
+	const int ITERATIONS = 1000000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		sent.Increment();
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	const double incrementCost_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(ITERATIONS);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		latency.Record_ns(static_cast<uint64_t>(i) * 97);
+	}
+	elapsed = std::chrono::steady_clock::now() - start;
+	const double recordCost_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / static_cast<double>(ITERATIONS);
+
+	std::cout << "Counter increment: " << incrementCost_ns << " ns, histogram sample: " << recordCost_ns << " ns" << std::endl;
+	check(incrementCost_ns < maxUpdateCost_ns && recordCost_ns < maxUpdateCost_ns, "metric update takes longer than " + std::to_string(maxUpdateCost_ns) + " ns");
+
+	shm_unlink(("/" + SEGMENT_NAME).c_str());
+
+	return testResult();
+}
@@ -0,0 +1,275 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include"DoorDeviceLoop.hpp"
+#include"SimulatedCardReader.hpp"
+#include"KeypadEvent.hpp"
+#include"TestCheck.hpp"
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include<fcntl.h>
+#include<poll.h>
+#include<time.h>
+#include<unistd.h>
+#include<sys/time.h>
+
+// Runs DOORS simulated doors (keypad fed through a pipe + SimulatedCardReader) on one DoorDeviceLoop thread.
+// Checks that every key entry and card reaches the pipes of the door it was made at, and reports
+// event latency, thread count and CPU use while idle. Must be run from the directory containing config.xml.
+// Usage: MultiDoorScaleTest [DOORS] [ROUNDS]
+
+using Clock = std::chrono::steady_clock;
+
+static const unsigned int POLL_COST_US = 200;
+
+/// Key codes of the keypad digits 0 - 9, which are not contiguous
+static const unsigned short DIGIT_KEYS[] = { KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9 };
+
+static double processCpuTime_ms()
+{
+	timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+static int threadCount()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 8, "Threads:") == 0) return std::stoi(line.substr(8));
+	}
+	return -1;
+}
+
+/// Simulated hardware of one door and the reading ends of its pipes (the InputController side)
+struct SimulatedDoor
+{
+	unsigned int id;
+	int keyWriteFd;
+	std::unique_ptr<Pipe> keypadIn;
+	std::unique_ptr<Pipe> keypadOut;
+	std::unique_ptr<Pipe> rfidIn;
+	std::unique_ptr<Pipe> rfidOut;
+	std::unique_ptr<Keypad> keypad;
+	std::unique_ptr<SimulatedCardReader> reader;
+
+	void key(unsigned short code)
+	{
+		input_event events[4] = {};
+		for (input_event& event : events) gettimeofday(&event.time, nullptr);
+		events[0].type = EV_KEY; events[0].code = code; events[0].value = 1;
+		events[1].type = EV_SYN; events[1].code = SYN_REPORT;
+		events[2].type = EV_KEY; events[2].code = code; events[2].value = 0;
+		events[3].type = EV_SYN; events[3].code = SYN_REPORT;
+		if (write(keyWriteFd, events, sizeof(events)) != sizeof(events)) std::cout << "key write failed" << std::endl;
+	}
+};
+
+struct Received
+{
+	size_t door;
+	bool fromRFID;
+	PipeMessage message;
+};
+
+/// Waits for the next message on any door pipe, like the logic thread of HardwareDaemon
+static bool receiveAny(std::vector<SimulatedDoor>& doors, Received& received, int timeout_ms = 2000)
+{
+	std::vector<pollfd> fds;
+	for (SimulatedDoor& door : doors)
+	{
+		fds.push_back({ door.keypadIn->getFd(), POLLIN, 0 });
+		fds.push_back({ door.rfidIn->getFd(), POLLIN, 0 });
+	}
+
+	const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (true)
+	{
+		for (size_t i = 0; i < doors.size(); ++i)
+		{
+			if (doors[i].keypadIn->receiveMessage(received.message)) { received.door = i; received.fromRFID = false; return true; }
+			if (doors[i].rfidIn->receiveMessage(received.message)) { received.door = i; received.fromRFID = true; return true; }
+		}
+
+		int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		if (remaining_ms < 0 || poll(fds.data(), fds.size(), remaining_ms) <= 0) return false;
+	}
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	if (values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+int main(int argc, char** argv)
+{
+	int DOORS = 16;
+	int ROUNDS = 5;
+	if (argc >= 2) DOORS = std::stoi(argv[1]);
+	if (argc >= 3) ROUNDS = std::stoi(argv[2]);
+	if (DOORS < 1 || ROUNDS < 1)
+	{
+		std::cout << "Input arguments DOORS and ROUNDS cannot be negative or zero!" << std::endl;
+		return -1;
+	}
+
+	const int threadsBefore = threadCount();
+
+	DoorDeviceLoop devices(CardReaderSettings{ 10, 250, 200, 50 }, 1000);
+	std::vector<SimulatedDoor> doors(DOORS);
+
+	for (int i = 0; i < DOORS; ++i)
+	{
+		SimulatedDoor& door = doors[i];
+		door.id = i + 1;
+
+		const std::string keypadPipe = "MultiDoorScaleTest.keypad." + std::to_string(door.id);
+		const std::string rfidPipe = "MultiDoorScaleTest.rfid." + std::to_string(door.id);
+
+		// Reading ends first, so opening the writing ends does not block
+		door.keypadIn.reset(new Pipe(keypadPipe, Kernel::IOMode::READ_NONBLOCKING, 64));
+		door.rfidIn.reset(new Pipe(rfidPipe, Kernel::IOMode::READ_NONBLOCKING, 64));
+		door.keypadOut.reset(new Pipe(keypadPipe, Kernel::IOMode::WRITE, 64));
+		door.rfidOut.reset(new Pipe(rfidPipe, Kernel::IOMode::WRITE, 64));
+
+		int keyFds[2];
+		if (pipe2(keyFds, O_NONBLOCK | O_CLOEXEC) < 0)
+		{
+			std::cout << "FAILED: cannot create key pipe" << std::endl;
+			return -1;
+		}
+		door.keyWriteFd = keyFds[1];
+		door.keypad.reset(new Keypad(keyFds[0], door.keypadOut.get()));
+		door.reader.reset(new SimulatedCardReader("door " + std::to_string(door.id), POLL_COST_US));
+
+		devices.AddDoor(door.keypad.get(), door.reader.get(), door.rfidOut.get());
+	}
+
+	std::atomic<bool> stop{ false };
+	std::thread deviceThread([&]()
+	{
+		while (!stop)
+		{
+			devices.RunOnce(100);
+		}
+	});
+
+	// Let every reader back off before measuring
+	usleep(1000 * 1000);
+
+	const int threadsServing = threadCount();
+	std::vector<double> keyLatencies_us;
+	std::vector<double> cardLatencies_us;
+	std::vector<unsigned int> routed(DOORS, 0);
+
+	unsigned int seed = 4321;
+	for (int round = 0; round < ROUNDS; ++round)
+	{
+		for (int step = 0; step < DOORS; ++step)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const size_t target = (seed >> 16) % DOORS;
+			SimulatedDoor& door = doors[target];
+			Received received;
+
+			// PIN entry "*<door ID>": the digits identify the door the keys were pressed at
+			const std::string digits = std::to_string(door.id);
+			door.key(KEY_KPASTERISK);
+			for (char digit : digits) door.key(DIGIT_KEYS[digit - '0']);
+
+			Clock::time_point start = Clock::now();
+			door.key(KEY_KPENTER);
+			bool ok = receiveAny(doors, received);
+			keyLatencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+
+			KeypadEvent event = KeypadEvent::fromPipeMessage(received.message);
+			check(ok && !received.fromRFID && received.door == target && event.getData() == "*" + digits,
+				"key entry at door " + digits + " not routed to its keypad pipe");
+
+			// Card "CARD-<door ID>", taken out of the field once it was read
+			const std::string card = "CARD-" + digits + "-" + std::to_string(round * DOORS + step);
+			door.reader->PresentCard(card);
+			ok = receiveAny(doors, received);
+			cardLatencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - door.reader->getPresentedAt()).count());
+			door.reader->RemoveCard();
+
+			check(ok && received.fromRFID && received.door == target && received.message.getType() == PipeMessage::RFIDCard
+				&& received.message.getData() == card, "card at door " + digits + " not routed to its RFID pipe");
+
+			if (ok && received.door == target) ++routed[target];
+		}
+	}
+
+	// Nothing may arrive that was not expected, e.g. a card forwarded twice or to two doors
+	Received unexpected;
+	check(!receiveAny(doors, unexpected, 300), "unexpected message after the last event");
+
+	// Idle: every reader at its idle interval and no keys pressed
+	const double cpuStart_ms = processCpuTime_ms();
+	const Clock::time_point idleStart = Clock::now();
+	usleep(2000 * 1000);
+	const double idleElapsed_ms = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - idleStart).count() / 1000.0;
+	const double idleCpu_percent = (processCpuTime_ms() - cpuStart_ms) / idleElapsed_ms * 100.0;
+
+	stop = true;
+	devices.Interrupt();
+	deviceThread.join();
+
+	for (SimulatedDoor& door : doors)
+	{
+		close(door.keyWriteFd);
+		unlink(("MultiDoorScaleTest.keypad." + std::to_string(door.id)).c_str());
+		unlink(("MultiDoorScaleTest.rfid." + std::to_string(door.id)).c_str());
+	}
+
+	std::cout << DOORS << " doors, " << ROUNDS * DOORS << " key entries and cards" << std::endl;
+	std::cout << "Threads serving devices: " << threadsServing - threadsBefore << std::endl;
+	std::cout << "Key entry latency: p50 " << percentile(keyLatencies_us, 0.5) / 1000.0 << " ms, p99 "
+		<< percentile(keyLatencies_us, 0.99) / 1000.0 << " ms" << std::endl;
+	std::cout << "Card latency: p50 " << percentile(cardLatencies_us, 0.5) / 1000.0 << " ms, p99 "
+		<< percentile(cardLatencies_us, 0.99) / 1000.0 << " ms" << std::endl;
+	std::cout << "Idle CPU: " << idleCpu_percent << " %" << std::endl;
+
+	check(threadsServing - threadsBefore == 1, "more than one thread serves the doors");
+	check(percentile(keyLatencies_us, 0.99) < 50 * 1000, "key entry latency above 50 ms");
+	// Worst case: presented just after a poll of a reader at its 250 ms idle interval
+	check(percentile(cardLatencies_us, 0.99) < 300 * 1000, "card latency above the idle poll interval");
+	// Idle readers are polled 4 times a second at POLL_COST_US each
+	check(idleCpu_percent < DOORS * 4 * POLL_COST_US / 10000.0 * 2 + 1, "idle CPU use does not match the idle poll rate");
+
+	return testResult();
+}
@@ -0,0 +1,353 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "SessionTable.hpp"
+#include "OfflineCache.hpp"
+#include "FieldValidators.hpp"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Doors keep deciding while DatabaseGateway is down. A child process plays the gateway: it answers the first requests,
+// which fill the offline cache, and is killed with SIGKILL after taking the next one. Known credentials are then decided
+// from the cache once the offline deadline passes (also at once when the gateway's mailbox is full), unknown ones time out.
+// A restarted gateway receives every offline decision as OFFLINE_LOG. Finally the cache file survives a restart and is
+// rejected once modified. Writes OfflineAuthorizationTest.cache(.key) in the current directory.
+
+static const std::string MAIN_NAME = "offline.test.main";
+static const std::string DATABASE_NAME = "offline.test.db";
+static const std::string INDICATORS_NAME = "offline.test.indicators";
+static const std::string CACHE_PATH = "OfflineAuthorizationTest.cache";
+
+static const std::chrono::milliseconds OFFLINE_DEADLINE(500);
+static const std::map<std::string, Clearance> CLEARANCES = { { "1111", 5 }, { "2222", NO_CLEARANCE } };
+
+/// Next message in `mailbox`, nullptr if none arrives within 200 ms
+static DataMailboxMessage* receive(DataMailbox& mailbox)
+{
+	mailbox.setTimeout_settings(Time::getTimespecFrom_ms(200));
+	DataMailboxMessage* pMessage = mailbox.receive(enuReceiveOptions::TIMED);
+
+	if (pMessage->getDataType() == MessageDataType::enuType::DataMailboxErrorMessage)
+	{
+		delete pMessage;
+		return nullptr;
+	}
+
+	return pMessage;
+}
+
+/**
+ * Plays DatabaseGateway until killed: answers AUTHENTICATE from CLEARANCES and reports every OFFLINE_LOG on `reportFd`
+ * ('L', or 'X' if its timestamp is malformed). Reports 'R' once its mailbox exists; after `answers` requests it stalls
+ * on the next one and reports 'S'.
+*/
+static void runGateway(int reportFd, int answers)
+{
+	DataMailbox database(DATABASE_NAME);
+	write(reportFd, "R", 1);
+
+	while (true)
+	{
+		DataMailboxMessage* pMessage = database.receive();
+		CommandMessage* pRequest = dynamic_cast<CommandMessage*>(pMessage);
+
+		if (pRequest != nullptr && pRequest->getCommandId() == CommandMessage::OFFLINE_LOG)
+		{
+			const bool valid = pRequest->getParameterCount() == 2
+				&& FieldValidators::Timestamp::test(pRequest->getParameterAt(1).getData());
+			write(reportFd, valid ? "L" : "X", 1);
+		}
+		else if (pRequest != nullptr && answers-- > 0)
+		{
+			auto found = CLEARANCES.find(pRequest->getParameterAt(0).getData());
+			DatabaseReply reply(found != CLEARANCES.end() ? found->second : NO_CLEARANCE);
+			reply.setDoorId(pRequest->getDoorId());
+			reply.setRequestId(pRequest->getRequestId());
+			database.sendConnectionless(pRequest->getSource(), &reply);
+		}
+		else if (pRequest != nullptr)
+		{
+			write(reportFd, "S", 1);
+			pause();
+		}
+
+		delete pMessage;
+	}
+}
+
+/// Forks a gateway and waits until its mailbox exists
+static pid_t startGateway(int pipeFds[2], int answers)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(pipeFds[0]);
+		runGateway(pipeFds[1], answers);
+		_exit(0);
+	}
+
+	char ready = 0;
+	read(pipeFds[0], &ready, 1);
+	check(ready == 'R', "gateway did not start");
+	return pid;
+}
+
+static void killGateway(pid_t pid)
+{
+	kill(pid, SIGKILL);
+	waitpid(pid, nullptr, 0);
+}
+
+/// Every indicator request queued at `server`
+static std::vector<InputParameter::enuType> drainIndicators(DataMailbox& server)
+{
+	std::vector<InputParameter::enuType> requests;
+
+	while (DataMailboxMessage* pMessage = receive(server))
+	{
+		CommandMessage* pCommand = dynamic_cast<CommandMessage*>(pMessage);
+		if (pCommand != nullptr && pCommand->getParameterCount() > 0)
+		{
+			requests.push_back(pCommand->getParameterAt(0).getType());
+		}
+		delete pMessage;
+	}
+
+	return requests;
+}
+
+static bool contains(const std::vector<InputParameter::enuType>& requests, InputParameter::enuType request)
+{
+	for (InputParameter::enuType received : requests)
+	{
+		if (received == request) return true;
+	}
+	return false;
+}
+
+/// PIN entry at `doorId`, as HardwareDaemon sends it
+static void enterPin(SessionTable& sessions, DoorId doorId, const std::string& pin)
+{
+	CommandMessage* pRequest = new CommandMessage(CommandMessage::AUTHENTICATE);
+	pRequest->setDoorId(doorId);
+	pRequest->addParameter({ InputParameter::KeypadPIN, pin });
+
+	sessions.Dispatch(pRequest, new MainAutomatonEvent(MainAutomaton::enuEvtKeypadMessageReceived, pRequest));
+	delete pRequest;
+}
+
+/// Handles the gateway's replies like MainApplication's main loop does, queued offline logs follow every reply
+static void pumpReplies(DataMailbox& mainMailbox, MailboxReference& refDatabase, SessionTable& sessions, OfflineCache& cache)
+{
+	while (DataMailboxMessage* pMessage = receive(mainMailbox))
+	{
+		cache.DeliverLogs(mainMailbox, refDatabase, 4);
+		sessions.Dispatch(pMessage, new MainAutomatonEvent(MainAutomaton::enuEvtKeypadMessageReceived, pMessage));
+		delete pMessage;
+	}
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+int main()
+{
+	// A blocking send to the dead gateway would hang the test instead of failing it
+	alarm(60);
+
+	unlink(CACHE_PATH.c_str());
+	unlink((CACHE_PATH + ".key").c_str());
+
+	int pipeFds[2];
+	pipe(pipeFds);
+
+	pid_t gateway = startGateway(pipeFds, 3);
+
+	DataMailbox mainMailbox(MAIN_NAME);
+	MailboxReference refDatabase(DATABASE_NAME);
+
+	const std::string SERVER_SUFFIX = GlobalProperties::Get().INDICATORS_MB_SERVER_SUFFIX;
+	DataMailbox door1(DoorIndicators::MailboxName(INDICATORS_NAME, 1) + SERVER_SUFFIX);
+	DataMailbox door2(DoorIndicators::MailboxName(INDICATORS_NAME, 2) + SERVER_SUFFIX);
+
+	DoorIndicators indicators;
+	indicators.AddDoor(1, INDICATORS_NAME);
+	indicators.AddDoor(2, INDICATORS_NAME);
+
+	OfflineCache::Limits limits;
+	limits.m_maxEntries = 100;
+	limits.m_ttl_s = 3600;
+	limits.m_maxQueuedLogs = 100;
+	OfflineCache cache(CACHE_PATH, limits);
+
+	SessionTable sessions(&mainMailbox, &refDatabase, &indicators);
+	sessions.AddDoor(1);
+	sessions.AddDoor(2);
+	sessions.setOfflineCache(&cache, OFFLINE_DEADLINE);
+
+	// The gateway answers: the cache learns a grant and a refusal at door 1 and a grant at door 2
+	const std::pair<DoorId, std::string> learned[] = { { 1, "1111" }, { 1, "2222" }, { 2, "1111" } };
+	for (const auto& entry : learned)
+	{
+		enterPin(sessions, entry.first, entry.second);
+		pumpReplies(mainMailbox, refDatabase, sessions, cache);
+	}
+	check(contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "door 1 not opened by the gateway");
+	check(contains(drainIndicators(door2), InputParameter::DoorOpen_wBuzzerSuccess), "door 2 not opened by the gateway");
+	check(cache.getEntryCount() == 3, "cache did not learn the replies: " + std::to_string(cache.getEntryCount()));
+
+	// Killed after taking the next request, which is never answered
+	enterPin(sessions, 1, "1111");
+	char stalled = 0;
+	read(pipeFds[0], &stalled, 1);
+	check(stalled == 'S', "gateway did not take the request");
+	killGateway(gateway);
+	drainIndicators(door1);
+
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + OFFLINE_DEADLINE / 2);
+	check(drainIndicators(door1).empty(), "decided offline before the offline deadline");
+
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + OFFLINE_DEADLINE);
+	check(contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "known credential not granted offline");
+	size_t offlineDecisions = 1;
+
+	// The refusal is repeated offline
+	enterPin(sessions, 1, "2222");
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + OFFLINE_DEADLINE);
+	std::vector<InputParameter::enuType> shown = drainIndicators(door1);
+	check(contains(shown, InputParameter::BuzzerError) && !contains(shown, InputParameter::DoorOpen_wBuzzerSuccess), "refused credential not refused offline");
+	++offlineDecisions;
+
+	// Unknown at this door: waits for the gateway until the regular deadline
+	enterPin(sessions, 2, "2222");
+	drainIndicators(door2);
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + OFFLINE_DEADLINE);
+	check(drainIndicators(door2).empty(), "unknown credential decided offline");
+	sessions.CheckDeadlines(std::chrono::steady_clock::now() + std::chrono::seconds(GlobalProperties::Get().REQUEST_DEADLINE_TIMER_TIMEOUT_S + 1));
+	check(contains(drainIndicators(door2), InputParameter::BuzzerError), "unknown credential not timed out");
+
+	// Requests pile up in the dead gateway's mailbox; once it is full they are not sent and decided at once
+	for (int i = 0; i < 64 && !refDatabase.isFull(); ++i)
+	{
+		enterPin(sessions, 1, "1111");
+		sessions.CheckDeadlines(std::chrono::steady_clock::now() + OFFLINE_DEADLINE);
+		check(contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "known credential not granted offline");
+		++offlineDecisions;
+	}
+	check(refDatabase.isFull(), "gateway mailbox never filled up");
+
+	enterPin(sessions, 1, "1111");
+	sessions.CheckDeadlines();
+	check(contains(drainIndicators(door1), InputParameter::DoorOpen_wBuzzerSuccess), "not decided at once with a full gateway mailbox");
+	++offlineDecisions;
+
+	enterPin(sessions, 1, "3333");
+	sessions.CheckDeadlines();
+	check(contains(drainIndicators(door1), InputParameter::BuzzerError), "unknown credential not timed out at once with a full gateway mailbox");
+
+	check(cache.getQueuedLogCount() == offlineDecisions, "offline decisions not queued for the access log: "
+		+ std::to_string(cache.getQueuedLogCount()) + " of " + std::to_string(offlineDecisions));
+
+	// A restarted gateway clears its mailbox; the records follow its replies to new requests
+	gateway = startGateway(pipeFds, 1000);
+	for (int i = 0; i < 64 && cache.getQueuedLogCount() > 0; ++i)
+	{
+		enterPin(sessions, 1, "1111");
+		pumpReplies(mainMailbox, refDatabase, sessions, cache);
+		drainIndicators(door1);
+	}
+	check(cache.getQueuedLogCount() == 0, "offline log records not delivered");
+
+	// Answered after the records sent before it, so the gateway has reported all of them
+	enterPin(sessions, 1, "1111");
+	pumpReplies(mainMailbox, refDatabase, sessions, cache);
+	drainIndicators(door1);
+	killGateway(gateway);
+
+	fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+	size_t delivered = 0;
+	char report = 0;
+	while (read(pipeFds[0], &report, 1) == 1)
+	{
+		check(report == 'L', "malformed OFFLINE_LOG record");
+		delivered += (report == 'L');
+	}
+	check(delivered == offlineDecisions, "gateway received " + std::to_string(delivered) + " of " + std::to_string(offlineDecisions) + " offline log records");
+
+	// The signed file survives a restart
+	const int64_t now = time(nullptr);
+	check(cache.Save(now), "cache not saved");
+
+	OfflineCache restarted(CACHE_PATH, limits);
+	check(restarted.Load(now), "saved cache not loaded");
+	check(restarted.getEntryCount() == cache.getEntryCount(), "entries lost by save and load");
+
+	Clearance clearance = NO_CLEARANCE;
+	check(restarted.Decide({ InputParameter::KeypadPIN, "1111" }, 1, now, clearance) && clearance == 5, "loaded cache does not grant");
+	check(restarted.Decide({ InputParameter::KeypadPIN, "2222" }, 1, now, clearance) && clearance == NO_CLEARANCE, "loaded cache does not refuse");
+	check(!restarted.Decide({ InputParameter::KeypadPIN, "1111" }, 1, now + limits.m_ttl_s + 1, clearance), "expired entry decided");
+	check(!restarted.Decide({ InputParameter::RFIDCard, "1111" }, 1, now, clearance), "credential type ignored");
+
+	OfflineCache expired(CACHE_PATH, limits);
+	check(expired.Load(now + limits.m_ttl_s + 1) && expired.getEntryCount() == 0, "expired entries loaded");
+
+	// Neither PINs nor card UIDs are written to the file
+	const std::string file = readFile(CACHE_PATH);
+	check(file.find("1111") == std::string::npos && file.find("2222") == std::string::npos, "credential in the cache file");
+
+	std::string tampered = file;
+	tampered[tampered.size() / 2] ^= 0x01;
+	writeFile(CACHE_PATH, tampered);
+	OfflineCache rejecting(CACHE_PATH, limits);
+	check(!rejecting.Load(now) && rejecting.getEntryCount() == 0, "modified cache file accepted");
+
+	writeFile(CACHE_PATH, file.substr(0, file.size() - 1));
+	check(!rejecting.Load(now), "truncated cache file accepted");
+
+	unlink(CACHE_PATH.c_str());
+	unlink((CACHE_PATH + ".key").c_str());
+
+	return testResult();
+}
@@ -0,0 +1,206 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include"pipe.hpp"
+#include"TestCheck.hpp"
+
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include<poll.h>
+#include<unistd.h>
+
+// Sends framed messages through a FIFO as fast as possible and checks that none are lost, merged,
+// split or reordered: two writers sharing the FIFO with sendMessage(), then with batched sendMessages(),
+// then a frame delivered in two writes. Usage: PipeFramingStressTest [MESSAGES_PER_WRITER]
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string FIFO_PATH = "pipe_framing_stress.fifo";
+
+static void fail(const std::string& description)
+{
+	if (++failures <= 10) std::cout << "FAILED: " << description << std::endl;
+}
+
+/// Payload carries the sequence number and a length that varies with it
+static std::string makePayload(unsigned int sequence)
+{
+	return std::to_string(sequence) + ":" + std::string(sequence % 97, (char)('a' + sequence % 26));
+}
+
+/// Checks that messages of each type arrive with consecutive sequence numbers and intact payloads
+class SequenceChecker
+{
+public:
+	unsigned int m_nextKeypad = 0;
+	unsigned int m_nextRFID = 0;
+
+	void check(const PipeMessage& message)
+	{
+		unsigned int& next = message.getType() == PipeMessage::KeypadData ? m_nextKeypad : m_nextRFID;
+		if (message.getType() != PipeMessage::KeypadData && message.getType() != PipeMessage::RFIDCard)
+		{
+			fail("unexpected message type " + std::to_string((int)message.getType()));
+			return;
+		}
+
+		if (message.getData() != makePayload(next))
+		{
+			fail("expected \"" + makePayload(next).substr(0, 20) + "...\" got \"" + message.getData().substr(0, 20) + "...\"");
+		}
+		// strtoul() instead of stoul(), a torn frame must be reported and not throw
+		next = std::strtoul(message.getData().c_str(), nullptr, 10) + 1;
+	}
+
+	unsigned int total() const { return m_nextKeypad + m_nextRFID; }
+};
+
+/// Drains `reader` until `expected` messages arrived or nothing arrives for a second
+static void receiveAll(Pipe& reader, SequenceChecker& checker, unsigned int expected, unsigned long& reads)
+{
+	std::vector<PipeMessage> messages;
+	while (checker.total() < expected)
+	{
+		pollfd pollStruct = { reader.getFd(), POLLIN, 0 };
+		if (poll(&pollStruct, 1, 1000) <= 0)
+		{
+			fail("timed out after " + std::to_string(checker.total()) + " of " + std::to_string(expected) + " messages");
+			return;
+		}
+
+		messages.clear();
+		reader.receiveMessages(messages);
+		++reads;
+
+		for (const PipeMessage& message : messages) checker.check(message);
+	}
+}
+
+static void report(const std::string& name, unsigned int messages, unsigned long reads, Clock::duration elapsed)
+{
+	double seconds = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1e6;
+	std::cout << name << ": " << messages << " messages in " << seconds << " s ("
+		<< (unsigned long)(messages / seconds) << " messages/s, " << reads << " reads)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int MESSAGES = 100000;
+	if (argc >= 2)
+	{
+		int value = std::stoi(argv[1]);
+		if (value < 1)
+		{
+			std::cout << "Input argument MESSAGES_PER_WRITER cannot be negative or zero!" << std::endl;
+			return -1;
+		}
+		MESSAGES = value;
+	}
+
+	Pipe reader(FIFO_PATH, Kernel::IOMode::READ_NONBLOCKING, 64);
+
+	// Two writers sharing one FIFO, one message per write()
+	{
+		SequenceChecker checker;
+		unsigned long reads = 0;
+		auto start = Clock::now();
+
+		std::thread keypadWriter([MESSAGES]()
+		{
+			Pipe writer(FIFO_PATH, Kernel::IOMode::WRITE, 64);
+			for (unsigned int i = 0; i < MESSAGES; ++i) writer.sendMessage(PipeMessage(PipeMessage::KeypadData, makePayload(i)));
+		});
+		std::thread rfidWriter([MESSAGES]()
+		{
+			Pipe writer(FIFO_PATH, Kernel::IOMode::WRITE, 64);
+			for (unsigned int i = 0; i < MESSAGES; ++i) writer.sendMessage(PipeMessage(PipeMessage::RFIDCard, makePayload(i)));
+		});
+
+		receiveAll(reader, checker, 2 * MESSAGES, reads);
+		keypadWriter.join();
+		rfidWriter.join();
+
+		report("sendMessage, 2 writers", checker.total(), reads, Clock::now() - start);
+	}
+
+	// Two writers sharing one FIFO, batches of 128 messages per sendMessages() - larger than PIPE_BUF
+	{
+		SequenceChecker checker;
+		unsigned long reads = 0;
+		auto start = Clock::now();
+
+		auto batchWriter = [MESSAGES](PipeMessage::enuType type)
+		{
+			Pipe writer(FIFO_PATH, Kernel::IOMode::WRITE, 64);
+			std::vector<PipeMessage> batch;
+			for (unsigned int i = 0; i < MESSAGES; ++i)
+			{
+				batch.emplace_back(type, makePayload(i));
+				if (batch.size() == 128 || i + 1 == MESSAGES)
+				{
+					writer.sendMessages(batch);
+					batch.clear();
+				}
+			}
+		};
+		std::thread keypadWriter(batchWriter, PipeMessage::KeypadData);
+		std::thread rfidWriter(batchWriter, PipeMessage::RFIDCard);
+
+		receiveAll(reader, checker, 2 * MESSAGES, reads);
+		keypadWriter.join();
+		rfidWriter.join();
+
+		report("sendMessages, 2 writers, batches of 128", checker.total(), reads, Clock::now() - start);
+	}
+
+	// Frame split across two writes must be reassembled, not returned as two messages
+	{
+		Pipe writer(FIFO_PATH, Kernel::IOMode::WRITE, 64);
+		const std::string frame = std::string("\x05\x00", 2) + "C" + "AB-CD";
+
+		std::vector<PipeMessage> messages;
+		if (write(writer.getFd(), frame.data(), 4) != 4) fail("raw write");
+		usleep(10 * 1000);
+		reader.receiveMessages(messages);
+		if (!messages.empty()) fail("partial frame returned as a message");
+
+		if (write(writer.getFd(), frame.data() + 4, frame.size() - 4) != (ssize_t)frame.size() - 4) fail("raw write");
+		usleep(10 * 1000);
+		reader.receiveMessages(messages);
+		if (messages.size() != 1 || messages[0].getType() != PipeMessage::RFIDCard || messages[0].getData() != "AB-CD")
+		{
+			fail("split frame not reassembled");
+		}
+	}
+
+	unlink(FIFO_PATH.c_str());
+
+	return testResult();
+}
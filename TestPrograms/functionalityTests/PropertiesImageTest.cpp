@@ -0,0 +1,159 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "propertiesclass.h"
+#include "propertiesimage.h"
+#include "TestCheck.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+// Round trip of every Properties field through a config image, plus rejection of corrupted,
+// truncated and stale images. Writes PropertiesImageTest.bin in the current directory.
+// Must be run from the directory containing config.xml.
+
+static const std::string IMAGE_PATH = "PropertiesImageTest.bin";
+
+/// Distinct value for every field, so a swapped or skipped field is detected
+static Properties makeProperties()
+{
+	Properties properties;
+	unsigned int counter = 1;
+
+#define FILL_UINT(NAME) properties.NAME = 1000u + counter++;
+#define FILL_INT(NAME) properties.NAME = -(int)(counter++);
+#define FILL_STRING(NAME) properties.NAME = std::string(#NAME) + " " + std::to_string(counter++);
+#define FILL_DOOR_UINT(NAME) door.NAME = 1000u + counter++;
+#define FILL_DOOR_STRING(NAME) door.NAME = std::string(#NAME) + " " + std::to_string(counter++);
+#define FILL_DOOR_LIST(NAME) \
+	for (int i = 0; i < 3; ++i) \
+	{ \
+		DoorProperties door; \
+		PROPERTIES_IMAGE_DOOR_FIELDS(FILL_DOOR_UINT, FILL_DOOR_STRING) \
+		properties.NAME.push_back(door); \
+	}
+	PROPERTIES_IMAGE_FIELDS(FILL_UINT, FILL_INT, FILL_STRING, FILL_DOOR_LIST)
+#undef FILL_UINT
+#undef FILL_INT
+#undef FILL_STRING
+#undef FILL_DOOR_UINT
+#undef FILL_DOOR_STRING
+#undef FILL_DOOR_LIST
+
+	properties.LCD_DEFAULT_IDLE_MESSAGE = std::string("Idle\0message", 12);
+	properties.LOG_FILE_OLD_SUFFIX = "";
+
+	return properties;
+}
+
+static bool equal(const Properties& a, const Properties& b)
+{
+	bool same = true;
+
+#define COMPARE_FIELD(NAME) if (a.NAME != b.NAME) { same = false; std::cout << "Field differs: " #NAME << std::endl; }
+	PROPERTIES_IMAGE_FIELDS(COMPARE_FIELD, COMPARE_FIELD, COMPARE_FIELD, COMPARE_FIELD)
+#undef COMPARE_FIELD
+
+	return same;
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+int main()
+{
+	const Properties original = makeProperties();
+	const PropertiesImage::Source source{ 1234567890123456789LL, 4242 };
+
+	check(PropertiesImage::Write(IMAGE_PATH, original, source), "image not written");
+
+	Properties decoded;
+	check(PropertiesImage::Read(IMAGE_PATH, source, decoded), "valid image rejected");
+	check(equal(original, decoded), "round trip changed fields");
+
+	// The settings processes actually start with: parsed from config.xml and decoded over different values
+	const Properties parsed = GlobalProperties::Parse();
+	check(PropertiesImage::Write(IMAGE_PATH, parsed, source), "image of config.xml not written");
+	Properties fromImage = makeProperties();
+	check(PropertiesImage::Read(IMAGE_PATH, source, fromImage), "image of config.xml rejected");
+	check(equal(parsed, fromImage), "round trip of config.xml changed fields");
+	check(PropertiesImage::Write(IMAGE_PATH, original, source), "image not rewritten");
+
+	PropertiesImage::Source edited = source;
+	edited.modificationTime_ns += 1;
+	check(!PropertiesImage::Read(IMAGE_PATH, edited, decoded), "image accepted after config.xml modification time changed");
+
+	edited = source;
+	edited.size += 1;
+	check(!PropertiesImage::Read(IMAGE_PATH, edited, decoded), "image accepted after config.xml size changed");
+
+	const std::string image = readFile(IMAGE_PATH);
+
+	for (size_t position = 0; position < image.size(); position += 7)
+	{
+		std::string corrupted = image;
+		corrupted[position] ^= 0x20;
+		writeFile(IMAGE_PATH, corrupted);
+		if (PropertiesImage::Read(IMAGE_PATH, source, decoded))
+		{
+			check(false, "image with flipped byte " + std::to_string(position) + " accepted");
+			break;
+		}
+	}
+
+	writeFile(IMAGE_PATH, image.substr(0, image.size() - 1));
+	check(!PropertiesImage::Read(IMAGE_PATH, source, decoded), "truncated image accepted");
+
+	writeFile(IMAGE_PATH, image + "x");
+	check(!PropertiesImage::Read(IMAGE_PATH, source, decoded), "image with trailing data accepted");
+
+	unlink(IMAGE_PATH.c_str());
+	check(!PropertiesImage::Read(IMAGE_PATH, source, decoded), "missing image accepted");
+
+	// Cost of loading the image, to compare with the startup time reported by GlobalPropertiesBenchmark
+	PropertiesImage::Write(IMAGE_PATH, original, source);
+	const int ITERATIONS = 1000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		PropertiesImage::Read(IMAGE_PATH, source, decoded);
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Image load: " << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / 1000.0 / ITERATIONS
+		<< " us (" << image.size() << " bytes)" << std::endl;
+	unlink(IMAGE_PATH.c_str());
+
+	return testResult();
+}
@@ -0,0 +1,228 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "MockGPIO_Port.hpp"
+#include "PatternSequencer.hpp"
+#include "SignalPattern.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Plays signal patterns on a mock GPIO port and checks the parser, the timing of every edge against the
+// pattern, preemption and queueing by priority, and that Play() does not block its caller.
+// Usage: SignalSequencerTest [TOLERANCE_MS]
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned int BUZZER_PIN = 20;
+const unsigned int DOOR_PIN = 21;
+const unsigned int LED_PIN = 16;
+
+static double maxEdgeError_ms = 0;
+
+static SignalPattern pattern(const std::string& text, unsigned int priority)
+{
+	SignalPattern parsed;
+	std::string error;
+	if (!SignalPattern::Parse(text, priority, parsed, error))
+	{
+		check(false, "\"" + text + "\" rejected: " + error);
+	}
+	return parsed;
+}
+
+static double since_ms(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct ExpectedEdge
+{
+	unsigned int pinBCM;
+	bool high;
+	double at_ms;
+};
+
+/// Compares recorded edges with `expected`, with times relative to `start`
+static void checkEdges(MockGPIO_Port& gpio, Clock::time_point start, const std::vector<ExpectedEdge>& expected, double tolerance_ms, const std::string& name)
+{
+	const std::vector<MockGPIO_Port::Edge> edges = gpio.getEdges();
+	if (edges.size() != expected.size())
+	{
+		check(false, name + ": " + std::to_string(edges.size()) + " edges instead of " + std::to_string(expected.size()));
+		return;
+	}
+
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		const double at_ms = std::chrono::duration<double, std::milli>(edges[i].time - start).count();
+		const double error_ms = std::fabs(at_ms - expected[i].at_ms);
+		maxEdgeError_ms = std::max(maxEdgeError_ms, error_ms);
+
+		check(edges[i].pinBCM == expected[i].pinBCM && edges[i].high == expected[i].high,
+			name + ": edge " + std::to_string(i) + " on the wrong pin or level");
+		check(error_ms <= tolerance_ms,
+			name + ": edge " + std::to_string(i) + " at " + std::to_string(at_ms) + " ms instead of " + std::to_string(expected[i].at_ms) + " ms");
+	}
+}
+
+static void testParser()
+{
+	SignalPattern parsed;
+	std::string error;
+
+	check(SignalPattern::Parse("buzzer+led:50  -:50\tbuzzer:250 door:3000", 2, parsed, error), "valid pattern rejected: " + error);
+	check(parsed.steps.size() == 4 && parsed.priority == 2, "wrong number of steps");
+	check(parsed.steps.size() == 4 && parsed.steps[0].outputs == (SignalPattern::BUZZER | SignalPattern::LED) && parsed.steps[1].outputs == 0
+		&& parsed.steps[3].outputs == SignalPattern::DOOR, "wrong outputs");
+	check(parsed.Duration_ms() == 3350, "wrong duration");
+
+	const char* invalid[] = { "", "   ", "buzzer", "buzzer:", ":50", "horn:50", "buzzer+:50", "+buzzer:50", "buzzer:0", "buzzer:-5", "buzzer:5x", "buzzer:60001", "buzzer:99999999999" };
+	for (const char* text : invalid)
+	{
+		check(!SignalPattern::Parse(text, 0, parsed, error), std::string("invalid pattern \"") + text + "\" accepted");
+	}
+}
+
+static void testTiming(double tolerance_ms)
+{
+	MockGPIO_Port gpio;
+	PatternSequencer sequencer(&gpio);
+	sequencer.AddOutput(SignalPattern::BUZZER, BUZZER_PIN, true, I_GPIO_Port::Pull::DOWN);
+	sequencer.AddOutput(SignalPattern::LED, LED_PIN, true, I_GPIO_Port::Pull::DOWN);
+	gpio.clearEdges();
+
+	const SignalPattern success = pattern("buzzer+led:50 led:50 buzzer+led:50", 1);
+
+	const Clock::time_point start = Clock::now();
+	check(sequencer.Play(success) == PatternSequencer::PlayResult::STARTED, "pattern not started on an idle sequencer");
+	const double blocked_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+	check(sequencer.WaitUntilIdle(1000), "pattern did not finish");
+	checkEdges(gpio, start, {
+		{ BUZZER_PIN, true, 0 }, { LED_PIN, true, 0 },
+		{ BUZZER_PIN, false, 50 },
+		{ BUZZER_PIN, true, 100 },
+		{ BUZZER_PIN, false, 150 }, { LED_PIN, false, 150 } }, tolerance_ms, "success pattern");
+
+	// The LED stays lit across the steps, so it must not be written again
+	check(gpio.getWriteCount() == 6, "outputs written although their level did not change");
+
+	std::cout << "Play() blocked the caller for " << blocked_us << " us, a blocking Buzzer blocked it for " << success.Duration_ms() << " ms" << std::endl;
+	check(blocked_us < 1000, "Play() blocks");
+}
+
+static void testPriorities(double tolerance_ms)
+{
+	MockGPIO_Port gpio;
+	PatternSequencer sequencer(&gpio);
+	sequencer.AddOutput(SignalPattern::BUZZER, BUZZER_PIN, true, I_GPIO_Port::Pull::DOWN);
+	sequencer.AddOutput(SignalPattern::LED, LED_PIN, true, I_GPIO_Port::Pull::DOWN);
+	gpio.clearEdges();
+
+	// Equal priority preempts: the long tone is cut off when the second pattern arrives
+	Clock::time_point start = Clock::now();
+	sequencer.Play(pattern("buzzer:500", 1));
+	std::this_thread::sleep_until(start + std::chrono::milliseconds(20));
+	// Measured, so oversleeping of this thread is not counted as an error of the sequencer
+	const double preempted_ms = since_ms(start);
+	check(sequencer.Play(pattern("led:30", 1)) == PatternSequencer::PlayResult::STARTED, "equal priority did not preempt");
+	check(sequencer.WaitUntilIdle(1000), "preempting pattern did not finish");
+	checkEdges(gpio, start, {
+		{ BUZZER_PIN, true, 0 },
+		{ BUZZER_PIN, false, preempted_ms }, { LED_PIN, true, preempted_ms },
+		{ LED_PIN, false, preempted_ms + 30 } }, tolerance_ms, "preemption");
+
+	// Lower priority waits and starts exactly when the higher one ends
+	gpio.clearEdges();
+	start = Clock::now();
+	sequencer.Play(pattern("buzzer:60", 2));
+	check(sequencer.Play(pattern("led:20", 0)) == PatternSequencer::PlayResult::QUEUED, "lower priority not queued");
+	check(sequencer.Play(pattern("led:20 buzzer+led:20", 1)) == PatternSequencer::PlayResult::QUEUED, "lower priority not queued");
+	check(sequencer.WaitUntilIdle(1000), "queued patterns did not finish");
+	// Priority 1 goes before the earlier priority 0 pattern; the LED stays lit from 60 to 120 ms
+	checkEdges(gpio, start, {
+		{ BUZZER_PIN, true, 0 },
+		{ BUZZER_PIN, false, 60 }, { LED_PIN, true, 60 },
+		{ BUZZER_PIN, true, 80 },
+		{ BUZZER_PIN, false, 100 },
+		{ LED_PIN, false, 120 } }, tolerance_ms, "queueing");
+
+	// A full queue keeps the highest priorities
+	sequencer.Play(pattern("buzzer:100", 5));
+	for (size_t i = 0; i < PatternSequencer::MAX_QUEUED; ++i)
+	{
+		check(sequencer.Play(pattern("led:1", 1)) == PatternSequencer::PlayResult::QUEUED, "pattern not queued");
+	}
+	check(sequencer.Play(pattern("led:1", 1)) == PatternSequencer::PlayResult::DROPPED, "pattern queued beyond MAX_QUEUED");
+	check(sequencer.Play(pattern("led:1", 2)) == PatternSequencer::PlayResult::QUEUED, "higher priority did not displace a queued pattern");
+
+	sequencer.Stop();
+	check(sequencer.WaitUntilIdle(100), "Stop() did not stop the sequencer");
+	check(!gpio.isHigh(BUZZER_PIN) && !gpio.isHigh(LED_PIN), "outputs active after Stop()");
+}
+
+static void testActiveLow(double tolerance_ms)
+{
+	MockGPIO_Port gpio;
+	{
+		PatternSequencer sequencer(&gpio);
+		check(!sequencer.AddOutput(SignalPattern::DOOR, 100, false, I_GPIO_Port::Pull::UP), "invalid pin accepted");
+		sequencer.AddOutput(SignalPattern::DOOR, DOOR_PIN, false, I_GPIO_Port::Pull::UP);
+		check(gpio.isHigh(DOOR_PIN), "active low output not idle after AddOutput()");
+
+		// Outputs which were not added are ignored, retriggering restarts the pattern
+		gpio.clearEdges();
+		const Clock::time_point start = Clock::now();
+		sequencer.Play(pattern("door+buzzer:40", 0));
+		std::this_thread::sleep_until(start + std::chrono::milliseconds(20));
+		const double retriggered_ms = since_ms(start);
+		sequencer.Play(pattern("door+buzzer:40", 0));
+		check(sequencer.WaitUntilIdle(1000), "door pattern did not finish");
+		checkEdges(gpio, start, { { DOOR_PIN, false, 0 }, { DOOR_PIN, true, retriggered_ms + 40 } }, tolerance_ms, "retriggered door");
+
+		sequencer.Play(pattern("door:1000", 0));
+	}
+	check(gpio.isHigh(DOOR_PIN), "door left open by the destructor");
+}
+
+int main(int argc, char* argv[])
+{
+	const double tolerance_ms = argc > 1 ? std::stod(argv[1]) : 5.0;
+
+	testParser();
+	testTiming(tolerance_ms);
+	testPriorities(tolerance_ms);
+	testActiveLow(tolerance_ms);
+
+	std::cout << "Largest edge timing error: " << maxEdgeError_ms << " ms (tolerance " << tolerance_ms << " ms)" << std::endl;
+
+	return testResult();
+}
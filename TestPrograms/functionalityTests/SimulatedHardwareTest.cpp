@@ -0,0 +1,260 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include"SimulatedHardwareBackend.hpp"
+#include"DoorDeviceLoop.hpp"
+#include"HD44780_Display.hpp"
+#include"KeypadEvent.hpp"
+#include"TestCheck.hpp"
+
+#include<chrono>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<sstream>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include<poll.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+
+// Drives two doors of SimulatedHardwareBackend through DoorDeviceLoop, like HardwareDaemon does with
+// Backend "simulated": a scenario with PIN entries and a card, the control socket, and a burst of key
+// entries to report the input rate the simulation sustains. Must be run from the directory containing config.xml.
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string SOCKET_PATH = "SimulatedHardwareTest.sock";
+static const unsigned int BURST_ENTRIES = 2000;
+
+/// Reading ends of the pipes of one door (the InputController side)
+struct DoorPipes
+{
+	DoorProperties properties;
+	std::unique_ptr<Pipe> keypadIn;
+	std::unique_ptr<Pipe> keypadOut;
+	std::unique_ptr<Pipe> rfidIn;
+	std::unique_ptr<Pipe> rfidOut;
+};
+
+/// Next message of `door`, from its keypad pipe or, if `fromRFID`, its RFID pipe
+static bool receive(DoorPipes& door, bool fromRFID, PipeMessage& message, int timeout_ms = 2000)
+{
+	Pipe& pipe = fromRFID ? *door.rfidIn : *door.keypadIn;
+	pollfd fd = { pipe.getFd(), POLLIN, 0 };
+
+	const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (true)
+	{
+		if (pipe.receiveMessage(message)) return true;
+
+		int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		if (remaining_ms < 0 || poll(&fd, 1, remaining_ms) <= 0) return false;
+	}
+}
+
+static bool receiveKeys(DoorPipes& door, const std::string& expected)
+{
+	PipeMessage message;
+	return receive(door, false, message) && KeypadEvent::fromPipeMessage(message).getData() == expected;
+}
+
+static HardwareScenario parse(const std::string& text)
+{
+	HardwareScenario scenario;
+	std::istringstream input(text);
+	std::string error;
+	check(HardwareScenario::Parse(input, scenario, error), "scenario rejected: " + error);
+	return scenario;
+}
+
+/// Sends `commands` to the control socket and returns the replies, one per line
+static std::vector<std::string> control(const std::string& commands, size_t replyCount)
+{
+	std::vector<std::string> replies;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	SOCKET_PATH.copy(address.sun_path, SOCKET_PATH.size());
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+	{
+		check(false, "cannot connect to the control socket");
+		if (fd >= 0) close(fd);
+		return replies;
+	}
+
+	if (write(fd, commands.data(), commands.size()) != (ssize_t)commands.size()) check(false, "control command not sent");
+
+	std::string input;
+	char buffer[256];
+	while (replies.size() < replyCount)
+	{
+		pollfd pfd = { fd, POLLIN, 0 };
+		ssize_t received = poll(&pfd, 1, 2000) > 0 ? read(fd, buffer, sizeof(buffer)) : 0;
+		if (received <= 0) break;
+
+		input.append(buffer, received);
+		size_t lineEnd;
+		while ((lineEnd = input.find('\n')) != std::string::npos)
+		{
+			replies.push_back(input.substr(0, lineEnd));
+			input.erase(0, lineEnd + 1);
+		}
+	}
+
+	close(fd);
+	return replies;
+}
+
+int main()
+{
+	std::vector<DoorPipes> doors(2);
+	doors[0].properties = DoorProperties{ 1, "", "", 20, 21, DoorProperties::NO_PIN, 0x27 };
+	doors[1].properties = DoorProperties{ 7, "", "", 22, 23, DoorProperties::NO_PIN, 0x26 };
+
+	std::vector<DoorProperties> doorList;
+	for (DoorPipes& door : doors) doorList.push_back(door.properties);
+
+	SimulatedHardwareBackend backend(doorList, "", SOCKET_PATH);
+	DoorDeviceLoop devices(CardReaderSettings{ 10, 250, 200, 50 }, 1000);
+
+	for (DoorPipes& door : doors)
+	{
+		const std::string id = std::to_string(door.properties.ID);
+		const std::string keypadPipe = "SimulatedHardwareTest.keypad." + id;
+		const std::string rfidPipe = "SimulatedHardwareTest.rfid." + id;
+
+		// Reading ends first, so opening the writing ends does not block
+		door.keypadIn.reset(new Pipe(keypadPipe, Kernel::IOMode::READ_NONBLOCKING, 64));
+		door.rfidIn.reset(new Pipe(rfidPipe, Kernel::IOMode::READ_NONBLOCKING, 64));
+		door.keypadOut.reset(new Pipe(keypadPipe, Kernel::IOMode::WRITE, 64));
+		door.rfidOut.reset(new Pipe(rfidPipe, Kernel::IOMode::WRITE, 64));
+
+		devices.AddDoor(backend.OpenKeypad(door.properties, door.keypadOut.get(), NulLogger::getInstance()),
+			backend.OpenCardReader(door.properties, NulLogger::getInstance()), door.rfidOut.get());
+	}
+
+	std::atomic<bool> stop{ false };
+	std::thread deviceThread([&]()
+	{
+		while (!stop)
+		{
+			devices.RunOnce(100);
+		}
+	});
+
+	backend.Start();
+
+	// Scenario: PIN entry at door 1, card at door 7 and PIN entries at door 7 paced by the timeline
+	HardwareScenario scenario = parse(
+		"# PIN entry, then a card\n"
+		"keys 1 *1234E\n"
+		"wait 10\n"
+		"card 7 CARD-7 50\n"
+		"wait 100\n"
+		"repeat 2\n"
+		"  repeat 5\n"
+		"    keys 7 *7E\n"
+		"    wait 4\n"
+		"  end\n"
+		"end\n");
+
+	Clock::time_point start = Clock::now();
+	check(backend.Play(scenario), "scenario not played to the end");
+	const double scenario_ms = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+
+	PipeMessage message;
+	check(receiveKeys(doors[0], "*1234"), "PIN entry of the scenario not received at door 1");
+	check(receive(doors[1], true, message) && message.getType() == PipeMessage::RFIDCard && message.getData() == "CARD-7",
+		"card of the scenario not received at door 7");
+	for (int i = 0; i < 10; ++i)
+	{
+		check(receiveKeys(doors[1], "*7"), "repeated PIN entry " + std::to_string(i) + " not received at door 7");
+	}
+	// 10 + 100 + 10 * 4 ms of waits on an absolute timeline
+	check(scenario_ms >= 150 && scenario_ms < 250, "scenario took " + std::to_string(scenario_ms) + " ms instead of 150 ms");
+
+	// Control socket, with the LCD and GPIO of door 1 driven like the indicators thread would
+	HD44780_Display display(backend.OpenLCD_Device(doors[0].properties, 1));
+	display.Show("Door 1");
+	display.WaitUntilRendered(1000);
+	backend.getGPIO()->SetOutput(20, I_GPIO_Port::Pull::UP);
+
+	std::vector<std::string> replies = control("keys 1 9E\ncard 1 SOCKET-CARD 0\nlcd 1\ngpio 20\nlcd 99\nrepeat 3\n", 6);
+	check(replies.size() == 6, "control socket replied " + std::to_string(replies.size()) + " times to 6 commands");
+	if (replies.size() == 6)
+	{
+		check(replies[0] == "OK" && replies[1] == "OK", "keys and card commands not accepted");
+		check(replies[2].compare(0, 9, "OK Door 1") == 0, "lcd reply '" + replies[2] + "' does not show the LCD text");
+		check(replies[3] == "OK 1", "gpio reply '" + replies[3] + "' does not show the pin level");
+		check(replies[4].compare(0, 5, "ERROR") == 0 && replies[5].compare(0, 5, "ERROR") == 0, "invalid commands accepted");
+	}
+	check(receiveKeys(doors[0], "9"), "key entry from the control socket not received");
+	check(receive(doors[0], true, message) && message.getData() == "SOCKET-CARD", "card from the control socket not received");
+	replies = control("remove 1\n", 1);
+	check(replies.size() == 1 && replies[0] == "OK", "remove command not accepted");
+
+	// Burst: key entries as fast as the keypad and pipes take them
+	std::ostringstream burstText;
+	burstText << "repeat " << BURST_ENTRIES << "\nkeys 7 *42E\nend\n";
+	HardwareScenario burst = parse(burstText.str());
+
+	start = Clock::now();
+	std::thread player([&]() { backend.Play(burst); });
+	unsigned int received = 0;
+	while (received < BURST_ENTRIES && receiveKeys(doors[1], "*42")) ++received;
+	const double burst_ms = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1000.0;
+	player.join();
+	check(received == BURST_ENTRIES, "only " + std::to_string(received) + " of " + std::to_string(BURST_ENTRIES) + " burst entries received");
+
+	// Nothing may arrive that was not expected
+	check(!receive(doors[0], false, message, 200) && !receive(doors[1], true, message, 0), "unexpected message after the last event");
+
+	SimulatedHardwareBackend::Stats stats = backend.getStats();
+	std::cout << "Scenario: " << scenario_ms << " ms (150 ms of waits)" << std::endl;
+	std::cout << "Burst: " << received << " key entries in " << burst_ms << " ms, "
+		<< received / burst_ms * 1000.0 << " entries/s" << std::endl;
+	std::cout << "Keys pressed: " << stats.keysPressed << ", cards presented: " << stats.cardsPresented
+		<< ", control commands: " << stats.controlCommands << std::endl;
+
+	backend.Stop();
+	stop = true;
+	devices.Interrupt();
+	deviceThread.join();
+
+	for (DoorPipes& door : doors)
+	{
+		const std::string id = std::to_string(door.properties.ID);
+		unlink(("SimulatedHardwareTest.keypad." + id).c_str());
+		unlink(("SimulatedHardwareTest.rfid." + id).c_str());
+	}
+
+	check(access(SOCKET_PATH.c_str(), F_OK) != 0, "control socket not removed by Stop()");
+
+	return testResult();
+}
@@ -0,0 +1,59 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef TEST_CHECK_HPP
+#define TEST_CHECK_HPP
+
+#include <iostream>
+#include <string>
+
+// Checks shared by the test programs. Every test program is a single translation unit, so each one gets its own counter.
+
+/// Number of failed checks; tests with their own reporting may increment it directly
+static int failures = 0;
+
+/// Counts and prints a failed check, the test continues
+static inline void check(bool condition, const std::string& description)
+{
+	if (!condition)
+	{
+		++failures;
+		std::cout << "FAILED: " << description << std::endl;
+	}
+}
+
+/// Prints the verdict and returns the exit code of the test program
+static inline int testResult()
+{
+	if (failures != 0)
+	{
+		std::cout << "FAILED: " << failures << " checks." << std::endl;
+		return -1;
+	}
+
+	std::cout << "PASSED" << std::endl;
+	return 0;
+}
+
+#endif
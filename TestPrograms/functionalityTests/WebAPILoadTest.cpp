@@ -0,0 +1,303 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessLogReader.hpp"
+#include "HttpServer.hpp"
+#include "StatusService.hpp"
+#include "Tables.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Endpoints of WebAPIController against a scratch database, then a load test: CLIENTS keep-alive
+// clients hammer /logs, /metrics and /status on loopback while a simulated door writes access logs
+// the way the gateway does. The door's p99 write latency under load must stay below the bound.
+//   WebAPILoadTest [MAX_DOOR_P99_MS]
+// Writes WebAPILoadTest.db (+ -wal, -shm) in the current directory.
+
+static const std::string DATABASE_PATH = "WebAPILoadTest.db";
+static const int SEEDED_LOGS = 1000;
+static const int CLIENTS = 16;
+static const int DOOR_WRITES = 200;
+static const auto DOOR_INTERVAL = std::chrono::milliseconds(5);
+
+/// Blocking keep-alive client
+class Client
+{
+public:
+	explicit Client(unsigned int port) : m_fd(socket(AF_INET, SOCK_STREAM, 0))
+	{
+		sockaddr_in address;
+		std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(static_cast<uint16_t>(port));
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+	}
+
+	~Client() { if (m_fd >= 0) close(m_fd); }
+
+	bool isConnected() const { return m_fd >= 0; }
+
+	bool sendRaw(const std::string& data)
+	{
+		return m_fd >= 0 && send(m_fd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+	}
+
+	/// Reads one response. Returns the status, 0 if the connection failed.
+	unsigned int receive(std::string& body)
+	{
+		size_t headerEnd;
+		while ((headerEnd = m_buffer.find("\r\n\r\n")) == std::string::npos)
+		{
+			if (!fill()) return 0;
+		}
+
+		const std::string headers = m_buffer.substr(0, headerEnd);
+		const size_t lengthPosition = headers.find("Content-Length: ");
+		const size_t length = lengthPosition == std::string::npos ? 0 : std::stoul(headers.substr(lengthPosition + 16));
+		while (m_buffer.size() < headerEnd + 4 + length)
+		{
+			if (!fill()) return 0;
+		}
+
+		body = m_buffer.substr(headerEnd + 4, length);
+		m_buffer.erase(0, headerEnd + 4 + length);
+		return static_cast<unsigned int>(std::stoul(headers.substr(9, 3)));
+	}
+
+	unsigned int get(const std::string& target, std::string& body)
+	{
+		if (!sendRaw("GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n")) return 0;
+		return receive(body);
+	}
+
+private:
+	bool fill()
+	{
+		char buffer[8192];
+		ssize_t received = recv(m_fd, buffer, sizeof(buffer), 0);
+		if (received <= 0) return false;
+		m_buffer.append(buffer, received);
+		return true;
+	}
+
+	int m_fd;
+	std::string m_buffer;
+};
+
+static int64_t jsonNumber(const std::string& json, const std::string& key)
+{
+	const size_t position = json.find("\"" + key + "\":");
+	if (position == std::string::npos) return -1;
+	const std::string value = json.substr(position + key.size() + 3);
+	return value.compare(0, 4, "null") == 0 ? 0 : std::stoll(value);
+}
+
+static size_t countOf(const std::string& text, const std::string& pattern)
+{
+	size_t count = 0;
+	for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1)) ++count;
+	return count;
+}
+
+static void createDatabase(Database& database, LogTable& logTable)
+{
+	const Properties& properties = GlobalProperties::Get();
+	database.Execute("CREATE TABLE " + properties.LOG_TABLE_NAME + "("
+		+ properties.LOG_TABLE_ID_COLUMN_NAME + " INTEGER PRIMARY KEY AUTOINCREMENT, "
+		+ properties.LOG_TABLE_TIMESTAMP_COLUMN_NAME + " TEXT, "
+		+ properties.LOG_TABLE_USER_ID_COLUMN_NAME + " INTEGER, "
+		+ properties.LOG_TABLE_AUTH_METHOD_COLUMN_NAME + " TEXT, "
+		+ properties.LOG_TABLE_COMMAND_ID_COLUMN_NAME + " INTEGER);", nullptr);
+
+	logTable.initialize();
+
+	database.Execute("BEGIN;", nullptr);
+	for (int i = 1; i <= SEEDED_LOGS; ++i)
+	{
+		logTable.CreateLog({ "2021-03-11T08:00:00.000", static_cast<unsigned int>(i % 7), i % 2 ? "PIN" : "RFID", 1 });
+	}
+	database.Execute("COMMIT;", nullptr);
+}
+
+static void testEndpoints(unsigned int port)
+{
+	Client client(port);
+	check(client.isConnected(), "cannot connect");
+	std::string body;
+
+	check(client.get("/status", body) == 200 && body.find("\"processes\":[") != std::string::npos
+		&& body.find("\"available\":true") != std::string::npos, "/status");
+
+	// The server itself publishes metrics, so its own segment is always there when publishing is on
+	if (MetricsRegistry::Process().isOpen())
+	{
+		check(client.get("/metrics", body) == 200 && body.find("# TYPE nfcdooraccess_webapi_requests counter") != std::string::npos
+			&& body.find("nfcdooraccess_webapi_request_ns_bucket{") != std::string::npos, "/metrics");
+	}
+
+	// Walk every page and check the cursor neither skips nor repeats entries
+	int64_t beforeId = 0;
+	int64_t previousId = SEEDED_LOGS + 1;
+	int total = 0;
+	bool ordered = true;
+	do
+	{
+		check(client.get("/logs?limit=300" + (beforeId != 0 ? "&before_id=" + std::to_string(beforeId) : std::string()), body) == 200, "/logs page");
+		for (size_t position = body.find("{\"id\":"); position != std::string::npos; position = body.find("{\"id\":", position + 1))
+		{
+			const int64_t id = std::stoll(body.substr(position + 6));
+			ordered &= id < previousId;
+			previousId = id;
+			++total;
+		}
+		beforeId = jsonNumber(body, "next_before_id");
+	} while (beforeId > 0 && total <= SEEDED_LOGS);
+	check(total == SEEDED_LOGS && ordered, "paging returned " + std::to_string(total) + " entries, ordered " + std::to_string(ordered));
+
+	// Seeded user ids are i % 7, so user 3 has entries 3, 10, 17, ...
+	check(client.get("/logs?user_id=3&limit=500", body) == 200 && countOf(body, "\"user_id\":3") == countOf(body, "{\"id\":")
+		&& countOf(body, "{\"id\":") == static_cast<size_t>((SEEDED_LOGS - 3) / 7 + 1), "/logs user filter");
+	check(client.get("/logs", body) == 200 && countOf(body, "{\"id\":") == DEFAULT_LOG_ROWS_LIMIT, "/logs default limit");
+
+	check(client.get("/logs?limit=0", body) == 400, "limit 0 accepted");
+	check(client.get("/logs?limit=100000", body) == 400, "limit above MAX_LOG_ROWS_LIMIT accepted");
+	check(client.get("/logs?before_id=abc", body) == 400, "malformed before_id accepted");
+	check(client.get("/no/such/page", body) == 404, "unknown path not 404");
+
+	check(client.sendRaw("POST /status HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}") && client.receive(body) == 405, "POST /status not 405");
+
+	// Two pipelined requests in one segment get two responses in order
+	check(client.sendRaw("GET /logs?limit=1 HTTP/1.1\r\n\r\nGET /logs?limit=2 HTTP/1.1\r\n\r\n")
+		&& client.receive(body) == 200 && countOf(body, "{\"id\":") == 1
+		&& client.receive(body) == 200 && countOf(body, "{\"id\":") == 2, "pipelined requests");
+
+	Client malformed(port);
+	check(malformed.sendRaw("NONSENSE\r\n\r\n") && malformed.receive(body) == 400, "malformed request not 400");
+
+	Client oversized(port);
+	check(oversized.sendRaw("GET / HTTP/1.1\r\nX-Filler: " + std::string(HttpServer::MAX_REQUEST_SIZE, 'x') + "\r\n\r\n")
+		&& oversized.receive(body) == 431, "oversized headers not 431");
+}
+
+/// Writes DOOR_WRITES access logs like the gateway's log thread and returns the p99 write latency in us
+static double runDoor(LogTable& logTable)
+{
+	std::vector<double> latencies_us;
+	for (int i = 0; i < DOOR_WRITES; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		logTable.CreateLog({ "2021-03-11T09:00:00.000", 42, "RFID", 1 });
+		latencies_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		std::this_thread::sleep_for(DOOR_INTERVAL);
+	}
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	return latencies_us[latencies_us.size() * 99 / 100];
+}
+
+int main(int argc, char** argv)
+{
+	const double MAX_DOOR_P99_MS = argc > 1 ? std::stod(argv[1]) : 20.0;
+
+	for (const char* suffix : { "", "-wal", "-shm" })
+	{
+		unlink((DATABASE_PATH + suffix).c_str());
+	}
+
+	// The gateway's connection: WAL mode is switched on by Database itself
+	Database database(DATABASE_PATH);
+	LogTable logTable(&database);
+	createDatabase(database, logTable);
+
+	AccessLogReader logReader(DATABASE_PATH);
+	StatusService statusService(GlobalProperties::Get().METRICS_NAME, &logReader);
+	HttpServer server("127.0.0.1", 0, CLIENTS + 4, nullptr);
+	statusService.RegisterRoutes(server);
+	std::thread serverThread(&HttpServer::Run, &server);
+
+	testEndpoints(server.getPort());
+
+	const double idleP99_us = runDoor(logTable);
+
+	std::atomic<bool> stop(false);
+	std::atomic<long> requests(0);
+	std::atomic<long> errors(0);
+	std::vector<std::thread> clients;
+	for (int i = 0; i < CLIENTS; ++i)
+	{
+		clients.emplace_back([&, i]()
+		{
+			static const char* const TARGETS[] = { "/logs?limit=100", "/metrics", "/status", "/logs?limit=500&user_id=3" };
+			Client client(server.getPort());
+			std::string body;
+			for (unsigned int n = i; !stop.load(); ++n)
+			{
+				if (client.get(TARGETS[n % 4], body) == 200) ++requests;
+				else { ++errors; break; }
+			}
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	const double loadedP99_us = runDoor(logTable);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	stop = true;
+	for (std::thread& client : clients) client.join();
+	server.Stop();
+	serverThread.join();
+
+	std::cout << "Door log write p99: " << idleP99_us << " us idle, " << loadedP99_us << " us with " << CLIENTS << " clients" << std::endl;
+	std::cout << "Served " << requests.load() << " requests in " << seconds << " s (" << static_cast<long>(requests.load() / seconds) << " req/s), "
+		<< errors.load() << " errors" << std::endl;
+
+	check(errors.load() == 0, "clients got errors under load");
+	check(requests.load() > CLIENTS, "server did not keep up with clients");
+	check(loadedP99_us < MAX_DOOR_P99_MS * 1000.0, "door write p99 under load above " + std::to_string(MAX_DOOR_P99_MS) + " ms");
+
+	for (const char* suffix : { "", "-wal", "-shm" })
+	{
+		unlink((DATABASE_PATH + suffix).c_str());
+	}
+
+	return testResult();
+}
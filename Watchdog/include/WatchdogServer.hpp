@@ -29,6 +29,7 @@
 #include "Timer.hpp"
 #include "ProcessManager.hpp"
 #include "SharedMemory.hpp"
+#include "Metrics.hpp"
 
 #include<list>
 
@@ -210,6 +211,10 @@ private:
 	std::list<WatchdogUnit> m_units;
 	SharedMemory<WatchdogUnitControlBlock> m_smhUnitControls;
 
+	MetricGauge m_unitsGauge;				// "watchdog.units" - registered units
+	MetricCounter m_missedPeriodCounter;	// "watchdog.missed_periods" - periods in which a unit did not kick, each costs one TTL
+	MetricCounter m_expirationCounter;		// "watchdog.expirations" - units which ran out of TTL
+
 	// volatile std::list<Timer*> m_expired_pTimers;
 };
 
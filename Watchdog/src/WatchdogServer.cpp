@@ -43,7 +43,10 @@ WatchdogServer::WatchdogServer(const std::string name, ProcessManager * pProcess
 	m_period_us(100 * Time::ms_to_us),
 	m_pProcessManager(pProcessManager),
 	m_timeoutCallbackFunctor(this, &WatchdogServer::MarkTimerExpired),
-	m_smhUnitControls(name + ".shm", initialShmCapacity, pLogger)
+	m_smhUnitControls(name + ".shm", initialShmCapacity, pLogger),
+	m_unitsGauge(MetricsRegistry::Process().getGauge("watchdog.units")),
+	m_missedPeriodCounter(MetricsRegistry::Process().getCounter("watchdog.missed_periods")),
+	m_expirationCounter(MetricsRegistry::Process().getCounter("watchdog.expirations"))
 {
 	if (m_pLogger == nullptr)
 	{
@@ -265,6 +268,7 @@ void WatchdogServer::MarkTimerExpired(void* pExpiredTimer_voidptr)
 		return;
 	}
 
+	m_missedPeriodCounter.Increment();
 	int RemainingTTL = position->DecrementAndReturnTTL();
 
 	if (RemainingTTL <= 0)
@@ -280,6 +284,8 @@ void WatchdogServer::MarkTimerExpired(void* pExpiredTimer_voidptr)
 
 void WatchdogServer::HandleUnitExpiration(unitsIterator& expiredUnitIter)
 {
+	m_expirationCounter.Increment();
+
 	if (expiredUnitIter->getActionOnFailure() == enuActionOnFailure::RESET_ONLY)
 	{
 		int processPID = expiredUnitIter->getPID();
@@ -388,6 +394,7 @@ void WatchdogServer::AddNewUnit(WatchdogMessage& request)
 			m_pLogger
 		)
 	);
+	m_unitsGauge.Set(m_units.size());
 
 
 
@@ -436,6 +443,7 @@ unitsIterator WatchdogServer::RemoveUnit(unitsIterator& unitIter)
 	m_smhUnitControls[unitToBeErasedIter->getOffset()].Clear();
 
 	m_units.erase(unitToBeErasedIter);
+	m_unitsGauge.Set(m_units.size());
 
 	return unitIter;
 }
@@ -0,0 +1,84 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef ACCESSLOGREADER_HPP
+#define ACCESSLOGREADER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite3.h"
+
+/**
+ * @brief Pages through the access log of the gateway's database on a read-only connection
+ *
+ * The connection is opened with SQLITE_OPEN_READONLY and `query_only`, so it cannot take a write lock,
+ * and the database runs in WAL mode, so readers and the gateway's writer never wait for each other.
+ * Every query is bounded by the page size and walks the log table's primary key, newest first.
+ * Failures are reported to the caller instead of being fatal: the database may not exist yet.
+*/
+class AccessLogReader
+{
+public:
+	/// Row of the log table, fields as in `LogEntry`
+	struct Entry
+	{
+		int64_t m_id;
+		std::string m_timestamp;
+		unsigned int m_userId;
+		std::string m_authMethod;
+		unsigned int m_commandId;
+	};
+
+	explicit AccessLogReader(const std::string& databasePath);
+	~AccessLogReader();
+
+	AccessLogReader(const AccessLogReader&) = delete;
+	AccessLogReader& operator=(const AccessLogReader&) = delete;
+
+	/**
+	 * @brief Reads up to `limit` entries older than `beforeId` (0 for the newest), newest first.
+	 * @param userId Only entries of this user, or all if negative
+	 * @param more Set if older entries exist
+	 * @return false with `error` set if the database cannot be read
+	*/
+	bool Read(int64_t beforeId, unsigned int limit, int64_t userId, std::vector<Entry>& entries, bool& more, std::string& error);
+
+	/// Opens the connection if it is not open yet
+	bool isAvailable(std::string& error);
+
+private:
+	bool open(std::string& error);
+	void closeConnection();
+
+	/// Waiting for a lock only happens while the WAL is reset, which is short
+	static const int BUSY_TIMEOUT_MS = 50;
+
+	std::string m_databasePath;
+	sqlite3* m_pDatabase;
+	sqlite3_stmt* m_pSelectPage;
+};
+
+#endif // ACCESSLOGREADER_HPP
@@ -0,0 +1,103 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef ADMINSERVICE_HPP
+#define ADMINSERVICE_HPP
+
+#include <string>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "BulkImport.hpp"
+#include "HttpServer.hpp"
+#include "MailboxRpc.hpp"
+
+/*
+	Administration endpoints of WebAPIController, served on a Unix socket only:
+
+	POST /admin/import	employees with their complete set of cards and PINs, as text/csv rows
+						`employee,clearance,card,pin` (several rows per employee for several PINs, header
+						optional) or application/json {"employees":[{"name","clearance","cards":[],"pins":[]}]}
+	GET /admin/export	every employee with cards and PINs; ?format=csv|json (default json), same formats
+
+	Every request carries `Authorization: Bearer <key>`, a key made by WebAPIKey. Its SHA-256 is looked up
+	in WebPassTable and the owner's clearance must reach the clearance of the IMPORT or EXPORT command in
+	the commands table (MAX_CLEARANCE for a command not listed there).
+
+	An import is validated here, written to a spool file next to the database and committed by
+	DatabaseGateway's BulkImporter in one transaction (see BulkImport.hpp); the request waits for the
+	gateway's reply. Exports are read on this service's own read-only connection.
+*/
+class AdminService
+{
+public:
+	/// Largest import request, about 100k employees as CSV
+	static const size_t MAX_IMPORT_SIZE = 16 * 1024 * 1024;
+
+	/**
+	 * @param databasePath DB_PATH, read for authorization and exports
+	 * @param pRpc Started client import requests are sent through; other services can share it
+	 * @param gateway Name of DatabaseGateway's mailbox
+	*/
+	AdminService(const std::string& databasePath, MailboxRpc* pRpc, const std::string& gateway, ILogger* pLogger = NulLogger::getInstance());
+	~AdminService();
+
+	AdminService(const AdminService&) = delete;
+	AdminService& operator=(const AdminService&) = delete;
+
+	/// Adds the routes and raises the server's request size limit to MAX_IMPORT_SIZE
+	void RegisterRoutes(HttpServer& server);
+
+	HttpServer::Response Import(const HttpServer::Request& request);
+	HttpServer::Response Export(const HttpServer::Request& request);
+
+	static bool ParseCsv(const std::string& text, std::vector<ImportedEmployee>& employees, std::string& error);
+	static bool ParseJson(const std::string& text, std::vector<ImportedEmployee>& employees, std::string& error);
+	static std::string ToCsv(const std::vector<ImportedEmployee>& employees);
+	static std::string ToJson(const std::vector<ImportedEmployee>& employees);
+
+private:
+	/**
+	 * @brief Checks the request's key against the clearance required for `commandName`
+	 * @param keyHash Set to the SHA-256 of the key
+	 * @return false with `response` set to 401, 403 or 503
+	*/
+	bool authorize(const HttpServer::Request& request, const std::string& commandName, std::string& keyHash, HttpServer::Response& response);
+	bool open(std::string& error);
+	void closeConnection();
+
+	static const int BUSY_TIMEOUT_MS = 50;
+
+	std::string m_databasePath;
+	MailboxRpc* m_pRpc;
+	std::string m_gateway;
+	ILogger* m_pLogger;
+
+	sqlite3* m_pDatabase;
+	sqlite3_stmt* m_pSelectKeyClearance;
+	sqlite3_stmt* m_pSelectCommandClearance;
+};
+
+#endif // ADMINSERVICE_HPP
@@ -0,0 +1,163 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef HTTPSERVER_HPP
+#define HTTPSERVER_HPP
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ILogger.hpp"
+#include "NulLogger.hpp"
+#include "Metrics.hpp"
+
+/*
+	Minimal HTTP/1.1 server for the local status pages.
+
+	One thread polls every connection with non-blocking sockets, so a slow or stalled client costs a
+	file descriptor and nothing else. Requests are parsed from the connection buffer as soon as they
+	are complete (keep-alive and pipelining work), handed to the handler registered for the exact
+	path and method, and the response is queued and written when the socket is ready. Bodies need a
+	Content-Length; chunked requests, HTTP/0.9 and upgrades are refused. Handlers run on the server
+	thread and must therefore be short - they only read shared memory and run bounded queries. The
+	admin instance on its Unix socket is the exception: an import blocks it until the gateway replies.
+*/
+class HttpServer
+{
+public:
+	/// Default limit of headers plus body of one request, see setMaxRequestSize()
+	static const size_t MAX_REQUEST_SIZE = 64 * 1024;
+	/// Connections without a complete request for this long are closed
+	static const int IDLE_TIMEOUT_MS = 10000;
+
+	struct Request
+	{
+		std::string m_method;
+		std::string m_path;							// without the query string, percent-decoded
+		std::map<std::string, std::string> m_query;	// percent-decoded, last value wins
+		std::map<std::string, std::string> m_headers;	// names in lower case
+		std::string m_body;
+
+		/// Value of query parameter `name`, or `defaultValue` if it is missing
+		std::string getQuery(const std::string& name, const std::string& defaultValue = "") const;
+		/// Value of header `name` (lower case), empty if it is missing
+		std::string getHeader(const std::string& name) const;
+	};
+
+	struct Response
+	{
+		unsigned int m_status = 200;
+		std::string m_contentType = "application/json";
+		std::string m_body;
+		std::vector<std::pair<std::string, std::string>> m_headers;
+
+		/// JSON body {"error": message} with the given status
+		static Response Error(unsigned int status, const std::string& message);
+	};
+
+	typedef std::function<Response(const Request&)> Handler;
+
+	/**
+	 * @brief Listens on `address`:`port` (IPv4). Port 0 picks a free port, see getPort().
+	 * @param maxClients Connections served at once; further ones wait in the listen backlog
+	*/
+	HttpServer(const std::string& address, unsigned int port, unsigned int maxClients, ILogger* pLogger = NulLogger::getInstance());
+	/**
+	 * @brief Listens on Unix socket `socketPath`, accessible to the owner only. A stale socket file is replaced.
+	 * The file is removed again by the destructor.
+	*/
+	HttpServer(const std::string& socketPath, unsigned int maxClients, ILogger* pLogger = NulLogger::getInstance());
+	~HttpServer();
+
+	HttpServer(const HttpServer&) = delete;
+	HttpServer& operator=(const HttpServer&) = delete;
+
+	/// Serves `method` requests for `path`. Must be called before Run().
+	void Route(const std::string& method, const std::string& path, Handler handler);
+
+	unsigned int getPort() const { return m_port; }
+
+	/// Limit of headers plus body of one request, larger ones are answered with 413. Must be called before Run().
+	void setMaxRequestSize(size_t maxRequestSize) { m_maxRequestSize = maxRequestSize; }
+
+	/// Serves connections until Stop() is called
+	void Run();
+
+	/// Makes Run() return. Safe to call from other threads and signal handlers.
+	void Stop();
+
+	/// Decodes %XX escapes, and '+' as space if `plusIsSpace`. Returns false on a malformed escape.
+	static bool UrlDecode(const std::string& encoded, std::string& decoded, bool plusIsSpace);
+
+	/// `text` as a quoted JSON string
+	static std::string JsonString(const std::string& text);
+
+	static const char* StatusText(unsigned int status);
+
+private:
+	struct Connection
+	{
+		int m_fd;
+		std::string m_input;
+		std::string m_output;
+		size_t m_outputSent;
+		bool m_closeAfterWrite;
+		int64_t m_lastActivity_ms;
+	};
+
+	void listenOn(int family, const void* pSocketAddress, size_t addressLength, const std::string& description);
+	void acceptConnections();
+	/// Returns false if the connection has to be closed
+	bool readFrom(Connection& connection);
+	bool writeTo(Connection& connection);
+	/// Answers every complete request in the input buffer
+	void processInput(Connection& connection);
+	/// Parses one request from the start of `input`. Returns 0 if it is incomplete, otherwise the bytes it used.
+	size_t parseRequest(const std::string& input, Request& request, bool& keepAlive, unsigned int& errorStatus);
+	Response dispatch(const Request& request);
+	void queueResponse(Connection& connection, const Response& response, bool keepAlive);
+	void closeConnection(size_t index);
+
+	static int64_t now_ms();
+
+	int m_listenFd;
+	int m_stopFd;
+	unsigned int m_port;
+	unsigned int m_maxClients;
+	size_t m_maxRequestSize;
+	std::string m_socketPath;	// empty for TCP
+	std::vector<Connection> m_connections;
+	std::map<std::string, std::map<std::string, Handler>> m_routes;	// path -> method -> handler
+	ILogger* m_pLogger;
+
+	MetricCounter m_requests;
+	MetricCounter m_errors;
+	MetricGauge m_connectionsGauge;
+	MetricHistogram m_requestLatency;
+};
+
+#endif // HTTPSERVER_HPP
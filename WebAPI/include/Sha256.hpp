@@ -0,0 +1,63 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/// SHA-256 (FIPS 180-4), used to store web API keys as digests in `WebPassTable` and to sign MainApplication's offline cache
+class Sha256
+{
+public:
+	typedef std::array<uint8_t, 32> Digest;
+
+	static Digest Hash(const std::string& data);
+	/// HMAC-SHA-256 (RFC 2104) of `data` with `key`
+	static Digest Hmac(const std::string& key, const std::string& data);
+	/// Digest as 64 lower case hex numerals
+	static std::string HexHash(const std::string& data);
+
+	/// HMAC-SHA-256 with a fixed key: the padded key blocks are compressed once, so short data costs two blocks instead of four
+	class HmacKey
+	{
+	public:
+		explicit HmacKey(const std::string& key = std::string());
+
+		/// Same as `Sha256::Hmac(key, data)`
+		Digest Sign(const std::string& data) const;
+
+	private:
+		uint32_t m_innerState[8];
+		uint32_t m_outerState[8];
+	};
+
+private:
+	/// Hashes `size` bytes at `pData` following `prefixSize` bytes (a multiple of 64) already compressed into `state`
+	static Digest finish(uint32_t state[8], const uint8_t* pData, size_t size, uint64_t prefixSize);
+};
+
+#endif // SHA256_HPP
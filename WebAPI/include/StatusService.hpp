@@ -0,0 +1,76 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#ifndef STATUSSERVICE_HPP
+#define STATUSSERVICE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AccessLogReader.hpp"
+#include "HttpServer.hpp"
+#include "Metrics.hpp"
+
+/*
+	Read-only endpoints of WebAPIController:
+
+	GET /status		every process publishing metrics: pid, running or exited, uptime, counters and gauges
+	GET /metrics	all metrics in the Prometheus text format, labelled with the program
+	GET /logs		access log, newest first; ?limit=N (default DEFAULT_LOG_ROWS_LIMIT, at most
+					MAX_LOG_ROWS_LIMIT), ?before_id=ID for the next page (next_before_id of the
+					previous one), ?user_id=ID to filter
+
+	Nothing here talks to the other processes: metrics are copied out of their shared memory segments
+	and the log is read on its own read-only database connection.
+*/
+class StatusService
+{
+public:
+	/**
+	 * @param metricsName METRICS_NAME - segments /metricsName.* are reported
+	 * @param pLogReader Source of /logs, not owned
+	*/
+	StatusService(const std::string& metricsName, AccessLogReader* pLogReader);
+
+	void RegisterRoutes(HttpServer& server);
+
+	HttpServer::Response Status(const HttpServer::Request& request);
+	HttpServer::Response Metrics(const HttpServer::Request& request);
+	HttpServer::Response Logs(const HttpServer::Request& request);
+
+	/// `name` restricted to the characters allowed in Prometheus metric names
+	static std::string PrometheusName(const std::string& name);
+
+private:
+	typedef std::pair<std::string, MetricsRegistry::Snapshot> NamedSnapshot;
+
+	/// Snapshots of every metrics segment in /dev/shm, sorted by segment name
+	std::vector<NamedSnapshot> readSnapshots() const;
+
+	std::string m_metricsName;
+	AccessLogReader* m_pLogReader;
+};
+
+#endif // STATUSSERVICE_HPP
@@ -0,0 +1,159 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AccessLogReader.hpp"
+#include "propertiesclass.h"
+
+#include <sstream>
+
+AccessLogReader::AccessLogReader(const std::string& databasePath) :
+	m_databasePath(databasePath), m_pDatabase(nullptr), m_pSelectPage(nullptr)
+{
+}
+
+AccessLogReader::~AccessLogReader()
+{
+	closeConnection();
+}
+
+bool AccessLogReader::isAvailable(std::string& error)
+{
+	return m_pDatabase != nullptr || open(error);
+}
+
+bool AccessLogReader::open(std::string& error)
+{
+	int status = sqlite3_open_v2(m_databasePath.c_str(), &m_pDatabase, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+	if (status == SQLITE_OK)
+	{
+		sqlite3_busy_timeout(m_pDatabase, BUSY_TIMEOUT_MS);
+		status = sqlite3_exec(m_pDatabase, "PRAGMA query_only = 1;", nullptr, nullptr, nullptr);
+	}
+
+	if (status == SQLITE_OK)
+	{
+		const Properties& properties = GlobalProperties::Get();
+		std::stringstream queryStringBuilder;
+		/*======================================================
+
+			SELECT Id, Timestamp, UserId, AuthMethod, CommandId
+			FROM LogTable
+			WHERE (?1 = 0 OR Id < ?1) AND (?2 IS NULL OR UserId = ?2)
+			ORDER BY Id DESC
+			LIMIT ?3;
+
+		  ======================================================*/
+
+		queryStringBuilder
+			<< "SELECT " << properties.LOG_TABLE_ID_COLUMN_NAME << ", " << properties.LOG_TABLE_TIMESTAMP_COLUMN_NAME << ", "
+			<< properties.LOG_TABLE_USER_ID_COLUMN_NAME << ", " << properties.LOG_TABLE_AUTH_METHOD_COLUMN_NAME << ", "
+			<< properties.LOG_TABLE_COMMAND_ID_COLUMN_NAME << " "
+			<< "FROM " << properties.LOG_TABLE_NAME << " "
+			<< "WHERE " << "(?1 = 0 OR " << properties.LOG_TABLE_ID_COLUMN_NAME << " < ?1)" << " "
+			<< "AND " << "(?2 IS NULL OR " << properties.LOG_TABLE_USER_ID_COLUMN_NAME << " = ?2)" << " "
+			<< "ORDER BY " << properties.LOG_TABLE_ID_COLUMN_NAME << " DESC" << " "
+			<< "LIMIT " << "?3" << ";";
+
+		status = sqlite3_prepare_v2(m_pDatabase, queryStringBuilder.str().c_str(), -1, &m_pSelectPage, nullptr);
+	}
+
+	if (status != SQLITE_OK)
+	{
+		error = "cannot read database " + m_databasePath + ": " + (m_pDatabase != nullptr ? sqlite3_errmsg(m_pDatabase) : sqlite3_errstr(status));
+		closeConnection();
+		return false;
+	}
+
+	return true;
+}
+
+void AccessLogReader::closeConnection()
+{
+	sqlite3_finalize(m_pSelectPage);
+	m_pSelectPage = nullptr;
+	sqlite3_close(m_pDatabase);
+	m_pDatabase = nullptr;
+}
+
+bool AccessLogReader::Read(int64_t beforeId, unsigned int limit, int64_t userId, std::vector<Entry>& entries, bool& more, std::string& error)
+{
+	entries.clear();
+	more = false;
+
+	if (!isAvailable(error))
+	{
+		return false;
+	}
+
+	// One row more than asked for tells whether there is another page
+	sqlite3_bind_int64(m_pSelectPage, 1, beforeId);
+	if (userId >= 0)
+	{
+		sqlite3_bind_int64(m_pSelectPage, 2, userId);
+	}
+	else
+	{
+		sqlite3_bind_null(m_pSelectPage, 2);
+	}
+	sqlite3_bind_int64(m_pSelectPage, 3, static_cast<int64_t>(limit) + 1);
+
+	int status;
+	while ((status = sqlite3_step(m_pSelectPage)) == SQLITE_ROW)
+	{
+		if (entries.size() == limit)
+		{
+			more = true;
+			break;
+		}
+
+		Entry entry;
+		entry.m_id = sqlite3_column_int64(m_pSelectPage, 0);
+		const unsigned char* pTimestamp = sqlite3_column_text(m_pSelectPage, 1);
+		entry.m_timestamp = pTimestamp != nullptr ? reinterpret_cast<const char*>(pTimestamp) : "";
+		entry.m_userId = static_cast<unsigned int>(sqlite3_column_int64(m_pSelectPage, 2));
+		const unsigned char* pAuthMethod = sqlite3_column_text(m_pSelectPage, 3);
+		entry.m_authMethod = pAuthMethod != nullptr ? reinterpret_cast<const char*>(pAuthMethod) : "";
+		entry.m_commandId = static_cast<unsigned int>(sqlite3_column_int64(m_pSelectPage, 4));
+		entries.push_back(entry);
+	}
+
+	const bool ok = status == SQLITE_ROW || status == SQLITE_DONE;
+	if (!ok)
+	{
+		error = "cannot read access log: " + std::string(sqlite3_errmsg(m_pDatabase));
+	}
+
+	// Reset ends the read transaction, so the WAL can be checkpointed while the server is idle
+	sqlite3_reset(m_pSelectPage);
+	sqlite3_clear_bindings(m_pSelectPage);
+
+	if (!ok)
+	{
+		entries.clear();
+		// Reopened on the next request, e.g. after the database file was replaced
+		closeConnection();
+	}
+
+	return ok;
+}
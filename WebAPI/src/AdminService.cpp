@@ -0,0 +1,781 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "AdminService.hpp"
+#include "FieldValidators.hpp"
+#include "Sha256.hpp"
+#include "propertiesclass.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace
+{
+	std::string trim(const std::string& text)
+	{
+		const size_t begin = text.find_first_not_of(" \t\r");
+		if (begin == std::string::npos)
+		{
+			return "";
+		}
+		return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+	}
+
+	std::string toLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+		return text;
+	}
+
+	bool parseClearance(const std::string& text, Clearance& clearance)
+	{
+		if (!FieldValidators::SignedNumber::test(text))
+		{
+			return false;
+		}
+
+		const long value = std::strtol(text.c_str(), nullptr, 10);
+		if (value < NO_CLEARANCE || value >= MAX_CLEARANCE)
+		{
+			return false;
+		}
+
+		clearance = static_cast<Clearance>(value);
+		return true;
+	}
+
+	/// Just enough JSON for the import format: objects, arrays, strings and integers, unknown members are skipped
+	class JsonReader
+	{
+	public:
+		explicit JsonReader(const std::string& text) : m_text(text), m_position(0) {}
+
+		/// Skips white space and consumes `c` if it is next
+		bool consume(char c)
+		{
+			skipWhitespace();
+			if (m_position < m_text.size() && m_text[m_position] == c)
+			{
+				++m_position;
+				return true;
+			}
+			return false;
+		}
+
+		bool peek(char c)
+		{
+			skipWhitespace();
+			return m_position < m_text.size() && m_text[m_position] == c;
+		}
+
+		bool atEnd()
+		{
+			skipWhitespace();
+			return m_position == m_text.size();
+		}
+
+		bool readString(std::string& value)
+		{
+			value.clear();
+			if (!consume('"'))
+			{
+				return false;
+			}
+
+			while (m_position < m_text.size())
+			{
+				const char c = m_text[m_position++];
+				if (c == '"')
+				{
+					return true;
+				}
+
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					return false;
+				}
+
+				if (c != '\\')
+				{
+					value += c;
+					continue;
+				}
+
+				if (m_position == m_text.size())
+				{
+					return false;
+				}
+
+				const char escaped = m_text[m_position++];
+				switch (escaped)
+				{
+				case '"': case '\\': case '/': value += escaped; break;
+				case 'b': value += '\b'; break;
+				case 'f': value += '\f'; break;
+				case 'n': value += '\n'; break;
+				case 'r': value += '\r'; break;
+				case 't': value += '\t'; break;
+				case 'u':
+				{
+					// Names, cards and PINs are ASCII; other characters would be refused by validation anyway
+					if (m_position + 4 > m_text.size())
+					{
+						return false;
+					}
+					const std::string hex = m_text.substr(m_position, 4);
+					if (!FieldValidators::FullMatch<FieldValidators::Run<FieldValidators::HexDigit, 4>>::test(hex))
+					{
+						return false;
+					}
+					m_position += 4;
+					const long code = std::strtol(hex.c_str(), nullptr, 16);
+					value += code < 0x80 ? static_cast<char>(code) : '?';
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		bool readInteger(long& value)
+		{
+			skipWhitespace();
+			const size_t begin = m_position;
+			if (m_position < m_text.size() && m_text[m_position] == '-')
+			{
+				++m_position;
+			}
+			while (m_position < m_text.size() && std::isdigit(static_cast<unsigned char>(m_text[m_position])))
+			{
+				++m_position;
+			}
+
+			const std::string number = m_text.substr(begin, m_position - begin);
+			if (!FieldValidators::SignedNumber::test(number))
+			{
+				return false;
+			}
+
+			value = std::strtol(number.c_str(), nullptr, 10);
+			return true;
+		}
+
+		/// Skips one value of any type
+		bool skipValue(int depth = 0)
+		{
+			if (depth > 32)
+			{
+				return false;
+			}
+
+			std::string text;
+			if (peek('"'))
+			{
+				return readString(text);
+			}
+
+			if (consume('{') || consume('['))
+			{
+				const char close = m_text[m_position - 1] == '{' ? '}' : ']';
+				if (consume(close))
+				{
+					return true;
+				}
+
+				do
+				{
+					if (close == '}' && (!readString(text) || !consume(':')))
+					{
+						return false;
+					}
+					if (!skipValue(depth + 1))
+					{
+						return false;
+					}
+				} while (consume(','));
+
+				return consume(close);
+			}
+
+			// Numbers, true, false, null
+			const size_t begin = m_position;
+			while (m_position < m_text.size() && (std::isalnum(static_cast<unsigned char>(m_text[m_position])) || std::strchr("+-.", m_text[m_position]) != nullptr))
+			{
+				++m_position;
+			}
+			return m_position != begin;
+		}
+
+		size_t getPosition() const { return m_position; }
+
+	private:
+		void skipWhitespace()
+		{
+			while (m_position < m_text.size() && std::strchr(" \t\r\n", m_text[m_position]) != nullptr && m_text[m_position] != '\0')
+			{
+				++m_position;
+			}
+		}
+
+		const std::string& m_text;
+		size_t m_position;
+	};
+
+	bool readStringArray(JsonReader& reader, std::vector<std::string>& values)
+	{
+		if (!reader.consume('['))
+		{
+			return false;
+		}
+
+		if (reader.consume(']'))
+		{
+			return true;
+		}
+
+		do
+		{
+			std::string value;
+			if (!reader.readString(value))
+			{
+				return false;
+			}
+			values.push_back(value);
+		} while (reader.consume(','));
+
+		return reader.consume(']');
+	}
+
+	bool readEmployee(JsonReader& reader, ImportedEmployee& employee)
+	{
+		if (!reader.consume('{'))
+		{
+			return false;
+		}
+
+		if (reader.consume('}'))
+		{
+			return true;
+		}
+
+		do
+		{
+			std::string member;
+			if (!reader.readString(member) || !reader.consume(':'))
+			{
+				return false;
+			}
+
+			long clearance = 0;
+			bool valid;
+			if (member == "name")
+			{
+				valid = reader.readString(employee.m_name);
+			}
+			else if (member == "clearance")
+			{
+				valid = reader.readInteger(clearance) && parseClearance(std::to_string(clearance), employee.m_clearance);
+			}
+			else if (member == "cards")
+			{
+				valid = readStringArray(reader, employee.m_cards);
+			}
+			else if (member == "pins")
+			{
+				// PINs as strings: a leading zero would be lost in a number
+				valid = readStringArray(reader, employee.m_pins);
+			}
+			else
+			{
+				valid = reader.skipValue();
+			}
+
+			if (!valid)
+			{
+				return false;
+			}
+		} while (reader.consume(','));
+
+		return reader.consume('}');
+	}
+}
+
+const size_t AdminService::MAX_IMPORT_SIZE;
+const int AdminService::BUSY_TIMEOUT_MS;
+
+AdminService::AdminService(const std::string& databasePath, MailboxRpc* pRpc, const std::string& gateway, ILogger* pLogger) :
+	m_databasePath(databasePath), m_pRpc(pRpc), m_gateway(gateway), m_pLogger(pLogger),
+	m_pDatabase(nullptr), m_pSelectKeyClearance(nullptr), m_pSelectCommandClearance(nullptr)
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	if (m_pRpc == nullptr)
+	{
+		*m_pLogger << "AdminService -- pointer to pRpc cannot be null!";
+		Kernel::Fatal_Error("AdminService -- pointer to pRpc cannot be null!");
+	}
+}
+
+AdminService::~AdminService()
+{
+	closeConnection();
+}
+
+void AdminService::RegisterRoutes(HttpServer& server)
+{
+	server.setMaxRequestSize(MAX_IMPORT_SIZE);
+	server.Route("POST", "/admin/import", [this](const HttpServer::Request& request) { return Import(request); });
+	server.Route("GET", "/admin/export", [this](const HttpServer::Request& request) { return Export(request); });
+}
+
+bool AdminService::open(std::string& error)
+{
+	if (m_pDatabase != nullptr)
+	{
+		return true;
+	}
+
+	int status = sqlite3_open_v2(m_databasePath.c_str(), &m_pDatabase, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+	if (status == SQLITE_OK)
+	{
+		sqlite3_busy_timeout(m_pDatabase, BUSY_TIMEOUT_MS);
+		status = sqlite3_exec(m_pDatabase, "PRAGMA query_only = 1;", nullptr, nullptr, nullptr);
+	}
+
+	if (status == SQLITE_OK)
+	{
+		const Properties& properties = GlobalProperties::Get();
+		std::stringstream queryStringBuilder;
+		/*======================================================
+
+			SELECT Employees.Clearance
+			FROM WebPassTable JOIN Employees ON Employees.EmployeeId = WebPassTable.UserId
+			WHERE WebPassTable.WebPassHash = ?1;
+
+		  ======================================================*/
+
+		// WebPassTable's names are fixed, see WebAPITable
+		queryStringBuilder
+			<< "SELECT " << properties.EMPLOYEES_TABLE_NAME << "." << properties.EMPLOYEES_TABLE_CLEARANCE_COLUMN_NAME << " "
+			<< "FROM " << "WebPassTable JOIN " << properties.EMPLOYEES_TABLE_NAME << " "
+			<< "ON " << properties.EMPLOYEES_TABLE_NAME << "." << properties.EMPLOYEES_TABLE_ID_COLUMN_NAME << " = WebPassTable.UserId" << " "
+			<< "WHERE " << "WebPassTable.WebPassHash = ?1" << ";";
+
+		status = sqlite3_prepare_v2(m_pDatabase, queryStringBuilder.str().c_str(), -1, &m_pSelectKeyClearance, nullptr);
+
+		/*======================================================
+
+			SELECT CommandClearance
+			FROM Commands
+			WHERE CommandName = ?1;
+
+		  ======================================================*/
+
+		queryStringBuilder.str("");
+		queryStringBuilder
+			<< "SELECT " << properties.COMMANDS_TABLE_CLEARANCE_COLUMN_NAME << " "
+			<< "FROM " << properties.COMMANDS_TABLE_NAME << " "
+			<< "WHERE " << properties.COMMANDS_TABLE_COMMAND_COLUMN_NAME << " = ?1" << ";";
+
+		if (status == SQLITE_OK)
+		{
+			status = sqlite3_prepare_v2(m_pDatabase, queryStringBuilder.str().c_str(), -1, &m_pSelectCommandClearance, nullptr);
+		}
+	}
+
+	if (status != SQLITE_OK)
+	{
+		error = m_pDatabase != nullptr ? sqlite3_errmsg(m_pDatabase) : "out of memory";
+		closeConnection();
+		return false;
+	}
+
+	return true;
+}
+
+void AdminService::closeConnection()
+{
+	sqlite3_finalize(m_pSelectKeyClearance);
+	sqlite3_finalize(m_pSelectCommandClearance);
+	sqlite3_close(m_pDatabase);
+
+	m_pSelectKeyClearance = nullptr;
+	m_pSelectCommandClearance = nullptr;
+	m_pDatabase = nullptr;
+}
+
+bool AdminService::authorize(const HttpServer::Request& request, const std::string& commandName, std::string& keyHash, HttpServer::Response& response)
+{
+	const std::string authorization = request.getHeader("authorization");
+	const std::string scheme = "bearer ";
+	const std::string key = toLower(authorization.substr(0, scheme.size())) == scheme ? trim(authorization.substr(scheme.size())) : "";
+
+	if (key.empty())
+	{
+		response = HttpServer::Response::Error(401, "missing API key");
+		response.m_headers.emplace_back("WWW-Authenticate", "Bearer");
+		return false;
+	}
+
+	std::string error;
+	if (!open(error))
+	{
+		response = HttpServer::Response::Error(503, "database unavailable: " + error);
+		response.m_headers.emplace_back("Retry-After", "1");
+		return false;
+	}
+
+	keyHash = Sha256::HexHash(key);
+
+	sqlite3_bind_text(m_pSelectKeyClearance, 1, keyHash.c_str(), static_cast<int>(keyHash.size()), SQLITE_TRANSIENT);
+	const int keyStatus = sqlite3_step(m_pSelectKeyClearance);
+	const int clearance = sqlite3_column_int(m_pSelectKeyClearance, 0);
+	sqlite3_reset(m_pSelectKeyClearance);
+
+	sqlite3_bind_text(m_pSelectCommandClearance, 1, commandName.c_str(), static_cast<int>(commandName.size()), SQLITE_TRANSIENT);
+	const int commandStatus = sqlite3_step(m_pSelectCommandClearance);
+	// A command missing from the commands table is reserved for MAX_CLEARANCE, as in DatabaseGateway
+	const int requiredClearance = commandStatus == SQLITE_ROW ? sqlite3_column_int(m_pSelectCommandClearance, 0) : MAX_CLEARANCE;
+	sqlite3_reset(m_pSelectCommandClearance);
+
+	if ((keyStatus != SQLITE_ROW && keyStatus != SQLITE_DONE) || (commandStatus != SQLITE_ROW && commandStatus != SQLITE_DONE))
+	{
+		response = HttpServer::Response::Error(503, std::string("database unavailable: ") + sqlite3_errmsg(m_pDatabase));
+		response.m_headers.emplace_back("Retry-After", "1");
+		closeConnection();
+		return false;
+	}
+
+	if (keyStatus != SQLITE_ROW)
+	{
+		*m_pLogger << "Admin API: unknown key for " + commandName;
+		response = HttpServer::Response::Error(401, "unknown API key");
+		response.m_headers.emplace_back("WWW-Authenticate", "Bearer");
+		return false;
+	}
+
+	if (clearance < requiredClearance)
+	{
+		*m_pLogger << "Admin API: clearance " + std::to_string(clearance) + " insufficient for " + commandName;
+		response = HttpServer::Response::Error(403, "insufficient clearance for " + commandName);
+		return false;
+	}
+
+	return true;
+}
+
+HttpServer::Response AdminService::Import(const HttpServer::Request& request)
+{
+	std::string keyHash;
+	HttpServer::Response response;
+	if (!authorize(request, "IMPORT", keyHash, response))
+	{
+		return response;
+	}
+
+	const std::string contentType = request.getHeader("content-type");
+	const std::string mediaType = toLower(trim(contentType.substr(0, contentType.find(';'))));
+
+	std::vector<ImportedEmployee> employees;
+	std::string error;
+	bool parsed;
+	if (mediaType == "text/csv")
+	{
+		parsed = ParseCsv(request.m_body, employees, error);
+	}
+	else if (mediaType == "application/json")
+	{
+		parsed = ParseJson(request.m_body, employees, error);
+	}
+	else
+	{
+		return HttpServer::Response::Error(415, "content type must be text/csv or application/json");
+	}
+
+	if (!parsed || !ImportSpool::Validate(employees, error))
+	{
+		return HttpServer::Response::Error(400, error);
+	}
+
+	const std::string spoolName = ImportSpool::CreateName();
+	const std::string spoolPath = ImportSpool::getPath(m_databasePath, spoolName);
+	if (!ImportSpool::Write(spoolPath, employees, error))
+	{
+		*m_pLogger << "Admin API: " + error;
+		return HttpServer::Response::Error(500, "cannot hand the import over to the database gateway");
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	CommandMessage message(CommandMessage::enuCommand::IMPORT);
+	message.addParameter(InputParameter(InputParameter::enuType::PlainData, spoolName));
+	message.addParameter(InputParameter(InputParameter::enuType::WebPass, keyHash));
+
+	// Only this request waits; replies to imports which timed out earlier are dropped by MailboxRpc
+	RpcResult result = m_pRpc->Call(m_gateway, std::move(message), std::chrono::milliseconds(GlobalProperties::Get().WEBAPI_IMPORT_TIMEOUT_MS)).get();
+	const DatabaseReply::enuStatus status = result.m_outcome == RpcResult::REPLIED ? result.m_pReply->getReplyStatus() : DatabaseReply::enuStatus::NONE;
+
+	const int64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	switch (status)
+	{
+	case DatabaseReply::enuStatus::SUCCESS:
+		*m_pLogger << "Admin API: imported " + std::to_string(employees.size()) + " employees in " + std::to_string(elapsed_ms) + " ms";
+		response.m_body = "{\"imported\":" + std::to_string(employees.size()) + ",\"elapsed_ms\":" + std::to_string(elapsed_ms) + "}\n";
+		return response;
+
+	case DatabaseReply::enuStatus::NONE:
+		// The gateway still owns the spool file and may commit it later
+		return HttpServer::Response::Error(504, "no reply from the database gateway, the import may still be committed");
+
+	case DatabaseReply::enuStatus::INSUFFICIENT_PERMISSIONS:
+	case DatabaseReply::enuStatus::INVALID_PARAMETER:
+		// Refused before BulkImporter took the spool file
+		unlink(spoolPath.c_str());
+		return HttpServer::Response::Error(status == DatabaseReply::enuStatus::INSUFFICIENT_PERMISSIONS ? 403 : 400, "refused by the database gateway");
+
+	default:
+		return HttpServer::Response::Error(500, "import rolled back by the database gateway, see database.import.log");
+	}
+}
+
+HttpServer::Response AdminService::Export(const HttpServer::Request& request)
+{
+	std::string keyHash;
+	HttpServer::Response response;
+	if (!authorize(request, "EXPORT", keyHash, response))
+	{
+		return response;
+	}
+
+	const std::string format = request.getQuery("format", "json");
+	if (format != "json" && format != "csv")
+	{
+		return HttpServer::Response::Error(400, "format must be json or csv");
+	}
+
+	std::vector<ImportedEmployee> employees;
+	std::string error;
+	if (!BulkImporter::Export(m_pDatabase, employees, error))
+	{
+		closeConnection();
+		response = HttpServer::Response::Error(503, "database unavailable: " + error);
+		response.m_headers.emplace_back("Retry-After", "1");
+		return response;
+	}
+
+	if (format == "csv")
+	{
+		response.m_contentType = "text/csv";
+		response.m_body = ToCsv(employees);
+	}
+	else
+	{
+		response.m_body = ToJson(employees);
+	}
+
+	return response;
+}
+
+bool AdminService::ParseCsv(const std::string& text, std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	employees.clear();
+	std::map<std::string, size_t> indexOf;
+
+	std::istringstream lines(text);
+	std::string line;
+	size_t lineNumber = 0;
+	bool firstRecord = true;
+	while (std::getline(lines, line))
+	{
+		++lineNumber;
+		if (trim(line).empty())
+		{
+			continue;
+		}
+
+		std::vector<std::string> fields;
+		std::istringstream fieldStream(line);
+		std::string field;
+		while (std::getline(fieldStream, field, ','))
+		{
+			field = trim(field);
+			if (field.size() >= 2 && field.front() == '"' && field.back() == '"')
+			{
+				field = field.substr(1, field.size() - 2);
+			}
+			fields.push_back(field);
+		}
+		fields.resize(4);
+
+		// Optional header row
+		if (firstRecord && (toLower(fields[0]) == "employee" || toLower(fields[0]) == "name"))
+		{
+			firstRecord = false;
+			continue;
+		}
+		firstRecord = false;
+
+		const std::string row = "line " + std::to_string(lineNumber) + ": ";
+		Clearance clearance = 0;
+		if (!fields[1].empty() && !parseClearance(fields[1], clearance))
+		{
+			error = row + "invalid clearance " + fields[1];
+			return false;
+		}
+
+		auto existing = indexOf.find(fields[0]);
+		if (existing == indexOf.end())
+		{
+			existing = indexOf.emplace(fields[0], employees.size()).first;
+			employees.push_back(ImportedEmployee());
+			employees.back().m_name = fields[0];
+			employees.back().m_clearance = clearance;
+		}
+		else if (!fields[1].empty() && employees[existing->second].m_clearance != clearance)
+		{
+			error = row + "clearance of " + fields[0] + " differs from an earlier row";
+			return false;
+		}
+
+		ImportedEmployee& employee = employees[existing->second];
+		if (!fields[2].empty())
+		{
+			employee.m_cards.push_back(fields[2]);
+		}
+		if (!fields[3].empty())
+		{
+			employee.m_pins.push_back(fields[3]);
+		}
+	}
+
+	return true;
+}
+
+bool AdminService::ParseJson(const std::string& text, std::vector<ImportedEmployee>& employees, std::string& error)
+{
+	employees.clear();
+	JsonReader reader(text);
+
+	bool valid = reader.consume('{');
+	bool hasEmployees = false;
+	if (valid && !reader.consume('}'))
+	{
+		do
+		{
+			std::string member;
+			valid = reader.readString(member) && reader.consume(':');
+			if (valid && member == "employees")
+			{
+				hasEmployees = true;
+				valid = reader.consume('[');
+				if (valid && !reader.consume(']'))
+				{
+					do
+					{
+						employees.push_back(ImportedEmployee());
+						valid = readEmployee(reader, employees.back());
+					} while (valid && employees.size() <= ImportSpool::MAX_EMPLOYEES && reader.consume(','));
+					valid = valid && reader.consume(']');
+				}
+			}
+			else if (valid)
+			{
+				valid = reader.skipValue();
+			}
+		} while (valid && reader.consume(','));
+
+		valid = valid && reader.consume('}');
+	}
+
+	if (!valid || !reader.atEnd())
+	{
+		error = "malformed JSON near offset " + std::to_string(reader.getPosition())
+			+ ", expected {\"employees\":[{\"name\":string,\"clearance\":number,\"cards\":[string],\"pins\":[string]}]}";
+		return false;
+	}
+
+	if (!hasEmployees)
+	{
+		error = "missing \"employees\"";
+		return false;
+	}
+
+	return true;
+}
+
+std::string AdminService::ToCsv(const std::vector<ImportedEmployee>& employees)
+{
+	std::string csv = "employee,clearance,card,pin\n";
+	for (const ImportedEmployee& employee : employees)
+	{
+		// One row per credential pair, an employee without credentials still gets one
+		const size_t rows = std::max<size_t>(1, std::max(employee.m_cards.size(), employee.m_pins.size()));
+		for (size_t row = 0; row < rows; ++row)
+		{
+			csv += employee.m_name + "," + std::to_string(employee.m_clearance) + ","
+				+ (row < employee.m_cards.size() ? employee.m_cards[row] : "") + ","
+				+ (row < employee.m_pins.size() ? employee.m_pins[row] : "") + "\n";
+		}
+	}
+	return csv;
+}
+
+std::string AdminService::ToJson(const std::vector<ImportedEmployee>& employees)
+{
+	auto toArray = [](const std::vector<std::string>& values)
+	{
+		std::string array = "[";
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			array += (i == 0 ? "" : ",") + HttpServer::JsonString(values[i]);
+		}
+		return array + "]";
+	};
+
+	std::string json = "{\"employees\":[";
+	for (size_t i = 0; i < employees.size(); ++i)
+	{
+		const ImportedEmployee& employee = employees[i];
+		json += (i == 0 ? "" : ",");
+		json += "{\"name\":" + HttpServer::JsonString(employee.m_name)
+			+ ",\"clearance\":" + std::to_string(employee.m_clearance)
+			+ ",\"cards\":" + toArray(employee.m_cards)
+			+ ",\"pins\":" + toArray(employee.m_pins) + "}";
+	}
+	return json + "]}\n";
+}
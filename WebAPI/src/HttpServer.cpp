@@ -0,0 +1,677 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "HttpServer.hpp"
+#include "Kernel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	std::string toLower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+		return text;
+	}
+
+	std::string trim(const std::string& text)
+	{
+		const size_t begin = text.find_first_not_of(" \t");
+		if (begin == std::string::npos)
+		{
+			return "";
+		}
+		return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+	}
+}
+
+const size_t HttpServer::MAX_REQUEST_SIZE;
+const int HttpServer::IDLE_TIMEOUT_MS;
+
+std::string HttpServer::Request::getQuery(const std::string& name, const std::string& defaultValue) const
+{
+	auto it = m_query.find(name);
+	return it != m_query.end() ? it->second : defaultValue;
+}
+
+std::string HttpServer::Request::getHeader(const std::string& name) const
+{
+	auto it = m_headers.find(name);
+	return it != m_headers.end() ? it->second : "";
+}
+
+HttpServer::Response HttpServer::Response::Error(unsigned int status, const std::string& message)
+{
+	Response response;
+	response.m_status = status;
+	response.m_body = "{\"error\":" + JsonString(message) + "}\n";
+	return response;
+}
+
+HttpServer::HttpServer(const std::string& address, unsigned int port, unsigned int maxClients, ILogger* pLogger) :
+	m_listenFd(-1), m_stopFd(-1), m_port(port), m_maxClients(maxClients), m_maxRequestSize(MAX_REQUEST_SIZE), m_pLogger(pLogger),
+	m_requests(MetricsRegistry::Process().getCounter("webapi.requests")),
+	m_errors(MetricsRegistry::Process().getCounter("webapi.errors")),
+	m_connectionsGauge(MetricsRegistry::Process().getGauge("webapi.connections")),
+	m_requestLatency(MetricsRegistry::Process().getHistogram("webapi.request_ns"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	sockaddr_in socketAddress;
+	std::memset(&socketAddress, 0, sizeof(socketAddress));
+	socketAddress.sin_family = AF_INET;
+	socketAddress.sin_port = htons(static_cast<uint16_t>(port));
+	if (port > 65535 || inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1)
+	{
+		Kernel::Fatal_Error("HttpServer - Invalid listen address " + address + ":" + std::to_string(port));
+	}
+
+	listenOn(AF_INET, &socketAddress, sizeof(socketAddress), address + ":" + std::to_string(port));
+
+	socklen_t addressLength = sizeof(socketAddress);
+	if (getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&socketAddress), &addressLength) == 0)
+	{
+		m_port = ntohs(socketAddress.sin_port);
+	}
+
+	*m_pLogger << "HTTP server listening on " + address + ":" + std::to_string(m_port);
+}
+
+HttpServer::HttpServer(const std::string& socketPath, unsigned int maxClients, ILogger* pLogger) :
+	m_listenFd(-1), m_stopFd(-1), m_port(0), m_maxClients(maxClients), m_maxRequestSize(MAX_REQUEST_SIZE), m_socketPath(socketPath), m_pLogger(pLogger),
+	m_requests(MetricsRegistry::Process().getCounter("webapi.requests")),
+	m_errors(MetricsRegistry::Process().getCounter("webapi.errors")),
+	m_connectionsGauge(MetricsRegistry::Process().getGauge("webapi.connections")),
+	m_requestLatency(MetricsRegistry::Process().getHistogram("webapi.request_ns"))
+{
+	if (m_pLogger == nullptr)
+	{
+		m_pLogger = NulLogger::getInstance();
+	}
+
+	sockaddr_un socketAddress;
+	std::memset(&socketAddress, 0, sizeof(socketAddress));
+	socketAddress.sun_family = AF_UNIX;
+	if (socketPath.empty() || socketPath.size() >= sizeof(socketAddress.sun_path))
+	{
+		Kernel::Fatal_Error("HttpServer - Invalid socket path " + socketPath);
+	}
+	std::memcpy(socketAddress.sun_path, socketPath.c_str(), socketPath.size());
+
+	// Left behind by a server which was killed; bind() fails on an existing file
+	unlink(socketPath.c_str());
+
+	// Created without permissions for group and others, there is no window in which they could connect
+	const mode_t previousMask = umask(0077);
+	listenOn(AF_UNIX, &socketAddress, sizeof(socketAddress), socketPath);
+	umask(previousMask);
+
+	*m_pLogger << "HTTP server listening on " + socketPath;
+}
+
+void HttpServer::listenOn(int family, const void* pSocketAddress, size_t addressLength, const std::string& description)
+{
+	m_stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	m_listenFd = socket(family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (m_stopFd < 0 || m_listenFd < 0)
+	{
+		Kernel::Fatal_Error("HttpServer - Could not create sockets: " + std::string(strerror(errno)));
+	}
+
+	// A restarted server must not wait for connections of the previous one in TIME_WAIT
+	int enable = 1;
+	setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+	if (bind(m_listenFd, static_cast<const sockaddr*>(pSocketAddress), static_cast<socklen_t>(addressLength)) < 0
+		|| listen(m_listenFd, SOMAXCONN) < 0)
+	{
+		Kernel::Fatal_Error("HttpServer - Could not listen on " + description + ": " + strerror(errno));
+	}
+}
+
+HttpServer::~HttpServer()
+{
+	for (const Connection& connection : m_connections)
+	{
+		close(connection.m_fd);
+	}
+	m_connectionsGauge.Set(0);
+
+	close(m_listenFd);
+	close(m_stopFd);
+
+	if (!m_socketPath.empty())
+	{
+		unlink(m_socketPath.c_str());
+	}
+}
+
+void HttpServer::Route(const std::string& method, const std::string& path, Handler handler)
+{
+	m_routes[path][method] = handler;
+}
+
+void HttpServer::Stop()
+{
+	const uint64_t one = 1;
+	if (write(m_stopFd, &one, sizeof(one)) < 0)
+	{
+		// Counter already non-zero: a stop is pending anyway
+	}
+}
+
+void HttpServer::Run()
+{
+	std::vector<pollfd> fds;
+
+	for (;;)
+	{
+		fds.clear();
+		fds.push_back({ m_stopFd, POLLIN, 0 });
+		// At the limit the listen socket is not polled, new clients wait in the backlog
+		fds.push_back({ m_connections.size() < m_maxClients ? m_listenFd : -1, POLLIN, 0 });
+		for (const Connection& connection : m_connections)
+		{
+			fds.push_back({ connection.m_fd, static_cast<short>(connection.m_output.empty() ? POLLIN : POLLOUT), 0 });
+		}
+
+		if (poll(fds.data(), fds.size(), 1000) < 0)
+		{
+			if (errno == EINTR) continue;
+			Kernel::Warning("HttpServer - poll failed: " + std::string(strerror(errno)));
+			break;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			break;
+		}
+
+		// Backwards, so closing a connection does not shift the ones still to be handled
+		const int64_t current_ms = now_ms();
+		for (size_t i = m_connections.size(); i-- > 0;)
+		{
+			Connection& connection = m_connections[i];
+			const short events = fds[i + 2].revents;
+			bool keep = true;
+
+			if (events & (POLLERR | POLLNVAL))
+			{
+				keep = false;
+			}
+			else if (events & POLLOUT)
+			{
+				keep = writeTo(connection);
+			}
+			else if (events & (POLLIN | POLLHUP))
+			{
+				keep = readFrom(connection);
+			}
+			else if (current_ms - connection.m_lastActivity_ms > IDLE_TIMEOUT_MS)
+			{
+				keep = false;
+			}
+
+			if (!keep)
+			{
+				closeConnection(i);
+			}
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			acceptConnections();
+		}
+	}
+}
+
+void HttpServer::acceptConnections()
+{
+	while (m_connections.size() < m_maxClients)
+	{
+		int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		// Responses are written in one piece, Nagle would only delay them
+		if (m_socketPath.empty())
+		{
+			int enable = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+		}
+
+		m_connections.push_back({ fd, "", "", 0, false, now_ms() });
+		m_connectionsGauge.Set(static_cast<int64_t>(m_connections.size()));
+	}
+}
+
+void HttpServer::closeConnection(size_t index)
+{
+	close(m_connections[index].m_fd);
+	m_connections.erase(m_connections.begin() + index);
+	m_connectionsGauge.Set(static_cast<int64_t>(m_connections.size()));
+}
+
+bool HttpServer::readFrom(Connection& connection)
+{
+	char buffer[4096];
+	bool peerClosed = false;
+	for (;;)
+	{
+		ssize_t received = read(connection.m_fd, buffer, sizeof(buffer));
+		if (received > 0)
+		{
+			connection.m_input.append(buffer, received);
+			if (connection.m_input.size() > 2 * m_maxRequestSize)
+			{
+				// A client sending faster than it reads its responses; parse what we have first
+				break;
+			}
+			continue;
+		}
+
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+
+		// Peer closed or the connection failed; a half-closed client still gets its pending responses
+		if (received == 0 && !connection.m_input.empty())
+		{
+			peerClosed = true;
+			break;
+		}
+		return false;
+	}
+
+	connection.m_lastActivity_ms = now_ms();
+	processInput(connection);
+	if (peerClosed)
+	{
+		connection.m_closeAfterWrite = true;
+	}
+
+	return connection.m_output.empty() ? !connection.m_closeAfterWrite : writeTo(connection);
+}
+
+bool HttpServer::writeTo(Connection& connection)
+{
+	while (connection.m_outputSent < connection.m_output.size())
+	{
+		ssize_t sent = send(connection.m_fd, connection.m_output.data() + connection.m_outputSent,
+			connection.m_output.size() - connection.m_outputSent, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR) continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		connection.m_outputSent += sent;
+	}
+
+	connection.m_output.clear();
+	connection.m_outputSent = 0;
+	connection.m_lastActivity_ms = now_ms();
+
+	if (connection.m_closeAfterWrite)
+	{
+		return false;
+	}
+
+	// Requests pipelined behind the ones just answered
+	processInput(connection);
+	return connection.m_output.empty() || writeTo(connection);
+}
+
+void HttpServer::processInput(Connection& connection)
+{
+	while (!connection.m_closeAfterWrite && !connection.m_input.empty())
+	{
+		Request request;
+		bool keepAlive = false;
+		unsigned int errorStatus = 0;
+
+		const size_t used = parseRequest(connection.m_input, request, keepAlive, errorStatus);
+		if (errorStatus != 0)
+		{
+			m_errors.Increment();
+			connection.m_input.clear();
+			queueResponse(connection, Response::Error(errorStatus, StatusText(errorStatus)), false);
+			return;
+		}
+
+		if (used == 0)
+		{
+			return;
+		}
+
+		connection.m_input.erase(0, used);
+
+		const auto start = std::chrono::steady_clock::now();
+		const Response response = dispatch(request);
+		queueResponse(connection, response, keepAlive);
+		m_requestLatency.Record(std::chrono::steady_clock::now() - start);
+
+		m_requests.Increment();
+		if (response.m_status >= 400)
+		{
+			m_errors.Increment();
+		}
+	}
+}
+
+size_t HttpServer::parseRequest(const std::string& input, Request& request, bool& keepAlive, unsigned int& errorStatus)
+{
+	const size_t headerEnd = input.find("\r\n\r\n");
+	if ((headerEnd == std::string::npos && input.size() > m_maxRequestSize) || (headerEnd != std::string::npos && headerEnd + 4 > m_maxRequestSize))
+	{
+		errorStatus = 431;
+		return 0;
+	}
+
+	if (headerEnd == std::string::npos)
+	{
+		return 0;
+	}
+
+	std::istringstream lines(input.substr(0, headerEnd + 2));
+	std::string line;
+	std::getline(lines, line);
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.pop_back();
+	}
+
+	// Request line: METHOD SP target SP HTTP/1.x
+	std::string target;
+	std::string version;
+	std::istringstream requestLine(line);
+	if (!(requestLine >> request.m_method >> target >> version) || target.empty() || target[0] != '/')
+	{
+		errorStatus = 400;
+		return 0;
+	}
+
+	if (version != "HTTP/1.1" && version != "HTTP/1.0")
+	{
+		errorStatus = 505;
+		return 0;
+	}
+	const bool http11 = version == "HTTP/1.1";
+
+	while (std::getline(lines, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		const size_t colon = line.find(':');
+		if (colon == std::string::npos || colon == 0)
+		{
+			errorStatus = 400;
+			return 0;
+		}
+		request.m_headers[toLower(line.substr(0, colon))] = trim(line.substr(colon + 1));
+	}
+
+	if (!request.getHeader("transfer-encoding").empty())
+	{
+		errorStatus = 501;
+		return 0;
+	}
+
+	size_t contentLength = 0;
+	const std::string lengthHeader = request.getHeader("content-length");
+	if (!lengthHeader.empty())
+	{
+		if (lengthHeader.find_first_not_of("0123456789") != std::string::npos || lengthHeader.size() > 9)
+		{
+			errorStatus = 400;
+			return 0;
+		}
+		contentLength = std::stoul(lengthHeader);
+	}
+
+	const size_t requestSize = headerEnd + 4 + contentLength;
+	if (requestSize > m_maxRequestSize)
+	{
+		errorStatus = 413;
+		return 0;
+	}
+
+	if (input.size() < requestSize)
+	{
+		return 0;
+	}
+
+	request.m_body = input.substr(headerEnd + 4, contentLength);
+
+	const std::string connectionHeader = toLower(request.getHeader("connection"));
+	keepAlive = http11 ? connectionHeader != "close" : connectionHeader == "keep-alive";
+
+	// Target: path[?name=value&...]
+	const size_t queryStart = target.find('?');
+	if (!UrlDecode(target.substr(0, queryStart), request.m_path, false))
+	{
+		errorStatus = 400;
+		return 0;
+	}
+
+	if (queryStart != std::string::npos)
+	{
+		std::istringstream parameters(target.substr(queryStart + 1));
+		std::string parameter;
+		while (std::getline(parameters, parameter, '&'))
+		{
+			if (parameter.empty()) continue;
+
+			const size_t equals = parameter.find('=');
+			std::string name;
+			std::string value;
+			if (!UrlDecode(parameter.substr(0, equals), name, true)
+				|| (equals != std::string::npos && !UrlDecode(parameter.substr(equals + 1), value, true)))
+			{
+				errorStatus = 400;
+				return 0;
+			}
+			request.m_query[name] = value;
+		}
+	}
+
+	return requestSize;
+}
+
+HttpServer::Response HttpServer::dispatch(const Request& request)
+{
+	auto path = m_routes.find(request.m_path);
+	if (path == m_routes.end())
+	{
+		return Response::Error(404, "no such resource: " + request.m_path);
+	}
+
+	auto handler = path->second.find(request.m_method);
+	if (handler == path->second.end())
+	{
+		Response response = Response::Error(405, "method " + request.m_method + " not allowed");
+
+		std::string allowed;
+		for (const auto& method : path->second)
+		{
+			allowed += (allowed.empty() ? "" : ", ") + method.first;
+		}
+		response.m_headers.push_back({ "Allow", allowed });
+		return response;
+	}
+
+	try
+	{
+		return handler->second(request);
+	}
+	catch (const std::exception& exception)
+	{
+		*m_pLogger << "Handler for " + request.m_method + " " + request.m_path + " failed: " + exception.what();
+		return Response::Error(500, "internal error");
+	}
+}
+
+void HttpServer::queueResponse(Connection& connection, const Response& response, bool keepAlive)
+{
+	std::string& output = connection.m_output;
+
+	output += "HTTP/1.1 " + std::to_string(response.m_status) + " " + StatusText(response.m_status) + "\r\n";
+	output += "Content-Type: " + response.m_contentType + "\r\n";
+	output += "Content-Length: " + std::to_string(response.m_body.size()) + "\r\n";
+	output += "Cache-Control: no-store\r\n";
+	output += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+	for (const auto& header : response.m_headers)
+	{
+		output += header.first + ": " + header.second + "\r\n";
+	}
+	output += "\r\n";
+	output += response.m_body;
+
+	if (!keepAlive)
+	{
+		connection.m_closeAfterWrite = true;
+	}
+}
+
+bool HttpServer::UrlDecode(const std::string& encoded, std::string& decoded, bool plusIsSpace)
+{
+	decoded.clear();
+	decoded.reserve(encoded.size());
+
+	for (size_t i = 0; i < encoded.size(); ++i)
+	{
+		const char c = encoded[i];
+		if (c == '%')
+		{
+			if (i + 2 >= encoded.size())
+			{
+				return false;
+			}
+			if (!std::isxdigit(static_cast<unsigned char>(encoded[i + 1])) || !std::isxdigit(static_cast<unsigned char>(encoded[i + 2])))
+			{
+				return false;
+			}
+			decoded += static_cast<char>(std::stoi(encoded.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		}
+		else if (c == '+' && plusIsSpace)
+		{
+			decoded += ' ';
+		}
+		else
+		{
+			decoded += c;
+		}
+	}
+
+	return true;
+}
+
+std::string HttpServer::JsonString(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (unsigned char c : text)
+	{
+		switch (c)
+		{
+		case '"': quoted += "\\\""; break;
+		case '\\': quoted += "\\\\"; break;
+		case '\n': quoted += "\\n"; break;
+		case '\r': quoted += "\\r"; break;
+		case '\t': quoted += "\\t"; break;
+		default:
+			if (c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				quoted += escaped;
+			}
+			else
+			{
+				quoted += static_cast<char>(c);
+			}
+		}
+	}
+	return quoted + "\"";
+}
+
+const char* HttpServer::StatusText(unsigned int status)
+{
+	switch (status)
+	{
+	case 200: return "OK";
+	case 201: return "Created";
+	case 204: return "No Content";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 409: return "Conflict";
+	case 413: return "Payload Too Large";
+	case 415: return "Unsupported Media Type";
+	case 429: return "Too Many Requests";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 503: return "Service Unavailable";
+	case 504: return "Gateway Timeout";
+	case 505: return "HTTP Version Not Supported";
+	default: return "Unknown";
+	}
+}
+
+int64_t HttpServer::now_ms()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
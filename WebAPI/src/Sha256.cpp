@@ -0,0 +1,217 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "Sha256.hpp"
+
+#include <cstring>
+
+namespace
+{
+	const uint32_t ROUND_CONSTANTS[64] =
+	{
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+	inline uint32_t rotateRight(uint32_t value, int count)
+	{
+		return (value >> count) | (value << (32 - count));
+	}
+
+	void processBlock(uint32_t state[8], const uint8_t* pBlock)
+	{
+		uint32_t schedule[64];
+		for (int i = 0; i < 16; ++i)
+		{
+			schedule[i] = (uint32_t(pBlock[4 * i]) << 24) | (uint32_t(pBlock[4 * i + 1]) << 16) | (uint32_t(pBlock[4 * i + 2]) << 8) | uint32_t(pBlock[4 * i + 3]);
+		}
+		for (int i = 16; i < 64; ++i)
+		{
+			const uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+			const uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+			schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int i = 0; i < 64; ++i)
+		{
+			const uint32_t S1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+			const uint32_t choice = (e & f) ^ (~e & g);
+			const uint32_t temp1 = h + S1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+			const uint32_t S0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+			const uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+			const uint32_t temp2 = S0 + majority;
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + temp1;
+			d = c;
+			c = b;
+			b = a;
+			a = temp1 + temp2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+Sha256::Digest Sha256::Hash(const std::string& data)
+{
+	uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	return finish(state, reinterpret_cast<const uint8_t*>(data.data()), data.size(), 0);
+}
+
+Sha256::Digest Sha256::finish(uint32_t state[8], const uint8_t* pData, size_t size, uint64_t prefixSize)
+{
+	const uint64_t totalSize = prefixSize + size;
+
+	size_t remaining = size;
+	while (remaining >= 64)
+	{
+		processBlock(state, pData);
+		pData += 64;
+		remaining -= 64;
+	}
+
+	// Padding: 0x80, zeros, then the message length in bits as a big-endian 64 bit number
+	uint8_t tail[128];
+	std::memset(tail, 0, sizeof(tail));
+	std::memcpy(tail, pData, remaining);
+	tail[remaining] = 0x80;
+
+	const size_t tailSize = remaining + 1 + 8 <= 64 ? 64 : 128;
+	const uint64_t bitLength = totalSize * 8;
+	for (int i = 0; i < 8; ++i)
+	{
+		tail[tailSize - 1 - i] = static_cast<uint8_t>(bitLength >> (8 * i));
+	}
+
+	processBlock(state, tail);
+	if (tailSize == 128)
+	{
+		processBlock(state, tail + 64);
+	}
+
+	Digest digest;
+	for (int i = 0; i < 8; ++i)
+	{
+		digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+		digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+		digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+		digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+	}
+
+	return digest;
+}
+
+std::string Sha256::HexHash(const std::string& data)
+{
+	static const char HEX[] = "0123456789abcdef";
+
+	const Digest digest = Hash(data);
+	std::string hex;
+	hex.reserve(2 * digest.size());
+	for (uint8_t byte : digest)
+	{
+		hex += HEX[byte >> 4];
+		hex += HEX[byte & 0x0F];
+	}
+
+	return hex;
+}
+
+Sha256::Digest Sha256::Hmac(const std::string& key, const std::string& data)
+{
+	const size_t BLOCK_SIZE = 64;
+
+	std::string blockKey = key;
+	if (blockKey.size() > BLOCK_SIZE)
+	{
+		const Digest digest = Hash(blockKey);
+		blockKey.assign(reinterpret_cast<const char*>(digest.data()), digest.size());
+	}
+	blockKey.resize(BLOCK_SIZE, '\0');
+
+	std::string innerPad(BLOCK_SIZE, '\0');
+	std::string outerPad(BLOCK_SIZE, '\0');
+	for (size_t i = 0; i < BLOCK_SIZE; ++i)
+	{
+		innerPad[i] = static_cast<char>(blockKey[i] ^ 0x36);
+		outerPad[i] = static_cast<char>(blockKey[i] ^ 0x5c);
+	}
+
+	const Digest inner = Hash(innerPad + data);
+	return Hash(outerPad + std::string(reinterpret_cast<const char*>(inner.data()), inner.size()));
+}
+
+Sha256::HmacKey::HmacKey(const std::string& key)
+{
+	const size_t BLOCK_SIZE = 64;
+	const uint32_t INITIAL_STATE[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+	uint8_t blockKey[BLOCK_SIZE];
+	std::memset(blockKey, 0, sizeof(blockKey));
+	if (key.size() > BLOCK_SIZE)
+	{
+		const Digest digest = Hash(key);
+		std::memcpy(blockKey, digest.data(), digest.size());
+	}
+	else
+	{
+		std::memcpy(blockKey, key.data(), key.size());
+	}
+
+	uint8_t innerPad[BLOCK_SIZE];
+	uint8_t outerPad[BLOCK_SIZE];
+	for (size_t i = 0; i < BLOCK_SIZE; ++i)
+	{
+		innerPad[i] = blockKey[i] ^ 0x36;
+		outerPad[i] = blockKey[i] ^ 0x5c;
+	}
+
+	std::memcpy(m_innerState, INITIAL_STATE, sizeof(m_innerState));
+	std::memcpy(m_outerState, INITIAL_STATE, sizeof(m_outerState));
+	processBlock(m_innerState, innerPad);
+	processBlock(m_outerState, outerPad);
+}
+
+Sha256::Digest Sha256::HmacKey::Sign(const std::string& data) const
+{
+	uint32_t state[8];
+	std::memcpy(state, m_innerState, sizeof(state));
+	const Digest inner = finish(state, reinterpret_cast<const uint8_t*>(data.data()), data.size(), 64);
+
+	std::memcpy(state, m_outerState, sizeof(state));
+	return finish(state, inner.data(), inner.size(), 64);
+}
@@ -0,0 +1,302 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "StatusService.hpp"
+#include "Tables.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <map>
+#include <sstream>
+
+#include <dirent.h>
+
+namespace
+{
+	bool isRunning(int pid)
+	{
+		return kill(pid, 0) == 0 || errno == EPERM;
+	}
+
+	/// Decimal number without sign, at most 18 digits so it fits int64_t
+	bool parseNumber(const std::string& text, int64_t& value)
+	{
+		if (text.empty() || text.size() > 18 || text.find_first_not_of("0123456789") != std::string::npos)
+		{
+			return false;
+		}
+		value = std::stoll(text);
+		return true;
+	}
+
+	int64_t realTime_ns()
+	{
+		timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+	}
+}
+
+StatusService::StatusService(const std::string& metricsName, AccessLogReader* pLogReader) :
+	m_metricsName(metricsName), m_pLogReader(pLogReader)
+{
+}
+
+void StatusService::RegisterRoutes(HttpServer& server)
+{
+	server.Route("GET", "/status", [this](const HttpServer::Request& request) { return Status(request); });
+	server.Route("GET", "/metrics", [this](const HttpServer::Request& request) { return Metrics(request); });
+	server.Route("GET", "/logs", [this](const HttpServer::Request& request) { return Logs(request); });
+}
+
+std::vector<StatusService::NamedSnapshot> StatusService::readSnapshots() const
+{
+	std::vector<NamedSnapshot> snapshots;
+	if (m_metricsName.empty())
+	{
+		return snapshots;
+	}
+
+	// glibc keeps POSIX shared memory in /dev/shm, every process has its own /METRICS_NAME.program
+	const std::string prefix = m_metricsName + ".";
+	DIR* pDirectory = opendir("/dev/shm");
+	if (pDirectory == nullptr)
+	{
+		return snapshots;
+	}
+
+	for (dirent* pEntry = readdir(pDirectory); pEntry != nullptr; pEntry = readdir(pDirectory))
+	{
+		const std::string segment = pEntry->d_name;
+		MetricsRegistry::Snapshot snapshot;
+		if (segment.compare(0, prefix.size(), prefix) == 0 && MetricsRegistry::Read(segment, snapshot))
+		{
+			snapshots.push_back({ segment, snapshot });
+		}
+	}
+	closedir(pDirectory);
+
+	std::sort(snapshots.begin(), snapshots.end(),
+		[](const NamedSnapshot& a, const NamedSnapshot& b) { return a.first < b.first; });
+	return snapshots;
+}
+
+HttpServer::Response StatusService::Status(const HttpServer::Request&)
+{
+	const int64_t now_ns = realTime_ns();
+	std::ostringstream body;
+
+	body << "{\"time_s\":" << now_ns / 1000000000LL << ",\"processes\":[";
+
+	bool first = true;
+	for (const NamedSnapshot& named : readSnapshots())
+	{
+		const MetricsRegistry::Snapshot& snapshot = named.second;
+		body << (first ? "" : ",")
+			<< "{\"program\":" << HttpServer::JsonString(snapshot.m_program)
+			<< ",\"segment\":" << HttpServer::JsonString(named.first)
+			<< ",\"pid\":" << snapshot.m_pid
+			<< ",\"running\":" << (isRunning(snapshot.m_pid) ? "true" : "false")
+			<< ",\"started_s\":" << snapshot.m_startTime_ns / 1000000000LL
+			<< ",\"uptime_s\":" << std::max<int64_t>(0, now_ns - snapshot.m_startTime_ns) / 1000000000LL
+			<< ",\"metrics\":{";
+		first = false;
+
+		// Histograms are only in /metrics, the status page keeps to plain numbers
+		bool firstMetric = true;
+		for (const MetricsRegistry::Value& metric : snapshot.m_metrics)
+		{
+			if (metric.m_type == MetricsRegistry::enuCounter || metric.m_type == MetricsRegistry::enuGauge)
+			{
+				body << (firstMetric ? "" : ",") << HttpServer::JsonString(metric.m_name) << ":" << metric.m_value;
+				firstMetric = false;
+			}
+		}
+		body << "}}";
+	}
+
+	std::string error;
+	const bool databaseAvailable = m_pLogReader->isAvailable(error);
+	body << "],\"database\":{\"available\":" << (databaseAvailable ? "true" : "false");
+	if (!databaseAvailable)
+	{
+		body << ",\"error\":" << HttpServer::JsonString(error);
+	}
+	body << "}}\n";
+
+	HttpServer::Response response;
+	response.m_body = body.str();
+	return response;
+}
+
+std::string StatusService::PrometheusName(const std::string& name)
+{
+	std::string sanitized = "nfcdooraccess_";
+	for (char c : name)
+	{
+		const bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+		sanitized += allowed ? c : '_';
+	}
+	return sanitized;
+}
+
+HttpServer::Response StatusService::Metrics(const HttpServer::Request&)
+{
+	// Prometheus wants all samples of a metric together, under a single TYPE line
+	struct Sample
+	{
+		std::string m_program;
+		const MetricsRegistry::Value* m_pValue;
+	};
+	std::vector<std::string> names;
+	std::map<std::string, std::vector<Sample>> samples;
+
+	const std::vector<NamedSnapshot> snapshots = readSnapshots();
+	for (const NamedSnapshot& named : snapshots)
+	{
+		for (const MetricsRegistry::Value& metric : named.second.m_metrics)
+		{
+			std::vector<Sample>& metricSamples = samples[metric.m_name];
+			if (metricSamples.empty())
+			{
+				names.push_back(metric.m_name);
+			}
+			metricSamples.push_back({ named.second.m_program, &metric });
+		}
+	}
+
+	std::ostringstream body;
+	for (const std::string& name : names)
+	{
+		const std::vector<Sample>& metricSamples = samples[name];
+		const std::string exported = PrometheusName(name);
+
+		// A name registered with different types by different programs is reported with the first one
+		const MetricsRegistry::enuMetricType type = metricSamples.front().m_pValue->m_type;
+		body << "# TYPE " << exported << (type == MetricsRegistry::enuCounter ? " counter" : type == MetricsRegistry::enuGauge ? " gauge" : " histogram") << "\n";
+
+		for (const Sample& sample : metricSamples)
+		{
+			const MetricsRegistry::Value& value = *sample.m_pValue;
+			const std::string label = "program=" + HttpServer::JsonString(sample.m_program);
+			if (value.m_type != type)
+			{
+				continue;
+			}
+
+			if (type != MetricsRegistry::enuHistogram)
+			{
+				body << exported << "{" << label << "} " << value.m_value << "\n";
+				continue;
+			}
+
+			// Buckets are in nanoseconds like the histograms themselves; empty ones are left out,
+			// the cumulative counts of the remaining ones are still exact
+			int64_t cumulative = 0;
+			for (uint32_t i = 0; i < value.m_buckets.size(); ++i)
+			{
+				if (value.m_buckets[i] == 0 || i == value.m_buckets.size() - 1)
+				{
+					continue;
+				}
+				cumulative += value.m_buckets[i];
+				body << exported << "_bucket{" << label << ",le=\"" << MetricHistogram::BucketUpperBound(i) << "\"} " << cumulative << "\n";
+			}
+			cumulative += value.m_buckets.empty() ? 0 : value.m_buckets.back();
+
+			body << exported << "_bucket{" << label << ",le=\"+Inf\"} " << cumulative << "\n"
+				<< exported << "_sum{" << label << "} " << value.m_sum_ns << "\n"
+				<< exported << "_count{" << label << "} " << cumulative << "\n";
+		}
+	}
+
+	HttpServer::Response response;
+	response.m_contentType = "text/plain; version=0.0.4";
+	response.m_body = body.str();
+	return response;
+}
+
+HttpServer::Response StatusService::Logs(const HttpServer::Request& request)
+{
+	int64_t limit = DEFAULT_LOG_ROWS_LIMIT;
+	int64_t beforeId = 0;
+	int64_t userId = -1;
+
+	const std::string limitText = request.getQuery("limit");
+	if (!limitText.empty() && (!parseNumber(limitText, limit) || limit == 0 || limit > MAX_LOG_ROWS_LIMIT))
+	{
+		return HttpServer::Response::Error(400, "limit must be between 1 and " + std::to_string(MAX_LOG_ROWS_LIMIT));
+	}
+
+	const std::string beforeText = request.getQuery("before_id");
+	if (!beforeText.empty() && !parseNumber(beforeText, beforeId))
+	{
+		return HttpServer::Response::Error(400, "before_id must be a log entry id");
+	}
+
+	const std::string userText = request.getQuery("user_id");
+	if (!userText.empty() && !parseNumber(userText, userId))
+	{
+		return HttpServer::Response::Error(400, "user_id must be a user id");
+	}
+
+	std::vector<AccessLogReader::Entry> entries;
+	bool more = false;
+	std::string error;
+	if (!m_pLogReader->Read(beforeId, static_cast<unsigned int>(limit), userId, entries, more, error))
+	{
+		HttpServer::Response response = HttpServer::Response::Error(503, error);
+		response.m_headers.push_back({ "Retry-After", "1" });
+		return response;
+	}
+
+	std::ostringstream body;
+	body << "{\"entries\":[";
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const AccessLogReader::Entry& entry = entries[i];
+		body << (i == 0 ? "" : ",")
+			<< "{\"id\":" << entry.m_id
+			<< ",\"timestamp\":" << HttpServer::JsonString(entry.m_timestamp)
+			<< ",\"user_id\":" << entry.m_userId
+			<< ",\"auth_method\":" << HttpServer::JsonString(entry.m_authMethod)
+			<< ",\"command_id\":" << entry.m_commandId << "}";
+	}
+	body << "],\"next_before_id\":";
+	if (more)
+	{
+		body << entries.back().m_id;
+	}
+	else
+	{
+		body << "null";
+	}
+	body << "}\n";
+
+	HttpServer::Response response;
+	response.m_body = body.str();
+	return response;
+}
@@ -22,107 +22,78 @@
 *
 */
 
-#include <QCoreApplication>
-#include <QTcpServer>
-#include <QTcpSocket>
-
-#include <iostream>
-
-const unsigned int PORT = 8080;
-
-class ConnectionManager : public QObject
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <thread>
+
+#include "AccessLogReader.hpp"
+#include "AdminService.hpp"
+#include "HttpServer.hpp"
+#include "Logger.hpp"
+#include "StatusService.hpp"
+#include "UNIX_SignalHandler.hpp"
+#include "propertiesclass.h"
+
+// Local HTTP/1.1 server with read-only status, metrics and access log pages, see StatusService.hpp.
+// The public server never sends to the other processes' mailboxes: a slow or hostile client cannot delay door handling.
+// Bulk imports (AdminService.hpp) are accepted only on the optional admin Unix socket, served by a second thread.
+
+volatile sig_atomic_t globalTerminateFlag = 0;
+
+int main()
 {
-	Q_OBJECT
-
-public:
-	ConnectionManager(QObject* pParent = nullptr) : QObject(pParent) {}
-
-private:
+	UNIX_SignalHandler::bindSignalToFlag(UNIX_SignalHandler::enuSIGTERM, &globalTerminateFlag);
+	UNIX_SignalHandler::bindSignalToFlag(UNIX_SignalHandler::enuSIGINT, &globalTerminateFlag);
 
-	QTcpSocket* m_pSocket = nullptr;
+	GlobalProperties::StartWatching();
 
-	void HandleConnection();
+	Logger logger("webapi.log");
 
-	std::string receiveData();
-	void sendData(const std::string& data);
+	const Properties& properties = GlobalProperties::Get();
 
-	std::string parseCommand(const std::string& command);
+	AccessLogReader logReader(properties.DB_PATH);
+	StatusService statusService(properties.METRICS_NAME, &logReader);
 
-public slots:
-	void ConnectionReceived();
+	HttpServer server(properties.WEBAPI_ADDRESS, properties.WEBAPI_PORT, properties.WEBAPI_MAX_CLIENTS, &logger);
+	statusService.RegisterRoutes(server);
 
-};
+	std::thread serverThread(&HttpServer::Run, &server);
 
-int main(int argc, char** argv)
-{
-	QCoreApplication app(argc, argv);
-
-	std::cout << "Started Qt" << std::endl;
+	std::unique_ptr<MailboxRpc> pAdminRpc;
+	std::unique_ptr<AdminService> pAdminService;
+	std::unique_ptr<HttpServer> pAdminServer;
+	std::thread adminThread;
+	if (!properties.WEBAPI_ADMIN_SOCKET.empty())
+	{
+		pAdminRpc.reset(new MailboxRpc(properties.WEBAPI_MB_NAME, &logger));
+		pAdminRpc->Start();
 
-	QTcpServer* pSocket = new QTcpServer(nullptr);
-	ConnectionManager* pConnectionManager = new ConnectionManager;
+		pAdminService.reset(new AdminService(properties.DB_PATH, pAdminRpc.get(), properties.DBGW_MB_NAME, &logger));
 
-	QObject::connect(pSocket, &QTcpServer::newConnection,
-		pConnectionManager, &ConnectionManager::ConnectionReceived);
+		// Few clients: imports are serialized by the gateway anyway
+		pAdminServer.reset(new HttpServer(properties.WEBAPI_ADMIN_SOCKET, 4, &logger));
+		pAdminService->RegisterRoutes(*pAdminServer);
 
-	if (!pSocket->listen(QHostAddress::Any, PORT))
-	{
-		std::cout << "Could not start listening on server!" << std::endl;
-		return -1;
-	};
-
-	return app.exec();
-}
+		adminThread = std::thread(&HttpServer::Run, pAdminServer.get());
+	}
 
-void ConnectionManager::ConnectionReceived()
-{
-	QTcpServer* pServer = (QTcpServer*)sender();
-	if (pServer == nullptr)
+	while (!globalTerminateFlag)
 	{
-		std::cout << "Invalid pointer to sender!" << std::endl;
-		return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
 	}
 
-	m_pSocket = pServer->nextPendingConnection();
-
-	std::cout << "Connected!" << std::endl;
-
-
-
-	m_pSocket->close();
-}
-
-void HandleConnection()
-{
-	std::string dataString = "";
+	server.Stop();
+	serverThread.join();
 
-	while (dataString != "CLOSE")
+	if (adminThread.joinable())
 	{
-		m_pSocket->waitForReadyRead(10000);
-		if (m_pSocket->bytesAvailable())
-		{
-			QByteArray data = pSocket->readAll();
-
-			dataString = data.toStdString();
-
-			std::cout << "Data received: " << dataString << std::endl;
-
-		}
+		pAdminServer->Stop();
+		adminThread.join();
+		pAdminRpc->Stop();
 	}
 
-}
-
-void HandleConnection();
-
-std::string receiveData();
-void sendData(const std::string& data);
-
-std::string parseCommand(const std::string& command);
-
-
-#include "WebAPIController.moc"
-
-
-
-
+	logger << "Program ended. Terminate flag: " + std::to_string(globalTerminateFlag);
 
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+*	 Copyright (C) Petar Kaselj 2021
+*
+*	 This file is part of NFCDoorAccess.
+*
+*	 NFCDoorAccess is written by Petar Kaselj as an employee of
+*	 Emovis tehnologije d.o.o. which allowed its release under
+*	 this license.
+*
+*    NFCDoorAccess is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    NFCDoorAccess is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with NFCDoorAccess.  If not, see <https://www.gnu.org/licenses/>.
+*
+*/
+
+#include "Database.hpp"
+#include "Sha256.hpp"
+#include "Tables.hpp"
+#include "propertiesclass.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <sys/random.h>
+
+// Creates and revokes the keys of the admin API (AdminService.hpp):
+//   WebAPIKey create EMPLOYEE	prints a new key for EMPLOYEE, replacing the previous one
+//   WebAPIKey revoke EMPLOYEE	removes EMPLOYEE's key
+// Only the SHA-256 of a key is stored in WebPassTable; the key itself is printed once.
+// The key carries the employee's clearance, which must reach the IMPORT or EXPORT command's clearance
+// in the commands table - a command without a row there requires MAX_CLEARANCE.
+
+static const size_t KEY_SIZE = 32;
+
+static bool createKey(std::string& key)
+{
+	unsigned char bytes[KEY_SIZE];
+	if (getrandom(bytes, sizeof(bytes), 0) != static_cast<ssize_t>(sizeof(bytes)))
+	{
+		return false;
+	}
+
+	std::ostringstream text;
+	for (unsigned char byte : bytes)
+	{
+		text << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+	}
+	key = text.str();
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string command = argc == 3 ? argv[1] : "";
+	if (command != "create" && command != "revoke")
+	{
+		std::cerr << "Usage: WebAPIKey create|revoke EMPLOYEE" << std::endl;
+		return 1;
+	}
+
+	Database database(GlobalProperties::Get().DB_PATH);
+
+	EmployeesTable employeesTable(&database);
+	employeesTable.initialize();
+	WebAPITable webAPITable(&database);
+	webAPITable.initialize();
+
+	const std::string employee = argv[2];
+	const UID userId = employeesTable.SelectIdWhereName(employee);
+	if (userId == 0)
+	{
+		std::cerr << "No employee named " << employee << std::endl;
+		return 2;
+	}
+
+	webAPITable.DeleteWhereUserId(userId);
+	if (command == "revoke")
+	{
+		std::cout << "Key of " << employee << " revoked" << std::endl;
+		return 0;
+	}
+
+	std::string key;
+	if (!createKey(key))
+	{
+		std::cerr << "No random bytes available" << std::endl;
+		return 3;
+	}
+
+	webAPITable.Add(userId, Sha256::HexHash(key));
+	std::cout << key << std::endl;
+
+	return 0;
+}